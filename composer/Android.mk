@@ -1,23 +1,8 @@
 LOCAL_PATH := $(call my-dir)
 
 include $(LOCAL_PATH)/../common.mk
-include $(CLEAR_VARS)
 
-LOCAL_MODULE                  := vendor.qti.hardware.display.composer-service
-LOCAL_SANITIZE                := integer_overflow
-LOCAL_VENDOR_MODULE           := true
-LOCAL_MODULE_RELATIVE_PATH    := hw
-LOCAL_MODULE_TAGS             := optional
-LOCAL_C_INCLUDES              := $(common_includes)
-LOCAL_C_INCLUDES              += $(kernel_includes)
-LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
-LOCAL_HEADER_LIBRARIES        := display_headers libThermal_headers
-
-LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Wno-unused-parameter \
-                                 -DLOG_TAG=\"SDM\" $(common_flags) -fcolor-diagnostics
-LOCAL_CLANG                   := true
-
-LOCAL_SHARED_LIBRARIES        := libhistogram libbinder libhardware libutils libcutils libsync \
+composer_shared_libraries     := libhistogram libbinder libhardware libutils libcutils libsync \
                                  libc++ liblog libhidlbase \
                                  liblog libfmq libhardware_legacy \
                                  libsdmcore libqservice libqdutils libqdMetaData \
@@ -34,13 +19,10 @@ LOCAL_SHARED_LIBRARIES        := libhistogram libbinder libhardware libutils lib
                                  android.hardware.graphics.allocator@2.0 \
                                  android.hardware.graphics.allocator@3.0 \
                                  libdisplayconfig.qti \
-                                 libdrm libthermalclient
-
-ifeq ($(TARGET_USES_FOD_ZPOS), true)
-LOCAL_CFLAGS                  += -DFOD_ZPOS
-endif
+                                 libdrm libthermalclient liblz4
 
-LOCAL_SRC_FILES               := QtiComposer.cpp QtiComposerClient.cpp service.cpp \
+composer_src_files            := QtiComposer.cpp QtiComposerClient.cpp \
+                                 QtiComposerCommandRecorder.cpp \
                                  QtiComposerHandleImporter.cpp \
                                  hwc_session.cpp \
                                  hwc_session_services.cpp \
@@ -49,14 +31,25 @@ LOCAL_SRC_FILES               := QtiComposer.cpp QtiComposerClient.cpp service.c
                                  hwc_display_pluggable.cpp \
                                  hwc_display_dummy.cpp \
                                  hwc_display_pluggable_test.cpp \
+                                 hwc_perf_test.cpp \
                                  hwc_display_virtual.cpp \
                                  hwc_debugger.cpp \
+                                 hwc_alloc_counter.cpp \
                                  hwc_buffer_sync_handler.cpp \
                                  hwc_color_manager.cpp \
                                  hwc_layers.cpp \
+                                 hwc_refresh_rate_governor.cpp \
+                                 hwc_avr_scheduler.cpp \
                                  hwc_callbacks.cpp \
                                  cpuhint.cpp \
                                  hwc_tonemapper.cpp \
+                                 hwc_gpu_worker.cpp \
+                                 hwc_frame_dumper.cpp \
+                                 hwc_jank_recorder.cpp \
+                                 hwc_state_page.cpp \
+                                 hwc_warm_state.cpp \
+                                 hwc_event_channel.cpp \
+                                 hwc_sideband_queue.cpp \
                                  display_null.cpp \
                                  hwc_socket_handler.cpp \
                                  hwc_buffer_allocator.cpp \
@@ -69,6 +62,30 @@ LOCAL_SRC_FILES               := QtiComposer.cpp QtiComposerClient.cpp service.c
                                  gl_layer_stitch.cpp \
                                  gl_layer_stitch_impl.cpp
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := vendor.qti.hardware.display.composer-service
+LOCAL_SANITIZE                := integer_overflow
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_RELATIVE_PATH    := hw
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_C_INCLUDES              += $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_HEADER_LIBRARIES        := display_headers libThermal_headers
+
+LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Wno-unused-parameter \
+                                 -DLOG_TAG=\"SDM\" $(common_flags) -fcolor-diagnostics
+LOCAL_CLANG                   := true
+
+LOCAL_SHARED_LIBRARIES        := $(composer_shared_libraries)
+
+ifeq ($(TARGET_USES_FOD_ZPOS), true)
+LOCAL_CFLAGS                  += -DFOD_ZPOS
+endif
+
+LOCAL_SRC_FILES               := service.cpp $(composer_src_files)
+
 LOCAL_INIT_RC                 := vendor.qti.hardware.display.composer-service.rc
 ifneq ($(TARGET_HAS_LOW_RAM),true)
   ifeq ($(TARGET_BOARD_PLATFORM)$(TARGET_BOARD_SUFFIX),bengal_32)
@@ -81,3 +98,43 @@ LOCAL_VINTF_FRAGMENTS         := vendor.qti.hardware.display.composer-service-lo
 endif
 
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := composer_command_replay
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_C_INCLUDES              += $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_HEADER_LIBRARIES        := display_headers libThermal_headers
+LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Wno-unused-parameter \
+                                 -DLOG_TAG=\"SDM\" $(common_flags) -fcolor-diagnostics
+LOCAL_CLANG                   := true
+LOCAL_SHARED_LIBRARIES        := $(composer_shared_libraries)
+ifeq ($(TARGET_USES_FOD_ZPOS), true)
+LOCAL_CFLAGS                  += -DFOD_ZPOS
+endif
+LOCAL_SRC_FILES               := QtiComposerCommandReplay.cpp $(composer_src_files)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := composer_gl_benchmark
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_C_INCLUDES              += $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_HEADER_LIBRARIES        := display_headers libThermal_headers
+LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Wno-unused-parameter \
+                                 -DLOG_TAG=\"SDM\" $(common_flags) -fcolor-diagnostics
+LOCAL_CLANG                   := true
+LOCAL_SHARED_LIBRARIES        := $(composer_shared_libraries)
+ifeq ($(TARGET_USES_FOD_ZPOS), true)
+LOCAL_CFLAGS                  += -DFOD_ZPOS
+endif
+LOCAL_SRC_FILES               := gl_engine_benchmark.cpp $(composer_src_files)
+
+include $(BUILD_EXECUTABLE)
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+* Copyright (c) 2019-2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -27,6 +27,7 @@
 * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <sstream>
 #include <vector>
 #include "QtiComposer.h"
 
@@ -90,10 +91,10 @@ Return<void> QtiComposer::dumpDebugInfo(dumpDebugInfo_cb _hidl_cb) {
   std::vector<char> buf(len + 1);
   hwc_session_->Dump(&len, buf.data());
 
-  buf.resize(len + 1);
-  buf[len] = '\0';
-  hidl_string buf_reply;
-  buf_reply.setToExternal(buf.data(), len);
+  std::ostringstream os;
+  os.write(buf.data(), len);
+  mHandleImporter.dump(&os);
+  hidl_string buf_reply = os.str();
 
   _hidl_cb(buf_reply);
   return Void();
@@ -58,6 +58,7 @@ void BufferCacheEntry::clear() {
 QtiComposerClient::QtiComposerClient() : mWriter(kWriterInitialSize), mReader(*this) {
   hwc_session_ = HWCSession::GetInstance();
   mHandleImporter.initialize();
+  mRecorder.init();
 }
 
 QtiComposerClient::~QtiComposerClient() {
@@ -137,8 +138,19 @@ void QtiComposerClient::onHotplug(hwc2_callback_data_t callbackData, hwc2_displa
     client->hwc_session_->GetVsyncPeriod(HWC_DISPLAY_PRIMARY, &vsync_period);
     usleep(vsync_period * 2 / 1000);
 
-    // Wait for the input command message queue to process before destroying the local display data.
-    std::lock_guard<std::mutex> lock(client->mCommandMutex);
+    // Wait for commands in flight on this display before destroying the local display data.
+    // Commands of other displays keep executing.
+    std::shared_ptr<std::mutex> display_mutex;
+    {
+      std::lock_guard<std::mutex> lock_d(client->mDisplayDataMutex);
+      auto it = client->mDisplayData.find(display);
+      if (it == client->mDisplayData.end()) {
+        return;
+      }
+      display_mutex = it->second.CommandMutex;
+    }
+
+    std::lock_guard<std::mutex> lock(*display_mutex);
     std::lock_guard<std::mutex> lock_d(client->mDisplayDataMutex);
     client->mDisplayData.erase(display);
   }
@@ -337,6 +349,10 @@ Return<void> QtiComposerClient::createLayer(uint64_t display, uint32_t bufferSlo
     if (dpy != mDisplayData.end()) {
       auto ly = dpy->second.Layers.emplace(layer, LayerBuffers()).first;
       ly->second.Buffers.resize(bufferSlotCount);
+      if (mRecorder.isActive()) {
+        mRecorder.recordEvent(QtiComposerCommandRecorder::kEntryCreateLayer, display, layer,
+                              bufferSlotCount);
+      }
     } else {
       err = Error::BAD_DISPLAY;
       // Note: We do not destroy the layer on this error as the hotplug
@@ -360,6 +376,9 @@ Return<Error> QtiComposerClient::destroyLayer(uint64_t display, uint64_t layer)
     if (dpy != mDisplayData.end()) {
       dpy->second.Layers.erase(layer);
     }
+    if (mRecorder.isActive()) {
+      mRecorder.recordEvent(QtiComposerCommandRecorder::kEntryDestroyLayer, display, layer, 0);
+    }
   }
 
   return static_cast<Error>(error);
@@ -529,6 +548,10 @@ Return<Error> QtiComposerClient::setPowerMode(uint64_t display,
                                               composer_V2_1::IComposerClient::PowerMode mode) {
   // TODO(user): Implement combinedly w.r.t setPowerMode_2_2
   auto error = hwc_session_->SetPowerMode(display, static_cast<int32_t>(mode));
+  if (mRecorder.isActive() && error == HWC2_ERROR_NONE) {
+    mRecorder.recordEvent(QtiComposerCommandRecorder::kEntryPowerMode, display,
+                          static_cast<uint64_t>(mode), 0);
+  }
 
   return static_cast<Error>(error);
 }
@@ -574,6 +597,10 @@ Return<void> QtiComposerClient::executeCommands(uint32_t inLength,
     return Void();
   }
 
+  if (mRecorder.isActive()) {
+    mRecorder.recordCommands(mReader.getData(), inLength, inHandles);
+  }
+
   Error err = mReader.parse();
   if (err == Error::NONE &&
       !mWriter.writeQueue(outChanged, outLength, outHandles)) {
@@ -697,6 +724,10 @@ Return<Error> QtiComposerClient::setPowerMode_2_2(uint64_t display,
     return Error::UNSUPPORTED;
   }
   auto error = hwc_session_->SetPowerMode(display, static_cast<int32_t>(mode));
+  if (mRecorder.isActive() && error == HWC2_ERROR_NONE) {
+    mRecorder.recordEvent(QtiComposerCommandRecorder::kEntryPowerMode, display,
+                          static_cast<uint64_t>(mode), 0);
+  }
 
   return static_cast<Error>(error);
 }
@@ -784,6 +815,10 @@ Return<void> QtiComposerClient::executeCommands_2_2(uint32_t inLength,
     return Void();
   }
 
+  if (mRecorder.isActive()) {
+    mRecorder.recordCommands(mReader.getData(), inLength, inHandles);
+  }
+
   Error err = mReader.parse();
   if (err == Error::NONE &&
       !mWriter.writeQueue(outChanged, outLength, outHandles)) {
@@ -900,6 +935,10 @@ Return<void> QtiComposerClient::executeCommands_2_3(uint32_t inLength,
     return Void();
   }
 
+  if (mRecorder.isActive()) {
+    mRecorder.recordCommands(mReader.getData(), inLength, inHandles);
+  }
+
   Error err = mReader.parse();
   if (err == Error::NONE &&
       !mWriter.writeQueue(outChanged, outLength, outHandles)) {
@@ -1154,10 +1193,8 @@ bool QtiComposerClient::CommandReader::parseCommonCmd(
   // Commands from ::android::hardware::graphics::composer::V2_1::IComposerClient follow.
   case IComposerClient::Command::SELECT_DISPLAY:
     parsed = parseSelectDisplay(length);
-    // Displays will not be removed while processing the command queue.
-    if (parsed && mClient.mDisplayData.find(mDisplay) == mClient.mDisplayData.end()) {
-      ALOGW("Command::SELECT_DISPLAY: Display %" PRId64 "not found. Dropping commands.", mDisplay);
-      mDisplay = sdm::HWCCallbacks::kNumDisplays;
+    if (parsed) {
+      lockSelectedDisplay();
     }
     break;
   case IComposerClient::Command::SELECT_LAYER:
@@ -1248,6 +1285,42 @@ bool QtiComposerClient::CommandReader::parseCommonCmd(
   return parsed;
 }
 
+void QtiComposerClient::CommandReader::lockSelectedDisplay() {
+  // Commands up to the next SELECT_DISPLAY form a sub-batch for the selected display. Sub-batches
+  // of a batch execute in queue order, each under its own display lock, so that committing one
+  // display never holds off a hotplug of another.
+  unlockSelectedDisplay();
+
+  {
+    std::lock_guard<std::mutex> lock(mClient.mDisplayDataMutex);
+    auto it = mClient.mDisplayData.find(mDisplay);
+    if (it != mClient.mDisplayData.end()) {
+      mDisplayMutex = it->second.CommandMutex;
+    }
+  }
+
+  if (mDisplayMutex) {
+    mDisplayLock = std::unique_lock<std::mutex>(*mDisplayMutex);
+    // The display may have been disconnected while waiting for its lock.
+    std::lock_guard<std::mutex> lock(mClient.mDisplayDataMutex);
+    if (mClient.mDisplayData.find(mDisplay) != mClient.mDisplayData.end()) {
+      return;
+    }
+    unlockSelectedDisplay();
+  }
+
+  ALOGW("Command::SELECT_DISPLAY: Display %" PRId64 "not found. Dropping commands.", mDisplay);
+  mDisplay = sdm::HWCCallbacks::kNumDisplays;
+}
+
+void QtiComposerClient::CommandReader::unlockSelectedDisplay() {
+  if (mDisplayLock.owns_lock()) {
+    mDisplayLock.unlock();
+  }
+  mDisplayLock = std::unique_lock<std::mutex>();
+  mDisplayMutex = nullptr;
+}
+
 Error QtiComposerClient::CommandReader::parse() {
   IQtiComposerClient::Command qticommand;
   uint16_t length;
@@ -1279,6 +1352,8 @@ Error QtiComposerClient::CommandReader::parse() {
     }
   }
 
+  unlockSelectedDisplay();
+
   return (isEmpty()) ? Error::NONE : Error::BAD_PARAMETER;
 }
 
@@ -1707,7 +1782,20 @@ bool QtiComposerClient::CommandReader::parseSetLayerSidebandStream(uint16_t leng
     return false;
   }
 
-  // Sideband stream is not supported
+  auto stream = readHandle();
+  auto error = lookupLayerSidebandStream(stream, &stream);
+  if (error == Error::NONE) {
+    auto err = mClient.hwc_session_->SetLayerSidebandStream(mDisplay, mLayer, stream);
+    error = static_cast<Error>(err);
+    auto updateErr = updateLayerSidebandStream(stream);
+    if (error == Error::NONE) {
+      error = updateErr;
+    }
+  }
+  if (error != Error::NONE) {
+    mWriter.setError(getCommandLoc(), error);
+  }
+
   return true;
 }
 
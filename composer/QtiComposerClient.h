@@ -24,12 +24,15 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <log/log.h>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 #include <string>
 
 #include "hwc_session.h"
 #include "QtiComposerCommandBuffer.h"
+#include "QtiComposerCommandRecorder.h"
 #include "QtiComposerHandleImporter.h"
 
 namespace vendor {
@@ -85,6 +88,8 @@ class BufferCacheEntry {
   buffer_handle_t mHandle;
 };
 
+extern ComposerHandleImporter mHandleImporter;
+
 class QtiComposerClient : public IQtiComposerClient {
   QtiComposerClient();
   virtual ~QtiComposerClient();
@@ -271,6 +276,10 @@ class QtiComposerClient : public IQtiComposerClient {
 
     std::unordered_map<Layer, LayerBuffers> Layers;
 
+    // Held while a command sub-batch targeting this display executes. Shared so that a
+    // disconnect can erase the entry while still holding the lock.
+    std::shared_ptr<std::mutex> CommandMutex = std::make_shared<std::mutex>();
+
     explicit DisplayData(bool isVirtual) : IsVirtual(isVirtual) {}
   };
 
@@ -323,6 +332,8 @@ class QtiComposerClient : public IQtiComposerClient {
     bool parseSetDisplayElapseTime(uint16_t length);
 
     bool parseCommonCmd(IComposerClient::Command command, uint16_t length);
+    void lockSelectedDisplay();
+    void unlockSelectedDisplay();
 
     hwc_rect_t readRect();
     std::vector<hwc_rect_t> readRegion(size_t count);
@@ -331,6 +342,8 @@ class QtiComposerClient : public IQtiComposerClient {
     CommandWriter& mWriter;
     Display mDisplay;
     Layer mLayer;
+    std::shared_ptr<std::mutex> mDisplayMutex;
+    std::unique_lock<std::mutex> mDisplayLock;
 
     // Buffer cache impl
     enum class BufferCache {
@@ -358,11 +371,13 @@ class QtiComposerClient : public IQtiComposerClient {
   sp<composer_V2_1::IComposerCallback> callback_ = nullptr;
   sp<composer_V2_4::IComposerCallback> callback24_ = nullptr;
   bool mUseCallback24_ = false;
+  // Guards the command queues; per display execution is guarded by DisplayData::CommandMutex.
   std::mutex mCommandMutex;
   // 64KiB minus a small space for metadata such as read/write pointers */
   static constexpr size_t kWriterInitialSize = 64 * 1024 / sizeof(uint32_t) - 16;
   CommandWriter mWriter;
   CommandReader mReader;
+  QtiComposerCommandRecorder mRecorder;
   std::mutex mDisplayDataMutex;
   std::unordered_map<Display, DisplayData> mDisplayData;
 };
@@ -667,7 +667,7 @@ class CommandWriter {
 // This class helps parse a command queue.  Note that all sizes/lengths are in units of uint32_t's.
 class CommandReaderBase {
  public:
-  CommandReaderBase() : mDataMaxSize(0) { reset(); }
+  CommandReaderBase() : mDataMaxSize(0), mDataReadPending(0) { reset(); }
 
   bool setMQDescriptor(const MQDescriptorSync<uint32_t>& descriptor) {
     mQueue = std::make_unique<CommandQueueType>(descriptor, false);
@@ -684,17 +684,36 @@ class CommandReaderBase {
       return false;
     }
 
-    auto quantumCount = mQueue->getQuantumCount();
-    if (mDataMaxSize < quantumCount) {
-      mDataMaxSize = quantumCount;
-      mData = std::make_unique<uint32_t[]>(mDataMaxSize);
+    if (commandLength > mQueue->getQuantumCount()) {
+      ALOGE("failed to read commands from message queue");
+      return false;
     }
 
-    if (commandLength > mDataMaxSize || !mQueue->read(mData.get(), commandLength)) {
+    // Parse in place when the commands are contiguous in the queue. The read is committed in
+    // reset(), the remote writer does not reuse the region before executeCommands returns.
+    CommandQueueType::MemTransaction tx;
+    if (!mQueue->beginRead(commandLength, &tx)) {
       ALOGE("failed to read commands from message queue");
       return false;
     }
 
+    auto first = tx.getFirstRegion();
+    auto second = tx.getSecondRegion();
+    if (first.getLength() >= commandLength) {
+      mData = first.getAddress();
+    } else {
+      // The commands wrap around the end of the queue, stitch both regions together.
+      if (mDataMaxSize < commandLength) {
+        mDataMaxSize = static_cast<uint32_t>(mQueue->getQuantumCount());
+        mDataCopy = std::make_unique<uint32_t[]>(mDataMaxSize);
+      }
+      std::copy_n(first.getAddress(), first.getLength(), mDataCopy.get());
+      std::copy_n(second.getAddress(), commandLength - first.getLength(),
+                  mDataCopy.get() + first.getLength());
+      mData = mDataCopy.get();
+    }
+
+    mDataReadPending = commandLength;
     mDataSize = commandLength;
     mDataRead = 0;
     mCommandBegin = 0;
@@ -706,6 +725,11 @@ class CommandReaderBase {
   }
 
   void reset() {
+    if (mQueue && mDataReadPending) {
+      mQueue->commitRead(mDataReadPending);
+    }
+    mDataReadPending = 0;
+    mData = nullptr;
     mDataSize = 0;
     mDataRead = 0;
     mCommandBegin = 0;
@@ -713,6 +737,9 @@ class CommandReaderBase {
     mDataHandles.setToExternal(nullptr, 0);
   }
 
+  // Commands of the batch read by readQueue, valid until reset().
+  const uint32_t* getData() const { return mData; }
+
  protected:
   bool isEmpty() const { return (mDataRead >= mDataSize); }
 
@@ -847,8 +874,12 @@ class CommandReaderBase {
 
  private:
   std::unique_ptr<CommandQueueType> mQueue;
+  // Commands being parsed, either in the queue itself or in mDataCopy when they wrap around.
+  const uint32_t* mData;
   uint32_t mDataMaxSize;
-  std::unique_ptr<uint32_t[]> mData;
+  std::unique_ptr<uint32_t[]> mDataCopy;
+  // Length of the in-flight queue read, committed on reset().
+  uint32_t mDataReadPending;
 
   uint32_t mDataSize;
   uint32_t mDataRead;
@@ -0,0 +1,186 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <gralloc_priv.h>
+#include <limits.h>
+#include <log/log.h>
+#include <string.h>
+#include <display_properties.h>
+#include <utils/frame_timing.h>
+
+#include "QtiComposerCommandRecorder.h"
+#include "hwc_debugger.h"
+
+namespace vendor {
+namespace qti {
+namespace hardware {
+namespace display {
+namespace composer {
+namespace V3_0 {
+namespace implementation {
+
+static_assert(sizeof(QtiComposerCommandRecorder::EntryHeader) == 40, "file layout changed");
+static_assert(sizeof(QtiComposerCommandRecorder::HandleRecord) == 40, "file layout changed");
+
+QtiComposerCommandRecorder::~QtiComposerCommandRecorder() {
+  close();
+}
+
+void QtiComposerCommandRecorder::init() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  sdm::HWCDebugHandler::Get()->GetProperty(COMMAND_RECORD_BATCHES_PROP, &mBatchesLeft);
+  if (mBatchesLeft <= 0) {
+    mBatchesLeft = 0;
+    return;
+  }
+
+  char file_path[PATH_MAX];
+  snprintf(file_path, sizeof(file_path), "%s/composer_commands.bin",
+           sdm::HWCDebugHandler::DumpDir());
+  mFile = fopen(file_path, "w");
+  FileHeader header;
+  if (!mFile || fwrite(&header, sizeof(header), 1, mFile) != 1) {
+    ALOGW("Failed to open %s errno = %d, desc = %s", file_path, errno, strerror(errno));
+    close();
+    return;
+  }
+
+  ALOGI("Recording %d command batches to %s", mBatchesLeft, file_path);
+  mActive = true;
+}
+
+void QtiComposerCommandRecorder::recordCommands(const uint32_t* data, uint32_t length,
+                                                const hidl_vec<hidl_handle>& handles) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (!mFile) {
+    return;
+  }
+
+  mHandles.assign(handles.size(), HandleRecord());
+  for (size_t i = 0; i < handles.size(); i++) {
+    const native_handle_t* handle = handles[i].getNativeHandle();
+    HandleRecord& record = mHandles[i];
+    if (!handle) {
+      continue;
+    }
+
+    if (private_handle_t::validate(handle) == 0) {
+      auto hnd = static_cast<const private_handle_t*>(handle);
+      record.type = kHandleBuffer;
+      record.width = hnd->unaligned_width;
+      record.height = hnd->unaligned_height;
+      record.format = hnd->format;
+      record.flags = hnd->flags;
+      record.size = hnd->size;
+      record.usage = hnd->usage;
+      record.id = hnd->id;
+    } else if (handle->numFds == 1 && handle->numInts == 0) {
+      record.type = kHandleFence;
+    } else {
+      record.type = kHandleOther;
+    }
+  }
+
+  EntryHeader header;
+  header.type = kEntryCommands;
+  header.length = length;
+  header.handleCount = static_cast<uint32_t>(mHandles.size());
+  write(header, data);
+  if (mFile && --mBatchesLeft == 0) {
+    close();
+  }
+}
+
+void QtiComposerCommandRecorder::recordEvent(EntryType type, uint64_t display, uint64_t arg,
+                                             uint32_t slotCount) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (!mFile) {
+    return;
+  }
+
+  EntryHeader header;
+  header.type = type;
+  header.display = display;
+  header.arg = arg;
+  header.slotCount = slotCount;
+  mHandles.clear();
+  write(header, nullptr);
+}
+
+void QtiComposerCommandRecorder::write(const EntryHeader& entry, const uint32_t* data) {
+  EntryHeader header = entry;
+  header.timestampNs = sdm::FrameTiming::Now();
+  if (fwrite(&header, sizeof(header), 1, mFile) != 1 ||
+      (header.length && fwrite(data, sizeof(uint32_t), header.length, mFile) != header.length) ||
+      (header.handleCount &&
+       fwrite(mHandles.data(), sizeof(HandleRecord), header.handleCount, mFile) !=
+       header.handleCount)) {
+    ALOGW("Failed to record command entry errno = %d, desc = %s", errno, strerror(errno));
+    close();
+  }
+}
+
+void QtiComposerCommandRecorder::close() {
+  if (mFile) {
+    fclose(mFile);
+    mFile = nullptr;
+  }
+  mActive = false;
+  mBatchesLeft = 0;
+  mHandles = {};
+}
+
+bool QtiComposerCommandRecorder::readHeader(FILE* file) {
+  FileHeader header;
+  return fread(&header, sizeof(header), 1, file) == 1 && header.magic == kMagic &&
+         header.version == kVersion;
+}
+
+bool QtiComposerCommandRecorder::readEntry(FILE* file, EntryHeader* header,
+                                           std::vector<uint32_t>* data,
+                                           std::vector<HandleRecord>* handles) {
+  if (fread(header, sizeof(*header), 1, file) != 1 || header->length > kMaxEntryLength ||
+      header->handleCount > kMaxEntryLength) {
+    return false;
+  }
+
+  data->resize(header->length);
+  handles->resize(header->handleCount);
+  return fread(data->data(), sizeof(uint32_t), data->size(), file) == data->size() &&
+         fread(handles->data(), sizeof(HandleRecord), handles->size(), file) == handles->size();
+}
+
+}  // namespace implementation
+}  // namespace V3_0
+}  // namespace composer
+}  // namespace display
+}  // namespace hardware
+}  // namespace qti
+}  // namespace vendor
@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __QTICOMPOSERCOMMANDRECORDER_H__
+#define __QTICOMPOSERCOMMANDRECORDER_H__
+
+#include <hidl/HidlSupport.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace vendor {
+namespace qti {
+namespace hardware {
+namespace display {
+namespace composer {
+namespace V3_0 {
+namespace implementation {
+
+using ::android::hardware::hidl_handle;
+using ::android::hardware::hidl_vec;
+
+// Records the command batches handed to executeCommands, for composer_command_replay.
+// vendor.display.command_record_batches sets the number of batches to record to
+// /data/vendor/display/composer_commands.bin from client creation on; while it is unset a call
+// costs a single check. A batch is stored as the raw command words followed by one record per
+// handle. Buffers are described by their gralloc metadata, never their contents, and fences only
+// by their presence. Layer lifetime and power mode calls, which the commands depend on but which
+// are not part of the command stream, are recorded as events in between.
+class QtiComposerCommandRecorder {
+ public:
+  static constexpr uint32_t kMagic = 0x52434351;  // "QCCR"
+  static constexpr uint32_t kVersion = 1;
+  // Bounds an entry read back from a corrupt file, well above any command queue size.
+  static constexpr uint32_t kMaxEntryLength = 1 << 24;
+
+  enum EntryType : uint32_t {
+    kEntryCommands,
+    kEntryCreateLayer,   // arg is the layer, slotCount its buffer slots
+    kEntryDestroyLayer,  // arg is the layer
+    kEntryPowerMode,     // arg is the power mode
+  };
+
+  enum HandleType : uint32_t {
+    kHandleNone,
+    kHandleFence,
+    kHandleBuffer,
+    kHandleOther,
+  };
+
+  struct FileHeader {
+    uint32_t magic = kMagic;
+    uint32_t version = kVersion;
+  };
+
+  struct EntryHeader {
+    uint64_t timestampNs = 0;
+    uint64_t display = 0;
+    uint64_t arg = 0;
+    uint32_t type = kEntryCommands;
+    uint32_t length = 0;
+    uint32_t handleCount = 0;
+    uint32_t slotCount = 0;
+  };
+
+  struct HandleRecord {
+    uint32_t type = kHandleNone;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t format = 0;
+    int32_t flags = 0;
+    uint32_t size = 0;
+    uint64_t usage = 0;
+    uint64_t id = 0;
+  };
+
+  ~QtiComposerCommandRecorder();
+  void init();
+  bool isActive() const { return mActive.load(std::memory_order_relaxed); }
+  // Called after the batch was read from the command queue, before it is parsed.
+  void recordCommands(const uint32_t* data, uint32_t length, const hidl_vec<hidl_handle>& handles);
+  void recordEvent(EntryType type, uint64_t display, uint64_t arg, uint32_t slotCount);
+
+  static bool readHeader(FILE* file);
+  static bool readEntry(FILE* file, EntryHeader* header, std::vector<uint32_t>* data,
+                        std::vector<HandleRecord>* handles);
+
+ private:
+  void write(const EntryHeader& header, const uint32_t* data);
+  void close();
+
+  std::mutex mMutex;
+  std::atomic<bool> mActive{false};
+  int mBatchesLeft = 0;
+  FILE* mFile = nullptr;
+  std::vector<HandleRecord> mHandles;
+};
+
+}  // namespace implementation
+}  // namespace V3_0
+}  // namespace composer
+}  // namespace display
+}  // namespace hardware
+}  // namespace qti
+}  // namespace vendor
+
+#endif  // __QTICOMPOSERCOMMANDRECORDER_H__
@@ -0,0 +1,368 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Replays a command recording of QtiComposerClient (vendor.display.command_record_batches)
+// through executeCommands into HWCSession and reports the cost of each batch. Recorded buffers
+// are replaced by stub gralloc buffers of the same size and format, allocated once per buffer id,
+// and fences by signaled ones. Layers are created again as recorded and the layer ids in the
+// commands are remapped to the new ones. HWCSession drives the real displays, so the composer
+// service has to be stopped first, unless it runs in null display mode.
+//
+// Usage: composer_command_replay <command record> [iterations] [--paced]
+
+#include <binder/ProcessState.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utils/constants.h>
+#include <utils/frame_timing.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "QtiComposerClient.h"
+#include "QtiComposerCommandRecorder.h"
+#include "hwc_buffer_allocator.h"
+#include "hwc_layers.h"
+
+namespace vendor {
+namespace qti {
+namespace hardware {
+namespace display {
+namespace composer {
+namespace V3_0 {
+namespace implementation {
+
+using Recorder = QtiComposerCommandRecorder;
+
+struct ReplayEntry {
+  Recorder::EntryHeader header;
+  std::vector<uint32_t> data;
+  std::vector<Recorder::HandleRecord> handles;
+};
+
+// Hotplug is what populates the display data of the client, the events themselves are dropped.
+class ReplayCallback : public composer_V2_1::IComposerCallback {
+ public:
+  Return<void> onHotplug(uint64_t, composer_V2_1::IComposerCallback::Connection) override {
+    return Void();
+  }
+  Return<void> onRefresh(uint64_t) override { return Void(); }
+  Return<void> onVsync(uint64_t, int64_t) override { return Void(); }
+};
+
+class CommandReplay {
+ public:
+  ~CommandReplay();
+  int Run(const char *record_path, uint32_t iterations, bool paced);
+
+ private:
+  bool Load(const char *record_path);
+  int Replay(uint32_t iterations, bool paced);
+  void ReplayEvent(const Recorder::EntryHeader &header);
+  bool ReplayCommands(ReplayEntry *entry);
+  void RemapLayers(std::vector<uint32_t> *data);
+  buffer_handle_t GetStubBuffer(const Recorder::HandleRecord &record);
+  void DestroyLayers();
+
+  std::vector<ReplayEntry> entries_;
+  sp<QtiComposerClient> client_;
+  std::unique_ptr<CommandQueueType> input_queue_;
+  std::unique_ptr<CommandQueueType> output_queue_;
+  std::vector<uint32_t> output_;
+  // Recorded layer id to the one created by the replay, with the display owning it.
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> layers_;
+  sdm::HWCBufferAllocator buffer_allocator_;
+  std::map<uint64_t, sdm::BufferInfo> buffers_;
+};
+
+CommandReplay::~CommandReplay() {
+  for (auto &buffer : buffers_) {
+    buffer_allocator_.FreeBuffer(&buffer.second);
+  }
+}
+
+bool CommandReplay::Load(const char *record_path) {
+  FILE *file = fopen(record_path, "r");
+  if (!file) {
+    fprintf(stderr, "Unable to open %s: %s\n", record_path, strerror(errno));
+    return false;
+  }
+
+  if (!Recorder::readHeader(file)) {
+    fprintf(stderr, "%s is not a command recording\n", record_path);
+    fclose(file);
+    return false;
+  }
+
+  while (true) {
+    ReplayEntry entry;
+    if (!Recorder::readEntry(file, &entry.header, &entry.data, &entry.handles)) {
+      break;
+    }
+    entries_.push_back(std::move(entry));
+  }
+  fclose(file);
+
+  return !entries_.empty();
+}
+
+buffer_handle_t CommandReplay::GetStubBuffer(const Recorder::HandleRecord &record) {
+  auto iter = buffers_.find(record.id);
+  if (iter != buffers_.end()) {
+    return reinterpret_cast<buffer_handle_t>(iter->second.private_data);
+  }
+
+  sdm::BufferInfo buffer_info;
+  buffer_info.buffer_config.width = UINT32(std::max(1, record.width));
+  buffer_info.buffer_config.height = UINT32(std::max(1, record.height));
+  buffer_info.buffer_config.format = sdm::HWCLayer::GetSDMFormat(record.format, record.flags);
+  buffer_info.buffer_config.buffer_count = 1;
+  if (buffer_allocator_.AllocateBuffer(&buffer_info) != sdm::kErrorNone) {
+    buffer_info.buffer_config.format = sdm::kFormatRGBA8888;
+    if (buffer_allocator_.AllocateBuffer(&buffer_info) != sdm::kErrorNone) {
+      return nullptr;
+    }
+  }
+
+  buffers_[record.id] = buffer_info;
+  return reinterpret_cast<buffer_handle_t>(buffer_info.private_data);
+}
+
+void CommandReplay::ReplayEvent(const Recorder::EntryHeader &header) {
+  switch (header.type) {
+  case Recorder::kEntryCreateLayer:
+    client_->createLayer(header.display, header.slotCount, [&](Error err, uint64_t layer) {
+      if (err == Error::NONE) {
+        layers_[header.arg] = std::make_pair(header.display, layer);
+      }
+    });
+    break;
+  case Recorder::kEntryDestroyLayer: {
+    auto iter = layers_.find(header.arg);
+    if (iter != layers_.end()) {
+      client_->destroyLayer(iter->second.first, iter->second.second);
+      layers_.erase(iter);
+    }
+    break;
+  }
+  case Recorder::kEntryPowerMode:
+    client_->setPowerMode_2_2(header.display,
+                              static_cast<composer_V2_2::IComposerClient::PowerMode>(header.arg));
+    break;
+  default:
+    break;
+  }
+}
+
+void CommandReplay::RemapLayers(std::vector<uint32_t> *data) {
+  constexpr uint32_t opcode_mask = static_cast<uint32_t>(IQtiComposerClient::Command::OPCODE_MASK);
+  constexpr uint32_t length_mask = static_cast<uint32_t>(IQtiComposerClient::Command::LENGTH_MASK);
+  constexpr uint32_t select_layer =
+    static_cast<uint32_t>(IQtiComposerClient::Command::SELECT_LAYER);
+
+  for (size_t i = 0; i < data->size(); i += ((*data)[i] & length_mask) + 1) {
+    if (((*data)[i] & opcode_mask) != select_layer || i + 2 >= data->size()) {
+      continue;
+    }
+
+    uint64_t layer = (UINT64((*data)[i + 2]) << 32) | (*data)[i + 1];
+    auto iter = layers_.find(layer);
+    if (iter != layers_.end()) {
+      (*data)[i + 1] = UINT32(iter->second.second);
+      (*data)[i + 2] = UINT32(iter->second.second >> 32);
+    }
+  }
+}
+
+bool CommandReplay::ReplayCommands(ReplayEntry *entry) {
+  RemapLayers(&entry->data);
+
+  hidl_vec<hidl_handle> handles(entry->handles.size());
+  for (size_t i = 0; i < entry->handles.size(); i++) {
+    if (entry->handles[i].type == Recorder::kHandleBuffer) {
+      handles[i] = hidl_handle(GetStubBuffer(entry->handles[i]));
+    }
+  }
+
+  if (!input_queue_->write(entry->data.data(), entry->data.size())) {
+    return false;
+  }
+
+  Error error = Error::NONE;
+  client_->executeCommands_2_3(UINT32(entry->data.size()), handles,
+                               [&](Error err, bool out_changed, uint32_t out_length,
+                                   const hidl_vec<hidl_handle> &) {
+    error = err;
+    // Drain the results as the client side reader would, or they go stale in the queue.
+    if (out_changed || !output_queue_) {
+      client_->getOutputCommandQueue([&](Error queue_err,
+                                         const MQDescriptorSync<uint32_t> &desc) {
+        if (queue_err == Error::NONE) {
+          output_queue_.reset(new CommandQueueType(desc));
+        }
+      });
+    }
+    if (output_queue_ && out_length) {
+      output_.resize(out_length);
+      output_queue_->read(output_.data(), out_length);
+    }
+  });
+
+  return error == Error::NONE;
+}
+
+void CommandReplay::DestroyLayers() {
+  if (client_ != nullptr) {
+    for (auto &layer : layers_) {
+      client_->destroyLayer(layer.second.first, layer.second.second);
+    }
+  }
+  layers_.clear();
+}
+
+int CommandReplay::Run(const char *record_path, uint32_t iterations, bool paced) {
+  if (!Load(record_path)) {
+    fprintf(stderr, "No command batches in %s\n", record_path);
+    return -1;
+  }
+
+  if (HWCSession::GetInstance()->Init()) {
+    fprintf(stderr, "Unable to initialize the composer\n");
+    return -1;
+  }
+
+  int ret = -1;
+  client_ = QtiComposerClient::CreateQtiComposerClientInstance();
+  if (client_ != nullptr) {
+    client_->registerCallback(new ReplayCallback());
+    ret = Replay(iterations, paced);
+    DestroyLayers();
+    client_ = nullptr;
+  } else {
+    fprintf(stderr, "Unable to create the composer client\n");
+  }
+  HWCSession::GetInstance()->Deinit();
+
+  return ret;
+}
+
+int CommandReplay::Replay(uint32_t iterations, bool paced) {
+  size_t max_length = 1;
+  for (auto &entry : entries_) {
+    max_length = std::max(max_length, entry.data.size());
+  }
+  input_queue_.reset(new CommandQueueType(max_length, false));
+  if (client_->setInputCommandQueue(*input_queue_->getDesc()) != Error::NONE) {
+    fprintf(stderr, "Unable to set up the command queue\n");
+    return -1;
+  }
+
+  uint32_t batch_count = 0;
+  uint32_t failed_count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    uint64_t first_ns = entries_.front().header.timestampNs;
+    uint64_t start_ns = sdm::FrameTiming::Now();
+    for (auto &entry : entries_) {
+      if (paced) {
+        uint64_t due_ns = start_ns + (entry.header.timestampNs - first_ns);
+        struct timespec due = {};
+        due.tv_sec = time_t(due_ns / 1000000000ULL);
+        due.tv_nsec = long(due_ns % 1000000000ULL);  // NOLINT
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr);
+      }
+
+      if (entry.header.type != Recorder::kEntryCommands) {
+        ReplayEvent(entry.header);
+        continue;
+      }
+
+      uint64_t batch_start_ns = sdm::FrameTiming::Now();
+      bool success = ReplayCommands(&entry);
+      uint64_t batch_ns = sdm::FrameTiming::Now() - batch_start_ns;
+      total_ns += batch_ns;
+      max_ns = std::max(max_ns, batch_ns);
+      batch_count++;
+      failed_count += !success;
+    }
+    DestroyLayers();
+  }
+
+  if (!batch_count) {
+    fprintf(stderr, "No command batches in the recording\n");
+    return -1;
+  }
+
+  printf("%zu entries x %u iterations, %u batches, %u failed, %zu stub buffers, %s\n",
+         entries_.size(), iterations, batch_count, failed_count, buffers_.size(),
+         paced ? "paced" : "back to back");
+  printf("%14s %14s\n", "ns/batch", "max ns");
+  printf("%14" PRIu64 " %14" PRIu64 "\n", total_ns / batch_count, max_ns);
+
+  return 0;
+}
+
+}  // namespace implementation
+}  // namespace V3_0
+}  // namespace composer
+}  // namespace display
+}  // namespace hardware
+}  // namespace qti
+}  // namespace vendor
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <command record> [iterations] [--paced]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t iterations = 1;
+  bool paced = false;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--paced")) {
+      paced = true;
+    } else {
+      iterations = UINT32(std::max(1, atoi(argv[i])));
+    }
+  }
+
+  // HWCSession talks to the display services over vndbinder, as in the composer service.
+  android::ProcessState::initWithDriver("/dev/vndbinder");
+  android::ProcessState::self()->startThreadPool();
+
+  vendor::qti::hardware::display::composer::V3_0::implementation::CommandReplay replay;
+  return (replay.Run(argv[1], iterations, paced) == 0) ? 0 : 1;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2019-2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright (C) 2017 The Android Open Source Project
@@ -17,6 +17,7 @@
  * limitations under the License.
  */
 
+#include <gralloc_priv.h>
 #include <log/log.h>
 
 #include "QtiComposerHandleImporter.h"
@@ -84,6 +85,19 @@ bool ComposerHandleImporter::importBuffer(buffer_handle_t& handle) {
     return false;
   }
 
+  bool cacheable = (private_handle_t::validate(handle) == 0);
+  uint64_t id = cacheable ? static_cast<const private_handle_t *>(handle)->id : 0;
+  if (cacheable) {
+    auto it = mImportedBuffers.find(id);
+    if (it != mImportedBuffers.end()) {
+      it->second.ref_count++;
+      handle = it->second.handle;
+      mImportHits++;
+      return true;
+    }
+  }
+  mImportMisses++;
+
   if (mMapper_V3 != nullptr) {
     MapperV3Error error;
     buffer_handle_t importedHandle;
@@ -128,6 +142,11 @@ bool ComposerHandleImporter::importBuffer(buffer_handle_t& handle) {
     handle = importedHandle;
   }
 
+  if (cacheable) {
+    mImportedBuffers[id] = {handle, 1};
+    mImportedIds[handle] = id;
+  }
+
   return true;
 }
 
@@ -138,6 +157,18 @@ void ComposerHandleImporter::freeBuffer(buffer_handle_t handle) {
 
   Mutex::Autolock lock(mLock);
 
+  auto id = mImportedIds.find(handle);
+  if (id != mImportedIds.end()) {
+    auto it = mImportedBuffers.find(id->second);
+    if (it != mImportedBuffers.end() && --it->second.ref_count) {
+      return;
+    }
+    if (it != mImportedBuffers.end()) {
+      mImportedBuffers.erase(it);
+    }
+    mImportedIds.erase(id);
+  }
+
   if (mMapper_V3 == nullptr && mMapper_V2 == nullptr) {
     ALOGE("%s: mMapper is null!", __FUNCTION__);
     return;
@@ -155,6 +186,12 @@ void ComposerHandleImporter::freeBuffer(buffer_handle_t handle) {
   }
 }
 
+void ComposerHandleImporter::dump(std::ostringstream *os) {
+  Mutex::Autolock lock(mLock);
+  *os << "Buffer imports: hits " << mImportHits << " misses " << mImportMisses
+      << " live " << mImportedBuffers.size() << std::endl;
+}
+
 }  // namespace V3_0
 }  // namespace composer
 }  // namespace display
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2019-2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright (C) 2017 The Android Open Source Project
@@ -23,6 +23,8 @@
 #include <android/hardware/graphics/mapper/2.0/IMapper.h>
 #include <android/hardware/graphics/mapper/3.0/IMapper.h>
 #include <utils/Mutex.h>
+#include <sstream>
+#include <unordered_map>
 
 namespace vendor {
 namespace qti {
@@ -48,9 +50,20 @@ class ComposerHandleImporter {
   void freeBuffer(buffer_handle_t handle);
   void initialize();
   void cleanup();
+  void dump(std::ostringstream *os);
 
  private:
+  // A gralloc buffer already imported under another slot is shared instead of re-imported.
+  struct ImportedBuffer {
+    buffer_handle_t handle = nullptr;
+    uint32_t ref_count = 0;
+  };
+
   Mutex mLock;
+  std::unordered_map<uint64_t, ImportedBuffer> mImportedBuffers;  // gralloc buffer id -> import
+  std::unordered_map<buffer_handle_t, uint64_t> mImportedIds;
+  uint64_t mImportHits = 0;
+  uint64_t mImportMisses = 0;
   bool mInitialized = false;
   sp<IMapperV2> mMapper_V2;
   sp<IMapperV3> mMapper_V3;
@@ -29,7 +29,11 @@
 
 #include <cutils/properties.h>
 #include <dlfcn.h>
+#include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
+
+#include <algorithm>
 
 #include "cpuhint.h"
 #include "hwc_debugger.h"
@@ -45,16 +49,22 @@ DisplayError CPUHint::Init(HWCDebugHandler *debug_handler) {
     return kErrorNotSupported;
   }
 
+  int closed_loop = 0;
+  debug_handler->GetProperty(ENABLE_PERF_HINT_FEEDBACK_PROP, &closed_loop);
+  closed_loop_ = (closed_loop == 1);
+
   int pre_enable_window = -1;
   debug_handler->GetProperty(PERF_HINT_WINDOW_PROP, &pre_enable_window);
-  if (pre_enable_window <= 0) {
+  if (closed_loop_) {
+    DLOGI("CPU Hint driven by composer frame time");
+  } else if (pre_enable_window <= 0) {
     DLOGI("Invalid CPU Hint Pre-enable Window %d", pre_enable_window);
     return kErrorNotSupported;
+  } else {
+    DLOGI("CPU Hint Pre-enable Window %d", pre_enable_window);
+    pre_enable_window_ = pre_enable_window;
   }
 
-  DLOGI("CPU Hint Pre-enable Window %d", pre_enable_window);
-  pre_enable_window_ = pre_enable_window;
-
   if (vendor_ext_lib_.Open(path)) {
     if (!vendor_ext_lib_.Sym("perf_lock_acq", reinterpret_cast<void **>(&fn_lock_acquire_)) ||
         !vendor_ext_lib_.Sym("perf_lock_rel", reinterpret_cast<void **>(&fn_lock_release_))) {
@@ -105,4 +115,81 @@ void CPUHint::Reset() {
   lock_acquired_ = false;
 }
 
+void CPUHint::Update(uint64_t frame_ns, uint64_t deadline_ns) {
+  if (!enabled_ || !closed_loop_ || !deadline_ns) {
+    return;
+  }
+
+  uint64_t now = FrameTiming::Now();
+  if (!first_frame_ns_) {
+    first_frame_ns_ = now;
+  }
+  frames_++;
+
+  if (lock_acquired_ && now >= lock_expiry_ns_) {
+    AccountBoost(now);
+    lock_acquired_ = false;
+  }
+
+  // Boost above 3/4 of the deadline and release below 1/2 of it, hold in between.
+  if ((frame_ns * 4) > (deadline_ns * 3)) {
+    relax_frames_ = 0;
+    Acquire(now);
+  } else if (lock_acquired_ && ((frame_ns * 2) < deadline_ns) &&
+             (++relax_frames_ >= kRelaxFrames)) {
+    Release(now);
+  }
+
+  if (lock_acquired_) {
+    boosted_frames_++;
+  }
+}
+
+void CPUHint::Acquire(uint64_t now_ns) {
+  // Passing the handle of a held lock renews it.
+  int hint = HINT;
+  int handle = fn_lock_acquire_(lock_acquired_ ? lock_handle_ : 0, kBoostDurationMs,
+                                &hint, sizeof(hint) / sizeof(int));
+  if (handle < 0) {
+    return;
+  }
+
+  if (lock_acquired_) {
+    AccountBoost(now_ns);
+  } else {
+    acquisitions_++;
+  }
+  lock_handle_ = handle;
+  lock_acquired_ = true;
+  lock_start_ns_ = now_ns;
+  lock_expiry_ns_ = now_ns + (UINT64(kBoostDurationMs) * 1000000);
+}
+
+void CPUHint::Release(uint64_t now_ns) {
+  fn_lock_release_(lock_handle_);
+  AccountBoost(now_ns);
+  lock_acquired_ = false;
+  relax_frames_ = 0;
+}
+
+void CPUHint::AccountBoost(uint64_t now_ns) {
+  boosted_ns_ += std::min(now_ns, lock_expiry_ns_) - lock_start_ns_;
+}
+
+void CPUHint::Dump(std::ostringstream *os) {
+  if (!enabled_ || !closed_loop_ || !frames_) {
+    return;
+  }
+
+  uint64_t now = FrameTiming::Now();
+  uint64_t boosted_ns = boosted_ns_;
+  if (lock_acquired_) {
+    boosted_ns += std::min(now, lock_expiry_ns_) - lock_start_ns_;
+  }
+  uint64_t elapsed_ns = std::max(now - first_frame_ns_, UINT64(1));
+
+  *os << "CPU hint: frames: " << frames_ << " boosted: " << boosted_frames_ << " acquisitions: "
+      << acquisitions_ << " duty cycle: " << (boosted_ns * 100 / elapsed_ns) << "%" << std::endl;
+}
+
 }  // namespace sdm
@@ -33,6 +33,8 @@
 #include <core/sdm_types.h>
 #include <utils/sys.h>
 
+#include <sstream>
+
 namespace sdm {
 
 class HWCDebugHandler;
@@ -42,15 +44,37 @@ class CPUHint {
   DisplayError Init(HWCDebugHandler *debug_handler);
   void Set();
   void Reset();
+  // Closed loop hinting, driven by the measured composer time of each frame instead of Set/Reset.
+  bool IsClosedLoop() const { return closed_loop_; }
+  void Update(uint64_t frame_ns, uint64_t deadline_ns);
+  void Dump(std::ostringstream *os);
 
  private:
   enum { HINT =  0x4501 /* 45-display layer hint, 01-Enable */ };
+  // Lock is renewed every frame at risk, so it lapses on its own when frames stop coming.
+  static const int kBoostDurationMs = 100;
+  // Frames below the release threshold before the lock is dropped ahead of its expiry.
+  static const uint32_t kRelaxFrames = 3;
+
+  void Acquire(uint64_t now_ns);
+  void Release(uint64_t now_ns);
+  void AccountBoost(uint64_t now_ns);
+
   bool enabled_ = false;
+  bool closed_loop_ = false;
   // frames to wait before setting this hint
   int pre_enable_window_ = 0;
   int frame_countdown_ = 0;
   int lock_handle_ = 0;
   bool lock_acquired_ = false;
+  uint64_t lock_start_ns_ = 0;
+  uint64_t lock_expiry_ns_ = 0;
+  uint32_t relax_frames_ = 0;
+  uint64_t first_frame_ns_ = 0;
+  uint64_t frames_ = 0;
+  uint64_t boosted_frames_ = 0;
+  uint64_t boosted_ns_ = 0;
+  uint64_t acquisitions_ = 0;
   DynLib vendor_ext_lib_;
   int (*fn_lock_acquire_)(int handle, int duration, int *hints, int num_args) = NULL;
   int (*fn_lock_release_)(int value) = NULL;
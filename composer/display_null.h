@@ -61,10 +61,13 @@ class DisplayNull : public DisplayInterface {
   virtual DisplayError GetDisplayIdentificationData(uint8_t *out_port, uint32_t *out_data_size,
                                                     uint8_t *out_data);
   virtual bool CheckResourceState() { return false; }
-  virtual string Dump() { return ""; }
+  virtual string Dump(DumpLevel level = kDumpLevelFull) { return ""; }
   virtual bool IsSupportSsppTonemap() { return false; }
   virtual bool CanSkipValidate() { return true; }
   virtual bool GameEnhanceSupported() { return false; }
+  virtual DisplayError GetPredictedVSync(int64_t *next_vsync_ns, int64_t *vsync_period_ns) {
+    return kErrorNotSupported;
+  }
 
   MAKE_NO_OP(TeardownConcurrentWriteback(void))
   MAKE_NO_OP(Commit(LayerStack *))
@@ -114,6 +117,7 @@ class DisplayNull : public DisplayInterface {
   MAKE_NO_OP(SetDynamicDSIClock(uint64_t bit_clk_rate))
   MAKE_NO_OP(GetDynamicDSIClock(uint64_t *bit_clk_rate))
   MAKE_NO_OP(GetSupportedDSIClock(vector<uint64_t> *bitclk_rates))
+  MAKE_NO_OP(SetDSIClockConstraints(const vector<uint64_t> &avoided_rates))
   MAKE_NO_OP(SetFrameTriggerMode(FrameTriggerMode))
   MAKE_NO_OP(SetPanelLuminanceAttributes(float min_lum, float max_lum))
   MAKE_NO_OP(SetBLScale(uint32_t))
@@ -121,6 +125,8 @@ class DisplayNull : public DisplayInterface {
   MAKE_NO_OP(colorSamplingOn());
   MAKE_NO_OP(colorSamplingOff());
   MAKE_NO_OP(SetDisplayElapseTime(uint64_t))
+  MAKE_NO_OP(PrefetchFbId(Layer *))
+  MAKE_NO_OP(SetExpectedPresentTime(uint64_t))
 
  protected:
   DisplayConfigVariableInfo default_variable_config_ = {};
@@ -170,16 +170,19 @@ int GLColorConvertImpl::Blit(const private_handle_t *src_hnd, const private_hand
   SetDestinationBuffer(dst_hnd);
   SetViewport(dst_rect);
 
+  // The GPU waits on the acquire fences, the caller never does. They must be queued ahead of the
+  // draw for it to be ordered after them.
+  std::vector<shared_ptr<Fence>> in_fence = {src_acquire_fence, dst_acquire_fence};
+  WaitOnInputFence(in_fence);
+
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, kFullScreenVertices);
   glEnableVertexAttribArray(1);
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, kFullScreenTexCoords);
   glDrawArrays(GL_TRIANGLES, 0, 3);
 
-  std::vector<shared_ptr<Fence>> in_fence = {Fence::Merge(src_acquire_fence, dst_acquire_fence)};
-  WaitOnInputFence(in_fence);
-
-  // Create output fence for client to wait on.
+  // Native fence of the draw, returned right after the flush and handed to the client as the
+  // output buffer's fence. Nothing here waits for the GPU to complete.
   CreateOutputFence(release_fence);
 
   return 0;
@@ -204,6 +207,9 @@ GLColorConvertImpl::GLColorConvertImpl(GLRenderTarget target, bool secure) {
 }
 
 void GLColorConvertImpl::Reset() {
+  // Cached EGL images own GL objects of this context, which may not be the current one on the
+  // shared GPU worker thread.
+  MakeCurrent(&ctx_);
   ClearCache();
 }
 
@@ -38,31 +38,8 @@ namespace sdm {
 
 GLuint GLCommon::LoadProgram(int vertex_entries, const char **vertex, int fragment_entries,
                            const char **fragment) {
-  GLuint prog_id = glCreateProgram();
-
-  int vert_id = glCreateShader(GL_VERTEX_SHADER);
-  int frag_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-  GL(glShaderSource(vert_id, vertex_entries, vertex, 0));
-  GL(glCompileShader(vert_id));
-  DumpShaderLog(vert_id);
-
-  GL(glShaderSource(frag_id, fragment_entries, fragment, 0));
-  GL(glCompileShader(frag_id));
-  DumpShaderLog(frag_id);
-
-  GL(glAttachShader(prog_id, vert_id));
-  GL(glAttachShader(prog_id, frag_id));
-
-  GL(glLinkProgram(prog_id));
-
-  GL(glDetachShader(prog_id, vert_id));
-  GL(glDetachShader(prog_id, frag_id));
-
-  GL(glDeleteShader(vert_id));
-  GL(glDeleteShader(frag_id));
-
-  return prog_id;
+  // Shares the tonemapper's loader, which serves linked programs from the program binary cache.
+  return engine_loadProgram(vertex_entries, vertex, fragment_entries, fragment);
 }
 
 void GLCommon::DumpShaderLog(int shader) {
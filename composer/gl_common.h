@@ -36,6 +36,7 @@
 #include <string>
 
 #include "glengine.h"
+#include "engine.h"
 #include "EGLImageWrapper.h"
 
 namespace sdm {
@@ -0,0 +1,273 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Runs the GPU engines of the composer back to back on synthetic sources and reports, per engine
+// and source, the first frame cost, CPU submission time and GPU time per frame. The first frame
+// covers engine creation, shader compilation, EGLImage creation and the first blit. GPU time is
+// taken from the signal timestamp of the release fence, each frame waits for the previous one, so
+// it is the execution time of the blit on an otherwise idle queue.
+//
+// Usage: composer_gl_benchmark [frames]
+
+#include <TonemapFactory.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utils/constants.h>
+#include <utils/fence.h>
+#include <utils/frame_timing.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "gl_color_convert.h"
+#include "gl_layer_stitch.h"
+#include "hwc_buffer_allocator.h"
+#include "hwc_event_channel.h"
+
+namespace sdm {
+
+struct BenchmarkSource {
+  const char *name;
+  uint32_t width;
+  uint32_t height;
+  LayerBufferFormat format;
+  bool hdr;
+};
+
+// Decoded HDR10 and HLG video, the tonemapper inputs, and SDR video for the other engines.
+static const BenchmarkSource kSources[] = {
+  {"hdr10_p010_4k", 3840, 2160, kFormatYCbCr420P010, true},
+  {"hlg_tp10_ubwc_4k", 3840, 2160, kFormatYCbCr420TP10Ubwc, true},
+  {"nv12_1080p", 1920, 1080, kFormatYCbCr420SemiPlanarVenus, false},
+};
+
+enum BenchmarkEngine {
+  kEngineTonemap,
+  kEngineTonemapCompute,
+  kEngineColorConvert,
+  kEngineLayerStitch,
+  kEngineMax,
+};
+
+static const char *kEngineNames[kEngineMax] = {
+  "tonemap", "tonemap_compute", "color_convert", "layer_stitch",
+};
+
+struct EngineStats {
+  uint64_t first_ns = 0;
+  uint64_t cpu_ns = 0;
+  uint64_t gpu_ns = 0;
+  uint32_t frames = 0;
+};
+
+// One engine instance, created when the measurement starts so that its setup counts as part of
+// the first frame.
+class Engine {
+ public:
+  Engine(BenchmarkEngine type, std::vector<uint32_t> *lut) : type_(type), lut_(lut) { }
+  ~Engine() {
+    delete tonemapper_;
+    if (color_convert_) {
+      GLColorConvert::Destroy(color_convert_);
+    }
+    if (layer_stitch_) {
+      GLLayerStitch::Destroy(layer_stitch_);
+    }
+  }
+
+  bool Init() {
+    switch (type_) {
+    case kEngineTonemap:
+    case kEngineTonemapCompute:
+      tonemapper_ = TonemapperFactory_GetInstance(TONEMAP_FORWARD, lut_->data(), kLutSize,
+                                                  nullptr, 0, false);
+      return tonemapper_ && (type_ != kEngineTonemapCompute || tonemapper_->enableCompute());
+    case kEngineColorConvert:
+      color_convert_ = GLColorConvert::GetInstance(kTargetRGBA, false);
+      return color_convert_ != nullptr;
+    case kEngineLayerStitch:
+      layer_stitch_ = GLLayerStitch::GetInstance(false);
+      return layer_stitch_ != nullptr;
+    default:
+      return false;
+    }
+  }
+
+  shared_ptr<Fence> Blit(const private_handle_t *src, const private_handle_t *dst) {
+    GLRect rect;
+    rect.right = FLOAT(src->unaligned_width);
+    rect.bottom = FLOAT(src->unaligned_height);
+    shared_ptr<Fence> release_fence = nullptr;
+    switch (type_) {
+    case kEngineTonemap:
+    case kEngineTonemapCompute:
+      release_fence = Fence::Create(tonemapper_->blit(dst, src, -1), "gl_benchmark");
+      break;
+    case kEngineColorConvert:
+      color_convert_->Blit(src, dst, rect, rect, nullptr, nullptr, &release_fence);
+      break;
+    case kEngineLayerStitch: {
+      StitchParams params;
+      params.src_hnd = src;
+      params.dst_hnd = dst;
+      params.src_rect = params.dst_rect = params.scissor_rect = rect;
+      layer_stitch_->Blit({params}, &release_fence);
+      break;
+    }
+    default:
+      break;
+    }
+
+    return release_fence;
+  }
+
+  static const int kLutSize = 17;
+
+ private:
+  BenchmarkEngine type_;
+  std::vector<uint32_t> *lut_;
+  Tonemapper *tonemapper_ = nullptr;
+  GLColorConvert *color_convert_ = nullptr;
+  GLLayerStitch *layer_stitch_ = nullptr;
+};
+
+// Identity 3D LUT in the GL_UNSIGNED_INT_2_10_10_10_REV layout the tonemapper loads.
+static std::vector<uint32_t> GetIdentityLut() {
+  const uint32_t size = Engine::kLutSize;
+  std::vector<uint32_t> lut;
+  for (uint32_t b = 0; b < size; b++) {
+    for (uint32_t g = 0; g < size; g++) {
+      for (uint32_t r = 0; r < size; r++) {
+        auto scale = [size](uint32_t value) { return value * 1023 / (size - 1); };
+        lut.push_back((3U << 30) | (scale(b) << 20) | (scale(g) << 10) | scale(r));
+      }
+    }
+  }
+
+  return lut;
+}
+
+// Returns the signal time of the fence once it signaled, or now if there is no fence.
+static uint64_t WaitForSignal(const shared_ptr<Fence> &fence) {
+  if (!fence || Fence::Wait(fence) != kErrorNone) {
+    return FrameTiming::Now();
+  }
+
+  Fence::ScopedRef scoped_ref;
+  int64_t signal_ns = HWCEventChannel::GetSignalTime(scoped_ref.Get(fence));
+  return signal_ns > 0 ? UINT64(signal_ns) : FrameTiming::Now();
+}
+
+static bool Measure(BenchmarkEngine type, const private_handle_t *src,
+                    const private_handle_t *dst, uint32_t frames, std::vector<uint32_t> *lut,
+                    EngineStats *stats) {
+  uint64_t start_ns = FrameTiming::Now();
+  Engine engine(type, lut);
+  if (!engine.Init()) {
+    return false;
+  }
+
+  for (uint32_t frame = 0; frame <= frames; frame++) {
+    uint64_t submit_ns = FrameTiming::Now();
+    shared_ptr<Fence> release_fence = engine.Blit(src, dst);
+    uint64_t submitted_ns = FrameTiming::Now();
+    uint64_t signal_ns = WaitForSignal(release_fence);
+    if (!frame) {
+      stats->first_ns = signal_ns - start_ns;
+      continue;
+    }
+
+    stats->cpu_ns += submitted_ns - submit_ns;
+    stats->gpu_ns += (signal_ns > submitted_ns) ? (signal_ns - submitted_ns) : 0;
+    stats->frames++;
+  }
+
+  return true;
+}
+
+static int Run(uint32_t frames) {
+  HWCBufferAllocator buffer_allocator;
+  std::vector<uint32_t> lut = GetIdentityLut();
+
+  printf("%u frames per engine\n", frames);
+  printf("%-18s %-16s %12s %12s %12s\n", "source", "engine", "first ms", "cpu us/frame",
+         "gpu ms/frame");
+  for (auto &source : kSources) {
+    BufferInfo src_info, dst_info;
+    src_info.buffer_config.width = dst_info.buffer_config.width = source.width;
+    src_info.buffer_config.height = dst_info.buffer_config.height = source.height;
+    src_info.buffer_config.format = source.format;
+    dst_info.buffer_config.format = kFormatRGBA8888;
+    src_info.buffer_config.buffer_count = dst_info.buffer_config.buffer_count = 1;
+    if (buffer_allocator.AllocateBuffer(&src_info) != kErrorNone) {
+      printf("%-18s unable to allocate the source\n", source.name);
+      continue;
+    }
+    if (buffer_allocator.AllocateBuffer(&dst_info) != kErrorNone) {
+      printf("%-18s unable to allocate the destination\n", source.name);
+      buffer_allocator.FreeBuffer(&src_info);
+      continue;
+    }
+
+    auto src = static_cast<const private_handle_t *>(src_info.private_data);
+    auto dst = static_cast<const private_handle_t *>(dst_info.private_data);
+    for (uint32_t i = 0; i < kEngineMax; i++) {
+      BenchmarkEngine type = static_cast<BenchmarkEngine>(i);
+      if (!source.hdr && (type == kEngineTonemap || type == kEngineTonemapCompute)) {
+        continue;
+      }
+
+      EngineStats stats;
+      if (!Measure(type, src, dst, frames, &lut, &stats) || !stats.frames) {
+        printf("%-18s %-16s not available\n", source.name, kEngineNames[i]);
+        continue;
+      }
+      printf("%-18s %-16s %12.2f %12.1f %12.3f\n", source.name, kEngineNames[i],
+             FLOAT(stats.first_ns) / 1e6f, FLOAT(stats.cpu_ns / stats.frames) / 1e3f,
+             FLOAT(stats.gpu_ns / stats.frames) / 1e6f);
+    }
+
+    buffer_allocator.FreeBuffer(&dst_info);
+    buffer_allocator.FreeBuffer(&src_info);
+  }
+
+  return 0;
+}
+
+}  // namespace sdm
+
+int main(int argc, char **argv) {
+  uint32_t frames = 100;
+  if (argc > 1) {
+    frames = UINT32(std::max(1, atoi(argv[1])));
+  }
+
+  return (sdm::Run(frames) == 0) ? 0 : 1;
+}
@@ -42,6 +42,7 @@ struct StitchParams {
   GLRect src_rect;
   GLRect dst_rect;
   GLRect scissor_rect;
+  GLRect damage_rect;  // Part of dst_rect to redraw, whole dst_rect if empty.
   shared_ptr<Fence> src_acquire_fence = nullptr;
   shared_ptr<Fence> dst_acquire_fence = nullptr;
 };
@@ -142,6 +142,8 @@ int GLLayerStitchImpl::CreateContext(bool secure) {
 int GLLayerStitchImpl::Blit(const std::vector<StitchParams> &stitch_params,
                             shared_ptr<Fence> *release_fence) {
   DTRACE_SCOPED();
+  // The GPU worker thread is shared with other GL clients, rebind this context and its state.
+  BindContext();
 
   std::vector<shared_ptr<Fence>> acquire_fences;
   std::vector<shared_ptr<Fence>> release_fences;
@@ -151,9 +153,14 @@ int GLLayerStitchImpl::Blit(const std::vector<StitchParams> &stitch_params,
     SetDestinationBuffer(info.dst_hnd);
     SetViewport(info.dst_rect);
     ClearWithTransparency(info.scissor_rect);
+    if (!IsValid(info.scissor_rect) && IsValid(info.damage_rect)) {
+      // Blending is off, so the undamaged part of the target keeps its last content.
+      RestrictToDamage(info.damage_rect);
+    }
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     acquire_fences.push_back(info.src_acquire_fence);
+    acquire_fences.push_back(info.dst_acquire_fence);
 
     if (!can_batch) {
       // Trigger flush and cache release fence.
@@ -214,11 +221,21 @@ void GLLayerStitchImpl::ClearWithTransparency(const GLRect &scissor_rect) {
                scissor_rect.bottom - scissor_rect.top));
 }
 
+void GLLayerStitchImpl::RestrictToDamage(const GLRect &damage_rect) {
+  GL(glEnable(GL_SCISSOR_TEST));
+  GL(glScissor(damage_rect.left, damage_rect.top, damage_rect.right - damage_rect.left,
+               damage_rect.bottom - damage_rect.top));
+}
+
 void GLLayerStitchImpl::InitContext() {
+  SetRealTimePriority();
+  BindContext();
+}
+
+void GLLayerStitchImpl::BindContext() {
   // eglMakeCurrent attaches rendering context to rendering surface.
   MakeCurrent(&ctx_);
   SetProgram(ctx_.program_id);
-  SetRealTimePriority();
   // Set vertices.
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, kFullScreenVertices);
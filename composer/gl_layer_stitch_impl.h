@@ -52,7 +52,9 @@ class GLLayerStitchImpl : public GLLayerStitch, public GLCommon {
   GLContext ctx_;
 
   void InitContext();
+  void BindContext();
   void ClearWithTransparency(const GLRect &scissor_rect);
+  void RestrictToDamage(const GLRect &damage_rect);
   int NeedsGLScissor(const std::vector<StitchParams> &stitch_params);
 };
 
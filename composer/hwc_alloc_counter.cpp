@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <log/log.h>
+#include <stdlib.h>
+
+#include <new>
+
+#include "hwc_alloc_counter.h"
+
+#ifdef USER_DEBUG
+static thread_local uint64_t g_thread_allocations = 0;
+
+static void *CountedAlloc(size_t size, bool nothrow) {
+  g_thread_allocations++;
+  void *ptr = malloc(size ? size : 1);
+  LOG_ALWAYS_FATAL_IF(!ptr && !nothrow, "Out of memory allocating %zu bytes", size);
+
+  return ptr;
+}
+
+void *operator new(size_t size) { return CountedAlloc(size, false); }
+void *operator new[](size_t size) { return CountedAlloc(size, false); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return CountedAlloc(size, true);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return CountedAlloc(size, true);
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+#endif
+
+namespace sdm {
+
+bool HWCAllocCounter::IsSupported() {
+#ifdef USER_DEBUG
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t HWCAllocCounter::ThreadAllocations() {
+#ifdef USER_DEBUG
+  return g_thread_allocations;
+#else
+  return 0;
+#endif
+}
+
+}  // namespace sdm
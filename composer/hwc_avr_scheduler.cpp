@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+
+#include "hwc_avr_scheduler.h"
+
+#define __CLASS__ "HWCAvrScheduler"
+
+namespace sdm {
+
+constexpr uint32_t HWCAvrScheduler::kEngageFrames;
+constexpr uint32_t HWCAvrScheduler::kReleaseFrames;
+constexpr uint32_t HWCAvrScheduler::kMinRateGap;
+
+bool HWCAvrScheduler::Update(const HWCLayerList &layer_set, int64_t now_ns,
+                             uint32_t refresh_rate, uint32_t min_fps,
+                             int64_t *frame_interval_ns) {
+  if (!refresh_rate) {
+    Reset();
+    return false;
+  }
+
+  uint32_t fps = GetContentFps(layer_set, now_ns, refresh_rate);
+  bool variable = fps && (fps >= min_fps) && ((fps + kMinRateGap) <= refresh_rate) &&
+                  (refresh_rate % fps) != 0;
+
+  if (variable) {
+    content_fps_ = fps;
+  }
+
+  if (variable == engaged_) {
+    pending_frames_ = 0;
+  } else if (++pending_frames_ >= (engaged_ ? kReleaseFrames : kEngageFrames)) {
+    DLOGV_IF(kTagClient, "%s variable refresh for %d fps content at %d Hz",
+             variable ? "Engaging" : "Releasing", content_fps_, refresh_rate);
+    engaged_ = variable;
+    engagements_ += variable ? 1 : 0;
+    pending_frames_ = 0;
+  }
+
+  if (engaged_) {
+    *frame_interval_ns = 1000000000LL / content_fps_;
+  }
+
+  return engaged_;
+}
+
+void HWCAvrScheduler::Reset() {
+  engaged_ = false;
+  content_fps_ = 0;
+  pending_frames_ = 0;
+}
+
+uint32_t HWCAvrScheduler::GetContentFps(const HWCLayerList &layer_set, int64_t now_ns,
+                                        uint32_t refresh_rate) {
+  // Follow a single steadily updating layer, usually the game surface. Any other updating layer
+  // would have to be shown at its own cadence too.
+  int64_t vsync_period_ns = 1000000000LL / refresh_rate;
+  uint32_t content_fps = 0;
+  for (auto hwc_layer : layer_set) {
+    uint32_t fps = 0;
+    LayerCadence::State state = hwc_layer->GetCadence().GetState(now_ns, vsync_period_ns, &fps);
+    if (state == LayerCadence::kIrregular) {
+      return 0;
+    } else if (state == LayerCadence::kSteady) {
+      if (content_fps) {
+        return 0;
+      }
+      content_fps = fps;
+    }
+  }
+
+  return content_fps;
+}
+
+}  // namespace sdm
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_AVR_SCHEDULER_H__
+#define __HWC_AVR_SCHEDULER_H__
+
+#include "hwc_layers.h"
+
+namespace sdm {
+
+// Decides when a built-in display shows frames with adaptive variable refresh (Qsync). Content
+// updating at a steady rate that the panel can not show evenly, e.g. a game rendering at 48-55 fps
+// on a 60 Hz panel, judders at a fixed refresh rate. Content at a divisor of the refresh rate
+// already shows evenly, and touch driven updates have no rate to follow, so both stay at fixed
+// refresh. Engaging is held for several frames and releasing for longer, so switching between
+// the two does not add judder of its own.
+class HWCAvrScheduler {
+ public:
+  // Returns whether the frame should be shown with variable refresh. On true, frame_interval_ns
+  // is the content frame interval that frames should be paced to.
+  bool Update(const HWCLayerList &layer_set, int64_t now_ns, uint32_t refresh_rate,
+              uint32_t min_fps, int64_t *frame_interval_ns);
+  void Reset();
+  bool IsEngaged() const { return engaged_; }
+  uint32_t GetContentFps() const { return content_fps_; }
+  uint64_t GetEngagements() const { return engagements_; }
+
+ private:
+  static constexpr uint32_t kEngageFrames = 10;
+  static constexpr uint32_t kReleaseFrames = 30;
+  // Content this close to the refresh rate is the refresh rate itself, measured with jitter.
+  static constexpr uint32_t kMinRateGap = 2;
+
+  uint32_t GetContentFps(const HWCLayerList &layer_set, int64_t now_ns, uint32_t refresh_rate);
+
+  bool engaged_ = false;
+  uint32_t content_fps_ = 0;
+  uint32_t pending_frames_ = 0;
+  uint64_t engagements_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_AVR_SCHEDULER_H__
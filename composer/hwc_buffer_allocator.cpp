@@ -32,6 +32,7 @@
 #include <core/buffer_allocator.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/formats.h>
 
 #include "gr_utils.h"
 #include "hwc_buffer_allocator.h"
@@ -82,6 +83,8 @@ DisplayError HWCBufferAllocator::AllocateBuffer(BufferInfo *buffer_info) {
   if (err != kErrorNone) {
     return err;
   }
+  LayerBufferFormat requested_format = buffer_info->buffer_config.format;
+  PreferCompressedFormat(&buffer_info->buffer_config);
   const BufferConfig &buffer_config = buffer_info->buffer_config;
   AllocatedBufferInfo *alloc_buffer_info = &buffer_info->alloc_buffer_info;
   int format;
@@ -231,12 +234,29 @@ DisplayError HWCBufferAllocator::AllocateBuffer(BufferInfo *buffer_info) {
   alloc_buffer_info->format = HWCLayer::GetSDMFormat(hnd->format, hnd->flags);
 
   buffer_info->private_data = reinterpret_cast<void *>(hnd);
+
+  if (buffer_config.format != requested_format) {
+    uint64_t linear_bytes = UINT64(FLOAT(buffer_config.width) * FLOAT(buffer_config.height) *
+                                   GetBufferFormatBpp(requested_format));
+    std::lock_guard<std::mutex> lock(compression_lock_);
+    compressed_buffers_[buffer_info->private_data] = linear_bytes;
+    compressed_bytes_ += linear_bytes;
+  }
+
   return kErrorNone;
 }
 
 DisplayError HWCBufferAllocator::FreeBuffer(BufferInfo *buffer_info) {
   DisplayError err = kErrorNone;
   auto hnd = reinterpret_cast<void *>(buffer_info->private_data);
+  {
+    std::lock_guard<std::mutex> lock(compression_lock_);
+    auto it = compressed_buffers_.find(hnd);
+    if (it != compressed_buffers_.end()) {
+      compressed_bytes_ -= it->second;
+      compressed_buffers_.erase(it);
+    }
+  }
   if (mapper_V3_ != nullptr) {
     mapper_V3_->freeBuffer(hnd);
   } else {
@@ -251,6 +271,86 @@ DisplayError HWCBufferAllocator::FreeBuffer(BufferInfo *buffer_info) {
   return err;
 }
 
+constexpr std::chrono::seconds HWCBufferAllocator::kPoolIdleTimeout;
+
+DisplayError HWCBufferAllocator::AllocatePooledBuffer(BufferInfo *buffer_info) {
+  // Pooled buffers are kept with the format they were allocated in.
+  LayerBufferFormat requested_format = buffer_info->buffer_config.format;
+  PreferCompressedFormat(&buffer_info->buffer_config);
+  const BufferConfig &config = buffer_info->buffer_config;
+  {
+    std::lock_guard<std::mutex> lock(pool_lock_);
+    TrimBufferPoolLocked(UINT64_MAX, true /* free_idle */);
+    for (auto it = buffer_pool_.begin(); it != buffer_pool_.end(); it++) {
+      const BufferConfig &pooled = it->buffer_info.buffer_config;
+      if (pooled.width == config.width && pooled.height == config.height &&
+          pooled.format == config.format && pooled.secure == config.secure &&
+          pooled.cache == config.cache && pooled.secure_camera == config.secure_camera &&
+          pooled.gfx_client == config.gfx_client) {
+        *buffer_info = it->buffer_info;
+        pool_size_ -= it->buffer_info.alloc_buffer_info.size;
+        buffer_pool_.erase(it);
+        DLOGV_IF(kTagClient, "Reusing pooled buffer %dx%d format %d, pool size %" PRIu64,
+                 config.width, config.height, config.format, pool_size_);
+        return kErrorNone;
+      }
+    }
+  }
+
+  // Let AllocateBuffer account for the promotion again.
+  buffer_info->buffer_config.format = requested_format;
+  return AllocateBuffer(buffer_info);
+}
+
+void HWCBufferAllocator::ReleasePooledBuffer(BufferInfo *buffer_info) {
+  if (!buffer_info->private_data) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(pool_lock_);
+  if (pool_budget_mb_ < 0) {
+    pool_budget_mb_ = kDefaultPoolBudgetMB;
+    HWCDebugHandler::Get()->GetProperty(BUFFER_POOL_BUDGET_MB_PROP, &pool_budget_mb_);
+  }
+
+  uint64_t budget = UINT64(pool_budget_mb_) * 1024 * 1024;
+  if (buffer_info->alloc_buffer_info.size > budget) {
+    FreeBuffer(buffer_info);
+    return;
+  }
+
+  PooledBuffer pooled_buffer;
+  pooled_buffer.buffer_info = *buffer_info;
+  pooled_buffer.release_time = std::chrono::steady_clock::now();
+  buffer_pool_.push_front(pooled_buffer);
+  pool_size_ += buffer_info->alloc_buffer_info.size;
+  TrimBufferPoolLocked(budget, true /* free_idle */);
+
+  // Ownership moved to the pool.
+  *buffer_info = {};
+}
+
+void HWCBufferAllocator::TrimBufferPool(bool free_all) {
+  std::lock_guard<std::mutex> lock(pool_lock_);
+  TrimBufferPoolLocked(free_all ? 0 : UINT64_MAX, true /* free_idle */);
+}
+
+void HWCBufferAllocator::TrimBufferPoolLocked(uint64_t budget, bool free_idle) {
+  auto now = std::chrono::steady_clock::now();
+  // Least recently released buffers sit at the back.
+  while (!buffer_pool_.empty()) {
+    PooledBuffer &oldest = buffer_pool_.back();
+    bool idle = free_idle && ((now - oldest.release_time) > kPoolIdleTimeout);
+    if (pool_size_ <= budget && !idle) {
+      break;
+    }
+
+    pool_size_ -= oldest.buffer_info.alloc_buffer_info.size;
+    FreeBuffer(&oldest.buffer_info);
+    buffer_pool_.pop_back();
+  }
+}
+
 void HWCBufferAllocator::GetCustomWidthAndHeight(const private_handle_t *handle, int *width,
                                                  int *height) {
   *width = handle->width;
@@ -306,6 +406,65 @@ uint32_t HWCBufferAllocator::GetBufferSize(BufferInfo *buffer_info) {
   return buffer_size;
 }
 
+LayerBufferFormat HWCBufferAllocator::GetCompressedFormat(LayerBufferFormat format) {
+  switch (format) {
+    case kFormatRGBA8888:                 return kFormatRGBA8888Ubwc;
+    case kFormatRGBX8888:                 return kFormatRGBX8888Ubwc;
+    case kFormatBGR565:                   return kFormatBGR565Ubwc;
+    case kFormatRGBA1010102:              return kFormatRGBA1010102Ubwc;
+    case kFormatRGBX1010102:              return kFormatRGBX1010102Ubwc;
+    case kFormatYCbCr420SemiPlanarVenus:  return kFormatYCbCr420SPVenusUbwc;
+    case kFormatYCbCr420P010Venus:        return kFormatYCbCr420P010Ubwc;
+    default:                              return kFormatInvalid;
+  }
+}
+
+void HWCBufferAllocator::PreferCompressedFormat(BufferConfig *buffer_config) {
+  // Compressed buffers can not be accessed by CPU.
+  if (!buffer_config->prefer_compression || buffer_config->cache) {
+    return;
+  }
+
+  LayerBufferFormat compressed_format = GetCompressedFormat(buffer_config->format);
+  if (compressed_format == kFormatInvalid) {
+    return;
+  }
+
+  // Honor UBWC being disabled for all buffers allocated through gralloc.
+  int ubwc_disabled = 0;
+  HWCDebugHandler::Get()->GetProperty(DISABLE_UBWC_PROP, &ubwc_disabled);
+  if (ubwc_disabled) {
+    return;
+  }
+
+  // Display always consumes the buffer. GPU renders into it, or reads it, for gfx clients.
+  int format = 0;
+  uint64_t usage = GRALLOC_USAGE_PRIVATE_ALLOC_UBWC | BufferUsage::COMPOSER_OVERLAY;
+  if (SetBufferInfo(buffer_config->format, &format, &usage) != 0) {
+    return;
+  }
+  if (buffer_config->gfx_client) {
+    usage |= BufferUsage::GPU_TEXTURE | BufferUsage::GPU_RENDER_TARGET;
+  }
+
+  if (gralloc::IsUBwcEnabled(format, usage)) {
+    DLOGV_IF(kTagClient, "Allocating %dx%d format %d as %d", buffer_config->width,
+             buffer_config->height, buffer_config->format, compressed_format);
+    buffer_config->format = compressed_format;
+  }
+}
+
+void HWCBufferAllocator::Dump(std::ostringstream *os) {
+  std::lock_guard<std::mutex> lock(compression_lock_);
+  if (compressed_buffers_.empty()) {
+    return;
+  }
+
+  // Actual savings depend on content, UBWC typically halves the traffic.
+  *os << "Compressed internal buffers: " << compressed_buffers_.size() << " linear bytes/frame: "
+      << compressed_bytes_ << " est. saved bytes/frame: " << compressed_bytes_ / 2 << std::endl;
+}
+
 int HWCBufferAllocator::SetBufferInfo(LayerBufferFormat format, int *target, uint64_t *flags) {
   switch (format) {
     case kFormatRGBA8888:
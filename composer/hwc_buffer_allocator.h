@@ -32,6 +32,12 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+
 #include <android/hardware/graphics/allocator/2.0/IAllocator.h>
 #include <android/hardware/graphics/allocator/3.0/IAllocator.h>
 #include <android/hardware/graphics/mapper/2.1/IMapper.h>
@@ -66,8 +72,34 @@ class HWCBufferAllocator : public BufferAllocator {
   DisplayError MapBuffer(const private_handle_t *handle, shared_ptr<Fence> acquire_fence);
   DisplayError UnmapBuffer(const private_handle_t *handle, int *release_fence);
 
+  // Intermediate buffers that come and go with a use case, such as tone mapping, are recycled
+  // through a pool shared by all displays instead of being freed back to gralloc.
+  DisplayError AllocatePooledBuffer(BufferInfo *buffer_info);
+  void ReleasePooledBuffer(BufferInfo *buffer_info);
+  void TrimBufferPool(bool free_all);
+  void Dump(std::ostringstream *os);
+
  private:
+  static const uint32_t kDefaultPoolBudgetMB = 64;
+  static constexpr std::chrono::seconds kPoolIdleTimeout = std::chrono::seconds(5);
+
+  struct PooledBuffer {
+    BufferInfo buffer_info = {};
+    std::chrono::steady_clock::time_point release_time = {};
+  };
+
   DisplayError GetGrallocInstance();
+  void PreferCompressedFormat(BufferConfig *buffer_config);
+  static LayerBufferFormat GetCompressedFormat(LayerBufferFormat format);
+  void TrimBufferPoolLocked(uint64_t budget, bool free_idle);
+  std::mutex pool_lock_;
+  std::deque<PooledBuffer> buffer_pool_;  // Most recently released first.
+  uint64_t pool_size_ = 0;
+  int pool_budget_mb_ = -1;
+  // Buffers allocated compressed in place of the format asked for, with their linear frame size.
+  std::mutex compression_lock_;
+  std::map<void *, uint64_t> compressed_buffers_;
+  uint64_t compressed_bytes_ = 0;
   android::sp<IMapperV2> mapper_V2_;
   android::sp<IMapperV3> mapper_V3_;
   android::sp<IAllocatorV2> allocator_V2_;
@@ -28,7 +28,9 @@
 */
 
 #include <errno.h>
+#include <linux/sync_file.h>
 #include <sync/sync.h>
+#include <sys/ioctl.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/fence.h>
@@ -38,6 +40,15 @@
 
 #define __CLASS__ "HWCBufferSyncHandler"
 
+#ifndef SYNC_IOC_SET_DEADLINE
+struct sync_set_deadline {
+  __u64 deadline_ns;
+  __u64 pad;
+};
+
+#define SYNC_IOC_SET_DEADLINE _IOW(SYNC_IOC_MAGIC, 5, struct sync_set_deadline)
+#endif
+
 namespace sdm {
 
 HWCBufferSyncHandler HWCBufferSyncHandler::g_hwc_buffer_sync_handler_;
@@ -107,6 +118,28 @@ void HWCBufferSyncHandler::GetSyncInfo(int fd, std::ostringstream *os) {
   }
 }
 
+DisplayError HWCBufferSyncHandler::SyncSetDeadline(int fd, uint64_t deadline_ns) {
+  if (fd < 0 || !deadline_supported_.load(std::memory_order_relaxed)) {
+    return kErrorNotSupported;
+  }
+
+  struct sync_set_deadline deadline = {};
+  deadline.deadline_ns = deadline_ns;
+  if (!ioctl(fd, SYNC_IOC_SET_DEADLINE, &deadline)) {
+    return kErrorNone;
+  }
+
+  // Kernels before sync file deadlines reject the ioctl, there is no point in asking again.
+  if (errno == ENOTTY) {
+    DLOGI("Sync file deadlines are not supported");
+    deadline_supported_ = false;
+    return kErrorNotSupported;
+  }
+
+  DLOGW("Set deadline failed for fd = %d, err = %d : %s", fd, errno, strerror(errno));
+  return kErrorUndefined;
+}
+
 DisplayError HWCBufferSyncHandler::SyncWait(int fd) {
   // Deprecated.
   assert(false);
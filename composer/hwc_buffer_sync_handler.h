@@ -35,6 +35,7 @@
 #include <fcntl.h>
 #include <core/sdm_types.h>
 #include <core/buffer_sync_handler.h>
+#include <atomic>
 
 namespace sdm {
 
@@ -45,10 +46,13 @@ class HWCBufferSyncHandler : public BufferSyncHandler {
   virtual DisplayError SyncMerge(int fd1, int fd2, int *merged_fd);
   virtual bool IsSyncSignaled(int fd);
   virtual void GetSyncInfo(int fd, std::ostringstream *os);
+  virtual DisplayError SyncSetDeadline(int fd, uint64_t deadline_ns);
 
  private:
   HWCBufferSyncHandler();
 
+  std::atomic<bool> deadline_supported_ = {true};  // Cleared once the kernel rejects the ioctl.
+
   static HWCBufferSyncHandler g_hwc_buffer_sync_handler_;
 };
 
@@ -28,6 +28,7 @@
  */
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
 #include <utils/locker.h>
 #include "hwc_callbacks.h"
 
@@ -60,7 +61,7 @@ HWC2::Error HWCCallbacks::Hotplug(hwc2_display_t display, HWC2::Connection state
   return HWC2::Error::None;
 }
 
-HWC2::Error HWCCallbacks::Refresh(hwc2_display_t display) {
+HWC2::Error HWCCallbacks::Refresh(hwc2_display_t display, RefreshReason reason) {
   SCOPE_LOCK(refresh_lock_);
   // Do not lock, will cause hotplug deadlock
   DTRACE_SCOPED();
@@ -68,11 +69,59 @@ HWC2::Error HWCCallbacks::Refresh(hwc2_display_t display) {
   if (!refresh_) {
     return HWC2::Error::NoResources;
   }
+
+  uint32_t id = UINT32(display);
+  uint64_t now_ns = FrameTiming::Now();
+  if (id < kNumDisplays && refresh_outstanding_.test(id)) {
+    // The frame of the earlier refresh has not been validated yet and will see this change too.
+    // After a vsync the refresh may have been dropped by the client, so it is sent again.
+    uint32_t window_ns = refresh_window_ns_[id] ? refresh_window_ns_[id] : kDefaultRefreshWindowNs;
+    if (now_ns - refresh_sent_ns_[id] < window_ns) {
+      refresh_stats_[reason].coalesced++;
+      return HWC2::Error::None;
+    }
+  }
+
   refresh_(refresh_data_, display);
-  pending_refresh_.set(UINT32(display));
+  pending_refresh_.set(id);
+  if (id < kNumDisplays) {
+    refresh_outstanding_.set(id);
+    refresh_sent_ns_[id] = now_ns;
+  }
+  refresh_stats_[reason].sent++;
   return HWC2::Error::None;
 }
 
+void HWCCallbacks::RefreshConsumed(hwc2_display_t display) {
+  SCOPE_LOCK(refresh_lock_);
+  if (display < kNumDisplays) {
+    refresh_outstanding_.reset(UINT32(display));
+  }
+}
+
+void HWCCallbacks::SetRefreshWindow(hwc2_display_t display, uint32_t vsync_period_ns) {
+  SCOPE_LOCK(refresh_lock_);
+  if (display < kNumDisplays) {
+    refresh_window_ns_[display] = vsync_period_ns;
+  }
+}
+
+void HWCCallbacks::DumpRefreshStats(std::ostringstream *os) {
+  static const char *kReasonNames[kRefreshReasonMax] = {
+    "other", "client", "color", "core", "config", "resources", "power mode", "sideband",
+    "present",
+  };
+
+  SCOPE_LOCK(refresh_lock_);
+  *os << "\nRefresh requests (sent / coalesced):\n";
+  for (uint32_t i = 0; i < kRefreshReasonMax; i++) {
+    if (refresh_stats_[i].sent || refresh_stats_[i].coalesced) {
+      *os << "  " << kReasonNames[i] << ": " << refresh_stats_[i].sent << " / "
+          << refresh_stats_[i].coalesced << "\n";
+    }
+  }
+}
+
 HWC2::Error HWCCallbacks::Vsync(hwc2_display_t display, int64_t timestamp) {
   SCOPE_LOCK(vsync_lock_);
   // Do not lock, may cause hotplug deadlock
@@ -37,8 +37,25 @@
 #undef HWC2_INCLUDE_STRINGIFICATION
 #undef HWC2_USE_CPP11
 
+#include <bitset>
+#include <sstream>
+
 namespace sdm {
 
+// Source of a refresh request, counted per reason in the dump.
+enum RefreshReason {
+  kRefreshReasonOther,
+  kRefreshReasonClient,     // Explicit refresh asked through a service API
+  kRefreshReasonColor,      // Color mode, transform, QDCM and other PP updates
+  kRefreshReasonCore,       // Requested by SDM core, e.g. idle fallback or secure session
+  kRefreshReasonConfig,     // Display config, refresh rate or panel clock changes
+  kRefreshReasonResources,  // Pipes freed or needed by another display
+  kRefreshReasonPowerMode,  // Power mode or display status changes
+  kRefreshReasonSideband,   // Sideband stream frames the layer stack has to be validated for
+  kRefreshReasonPresent,    // Frame dropped while the previous commit was in flight
+  kRefreshReasonMax,
+};
+
 class HWCCallbacks {
  public:
   static const int kNumBuiltIn = 4;
@@ -52,7 +69,13 @@ class HWCCallbacks {
                                     1 + kNumBuiltIn + kNumPluggable;
 
   HWC2::Error Hotplug(hwc2_display_t display, HWC2::Connection state);
-  HWC2::Error Refresh(hwc2_display_t display);
+  // Requests arriving while an earlier refresh of the display is still to be validated, and sent
+  // less than a vsync period ago, are merged into that refresh.
+  HWC2::Error Refresh(hwc2_display_t display, RefreshReason reason = kRefreshReasonOther);
+  // Called when a frame of the display starts, so later requests trigger a new refresh.
+  void RefreshConsumed(hwc2_display_t display);
+  void SetRefreshWindow(hwc2_display_t display, uint32_t vsync_period_ns);
+  void DumpRefreshStats(std::ostringstream *os);
   HWC2::Error Vsync(hwc2_display_t display, int64_t timestamp);
   HWC2::Error Vsync_2_4(hwc2_display_t display, int64_t timestamp, uint32_t period);
   HWC2::Error VsyncPeriodTimingChanged(hwc2_display_t display,
@@ -92,6 +115,16 @@ class HWCCallbacks {
   hwc2_display_t vsync_source_ = HWC_DISPLAY_PRIMARY;   // hw vsync is active on this display
   std::bitset<kNumDisplays> pending_refresh_;         // Displays waiting to get refreshed
 
+  static const uint32_t kDefaultRefreshWindowNs = 16666666;
+  struct RefreshStats {
+    uint64_t sent = 0;
+    uint64_t coalesced = 0;
+  };
+  std::bitset<kNumDisplays> refresh_outstanding_;     // Refresh sent, frame not started yet
+  uint64_t refresh_sent_ns_[kNumDisplays] = {};
+  uint32_t refresh_window_ns_[kNumDisplays] = {};     // 0 until the vsync period is known
+  RefreshStats refresh_stats_[kRefreshReasonMax];
+
   Locker hotplug_lock_;
   Locker refresh_lock_;
   Locker vsync_lock_;
@@ -28,6 +28,9 @@
 */
 
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cutils/sockets.h>
 #include <cutils/native_handle.h>
 #include <sync/sync.h>
@@ -80,6 +83,54 @@ int HWCColorManager::CreatePayloadFromParcel(const android::Parcel &in, uint32_t
   return ret;
 }
 
+int HWCColorManager::CreatePayloadFromSharedMemory(const android::Parcel &in, uint32_t *disp_id,
+                                                   PPDisplayAPIPayload *sink) {
+  uint32_t id = UINT32(in.readInt32());
+  uint32_t size = UINT32(in.readInt32());
+  int fd = in.readFileDescriptor();  // Owned by the parcel.
+  struct stat st = {};
+  if (fd < 0 || !size || size > kMaxSharedPayloadSize || fstat(fd, &st) ||
+      st.st_size < static_cast<off_t>(size)) {
+    DLOGW("Failing shared payload checking, fd = %d, size = %d", fd, size);
+    return -EINVAL;
+  }
+
+  void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    int error = errno;
+    DLOGE("mmap of shared payload failed, size = %d, error = %s", size, strerror(error));
+    return -error;
+  }
+
+  // Without the seals the client could rewrite the tables while the color library parses them.
+  int seals = fcntl(fd, F_GET_SEALS);
+  if (seals >= 0 && (seals & F_SEAL_WRITE) && (seals & F_SEAL_SHRINK)) {
+    sink->own_payload = false;
+    sink->size = size;
+    sink->payload = reinterpret_cast<uint8_t *>(addr);
+  } else {
+    uint8_t *payload = NULL;
+    if (sink->CreatePayloadBytes(size, &payload) != kErrorNone) {
+      munmap(addr, size);
+      return -ENOMEM;
+    }
+    memcpy(payload, addr, size);
+    munmap(addr, size);
+  }
+  *disp_id = id;
+  DLOGV_IF(kTagQDCM, "Shared payload size = %d, %s", size, sink->own_payload ? "copied" : "mapped");
+
+  return 0;
+}
+
+void HWCColorManager::DestroySharedPayload(PPDisplayAPIPayload *payload) {
+  if (payload->payload && !payload->own_payload) {
+    munmap(payload->payload, payload->size);
+    payload->payload = NULL;
+    payload->size = 0;
+  }
+}
+
 void HWCColorManager::MarshallStructIntoParcel(const PPDisplayAPIPayload &data,
                                                android::Parcel *out_parcel) {
   if (data.fd > 0) {
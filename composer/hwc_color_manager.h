@@ -103,9 +103,16 @@ class HWCQDCMModeManager {
 class HWCColorManager {
  public:
   static const int kNumSolidFillLayers = 2;
+  static const uint32_t kMaxSharedPayloadSize = 16 * 1024 * 1024;
   static HWCColorManager *CreateColorManager(HWCBufferAllocator *buffer_allocator);
   static int CreatePayloadFromParcel(const android::Parcel &in, uint32_t *disp_id,
                                      PPDisplayAPIPayload *sink);
+  // Reads display_id, payload_size and an fd of a memfd or ashmem region holding the payload.
+  // A region sealed against writes and shrinking is read in place, anything else is copied once.
+  static int CreatePayloadFromSharedMemory(const android::Parcel &in, uint32_t *disp_id,
+                                           PPDisplayAPIPayload *sink);
+  // Unmaps a payload CreatePayloadFromSharedMemory read in place. Copies go with DestroyPayload.
+  static void DestroySharedPayload(PPDisplayAPIPayload *payload);
   static void MarshallStructIntoParcel(const PPDisplayAPIPayload &data,
                                        android::Parcel *out_parcel);
 
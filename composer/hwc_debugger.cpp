@@ -30,6 +30,9 @@
 #include <utils/constants.h>
 #include <cutils/properties.h>
 #include <display_properties.h>
+#include <stdlib.h>
+
+#include <algorithm>
 
 #include "hwc_debugger.h"
 
@@ -224,6 +227,10 @@ void HWCDebugHandler::EndTrace() {
   atrace_end(ATRACE_TAG);
 }
 
+bool HWCDebugHandler::IsTraceEnabled() {
+  return atrace_is_tag_enabled(ATRACE_TAG);
+}
+
 int  HWCDebugHandler::GetIdleTimeoutMs() {
   int value = IDLE_TIMEOUT_DEFAULT_MS;
   debug_handler_.GetProperty(IDLE_TIME_PROP, &value);
@@ -231,10 +238,63 @@ int  HWCDebugHandler::GetIdleTimeoutMs() {
   return value;
 }
 
+// Tags set in the trace mask are kept in the log ring while they are not enabled for logcat, so
+// their diagnostics can stay on and be read back from dumpsys.
+void HWCDebugHandler::InitLogRing() {
+  char value[PROPERTY_VALUE_MAX] = {};
+  if (debug_handler_.GetProperty(TRACE_LOG_MASK_PROP, value) == kErrorNone) {
+    DebugHandler::SetTraceMask(std::bitset<32>(strtoul(value, NULL, 0)));
+  }
+
+  int lines_per_sec = 0;
+  debug_handler_.GetProperty(LOG_RATE_LIMIT_PROP, &lines_per_sec);
+  DebugHandler::SetLogRateLimit(UINT32(std::max(lines_per_sec, 0)));
+}
+
+bool HWCDebugHandler::ReadProperty(const char *property_name, char *value) {
+  std::lock_guard<std::mutex> lock(property_mutex_);
+  auto it = property_cache_.find(property_name);
+  if (it == property_cache_.end()) {
+    it = property_cache_.emplace(property_name, PropertyEntry()).first;
+  }
+
+  PropertyEntry &entry = it->second;
+  if (!entry.info) {
+    // A property that is not set is searched for again only after the property area changed.
+    uint32_t area_serial = __system_property_area_serial();
+    if (entry.looked_up && entry.area_serial == area_serial) {
+      return false;
+    }
+    entry.looked_up = true;
+    entry.area_serial = area_serial;
+    entry.info = __system_property_find(property_name);
+    if (!entry.info) {
+      return false;
+    }
+    entry.serial = __system_property_serial(entry.info) + 1;
+  }
+
+  if (__system_property_serial(entry.info) != entry.serial) {
+    __system_property_read_callback(entry.info,
+      [](void *cookie, const char *, const char *property_value, uint32_t serial) {
+        PropertyEntry *entry = reinterpret_cast<PropertyEntry *>(cookie);
+        strlcpy(entry->value, property_value, sizeof(entry->value));
+        entry->serial = serial;
+      }, &entry);
+  }
+
+  if (!entry.value[0]) {
+    return false;
+  }
+  strlcpy(value, entry.value, PROPERTY_VALUE_MAX);
+
+  return true;
+}
+
 int HWCDebugHandler::GetProperty(const char *property_name, int *value) {
   char property[PROPERTY_VALUE_MAX];
 
-  if (property_get(property_name, property, NULL) > 0) {
+  if (ReadProperty(property_name, property)) {
     *value = atoi(property);
     return kErrorNone;
   }
@@ -243,9 +303,11 @@ int HWCDebugHandler::GetProperty(const char *property_name, int *value) {
 }
 
 int HWCDebugHandler::GetProperty(const char *property_name, char *value) {
-  if (property_get(property_name, value, NULL) > 0) {
+  if (ReadProperty(property_name, value)) {
     return kErrorNone;
   }
+  // Same as property_get, which leaves an empty string behind.
+  value[0] = '\0';
 
   return kErrorNotSupported;
 }
@@ -36,7 +36,12 @@
 #include <debug_handler.h>
 #include <log/log.h>
 #include <utils/Trace.h>
+#include <cutils/properties.h>
+#include <sys/system_properties.h>
 #include <bitset>
+#include <map>
+#include <mutex>
+#include <string>
 
 namespace sdm {
 
@@ -60,6 +65,7 @@ class HWCDebugHandler : public DebugHandler {
   static void DebugQos(bool enable, int verbose_level);
   static void DebugDisplay(bool enable, int verbose_level);
   static int  GetIdleTimeoutMs();
+  static void InitLogRing();
 
   virtual void Error(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
   virtual void Warning(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
@@ -69,11 +75,26 @@ class HWCDebugHandler : public DebugHandler {
   virtual void BeginTrace(const char *class_name, const char *function_name,
                           const char *custom_string);
   virtual void EndTrace();
+  virtual bool IsTraceEnabled();
   virtual int GetProperty(const char *property_name, int *value);
   virtual int GetProperty(const char *property_name, char *value);
 
  private:
+  // Last value read for a property. The property serial tells when it has to be read again, so
+  // repeated lookups cost a map search and a memory load instead of a property area search.
+  struct PropertyEntry {
+    const prop_info *info = nullptr;
+    uint32_t serial = 0;
+    uint32_t area_serial = 0;
+    bool looked_up = false;
+    char value[PROPERTY_VALUE_MAX] = {};
+  };
+
+  bool ReadProperty(const char *property_name, char *value);
+
   static HWCDebugHandler debug_handler_;
+  std::mutex property_mutex_;
+  std::map<std::string, PropertyEntry, std::less<>> property_cache_;
   std::bitset<32> log_mask_;
   int32_t verbose_level_;
 };
@@ -27,13 +27,17 @@
 #include <utils/debug.h>
 #include <utils/utils.h>
 #include <utils/formats.h>
+#include <utils/frame_timing.h>
+#include <utils/layer_stack_recorder.h>
 #include <utils/rect.h>
+#include <utils/thread_policy.h>
 #include <qd_utils.h>
 #include <vendor/qti/hardware/display/composer/3.0/IQtiComposerClient.h>
 
 #include <algorithm>
 #include <iomanip>
 #include <map>
+#include <new>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -71,61 +75,128 @@ bool IsTimeAfterOrEqualVsyncTime(int64_t time, int64_t vsync_time) {
 HWCColorMode::HWCColorMode(DisplayInterface *display_intf) : display_intf_(display_intf) {}
 
 HWC2::Error HWCColorMode::Init() {
-  PopulateColorModes();
+  ColorModeMap color_modes;
+  PopulateColorModes(&color_modes);
+  BuildModeTable(color_modes);
   return HWC2::Error::None;
 }
 
 HWC2::Error HWCColorMode::DeInit() {
-  color_mode_map_.clear();
+  mode_table_.clear();
+  mode_begin_.fill(0);
+  mode_names_.clear();
+  num_color_modes_ = 0;
   return HWC2::Error::None;
 }
 
 uint32_t HWCColorMode::GetColorModeCount() {
-  uint32_t count = UINT32(color_mode_map_.size());
+  uint32_t count = num_color_modes_;
   DLOGI("Supported color mode count = %d", count);
   return std::max(1U, count);
 }
 
 uint32_t HWCColorMode::GetRenderIntentCount(ColorMode mode) {
-  uint32_t count = UINT32(color_mode_map_[mode].size());
+  uint32_t count = (UINT32(mode) < kColorModeCount) ? GetNumIntents(mode) : 0;
   DLOGI("mode: %d supported rendering intent count = %d", mode, count);
   return std::max(1U, count);
 }
 
 HWC2::Error HWCColorMode::GetColorModes(uint32_t *out_num_modes, ColorMode *out_modes) {
-  auto it = color_mode_map_.begin();
-  *out_num_modes = std::min(*out_num_modes, UINT32(color_mode_map_.size()));
-  for (uint32_t i = 0; i < *out_num_modes; it++, i++) {
-    out_modes[i] = it->first;
-    DLOGI("Color mode = %d is supported", out_modes[i]);
+  *out_num_modes = std::min(*out_num_modes, num_color_modes_);
+  uint32_t i = 0;
+  for (uint32_t mode = 0; mode < kColorModeCount && i < *out_num_modes; mode++) {
+    if (GetNumIntents(static_cast<ColorMode>(mode))) {
+      out_modes[i] = static_cast<ColorMode>(mode);
+      DLOGI("Color mode = %d is supported", out_modes[i]);
+      i++;
+    }
   }
   return HWC2::Error::None;
 }
 
 HWC2::Error HWCColorMode::GetRenderIntents(ColorMode mode, uint32_t *out_num_intents,
                                            RenderIntent *out_intents) {
-  if (color_mode_map_.find(mode) == color_mode_map_.end()) {
+  if (UINT32(mode) >= kColorModeCount || !GetNumIntents(mode)) {
     return HWC2::Error::BadParameter;
   }
-  auto it = color_mode_map_[mode].begin();
-  *out_num_intents = std::min(*out_num_intents, UINT32(color_mode_map_[mode].size()));
-  for (uint32_t i = 0; i < *out_num_intents; it++, i++) {
-    out_intents[i] = it->first;
+  *out_num_intents = std::min(*out_num_intents, GetNumIntents(mode));
+  const ModeEntry *entry = &mode_table_[mode_begin_[UINT32(mode)]];
+  for (uint32_t i = 0; i < *out_num_intents; i++) {
+    out_intents[i] = entry[i].intent;
     DLOGI("Color mode = %d is supported with render intent = %d", mode, out_intents[i]);
   }
   return HWC2::Error::None;
 }
 
+const HWCColorMode::ModeEntry *HWCColorMode::FindModeEntry(ColorMode mode,
+                                                           RenderIntent intent) const {
+  if (UINT32(mode) >= kColorModeCount) {
+    return nullptr;
+  }
+  // A mode has a handful of intents at most.
+  for (uint32_t i = mode_begin_[UINT32(mode)]; i < mode_begin_[UINT32(mode) + 1]; i++) {
+    if (mode_table_[i].intent == intent) {
+      return &mode_table_[i];
+    }
+  }
+  return nullptr;
+}
+
+const std::string &HWCColorMode::GetModeName(ColorMode mode, RenderIntent intent,
+                                             DynamicRangeType range) const {
+  static const std::string kNone;
+  const ModeEntry *entry = FindModeEntry(mode, intent);
+  if (!entry || entry->name_index[range] < 0) {
+    return kNone;
+  }
+  return mode_names_[UINT32(entry->name_index[range])];
+}
+
+void HWCColorMode::BuildModeTable(const ColorModeMap &color_modes) {
+  mode_table_.clear();
+  mode_names_.clear();
+  mode_begin_.fill(0);
+  num_color_modes_ = 0;
+
+  // The map iterates in mode then intent order, which keeps the entries of each mode together.
+  for (auto &mode_it : color_modes) {
+    if (UINT32(mode_it.first) >= kColorModeCount || mode_it.second.empty()) {
+      continue;
+    }
+    num_color_modes_++;
+    for (auto &intent_it : mode_it.second) {
+      ModeEntry entry;
+      entry.mode = mode_it.first;
+      entry.intent = intent_it.first;
+      for (auto &range_it : intent_it.second) {
+        auto name = std::find(mode_names_.begin(), mode_names_.end(), range_it.second);
+        if (name == mode_names_.end()) {
+          name = mode_names_.insert(mode_names_.end(), range_it.second);
+        }
+        entry.name_index[range_it.first] = INT32(name - mode_names_.begin());
+      }
+      mode_table_.push_back(entry);
+    }
+  }
+
+  for (uint32_t mode = 0, i = 0; mode <= kColorModeCount; mode++) {
+    while (i < mode_table_.size() && UINT32(mode_table_[i].mode) < mode) {
+      i++;
+    }
+    mode_begin_[mode] = i;
+  }
+}
+
 HWC2::Error HWCColorMode::ValidateColorModeWithRenderIntent(ColorMode mode, RenderIntent intent) {
   if (mode < ColorMode::NATIVE || mode > ColorMode::DISPLAY_BT2020) {
     DLOGE("Invalid mode: %d", mode);
     return HWC2::Error::BadParameter;
   }
-  if (color_mode_map_.find(mode) == color_mode_map_.end()) {
+  if (!GetNumIntents(mode)) {
     DLOGE("Could not find mode: %d", mode);
     return HWC2::Error::Unsupported;
   }
-  if (color_mode_map_[mode].find(intent) == color_mode_map_[mode].end()) {
+  if (!FindModeEntry(mode, intent)) {
     DLOGE("Could not find render intent %d in mode %d", intent, mode);
     return HWC2::Error::Unsupported;
   }
@@ -144,7 +215,7 @@ HWC2::Error HWCColorMode::SetColorModeWithRenderIntent(ColorMode mode, RenderInt
     return HWC2::Error::None;
   }
 
-  auto mode_string = color_mode_map_[mode][intent][kSdrType];
+  auto &mode_string = GetModeName(mode, intent, kSdrType);
   DisplayError error = display_intf_->SetColorMode(mode_string);
   if (error != kErrorNone) {
     DLOGE("failed for mode = %d intent = %d name = %s", mode, intent, mode_string.c_str());
@@ -179,7 +250,7 @@ HWC2::Error HWCColorMode::CacheColorModeWithRenderIntent(ColorMode mode, RenderI
 
 HWC2::Error HWCColorMode::ApplyCurrentColorModeWithRenderIntent(bool hdr_present) {
   // If panel does not support color modes, do not set color mode.
-  if (color_mode_map_.size() <= 1) {
+  if (num_color_modes_ <= 1) {
     return HWC2::Error::None;
   }
   if (!apply_mode_) {
@@ -192,25 +263,25 @@ HWC2::Error HWCColorMode::ApplyCurrentColorModeWithRenderIntent(bool hdr_present
   curr_dynamic_range_ = (hdr_present)? kHdrType : kSdrType;
 
   // select mode according to the blend space and dynamic range
-  std::string mode_string = preferred_mode_[current_color_mode_][curr_dynamic_range_];
+  std::string mode_string = preferred_mode_[UINT32(current_color_mode_)][curr_dynamic_range_];
   if (mode_string.empty()) {
-    mode_string = color_mode_map_[current_color_mode_][current_render_intent_][curr_dynamic_range_];
+    mode_string = GetModeName(current_color_mode_, current_render_intent_, curr_dynamic_range_);
     if (mode_string.empty() && hdr_present) {
       // Use the colorimetric HDR mode, if an HDR mode with the current render intent is not present
-      mode_string = color_mode_map_[current_color_mode_][RenderIntent::COLORIMETRIC][kHdrType];
+      mode_string = GetModeName(current_color_mode_, RenderIntent::COLORIMETRIC, kHdrType);
     }
     if (mode_string.empty() &&
        (current_color_mode_ == ColorMode::DISPLAY_P3 ||
        current_color_mode_ == ColorMode::DISPLAY_BT2020) &&
        curr_dynamic_range_ == kHdrType) {
       // fall back to display_p3/display_bt2020 SDR mode if there is no HDR mode
-      mode_string = color_mode_map_[current_color_mode_][current_render_intent_][kSdrType];
+      mode_string = GetModeName(current_color_mode_, current_render_intent_, kSdrType);
     }
 
     if (mode_string.empty() &&
        (current_color_mode_ == ColorMode::BT2100_PQ) && (curr_dynamic_range_ == kSdrType)) {
       // fallback to hdr mode.
-      mode_string = color_mode_map_[current_color_mode_][current_render_intent_][kHdrType];
+      mode_string = GetModeName(current_color_mode_, current_render_intent_, kHdrType);
       DLOGI("fall back to hdr mode for ColorMode::BT2100_PQ kSdrType");
     }
   }
@@ -306,7 +377,7 @@ HWC2::Error HWCColorMode::SetColorModeFromClientApi(std::string mode_string) {
 
   auto error = SetPreferredColorModeInternal(mode_string, true, &mode, &range);
   if (error == HWC2::Error::None) {
-    preferred_mode_[mode][range] = mode_string;
+    preferred_mode_[UINT32(mode)][range] = mode_string;
     DLOGV_IF(kTagClient, "Put mode %s(mode %d, range %d) into preferred_mode",
              mode_string.c_str(), mode, range);
   }
@@ -340,14 +411,14 @@ HWC2::Error HWCColorMode::SetColorTransform(const float *matrix,
   return status;
 }
 
-void HWCColorMode::PopulateColorModes() {
+void HWCColorMode::PopulateColorModes(ColorModeMap *color_modes) {
   uint32_t color_mode_count = 0;
   // SDM returns modes which have attributes defining mode and rendering intent
   DisplayError error = display_intf_->GetColorModeCount(&color_mode_count);
   if (error != kErrorNone || (color_mode_count == 0)) {
     DLOGW("GetColorModeCount failed, use native color mode");
-    color_mode_map_[ColorMode::NATIVE][RenderIntent::COLORIMETRIC]
-                   [kSdrType] = "hal_native_identity";
+    (*color_modes)[ColorMode::NATIVE][RenderIntent::COLORIMETRIC]
+                  [kSdrType] = "hal_native_identity";
     return;
   }
 
@@ -387,42 +458,42 @@ void HWCColorMode::PopulateColorModes() {
 
       auto render_intent = static_cast<RenderIntent>(int_render_intent);
       if (color_gamut == kNative) {
-        color_mode_map_[ColorMode::NATIVE][render_intent][kSdrType] = mode_string;
+        (*color_modes)[ColorMode::NATIVE][render_intent][kSdrType] = mode_string;
       }
 
       if (color_gamut == kSrgb && dynamic_range == kSdr) {
-        color_mode_map_[ColorMode::SRGB][render_intent][kSdrType] = mode_string;
+        (*color_modes)[ColorMode::SRGB][render_intent][kSdrType] = mode_string;
       }
 
       if (color_gamut == kDcip3 && dynamic_range == kSdr) {
-        color_mode_map_[ColorMode::DISPLAY_P3][render_intent][kSdrType] = mode_string;
+        (*color_modes)[ColorMode::DISPLAY_P3][render_intent][kSdrType] = mode_string;
       }
       if (color_gamut == kDcip3 && dynamic_range == kHdr) {
         if (display_intf_->IsSupportSsppTonemap()) {
-          color_mode_map_[ColorMode::DISPLAY_P3][render_intent][kHdrType] = mode_string;
+          (*color_modes)[ColorMode::DISPLAY_P3][render_intent][kHdrType] = mode_string;
         } else if (pic_quality == kStandard) {
-          color_mode_map_[ColorMode::BT2100_PQ][render_intent]
-                         [kHdrType] = mode_string;
-          color_mode_map_[ColorMode::BT2100_HLG][render_intent]
-                         [kHdrType] = mode_string;
+          (*color_modes)[ColorMode::BT2100_PQ][render_intent]
+                        [kHdrType] = mode_string;
+          (*color_modes)[ColorMode::BT2100_HLG][render_intent]
+                        [kHdrType] = mode_string;
         }
       } else if (color_gamut == kBt2020) {
         if (transfer == kSt2084) {
-          color_mode_map_[ColorMode::BT2100_PQ][RenderIntent::COLORIMETRIC]
-                         [kHdrType] = mode_string;
+          (*color_modes)[ColorMode::BT2100_PQ][RenderIntent::COLORIMETRIC]
+                        [kHdrType] = mode_string;
         } else if (transfer == kHlg) {
-          color_mode_map_[ColorMode::BT2100_HLG][RenderIntent::COLORIMETRIC]
-                         [kHdrType] = mode_string;
+          (*color_modes)[ColorMode::BT2100_HLG][RenderIntent::COLORIMETRIC]
+                        [kHdrType] = mode_string;
         } else if (transfer == kSrgb) {
-          color_mode_map_[ColorMode::DISPLAY_BT2020][RenderIntent::COLORIMETRIC]
-                         [kSdrType] = mode_string;
+          (*color_modes)[ColorMode::DISPLAY_BT2020][RenderIntent::COLORIMETRIC]
+                        [kSdrType] = mode_string;
         }
       }
     } else {
       // Look at the mode names, if no attributes are found
       if (mode_string.find("hal_native") != std::string::npos) {
-        color_mode_map_[ColorMode::NATIVE][RenderIntent::COLORIMETRIC]
-                       [kSdrType] = mode_string;
+        (*color_modes)[ColorMode::NATIVE][RenderIntent::COLORIMETRIC]
+                      [kSdrType] = mode_string;
       }
     }
   }
@@ -430,12 +501,17 @@ void HWCColorMode::PopulateColorModes() {
 
 void HWCColorMode::Dump(std::ostringstream* os) {
   *os << "color modes supported: \n";
-  for (auto it : color_mode_map_) {
-    *os << "mode: " << static_cast<int32_t>(it.first) << " RIs { ";
-    for (auto render_intent_it : color_mode_map_[it.first]) {
-      *os << static_cast<int32_t>(render_intent_it.first) << " dynamic_range [ ";
-      for (auto range_it : color_mode_map_[it.first][render_intent_it.first]) {
-        *os << static_cast<int32_t>(range_it.first) << " ";
+  for (uint32_t mode = 0; mode < kColorModeCount; mode++) {
+    if (!GetNumIntents(static_cast<ColorMode>(mode))) {
+      continue;
+    }
+    *os << "mode: " << mode << " RIs { ";
+    for (uint32_t i = mode_begin_[mode]; i < mode_begin_[mode + 1]; i++) {
+      *os << static_cast<int32_t>(mode_table_[i].intent) << " dynamic_range [ ";
+      for (uint32_t range = 0; range < kDynamicRangeCount; range++) {
+        if (mode_table_[i].name_index[range] >= 0) {
+          *os << range << " ";
+        }
       }
       *os << "] ";
     }
@@ -533,8 +609,31 @@ int HWCDisplay::Init() {
   display_intf_->GetConfig(&fixed_info);
   is_cmd_mode_ = fixed_info.is_cmdmode;
   partial_update_enabled_ = fixed_info.partial_update || (!fixed_info.is_cmdmode);
+  panel_partial_update_ = fixed_info.partial_update;
   client_target_->SetPartialUpdate(partial_update_enabled_);
 
+  HWCDebugHandler::Get()->GetProperty(FRAME_DUMP_RING_SIZE_PROP, &frame_dump_ring_size_mb_);
+  HWCDebugHandler::Get()->GetProperty(LAYER_STACK_RECORD_FRAMES_PROP, &layer_stack_record_frames_);
+  HWCDebugHandler::Get()->GetProperty(CONTENT_SIGNATURE_MAX_PIXELS_PROP,
+                                      &content_signature_max_pixels_);
+  HWCDebugHandler::Get()->GetProperty(SOLID_FILL_DETECT_MAX_PIXELS_PROP,
+                                      &solid_fill_detect_max_pixels_);
+  int enable_client_target_reuse = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_CLIENT_TARGET_REUSE_PROP,
+                                      &enable_client_target_reuse);
+  enable_client_target_reuse_ = (enable_client_target_reuse == 1);
+  int early_config_submit = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_EARLY_CONFIG_SUBMIT_PROP, &early_config_submit);
+  early_config_submit_ = (early_config_submit == 1);
+  int disable_fence_deadline = 0;
+  HWCDebugHandler::Get()->GetProperty(DISABLE_FENCE_DEADLINE_PROP, &disable_fence_deadline);
+  fence_deadlines_ = (disable_fence_deadline != 1);
+  int jank_record_frames = 32;
+  HWCDebugHandler::Get()->GetProperty(JANK_RECORD_FRAMES_PROP, &jank_record_frames);
+  char jank_record_dir[PROPERTY_VALUE_MAX] = {};
+  HWCDebugHandler::Get()->GetProperty(JANK_RECORD_DIR_PROP, jank_record_dir);
+  jank_recorder_.Init(sdm_id_, UINT32(std::max(jank_record_frames, 0)), jank_record_dir);
+
   int disable_fast_path = 0;
   HWCDebugHandler::Get()->GetProperty(DISABLE_FAST_PATH, &disable_fast_path);
   fast_path_enabled_ = !(disable_fast_path == 1);
@@ -543,6 +642,8 @@ int HWCDisplay::Init() {
 
   DLOGI("Display created with id: %d, game_supported_: %d", UINT32(id_), game_supported_);
 
+  StartVSyncThread();
+
   return 0;
 }
 
@@ -583,6 +684,15 @@ void HWCDisplay::UpdateConfigs() {
 }
 
 int HWCDisplay::Deinit() {
+  StopSidebandThread();
+  StopVSyncThread();
+  frame_dumper_.Deinit();
+  jank_recorder_.Deinit();
+  if (layer_stack_record_file_) {
+    fclose(layer_stack_record_file_);
+    layer_stack_record_file_ = nullptr;
+  }
+
   if (null_display_mode_) {
     delete static_cast<DisplayNull *>(display_intf_);
     display_intf_ = nullptr;
@@ -598,6 +708,7 @@ int HWCDisplay::Deinit() {
   for (auto hwc_layer : layer_set_) {
     delete hwc_layer;
   }
+  FreeLayerPool();
 
   if (color_mode_) {
     color_mode_->DeInit();
@@ -614,8 +725,13 @@ int HWCDisplay::Deinit() {
 
 // LayerStack operations
 HWC2::Error HWCDisplay::CreateLayer(hwc2_layer_t *out_layer_id) {
-  HWCLayer *layer = *layer_set_.emplace(new HWCLayer(id_, buffer_allocator_));
-  layer_map_.emplace(std::make_pair(layer->GetId(), layer));
+  HWCLayer *layer = AllocateLayer();
+  InsertLayerByZ(layer);
+  auto map_layer = std::upper_bound(layer_map_.begin(), layer_map_.end(), layer->GetId(),
+                                    [](hwc2_layer_t id, const HWCLayerMap::value_type &entry) {
+                                      return id < entry.first;
+                                    });
+  layer_map_.emplace(map_layer, layer->GetId(), layer);
   *out_layer_id = layer->GetId();
   geometry_changes_ |= GeometryChanges::kAdded;
   validated_ = false;
@@ -625,78 +741,183 @@ HWC2::Error HWCDisplay::CreateLayer(hwc2_layer_t *out_layer_id) {
   return HWC2::Error::None;
 }
 
+HWCLayerMap::iterator HWCDisplay::FindLayer(hwc2_layer_t layer_id) {
+  auto map_layer = std::lower_bound(layer_map_.begin(), layer_map_.end(), layer_id,
+                                    [](const HWCLayerMap::value_type &entry, hwc2_layer_t id) {
+                                      return entry.first < id;
+                                    });
+  if (map_layer != layer_map_.end() && map_layer->first != layer_id) {
+    return layer_map_.end();
+  }
+
+  return map_layer;
+}
+
+HWCLayer *HWCDisplay::AllocateLayer() {
+  if (layer_pool_.empty()) {
+    return new HWCLayer(id_, buffer_allocator_);
+  }
+
+  void *storage = layer_pool_.back();
+  layer_pool_.pop_back();
+  return new (storage) HWCLayer(id_, buffer_allocator_);
+}
+
+void HWCDisplay::FreeLayer(HWCLayer *layer) {
+  if (layer_pool_.size() >= kMaxPooledLayers) {
+    delete layer;
+    return;
+  }
+
+  // Destroy in place, the storage is handed to the next CreateLayer with a freshly reset layer.
+  layer->~HWCLayer();
+  layer_pool_.push_back(layer);
+}
+
+void HWCDisplay::FreeLayerPool() {
+  for (auto storage : layer_pool_) {
+    ::operator delete(storage);
+  }
+  layer_pool_.clear();
+}
+
+void HWCDisplay::InsertLayerByZ(HWCLayer *layer) {
+  if (layer_set_unsorted_) {
+    layer_set_.push_back(layer);
+    return;
+  }
+
+  layer_set_.insert(std::upper_bound(layer_set_.begin(), layer_set_.end(), layer, SortLayersByZ()),
+                    layer);
+}
+
+// SurfaceFlinger sends the Z of every layer on a geometry change, so the list is sorted once when
+// the layer stack is built rather than on each SetLayerZOrder.
+void HWCDisplay::SortLayerSet() {
+  if (!layer_set_unsorted_) {
+    return;
+  }
+
+  std::stable_sort(layer_set_.begin(), layer_set_.end(), SortLayersByZ());
+  layer_set_unsorted_ = false;
+}
+
 HWCLayer *HWCDisplay::GetHWCLayer(hwc2_layer_t layer_id) {
-  const auto map_layer = layer_map_.find(layer_id);
+  if (last_layer_ && (last_layer_id_ == layer_id)) {
+    return last_layer_;
+  }
+
+  const auto map_layer = FindLayer(layer_id);
   if (map_layer == layer_map_.end()) {
     DLOGW("[%" PRIu64 "] GetLayer(%" PRIu64 ") failed: no such layer", id_, layer_id);
     return nullptr;
   } else {
+    last_layer_id_ = layer_id;
+    last_layer_ = map_layer->second;
     return map_layer->second;
   }
 }
 
 HWC2::Error HWCDisplay::DestroyLayer(hwc2_layer_t layer_id) {
-  const auto map_layer = layer_map_.find(layer_id);
+  const auto map_layer = FindLayer(layer_id);
   if (map_layer == layer_map_.end()) {
     DLOGW("[%" PRIu64 "] destroyLayer(%" PRIu64 ") failed: no such layer", id_, layer_id);
     return HWC2::Error::BadLayer;
   }
   const auto layer = map_layer->second;
   layer_map_.erase(map_layer);
-  const auto z_range = layer_set_.equal_range(layer);
-  for (auto current = z_range.first; current != z_range.second; ++current) {
-    if (*current == layer) {
-      current = layer_set_.erase(current);
-      delete layer;
-      break;
-    }
+  if (last_layer_ == layer) {
+    last_layer_ = nullptr;
+  }
+  const auto current = std::find(layer_set_.begin(), layer_set_.end(), layer);
+  if (current != layer_set_.end()) {
+    layer_set_.erase(current);
+    FreeLayer(layer);
   }
 
   geometry_changes_ |= GeometryChanges::kRemoved;
   validated_ = false;
   layer_stack_invalid_ = true;
+  if (sideband_active_.load(std::memory_order_relaxed)) {
+    UpdateSidebandState();
+  }
+
+  return HWC2::Error::None;
+}
+
+HWC2::Error HWCDisplay::SetLayerSidebandStream(hwc2_layer_t layer_id,
+                                               shared_ptr<HWCSidebandQueue> queue) {
+  HWCLayer *hwc_layer = GetHWCLayer(layer_id);
+  if (!hwc_layer) {
+    return HWC2::Error::BadLayer;
+  }
+
+  hwc_layer->SetSidebandStream(queue);
+  validated_ = false;
+  UpdateSidebandState();
 
   return HWC2::Error::None;
 }
 
+void HWCDisplay::UpdateSidebandState() {
+  bool active = std::any_of(layer_set_.begin(), layer_set_.end(),
+                            [](HWCLayer *hwc_layer) { return hwc_layer->HasSidebandStream(); });
+  if (active == sideband_active_.load(std::memory_order_relaxed)) {
+    return;
+  }
 
-void HWCDisplay::BuildLayerStack() {
+  if (active && !sideband_thread_.joinable()) {
+    sideband_thread_exit_ = false;
+    sideband_thread_ = std::thread(&HWCDisplay::SidebandThread, this);
+  }
+  sideband_active_.store(active, std::memory_order_release);
+
+  bool vsync_enabled = active || client_vsync_enabled_.load(std::memory_order_relaxed);
+  DisplayError error = display_intf_->SetVSyncState(vsync_enabled);
+  if (error != kErrorNone) {
+    DLOGW("Display %" PRIu64 " failed to set vsync %d for sideband layers. Error = %d", id_,
+          vsync_enabled, error);
+  }
+}
+
+
+// Keeps the storage of the layer list so that rebuilding the stack every frame does not allocate.
+void HWCDisplay::ResetLayerStack() {
+  std::vector<Layer *> layers;
+  layers.swap(layer_stack_.layers);
+  layers.clear();
   layer_stack_ = LayerStack();
+  layer_stack_.layers.swap(layers);
+}
+
+void HWCDisplay::BuildLayerStack() {
+  SortLayerSet();
+  ResetLayerStack();
   display_rect_ = LayerRect();
   metadata_refresh_rate_ = 0;
   layer_stack_.flags.animating = animating_;
   layer_stack_.flags.fast_path = fast_path_enabled_ && fast_path_composition_;
+  if (sideband_active_.load(std::memory_order_relaxed)) {
+    // Frames due at the next vsync go out with this frame of the client.
+    LatchSidebandFrames(last_vsync_timestamp_.load(std::memory_order_relaxed));
+  }
 
   DTRACE_SCOPED();
+  // Layer flags derived from geometry, color and metadata are re-populated only for the layers
+  // that changed in those, unless a display wide input they depend on has changed.
+  bool client_target_valid = (client_target_->GetSDMLayer()->input_buffer.buffer_id != 0);
+  hwc2_layer_t top_layer_id = layer_set_.empty() ? 0 : (*layer_set_.rbegin())->GetId();
+  bool repopulate_all = geometry_changes_ || (client_target_valid != client_target_valid_) ||
+                        (top_layer_id != top_layer_id_);
+  client_target_valid_ = client_target_valid;
+  top_layer_id_ = top_layer_id;
+
   // Add one layer for fb target
   for (auto hwc_layer : layer_set_) {
     // Reset layer data which SDM may change
     hwc_layer->ResetPerFrameData();
 
     Layer *layer = hwc_layer->GetSDMLayer();
-    layer->flags = {};   // Reset earlier flags
-    // Mark all layers to skip, when client target handle is NULL
-    if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Client ||
-        !client_target_->GetSDMLayer()->input_buffer.buffer_id) {
-      layer->flags.skip = true;
-    } else if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::SolidColor) {
-      layer->flags.solid_fill = true;
-    }
-
-#ifdef FOD_ZPOS
-    if (hwc_layer->IsFodPressed()) {
-      layer->flags.fod_pressed = true;
-      layer_stack_.flags.fod_pressed_present = true;
-    } else {
-      layer->flags.fod_pressed = false;
-      layer_stack_.flags.fod_pressed_present = false;
-    }
-#endif
-
-    if (!hwc_layer->IsDataSpaceSupported()) {
-      layer->flags.skip = true;
-    }
-
     // set default composition as GPU for SDM
     layer->composition = kCompositionGPU;
 
@@ -731,49 +952,28 @@ void HWCDisplay::BuildLayerStack() {
       is_secure = true;
     }
 
-    if (hwc_layer->IsSingleBuffered() &&
-       !(hwc_layer->IsRotationPresent() || hwc_layer->IsScalingPresent())) {
-      layer->flags.single_buffer = true;
-      layer_stack_.flags.single_buffered_layer_present = true;
-    }
-
-    bool hdr_layer = layer->input_buffer.color_metadata.colorPrimaries == ColorPrimaries_BT2020 &&
-                     (layer->input_buffer.color_metadata.transfer == Transfer_SMPTE_ST2084 ||
-                     layer->input_buffer.color_metadata.transfer == Transfer_HLG);
-    if (hdr_layer && !disable_hdr_handling_) {
-      // Dont honor HDR when its handling is disabled
-      layer->input_buffer.flags.hdr = true;
-      layer_stack_.flags.hdr_present = true;
-    }
-
-    if (hwc_layer->IsNonIntegralSourceCrop() && !is_secure && !hdr_layer &&
-        !layer->flags.single_buffer && !layer->flags.solid_fill && !is_video) {
-      layer->flags.skip = true;
+    if (repopulate_all || (hwc_layer->GetDirtyMask() & ~kLayerDirtyBuffer)) {
+      PopulateLayerFlags(hwc_layer, is_secure, is_video);
+    } else {
+      // Only buffer has changed, flags derived from rest of the layer state still hold.
+      layer->flags = hwc_layer->GetCachedFlags();
     }
-
-    if (!layer->flags.skip &&
-        (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Cursor)) {
-      // Currently we support only one HWCursor & only at top most z-order
-      if ((*layer_set_.rbegin())->GetId() == hwc_layer->GetId()) {
-        layer->flags.cursor = true;
-        layer_stack_.flags.cursor_present = true;
-      }
+    if (solid_fill_detect_max_pixels_ > 0) {
+      solid_fill_promotions_ +=
+          hwc_layer->PromoteUniformColor(UINT32(solid_fill_detect_max_pixels_));
     }
+    hwc_layer->ResetDirtyMask();
 
-    if (layer->flags.skip) {
-      layer_stack_.flags.skip_present = true;
-    }
+#ifdef FOD_ZPOS
+    layer_stack_.flags.fod_pressed_present = layer->flags.fod_pressed;
+#endif
+    layer_stack_.flags.single_buffered_layer_present |= layer->flags.single_buffer;
+    layer_stack_.flags.hdr_present |= layer->input_buffer.flags.hdr;
+    layer_stack_.flags.cursor_present |= layer->flags.cursor;
+    layer_stack_.flags.skip_present |= layer->flags.skip;
 
-    // TODO(user): Move to a getter if this is needed at other places
-    hwc_rect_t scaled_display_frame = {INT(layer->dst_rect.left), INT(layer->dst_rect.top),
-                                       INT(layer->dst_rect.right), INT(layer->dst_rect.bottom)};
-    if (hwc_layer->GetGeometryChanges() & kDisplayFrame) {
-      ApplyScanAdjustment(&scaled_display_frame);
-    }
-    hwc_layer->SetLayerDisplayFrame(scaled_display_frame);
-    hwc_layer->ResetPerFrameData();
-    // SDM requires these details even for solid fill
-    if (layer->flags.solid_fill) {
+    // SDM requires these details even for solid fill. Promoted layers keep those of their buffer.
+    if (layer->flags.solid_fill && !hwc_layer->IsSolidFillPromoted()) {
       LayerBuffer *layer_buffer = &layer->input_buffer;
       layer_buffer->width = UINT32(layer->dst_rect.right - layer->dst_rect.left);
       layer_buffer->height = UINT32(layer->dst_rect.bottom - layer->dst_rect.top);
@@ -797,26 +997,32 @@ void HWCDisplay::BuildLayerStack() {
       layer->flags.updating = IsLayerUpdating(hwc_layer);
     }
 
-    if (hwc_layer->IsColorTransformSet()) {
-      layer->flags.color_transform = true;
-    }
-
     layer_stack_.flags.mask_present |= layer->input_buffer.flags.mask_layer;
 
-    if ((hwc_layer->GetDeviceSelectedCompositionType() != HWC2::Composition::Device) ||
-        (hwc_layer->GetClientRequestedCompositionType() != HWC2::Composition::Device) ||
+    // Sideband layers are device layers with buffers of their own.
+    HWC2::Composition requested = hwc_layer->GetClientRequestedCompositionType();
+    bool device_requested = (requested == HWC2::Composition::Device) ||
+                            (requested == HWC2::Composition::Sideband);
+    if ((hwc_layer->GetDeviceSelectedCompositionType() != requested) || !device_requested ||
         layer->flags.skip) {
       layer->update_mask.set(kClientCompRequest);
     }
 
-    if (game_supported_ && (hwc_layer->GetType() == kLayerGame)) {
-      layer->flags.is_game = true;
-      layer->input_buffer.flags.game = true;
-    }
-
     layer_stack_.layers.push_back(layer);
   }
 
+  // SDR layers shown next to HDR content are dimmed by their pipe, so they are not sent to the
+  // GPU for it.
+  float sdr_scale = layer_stack_.flags.hdr_present ? sdr_dimming_scale_ : 1.0f;
+  for (auto hwc_layer : layer_set_) {
+    Layer *layer = hwc_layer->GetSDMLayer();
+    float scale = layer->input_buffer.flags.hdr ? 1.0f : sdr_scale;
+    if (layer->luminance_scale != scale) {
+      layer->luminance_scale = scale;
+      layer->update_mask.set(kLuminanceScaleUpdate);
+    }
+  }
+
   // If layer stack needs Client composition, HWC display gets into InternalValidate state. If
   // validation gets reset by any other thread in this state, enforce Geometry change to ensure
   // that Client target gets composed by SF.
@@ -842,10 +1048,123 @@ void HWCDisplay::BuildLayerStack() {
     // Must fall back to client composition
     MarkLayersForClientComposition();
   }
+
+  RecordLayerStack();
+}
+
+HWC2::Error HWCDisplay::SetSdrDimmingScale(float scale) {
+  if (scale < 0.0f || scale > 1.0f) {
+    return HWC2::Error::BadParameter;
+  }
+
+  if (sdr_dimming_scale_ != scale) {
+    DLOGI("SDR dimming scale %f on display %d-%d", scale, sdm_id_, type_);
+    sdr_dimming_scale_ = scale;
+    validated_ = false;
+  }
+
+  return HWC2::Error::None;
+}
+
+void HWCDisplay::RecordLayerStack() {
+  if (layer_stack_record_frames_ <= 0) {
+    return;
+  }
+
+  if (!layer_stack_record_file_) {
+    char file_path[PATH_MAX];
+    snprintf(file_path, sizeof(file_path), "%s/layer_stack_disp_id_%02u_%s.txt",
+             HWCDebugHandler::DumpDir(), UINT32(id_), GetDisplayString());
+    layer_stack_record_file_ = fopen(file_path, "w");
+    if (!layer_stack_record_file_) {
+      DLOGW("Failed to open %s errno = %d, desc = %s", file_path, errno, strerror(errno));
+      layer_stack_record_frames_ = 0;
+      return;
+    }
+    DLOGI("Recording %d layer stacks to %s", layer_stack_record_frames_, file_path);
+  }
+
+  if (!LayerStackRecorder::Write(layer_stack_record_file_, layer_stack_) ||
+      (--layer_stack_record_frames_ == 0)) {
+    fclose(layer_stack_record_file_);
+    layer_stack_record_file_ = nullptr;
+    layer_stack_record_frames_ = 0;
+  }
+}
+
+void HWCDisplay::PopulateLayerFlags(HWCLayer *hwc_layer, bool is_secure, bool is_video) {
+  Layer *layer = hwc_layer->GetSDMLayer();
+  layer->flags = {};   // Reset earlier flags
+  // Mark all layers to skip, when client target handle is NULL
+  if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Client ||
+      !client_target_valid_) {
+    layer->flags.skip = true;
+  } else if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::SolidColor) {
+    layer->flags.solid_fill = true;
+  }
+
+#ifdef FOD_ZPOS
+  layer->flags.fod_pressed = hwc_layer->IsFodPressed();
+#endif
+
+  if (!hwc_layer->IsDataSpaceSupported()) {
+    layer->flags.skip = true;
+  }
+
+  if (hwc_layer->HasSidebandStream() && !layer->input_buffer.buffer_id) {
+    // Nothing was queued on the stream yet.
+    layer->flags.skip = true;
+  }
+
+  if (hwc_layer->IsSingleBuffered() &&
+     !(hwc_layer->IsRotationPresent() || hwc_layer->IsScalingPresent())) {
+    layer->flags.single_buffer = true;
+  }
+
+  bool hdr_layer = layer->input_buffer.color_metadata.colorPrimaries == ColorPrimaries_BT2020 &&
+                   (layer->input_buffer.color_metadata.transfer == Transfer_SMPTE_ST2084 ||
+                   layer->input_buffer.color_metadata.transfer == Transfer_HLG);
+  if (hdr_layer && !disable_hdr_handling_) {
+    // Dont honor HDR when its handling is disabled
+    layer->input_buffer.flags.hdr = true;
+  }
+
+  if (hwc_layer->IsNonIntegralSourceCrop() && !is_secure && !hdr_layer &&
+      !layer->flags.single_buffer && !layer->flags.solid_fill && !is_video) {
+    layer->flags.skip = true;
+  }
+
+  if (!layer->flags.skip &&
+      (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Cursor)) {
+    // Currently we support only one HWCursor & only at top most z-order
+    if (top_layer_id_ == hwc_layer->GetId()) {
+      layer->flags.cursor = true;
+    }
+  }
+
+  // TODO(user): Move to a getter if this is needed at other places
+  hwc_rect_t scaled_display_frame = {INT(layer->dst_rect.left), INT(layer->dst_rect.top),
+                                     INT(layer->dst_rect.right), INT(layer->dst_rect.bottom)};
+  if (hwc_layer->GetGeometryChanges() & kDisplayFrame) {
+    ApplyScanAdjustment(&scaled_display_frame);
+  }
+  hwc_layer->SetLayerDisplayFrame(scaled_display_frame);
+  hwc_layer->ResetPerFrameData();
+
+  if (hwc_layer->IsColorTransformSet()) {
+    layer->flags.color_transform = true;
+  }
+
+  if (game_supported_ && (hwc_layer->GetType() == kLayerGame)) {
+    layer->flags.is_game = true;
+    layer->input_buffer.flags.game = true;
+  }
+
+  hwc_layer->SetCachedFlags(layer->flags);
 }
 
 void HWCDisplay::BuildSolidFillStack() {
-  layer_stack_ = LayerStack();
+  ResetLayerStack();
   display_rect_ = LayerRect();
 
   layer_stack_.layers.push_back(solid_fill_layer_);
@@ -855,7 +1174,7 @@ void HWCDisplay::BuildSolidFillStack() {
 }
 
 HWC2::Error HWCDisplay::SetLayerType(hwc2_layer_t layer_id, IQtiComposerClient::LayerType type) {
-  const auto map_layer = layer_map_.find(layer_id);
+  const auto map_layer = FindLayer(layer_id);
   if (map_layer == layer_map_.end()) {
     DLOGE("[%" PRIu64 "] SetLayerType failed to find layer", id_);
     return HWC2::Error::BadLayer;
@@ -867,34 +1186,21 @@ HWC2::Error HWCDisplay::SetLayerType(hwc2_layer_t layer_id, IQtiComposerClient::
 }
 
 HWC2::Error HWCDisplay::SetLayerZOrder(hwc2_layer_t layer_id, uint32_t z) {
-  const auto map_layer = layer_map_.find(layer_id);
+  const auto map_layer = FindLayer(layer_id);
   if (map_layer == layer_map_.end()) {
     DLOGW("[%" PRIu64 "] updateLayerZ failed to find layer", id_);
     return HWC2::Error::BadLayer;
   }
 
+  // Every layer in layer_map_ is also in layer_set_.
   const auto layer = map_layer->second;
-  const auto z_range = layer_set_.equal_range(layer);
-  bool layer_on_display = false;
-  for (auto current = z_range.first; current != z_range.second; ++current) {
-    if (*current == layer) {
-      if ((*current)->GetZ() == z) {
-        // Don't change anything if the Z hasn't changed
-        return HWC2::Error::None;
-      }
-      current = layer_set_.erase(current);
-      layer_on_display = true;
-      break;
-    }
-  }
-
-  if (!layer_on_display) {
-    DLOGE("[%" PRIu64 "] updateLayerZ failed to find layer on display", id_);
-    return HWC2::Error::BadLayer;
+  if (layer->GetZ() == z) {
+    // Don't change anything if the Z hasn't changed
+    return HWC2::Error::None;
   }
 
   layer->SetLayerZOrder(z);
-  layer_set_.emplace(layer);
+  layer_set_unsorted_ = true;
   return HWC2::Error::None;
 }
 
@@ -916,7 +1222,9 @@ HWC2::Error HWCDisplay::SetVsyncEnabled(HWC2::Vsync enabled) {
   else
     return HWC2::Error::BadParameter;
 
-  error = display_intf_->SetVSyncState(state);
+  // Sideband layers need vsync whether the client does or not.
+  client_vsync_enabled_.store(state, std::memory_order_relaxed);
+  error = display_intf_->SetVSyncState(state || sideband_active_.load(std::memory_order_relaxed));
 
   if (error != kErrorNone) {
     if (error == kErrorShutDown) {
@@ -935,17 +1243,18 @@ void HWCDisplay::PostPowerMode() {
     return;
   }
 
+  // Layers of the last commit share its release fence, so reuse the merge across layers.
+  shared_ptr<Fence> last_fence = nullptr;
+  shared_ptr<Fence> last_merged_fence = release_fence_;
   for (auto hwc_layer : layer_set_) {
     shared_ptr<Fence> fence = nullptr;
-    shared_ptr<Fence> merged_fence = nullptr;
 
     hwc_layer->PopBackReleaseFence(&fence);
-    if (fence) {
-      merged_fence = Fence::Merge(release_fence_, fence);
-    } else {
-      merged_fence = release_fence_;
+    if (fence != last_fence) {
+      last_merged_fence = Fence::Merge(release_fence_, fence);
+      last_fence = fence;
     }
-    hwc_layer->PushBackReleaseFence(merged_fence);
+    hwc_layer->PushBackReleaseFence(last_merged_fence);
   }
 
   fbt_release_fence_ = release_fence_;
@@ -1003,6 +1312,12 @@ HWC2::Error HWCDisplay::SetPowerMode(HWC2::PowerMode mode, bool teardown) {
 
   // Update release fence.
   release_fence_ = release_fence;
+  if (mode == HWC2::PowerMode::Off) {
+    power_mode_request_ns_ = 0;
+  } else if (mode != current_power_mode_) {
+    power_mode_request_from_ = current_power_mode_;
+    power_mode_request_ns_ = FrameTiming::Now();
+  }
   current_power_mode_ = mode;
 
   // Close the release fences in synchronous power updates
@@ -1222,6 +1537,7 @@ HWC2::Error HWCDisplay::SetClientTarget(buffer_handle_t target, shared_ptr<Fence
     return HWC2::Error::None;
   }
 
+  client_update_pending_ = true;
   if (acquire_fence == nullptr) {
     DLOGV_IF(kTagClient, "Re-using cached buffer");
   }
@@ -1276,7 +1592,7 @@ HWC2::Error HWCDisplay::SetActiveConfig(hwc2_config_t config) {
   validated_ = false;
 
   // Trigger refresh. This config gets applied on next commit.
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonConfig);
 
   return HWC2::Error::None;
 }
@@ -1305,22 +1621,206 @@ HWC2::PowerMode HWCDisplay::GetCurrentPowerMode() {
 }
 
 DisplayError HWCDisplay::VSync(const DisplayEventVSync &vsync) {
+  if (event_channel_.IsActive()) {
+    event_channel_.Publish(DISPLAY_EVENT_VSYNC, 0, vsync.timestamp);
+  }
+
+  last_vsync_timestamp_.store(vsync.timestamp, std::memory_order_relaxed);
+  if (sideband_active_.load(std::memory_order_acquire)) {
+    {
+      std::lock_guard<std::mutex> lock(sideband_thread_lock_);
+      sideband_vsync_timestamp_ = vsync.timestamp;
+    }
+    sideband_thread_cv_.notify_one();
+    if (!client_vsync_enabled_.load(std::memory_order_relaxed)) {
+      return kErrorNone;
+    }
+  }
+
+  if (!vsync_thread_running_.load(std::memory_order_acquire)) {
+    DeliverVSync(vsync.timestamp);
+    return kErrorNone;
+  }
+
+  // Latest timestamp wins if the previous one has not been delivered yet.
+  pending_vsync_timestamp_.store(vsync.timestamp, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(vsync_thread_lock_);
+  }
+  vsync_thread_cv_.notify_one();
+
+  return kErrorNone;
+}
+
+void HWCDisplay::DeliverVSync(int64_t timestamp) {
   if (callbacks_->Vsync_2_4CallbackRegistered()) {
     VsyncPeriodNanos vsync_period;
     if (GetDisplayVsyncPeriod(&vsync_period) != HWC2::Error::None) {
       vsync_period = 0;
     }
     ATRACE_INT("VsyncPeriod", INT32(vsync_period));
-    callbacks_->Vsync_2_4(id_, vsync.timestamp, vsync_period);
+    callbacks_->Vsync_2_4(id_, timestamp, vsync_period);
   } else {
-    callbacks_->Vsync(id_, vsync.timestamp);
+    callbacks_->Vsync(id_, timestamp);
   }
 
-  return kErrorNone;
+  int64_t delay = systemTime(SYSTEM_TIME_MONOTONIC) - timestamp;
+  vsync_delivery_delay_ns_.store(delay, std::memory_order_relaxed);
+  if (delay > max_vsync_delivery_delay_ns_.load(std::memory_order_relaxed)) {
+    max_vsync_delivery_delay_ns_.store(delay, std::memory_order_relaxed);
+  }
+  ATRACE_INT("VsyncDeliveryDelayUs", INT32(delay / 1000));
+}
+
+void HWCDisplay::StartVSyncThread() {
+  vsync_thread_exit_ = false;
+  vsync_thread_ = std::thread(&HWCDisplay::VSyncThread, this);
+  vsync_thread_running_.store(true, std::memory_order_release);
+}
+
+void HWCDisplay::StopVSyncThread() {
+  if (!vsync_thread_.joinable()) {
+    return;
+  }
+
+  vsync_thread_running_.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(vsync_thread_lock_);
+    vsync_thread_exit_ = true;
+  }
+  vsync_thread_cv_.notify_one();
+  vsync_thread_.join();
+}
+
+void HWCDisplay::VSyncThread() {
+  ThreadPolicy::Apply(kThreadClassPresent, "HWC_VSyncThread");
+
+  while (true) {
+    int64_t timestamp = 0;
+    {
+      std::unique_lock<std::mutex> lock(vsync_thread_lock_);
+      vsync_thread_cv_.wait(lock, [this] {
+        return vsync_thread_exit_ || pending_vsync_timestamp_.load(std::memory_order_acquire);
+      });
+      if (vsync_thread_exit_) {
+        break;
+      }
+      timestamp = pending_vsync_timestamp_.exchange(0, std::memory_order_acq_rel);
+    }
+
+    DeliverVSync(timestamp);
+  }
+}
+
+void HWCDisplay::StopSidebandThread() {
+  if (!sideband_thread_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(sideband_thread_lock_);
+    sideband_thread_exit_ = true;
+  }
+  sideband_thread_cv_.notify_one();
+  sideband_thread_.join();
+}
+
+void HWCDisplay::SidebandThread() {
+  ThreadPolicy::Apply(kThreadClassPresent, "HWC_SidebandThread");
+
+  while (true) {
+    int64_t timestamp = 0;
+    {
+      std::unique_lock<std::mutex> lock(sideband_thread_lock_);
+      sideband_thread_cv_.wait(lock, [this] {
+        return sideband_thread_exit_ || sideband_vsync_timestamp_;
+      });
+      if (sideband_thread_exit_) {
+        break;
+      }
+      timestamp = sideband_vsync_timestamp_;
+      sideband_vsync_timestamp_ = 0;
+    }
+
+    // The display is not waited for. A client frame in flight latches the frames due with it,
+    // and the thread is stopped with the display lock held.
+    if (HWCSession::locker_[id_].TryLock()) {
+      sideband_busy_vsyncs_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    PresentSidebandFrame(timestamp);
+    HWCSession::locker_[id_].Unlock();
+  }
+}
+
+bool HWCDisplay::LatchSidebandFrames(int64_t vsync_ns) {
+  VsyncPeriodNanos vsync_period = 0;
+  if (GetDisplayVsyncPeriod(&vsync_period) != HWC2::Error::None) {
+    return false;
+  }
+
+  bool latched = false;
+  for (auto hwc_layer : layer_set_) {
+    if (!hwc_layer->LatchSidebandFrame(vsync_ns, static_cast<int64_t>(vsync_period))) {
+      continue;
+    }
+    latched = true;
+    if (hwc_layer->GetGeometryChanges()) {
+      // A frame of another size or format has to be validated first.
+      validated_ = false;
+    }
+  }
+
+  return latched;
+}
+
+void HWCDisplay::PresentSidebandFrame(int64_t vsync_ns) {
+  if (shutdown_pending_ || current_power_mode_ == HWC2::PowerMode::Off ||
+      !LatchSidebandFrames(vsync_ns)) {
+    return;
+  }
+
+  // The client presents the frames latched along with its own updates.
+  if (client_update_pending_) {
+    return;
+  }
+
+  // The layer stack last presented is committed again with the new frames, as long as the
+  // composition it was validated with still holds.
+  bool device_composed =
+      std::all_of(layer_set_.begin(), layer_set_.end(), [](HWCLayer *hwc_layer) {
+        LayerComposition composition = hwc_layer->GetSDMLayer()->composition;
+        return (composition == kCompositionSDE) || (composition == kCompositionCursor);
+      });
+  if (validate_state_ != kSkipValidate || !device_composed || !CanSkipValidate()) {
+    sideband_refreshes_++;
+    callbacks_->Refresh(id_, kRefreshReasonSideband);
+    return;
+  }
+
+  if (CommitLayerStack() != HWC2::Error::None || flush_) {
+    // Flushed by the next present of the client.
+    callbacks_->Refresh(id_, kRefreshReasonSideband);
+    return;
+  }
+
+  PostCommitSidebandFrame();
+  sideband_commits_++;
+}
+
+void HWCDisplay::PostCommitSidebandFrame() {
+  // Buffers of the client stay on screen, and are released by the fences of its next present.
+  for (auto hwc_layer : layer_set_) {
+    LayerBuffer *layer_buffer = &hwc_layer->GetSDMLayer()->input_buffer;
+    if (hwc_layer->HasSidebandStream()) {
+      hwc_layer->OnSidebandCommitted(layer_buffer->release_fence);
+    }
+    layer_buffer->acquire_fence = nullptr;
+  }
 }
 
 DisplayError HWCDisplay::Refresh() {
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonCore);
   return kErrorNone;
 }
 
@@ -1406,6 +1906,7 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
   UpdateActiveConfig();
   DisplayError error = display_intf_->Prepare(&layer_stack_);
   if (error != kErrorNone) {
+    client_layers_hash_ = 0;
     if (error == kErrorShutDown) {
       shutdown_pending_ = true;
     } else if (error == kErrorPermission) {
@@ -1421,7 +1922,7 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
       // Prepare cycle can fail on a newly connected display if insufficient pipes
       // are available at this moment. Trigger refresh so that the other displays
       // can free up pipes and a valid content can be attached to virtual display.
-      callbacks_->Refresh(id_);
+      callbacks_->Refresh(id_, kRefreshReasonResources);
       return HWC2::Error::BadDisplay;
     }
   } else {
@@ -1429,24 +1930,36 @@ HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out
     geometry_changes_on_doze_suspend_ = GeometryChanges::kNone;
   }
 
+  // When SDM picks the same GPU layers as for the current client target, with none of them
+  // updating, they are reported as Device so that SurfaceFlinger skips its GPU pass and the
+  // cached client target is composed again.
+  uint64_t client_layers_hash = GetClientLayersHash();
+  bool reuse_client_target = client_layers_hash && (client_layers_hash == client_layers_hash_);
+  client_layers_hash_ = client_layers_hash;
+  client_target_reuses_ += reuse_client_target;
+
   for (auto hwc_layer : layer_set_) {
     Layer *layer = hwc_layer->GetSDMLayer();
     LayerComposition &composition = layer->composition;
 
     if (composition == kCompositionSDE || composition == kCompositionStitch) {
-      layer_requests_[hwc_layer->GetId()] = HWC2::LayerRequest::ClearClientTarget;
+      layer_requests_.emplace_back(hwc_layer->GetId(), HWC2::LayerRequest::ClearClientTarget);
     }
 
     HWC2::Composition requested_composition = hwc_layer->GetClientRequestedCompositionType();
     // Set SDM composition to HWC2 type in HWCLayer
-    hwc_layer->SetComposition(composition);
+    if (reuse_client_target && composition == kCompositionGPU) {
+      hwc_layer->SetComposition(kCompositionSDE);
+    } else {
+      hwc_layer->SetComposition(composition);
+    }
     HWC2::Composition device_composition  = hwc_layer->GetDeviceSelectedCompositionType();
     if (device_composition == HWC2::Composition::Client) {
       has_client_composition_ = true;
     }
     // Update the changes list only if the requested composition is different from SDM comp type
     if (requested_composition != device_composition) {
-      layer_changes_[hwc_layer->GetId()] = device_composition;
+      layer_changes_.emplace_back(hwc_layer->GetId(), device_composition);
     }
     hwc_layer->ResetValidation();
   }
@@ -1471,7 +1984,8 @@ HWC2::Error HWCDisplay::AcceptDisplayChanges() {
   }
 
   for (const auto& change : layer_changes_) {
-    auto hwc_layer = layer_map_[change.first];
+    auto map_layer = FindLayer(change.first);
+    auto hwc_layer = (map_layer != layer_map_.end()) ? map_layer->second : nullptr;
     auto composition = change.second;
     if (hwc_layer != nullptr) {
       hwc_layer->UpdateClientCompositionType(composition);
@@ -1654,16 +2168,38 @@ HWC2::Error HWCDisplay::CommitLayerStack(void) {
     }
   }
 
-  if (elapse_timestamp_) {
-    layer_stack_.elapse_timestamp = elapse_timestamp_;
+  uint64_t hold_until = ScheduleExpectedPresent();
+  if (hold_until) {
+    layer_stack_.elapse_timestamp = hold_until;
+  }
+  if (fence_deadlines_) {
+    SetAcquireFenceDeadlines(hold_until);
+  }
+  uint64_t expected_vsync = 0, vsync_period = 0;
+  if (jank_recorder_.IsActive()) {
+    GetExpectedVSync(hold_until, &expected_vsync, &vsync_period);
   }
 
   error = display_intf_->Commit(&layer_stack_);
+  layer_stack_.elapse_timestamp = 0;
 
   if (error == kErrorNone) {
     // A commit is successfully submitted, start flushing on failure now onwards.
     flush_on_error_ = true;
     first_cycle_ = false;
+    if (power_mode_request_ns_) {
+      power_transition_ns_ = FrameTiming::Now() - power_mode_request_ns_;
+      power_transition_from_ = power_mode_request_from_;
+      power_transition_to_ = current_power_mode_;
+      power_mode_request_ns_ = 0;
+    }
+    present_count_++;
+    jank_recorder_.OnCommit(layer_stack_, present_count_, expected_vsync, vsync_period,
+                            HWCSession::locker_[id_].GetLastWaitNs(), hold_until != 0);
+    if (event_channel_.IsActive()) {
+      event_channel_.Publish(DISPLAY_EVENT_PRESENT, present_count_,
+                             static_cast<int64_t>(FrameTiming::Now()));
+    }
   } else {
     if (error == kErrorShutDown) {
       shutdown_pending_ = true;
@@ -1696,6 +2232,9 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(shared_ptr<Fence> *out_retire_fence
      tone_mapper_->PostCommit(&layer_stack_);
   }
 
+  // Return intermediate buffers idle for a while to gralloc.
+  buffer_allocator_->TrimBufferPool(false /* free_all */);
+
   // TODO(user): No way to set the client target release fence on SF
   shared_ptr<Fence> client_target_release_fence =
       client_target_->GetSDMLayer()->input_buffer.release_fence;
@@ -1709,7 +2248,11 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(shared_ptr<Fence> *out_retire_fence
     Layer *layer = hwc_layer->GetSDMLayer();
     LayerBuffer *layer_buffer = &layer->input_buffer;
 
-    if (!flush_) {
+    if (!flush_ && hwc_layer->HasSidebandStream()) {
+      // Frames are returned to the producer of the stream, the client has no buffer to release.
+      hwc_layer->OnSidebandCommitted(layer_buffer->release_fence);
+      hwc_layer->PushBackReleaseFence(nullptr);
+    } else if (!flush_) {
       // If swapinterval property is set to 0 or for single buffer layers, do not update f/w
       // release fences and discard fences from driver
       if (!swap_interval_zero_ && !layer->flags.single_buffer) {
@@ -1740,10 +2283,19 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(shared_ptr<Fence> *out_retire_fence
     dump_frame_index_++;
   }
 
+  UpdateStatePage();
+  UpdateWarmState();
+  PublishRetire();
+
   layer_stack_.flags.geometry_changed = false;
   geometry_changes_ = GeometryChanges::kNone;
+  if (flush_) {
+    // The flushed client target was never shown.
+    client_layers_hash_ = 0;
+  }
   flush_ = false;
   skip_commit_ = false;
+  client_update_pending_ = false;
 
   // Handle pending config changes.
   if (pending_first_commit_config_) {
@@ -1770,6 +2322,35 @@ DisplayError HWCDisplay::SetMaxMixerStages(uint32_t max_mixer_stages) {
   return error;
 }
 
+bool HWCDisplay::InitFrameDumpRing(const char *dir_path) {
+  if (frame_dump_ring_size_mb_ <= 0) {
+    return false;
+  }
+
+  if (!frame_dumper_.IsActive()) {
+    FrameDumpOptions options;
+    int compress = 1;
+    HWCDebugHandler::Get()->GetProperty(FRAME_DUMP_COMPRESS_PROP, &compress);
+    options.compress = (compress != 0);
+    char value[PROPERTY_VALUE_MAX] = {};
+    if (HWCDebugHandler::Get()->GetProperty(FRAME_DUMP_USAGE_MASK_PROP, value) == kErrorNone) {
+      options.usage_mask = strtoull(value, nullptr, 0);
+    }
+    if (HWCDebugHandler::Get()->GetProperty(FRAME_DUMP_NAME_PROP, value) == kErrorNone) {
+      options.name = value;
+    }
+
+    size_t ring_size = size_t(frame_dump_ring_size_mb_) * 1024 * 1024;
+    if (frame_dumper_.Init(dir_path, ring_size, options) != 0) {
+      // Fall back to one file per buffer.
+      frame_dump_ring_size_mb_ = 0;
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void HWCDisplay::DumpInputBuffers() {
   char dir_path[PATH_MAX];
   int  status;
@@ -1794,6 +2375,34 @@ void HWCDisplay::DumpInputBuffers() {
     return;
   }
 
+  if (InitFrameDumpRing(dir_path)) {
+    // Only enqueue the buffers; the dumper waits for the acquire fences and copies them.
+    for (uint32_t i = 0; i < layer_stack_.layers.size(); i++) {
+      auto layer = layer_stack_.layers.at(i);
+      const private_handle_t *pvt_handle =
+          reinterpret_cast<const private_handle_t *>(layer->input_buffer.buffer_id);
+      if (!pvt_handle) {
+        continue;
+      }
+
+      FrameDumpRecord record = {};
+      record.frame_index = dump_frame_index_;
+      record.layer_index = i;
+      record.width = UINT32(pvt_handle->width);
+      record.height = UINT32(pvt_handle->height);
+      record.format = pvt_handle->format;
+      snprintf(record.format_name, sizeof(record.format_name), "%s",
+               qdutils::GetHALPixelFormatString(pvt_handle->format));
+      record.unaligned_width = UINT32(pvt_handle->unaligned_width);
+      record.unaligned_height = UINT32(pvt_handle->unaligned_height);
+      record.usage = pvt_handle->usage;
+      record.buffer_flags = UINT32(pvt_handle->flags);
+      frame_dumper_.DumpBuffer(pvt_handle->fd, pvt_handle->size, pvt_handle->fd_metadata,
+                               layer->input_buffer.acquire_fence, record);
+    }
+    return;
+  }
+
   for (uint32_t i = 0; i < layer_stack_.layers.size(); i++) {
     auto layer = layer_stack_.layers.at(i);
     const private_handle_t *pvt_handle =
@@ -1860,6 +2469,23 @@ void HWCDisplay::DumpOutputBuffer(const BufferInfo &buffer_info, void *base,
     return;
   }
 
+  // The caller unmaps base right after this call, so the dumper maps the buffer fd itself.
+  if (base && buffer_info.alloc_buffer_info.fd >= 0 && InitFrameDumpRing(dir_path)) {
+    FrameDumpRecord record = {};
+    record.frame_index = dump_frame_index_;
+    record.layer_index = UINT32_MAX;  // Output buffer
+    record.width = buffer_info.alloc_buffer_info.aligned_width;
+    record.height = buffer_info.alloc_buffer_info.aligned_height;
+    record.format = buffer_info.buffer_config.format;
+    snprintf(record.format_name, sizeof(record.format_name), "%s",
+             GetFormatString(buffer_info.buffer_config.format));
+    record.unaligned_width = buffer_info.buffer_config.width;
+    record.unaligned_height = buffer_info.buffer_config.height;
+    frame_dumper_.DumpBuffer(buffer_info.alloc_buffer_info.fd, buffer_info.alloc_buffer_info.size,
+                             -1, retire_fence, record);
+    return;
+  }
+
   if (base) {
     char dump_file_name[PATH_MAX];
     size_t result = 0;
@@ -2038,6 +2664,18 @@ int HWCDisplay::SetDisplayStatus(DisplayStatus display_status) {
   return status;
 }
 
+HWC2::Error HWCDisplay::PrefetchLayerBuffer(hwc2_layer_t layer_id) {
+  HWCLayer *hwc_layer = GetHWCLayer(layer_id);
+  if (hwc_layer == nullptr) {
+    return HWC2::Error::BadLayer;
+  }
+
+  // Best effort, commit path creates the fb_id if it is not ready.
+  display_intf_->PrefetchFbId(hwc_layer->GetSDMLayer());
+
+  return HWC2::Error::None;
+}
+
 HWC2::Error HWCDisplay::SetCursorPosition(hwc2_layer_t layer, int x, int y) {
   if (shutdown_pending_) {
     return HWC2::Error::None;
@@ -2285,6 +2923,64 @@ uint32_t HWCDisplay::GetUpdatingLayersCount(void) {
   return updating_count;
 }
 
+// FNV-1a over what SurfaceFlinger renders the client target from, or 0 when it can not be reused.
+uint64_t HWCDisplay::GetClientLayersHash() {
+  Layer *client_target = client_target_->GetSDMLayer();
+  if (!enable_client_target_reuse_ || !client_target->input_buffer.buffer_id) {
+    return 0;
+  }
+
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const void *data, size_t size) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+
+  bool has_gpu_layers = false;
+  for (auto hwc_layer : layer_set_) {
+    Layer *layer = hwc_layer->GetSDMLayer();
+    // SurfaceFlinger composes layers it forces to Client regardless of what is reported.
+    if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Client) {
+      return 0;
+    }
+    if (layer->composition != kCompositionGPU) {
+      continue;
+    }
+    if (layer->flags.updating) {
+      return 0;
+    }
+
+    hwc2_layer_t id = hwc_layer->GetId();
+    uint32_t z = hwc_layer->GetZ();
+    int32_t dataspace = hwc_layer->GetLayerDataspace();
+    mix(&id, sizeof(id));
+    mix(&z, sizeof(z));
+    mix(&dataspace, sizeof(dataspace));
+    mix(&layer->input_buffer.buffer_id, sizeof(layer->input_buffer.buffer_id));
+    mix(&layer->src_rect, sizeof(layer->src_rect));
+    mix(&layer->dst_rect, sizeof(layer->dst_rect));
+    mix(&layer->transform.rotation, sizeof(layer->transform.rotation));
+    mix(&layer->transform.flip_horizontal, sizeof(layer->transform.flip_horizontal));
+    mix(&layer->transform.flip_vertical, sizeof(layer->transform.flip_vertical));
+    mix(&layer->blending, sizeof(layer->blending));
+    mix(&layer->plane_alpha, sizeof(layer->plane_alpha));
+    mix(&layer->solid_fill_color, sizeof(layer->solid_fill_color));
+    has_gpu_layers = true;
+  }
+
+  if (!has_gpu_layers) {
+    return 0;
+  }
+
+  int32_t dataspace = client_target_->GetLayerDataspace();
+  mix(&dataspace, sizeof(dataspace));
+  mix(&client_target->dst_rect, sizeof(client_target->dst_rect));
+
+  return hash ? hash : 1;
+}
+
 bool HWCDisplay::IsLayerUpdating(HWCLayer *hwc_layer) {
   auto layer = hwc_layer->GetSDMLayer();
   // Layer should be considered updating if
@@ -2292,8 +2988,18 @@ bool HWCDisplay::IsLayerUpdating(HWCLayer *hwc_layer) {
   //   b) valid dirty_regions(android specific hint for updating status), or
   //   c) layer stack geometry has changed (TODO(user): Remove when SDM accepts
   //      geometry_changed as bit fields).
-  return (layer->flags.single_buffer || hwc_layer->IsSurfaceUpdated() ||
-          geometry_changes_);
+  // A damaged layer whose content hashes the same as in the previous frame is not updating, so
+  // apps that redraw identical frames do not hold off idle fallback.
+  if (layer->flags.single_buffer || geometry_changes_) {
+    return true;
+  }
+
+  if (!hwc_layer->IsSurfaceUpdated()) {
+    return false;
+  }
+
+  return !((content_signature_max_pixels_ > 0) &&
+           hwc_layer->IsContentUnchanged(UINT32(content_signature_max_pixels_)));
 }
 
 uint32_t HWCDisplay::SanitizeRefreshRate(uint32_t req_refresh_rate) {
@@ -2317,30 +3023,61 @@ DisplayClass HWCDisplay::GetDisplayClass() {
   return display_class_;
 }
 
-void HWCDisplay::Dump(std::ostringstream *os) {
+void HWCDisplay::Dump(std::ostringstream *os, DumpLevel level) {
+  SortLayerSet();
   *os << "\n------------HWC----------------\n";
   *os << "HWC2 display_id: " << id_ << std::endl;
-  for (auto layer : layer_set_) {
-    auto sdm_layer = layer->GetSDMLayer();
-    auto transform = sdm_layer->transform;
-    *os << "layer: " << std::setw(4) << layer->GetId();
-    *os << " z: " << layer->GetZ();
-    *os << " composition: " <<
-          to_string(layer->GetClientRequestedCompositionType()).c_str();
-    *os << "/" <<
-          to_string(layer->GetDeviceSelectedCompositionType()).c_str();
-    *os << " alpha: " << std::to_string(sdm_layer->plane_alpha).c_str();
-    *os << " format: " << std::setw(22) << GetFormatString(sdm_layer->input_buffer.format);
-    *os << " dataspace:" << std::hex << "0x" << std::setw(8) << std::setfill('0')
-        << layer->GetLayerDataspace() << std::dec << std::setfill(' ');
-    *os << " transform: " << transform.rotation << "/" << transform.flip_horizontal <<
-          "/"<< transform.flip_vertical;
-    *os << " buffer_id: " << std::hex << "0x" << sdm_layer->input_buffer.buffer_id << std::dec;
-    *os << " secure: " << layer->IsProtected()
-        << std::endl;
+  if (enable_client_target_reuse_) {
+    *os << "client target reuses: " << client_target_reuses_ << std::endl;
   }
-
-  if (has_client_composition_) {
+  if (solid_fill_detect_max_pixels_ > 0) {
+    *os << "solid fill promotions: " << solid_fill_promotions_ << std::endl;
+  }
+  if (expected_presents_on_time_ || expected_presents_late_) {
+    *os << "expected presents on time: " << expected_presents_on_time_ << " late: "
+        << expected_presents_late_ << " dropped: " << expected_presents_dropped_;
+    if (expected_present_holds_) {
+      *os << " hold avg/max (us): "
+          << expected_present_hold_ns_total_ / static_cast<int64_t>(expected_present_holds_) / 1000
+          << "/" << expected_present_hold_ns_max_ / 1000;
+    }
+    *os << std::endl;
+  }
+  if (sideband_active_.load(std::memory_order_relaxed) || sideband_commits_) {
+    *os << "sideband commits: " << sideband_commits_ << " refreshes: " << sideband_refreshes_
+        << " busy vsyncs: " << sideband_busy_vsyncs_.load(std::memory_order_relaxed) << std::endl;
+  }
+  if (config_switches_) {
+    *os << "config switches: " << config_switches_ << " late avg/max (us): "
+        << config_switch_late_ns_total_ / static_cast<int64_t>(config_switches_) / 1000 << "/"
+        << config_switch_late_ns_max_ / 1000 << std::endl;
+  }
+  if (level == kDumpLevelPerf) {
+    *os << "layers: " << layer_set_.size() << " client composition: " << has_client_composition_
+        << std::endl;
+  } else {
+    for (auto layer : layer_set_) {
+      auto sdm_layer = layer->GetSDMLayer();
+      auto transform = sdm_layer->transform;
+      *os << "layer: " << std::setw(4) << layer->GetId();
+      *os << " z: " << layer->GetZ();
+      *os << " composition: " <<
+            to_string(layer->GetClientRequestedCompositionType()).c_str();
+      *os << "/" <<
+            to_string(layer->GetDeviceSelectedCompositionType()).c_str();
+      *os << " alpha: " << std::to_string(sdm_layer->plane_alpha).c_str();
+      *os << " format: " << std::setw(22) << GetFormatString(sdm_layer->input_buffer.format);
+      *os << " dataspace:" << std::hex << "0x" << std::setw(8) << std::setfill('0')
+          << layer->GetLayerDataspace() << std::dec << std::setfill(' ');
+      *os << " transform: " << transform.rotation << "/" << transform.flip_horizontal <<
+            "/"<< transform.flip_vertical;
+      *os << " buffer_id: " << std::hex << "0x" << sdm_layer->input_buffer.buffer_id << std::dec;
+      *os << " secure: " << layer->IsProtected()
+          << std::endl;
+    }
+  }
+
+  if (has_client_composition_ && level == kDumpLevelFull) {
     *os << "\n---------client target---------\n";
     auto sdm_layer = client_target_->GetSDMLayer();
     *os << "format: " << std::setw(14) << GetFormatString(sdm_layer->input_buffer.format);
@@ -2363,12 +3100,37 @@ void HWCDisplay::Dump(std::ostringstream *os) {
 
   if (display_intf_) {
     *os << "\n------------SDM----------------\n";
-    *os << display_intf_->Dump();
+    *os << display_intf_->Dump(level);
+  }
+
+  FrameTiming::Dump(sdm_id_, os);
+  jank_recorder_.Dump(os);
+  *os << "VSync delivery delay (us): last: "
+      << (vsync_delivery_delay_ns_.load(std::memory_order_relaxed) / 1000)
+      << " max: " << (max_vsync_delivery_delay_ns_.load(std::memory_order_relaxed) / 1000)
+      << std::endl;
+  if (power_transition_ns_) {
+    *os << "Power transition " << to_string(power_transition_from_).c_str() << " -> "
+        << to_string(power_transition_to_).c_str() << " to first commit (us): "
+        << (power_transition_ns_ / 1000) << std::endl;
   }
 
   *os << "\n";
 }
 
+void HWCDisplay::TraceFrameTiming() {
+  if (!ATRACE_ENABLED()) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < kFrameStageMax; i++) {
+    FrameStage stage = static_cast<FrameStage>(i);
+    std::string name = "FrameTiming" + std::to_string(sdm_id_) + FrameTiming::GetStageName(stage);
+    uint64_t latest_us = FrameTiming::GetLatest(sdm_id_, stage) / 1000;
+    ATRACE_INT64(name.c_str(), static_cast<int64_t>(latest_us));
+  }
+}
+
 bool HWCDisplay::CanSkipValidate() {
   if (!validated_ || solid_fill_enable_) {
     return false;
@@ -2388,7 +3150,11 @@ bool HWCDisplay::CanSkipValidate() {
 
   for (auto hwc_layer : layer_set_) {
     Layer *layer = hwc_layer->GetSDMLayer();
-    if (hwc_layer->NeedsValidation()) {
+    // Content only updates on device composed layers are presented as predicted by the last
+    // validate, unless the panel's partial update ROI has to follow the new damage.
+    bool predicted = !panel_partial_update_ && hwc_layer->HasContentOnlyUpdate() &&
+                     (layer->composition == kCompositionSDE);
+    if (hwc_layer->NeedsValidation() && !predicted) {
       DLOGV_IF(kTagClient, "hwc_layer[%" PRIu64 "] needs validation. Returning false.",
                hwc_layer->GetId());
       return false;
@@ -2429,10 +3195,100 @@ HWC2::Error HWCDisplay::GetDisplayIdentificationData(uint8_t *out_port, uint32_t
 }
 
 HWC2::Error HWCDisplay::SetDisplayElapseTime(uint64_t time) {
-  elapse_timestamp_ = time;
+  if (!time) {
+    expected_presents_.clear();
+    return HWC2::Error::None;
+  }
+
+  if (expected_presents_.size() >= kMaxExpectedPresents) {
+    expected_presents_.pop_front();
+    expected_presents_dropped_++;
+  }
+  expected_presents_.push_back(time);
+  // Keeps a vsync driven sideband commit from taking the target meant for the client's frame.
+  MarkClientUpdate();
+  display_intf_->SetExpectedPresentTime(time);
+
   return HWC2::Error::None;
 }
 
+uint64_t HWCDisplay::ScheduleExpectedPresent() {
+  if (expected_presents_.empty()) {
+    return 0;
+  }
+
+  int64_t target = static_cast<int64_t>(expected_presents_.front());
+  expected_presents_.pop_front();
+
+  // The frame reaches the panel at the predicted next vsync at the earliest. Without a locked
+  // vsync model the target itself is taken as the vsync to aim for.
+  int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+  int64_t next_vsync = 0, vsync_period = 0;
+  int64_t present_vsync = target;
+  int64_t late_ns = 0;
+  if ((display_intf_->GetPredictedVSync(&next_vsync, &vsync_period) == kErrorNone) &&
+      (vsync_period > 0)) {
+    int64_t periods = (target - next_vsync + (vsync_period / 2)) / vsync_period;
+    present_vsync = next_vsync + (std::max<int64_t>(periods, 0) * vsync_period);
+    late_ns = next_vsync - target;
+  } else {
+    vsync_period = current_refresh_rate_ ? (1000000000LL / current_refresh_rate_) : 0;
+    late_ns = now - target;
+  }
+
+  if (late_ns > (vsync_period / 2)) {
+    expected_presents_late_++;
+    DLOGV_IF(kTagClient, "Display %" PRIu64 " present %" PRId64 " us late", id_, late_ns / 1000);
+  } else {
+    expected_presents_on_time_++;
+  }
+
+  // Kick off half a period ahead, so the commit is done by the vsync it targets.
+  int64_t hold_until = present_vsync - (vsync_period / 2);
+  if (hold_until <= now) {
+    return 0;
+  }
+
+  int64_t hold_ns = hold_until - now;
+  expected_present_holds_++;
+  expected_present_hold_ns_total_ += hold_ns;
+  expected_present_hold_ns_max_ = std::max(expected_present_hold_ns_max_, hold_ns);
+
+  return UINT64(hold_until);
+}
+
+void HWCDisplay::SetAcquireFenceDeadlines(uint64_t hold_until) {
+  int64_t next_vsync = 0, vsync_period = 0;
+  if (display_intf_->GetPredictedVSync(&next_vsync, &vsync_period) != kErrorNone) {
+    return;
+  }
+
+  // The driver waits for the buffers before the kickoff, which a held commit delays past the
+  // next vsync. Layers composed by the client are waited on by the GPU, not the display.
+  uint64_t deadline_ns = std::max(UINT64(next_vsync), hold_until);
+  for (auto &layer : layer_stack_.layers) {
+    if (layer->composition != kCompositionGPU && layer->composition != kCompositionStitch) {
+      Fence::SetDeadline(layer->input_buffer.acquire_fence, deadline_ns);
+    }
+  }
+}
+
+void HWCDisplay::GetExpectedVSync(uint64_t hold_until, uint64_t *expected_vsync,
+                                  uint64_t *vsync_period) {
+  int64_t next_vsync = 0, period = 0;
+  if ((display_intf_->GetPredictedVSync(&next_vsync, &period) != kErrorNone) || (period <= 0)) {
+    return;
+  }
+
+  // A held commit is meant for the first vsync after the hold, others for the next one.
+  int64_t periods = 0;
+  if (static_cast<int64_t>(hold_until) > next_vsync) {
+    periods = (static_cast<int64_t>(hold_until) - next_vsync + period - 1) / period;
+  }
+  *expected_vsync = UINT64(next_vsync + (periods * period));
+  *vsync_period = UINT64(period);
+}
+
 bool HWCDisplay::IsDisplayCommandMode() {
   return is_cmd_mode_;
 }
@@ -2476,7 +3332,7 @@ bool HWCDisplay::CanSkipSdmPrepare(uint32_t *num_types, uint32_t *num_requests)
       break;
     }
     if (hwc_layer->GetClientRequestedCompositionType() != HWC2::Composition::Client) {
-      layer_changes_[hwc_layer->GetId()] = HWC2::Composition::Client;
+      layer_changes_.emplace_back(hwc_layer->GetId(), HWC2::Composition::Client);
     }
   }
 
@@ -2493,12 +3349,22 @@ bool HWCDisplay::CanSkipSdmPrepare(uint32_t *num_types, uint32_t *num_requests)
 }
 
 void HWCDisplay::UpdateRefreshRate() {
+  uint32_t refresh_rate = std::min(current_refresh_rate_, HWCDisplay::GetThrottlingRefreshRate());
+  int64_t now_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  int64_t vsync_period_ns = current_refresh_rate_ ? (1000000000LL / current_refresh_rate_) : 0;
   for (auto hwc_layer : layer_set_) {
     if (hwc_layer->HasMetaDataRefreshRate()) {
       continue;
     }
+    // Layers without producer metadata that update at a steady rate report that rate.
     auto layer = hwc_layer->GetSDMLayer();
-    layer->frame_rate = std::min(current_refresh_rate_, HWCDisplay::GetThrottlingRefreshRate());
+    uint32_t fps = 0;
+    if (vsync_period_ns && (hwc_layer->GetCadence().GetState(now_ns, vsync_period_ns, &fps) ==
+                            LayerCadence::kSteady)) {
+      layer->frame_rate = std::min(fps, refresh_rate);
+    } else {
+      layer->frame_rate = refresh_rate;
+    }
   }
 }
 
@@ -2541,6 +3407,7 @@ void HWCDisplay::WaitOnPreviousFence() {
 }
 
 void HWCDisplay::GetLayerStack(HWCLayerStack *stack) {
+  SortLayerSet();
   stack->client_target = client_target_;
   stack->layer_map = layer_map_;
   stack->layer_set = layer_set_;
@@ -2550,6 +3417,8 @@ void HWCDisplay::SetLayerStack(HWCLayerStack *stack) {
   client_target_ = stack->client_target;
   layer_map_ = stack->layer_map;
   layer_set_ = stack->layer_set;
+  layer_set_unsorted_ = false;
+  last_layer_ = nullptr;
 }
 
 bool HWCDisplay::CheckResourceState() {
@@ -2622,7 +3491,20 @@ HWC2::Error HWCDisplay::SetActiveConfigWithConstraints(
 }
 
 void HWCDisplay::ProcessActiveConfigChange() {
-  if (!IsActiveConfigReadyToSubmit(systemTime(SYSTEM_TIME_MONOTONIC))) {
+  if (pending_refresh_rate_config_ == UINT_MAX) {
+    return;
+  }
+
+  // The frame being composed reaches the panel at the next vsync at the earliest. Submitting the
+  // config with it, rather than with a later present, avoids a validate of its own for the switch.
+  int64_t time = systemTime(SYSTEM_TIME_MONOTONIC);
+  int64_t next_vsync = 0, vsync_period = 0;
+  if (early_config_submit_ &&
+      (display_intf_->GetPredictedVSync(&next_vsync, &vsync_period) == kErrorNone)) {
+    time = std::max(time, next_vsync);
+  }
+
+  if (!IsActiveConfigReadyToSubmit(time)) {
     return;
   }
 
@@ -2678,6 +3560,7 @@ std::tuple<int64_t, int64_t> HWCDisplay::RequestActiveConfigChange(
   pending_refresh_rate_config_ = config;
   pending_refresh_rate_refresh_time_ = refresh_time;
   pending_refresh_rate_applied_time_ = applied_time;
+  pending_refresh_rate_desired_time_ = desired_time;
 
   return std::make_tuple(refresh_time, applied_time);
 }
@@ -2697,6 +3580,19 @@ std::tuple<int64_t, int64_t> HWCDisplay::EstimateVsyncPeriodChangeTimeline(
     refresh_time = desired_time - refresh_rate_activate_period;
   }
 
+  int64_t next_vsync = 0, vsync_period = 0;
+  if ((display_intf_->GetPredictedVSync(&next_vsync, &vsync_period) == kErrorNone) &&
+      (vsync_period > 0)) {
+    // A new period only takes effect on a vsync edge, so move the refresh back onto the vsync
+    // grid of the display. Moving it earlier never holds back IsActiveConfigReadyToSubmit().
+    int64_t delta_vsync = refresh_time - next_vsync;
+    int64_t periods = delta_vsync / vsync_period;
+    if ((delta_vsync < 0) && (delta_vsync % vsync_period)) {
+      periods--;
+    }
+    refresh_time = next_vsync + (periods * vsync_period);
+  }
+
   const auto applied_time = refresh_time + refresh_rate_activate_period;
   return std::make_tuple(refresh_time, applied_time);
 }
@@ -2718,9 +3614,17 @@ void HWCDisplay::SubmitActiveConfigChange(VsyncPeriodNanos current_vsync_period)
     callbacks_->VsyncPeriodTimingChanged(id_, &timeline);
   }
 
+  int64_t late_ns = std::max(int64_t(0), timeline.newVsyncAppliedTimeNanos -
+                                         pending_refresh_rate_desired_time_);
+  config_switches_++;
+  config_switch_late_ns_total_ += late_ns;
+  config_switch_late_ns_max_ = std::max(config_switch_late_ns_max_, late_ns);
+  ATRACE_INT("ConfigSwitchLateUs", INT32(late_ns / 1000));
+
   pending_refresh_rate_config_ = UINT_MAX;
   pending_refresh_rate_refresh_time_ = INT64_MAX;
   pending_refresh_rate_applied_time_ = INT64_MAX;
+  pending_refresh_rate_desired_time_ = INT64_MAX;
 }
 
 bool HWCDisplay::IsActiveConfigReadyToSubmit(int64_t time) {
@@ -2794,6 +3698,115 @@ HWC2::Error HWCDisplay::GetCachedActiveConfig(hwc2_config_t *active_config) {
 void HWCDisplay::SetActiveConfigIndex(int index) {
   std::lock_guard<std::mutex> lock(active_config_lock_);
   active_config_index_ = index;
+  state_page_.BumpConfigGeneration();
+}
+
+int HWCDisplay::GetStatePageFd() {
+  if (state_page_.GetFd() < 0) {
+    std::string name = "display_state_" + std::to_string(id_);
+    if (state_page_.Init(name.c_str())) {
+      return -1;
+    }
+  }
+
+  return state_page_.GetFd();
+}
+
+void HWCDisplay::UpdateStatePage() {
+  if (state_page_.GetFd() < 0 || flush_) {
+    return;
+  }
+
+  uint64_t now_ns = FrameTiming::Now();
+  fps_window_frames_++;
+  if (!fps_window_start_ns_) {
+    fps_window_start_ns_ = now_ns;
+  } else if (now_ns - fps_window_start_ns_ >= 1000000000) {
+    fps_ = UINT32(UINT64(fps_window_frames_) * 1000000000 / (now_ns - fps_window_start_ns_));
+    fps_window_start_ns_ = now_ns;
+    fps_window_frames_ = 0;
+  }
+
+  DisplayStatePage *page = state_page_.BeginUpdate();
+  page->frame_count++;
+  page->last_present_ns = now_ns;
+  page->active_config = GetActiveConfigIndex();
+  page->refresh_rate = current_refresh_rate_;
+  page->fps = fps_;
+  page->power_mode = INT32(current_power_mode_);
+  page->qsync_enabled = IsQsyncEnabled();
+  for (auto hwc_layer : layer_set_) {
+    auto type = UINT32(hwc_layer->GetDeviceSelectedCompositionType());
+    if (type < DISPLAY_STATE_COMPOSITION_TYPES) {
+      page->composition_counts[type]++;
+    }
+  }
+  if (last_present_ns_) {
+    uint64_t bucket = std::min(UINT64(DISPLAY_STATE_FRAME_TIME_BUCKETS - 1),
+                               (now_ns - last_present_ns_) / 1000000);
+    page->frame_time_histogram[bucket]++;
+  }
+  state_page_.EndUpdate();
+  last_present_ns_ = now_ns;
+}
+
+void HWCDisplay::UpdateWarmState() {
+  if (!warm_state_ || flush_) {
+    return;
+  }
+
+  hwc2_config_t config = 0;
+  GetCachedActiveConfig(&config);
+  int32_t color_mode = color_mode_ ? INT32(color_mode_->GetCurrentColorMode()) : -1;
+  int32_t render_intent = color_mode_ ? INT32(color_mode_->GetCurrentRenderIntent()) : 0;
+  float brightness = panel_brightness_.load(std::memory_order_relaxed);
+  uint32_t has_brightness = (brightness >= -1.0f);
+  if (warm_state_->active_config == INT32(config) && warm_state_->color_mode == color_mode &&
+      warm_state_->render_intent == render_intent &&
+      warm_state_->has_brightness == has_brightness &&
+      (!has_brightness || warm_state_->brightness == brightness)) {
+    return;
+  }
+
+  HWCWarmState::BeginUpdate(warm_state_);
+  warm_state_->active_config = INT32(config);
+  warm_state_->color_mode = color_mode;
+  warm_state_->render_intent = render_intent;
+  warm_state_->has_brightness = has_brightness;
+  warm_state_->brightness = brightness;
+  HWCWarmState::EndUpdate(warm_state_);
+}
+
+int HWCDisplay::GetEventChannelFds(int *ring_fd, int *event_fd) {
+  if (!event_channel_.IsActive()) {
+    std::string name = "display_events_" + std::to_string(id_);
+    if (event_channel_.Init(name.c_str())) {
+      return -1;
+    }
+  }
+
+  *ring_fd = event_channel_.GetRingFd();
+  *event_fd = event_channel_.GetEventFd();
+  return 0;
+}
+
+void HWCDisplay::PublishRetire() {
+  if (!event_channel_.IsActive()) {
+    pending_retire_fence_ = nullptr;
+    return;
+  }
+
+  // The previous frame is normally retired by now. It is checked without waiting, so a frame
+  // whose fence is still pending when the next one is committed is not reported.
+  if (pending_retire_fence_) {
+    Fence::ScopedRef scoped_ref;
+    int64_t timestamp_ns = HWCEventChannel::GetSignalTime(scoped_ref.Get(pending_retire_fence_));
+    if (timestamp_ns) {
+      event_channel_.Publish(DISPLAY_EVENT_RETIRE, pending_retire_frame_, timestamp_ns);
+    }
+  }
+  pending_retire_fence_ = flush_ ? nullptr : layer_stack_.retire_fence;
+  pending_retire_frame_ = present_count_;
 }
 
 int HWCDisplay::GetActiveConfigIndex() {
@@ -28,11 +28,16 @@
 #include <qdMetaData.h>
 #include <sys/stat.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <queue>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "display_null.h"
@@ -40,8 +45,13 @@
 #include "hwc_buffer_allocator.h"
 #include "hwc_callbacks.h"
 #include "hwc_display_event_handler.h"
+#include "hwc_frame_dumper.h"
+#include "hwc_jank_recorder.h"
 #include "hwc_layers.h"
 #include "hwc_buffer_sync_handler.h"
+#include "hwc_event_channel.h"
+#include "hwc_state_page.h"
+#include "hwc_warm_state.h"
 
 using android::hardware::graphics::common::V1_2::ColorMode;
 using android::hardware::graphics::common::V1_1::Dataspace;
@@ -84,6 +94,7 @@ enum CWBClient {
   kCWBClientColor,      // Internal client i.e. Color Manager
   kCWBClientExternal,   // External client calling through private APIs
   kCWBClientComposer,   // Client to HWC i.e. SurfaceFlinger
+  kCWBClientCaptureRing,  // Continuous capture into a ring of client buffers
 };
 
 struct TransientRefreshRateInfo {
@@ -108,12 +119,34 @@ class HWCColorMode {
   HWC2::Error SetColorTransform(const float *matrix, android_color_transform_t hint);
   HWC2::Error RestoreColorTransform();
   ColorMode GetCurrentColorMode() { return current_color_mode_; }
+  RenderIntent GetCurrentRenderIntent() { return current_render_intent_; }
   HWC2::Error ApplyCurrentColorModeWithRenderIntent(bool hdr_present);
   HWC2::Error CacheColorModeWithRenderIntent(ColorMode mode, RenderIntent intent);
 
  private:
   static const uint32_t kColorTransformMatrixCount = 16;
-  void PopulateColorModes();
+  static const uint32_t kColorModeCount = UINT32(ColorMode::DISPLAY_BT2020) + 1;
+  static const uint32_t kDynamicRangeCount = UINT32(kHdrType) + 1;
+  typedef std::map<DynamicRangeType, std::string> DynamicRangeMap;
+  typedef std::map<RenderIntent, DynamicRangeMap> RenderIntentMap;
+  typedef std::map<ColorMode, RenderIntentMap> ColorModeMap;
+
+  // A supported mode and render intent, naming the SDM mode of each dynamic range by its index
+  // in mode_names_, or -1.
+  struct ModeEntry {
+    ColorMode mode = ColorMode::NATIVE;
+    RenderIntent intent = RenderIntent::COLORIMETRIC;
+    int32_t name_index[kDynamicRangeCount] = {-1, -1};
+  };
+
+  void PopulateColorModes(ColorModeMap *color_modes);
+  void BuildModeTable(const ColorModeMap &color_modes);
+  const ModeEntry *FindModeEntry(ColorMode mode, RenderIntent intent) const;
+  const std::string &GetModeName(ColorMode mode, RenderIntent intent,
+                                 DynamicRangeType range) const;
+  uint32_t GetNumIntents(ColorMode mode) const {
+    return mode_begin_[UINT32(mode) + 1] - mode_begin_[UINT32(mode)];
+  }
   template <class T>
   void CopyColorTransformMatrix(const T *input_matrix, double *output_matrix) {
     for (uint32_t i = 0; i < kColorTransformMatrixCount; i++) {
@@ -129,15 +162,18 @@ class HWCColorMode {
   ColorMode current_color_mode_ = ColorMode::NATIVE;
   RenderIntent current_render_intent_ = RenderIntent::COLORIMETRIC;
   DynamicRangeType curr_dynamic_range_ = kSdrType;
-  typedef std::map<DynamicRangeType, std::string> DynamicRangeMap;
-  typedef std::map<RenderIntent, DynamicRangeMap> RenderIntentMap;
-  // Initialize supported mode/render intent/dynamic range combination
-  std::map<ColorMode, RenderIntentMap> color_mode_map_ = {};
+  // Supported mode/render intent/dynamic range combinations, built once at Init so mode changes
+  // resolve without map walks. Entries are sorted by mode then intent, those of a mode are
+  // [mode_begin_[mode], mode_begin_[mode + 1]).
+  std::vector<ModeEntry> mode_table_ = {};
+  std::array<uint32_t, kColorModeCount + 1> mode_begin_ = {};
+  std::vector<std::string> mode_names_ = {};
+  uint32_t num_color_modes_ = 0;
   double color_matrix_[kColorTransformMatrixCount] = { 1.0, 0.0, 0.0, 0.0, \
                                                        0.0, 1.0, 0.0, 0.0, \
                                                        0.0, 0.0, 1.0, 0.0, \
                                                        0.0, 0.0, 0.0, 1.0 };
-  std::map<ColorMode, DynamicRangeMap> preferred_mode_ = {};
+  std::string preferred_mode_[kColorModeCount][kDynamicRangeCount] = {};
 };
 
 class HWCDisplay : public DisplayEventHandler {
@@ -158,8 +194,8 @@ class HWCDisplay : public DisplayEventHandler {
 
   struct HWCLayerStack {
     HWCLayer *client_target = nullptr;                   // Also known as framebuffer target
-    std::map<hwc2_layer_t, HWCLayer *> layer_map;        // Look up by Id - TODO
-    std::multiset<HWCLayer *, SortLayersByZ> layer_set;  // Maintain a set sorted by Z
+    HWCLayerMap layer_map;                               // Look up by Id
+    HWCLayerList layer_set;                              // Maintain a list sorted by Z
   };
 
   virtual ~HWCDisplay() {}
@@ -186,7 +222,7 @@ class HWCDisplay : public DisplayEventHandler {
   virtual DisplayError SetMixerResolution(uint32_t width, uint32_t height);
   virtual DisplayError GetMixerResolution(uint32_t *width, uint32_t *height);
   virtual void GetPanelResolution(uint32_t *width, uint32_t *height);
-  virtual void Dump(std::ostringstream *os);
+  virtual void Dump(std::ostringstream *os, DumpLevel level = kDumpLevelFull);
   virtual DisplayError TeardownConcurrentWriteback(void) {
     return kErrorNotSupported;
   }
@@ -202,6 +238,22 @@ class HWCDisplay : public DisplayEventHandler {
   // < 0 : Operation happened but failed.
   // 0 : Success.
   virtual int GetFrameCaptureStatus() { return -EAGAIN; }
+  // Captures every frame_interval-th frame into the buffers specified by buffers, written in turn.
+  // CWB stays set up across frames and a buffer is rearmed only once the client has released it.
+  // Buffers may be of any writeback output format, e.g. NV12. Returns -1 if the input is invalid
+  // or CWB is in use.
+  virtual int StartFrameCaptureRing(const std::vector<BufferInfo> &buffers, bool post_processed,
+                                    uint32_t frame_interval) {
+    return -1;
+  }
+  virtual int StopFrameCaptureRing() { return -1; }
+  // Hands the oldest captured frame over to the client, release_fence signals once it has been
+  // written. Returns -EAGAIN if no frame has been captured since the last call.
+  virtual int AcquireCapturedFrame(uint32_t *index, shared_ptr<Fence> *release_fence) {
+    return -EAGAIN;
+  }
+  // Gives a buffer obtained with AcquireCapturedFrame() back to the ring.
+  virtual int ReleaseCapturedFrame(uint32_t index) { return -1; }
 
   virtual DisplayError SetDetailEnhancerConfig(const DisplayDetailEnhancerData &de_data) {
     return kErrorNotSupported;
@@ -254,9 +306,13 @@ class HWCDisplay : public DisplayEventHandler {
                            PPPendingParams *pending_action);
   void SolidFillPrepare();
   DisplayClass GetDisplayClass();
+  int32_t GetSdmId() { return sdm_id_; }
+  void TraceFrameTiming();
   int GetVisibleDisplayRect(hwc_rect_t *rect);
   void BuildLayerStack(void);
+  void PopulateLayerFlags(HWCLayer *hwc_layer, bool is_secure, bool is_video);
   void BuildSolidFillStack(void);
+  void ResetLayerStack();
   HWCLayer *GetHWCLayer(hwc2_layer_t layer_id);
   void ResetValidation() { validated_ = false; }
   uint32_t GetGeometryChanges() { return geometry_changes_; }
@@ -314,6 +370,9 @@ class HWCDisplay : public DisplayEventHandler {
   virtual DisplayError GetSupportedDSIClock(std::vector<uint64_t> *bitclk) {
     return kErrorNotSupported;
   }
+  virtual DisplayError SetDSIClockConstraints(const std::vector<uint64_t> &avoided_bitclk) {
+    return kErrorNotSupported;
+  }
   virtual HWC2::Error UpdateDisplayId(hwc2_display_t id) {
     return HWC2::Error::Unsupported;
   }
@@ -352,7 +411,12 @@ class HWCDisplay : public DisplayEventHandler {
   virtual HWC2::Error CreateLayer(hwc2_layer_t *out_layer_id);
   virtual HWC2::Error DestroyLayer(hwc2_layer_t layer_id);
   virtual HWC2::Error SetLayerZOrder(hwc2_layer_t layer_id, uint32_t z);
+  virtual HWC2::Error PrefetchLayerBuffer(hwc2_layer_t layer_id);
   virtual HWC2::Error SetLayerType(hwc2_layer_t layer_id, IQtiComposerClient::LayerType type);
+  virtual HWC2::Error SetLayerSidebandStream(hwc2_layer_t layer_id,
+                                             shared_ptr<HWCSidebandQueue> queue);
+  // Client updates of the layer stack are presented by the client, along with sideband frames.
+  void MarkClientUpdate() { client_update_pending_ = true; }
   virtual HWC2::Error Validate(uint32_t *out_num_types, uint32_t *out_num_requests) = 0;
   virtual HWC2::Error GetReleaseFences(uint32_t *out_num_elements, hwc2_layer_t *out_layers,
                                        std::vector<shared_ptr<Fence>> *out_fences);
@@ -381,6 +445,7 @@ class HWCDisplay : public DisplayEventHandler {
   virtual HWC2::Error SetBLScale(uint32_t level) {
     return HWC2::Error::Unsupported;
   }
+  virtual HWC2::Error SetSdrDimmingScale(float scale);
   virtual void GetLayerStack(HWCLayerStack *stack);
   virtual void SetLayerStack(HWCLayerStack *stack);
   virtual void PostPowerMode();
@@ -398,7 +463,11 @@ class HWCDisplay : public DisplayEventHandler {
                                      int32_t *qsync_refresh_rate) {
     return false;
   }
+  virtual bool IsQsyncEnabled() { return false; }
   virtual int PostInit() { return 0; }
+  int GetStatePageFd();
+  void SetWarmState(HWCWarmDisplayState *warm_state) { warm_state_ = warm_state; }
+  int GetEventChannelFds(int *ring_fd, int *event_fd);
 
   virtual HWC2::Error SetDisplayedContentSamplingEnabledVndService(bool enabled);
   virtual HWC2::Error SetDisplayedContentSamplingEnabled(int32_t enabled, uint8_t component_mask,
@@ -420,6 +489,7 @@ class HWCDisplay : public DisplayEventHandler {
 
  protected:
   static uint32_t throttling_refresh_rate_;
+  static const uint32_t kMaxExpectedPresents = 4;
   // Maximum number of layers supported by display manager.
   static const uint32_t kMaxLayerCount = 32;
   HWCDisplay(CoreInterface *core_intf, BufferAllocator *buffer_allocator, HWCCallbacks *callbacks,
@@ -447,6 +517,7 @@ class HWCDisplay : public DisplayEventHandler {
   virtual void ApplyScanAdjustment(hwc_rect_t *display_frame);
   uint32_t GetUpdatingLayersCount(void);
   bool IsLayerUpdating(HWCLayer *layer);
+  uint64_t GetClientLayersHash();
   uint32_t SanitizeRefreshRate(uint32_t req_refresh_rate);
   virtual void GetUnderScanConfig() { }
   int32_t SetClientTargetDataSpace(int32_t dataspace);
@@ -482,15 +553,47 @@ class HWCDisplay : public DisplayEventHandler {
   DisplayInterface *display_intf_ = NULL;
   LayerStack layer_stack_;
   HWCLayer *client_target_ = nullptr;                   // Also known as framebuffer target
-  std::map<hwc2_layer_t, HWCLayer *> layer_map_;        // Look up by Id - TODO
-  std::multiset<HWCLayer *, SortLayersByZ> layer_set_;  // Maintain a set sorted by Z
-  std::map<hwc2_layer_t, HWC2::Composition> layer_changes_;
-  std::map<hwc2_layer_t, HWC2::LayerRequest> layer_requests_;
+  HWCLayerMap layer_map_;                               // Look up by Id
+  // SurfaceFlinger sends all setters of a layer back to back, remember the last lookup.
+  hwc2_layer_t last_layer_id_ = UINT64_MAX;
+  HWCLayer *last_layer_ = nullptr;
+  HWCLayerList layer_set_;                              // Maintain a list sorted by Z
+  bool layer_set_unsorted_ = false;                     // Z changed since the last sort
+  // Rebuilt on every validate, cleared without releasing their storage.
+  std::vector<std::pair<hwc2_layer_t, HWC2::Composition>> layer_changes_;
+  std::vector<std::pair<hwc2_layer_t, HWC2::LayerRequest>> layer_requests_;
   bool flush_on_error_ = false;
   bool flush_ = false;
   uint32_t dump_frame_count_ = 0;
   uint32_t dump_frame_index_ = 0;
   bool dump_input_layers_ = false;
+  HWCFrameDumper frame_dumper_;
+  HWCJankRecorder jank_recorder_;
+  HWCStatePage state_page_;  // Created on the first request, updated at each present after.
+  uint64_t last_present_ns_ = 0;
+  uint64_t fps_window_start_ns_ = 0;
+  uint32_t fps_window_frames_ = 0;
+  uint32_t fps_ = 0;
+  HWCEventChannel event_channel_;  // Created on the first request, like state_page_.
+  HWCWarmDisplayState *warm_state_ = nullptr;  // Updated at each present, when state is kept.
+  std::atomic<float> panel_brightness_{-2.0f};  // Last brightness set, below -1.0f when unknown.
+  uint64_t present_count_ = 0;
+  shared_ptr<Fence> pending_retire_fence_ = nullptr;  // Of pending_retire_frame_, until signaled.
+  uint64_t pending_retire_frame_ = 0;
+  int frame_dump_ring_size_mb_ = 0;  // Frame dumps go to a mapped ring file when set.
+  FILE *layer_stack_record_file_ = nullptr;
+  int content_signature_max_pixels_ = 0;  // Hash layers up to this size to find static content.
+  int solid_fill_detect_max_pixels_ = 0;  // Check layers up to this size for a single color.
+  uint64_t solid_fill_promotions_ = 0;
+  bool enable_client_target_reuse_ = false;
+  uint64_t client_layers_hash_ = 0;  // Of the layers the current client target was composed from.
+  uint64_t client_target_reuses_ = 0;
+  bool early_config_submit_ = false;  // Submit a config change with the frame that reaches it.
+  bool fence_deadlines_ = true;  // Pass the commit deadline on to the acquire fences.
+  uint64_t config_switches_ = 0;
+  int64_t config_switch_late_ns_total_ = 0;  // Applied time behind the desired time, summed.
+  int64_t config_switch_late_ns_max_ = 0;
+  int layer_stack_record_frames_ = 0;  // Layer stacks still to be recorded for off line replay.
   HWC2::PowerMode current_power_mode_ = HWC2::PowerMode::Off;
   HWC2::PowerMode pending_power_mode_ = HWC2::PowerMode::Off;
   bool swap_interval_zero_ = false;
@@ -514,10 +617,14 @@ class HWCDisplay : public DisplayEventHandler {
   HWCToneMapper *tone_mapper_ = nullptr;
   uint32_t num_configs_ = 0;
   int disable_hdr_handling_ = 0;  // disables HDR handling.
+  float sdr_dimming_scale_ = 1.0f;  // luminance scale of SDR layers while HDR is on screen.
   bool pending_commit_ = false;
   bool is_cmd_mode_ = false;
   bool partial_update_enabled_ = false;
+  bool panel_partial_update_ = false;
   bool fast_path_composition_ = false;
+  bool client_target_valid_ = false;
+  hwc2_layer_t top_layer_id_ = 0;
   bool skip_commit_ = false;
   std::map<uint32_t, DisplayConfigVariableInfo> variable_config_map_;
   std::vector<uint32_t> hwc_config_map_;
@@ -528,6 +635,7 @@ class HWCDisplay : public DisplayEventHandler {
   hwc2_config_t pending_refresh_rate_config_ = UINT_MAX;
   int64_t pending_refresh_rate_refresh_time_ = INT64_MAX;
   int64_t pending_refresh_rate_applied_time_ = INT64_MAX;
+  int64_t pending_refresh_rate_desired_time_ = INT64_MAX;
   std::deque<TransientRefreshRateInfo> transient_refresh_rate_info_;
   std::mutex transient_refresh_rate_lock_;
   std::mutex active_config_lock_;
@@ -535,13 +643,42 @@ class HWCDisplay : public DisplayEventHandler {
   LayerRect window_rect_ = {};
   bool windowed_display_ = false;
   uint32_t active_refresh_rate_ = 0;
+  // Storage of destroyed layers, reused by CreateLayer() for surfaces that come and go quickly.
+  static constexpr size_t kMaxPooledLayers = 16;
+  std::vector<void *> layer_pool_;
+
+  void FreeLayerPool();
+  bool HasExpectedPresent() const { return !expected_presents_.empty(); }
 
  private:
   void DumpInputBuffers(void);
+  bool InitFrameDumpRing(const char *dir_path);
+  void RecordLayerStack();
+  void UpdateStatePage();
+  void UpdateWarmState();
+  void PublishRetire();
+  uint64_t ScheduleExpectedPresent();
+  void SetAcquireFenceDeadlines(uint64_t hold_until);
+  void GetExpectedVSync(uint64_t hold_until, uint64_t *expected_vsync, uint64_t *vsync_period);
   bool CanSkipSdmPrepare(uint32_t *num_types, uint32_t *num_requests);
+  HWCLayerMap::iterator FindLayer(hwc2_layer_t layer_id);
+  void InsertLayerByZ(HWCLayer *layer);
+  void SortLayerSet();
+  HWCLayer *AllocateLayer();
+  void FreeLayer(HWCLayer *layer);
   void UpdateRefreshRate();
   void WaitOnPreviousFence();
   void UpdateActiveConfig();
+  void StartVSyncThread();
+  void StopVSyncThread();
+  void VSyncThread();
+  void DeliverVSync(int64_t timestamp);
+  void UpdateSidebandState();
+  void StopSidebandThread();
+  void SidebandThread();
+  bool LatchSidebandFrames(int64_t vsync_ns);
+  void PresentSidebandFrame(int64_t vsync_ns);
+  void PostCommitSidebandFrame();
   qService::QService *qservice_ = NULL;
   DisplayClass display_class_;
   uint32_t geometry_changes_ = GeometryChanges::kNone;
@@ -552,13 +689,52 @@ class HWCDisplay : public DisplayEventHandler {
   bool fast_path_enabled_ = true;
   bool first_cycle_ = true;  // false if a display commit has succeeded on the device.
   shared_ptr<Fence> fbt_release_fence_ = nullptr;
+  // VSync is handed from the SDM event thread to vsync_thread_ through a single atomic slot, so
+  // the event thread never waits on the display or on the client callback.
+  std::thread vsync_thread_;
+  std::mutex vsync_thread_lock_;
+  std::condition_variable vsync_thread_cv_;
+  std::atomic<bool> vsync_thread_running_ = {false};
+  std::atomic<int64_t> pending_vsync_timestamp_ = {0};  // 0 when no vsync awaits delivery.
+  bool vsync_thread_exit_ = false;
+  std::atomic<int64_t> vsync_delivery_delay_ns_ = {0};
+  std::atomic<int64_t> max_vsync_delivery_delay_ns_ = {0};
+  // Sideband layers latch the frame due at each vsync on sideband_thread_, which commits it
+  // right away when the client has nothing else to present. VSync stays enabled for it while
+  // the client does not listen.
+  std::thread sideband_thread_;
+  std::mutex sideband_thread_lock_;
+  std::condition_variable sideband_thread_cv_;
+  int64_t sideband_vsync_timestamp_ = 0;  // 0 when no vsync awaits the thread.
+  bool sideband_thread_exit_ = false;
+  std::atomic<bool> sideband_active_ = {false};
+  std::atomic<bool> client_vsync_enabled_ = {false};
+  std::atomic<int64_t> last_vsync_timestamp_ = {0};
+  bool client_update_pending_ = false;
+  uint64_t sideband_commits_ = 0;
+  uint64_t sideband_refreshes_ = 0;
+  std::atomic<uint64_t> sideband_busy_vsyncs_ = {0};  // Display held by the client at vsync.
   shared_ptr<Fence> release_fence_ = nullptr;
   hwc2_config_t pending_config_index_ = 0;
   bool pending_first_commit_config_ = false;
   hwc2_config_t pending_first_commit_config_index_ = 0;
   bool game_supported_ = false;
-  uint64_t elapse_timestamp_ = 0;
+  // Target present times set by the client, one per upcoming present and oldest first. Each
+  // commit takes the front one and is held until just ahead of the vsync nearest to it.
+  std::deque<uint64_t> expected_presents_;
+  uint64_t expected_presents_on_time_ = 0;
+  uint64_t expected_presents_late_ = 0;
+  uint64_t expected_presents_dropped_ = 0;  // Overwritten before a present consumed them
+  uint64_t expected_present_holds_ = 0;
+  int64_t expected_present_hold_ns_total_ = 0;
+  int64_t expected_present_hold_ns_max_ = 0;
   int async_power_mode_ = 0;
+  // Power mode change waiting for its first committed frame, and the latency of the last one.
+  uint64_t power_mode_request_ns_ = 0;
+  HWC2::PowerMode power_mode_request_from_ = HWC2::PowerMode::Off;
+  HWC2::PowerMode power_transition_from_ = HWC2::PowerMode::Off;
+  HWC2::PowerMode power_transition_to_ = HWC2::PowerMode::Off;
+  uint64_t power_transition_ns_ = 0;
 };
 
 inline int HWCDisplay::Perform(uint32_t operation, ...) {
@@ -31,10 +31,14 @@
 #include <sync/sync.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
+#include <utils/rect.h>
+#include <utils/thread_policy.h>
 #include <utils/utils.h>
 #include <stdarg.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -113,6 +117,15 @@ int HWCDisplayBuiltIn::Init() {
     cpu_hint_ = NULL;
   }
 
+  int low_ram_mode = -1;
+  HWCDebugHandler::Get()->GetProperty(LOW_RAM_MODE_PROP, &low_ram_mode);
+  low_ram_mode_ = (low_ram_mode < 0) ? property_get_bool("ro.config.low_ram", false) :
+                                       (low_ram_mode == 1);
+
+  histogram.set_thread_init([] {
+    ThreadPolicy::Apply(kThreadClassBackground, "histogram_blob");
+  });
+
   use_metadata_refresh_rate_ = true;
   int disable_metadata_dynfps = 0;
   HWCDebugHandler::Get()->GetProperty(DISABLE_METADATA_DYNAMIC_FPS_PROP, &disable_metadata_dynfps);
@@ -134,6 +147,10 @@ int HWCDisplayBuiltIn::Init() {
     DLOGI("Drop redundant drawcycles %" PRIu64 , id_);
   }
 
+  value = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_CLIENT_TARGET_ELISION_PROP, &value);
+  enable_client_target_elision_ = (value == 1);
+
   int vsyncs = 0;
   HWCDebugHandler::Get()->GetProperty(DEFER_FPS_FRAME_COUNT, &vsyncs);
   if (vsyncs > 0) {
@@ -166,6 +183,20 @@ int HWCDisplayBuiltIn::Init() {
   DebugHandler::Get()->GetProperty(DISABLE_DYNAMIC_FPS, &value);
   disable_dyn_fps_ = (value == 1);
 
+  value = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_REFRESH_RATE_GOVERNOR_PROP, &value);
+  enable_refresh_rate_governor_ = (value == 1) && !disable_dyn_fps_;
+
+  value = 0;
+  HWCDebugHandler::Get()->GetProperty(ENABLE_AVR_SCHEDULER_PROP, &value);
+  enable_avr_scheduler_ = (value == 1);
+
+  value = 0;
+  HWCDebugHandler::Get()->GetProperty(CONTENT_SAMPLING_BINS_PROP, &value);
+  if (value > 0 && !histogram.set_bin_count(UINT32(value))) {
+    DLOGW("Unsupported content sampling bin count %d", value);
+  }
+
   uint32_t config_index = 0;
   GetActiveDisplayConfig(&config_index);
   DisplayConfigVariableInfo attr = {};
@@ -177,8 +208,37 @@ int HWCDisplayBuiltIn::Init() {
   return status;
 }
 
-void HWCDisplayBuiltIn::Dump(std::ostringstream *os) {
-  HWCDisplay::Dump(os);
+void HWCDisplayBuiltIn::Dump(std::ostringstream *os, DumpLevel level) {
+  HWCDisplay::Dump(os, level);
+  if (enable_refresh_rate_governor_) {
+    *os << "Refresh rate governor: " << refresh_rate_governor_.GetCurrentRate() << std::endl;
+  }
+  if (cpu_hint_) {
+    cpu_hint_->Dump(os);
+  }
+  if (enable_client_target_elision_) {
+    *os << "Client target elisions: " << client_target_elisions_ << std::endl;
+  }
+  if (enable_avr_scheduler_) {
+    *os << "AVR scheduler: engaged: " << avr_scheduled_ << " content fps: "
+        << avr_scheduler_.GetContentFps() << " engagements: " << avr_scheduler_.GetEngagements()
+        << std::endl;
+  }
+  if (capture_ring_.size()) {
+    *os << "Capture ring: buffers: " << capture_ring_.size() << " frames: "
+        << capture_ring_frames_ << " drops: " << capture_ring_drops_ << " misses: "
+        << capture_ring_misses_ << std::endl;
+  }
+  size_t stitch_bytes = 0;
+  if (stitch_target_) {
+    for (auto &buffer_info : buffer_info_) {
+      stitch_bytes += buffer_info.alloc_buffer_info.size;
+    }
+  }
+  *os << "Memory (KiB): stitch: " << stitch_bytes / 1024 << " color sampling: "
+      << histogram.memory_usage() / 1024 << " tone map: "
+      << (tone_mapper_ ? tone_mapper_->GetMemoryUsage() / 1024 : 0)
+      << (low_ram_mode_ ? " (low RAM mode)" : "") << std::endl;
   *os << histogram.Dump();
 }
 
@@ -201,6 +261,10 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
   // Fill in the remaining blanks in the layers and add them to the SDM layerstack
   BuildLayerStack();
 
+  if (low_ram_mode_) {
+    TrimIdleResources();
+  }
+
   // Add stitch layer to layer stack.
   AppendStitchLayer();
 
@@ -216,6 +280,8 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
 
   bool pending_output_dump = dump_frame_count_ && dump_output_to_file_;
 
+  ArmCaptureRing();
+
   if (readback_buffer_queued_ || pending_output_dump) {
     // RHS values were set in FrameCaptureAsync() called from a binder thread. They are picked up
     // here in a subsequent draw round. Readback is not allowed for any secure use case.
@@ -229,7 +295,9 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
 
   uint32_t num_updating_layers = GetUpdatingLayersCount();
   bool one_updating_layer = (num_updating_layers == 1);
-  if (num_updating_layers != 0) {
+  if (cpu_hint_ && cpu_hint_->IsClosedLoop()) {
+    UpdateCPUHint();
+  } else if (num_updating_layers != 0) {
     ToggleCPUHint(one_updating_layer);
   }
 
@@ -254,6 +322,10 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
     current_refresh_rate_ = refresh_rate;
   }
 
+  if (enable_avr_scheduler_) {
+    UpdateAvrSchedule();
+  }
+
   if (layer_set_.empty()) {
     // Avoid flush for Command mode panel.
     flush_ = !client_connected_;
@@ -268,7 +340,23 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
 
 HWC2::Error HWCDisplayBuiltIn::CommitLayerStack() {
   skip_commit_ = CanSkipCommit();
-  return HWCDisplay::CommitLayerStack();
+
+  // Hold frames that arrive a little early, so variable refresh shows them at an even cadence.
+  // A frame that is well ahead is a new burst and goes out right away.
+  if (avr_scheduled_ && !HasExpectedPresent() && last_avr_commit_ns_) {
+    int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    int64_t target = last_avr_commit_ns_ + avr_frame_interval_ns_;
+    if ((target > now) && ((target - now) < (avr_frame_interval_ns_ / 4))) {
+      layer_stack_.elapse_timestamp = UINT64(target);
+    }
+  }
+
+  HWC2::Error status = HWCDisplay::CommitLayerStack();
+  if (avr_scheduled_) {
+    last_avr_commit_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
+  }
+
+  return status;
 }
 
 bool HWCDisplayBuiltIn::CanSkipCommit() {
@@ -290,13 +378,39 @@ bool HWCDisplayBuiltIn::CanSkipCommit() {
   bool vsync_source = (callbacks_->GetVsyncSource() == id_);
   bool skip_commit = enable_optimize_refresh_ && !pending_commit_ && !buffers_latched &&
                      !pending_refresh_ && !vsync_source;
+  if (!skip_commit && CanElideClientTarget(buffers_latched)) {
+    skip_commit = true;
+    client_target_elisions_++;
+  }
+  client_target_->ResetBufferFlip();
   pending_refresh_ = false;
 
   return skip_commit;
 }
 
+// Once idle fallback has every app layer composed by GPU, a video mode panel keeps fetching the
+// client target last committed. A frame with the same client target buffer and no damage on it
+// is left to that repeated fetch, the way a panel refresh would show it.
+bool HWCDisplayBuiltIn::CanElideClientTarget(bool buffers_latched) {
+  if (!enable_client_target_elision_ || is_cmd_mode_ || buffers_latched || pending_refresh_ ||
+      !IsFirstCommitDone() || !validated_ || layer_stack_.flags.geometry_changed ||
+      GetGeometryChanges() || layer_set_.empty()) {
+    return false;
+  }
+
+  // SurfaceFlinger sets a client target for every frame it composes anything for.
+  if (client_target_->BufferLatched() || client_target_->IsSurfaceUpdated()) {
+    return false;
+  }
+
+  return std::all_of(layer_set_.begin(), layer_set_.end(), [](HWCLayer *hwc_layer) {
+    Layer *layer = hwc_layer->GetSDMLayer();
+    return (layer->composition == kCompositionGPU) && !layer->flags.updating;
+  });
+}
+
 HWC2::Error HWCDisplayBuiltIn::CommitStitchLayers() {
-  if (disable_layer_stitch_) {
+  if (disable_layer_stitch_ || !stitch_target_) {
     return HWC2::Error::None;
   }
 
@@ -304,30 +418,83 @@ HWC2::Error HWCDisplayBuiltIn::CommitStitchLayers() {
     return HWC2::Error::None;
   }
 
+  // Accumulate this frame's damage, in stitch buffer space, into both stitch buffers.
+  std::vector<Layer *> stitch_layers;
+  std::vector<std::pair<LayerRect, LayerRect>> stitch_geometry;
+  LayerRect damage = {};
+  for (auto &layer : layer_stack_.layers) {
+    if (layer->composition != kCompositionStitch) {
+      continue;
+    }
+
+    stitch_layers.push_back(layer);
+    stitch_geometry.push_back(std::make_pair(layer->stitch_info.dst_rect,
+                                             layer->stitch_info.slice_rect));
+    damage = Union(damage, GetStitchDamage(layer));
+  }
+
+  if (!stitch_layers.size()) {
+    // No layers marked for stitch.
+    stitch_idle_commits_++;
+    return HWC2::Error::None;
+  }
+  stitch_last_used_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
+  stitch_idle_commits_ = 0;
+
+  if (layer_stack_.flags.geometry_changed || (stitch_geometry != stitch_geometry_)) {
+    damage = {0, 0, FLOAT(fb_config_.x_pixels), FLOAT(fb_config_.y_pixels * kBufferHeightFactor)};
+    stitch_geometry_ = stitch_geometry;
+  }
+
+  for (uint32_t i = 0; i < kNumStitchBuffers; i++) {
+    stitch_pending_damage_[i] = Union(stitch_pending_damage_[i], damage);
+  }
+
+  // Nothing changed since the other buffer was drawn, keep presenting the current one.
+  uint32_t next_index = (stitch_index_ + 1) % kNumStitchBuffers;
+  LayerRect clip = stitch_pending_damage_[next_index];
+  if (!IsValid(clip)) {
+    return HWC2::Error::None;
+  }
+
+  stitch_index_ = next_index;
+  stitch_pending_damage_[stitch_index_] = {};
+  InitStitchTarget(stitch_index_);
+
   LayerStitchContext ctx = {};
   Layer *stitch_layer = stitch_target_->GetSDMLayer();
   LayerBuffer &output_buffer = stitch_layer->input_buffer;
-  for (auto &layer : layer_stack_.layers) {
-    LayerComposition &composition = layer->composition;
-    if (composition != kCompositionStitch) {
+  for (auto &layer : stitch_layers) {
+    LayerRect dst_rect = Intersection(layer->stitch_info.dst_rect, clip);
+    if (!IsValid(dst_rect)) {
       continue;
     }
 
     StitchParams params = {};
-    // Stitch target doesn't have an input fence.
     // Render all layers at specified destination.
     LayerBuffer &input_buffer = layer->input_buffer;
     params.src_hnd = reinterpret_cast<const private_handle_t *>(input_buffer.buffer_id);
     params.dst_hnd = reinterpret_cast<const private_handle_t *>(output_buffer.buffer_id);
     SetRect(layer->stitch_info.dst_rect, &params.dst_rect);
-    SetRect(layer->stitch_info.slice_rect, &params.scissor_rect);
+    if (IsValid(layer->stitch_info.slice_rect)) {
+      LayerRect scissor_rect = Intersection(layer->stitch_info.slice_rect, clip);
+      if (!IsValid(scissor_rect)) {
+        continue;
+      }
+      SetRect(scissor_rect, &params.scissor_rect);
+    } else if (dst_rect != layer->stitch_info.dst_rect) {
+      SetRect(dst_rect, &params.damage_rect);
+    }
     params.src_acquire_fence = input_buffer.acquire_fence;
+    // Wait for the display to release this stitch buffer before drawing into it.
+    params.dst_acquire_fence = stitch_release_fence_[stitch_index_];
 
     ctx.stitch_params.push_back(params);
   }
 
   if (!ctx.stitch_params.size()) {
-    // No layers marked for stitch.
+    // Damage lies outside all stitched layers, the buffer content is already current.
+    output_buffer.acquire_fence = nullptr;
     return HWC2::Error::None;
   }
 
@@ -355,6 +522,42 @@ void HWCDisplayBuiltIn::CacheAvrStatus() {
   }
 }
 
+void HWCDisplayBuiltIn::UpdateAvrSchedule() {
+  QSyncMode qsync_mode = kQSyncModeNone;
+  if (display_intf_->GetQSyncMode(&qsync_mode) != kErrorNone) {
+    return;
+  }
+
+  // Qsync set by the client takes precedence over the scheduler.
+  QSyncMode scheduled_mode = avr_scheduled_ ? kQsyncModeOneShotContinuous : kQSyncModeNone;
+  if (qsync_mode != scheduled_mode) {
+    avr_scheduled_ = false;
+    avr_scheduler_.Reset();
+    return;
+  }
+
+  bool engage = avr_scheduler_.Update(layer_set_, systemTime(SYSTEM_TIME_MONOTONIC),
+                                      current_refresh_rate_, min_refresh_rate_,
+                                      &avr_frame_interval_ns_);
+  if (engage == avr_scheduled_ || pending_config_) {
+    return;
+  }
+
+  DisplayError error = display_intf_->SetQSyncMode(engage ? kQsyncModeOneShotContinuous :
+                                                            kQSyncModeNone);
+  if (error == kErrorNotSupported) {
+    DLOGW("Qsync not supported, disabling AVR scheduler for display %" PRIu64, id_);
+    enable_avr_scheduler_ = false;
+    avr_scheduler_.Reset();
+    return;
+  } else if (error != kErrorNone) {
+    return;
+  }
+
+  avr_scheduled_ = engage;
+  last_avr_commit_ns_ = 0;
+}
+
 bool HWCDisplayBuiltIn::IsQsyncCallbackNeeded(bool *qsync_enabled, int32_t *refresh_rate,
                            int32_t *qsync_refresh_rate) {
   if (!qsync_reconfigured_) {
@@ -501,13 +704,14 @@ HWC2::Error HWCDisplayBuiltIn::Present(shared_ptr<Fence> *out_retire_fence) {
 }
 
 void HWCDisplayBuiltIn::PostCommitStitchLayers() {
-  if (disable_layer_stitch_) {
+  if (disable_layer_stitch_ || !stitch_target_) {
     return;
   }
 
   // Close Stitch buffer acquire fence.
   Layer *stitch_layer = stitch_target_->GetSDMLayer();
   LayerBuffer &output_buffer = stitch_layer->input_buffer;
+  stitch_release_fence_[stitch_index_] = output_buffer.release_fence;
   for (auto &layer : layer_stack_.layers) {
     LayerComposition &composition = layer->composition;
     if (composition != kCompositionStitch) {
@@ -548,7 +752,7 @@ HWC2::Error HWCDisplayBuiltIn::SetColorModeWithRenderIntent(ColorMode mode, Rend
     DLOGE("failed for mode = %d intent = %d", mode, intent);
     return status;
   }
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
   validated_ = false;
   return status;
 }
@@ -560,7 +764,7 @@ HWC2::Error HWCDisplayBuiltIn::SetColorModeById(int32_t color_mode_id) {
     return status;
   }
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
   validated_ = false;
 
   return status;
@@ -592,7 +796,7 @@ HWC2::Error HWCDisplayBuiltIn::RestoreColorTransform() {
     return status;
   }
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
 
   return status;
 }
@@ -610,9 +814,13 @@ HWC2::Error HWCDisplayBuiltIn::SetColorTransform(const float *matrix,
     return status;
   }
 
-  callbacks_->Refresh(id_);
-  color_tranform_failed_ = false;
-  validated_ = false;
+  // The matrix reaches the PCC with the next commit, the composition strategy still holds unless
+  // the layers have to move off client composition.
+  callbacks_->Refresh(id_, kRefreshReasonColor);
+  if (color_tranform_failed_) {
+    color_tranform_failed_ = false;
+    validated_ = false;
+  }
 
   return status;
 }
@@ -717,7 +925,7 @@ HWC2::Error HWCDisplayBuiltIn::SetDisplayDppsAdROI(uint32_t h_start, uint32_t h_
   if (error)
     return HWC2::Error::BadConfig;
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
 
   return HWC2::Error::None;
 }
@@ -736,7 +944,7 @@ HWC2::Error HWCDisplayBuiltIn::SetFrameTriggerMode(uint32_t mode) {
   if (error)
     return HWC2::Error::BadConfig;
 
-  callbacks_->Refresh(HWC_DISPLAY_PRIMARY);
+  callbacks_->Refresh(HWC_DISPLAY_PRIMARY, kRefreshReasonConfig);
   validated_ = false;
 
   return HWC2::Error::None;
@@ -820,6 +1028,17 @@ void HWCDisplayBuiltIn::SetQDCMSolidFillInfo(bool enable, const LayerSolidFill &
   solid_fill_color_ = color;
 }
 
+void HWCDisplayBuiltIn::UpdateCPUHint() {
+  if (!current_refresh_rate_) {
+    return;
+  }
+
+  // Validate and present of the previous frame, this frame is still being validated.
+  uint64_t frame_ns = FrameTiming::GetLatest(sdm_id_, kFrameStageValidate) +
+                      FrameTiming::GetLatest(sdm_id_, kFrameStagePresent);
+  cpu_hint_->Update(frame_ns, 1000000000ULL / current_refresh_rate_);
+}
+
 void HWCDisplayBuiltIn::ToggleCPUHint(bool set) {
   if (!cpu_hint_) {
     return;
@@ -873,7 +1092,7 @@ void HWCDisplayBuiltIn::ForceRefreshRate(uint32_t refresh_rate) {
 
   force_refresh_rate_ = refresh_rate;
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonConfig);
 
   return;
 }
@@ -883,6 +1102,15 @@ uint32_t HWCDisplayBuiltIn::GetOptimalRefreshRate(bool one_updating_layer) {
     return force_refresh_rate_;
   } else if (use_metadata_refresh_rate_ && one_updating_layer && metadata_refresh_rate_) {
     return metadata_refresh_rate_;
+  } else if (enable_refresh_rate_governor_) {
+    // Lower rate changes are applied through the deferred fps config of the display.
+    uint32_t governed_rate = refresh_rate_governor_.GetRefreshRate(layer_set_,
+                               systemTime(SYSTEM_TIME_MONOTONIC), current_refresh_rate_,
+                               min_refresh_rate_, active_refresh_rate_);
+    if (governed_rate) {
+      DLOGV_IF(kTagClient, "governed_rate: %d", governed_rate);
+      return governed_rate;
+    }
   }
 
   DLOGV_IF(kTagClient, "active_refresh_rate_: %d", active_refresh_rate_);
@@ -899,7 +1127,9 @@ void HWCDisplayBuiltIn::HandleFrameOutput() {
     validated_ = false;
   }
 
-  if (frame_capture_buffer_queued_) {
+  if (capture_ring_.size()) {
+    HandleCaptureRing();
+  } else if (frame_capture_buffer_queued_) {
     HandleFrameCapture();
   } else if (dump_output_to_file_) {
     HandleFrameDump();
@@ -1046,6 +1276,201 @@ int HWCDisplayBuiltIn::FrameCaptureAsync(const BufferInfo &output_buffer_info,
   return 0;
 }
 
+bool HWCDisplayBuiltIn::IsValidCaptureBuffer(const BufferInfo &buffer_info, bool post_processed) {
+  if (buffer_info.alloc_buffer_info.fd < 0 || !buffer_info.private_data) {
+    DLOGE("Invalid fd %d", buffer_info.alloc_buffer_info.fd);
+    return false;
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  if (post_processed) {
+    GetPanelResolution(&width, &height);
+  } else {
+    GetFrameBufferResolution(&width, &height);
+  }
+
+  if (buffer_info.buffer_config.width < width || buffer_info.buffer_config.height < height) {
+    DLOGE("Buffer dimensions should not be less than %s resolution",
+          post_processed ? "panel" : "FB");
+    return false;
+  }
+
+  return true;
+}
+
+int HWCDisplayBuiltIn::StartFrameCaptureRing(const std::vector<BufferInfo> &buffers,
+                                             bool post_processed, uint32_t frame_interval) {
+  // Note: This function is called in context of a binder thread and a lock is already held
+  if (cwb_client_ != kCWBClientNone) {
+    DLOGE("CWB is in use with client = %d", cwb_client_);
+    return -1;
+  }
+
+  // At least one buffer is written while the client reads another.
+  if (buffers.size() < 2 || buffers.size() > kMaxCaptureRingSize) {
+    DLOGE("Unsupported capture ring size %zu", buffers.size());
+    return -1;
+  }
+
+  if (!frame_interval || frame_interval > kMaxCaptureInterval) {
+    DLOGE("Unsupported capture interval %u", frame_interval);
+    return -1;
+  }
+
+  for (auto &buffer_info : buffers) {
+    if (!IsValidCaptureBuffer(buffer_info, post_processed)) {
+      return -1;
+    }
+  }
+
+  capture_ring_.assign(buffers.size(), CaptureSlot());
+  for (uint32_t i = 0; i < buffers.size(); i++) {
+    capture_ring_[i].buffer = static_cast<native_handle_t *>(buffers[i].private_data);
+  }
+  captured_slots_.clear();
+  armed_slot_ = -1;
+  next_slot_ = 0;
+  capture_ring_post_processed_ = post_processed;
+  capture_ring_interval_ = frame_interval;
+  capture_ring_frames_to_skip_ = 0;
+  capture_ring_frames_ = 0;
+  capture_ring_drops_ = 0;
+  capture_ring_misses_ = 0;
+  cwb_client_ = kCWBClientCaptureRing;
+  validated_ = false;
+
+  DLOGI("Capture ring started with %zu buffers, every %u frames", buffers.size(), frame_interval);
+
+  return 0;
+}
+
+int HWCDisplayBuiltIn::StopFrameCaptureRing() {
+  if (cwb_client_ != kCWBClientCaptureRing) {
+    return -1;
+  }
+
+  // A buffer armed for a cycle that is validated but not presented yet must not be written.
+  layer_stack_.output_buffer = nullptr;
+  post_processed_output_ = false;
+  readback_buffer_queued_ = false;
+  readback_configured_ = false;
+  output_buffer_ = {};
+  cwb_client_ = kCWBClientNone;
+  validated_ = false;
+
+  capture_ring_.clear();
+  captured_slots_.clear();
+  armed_slot_ = -1;
+
+  DLOGI("Capture ring stopped after %" PRIu64 " frames", capture_ring_frames_);
+
+  return 0;
+}
+
+int HWCDisplayBuiltIn::AcquireCapturedFrame(uint32_t *index, shared_ptr<Fence> *release_fence) {
+  if (!index || !release_fence) {
+    return -1;
+  }
+
+  if (captured_slots_.empty()) {
+    return -EAGAIN;
+  }
+
+  uint32_t slot_index = captured_slots_.front();
+  captured_slots_.pop_front();
+
+  CaptureSlot &slot = capture_ring_.at(slot_index);
+  slot.state = kCaptureSlotAcquired;
+  *index = slot_index;
+  *release_fence = slot.release_fence;
+
+  return 0;
+}
+
+int HWCDisplayBuiltIn::ReleaseCapturedFrame(uint32_t index) {
+  if (index >= capture_ring_.size() || capture_ring_[index].state != kCaptureSlotAcquired) {
+    DLOGE("Capture buffer %d is not held by the client", index);
+    return -1;
+  }
+
+  capture_ring_[index].state = kCaptureSlotFree;
+
+  return 0;
+}
+
+void HWCDisplayBuiltIn::ArmCaptureRing() {
+  // Keep the slot of a cycle that is validated again before being presented.
+  if (capture_ring_.empty() || armed_slot_ >= 0 || capture_ring_frames_to_skip_) {
+    return;
+  }
+
+  int slot_index = -1;
+  uint32_t num_slots = UINT32(capture_ring_.size());
+  for (uint32_t i = 0; i < num_slots; i++) {
+    uint32_t index = (next_slot_ + i) % num_slots;
+    if (capture_ring_[index].state == kCaptureSlotFree) {
+      slot_index = INT(index);
+      break;
+    }
+  }
+
+  // The client is falling behind, overwrite the oldest frame it has not acquired yet.
+  if (slot_index < 0 && captured_slots_.size()) {
+    slot_index = INT(captured_slots_.front());
+    captured_slots_.pop_front();
+    capture_ring_drops_++;
+  }
+
+  if (slot_index < 0) {
+    capture_ring_misses_++;
+    return;
+  }
+
+  CaptureSlot &slot = capture_ring_[UINT32(slot_index)];
+  // Writeback into the buffer must not start before its previous capture has been written.
+  if (SetReadbackBuffer(slot.buffer, slot.release_fence, capture_ring_post_processed_,
+                        kCWBClientCaptureRing) != HWC2::Error::None) {
+    return;
+  }
+
+  slot.state = kCaptureSlotArmed;
+  armed_slot_ = slot_index;
+  next_slot_ = (UINT32(slot_index) + 1) % num_slots;
+}
+
+void HWCDisplayBuiltIn::HandleCaptureRing() {
+  if (armed_slot_ < 0) {
+    if (capture_ring_frames_to_skip_) {
+      capture_ring_frames_to_skip_--;
+    }
+    // The frame that arms the next buffer has to be validated.
+    validated_ = validated_ && capture_ring_frames_to_skip_;
+    return;
+  }
+
+  CaptureSlot &slot = capture_ring_[UINT32(armed_slot_)];
+  if (readback_configured_ && output_buffer_.release_fence) {
+    slot.state = kCaptureSlotCaptured;
+    slot.release_fence = output_buffer_.release_fence;
+    captured_slots_.push_back(UINT32(armed_slot_));
+    capture_ring_frames_++;
+    capture_ring_frames_to_skip_ = capture_ring_interval_ - 1;
+  } else {
+    // Readback was not allowed in this cycle, e.g. for secure content.
+    slot.state = kCaptureSlotFree;
+  }
+  armed_slot_ = -1;
+  // The next frame is validated in any case, to take the readback buffer off the layer stack.
+  validated_ = false;
+
+  // The ring keeps the CWB block, only the readback of this cycle is done.
+  post_processed_output_ = false;
+  readback_buffer_queued_ = false;
+  readback_configured_ = false;
+  output_buffer_ = {};
+}
+
 DisplayError HWCDisplayBuiltIn::SetDetailEnhancerConfig
                                    (const DisplayDetailEnhancerData &de_data) {
   DisplayError error = kErrorNotSupported;
@@ -1088,6 +1513,7 @@ HWC2::Error HWCDisplayBuiltIn::SetDisplayedContentSamplingEnabledVndService(bool
   } else {
     display_intf_->colorSamplingOff();
     histogram.stop();
+    sampling_stopped_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
   }
   return HWC2::Error::None;
 }
@@ -1116,6 +1542,7 @@ HWC2::Error HWCDisplayBuiltIn::SetDisplayedContentSamplingEnabled(int32_t enable
   } else {
     display_intf_->colorSamplingOff();
     histogram.stop();
+    sampling_stopped_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
   }
   return HWC2::Error::None;
 }
@@ -1135,7 +1562,7 @@ HWC2::Error HWCDisplayBuiltIn::GetDisplayedContentSample(
 
 DisplayError HWCDisplayBuiltIn::SetMixerResolution(uint32_t width, uint32_t height) {
   DisplayError error = display_intf_->SetMixerResolution(width, height);
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonConfig);
   validated_ = false;
   return error;
 }
@@ -1179,7 +1606,7 @@ DisplayError HWCDisplayBuiltIn::SetDynamicDSIClock(uint64_t bitclk) {
     return error;
   }
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonConfig);
   validated_ = false;
 
   return kErrorNone;
@@ -1201,6 +1628,15 @@ DisplayError HWCDisplayBuiltIn::GetSupportedDSIClock(std::vector<uint64_t> *bitc
   return kErrorNotSupported;
 }
 
+DisplayError HWCDisplayBuiltIn::SetDSIClockConstraints(
+    const std::vector<uint64_t> &avoided_bitclk) {
+  if (display_intf_) {
+    return display_intf_->SetDSIClockConstraints(avoided_bitclk);
+  }
+
+  return kErrorNotSupported;
+}
+
 HWC2::Error HWCDisplayBuiltIn::UpdateDisplayId(hwc2_display_t id) {
   id_ = id;
   return HWC2::Error::None;
@@ -1216,6 +1652,8 @@ HWC2::Error HWCDisplayBuiltIn::SetPanelBrightness(float brightness) {
   if (ret != kErrorNone) {
     return HWC2::Error::NoResources;
   }
+  panel_brightness_.store(brightness, std::memory_order_relaxed);
+  state_page_.BumpConfigGeneration();
 
   return HWC2::Error::None;
 }
@@ -1307,10 +1745,8 @@ bool HWCDisplayBuiltIn::HasSmartPanelConfig(void) {
 }
 
 int HWCDisplayBuiltIn::Deinit() {
-  // Destory color convert instance. This destroys thread and underlying GL resources.
-  if (gl_layer_stitch_) {
-    layer_stitch_task_.PerformTask(LayerStitchTaskCode::kCodeDestroyInstance, nullptr);
-  }
+  // Destory layer stitch instance. This destroys underlying GL resources.
+  ReleaseStitchResources();
 
   histogram.stop();
   return HWCDisplay::Deinit();
@@ -1356,6 +1792,15 @@ bool HWCDisplayBuiltIn::InitLayerStitch() {
     return true;
   }
 
+  if (low_ram_mode_) {
+    DLOGI("Layer Stitch resources are created on first use");
+    return true;
+  }
+
+  return AcquireStitchResources();
+}
+
+bool HWCDisplayBuiltIn::AcquireStitchResources() {
   // Initialize stitch context. This will be non-secure.
   layer_stitch_task_.PerformTask(LayerStitchTaskCode::kCodeGetInstance, nullptr);
   if (gl_layer_stitch_ == nullptr) {
@@ -1364,19 +1809,62 @@ bool HWCDisplayBuiltIn::InitLayerStitch() {
   }
 
   if (!AllocateStitchBuffer()) {
-    return true;
+    layer_stitch_task_.PerformTask(LayerStitchTaskCode::kCodeDestroyInstance, nullptr);
+    gl_layer_stitch_ = nullptr;
+    return false;
   }
 
   stitch_target_ = new HWCLayer(id_, static_cast<HWCBufferAllocator *>(buffer_allocator_));
 
   // Populate buffer params and pvt handle.
-  InitStitchTarget();
+  InitStitchTarget(stitch_index_);
+  stitch_last_used_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
+  stitch_idle_commits_ = 0;
 
   DLOGI("Created LayerStitch instance: %p", gl_layer_stitch_);
 
   return true;
 }
 
+void HWCDisplayBuiltIn::ReleaseStitchResources() {
+  if (!stitch_target_) {
+    return;
+  }
+
+  layer_stitch_task_.PerformTask(LayerStitchTaskCode::kCodeDestroyInstance, nullptr);
+  gl_layer_stitch_ = nullptr;
+
+  // The target layer goes too, so that its buffer map cannot match the ids of later buffers.
+  delete stitch_target_;
+  stitch_target_ = nullptr;
+  for (uint32_t i = 0; i < kNumStitchBuffers; i++) {
+    buffer_allocator_->FreeBuffer(&buffer_info_[i]);
+    buffer_info_[i] = {};
+    stitch_release_fence_[i] = nullptr;
+    stitch_pending_damage_[i] = {};
+  }
+  stitch_index_ = 0;
+  stitch_geometry_.clear();
+
+  DLOGI("Released LayerStitch resources");
+}
+
+void HWCDisplayBuiltIn::TrimIdleResources() {
+  int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+  // The buffers may still be on screen until a frame without stitch has replaced the last one.
+  if (stitch_target_ && (stitch_idle_commits_ > 1) &&
+      ((now - stitch_last_used_ns_) > kLowRamIdleNs)) {
+    ReleaseStitchResources();
+  }
+
+  std::unique_lock<decltype(sampling_mutex)> lk(sampling_mutex);
+  if (sampling_stopped_ns_ && ((now - sampling_stopped_ns_) > kLowRamIdleNs)) {
+    histogram.release();
+    sampling_stopped_ns_ = 0;
+  }
+}
+
 bool HWCDisplayBuiltIn::AllocateStitchBuffer() {
   // Buffer dimensions: FB width * (1.5 * height)
 
@@ -1386,50 +1874,84 @@ bool HWCDisplayBuiltIn::AllocateStitchBuffer() {
     return false;
   }
 
-  BufferConfig &config = buffer_info_.buffer_config;
-  config.width = fb_config_.x_pixels;
-  config.height = fb_config_.y_pixels * kBufferHeightFactor;
+  for (uint32_t i = 0; i < kNumStitchBuffers; i++) {
+    BufferConfig &config = buffer_info_[i].buffer_config;
+    config.width = fb_config_.x_pixels;
+    config.height = fb_config_.y_pixels * kBufferHeightFactor;
+    config.format = kFormatRGBA8888;
+    // Allocator picks UBWC when display and GPU both support it and it is not disabled.
+    config.prefer_compression = true;
 
-  // By default UBWC is enabled and below property is global enable/disable for all
-  // buffers allocated through gralloc , including framebuffer targets.
-  int ubwc_disabled = 0;
-  HWCDebugHandler::Get()->GetProperty(DISABLE_UBWC_PROP, &ubwc_disabled);
-  config.format = ubwc_disabled ? kFormatRGBA8888 : kFormatRGBA8888Ubwc;
+    config.gfx_client = true;
 
-  config.gfx_client = true;
+    // Populate default params.
+    config.secure = false;
+    config.cache = false;
+    config.secure_camera = false;
 
-  // Populate default params.
-  config.secure = false;
-  config.cache = false;
-  config.secure_camera = false;
+    error = buffer_allocator_->AllocateBuffer(&buffer_info_[i]);
 
-  error = buffer_allocator_->AllocateBuffer(&buffer_info_);
-
-  if (error != kErrorNone) {
-    DLOGE("Failed to allocate buffer. Error: %d", error);
-    return false;
+    if (error != kErrorNone) {
+      DLOGE("Failed to allocate buffer %d. Error: %d", i, error);
+      for (uint32_t j = 0; j < i; j++) {
+        buffer_allocator_->FreeBuffer(&buffer_info_[j]);
+        buffer_info_[j] = {};
+      }
+      return false;
+    }
   }
 
   return true;
 }
 
-void HWCDisplayBuiltIn::InitStitchTarget() {
+void HWCDisplayBuiltIn::InitStitchTarget(uint32_t index) {
   LayerBuffer buffer = {};
-  buffer.planes[0].fd = buffer_info_.alloc_buffer_info.fd;
+  buffer.planes[0].fd = buffer_info_[index].alloc_buffer_info.fd;
   buffer.planes[0].offset = 0;
-  buffer.planes[0].stride = buffer_info_.alloc_buffer_info.stride;
-  buffer.size = buffer_info_.alloc_buffer_info.size;
-  buffer.handle_id = buffer_info_.alloc_buffer_info.id;
-  buffer.width = buffer_info_.alloc_buffer_info.aligned_width;
-  buffer.height = buffer_info_.alloc_buffer_info.aligned_height;
+  buffer.planes[0].stride = buffer_info_[index].alloc_buffer_info.stride;
+  buffer.size = buffer_info_[index].alloc_buffer_info.size;
+  buffer.handle_id = buffer_info_[index].alloc_buffer_info.id;
+  buffer.width = buffer_info_[index].alloc_buffer_info.aligned_width;
+  buffer.height = buffer_info_[index].alloc_buffer_info.aligned_height;
   buffer.unaligned_width = fb_config_.x_pixels;
   buffer.unaligned_height = fb_config_.y_pixels * kBufferHeightFactor;
-  buffer.format = buffer_info_.alloc_buffer_info.format;
+  buffer.format = buffer_info_[index].alloc_buffer_info.format;
 
   Layer *sdm_stitch_target = stitch_target_->GetSDMLayer();
   sdm_stitch_target->composition = kCompositionStitchTarget;
   sdm_stitch_target->input_buffer = buffer;
-  sdm_stitch_target->input_buffer.buffer_id = reinterpret_cast<uint64_t>(buffer_info_.private_data);
+  sdm_stitch_target->input_buffer.buffer_id = reinterpret_cast<uint64_t>(buffer_info_[index].private_data);
+}
+
+LayerRect HWCDisplayBuiltIn::GetStitchDamage(const Layer *layer) {
+  const LayerRect &dst_rect = layer->stitch_info.dst_rect;
+  if (!layer->flags.updating) {
+    return LayerRect();
+  }
+
+  // Surface damage is in buffer space and the whole buffer is drawn into dst_rect. No damage
+  // regions means the whole layer is damaged.
+  const LayerBuffer &buffer = layer->input_buffer;
+  LayerRect buffer_rect = {0, 0, FLOAT(buffer.unaligned_width), FLOAT(buffer.unaligned_height)};
+  if (!layer->dirty_regions.size() || !IsValid(buffer_rect)) {
+    return dst_rect;
+  }
+
+  LayerRect damage = {};
+  for (auto &dirty_rect : layer->dirty_regions) {
+    LayerRect mapped_rect = {};
+    MapRect(buffer_rect, dst_rect, dirty_rect, &mapped_rect);
+    damage = Union(damage, mapped_rect);
+  }
+
+  if (!IsValid(damage)) {
+    return LayerRect();
+  }
+
+  // Grow by a pixel to cover rounding in MapRect and bilinear filtering at the edges.
+  damage = {damage.left - 1.0f, damage.top - 1.0f, damage.right + 1.0f, damage.bottom + 1.0f};
+
+  return Intersection(damage, dst_rect);
 }
 
 void HWCDisplayBuiltIn::AppendStitchLayer() {
@@ -1437,6 +1959,12 @@ void HWCDisplayBuiltIn::AppendStitchLayer() {
     return;
   }
 
+  // Resources freed while idle come back for a new use case.
+  if (!stitch_target_ && (!low_ram_mode_ || !layer_stack_.flags.geometry_changed ||
+                          !AcquireStitchResources())) {
+    return;
+  }
+
   // Append stitch target buffer to layer stack.
   Layer *sdm_stitch_target = stitch_target_->GetSDMLayer();
   sdm_stitch_target->composition = kCompositionStitchTarget;
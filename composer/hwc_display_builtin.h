@@ -31,15 +31,20 @@
 #define __HWC_DISPLAY_BUILTIN_H__
 
 #include <thermal_client.h>
+#include <deque>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "utils/sync_task.h"
 #include "utils/constants.h"
 #include "cpuhint.h"
 #include "hwc_display.h"
+#include "hwc_gpu_worker.h"
+#include "hwc_avr_scheduler.h"
 #include "hwc_layers.h"
+#include "hwc_refresh_rate_governor.h"
 
 #include "gl_layer_stitch.h"
 
@@ -99,6 +104,11 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
                                          int32_t format, bool post_processed);
   virtual int FrameCaptureAsync(const BufferInfo &output_buffer_info, bool post_processed);
   virtual int GetFrameCaptureStatus() { return frame_capture_status_; }
+  virtual int StartFrameCaptureRing(const std::vector<BufferInfo> &buffers, bool post_processed,
+                                    uint32_t frame_interval);
+  virtual int StopFrameCaptureRing();
+  virtual int AcquireCapturedFrame(uint32_t *index, shared_ptr<Fence> *release_fence);
+  virtual int ReleaseCapturedFrame(uint32_t index);
   virtual DisplayError SetDetailEnhancerConfig(const DisplayDetailEnhancerData &de_data);
   virtual DisplayError ControlPartialUpdate(bool enable, uint32_t *pending);
   virtual HWC2::Error SetReadbackBuffer(const native_handle_t *buffer,
@@ -112,6 +122,7 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   virtual DisplayError SetDynamicDSIClock(uint64_t bitclk);
   virtual DisplayError GetDynamicDSIClock(uint64_t *bitclk);
   virtual DisplayError GetSupportedDSIClock(std::vector<uint64_t> *bitclk_rates);
+  virtual DisplayError SetDSIClockConstraints(const std::vector<uint64_t> &avoided_bitclk);
   virtual HWC2::Error UpdateDisplayId(hwc2_display_t id);
   virtual HWC2::Error SetPendingRefresh();
   virtual HWC2::Error SetPanelBrightness(float brightness);
@@ -131,6 +142,7 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   virtual int Deinit();
   virtual bool IsQsyncCallbackNeeded(bool *qsync_enabled, int32_t *refresh_rate,
                                      int32_t *qsync_refresh_rate);
+  virtual bool IsQsyncEnabled() { return qsync_enabled_; }
   virtual int PostInit();
 
   virtual HWC2::Error SetDisplayedContentSamplingEnabledVndService(bool enabled);
@@ -142,7 +154,7 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
       uint64_t max_frames, uint64_t timestamp, uint64_t *numFrames,
       int32_t samples_size[NUM_HISTOGRAM_COLOR_COMPONENTS],
       uint64_t *samples[NUM_HISTOGRAM_COLOR_COMPONENTS]);
-  void Dump(std::ostringstream *os) override;
+  void Dump(std::ostringstream *os, DumpLevel level = kDumpLevelFull) override;
   virtual HWC2::Error SetPowerMode(HWC2::PowerMode mode, bool teardown);
   virtual bool HasReadBackBufferSupport();
 
@@ -156,20 +168,30 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   void ProcessBootAnimCompleted(void);
   void SetQDCMSolidFillInfo(bool enable, const LayerSolidFill &color);
   void ToggleCPUHint(bool set);
+  void UpdateCPUHint();
   void ForceRefreshRate(uint32_t refresh_rate);
   uint32_t GetOptimalRefreshRate(bool one_updating_layer);
   void HandleFrameOutput();
   void HandleFrameDump();
   void HandleFrameCapture();
+  bool IsValidCaptureBuffer(const BufferInfo &buffer_info, bool post_processed);
+  void ArmCaptureRing();
+  void HandleCaptureRing();
   bool CanSkipCommit();
+  bool CanElideClientTarget(bool buffers_latched);
   DisplayError SetMixerResolution(uint32_t width, uint32_t height);
   DisplayError GetMixerResolution(uint32_t *width, uint32_t *height);
   HWC2::Error CommitStitchLayers();
   void AppendStitchLayer();
   bool InitLayerStitch();
-  void InitStitchTarget();
+  bool AcquireStitchResources();
+  void ReleaseStitchResources();
+  void TrimIdleResources();
+  void InitStitchTarget(uint32_t index);
   bool AllocateStitchBuffer();
+  LayerRect GetStitchDamage(const Layer *layer);
   void CacheAvrStatus();
+  void UpdateAvrSchedule();
   void PostCommitStitchLayers();
   int GetBwCode(const DisplayConfigVariableInfo &attr);
   void SetBwLimitHint(bool enable);
@@ -199,17 +221,58 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   void *output_buffer_base_ = nullptr;
   bool pending_refresh_ = true;
   bool enable_optimize_refresh_ = false;
+  bool enable_client_target_elision_ = false;
+  uint64_t client_target_elisions_ = 0;
   bool enable_poms_during_doze_ = false;
 
   // Members for 1 frame capture in a client provided buffer
   bool frame_capture_buffer_queued_ = false;
   int frame_capture_status_ = -EAGAIN;
+
+  // Members for continuous capture in a ring of client provided buffers
+  enum CaptureSlotState {
+    kCaptureSlotFree,
+    kCaptureSlotArmed,     // Set as readback buffer of the current draw cycle
+    kCaptureSlotCaptured,  // Written, waiting for the client to acquire it
+    kCaptureSlotAcquired,  // Held by the client
+  };
+  struct CaptureSlot {
+    const native_handle_t *buffer = nullptr;
+    CaptureSlotState state = kCaptureSlotFree;
+    shared_ptr<Fence> release_fence = nullptr;  // Signals when the last capture has been written
+  };
+  static const uint32_t kMaxCaptureRingSize = 8;
+  std::vector<CaptureSlot> capture_ring_;
+  std::deque<uint32_t> captured_slots_;  // Captured and not yet acquired, oldest first
+  int armed_slot_ = -1;
+  uint32_t next_slot_ = 0;
+  bool capture_ring_post_processed_ = false;
+  static const uint32_t kMaxCaptureInterval = 60;
+  uint32_t capture_ring_interval_ = 1;
+  uint32_t capture_ring_frames_to_skip_ = 0;  // Presented frames left until the next capture
+  uint64_t capture_ring_frames_ = 0;
+  uint64_t capture_ring_drops_ = 0;   // Captures overwritten before the client acquired them
+  uint64_t capture_ring_misses_ = 0;  // Frames not captured as the client held every buffer
   bool is_primary_ = false;
   bool disable_layer_stitch_ = true;
   HWCLayer* stitch_target_ = nullptr;
-  SyncTask<LayerStitchTaskCode> layer_stitch_task_;
+  HWCGPUTask<LayerStitchTaskCode> layer_stitch_task_;
   GLLayerStitch* gl_layer_stitch_ = nullptr;
-  BufferInfo buffer_info_ = {};
+  // Stitch target is double buffered. Each buffer tracks the damage it lags behind by, so only
+  // that part is redrawn when it is reused.
+  static const uint32_t kNumStitchBuffers = 2;
+  BufferInfo buffer_info_[kNumStitchBuffers] = {};
+  shared_ptr<Fence> stitch_release_fence_[kNumStitchBuffers] = {};
+  LayerRect stitch_pending_damage_[kNumStitchBuffers] = {};
+  uint32_t stitch_index_ = 0;
+  std::vector<std::pair<LayerRect, LayerRect>> stitch_geometry_ = {};
+  // In low RAM mode the stitch context and buffers are created on a geometry change and freed
+  // once no frame has been stitched for kLowRamIdleNs, as is the color sampling ring.
+  static const int64_t kLowRamIdleNs = 5000000000LL;
+  bool low_ram_mode_ = false;
+  int64_t stitch_last_used_ns_ = 0;
+  uint32_t stitch_idle_commits_ = 0;  // Commits without stitched layers since the last one
+  int64_t sampling_stopped_ns_ = 0;   // 0 while sampling or once the ring is freed
   DisplayConfigVariableInfo fb_config_ = {};
 
   bool qsync_enabled_ = false;
@@ -225,6 +288,13 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   const char *kDisplayBwName = "display_bw";
   bool enable_bw_limits_ = false;
   bool disable_dyn_fps_ = false;
+  bool enable_refresh_rate_governor_ = false;
+  HWCRefreshRateGovernor refresh_rate_governor_;
+  bool enable_avr_scheduler_ = false;
+  bool avr_scheduled_ = false;  // Qsync one shot mode was set by the scheduler
+  HWCAvrScheduler avr_scheduler_;
+  int64_t avr_frame_interval_ns_ = 0;
+  int64_t last_avr_commit_ns_ = 0;
 };
 
 }  // namespace sdm
@@ -30,6 +30,7 @@
 #include <cutils/properties.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/thread_policy.h>
 #include <algorithm>
 
 #include "hwc_display_pluggable.h"
@@ -96,9 +97,21 @@ int HWCDisplayPluggable::Init() {
   color_mode_ = new HWCColorMode(display_intf_);
   color_mode_->Init();
 
+  int async_present = 0;
+  HWCDebugHandler::Get()->GetProperty(ASYNC_PLUGGABLE_PRESENT_PROP, &async_present);
+  async_present_ = (async_present == 1);
+  if (async_present_) {
+    present_thread_ = std::thread(&HWCDisplayPluggable::PresentThread, this);
+  }
+
   return status;
 }
 
+int HWCDisplayPluggable::Deinit() {
+  StopPresentThread();
+  return HWCDisplay::Deinit();
+}
+
 void HWCDisplayPluggable::Destroy(HWCDisplay *hwc_display) {
   // Flush the display to have outstanding fences signaled.
   hwc_display->Flush();
@@ -152,6 +165,13 @@ HWC2::Error HWCDisplayPluggable::Present(shared_ptr<Fence> *out_retire_fence) {
   auto status = HWC2::Error::None;
 
   if (!active_secure_sessions_[kSecureDisplay]) {
+    if (NeedsFrameDrop()) {
+      // Layers keep the release fences of the frame on screen, and the previous retire fence
+      // is returned again.
+      DTRACE_SCOPED();
+      frames_dropped_++;
+      skip_commit_ = true;
+    }
     status = HWCDisplay::CommitLayerStack();
     if (status == HWC2::Error::None) {
       status = HWCDisplay::PostCommitLayerStack(out_retire_fence);
@@ -160,6 +180,72 @@ HWC2::Error HWCDisplayPluggable::Present(shared_ptr<Fence> *out_retire_fence) {
   return status;
 }
 
+bool HWCDisplayPluggable::NeedsFrameDrop() {
+  const shared_ptr<Fence> &retire_fence = layer_stack_.retire_fence;
+  if (!async_present_ || skip_commit_ || flush_ || !retire_fence ||
+      Fence::GetStatus(retire_fence) == Fence::Status::kSignaled) {
+    return false;
+  }
+
+  // The composition validated for the frame has to stay valid without a commit. Geometry changes
+  // are committed as they come, and a client target would be rendered over the buffer on screen.
+  if (layer_stack_.flags.geometry_changed || GetGeometryChanges() || layer_set_.empty()) {
+    return false;
+  }
+  bool device_composed =
+      std::all_of(layer_set_.begin(), layer_set_.end(), [](HWCLayer *hwc_layer) {
+        LayerComposition composition = hwc_layer->GetSDMLayer()->composition;
+        return (composition == kCompositionSDE) || (composition == kCompositionCursor);
+      });
+  if (!device_composed) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(present_thread_lock_);
+    dropped_on_fence_ = retire_fence;
+  }
+  present_thread_cv_.notify_one();
+
+  return true;
+}
+
+void HWCDisplayPluggable::StopPresentThread() {
+  if (!present_thread_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(present_thread_lock_);
+    present_thread_exit_ = true;
+  }
+  present_thread_cv_.notify_one();
+  present_thread_.join();
+}
+
+void HWCDisplayPluggable::PresentThread() {
+  ThreadPolicy::Apply(kThreadClassPresent, "HWC_PresentThread");
+
+  while (true) {
+    shared_ptr<Fence> fence = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(present_thread_lock_);
+      present_thread_cv_.wait(lock, [this] {
+        return present_thread_exit_ || dropped_on_fence_;
+      });
+      if (present_thread_exit_) {
+        break;
+      }
+      fence = dropped_on_fence_;
+      dropped_on_fence_ = nullptr;
+    }
+
+    // The display lock is not taken, the next present commits whatever the client has by then.
+    Fence::Wait(fence);
+    callbacks_->Refresh(id_, kRefreshReasonPresent);
+  }
+}
+
 void HWCDisplayPluggable::ApplyScanAdjustment(hwc_rect_t *display_frame) {
   if ((underscan_width_ <= 0) || (underscan_height_ <= 0)) {
     return;
@@ -318,7 +404,7 @@ HWC2::Error HWCDisplayPluggable::SetColorModeWithRenderIntent(ColorMode mode, Re
     return status;
   }
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
   validated_ = false;
 
   return status;
@@ -330,6 +416,14 @@ HWC2::Error HWCDisplayPluggable::UpdatePowerMode(HWC2::PowerMode mode) {
   return HWC2::Error::None;
 }
 
+void HWCDisplayPluggable::Dump(std::ostringstream *os, DumpLevel level) {
+  HWCDisplay::Dump(os, level);
+
+  if (async_present_) {
+    *os << "Async present frames dropped: " << frames_dropped_ << std::endl;
+  }
+}
+
 HWC2::Error HWCDisplayPluggable::SetColorTransform(const float *matrix,
                                                    android_color_transform_t hint) {
   if (HAL_COLOR_TRANSFORM_IDENTITY == hint) {
@@ -342,7 +436,7 @@ HWC2::Error HWCDisplayPluggable::SetColorTransform(const float *matrix,
     has_color_tranform_ = true;
   }
 
-  callbacks_->Refresh(id_);
+  callbacks_->Refresh(id_, kRefreshReasonColor);
   validated_ = false;
 
   return HWC2::Error::None;
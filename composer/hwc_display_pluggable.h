@@ -45,6 +45,7 @@ class HWCDisplayPluggable : public HWCDisplay {
                     bool use_primary_res, HWCDisplay **hwc_display);
   static void Destroy(HWCDisplay *hwc_display);
   virtual int Init();
+  virtual int Deinit();
   virtual HWC2::Error Validate(uint32_t *out_num_types, uint32_t *out_num_requests);
   virtual HWC2::Error Present(shared_ptr<Fence> *out_retire_fence);
   virtual int SetState(bool connected);
@@ -56,6 +57,7 @@ class HWCDisplayPluggable : public HWCDisplay {
   virtual HWC2::Error SetColorModeWithRenderIntent(ColorMode mode, RenderIntent intent);
   virtual HWC2::Error SetColorTransform(const float *matrix, android_color_transform_t hint);
   virtual HWC2::Error UpdatePowerMode(HWC2::PowerMode mode);
+  virtual void Dump(std::ostringstream *os, DumpLevel level = kDumpLevelFull);
 
  private:
   HWCDisplayPluggable(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
@@ -65,11 +67,24 @@ class HWCDisplayPluggable : public HWCDisplay {
   void GetUnderScanConfig();
   static void GetDownscaleResolution(uint32_t primary_width, uint32_t primary_height,
                                      uint32_t *virtual_width, uint32_t *virtual_height);
+  bool NeedsFrameDrop();
+  void StopPresentThread();
+  void PresentThread();
 
   DisplayNullExternal display_null_;
   int underscan_width_ = 0;
   int underscan_height_ = 0;
   bool has_color_tranform_ = false;
+  // With async present, a frame that would wait in the driver for the previous commit to retire
+  // is dropped instead of holding the client. present_thread_ waits for that commit and asks
+  // for a refresh, so the latest frame still reaches the screen. Commits stay on Present().
+  bool async_present_ = false;
+  std::thread present_thread_;
+  std::mutex present_thread_lock_;
+  std::condition_variable present_thread_cv_;
+  shared_ptr<Fence> dropped_on_fence_ = nullptr;  // Commit in flight at the last drop.
+  bool present_thread_exit_ = false;
+  uint64_t frames_dropped_ = 0;
 };
 
 }  // namespace sdm
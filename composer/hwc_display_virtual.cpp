@@ -87,6 +87,7 @@ HWC2::Error HWCDisplayVirtual::DumpVDSBuffer() {
       buffer_info.buffer_config.format =
       HWCLayer::GetSDMFormat(output_handle->format, output_handle->flags);
       buffer_info.alloc_buffer_info.size = static_cast<uint32_t>(output_handle->size);
+      buffer_info.alloc_buffer_info.fd = output_handle->fd;
       DumpOutputBuffer(buffer_info, reinterpret_cast<void *>(output_handle->base),
                        layer_stack_.retire_fence);
 
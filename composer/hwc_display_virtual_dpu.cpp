@@ -28,6 +28,7 @@
  */
 
 #include <hwc_display_virtual_dpu.h>
+#include "hwc_debugger.h"
 
 #define __CLASS__ "HWCDisplayVirtualDPU"
 
@@ -38,7 +39,7 @@ HWCDisplayVirtualDPU::HWCDisplayVirtualDPU(CoreInterface *core_intf, HWCBufferAl
                                            hwc2_display_t id, int32_t sdm_id, uint32_t width,
                                            uint32_t height, float min_lum, float max_lum)
   : HWCDisplayVirtual(core_intf, buffer_allocator, callbacks, id, sdm_id, width, height),
-    min_lum_(min_lum), max_lum_(max_lum) {
+    min_lum_(min_lum), max_lum_(max_lum), color_convert_task_(*this) {
 }
 
 int HWCDisplayVirtualDPU::Init() {
@@ -71,9 +72,22 @@ int HWCDisplayVirtualDPU::Init() {
     return status;
   }
 
+  int value = 0;
+  HWCDebugHandler::Get()->GetProperty(DISABLE_GPU_COLOR_CONVERT, &value);
+  gpu_fallback_enabled_ = (value == 0);
+
   return HWCDisplayVirtual::Init();
 }
 
+int HWCDisplayVirtualDPU::Deinit() {
+  // Destroy GPU fallback resources, if the display ever had to use them.
+  if (gl_color_convert_) {
+    color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeDestroyInstance, nullptr);
+  }
+
+  return HWCDisplayVirtual::Deinit();
+}
+
 int HWCDisplayVirtualDPU::SetConfig(uint32_t width, uint32_t height) {
   DisplayConfigVariableInfo variable_info;
   variable_info.x_pixels = width;
@@ -118,6 +132,9 @@ HWC2::Error HWCDisplayVirtualDPU::SetOutputBuffer(buffer_handle_t buf,
         return HWC2::Error::BadParameter;
       }
       validated_ = false;
+      if (gl_color_convert_) {
+        color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeReset, nullptr);
+      }
     }
 
     output_buffer_.width = UINT32(new_aligned_w);
@@ -131,10 +148,22 @@ HWC2::Error HWCDisplayVirtualDPU::SetOutputBuffer(buffer_handle_t buf,
 
 HWC2::Error HWCDisplayVirtualDPU::Validate(uint32_t *out_num_types, uint32_t *out_num_requests) {
   if (NeedsGPUBypass()) {
+    SetCompositionPath(kPathDPU);
     MarkLayersForGPUBypass();
     return HWC2::Error::None;
   }
 
+  // Writeback was unavailable recently. Stay on GPU for a while instead of retrying every frame.
+  if (wb_retry_countdown_) {
+    wb_retry_countdown_--;
+    return ValidateGPUFallback(out_num_types, out_num_requests);
+  }
+
+  // SDM has not seen the stacks composed on GPU, make sure it is prepared in full on return.
+  if (path_ == kPathGPU) {
+    validated_ = false;
+  }
+
   BuildLayerStack();
   layer_stack_.output_buffer = &output_buffer_;
   // If Output buffer of Virtual Display is not secure, set SKIP flag on the secure layers.
@@ -148,7 +177,46 @@ HWC2::Error HWCDisplayVirtualDPU::Validate(uint32_t *out_num_types, uint32_t *ou
     }
   }
 
-  return PrepareLayerStack(out_num_types, out_num_requests);
+  HWC2::Error status = PrepareLayerStack(out_num_types, out_num_requests);
+  if (status == HWC2::Error::BadDisplay && gpu_fallback_enabled_ && !shutdown_pending_) {
+    // No writeback block could be assigned for this stack, or it rejected the output format.
+    // Compose this frame on GPU rather than dropping it.
+    DLOGW("Writeback unavailable on display %" PRIu64 ", composing on GPU", id_);
+    flush_ = false;
+    wb_retry_countdown_ = kWBRetryInterval;
+    return ValidateGPUFallback(out_num_types, out_num_requests);
+  }
+
+  SetCompositionPath(kPathDPU);
+
+  return status;
+}
+
+HWC2::Error HWCDisplayVirtualDPU::ValidateGPUFallback(uint32_t *out_num_types,
+                                                     uint32_t *out_num_requests) {
+  DTRACE_SCOPED();
+
+  SetCompositionPath(kPathGPU);
+
+  layer_changes_.clear();
+  layer_requests_.clear();
+
+  for (auto hwc_layer : layer_set_) {
+    hwc_layer->SetComposition(kCompositionGPU);
+    if (hwc_layer->GetClientRequestedCompositionType() != HWC2::Composition::Client) {
+      layer_changes_.emplace_back(hwc_layer->GetId(), HWC2::Composition::Client);
+    }
+    hwc_layer->ResetValidation();
+  }
+
+  *out_num_types = UINT32(layer_changes_.size());
+  *out_num_requests = UINT32(layer_requests_.size());
+  has_client_composition_ = true;
+  client_target_->ResetValidation();
+  validate_state_ = kNormalValidate;
+  validated_ = true;
+
+  return ((*out_num_types > 0) ? HWC2::Error::HasChanges : HWC2::Error::None);
 }
 
 HWC2::Error HWCDisplayVirtualDPU::Present(shared_ptr<Fence> *out_retire_fence) {
@@ -162,22 +230,89 @@ HWC2::Error HWCDisplayVirtualDPU::Present(shared_ptr<Fence> *out_retire_fence) {
     return status;
   }
 
-  layer_stack_.output_buffer = &output_buffer_;
-  if (display_paused_) {
-    validated_ = false;
-    flush_ = true;
+  nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+  if (path_ == kPathGPU) {
+    status = PresentGPUFallback(out_retire_fence);
+  } else {
+    layer_stack_.output_buffer = &output_buffer_;
+    if (display_paused_) {
+      validated_ = false;
+      flush_ = true;
+    }
+
+    status = HWCDisplay::CommitLayerStack();
+    if (status != HWC2::Error::None) {
+      return status;
+    }
+
+    DumpVDSBuffer();
+
+    status = HWCDisplay::PostCommitLayerStack(out_retire_fence);
   }
 
-  status = HWCDisplay::CommitLayerStack();
-  if (status != HWC2::Error::None) {
-    return status;
+  PathStats &stats = path_stats_[path_];
+  stats.last_us = UINT64(systemTime(SYSTEM_TIME_MONOTONIC) - start) / 1000;
+  stats.total_us += stats.last_us;
+  stats.frames++;
+
+  return status;
+}
+
+HWC2::Error HWCDisplayVirtualDPU::PresentGPUFallback(shared_ptr<Fence> *out_retire_fence) {
+  DTRACE_SCOPED();
+
+  if (!validated_) {
+    return HWC2::Error::NotValidated;
+  }
+
+  // GPU context gets in secure or non-secure mode depending on output buffer provided.
+  if (!gl_color_convert_) {
+    color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeGetInstance, nullptr);
+    if (gl_color_convert_ == nullptr) {
+      DLOGE("Failed to get Color Convert Instance");
+      return HWC2::Error::NoResources;
+    }
   }
 
+  ColorConvertBlitContext ctx = {};
+
+  LayerBuffer &input_buffer = client_target_->GetSDMLayer()->input_buffer;
+  ctx.src_hnd = reinterpret_cast<const private_handle_t *>(input_buffer.buffer_id);
+  ctx.dst_hnd = output_handle_;
+  ctx.dst_rect = {0, 0, FLOAT(output_buffer_.unaligned_width),
+                  FLOAT(output_buffer_.unaligned_height)};
+  ctx.src_acquire_fence = input_buffer.acquire_fence;
+  ctx.dst_acquire_fence = output_buffer_.acquire_fence;
+
+  color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeBlit, &ctx);
+
   DumpVDSBuffer();
 
-  status = HWCDisplay::PostCommitLayerStack(out_retire_fence);
+  // Layers were composed by the client, there is nothing to release on their behalf. Keep the
+  // release fence queue in step with the DPU path.
+  for (auto hwc_layer : layer_set_) {
+    hwc_layer->ResetGeometryChanges();
+    hwc_layer->PushBackReleaseFence(nullptr);
+    hwc_layer->GetSDMLayer()->input_buffer.acquire_fence = nullptr;
+  }
+  client_target_->ResetGeometryChanges();
+  layer_stack_.flags.geometry_changed = false;
+  geometry_changes_ = GeometryChanges::kNone;
+
+  *out_retire_fence = ctx.release_fence;
 
-  return status;
+  return HWC2::Error::None;
+}
+
+void HWCDisplayVirtualDPU::SetCompositionPath(CompositionPath path) {
+  if (path_ == path) {
+    return;
+  }
+
+  DLOGI("Display %" PRIu64 " switching to %s composition", id_,
+        (path == kPathGPU) ? "GPU" : "DPU");
+  path_ = path;
+  path_switches_++;
 }
 
 HWC2::Error HWCDisplayVirtualDPU::SetPanelLuminanceAttributes(float min_lum, float max_lum) {
@@ -188,5 +323,50 @@ HWC2::Error HWCDisplayVirtualDPU::SetPanelLuminanceAttributes(float min_lum, flo
   return HWC2::Error::None;
 }
 
+void HWCDisplayVirtualDPU::Dump(std::ostringstream *os, DumpLevel level) {
+  HWCDisplay::Dump(os, level);
+
+  *os << "Virtual composition: " << ((path_ == kPathGPU) ? "GPU" : "DPU")
+      << " switches: " << path_switches_ << std::endl;
+  const char *names[kPathMax] = { "DPU", "GPU" };
+  for (int i = 0; i < kPathMax; i++) {
+    const PathStats &stats = path_stats_[i];
+    *os << names[i] << " frames: " << stats.frames
+        << " avg (us): " << (stats.frames ? (stats.total_us / stats.frames) : 0)
+        << " last (us): " << stats.last_us << std::endl;
+  }
+}
+
+void HWCDisplayVirtualDPU::OnTask(const ColorConvertTaskCode &task_code,
+                                  SyncTask<ColorConvertTaskCode>::TaskContext *task_context) {
+  switch (task_code) {
+    case ColorConvertTaskCode::kCodeGetInstance: {
+        gl_color_convert_ = GLColorConvert::GetInstance(kTargetYUV, output_buffer_.flags.secure);
+      }
+      break;
+    case ColorConvertTaskCode::kCodeBlit: {
+        DTRACE_SCOPED();
+        ColorConvertBlitContext* ctx = reinterpret_cast<ColorConvertBlitContext*>(task_context);
+        gl_color_convert_->Blit(ctx->src_hnd, ctx->dst_hnd, ctx->src_rect, ctx->dst_rect,
+                                ctx->src_acquire_fence, ctx->dst_acquire_fence,
+                                &(ctx->release_fence));
+      }
+      break;
+    case ColorConvertTaskCode::kCodeReset: {
+        if (gl_color_convert_) {
+          gl_color_convert_->Reset();
+        }
+      }
+      break;
+    case ColorConvertTaskCode::kCodeDestroyInstance: {
+        if (gl_color_convert_) {
+          GLColorConvert::Destroy(gl_color_convert_);
+          gl_color_convert_ = nullptr;
+        }
+      }
+      break;
+  }
+}
+
 }  // namespace sdm
 
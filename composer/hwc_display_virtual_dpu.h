@@ -31,25 +31,58 @@
 #define __HWC_DISPLAY_VIRTUAL_DPU_H__
 
 #include "hwc_display_virtual.h"
+#include "hwc_display_virtual_gpu.h"
 
 namespace sdm {
 
-class HWCDisplayVirtualDPU : public HWCDisplayVirtual {
+class HWCDisplayVirtualDPU : public HWCDisplayVirtual,
+                             public SyncTask<ColorConvertTaskCode>::TaskHandler {
  public:
   HWCDisplayVirtualDPU(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
                        HWCCallbacks *callbacks, hwc2_display_t id, int32_t sdm_id,
                        uint32_t width, uint32_t height, float min_lum, float max_lum);
   virtual int Init();
+  virtual int Deinit();
   virtual HWC2::Error Validate(uint32_t *out_num_types, uint32_t *out_num_requests);
   virtual HWC2::Error Present(shared_ptr<Fence> *out_retire_fence);
   virtual HWC2::Error SetOutputBuffer(buffer_handle_t buf, shared_ptr<Fence> release_fence);
   virtual HWC2::Error SetPanelLuminanceAttributes(float min_lum, float max_lum);
+  virtual void Dump(std::ostringstream *os, DumpLevel level = kDumpLevelFull);
 
  private:
+  enum CompositionPath {
+    kPathDPU,
+    kPathGPU,
+    kPathMax,
+  };
+
+  struct PathStats {
+    uint64_t frames = 0;
+    uint64_t total_us = 0;
+    uint64_t last_us = 0;
+  };
+
+  // Frames composed on GPU after a failed writeback prepare before DPU is tried again.
+  static const uint32_t kWBRetryInterval = 30;
+
   int SetConfig(uint32_t width, uint32_t height);
+  HWC2::Error ValidateGPUFallback(uint32_t *out_num_types, uint32_t *out_num_requests);
+  HWC2::Error PresentGPUFallback(shared_ptr<Fence> *out_retire_fence);
+  void SetCompositionPath(CompositionPath path);
+
+  // SyncTask methods.
+  void OnTask(const ColorConvertTaskCode &task_code,
+              SyncTask<ColorConvertTaskCode>::TaskContext *task_context);
 
   float min_lum_ = 0.0f;
   float max_lum_ = 0.0f;
+  HWCGPUTask<ColorConvertTaskCode> color_convert_task_;
+  GLColorConvert *gl_color_convert_ = nullptr;
+  bool gpu_fallback_enabled_ = false;
+  uint32_t wb_retry_countdown_ = 0;
+  CompositionPath path_ = kPathDPU;
+  uint64_t path_switches_ = 0;
+  PathStats path_stats_[kPathMax] = {};
 };
 
 }  // namespace sdm
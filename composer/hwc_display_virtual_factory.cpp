@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2019-2020, The Linux Foundation. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are
@@ -64,6 +64,15 @@ int HWCVirtualDisplayFactory::Create(CoreInterface *core_intf, HWCBufferAllocato
   }
 
   int status = hwc_display_virtual->Init();
+  if (status && supported_virtual_displays && IsGPUColorConvertSupported()) {
+    // Writeback could not be acquired for this display. Composing on GPU beats failing it.
+    DLOGW("DPU based virtual display init failed: %d, falling back to GPU", status);
+    Destroy(hwc_display_virtual);
+    hwc_display_virtual = new HWCDisplayVirtualGPU(core_intf, buffer_allocator, callbacks, id,
+                                                   sdm_id, width, height, min_lum, max_lum);
+    status = hwc_display_virtual->Init();
+  }
+
   if (status) {
     DLOGW("Failed to initialize virtual display");
     Destroy(hwc_display_virtual);
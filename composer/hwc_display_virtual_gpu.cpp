@@ -43,11 +43,18 @@ int HWCDisplayVirtualGPU::Init() {
   // Calls into SDM need to be dropped. Create Null Display interface.
   display_intf_ = new DisplayNull();
 
+  int value = 0;
+  HWCDebugHandler::Get()->GetProperty(VDS_MAX_PENDING_FRAMES_PROP, &value);
+  max_pending_frames_ = UINT32(std::max(value, 0));
+  value = 0;
+  HWCDebugHandler::Get()->GetProperty(VDS_FRAME_DEADLINE_PROP, &value);
+  frame_deadline_ms_ = std::max(value, 0);
+
   return HWCDisplayVirtual::Init();
 }
 
 int HWCDisplayVirtualGPU::Deinit() {
-  // Destory color convert instance. This destroys thread and underlying GL resources.
+  // Destory color convert instance. This destroys underlying GL resources.
   if (gl_color_convert_) {
     color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeDestroyInstance, nullptr);
   }
@@ -58,6 +65,7 @@ int HWCDisplayVirtualGPU::Deinit() {
   for (auto hwc_layer : layer_set_) {
     delete hwc_layer;
   }
+  FreeLayerPool();
 
   return 0;
 }
@@ -85,12 +93,12 @@ HWC2::Error HWCDisplayVirtualGPU::Validate(uint32_t *out_num_types, uint32_t *ou
 
     if (needs_gpu_bypass) {
       if (hwc_layer->GetClientRequestedCompositionType() == HWC2::Composition::Client) {
-       layer_changes_[hwc_layer->GetId()] = HWC2::Composition::Device;
-       layer_requests_[hwc_layer->GetId()] = HWC2::LayerRequest::ClearClientTarget;
+       layer_changes_.emplace_back(hwc_layer->GetId(), HWC2::Composition::Device);
+       layer_requests_.emplace_back(hwc_layer->GetId(), HWC2::LayerRequest::ClearClientTarget);
       }
     } else {
       if (hwc_layer->GetClientRequestedCompositionType() != HWC2::Composition::Client) {
-       layer_changes_[hwc_layer->GetId()] = HWC2::Composition::Client;
+       layer_changes_.emplace_back(hwc_layer->GetId(), HWC2::Composition::Client);
       }
     }
   }
@@ -117,6 +125,8 @@ HWC2::Error HWCDisplayVirtualGPU::SetOutputBuffer(buffer_handle_t buf,
   }
 
   const private_handle_t *hnd = static_cast<const private_handle_t *>(buf);
+  uint32_t active_width = output_buffer_.unaligned_width;
+  uint32_t active_height = output_buffer_.unaligned_height;
   output_buffer_.width = hnd->width;
   output_buffer_.height = hnd->height;
   output_buffer_.unaligned_width = width_;
@@ -127,6 +137,12 @@ HWC2::Error HWCDisplayVirtualGPU::SetOutputBuffer(buffer_handle_t buf,
   if (getMetaData(const_cast<private_handle_t *>(hnd), GET_BUFFER_GEOMETRY, &buffer_dim) == 0) {
     output_buffer_.unaligned_width = buffer_dim.sliceWidth;
     output_buffer_.unaligned_height = buffer_dim.sliceHeight;
+  }
+
+  // Cached EGL images are only stale once the sink resizes its buffers. Dropping them for every
+  // output buffer would cost a GPU worker round trip and an EGL image import each frame.
+  if (gl_color_convert_ && (active_width != output_buffer_.unaligned_width ||
+                            active_height != output_buffer_.unaligned_height)) {
     color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeReset, nullptr);
   }
 
@@ -168,6 +184,14 @@ HWC2::Error HWCDisplayVirtualGPU::Present(shared_ptr<Fence> *out_retire_fence) {
     }
   }
 
+  if (NeedsFrameDrop()) {
+    // Output buffer goes back to the sink untouched, holding an earlier frame.
+    DTRACE_SCOPED();
+    frames_dropped_++;
+    *out_retire_fence = output_buffer_.acquire_fence;
+    return status;
+  }
+
   ColorConvertBlitContext ctx = {};
 
   Layer *sdm_layer = client_target_->GetSDMLayer();
@@ -180,6 +204,11 @@ HWC2::Error HWCDisplayVirtualGPU::Present(shared_ptr<Fence> *out_retire_fence) {
   ctx.dst_acquire_fence = output_buffer_.acquire_fence;
 
   color_convert_task_.PerformTask(ColorConvertTaskCode::kCodeBlit, &ctx);
+  frames_converted_++;
+  if (max_pending_frames_ && ctx.release_fence) {
+    pending_fences_.push_back(ctx.release_fence);
+    max_queue_depth_ = std::max(max_queue_depth_, pending_fences_.size());
+  }
 
   // todo blit
   DumpVDSBuffer();
@@ -189,6 +218,35 @@ HWC2::Error HWCDisplayVirtualGPU::Present(shared_ptr<Fence> *out_retire_fence) {
   return status;
 }
 
+bool HWCDisplayVirtualGPU::NeedsFrameDrop() {
+  // Retire the conversions the GPU has finished.
+  while (!pending_fences_.empty() &&
+         Fence::GetStatus(pending_fences_.front()) == Fence::Status::kSignaled) {
+    pending_fences_.pop_front();
+  }
+
+  if (!max_pending_frames_ || pending_fences_.size() < max_pending_frames_) {
+    return false;
+  }
+
+  if (frame_deadline_ms_ &&
+      Fence::Wait(pending_fences_.front(), frame_deadline_ms_) == kErrorNone) {
+    pending_fences_.pop_front();
+    return false;
+  }
+
+  return true;
+}
+
+void HWCDisplayVirtualGPU::Dump(std::ostringstream *os, DumpLevel level) {
+  HWCDisplay::Dump(os, level);
+
+  *os << "GPU color convert frames: " << frames_converted_ << " dropped: " << frames_dropped_;
+  *os << " in flight: " << pending_fences_.size() << " max in flight: " << max_queue_depth_;
+  *os << " limit: " << max_pending_frames_ << " deadline (ms): " << frame_deadline_ms_;
+  *os << std::endl;
+}
+
 void HWCDisplayVirtualGPU::OnTask(const ColorConvertTaskCode &task_code,
                                   SyncTask<ColorConvertTaskCode>::TaskContext *task_context) {
   switch (task_code) {
@@ -214,6 +272,7 @@ void HWCDisplayVirtualGPU::OnTask(const ColorConvertTaskCode &task_code,
     case ColorConvertTaskCode::kCodeDestroyInstance: {
         if (gl_color_convert_) {
           GLColorConvert::Destroy(gl_color_convert_);
+          gl_color_convert_ = nullptr;
         }
       }
       break;
@@ -30,9 +30,12 @@
 #ifndef __HWC_DISPLAY_VIRTUAL_GPU_H__
 #define __HWC_DISPLAY_VIRTUAL_GPU_H__
 
+#include <deque>
+
 #include "utils/sync_task.h"
 #include "hwc_display_virtual.h"
 #include "gl_color_convert.h"
+#include "hwc_gpu_worker.h"
 
 namespace sdm {
 
@@ -68,14 +71,25 @@ class HWCDisplayVirtualGPU : public HWCDisplayVirtual,
   virtual HWC2::Error Validate(uint32_t *out_num_types, uint32_t *out_num_requests);
   virtual HWC2::Error Present(shared_ptr<Fence> *out_retire_fence);
   virtual HWC2::Error SetOutputBuffer(buffer_handle_t buf, shared_ptr<Fence> release_fence);
+  virtual void Dump(std::ostringstream *os, DumpLevel level = kDumpLevelFull);
 
  private:
+  bool NeedsFrameDrop();
+
   // SyncTask methods.
   void OnTask(const ColorConvertTaskCode &task_code,
               SyncTask<ColorConvertTaskCode>::TaskContext *task_context);
 
-  SyncTask<ColorConvertTaskCode> color_convert_task_;
-  GLColorConvert *gl_color_convert_;
+  HWCGPUTask<ColorConvertTaskCode> color_convert_task_;
+  GLColorConvert *gl_color_convert_ = nullptr;
+  // Bounded latency mode. Frames are dropped rather than queued behind a busy GPU once
+  // max_pending_frames_ conversions are in flight and none retires within frame_deadline_ms_.
+  uint32_t max_pending_frames_ = 0;
+  int frame_deadline_ms_ = 0;
+  std::deque<shared_ptr<Fence>> pending_fences_;
+  size_t max_queue_depth_ = 0;
+  uint64_t frames_converted_ = 0;
+  uint64_t frames_dropped_ = 0;
 };
 
 }  // namespace sdm
@@ -0,0 +1,134 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <sync/sync.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <utils/debug.h>
+
+#include <algorithm>
+
+#include "hwc_event_channel.h"
+#include "hwc_state_page.h"
+
+#define __CLASS__ "HWCEventChannel"
+
+namespace sdm {
+
+int HWCEventChannel::Init(const char *name) {
+  if (IsActive()) {
+    return 0;
+  }
+
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0) {
+    DLOGE("Failed to create eventfd. Error %d '%s'.", errno, strerror(errno));
+    return -errno;
+  }
+
+  void *base = nullptr;
+  int fd = CreateReadOnlyRegion(name, sizeof(DisplayEventRing), &base);
+  if (fd < 0) {
+    Deinit();
+    return fd;
+  }
+  ring_fd_ = fd;
+
+  DisplayEventRing *ring = reinterpret_cast<DisplayEventRing *>(base);
+  ring->version = DISPLAY_EVENT_RING_VERSION;
+  ring->size = DISPLAY_EVENT_RING_SIZE;
+  ring_.store(ring, std::memory_order_release);
+
+  return 0;
+}
+
+void HWCEventChannel::Deinit() {
+  std::lock_guard<std::mutex> lock(publish_lock_);
+  DisplayEventRing *ring = ring_.exchange(nullptr);
+  if (ring) {
+    munmap(ring, sizeof(DisplayEventRing));
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+    event_fd_ = -1;
+  }
+}
+
+void HWCEventChannel::Publish(DisplayEventType type, uint64_t frame, int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(publish_lock_);
+  DisplayEventRing *ring = ring_.load(std::memory_order_relaxed);
+  if (!ring) {
+    return;
+  }
+
+  uint64_t number = ring->head.load(std::memory_order_relaxed);
+  DisplayEventSlot &slot = ring->slots[number % DISPLAY_EVENT_RING_SIZE];
+  slot.number.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.data.type = type;
+  slot.data.frame = frame;
+  slot.data.timestamp_ns = timestamp_ns;
+  slot.number.store(number + 1, std::memory_order_release);
+  ring->head.store(number + 1, std::memory_order_release);
+
+  // Wakes up pollers; the count saturating while nobody reads is harmless.
+  uint64_t count = 1;
+  if (write(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    DLOGW("Failed to signal display event. Error %d '%s'.", errno, strerror(errno));
+  }
+}
+
+int64_t HWCEventChannel::GetSignalTime(int fd) {
+  struct sync_file_info *file_info = sync_file_info(fd);
+  if (!file_info) {
+    return 0;
+  }
+
+  // A merged fence signals with the last of its fences.
+  int64_t timestamp_ns = 0;
+  struct sync_fence_info *fence_info = sync_get_fence_info(file_info);
+  if (file_info->status == 1 && fence_info) {
+    for (size_t i = 0; i < file_info->num_fences; i++) {
+      timestamp_ns = std::max(timestamp_ns, static_cast<int64_t>(fence_info[i].timestamp_ns));
+    }
+  }
+  sync_file_info_free(file_info);
+
+  return timestamp_ns;
+}
+
+}  // namespace sdm
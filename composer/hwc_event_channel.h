@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_EVENT_CHANNEL_H__
+#define __HWC_EVENT_CHANNEL_H__
+
+#include <display_event_ring.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace sdm {
+
+// Writer of the DisplayEventRing of a display. Events come from both the present path and the
+// vsync thread, so publishing is serialized here; clients only ever read the ring.
+class HWCEventChannel {
+ public:
+  ~HWCEventChannel() { Deinit(); }
+  int Init(const char *name);
+  void Deinit();
+  bool IsActive() const { return ring_.load(std::memory_order_acquire) != nullptr; }
+  int GetRingFd() const { return ring_fd_; }
+  int GetEventFd() const { return event_fd_; }
+  void Publish(DisplayEventType type, uint64_t frame, int64_t timestamp_ns);
+  // Returns the time the fence fd signaled at, or 0 if it has not signaled yet.
+  static int64_t GetSignalTime(int fd);
+
+ private:
+  std::mutex publish_lock_;
+  std::atomic<DisplayEventRing *> ring_ = {nullptr};
+  int ring_fd_ = -1;
+  int event_fd_ = -1;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_EVENT_CHANNEL_H__
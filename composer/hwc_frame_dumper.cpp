@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <lz4.h>
+#include <qdMetaData.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/thread_policy.h>
+
+#include <algorithm>
+
+#include "hwc_debugger.h"
+#include "hwc_frame_dumper.h"
+
+#define __CLASS__ "HWCFrameDumper"
+
+namespace sdm {
+
+int HWCFrameDumper::Init(const char *dir_path, size_t ring_size, const FrameDumpOptions &options) {
+  if (IsActive()) {
+    return 0;
+  }
+
+  if (ring_size <= sizeof(RingHeader) + sizeof(FrameDumpRecord)) {
+    return -EINVAL;
+  }
+
+  char ring_path[PATH_MAX];
+  snprintf(ring_path, sizeof(ring_path), "%s/frame_dump_ring.bin", dir_path);
+
+  ring_fd_ = open(ring_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (ring_fd_ < 0) {
+    DLOGE("Failed to open %s errno = %d, desc = %s", ring_path, errno, strerror(errno));
+    return -errno;
+  }
+
+  // Reserve the blocks up front so that the worker never extends the file while dumping.
+  int err = posix_fallocate(ring_fd_, 0, static_cast<off_t>(ring_size));
+  if (err) {
+    DLOGE("Failed to allocate %zu bytes for %s, error = %d", ring_size, ring_path, err);
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return -err;
+  }
+
+  void *base = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd_, 0);
+  if (base == MAP_FAILED) {
+    DLOGE("Failed to map %s errno = %d, desc = %s", ring_path, errno, strerror(errno));
+    close(ring_fd_);
+    ring_fd_ = -1;
+    return -errno;
+  }
+
+  ring_base_ = reinterpret_cast<uint8_t *>(base);
+  ring_size_ = ring_size;
+  options_ = options;
+
+  RingHeader *header = reinterpret_cast<RingHeader *>(ring_base_);
+  *header = {};
+  header->magic = kRecordMagic;
+  header->version = 2;
+  header->ring_size = ring_size_;
+  header->write_offset = sizeof(RingHeader);
+
+  exit_ = false;
+  worker_ = std::thread(&HWCFrameDumper::WorkerThread, this);
+
+  DLOGI("Frame dump ring %s of %zu bytes, compression %d usage mask 0x%" PRIx64 " name '%s'",
+        ring_path, ring_size_, options_.compress, options_.usage_mask, options_.name.c_str());
+
+  return 0;
+}
+
+void HWCFrameDumper::Deinit() {
+  if (!IsActive()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    exit_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+
+  // Drop the requests the worker did not get to.
+  for (auto &request : requests_) {
+    CloseRequest(&request);
+  }
+  requests_.clear();
+
+  msync(ring_base_, ring_size_, MS_ASYNC);
+  munmap(ring_base_, ring_size_);
+  close(ring_fd_);
+  ring_base_ = nullptr;
+  ring_size_ = 0;
+  ring_fd_ = -1;
+}
+
+void HWCFrameDumper::DumpBuffer(int fd, size_t size, int metadata_fd,
+                                const shared_ptr<Fence> &fence, FrameDumpRecord record) {
+  if (options_.usage_mask && !(record.usage & options_.usage_mask)) {
+    return;
+  }
+
+  Request request;
+  request.fd = dup(fd);
+  if (request.fd < 0) {
+    DLOGW("Failed to dup buffer fd %d errno = %d", fd, errno);
+    return;
+  }
+  if (metadata_fd >= 0) {
+    // Dump the buffer without its metadata if this fails.
+    request.metadata_fd = dup(metadata_fd);
+  }
+  request.size = size;
+  request.fence = fence;
+  request.record = record;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (IsActive() && requests_.size() < kMaxPendingRequests) {
+      requests_.push_back(request);
+      cv_.notify_one();
+      return;
+    }
+  }
+
+  DLOGW("Dropping dump of frame %d layer %d", request.record.frame_index,
+        request.record.layer_index);
+  CloseRequest(&request);
+}
+
+void HWCFrameDumper::CloseRequest(Request *request) {
+  close(request->fd);
+  if (request->metadata_fd >= 0) {
+    close(request->metadata_fd);
+  }
+  request->fd = -1;
+  request->metadata_fd = -1;
+}
+
+void HWCFrameDumper::WorkerThread() {
+  ThreadPolicy::Apply(kThreadClassBackground, "HWC_FrameDump");
+
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      cv_.wait(lock, [this] { return exit_ || !requests_.empty(); });
+      if (exit_) {
+        break;
+      }
+      request = requests_.front();
+      requests_.pop_front();
+    }
+
+    WriteRecord(request);
+    CloseRequest(&request);
+  }
+}
+
+void HWCFrameDumper::WriteRecord(const Request &request) {
+  if (Fence::Wait(request.fence) != kErrorNone) {
+    DLOGW("sync_wait error errno = %d, desc = %s", errno, strerror(errno));
+    return;
+  }
+
+  FrameDumpRecord record = request.record;
+  void *metadata = nullptr;
+  if (request.metadata_fd >= 0) {
+    metadata = mmap(nullptr, sizeof(MetaData_t), PROT_READ, MAP_SHARED, request.metadata_fd, 0);
+    if (metadata == MAP_FAILED) {
+      DLOGW("Failed to map metadata errno = %d, desc = %s", errno, strerror(errno));
+      metadata = nullptr;
+    } else {
+      const MetaData_t *meta = reinterpret_cast<const MetaData_t *>(metadata);
+      snprintf(record.name, sizeof(record.name), "%.*s", INT(sizeof(record.name) - 1),
+               meta->name);
+      record.metadata_size = sizeof(MetaData_t);
+    }
+  }
+
+  if (!options_.name.empty() && !strstr(record.name, options_.name.c_str())) {
+    if (metadata) {
+      munmap(metadata, sizeof(MetaData_t));
+    }
+    return;
+  }
+
+  // Reserve room for the worst case, since the compressed size is only known afterwards.
+  int bound = options_.compress ? LZ4_compressBound(INT(request.size)) : 0;
+  size_t max_stored_size = (bound > 0) ? std::max(size_t(bound), request.size) : request.size;
+  size_t record_size = sizeof(FrameDumpRecord) + record.metadata_size + max_stored_size;
+  void *src = MAP_FAILED;
+  if (record_size > ring_size_ - sizeof(RingHeader)) {
+    DLOGW("Buffer of %zu bytes does not fit in the dump ring", request.size);
+  } else {
+    src = mmap(nullptr, request.size, PROT_READ, MAP_SHARED, request.fd, 0);
+    if (src == MAP_FAILED) {
+      DLOGW("Failed to map buffer errno = %d, desc = %s", errno, strerror(errno));
+    }
+  }
+
+  if (src == MAP_FAILED) {
+    if (metadata) {
+      munmap(metadata, sizeof(MetaData_t));
+    }
+    return;
+  }
+
+  RingHeader *header = reinterpret_cast<RingHeader *>(ring_base_);
+  uint64_t offset = header->write_offset;
+  if (offset + record_size > ring_size_) {
+    // Mark the tail as unused and wrap around.
+    if (offset + sizeof(uint32_t) <= ring_size_) {
+      memset(ring_base_ + offset, 0, sizeof(uint32_t));
+    }
+    offset = sizeof(RingHeader);
+  }
+
+  uint8_t *dst = ring_base_ + offset + sizeof(record);
+  if (metadata) {
+    memcpy(dst, metadata, record.metadata_size);
+    munmap(metadata, sizeof(MetaData_t));
+    dst += record.metadata_size;
+  }
+
+  record.magic = kRecordMagic;
+  record.size = request.size;
+  record.stored_size = request.size;
+  record.flags = 0;
+  if (bound > 0) {
+    int compressed_size = LZ4_compress_default(reinterpret_cast<const char *>(src),
+                                               reinterpret_cast<char *>(dst), INT(request.size),
+                                               bound);
+    if (compressed_size > 0 && size_t(compressed_size) < request.size) {
+      record.stored_size = UINT64(compressed_size);
+      record.flags |= kFrameDumpCompressed;
+    }
+  }
+  if (!(record.flags & kFrameDumpCompressed)) {
+    memcpy(dst, src, request.size);
+  }
+  memcpy(ring_base_ + offset, &record, sizeof(record));
+
+  header->write_offset = offset + sizeof(record) + record.metadata_size + record.stored_size;
+  header->num_records++;
+
+  munmap(src, request.size);
+
+  DLOGI("Frame dump of frame %d layer %d %dx%d %s '%s': %zu bytes stored in %" PRIu64
+        " at offset %" PRIu64, record.frame_index, record.layer_index, record.width,
+        record.height, record.format_name, record.name, request.size, record.stored_size, offset);
+}
+
+}  // namespace sdm
@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_FRAME_DUMPER_H__
+#define __HWC_FRAME_DUMPER_H__
+
+#include <utils/fence.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sdm {
+
+// Record header preceding every buffer stored in the ring file. The header is followed by
+// metadata_size bytes of buffer metadata and stored_size bytes of buffer contents, which are
+// LZ4 compressed when kFrameDumpCompressed is set in flags.
+struct FrameDumpRecord {
+  uint32_t magic = 0;
+  uint32_t frame_index = 0;
+  uint32_t layer_index = 0;
+  uint32_t width = 0;  // Aligned
+  uint32_t height = 0;  // Aligned
+  int32_t format = 0;
+  uint64_t size = 0;
+  char format_name[32] = {};
+  uint32_t unaligned_width = 0;
+  uint32_t unaligned_height = 0;
+  uint64_t usage = 0;
+  uint32_t buffer_flags = 0;  // private_handle_t flags
+  uint32_t flags = 0;
+  uint64_t stored_size = 0;
+  uint32_t metadata_size = 0;
+  char name[64] = {};
+};
+
+enum FrameDumpRecordFlags {
+  kFrameDumpCompressed = 0x1,
+};
+
+struct FrameDumpOptions {
+  bool compress = true;
+  uint64_t usage_mask = 0;  // Dump only buffers sharing a usage bit when set
+  std::string name;  // Dump only buffers whose name contains this when set
+};
+
+// Captures buffers into a preallocated, memory-mapped ring file. Callers only enqueue a buffer
+// descriptor; a worker waits for the fence and copies the buffer contents into the ring.
+class HWCFrameDumper {
+ public:
+  ~HWCFrameDumper() { Deinit(); }
+  int Init(const char *dir_path, size_t ring_size, const FrameDumpOptions &options);
+  void Deinit();
+  bool IsActive() { return ring_base_ != nullptr; }
+  // The fds are duped and the buffer is mapped by the worker once the fence signals. The buffer
+  // metadata is stored along with it when metadata_fd is valid.
+  void DumpBuffer(int fd, size_t size, int metadata_fd, const shared_ptr<Fence> &fence,
+                  FrameDumpRecord record);
+
+ private:
+  static const uint32_t kRecordMagic = 0x504d4446;  // "FDMP"
+  static const uint32_t kMaxPendingRequests = 32;
+
+  // Placed at the start of the ring file so that tools can find the most recent record.
+  struct RingHeader {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t ring_size = 0;
+    uint64_t write_offset = 0;
+    uint64_t num_records = 0;
+  };
+
+  struct Request {
+    int fd = -1;
+    int metadata_fd = -1;
+    size_t size = 0;
+    shared_ptr<Fence> fence = nullptr;
+    FrameDumpRecord record = {};
+  };
+
+  void WorkerThread();
+  void WriteRecord(const Request &request);
+  void CloseRequest(Request *request);
+
+  int ring_fd_ = -1;
+  uint8_t *ring_base_ = nullptr;
+  size_t ring_size_ = 0;
+  FrameDumpOptions options_;
+  std::thread worker_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<Request> requests_;
+  bool exit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_FRAME_DUMPER_H__
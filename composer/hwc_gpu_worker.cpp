@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <utils/debug.h>
+#include <utils/thread_policy.h>
+
+#include "hwc_gpu_worker.h"
+
+#define __CLASS__ "HWCGPUWorker"
+
+namespace sdm {
+
+HWCGPUWorker *HWCGPUWorker::GetInstance() {
+  static HWCGPUWorker gpu_worker;
+
+  return &gpu_worker;
+}
+
+HWCGPUWorker::HWCGPUWorker() {
+  std::thread worker_thread(&HWCGPUWorker::Run, this);
+  worker_thread_id_ = worker_thread.get_id();
+  worker_thread_.swap(worker_thread);
+}
+
+HWCGPUWorker::~HWCGPUWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+    worker_cv_.notify_one();
+  }
+
+  worker_thread_.join();
+}
+
+void HWCGPUWorker::PerformTask(const std::function<void()> &task) {
+  if (std::this_thread::get_id() == worker_thread_id_) {
+    task();
+    return;
+  }
+
+  Task pending = {};
+  pending.task = &task;
+
+  std::unique_lock<std::mutex> caller_lock(mutex_);
+  tasks_.push_back(&pending);
+  worker_cv_.notify_one();
+  caller_cv_.wait(caller_lock, [&pending] { return pending.done; });
+}
+
+void HWCGPUWorker::Run() {
+  ThreadPolicy::Apply(kThreadClassGPU, "HWC_GPUWorker");
+
+  std::unique_lock<std::mutex> worker_lock(mutex_);
+
+  while (!exit_) {
+    // Add predicate to handle spurious interrupts.
+    worker_cv_.wait(worker_lock, [this] { return exit_ || !tasks_.empty(); });
+
+    while (!tasks_.empty()) {
+      Task *task = tasks_.front();
+      tasks_.pop_front();
+
+      // Let other callers queue up while this task runs.
+      worker_lock.unlock();
+      (*task->task)();
+      worker_lock.lock();
+
+      task->done = true;
+      caller_cv_.notify_all();
+    }
+  }
+
+  DLOGI("GPU worker thread exiting");
+}
+
+}  // namespace sdm
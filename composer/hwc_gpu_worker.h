@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HWC_GPU_WORKER_H__
+#define __HWC_GPU_WORKER_H__
+
+#include <utils/sync_task.h>
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace sdm {
+
+// Single worker thread shared by all composer GPU clients (tonemapper, layer stitch and color
+// convert). GL contexts are current on one thread only, so the clients' jobs are queued here and
+// run in order instead of each client owning a thread. Completion of the GPU work itself is still
+// signaled through the fences the jobs return.
+class HWCGPUWorker {
+ public:
+  static HWCGPUWorker *GetInstance();
+
+  // Runs the task on the worker thread and blocks until it returns. Tasks issued from the worker
+  // thread itself run inline.
+  void PerformTask(const std::function<void()> &task);
+
+ private:
+  struct Task {
+    const std::function<void()> *task = nullptr;
+    bool done = false;
+  };
+
+  HWCGPUWorker();
+  ~HWCGPUWorker();
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable worker_cv_;
+  std::condition_variable caller_cv_;
+  std::deque<Task *> tasks_;
+  std::thread worker_thread_;
+  std::thread::id worker_thread_id_;
+  bool exit_ = false;
+};
+
+// Drop-in replacement for SyncTask whose tasks run on the shared GPU worker thread.
+template <class TaskCode>
+class HWCGPUTask {
+ public:
+  explicit HWCGPUTask(typename SyncTask<TaskCode>::TaskHandler &task_handler)
+    : task_handler_(task_handler) { }
+
+  void PerformTask(const TaskCode &task_code,
+                   typename SyncTask<TaskCode>::TaskContext *task_context) {
+    HWCGPUWorker::GetInstance()->PerformTask([&]() {
+      task_handler_.OnTask(task_code, task_context);
+    });
+  }
+
+ private:
+  typename SyncTask<TaskCode>::TaskHandler &task_handler_;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_GPU_WORKER_H__
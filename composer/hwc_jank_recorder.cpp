@@ -0,0 +1,328 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/thread_policy.h>
+
+#include <algorithm>
+
+#include "hwc_event_channel.h"
+#include "hwc_jank_recorder.h"
+
+#define __CLASS__ "HWCJankRecorder"
+
+namespace sdm {
+
+int HWCJankRecorder::Init(int32_t sdm_id, uint32_t frames, const char *dir_path) {
+  if (IsActive() || !frames) {
+    return 0;
+  }
+
+  // Everything a capture touches is allocated here, so that frames never allocate.
+  frames = std::min(frames, kMaxFrames);
+  sdm_id_ = sdm_id;
+  ring_.assign(frames, JankFrameRecord());
+  pending_acquire_fences_.reserve(kMaxAcquireFences);
+  for (auto &snapshot : snapshots_) {
+    snapshot.frames.reserve(frames);
+  }
+
+  if (dir_path && *dir_path) {
+    dir_path_ = dir_path;
+    file_snapshot_.frames.reserve(frames);
+    exit_ = false;
+    writer_ = std::thread(&HWCJankRecorder::WriterThread, this);
+  }
+
+  DLOGI("Recording %u frames of display %d, captures written to '%s'", frames, sdm_id_,
+        dir_path_.c_str());
+
+  return 0;
+}
+
+void HWCJankRecorder::Deinit() {
+  if (!IsActive()) {
+    return;
+  }
+
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      exit_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+  }
+
+  ring_.clear();
+  pending_retire_fence_ = nullptr;
+  pending_acquire_fences_.clear();
+  recorded_ = 0;
+  dir_path_.clear();
+  file_pending_ = false;
+}
+
+void HWCJankRecorder::OnCommit(const LayerStack &layer_stack, uint64_t frame, uint64_t expected_ns,
+                               uint64_t vsync_period_ns, uint64_t lock_wait_ns, bool held) {
+  if (!IsActive()) {
+    return;
+  }
+
+  uint64_t now = FrameTiming::Now();
+  CheckPrevious(now);
+
+  JankFrameRecord &record = ring_[recorded_ % ring_.size()];
+  record = {};
+  record.frame = frame;
+  record.commit_ns = now;
+  record.expected_ns = expected_ns;
+  record.lock_wait_ns = lock_wait_ns;
+  record.dram_ib_bps = layer_stack.qos_dram_ib_bps;
+  record.clock_hz = layer_stack.qos_clock_hz;
+  for (uint32_t stage = 0; stage < kFrameStageHWEvent; stage++) {
+    // The present stage is recorded once the present returns, it is filled in on the next commit.
+    if (stage != kFrameStagePresent) {
+      record.stage_us[stage] = UINT32(FrameTiming::GetLatest(sdm_id_, FrameStage(stage)) / 1000);
+    }
+  }
+  if (layer_stack.flags.geometry_changed) {
+    record.flags |= kJankFrameGeometryChanged;
+  }
+  if (held) {
+    record.flags |= kJankFrameHeld;
+  }
+
+  // Only the fences the display waits on are kept, layers composed by the client are waited on
+  // by the GPU before the client target signals.
+  pending_acquire_fences_.clear();
+  for (auto layer : layer_stack.layers) {
+    switch (layer->composition) {
+      case kCompositionGPU:
+        record.gpu_layers++;
+        continue;
+      case kCompositionStitch:
+        record.stitch_layers++;
+        continue;
+      case kCompositionSDE:
+      case kCompositionCursor:
+        record.sde_layers++;
+        break;
+      case kCompositionNone:
+        record.dropped_layers++;
+        continue;
+    default:
+        break;
+    }
+    if (layer->input_buffer.acquire_fence &&
+        pending_acquire_fences_.size() < kMaxAcquireFences) {
+      pending_acquire_fences_.push_back(layer->input_buffer.acquire_fence);
+    }
+  }
+  record.layers = UINT16(record.gpu_layers + record.stitch_layers + record.sde_layers +
+                         record.dropped_layers);
+
+  pending_retire_fence_ = layer_stack.retire_fence;
+  vsync_period_ns_ = vsync_period_ns;
+  recorded_++;
+}
+
+void HWCJankRecorder::CheckPrevious(uint64_t now) {
+  if (!recorded_ || !pending_retire_fence_) {
+    return;
+  }
+
+  JankFrameRecord &record = ring_[(recorded_ - 1) % ring_.size()];
+  record.stage_us[kFrameStagePresent] =
+      UINT32(FrameTiming::GetLatest(sdm_id_, kFrameStagePresent) / 1000);
+
+  Fence::ScopedRef scoped_ref;
+  int64_t retire_ns = HWCEventChannel::GetSignalTime(scoped_ref.Get(pending_retire_fence_));
+  pending_retire_fence_ = nullptr;
+  if (!record.expected_ns || !vsync_period_ns_) {
+    return;
+  }
+
+  // A frame still pending a period past its vsync has missed it, without waiting to see by how
+  // much.
+  record.retire_ns = UINT64(retire_ns);
+  bool missed = retire_ns ? (record.retire_ns > record.expected_ns + (vsync_period_ns_ / 2)) :
+                            (now > record.expected_ns + vsync_period_ns_);
+  if (!missed) {
+    return;
+  }
+
+  // Fences are only looked at for missed frames, a pending one waited until now at least.
+  for (auto &fence : pending_acquire_fences_) {
+    int64_t signal_ns = HWCEventChannel::GetSignalTime(scoped_ref.Get(fence));
+    uint64_t signaled_ns = signal_ns ? UINT64(signal_ns) : now;
+    if (signaled_ns > record.commit_ns) {
+      record.acquire_wait_ns = std::max(record.acquire_wait_ns, signaled_ns - record.commit_ns);
+    }
+  }
+  record.flags |= kJankFrameMissed;
+  missed_++;
+
+  Capture(now);
+}
+
+void HWCJankRecorder::Capture(uint64_t now) {
+  // A stall usually misses several vsyncs in a row, the first capture already holds its frames.
+  if (last_capture_ns_ && (now - last_capture_ns_ < kCaptureIntervalNs)) {
+    return;
+  }
+  last_capture_ns_ = now;
+
+  Snapshot &snapshot = snapshots_[snapshot_count_ % kMaxSnapshots];
+  snapshot.capture_ns = now;
+  snapshot.vsync_period_ns = vsync_period_ns_;
+  snapshot.frames.clear();
+  uint64_t count = std::min(recorded_, UINT64(ring_.size()));
+  for (uint64_t i = recorded_ - count; i < recorded_; i++) {
+    snapshot.frames.push_back(ring_[i % ring_.size()]);
+  }
+  snapshot_count_++;
+
+  if (dir_path_.empty() || (last_file_ns_ && (now - last_file_ns_ < kFileIntervalNs))) {
+    return;
+  }
+
+  // Skipped rather than waited for while the writer is busy.
+  std::unique_lock<std::mutex> lock(lock_, std::try_to_lock);
+  if (!lock.owns_lock() || file_pending_) {
+    return;
+  }
+  file_snapshot_.capture_ns = snapshot.capture_ns;
+  file_snapshot_.vsync_period_ns = snapshot.vsync_period_ns;
+  file_snapshot_.frames = snapshot.frames;
+  file_pending_ = true;
+  last_file_ns_ = now;
+  cv_.notify_one();
+}
+
+void HWCJankRecorder::Format(const Snapshot &snapshot, std::ostringstream *os) {
+  if (snapshot.frames.empty()) {
+    return;
+  }
+
+  const JankFrameRecord &missed = snapshot.frames.back();
+  *os << "Display " << sdm_id_ << " missed vsync on frame " << missed.frame << " at "
+      << snapshot.capture_ns / 1000000 << " ms, ";
+  if (missed.retire_ns) {
+    *os << "retired " << (missed.retire_ns - missed.expected_ns) / 1000 << " us late";
+  } else {
+    *os << "not retired " << (snapshot.capture_ns - missed.expected_ns) / 1000 << " us late";
+  }
+  *os << ", acquire fences signaled " << missed.acquire_wait_ns / 1000
+      << " us after commit, vsync period " << snapshot.vsync_period_ns / 1000 << " us\n";
+
+  *os << "  frame commit(us) late(us) lock(us)";
+  for (uint32_t stage = 0; stage < kFrameStageHWEvent; stage++) {
+    *os << " " << FrameTiming::GetStageName(FrameStage(stage));
+  }
+  *os << " layers gpu sde stitch none clk(MHz) dram_ib(MBps) flags\n";
+
+  // Commit times are relative to the missed frame, lateness to the vsync of each frame.
+  for (auto &record : snapshot.frames) {
+    *os << "  " << record.frame << " "
+        << (static_cast<int64_t>(record.commit_ns) - static_cast<int64_t>(missed.commit_ns)) / 1000
+        << " ";
+    if (record.retire_ns && record.expected_ns) {
+      *os << (static_cast<int64_t>(record.retire_ns) -
+              static_cast<int64_t>(record.expected_ns)) / 1000;
+    } else {
+      *os << "-";
+    }
+    *os << " " << record.lock_wait_ns / 1000;
+    for (uint32_t stage = 0; stage < kFrameStageHWEvent; stage++) {
+      *os << " " << record.stage_us[stage];
+    }
+    *os << " " << record.layers << " " << record.gpu_layers << " " << record.sde_layers << " "
+        << record.stitch_layers << " " << record.dropped_layers << " "
+        << record.clock_hz / 1000000 << " " << record.dram_ib_bps / 1000000 << " "
+        << ((record.flags & kJankFrameGeometryChanged) ? "G" : "")
+        << ((record.flags & kJankFrameHeld) ? "H" : "")
+        << ((record.flags & kJankFrameMissed) ? "M" : "") << "\n";
+  }
+}
+
+void HWCJankRecorder::Dump(std::ostringstream *os) {
+  if (!IsActive()) {
+    return;
+  }
+
+  *os << "Jank recorder: " << recorded_ << " frames, " << missed_ << " missed vsync, "
+      << snapshot_count_ << " captured";
+  if (!dir_path_.empty()) {
+    *os << " to " << dir_path_;
+  }
+  *os << "\n";
+
+  uint32_t first = (snapshot_count_ > kMaxSnapshots) ? (snapshot_count_ - kMaxSnapshots) : 0;
+  for (uint32_t i = first; i < snapshot_count_; i++) {
+    Format(snapshots_[i % kMaxSnapshots], os);
+  }
+}
+
+void HWCJankRecorder::WriterThread() {
+  ThreadPolicy::Apply(kThreadClassBackground, "HWC_JankWriter");
+
+  while (true) {
+    std::ostringstream os;
+    uint64_t frame = 0;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      cv_.wait(lock, [this] { return exit_ || file_pending_; });
+      if (exit_) {
+        break;
+      }
+      Format(file_snapshot_, &os);
+      frame = file_snapshot_.frames.back().frame;
+      file_pending_ = false;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/jank_%d_%" PRIu64 ".txt", dir_path_.c_str(), sdm_id_,
+             frame);
+    FILE *file = fopen(path, "w");
+    if (!file) {
+      DLOGW("Failed to open %s errno = %d, desc = %s", path, errno, strerror(errno));
+      continue;
+    }
+    fputs(os.str().c_str(), file);
+    fclose(file);
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,127 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_JANK_RECORDER_H__
+#define __HWC_JANK_RECORDER_H__
+
+#include <core/layer_stack.h>
+#include <utils/fence.h>
+#include <utils/frame_timing.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sdm {
+
+enum JankFrameFlags {
+  kJankFrameGeometryChanged = 0x1,
+  kJankFrameHeld = 0x2,  // Held back for an expected present time
+  kJankFrameMissed = 0x4,
+};
+
+// Compact summary of one committed frame. Stages after kFrameStageDRMCommit are not per frame.
+struct JankFrameRecord {
+  uint64_t frame = 0;
+  uint64_t commit_ns = 0;
+  uint64_t expected_ns = 0;  // Vsync the frame was meant to be shown on
+  uint64_t retire_ns = 0;  // 0 until the retire fence is seen signaled
+  uint64_t lock_wait_ns = 0;  // Wait for the display lock at present
+  uint64_t acquire_wait_ns = 0;  // Last acquire fence signal after commit, missed frames only
+  uint64_t dram_ib_bps = 0;
+  uint32_t clock_hz = 0;
+  uint32_t stage_us[kFrameStageHWEvent] = {};
+  uint16_t layers = 0;
+  uint16_t gpu_layers = 0;
+  uint16_t sde_layers = 0;
+  uint16_t stitch_layers = 0;
+  uint16_t dropped_layers = 0;
+  uint16_t flags = 0;
+};
+
+// Keeps a summary of the recent frames of a display in a preallocated ring, and captures the ring
+// when a frame retires later than the vsync it was committed for. Retire fences are checked
+// without waiting when the next frame is committed, so recording adds no blocking to a frame.
+// Captures are kept for dumpsys and optionally written to a directory, both rate limited.
+class HWCJankRecorder {
+ public:
+  ~HWCJankRecorder() { Deinit(); }
+  int Init(int32_t sdm_id, uint32_t frames, const char *dir_path);
+  void Deinit();
+  bool IsActive() { return !ring_.empty(); }
+  // Records a frame that was just committed; layer_stack still holds its fences.
+  void OnCommit(const LayerStack &layer_stack, uint64_t frame, uint64_t expected_ns,
+                uint64_t vsync_period_ns, uint64_t lock_wait_ns, bool held);
+  void Dump(std::ostringstream *os);
+
+ private:
+  static const uint32_t kMaxFrames = 256;
+  static const uint32_t kMaxSnapshots = 4;
+  static const uint32_t kMaxAcquireFences = 32;
+  static const uint64_t kCaptureIntervalNs = 1000000000ULL;
+  static const uint64_t kFileIntervalNs = 10000000000ULL;
+
+  struct Snapshot {
+    uint64_t capture_ns = 0;
+    uint64_t vsync_period_ns = 0;
+    std::vector<JankFrameRecord> frames;  // Oldest first, the missed frame last
+  };
+
+  void CheckPrevious(uint64_t now);
+  void Capture(uint64_t now);
+  void Format(const Snapshot &snapshot, std::ostringstream *os);
+  void WriterThread();
+
+  int32_t sdm_id_ = -1;
+  std::vector<JankFrameRecord> ring_;
+  uint64_t recorded_ = 0;
+  uint64_t missed_ = 0;
+  uint64_t vsync_period_ns_ = 0;
+  shared_ptr<Fence> pending_retire_fence_ = nullptr;
+  std::vector<shared_ptr<Fence>> pending_acquire_fences_;
+  Snapshot snapshots_[kMaxSnapshots];
+  uint32_t snapshot_count_ = 0;
+  uint64_t last_capture_ns_ = 0;
+  uint64_t last_file_ns_ = 0;
+
+  std::string dir_path_;
+  std::thread writer_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  Snapshot file_snapshot_;
+  bool file_pending_ = false;
+  bool exit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_JANK_RECORDER_H__
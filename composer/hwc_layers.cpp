@@ -18,10 +18,13 @@
  */
 
 #include "hwc_layers.h"
+#include "gr_utils.h"
 #include <qdMetaData.h>
 #include <qd_utils.h>
 #include <utils/debug.h>
+#include <utils/Timers.h>
 #include <stdint.h>
+#include <algorithm>
 #include <utility>
 #include <cmath>
 
@@ -31,12 +34,68 @@ namespace sdm {
 
 std::atomic<hwc2_layer_t> HWCLayer::next_id_(1);
 
+constexpr uint32_t LayerCadence::kNumIntervals;
+constexpr int64_t LayerCadence::kMaxIntervalNs;
+
+void LayerCadence::OnBufferLatched(int64_t time_ns) {
+  int64_t interval_ns = time_ns - last_latch_ns_;
+  last_latch_ns_ = time_ns;
+  if (interval_ns <= 0 || interval_ns > kMaxIntervalNs) {
+    num_intervals_ = 0;
+    next_interval_ = 0;
+    return;
+  }
+
+  intervals_ns_[next_interval_] = interval_ns;
+  next_interval_ = (next_interval_ + 1) % kNumIntervals;
+  num_intervals_ = std::min(num_intervals_ + 1, kNumIntervals);
+}
+
+LayerCadence::State LayerCadence::GetState(int64_t now_ns, int64_t vsync_period_ns,
+                                           uint32_t *fps) const {
+  if (!last_latch_ns_ || (now_ns - last_latch_ns_) > kMaxIntervalNs) {
+    return kIdle;
+  }
+
+  // Too few samples to tell a steady rate from the start of an animation.
+  if (num_intervals_ < kNumIntervals) {
+    return kIrregular;
+  }
+
+  int64_t total_ns = 0;
+  for (uint32_t i = 0; i < kNumIntervals; i++) {
+    total_ns += intervals_ns_[i];
+  }
+  int64_t mean_ns = total_ns / kNumIntervals;
+
+  // The layer has gone quiet for longer than its own cadence, the next update may start a burst.
+  if ((now_ns - last_latch_ns_) > (2 * mean_ns + vsync_period_ns)) {
+    return kIrregular;
+  }
+
+  for (uint32_t i = 0; i < kNumIntervals; i++) {
+    if (std::abs(intervals_ns_[i] - mean_ns) > vsync_period_ns) {
+      return kIrregular;
+    }
+  }
+
+  *fps = UINT32((kNumIntervals * 1000000000LL + total_ns / 2) / total_ns);
+
+  return (*fps ? kSteady : kIrregular);
+}
+
 DisplayError SetCSC(const private_handle_t *pvt_handle, ColorMetaData *color_metadata) {
-  if (getMetaData(const_cast<private_handle_t *>(pvt_handle), GET_COLOR_METADATA,
-                  color_metadata) != 0) {
-    ColorSpace_t csc = ITU_R_601;
-    if (getMetaData(const_cast<private_handle_t *>(pvt_handle),  GET_COLOR_SPACE,
-                    &csc) == 0) {
+  gralloc::MetaDataSnapshot snapshot;
+  gralloc::GetMetaDataSnapshot(const_cast<private_handle_t *>(pvt_handle), &snapshot);
+  return SetCSC(snapshot, color_metadata);
+}
+
+DisplayError SetCSC(const gralloc::MetaDataSnapshot &snapshot, ColorMetaData *color_metadata) {
+  if (snapshot.has_color_metadata) {
+    *color_metadata = snapshot.color_metadata;
+  } else {
+    ColorSpace_t csc = snapshot.color_space;
+    if (snapshot.has_color_space) {
       if (csc == ITU_R_601_FR || csc == ITU_R_2020_FR) {
         color_metadata->range = Range_Full;
       }
@@ -208,7 +267,7 @@ bool GetSDMColorSpace(const int32_t &dataspace, ColorMetaData *color_metadata) {
 // Layer operations
 HWCLayer::HWCLayer(hwc2_display_t display_id, HWCBufferAllocator *buf_allocator)
   : id_(next_id_++), display_id_(display_id), buffer_allocator_(buf_allocator) {
-  layer_ = new Layer();
+  layer_ = &sdm_layer_;
   // Fences are deferred, so the first time this layer is presented, return -1
   // TODO(user): Verify that fences are properly obtained on suspend/resume
   release_fences_.push_back(nullptr);
@@ -219,11 +278,8 @@ HWCLayer::~HWCLayer() {
   while (!release_fences_.empty()) {
     release_fences_.pop_front();
   }
-  if (layer_) {
-    if (buffer_fd_ >= 0) {
-      ::close(buffer_fd_);
-    }
-    delete layer_;
+  if (buffer_fd_ >= 0) {
+    ::close(buffer_fd_);
   }
 }
 
@@ -254,7 +310,14 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, shared_ptr<Fence> a
       (UINT32(aligned_height) != layer_buffer->height)) {
     // Layer buffer geometry has changed.
     geometry_changes_ |= kBufferGeometry;
+    dirty_mask_ |= kLayerDirtyGeometry;
   }
+  dirty_mask_ |= kLayerDirtyBuffer;
+
+  bool single_buffer = single_buffer_;
+  bool dataspace_supported = dataspace_supported_;
+  ColorPrimaries color_primaries = layer_buffer->color_metadata.colorPrimaries;
+  GammaTransfer transfer = layer_buffer->color_metadata.transfer;
 
   layer_buffer->format = format;
   layer_buffer->width = UINT32(aligned_width);
@@ -267,6 +330,19 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, shared_ptr<Fence> a
     return HWC2::Error::BadLayer;
   }
 
+  if ((single_buffer != single_buffer_) || (handle->flags != buffer_flags_) ||
+      (handle->buffer_type != buffer_type_)) {
+    dirty_mask_ |= kLayerDirtyMetadata;
+    buffer_flags_ = handle->flags;
+    buffer_type_ = handle->buffer_type;
+  }
+
+  if ((dataspace_supported != dataspace_supported_) ||
+      (color_primaries != layer_buffer->color_metadata.colorPrimaries) ||
+      (transfer != layer_buffer->color_metadata.transfer)) {
+    dirty_mask_ |= kLayerDirtyColor;
+  }
+
   // TZ Protected Buffer - L1
   secure_ = (handle->flags & private_handle_t::PRIV_FLAGS_SECURE_BUFFER);
   bool secure_camera = secure_ && (handle->flags & private_handle_t::PRIV_FLAGS_CAMERA_WRITE);
@@ -291,6 +367,9 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, shared_ptr<Fence> a
   layer_buffer->planes[0].stride = UINT32(handle->width);
   layer_buffer->size = handle->size;
   buffer_flipped_ = reinterpret_cast<uint64_t>(handle) != layer_buffer->buffer_id;
+  if (buffer_flipped_) {
+    cadence_.OnBufferLatched(systemTime(SYSTEM_TIME_MONOTONIC));
+  }
   layer_buffer->buffer_id = reinterpret_cast<uint64_t>(handle);
   layer_buffer->handle_id = handle->id;
 
@@ -298,6 +377,7 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, shared_ptr<Fence> a
 }
 
 HWC2::Error HWCLayer::SetLayerSurfaceDamage(hwc_region_t damage) {
+  dirty_mask_ |= kLayerDirtyBuffer;
   surface_updated_ = true;
   if ((damage.numRects == 1) && (damage.rects[0].bottom == 0) && (damage.rects[0].right == 0)) {
     surface_updated_ = false;
@@ -348,6 +428,7 @@ HWC2::Error HWCLayer::SetLayerBlendMode(HWC2::BlendMode mode) {
 
   if (layer_->blending != blending) {
     geometry_changes_ |= kBlendMode;
+    dirty_mask_ |= kLayerDirtyGeometry;
     layer_->blending = blending;
   }
   return HWC2::Error::None;
@@ -358,6 +439,7 @@ HWC2::Error HWCLayer::SetLayerColor(hwc_color_t color) {
     return HWC2::Error::None;
   }
   if (layer_->solid_fill_color != GetUint32Color(color)) {
+    dirty_mask_ |= kLayerDirtyColor;
     layer_->solid_fill_color = GetUint32Color(color);
     layer_->update_mask.set(kSurfaceInvalidate);
     surface_updated_ = true;
@@ -375,6 +457,7 @@ HWC2::Error HWCLayer::SetLayerCompositionType(HWC2::Composition type) {
   // Validation is required when the client changes the composition type
   if (client_requested_ != type) {
     layer_->update_mask.set(kClientCompRequest);
+    dirty_mask_ |= kLayerDirtyGeometry;
   }
   client_requested_ = type;
   switch (type) {
@@ -387,6 +470,9 @@ HWC2::Error HWCLayer::SetLayerCompositionType(HWC2::Composition type) {
       break;
     case HWC2::Composition::Cursor:
       break;
+    case HWC2::Composition::Sideband:
+      // Composed like a device layer, with the buffers of its stream.
+      break;
     case HWC2::Composition::Invalid:
       return HWC2::Error::BadParameter;
     default:
@@ -403,9 +489,13 @@ HWC2::Error HWCLayer::SetLayerDataspace(int32_t dataspace) {
   // cache the dataspace, to be used later to update SDM ColorMetaData
   if (dataspace_ != dataspace) {
     geometry_changes_ |= kDataspace;
+    dirty_mask_ |= kLayerDirtyColor;
     dataspace_ = dataspace;
     if (layer_->input_buffer.buffer_id) {
-      ValidateAndSetCSC(reinterpret_cast<private_handle_t *>(layer_->input_buffer.buffer_id));
+      gralloc::MetaDataSnapshot snapshot;
+      gralloc::GetMetaDataSnapshot(
+          reinterpret_cast<private_handle_t *>(layer_->input_buffer.buffer_id), &snapshot);
+      ValidateAndSetCSC(snapshot);
     }
   }
   return HWC2::Error::None;
@@ -417,6 +507,7 @@ HWC2::Error HWCLayer::SetLayerDisplayFrame(hwc_rect_t frame) {
   SetRect(frame, &dst_rect);
   if (dst_rect_ != dst_rect) {
     geometry_changes_ |= kDisplayFrame;
+    dirty_mask_ |= kLayerDirtyGeometry;
     dst_rect_ = dst_rect;
   }
 
@@ -449,6 +540,7 @@ HWC2::Error HWCLayer::SetLayerPlaneAlpha(float alpha) {
 
   if (layer_->plane_alpha != plane_alpha) {
     geometry_changes_ |= kPlaneAlpha;
+    dirty_mask_ |= kLayerDirtyGeometry;
     layer_->plane_alpha = plane_alpha;
   }
 
@@ -467,6 +559,7 @@ HWC2::Error HWCLayer::SetLayerSourceCrop(hwc_frect_t crop) {
   }
   if (layer_->src_rect != src_rect) {
     geometry_changes_ |= kSourceCrop;
+    dirty_mask_ |= kLayerDirtyGeometry;
     layer_->src_rect = src_rect;
   }
 
@@ -511,6 +604,7 @@ HWC2::Error HWCLayer::SetLayerTransform(HWC2::Transform transform) {
 
   if (layer_transform_ != layer_transform) {
     geometry_changes_ |= kTransform;
+    dirty_mask_ |= kLayerDirtyGeometry;
     layer_transform_ = layer_transform;
   }
 
@@ -538,6 +632,7 @@ HWC2::Error HWCLayer::SetLayerZOrder(uint32_t z) {
 #endif
 
     geometry_changes_ |= kZOrder;
+    dirty_mask_ |= kLayerDirtyGeometry;
     z_ = z;
   }
 
@@ -564,6 +659,9 @@ HWC2::Error HWCLayer::SetLayerType(IQtiComposerClient::LayerType type) {
       break;
   }
 
+  if (type_ != layer_type) {
+    dirty_mask_ |= kLayerDirtyGeometry;
+  }
   type_ = layer_type;
   return HWC2::Error::None;
 }
@@ -572,6 +670,7 @@ HWC2::Error HWCLayer::SetLayerColorTransform(const float *matrix) {
   if (std::memcmp(matrix, layer_->color_transform_matrix, sizeof(layer_->color_transform_matrix))) {
     std::memcpy(layer_->color_transform_matrix, matrix, sizeof(layer_->color_transform_matrix));
     layer_->update_mask.set(kColorTransformUpdate);
+    dirty_mask_ |= kLayerDirtyColor;
     color_transform_matrix_set_ = true;
     if (!std::memcmp(matrix, kIdentityMatrix, sizeof(kIdentityMatrix))) {
       color_transform_matrix_set_ = false;
@@ -635,6 +734,7 @@ HWC2::Error HWCLayer::SetLayerPerFrameMetadata(uint32_t num_elements,
       (!SameConfig(&old_content_light, &content_light, UINT32(sizeof(ContentLightLevel))))) {
     layer_->update_mask.set(kMetadataUpdate);
     geometry_changes_ |= kDataspace;
+    dirty_mask_ |= kLayerDirtyMetadata;
   }
   return HWC2::Error::None;
 }
@@ -660,6 +760,7 @@ HWC2::Error HWCLayer::SetLayerPerFrameMetadataBlobs(uint32_t num_elements,
         if (!SameConfig(static_cast<const uint8_t*>(color_metadata.dynamicMetaDataPayload),
                         metadata, sizes[i])) {
           geometry_changes_ |= kDataspace;
+          dirty_mask_ |= kLayerDirtyMetadata;
           color_metadata.dynamicMetaDataValid = true;
           color_metadata.dynamicMetaDataLen = sizes[i];
           std::memcpy(color_metadata.dynamicMetaDataPayload, metadata, sizes[i]);
@@ -869,25 +970,26 @@ DisplayError HWCLayer::SetMetaData(const private_handle_t *pvt_handle, Layer *la
   LayerBuffer *layer_buffer = &layer->input_buffer;
   private_handle_t *handle = const_cast<private_handle_t *>(pvt_handle);
 
-  float fps = 0;
+  // One validated read of all the fields below, in place of a getMetaData call per field.
+  gralloc::MetaDataSnapshot snapshot;
+  gralloc::GetMetaDataSnapshot(handle, &snapshot);
+
+  float fps = snapshot.refresh_rate;
   uint32_t frame_rate = layer->frame_rate;
-  if (getMetaData(handle, GET_REFRESH_RATE, &fps) == 0) {
+  if (snapshot.has_refresh_rate) {
     frame_rate = (fps != 0) ? RoundToStandardFPS(fps) : layer->frame_rate;
     has_metadata_refresh_rate_ = true;
   }
 
-  int32_t interlaced = 0;
-  getMetaData(handle, GET_PP_PARAM_INTERLACED, &interlaced);
-  bool interlace = interlaced ? true : false;
+  bool interlace = snapshot.interlaced ? true : false;
 
   if (interlace != layer_buffer->flags.interlace) {
     DLOGI("Layer buffer interlaced metadata has changed. old=%d, new=%d",
           layer_buffer->flags.interlace, interlace);
   }
 
-  uint32_t linear_format = 0;
-  if (getMetaData(handle, GET_LINEAR_FORMAT, &linear_format) == 0) {
-    layer_buffer->format = GetSDMFormat(INT32(linear_format), 0);
+  if (snapshot.has_linear_format) {
+    layer_buffer->format = GetSDMFormat(INT32(snapshot.linear_format), 0);
   }
 
   if ((interlace != layer_buffer->flags.interlace) || (frame_rate != layer->frame_rate)) {
@@ -897,31 +999,28 @@ DisplayError HWCLayer::SetMetaData(const private_handle_t *pvt_handle, Layer *la
     layer_->update_mask.set(kMetadataUpdate);
   }
 
-  // Check if metadata is set
-  struct UBWCStats cr_stats[NUM_UBWC_CR_STATS_LAYERS] = {};
-
   for (int i = 0; i < NUM_UBWC_CR_STATS_LAYERS; i++) {
     layer_buffer->ubwc_crstats[i].clear();
   }
 
-  if (getMetaData(handle, GET_UBWC_CR_STATS_INFO, cr_stats) == 0) {
+  // Check if metadata is set
+  if (snapshot.has_ubwc_cr_stats) {
   // Only copy top layer for now as only top field for interlaced is used
-    GetUBWCStatsFromMetaData(&cr_stats[0], &(layer_buffer->ubwc_crstats[0]));
-  }  // if (getMetaData)
+    GetUBWCStatsFromMetaData(&snapshot.ubwc_cr_stats[0], &(layer_buffer->ubwc_crstats[0]));
+  }
 
-  uint32_t single_buffer = 0;
-  getMetaData(const_cast<private_handle_t *>(handle), GET_SINGLE_BUFFER_MODE, &single_buffer);
-  single_buffer_ = (single_buffer == 1);
+  single_buffer_ = (snapshot.single_buffer_mode == 1);
 
   // Handle colorMetaData / Dataspace handling now
-  ValidateAndSetCSC(handle);
+  ValidateAndSetCSC(snapshot);
 
   return kErrorNone;
 }
 
 bool HWCLayer::IsDataSpaceSupported() {
   if (client_requested_ != HWC2::Composition::Device &&
-      client_requested_ != HWC2::Composition::Cursor) {
+      client_requested_ != HWC2::Composition::Cursor &&
+      client_requested_ != HWC2::Composition::Sideband) {
     // Layers marked for GPU can have any dataspace
     return true;
   }
@@ -929,7 +1028,7 @@ bool HWCLayer::IsDataSpaceSupported() {
   return dataspace_supported_;
 }
 
-void HWCLayer::ValidateAndSetCSC(const private_handle_t *handle) {
+void HWCLayer::ValidateAndSetCSC(const gralloc::MetaDataSnapshot &snapshot) {
   LayerBuffer *layer_buffer = &layer_->input_buffer;
   bool use_color_metadata = true;
   ColorMetaData csc = {};
@@ -961,7 +1060,7 @@ void HWCLayer::ValidateAndSetCSC(const private_handle_t *handle) {
 
   if (use_color_metadata) {
     ColorMetaData new_metadata = layer_buffer->color_metadata;
-    if (sdm::SetCSC(handle, &new_metadata) == kErrorNone) {
+    if (sdm::SetCSC(snapshot, &new_metadata) == kErrorNone) {
       // If dataspace is KNOWN, overwrite the gralloc metadata CSC using the previously derived CSC
       // from dataspace.
       if (dataspace_ != HAL_DATASPACE_UNKNOWN) {
@@ -1055,8 +1154,14 @@ void HWCLayer::SetComposition(const LayerComposition &sdm_composition) {
       hwc_composition = HWC2::Composition::Device;
       break;
   }
+  // Sideband layers composed by the device stay sideband.
+  if (hwc_composition == HWC2::Composition::Device &&
+      client_requested_ == HWC2::Composition::Sideband) {
+    hwc_composition = HWC2::Composition::Sideband;
+  }
   // Update solid fill composition
-  if (sdm_composition == kCompositionSDE && layer_->flags.solid_fill != 0) {
+  if (sdm_composition == kCompositionSDE && layer_->flags.solid_fill != 0 &&
+      !solid_fill_promoted_) {
     hwc_composition = HWC2::Composition::SolidColor;
   }
   device_selected_ = hwc_composition;
@@ -1086,12 +1191,66 @@ void HWCLayer::PopFrontReleaseFence(shared_ptr<Fence> *fence) {
   release_fences_.pop_front();
 }
 
+void HWCLayer::SetSidebandStream(const shared_ptr<HWCSidebandQueue> &queue) {
+  if (queue == sideband_queue_) {
+    return;
+  }
+
+  if (sideband_queue_) {
+    // The frame shown goes away with the stream it came from.
+    LayerBuffer *layer_buffer = &layer_->input_buffer;
+    if (buffer_fd_ >= 0) {
+      ::close(buffer_fd_);
+      buffer_fd_ = -1;
+    }
+    layer_buffer->planes[0].fd = -1;
+    layer_buffer->acquire_fence = nullptr;
+    layer_buffer->buffer_id = 0;
+    layer_buffer->handle_id = 0;
+    geometry_changes_ |= kBufferGeometry;
+    dirty_mask_ |= kLayerDirtyGeometry;
+  }
+  sideband_queue_ = queue;
+}
+
+bool HWCLayer::LatchSidebandFrame(int64_t vsync_ns, int64_t vsync_period_ns) {
+  buffer_handle_t buffer = nullptr;
+  shared_ptr<Fence> acquire_fence = nullptr;
+  if (!sideband_queue_ ||
+      !sideband_queue_->Latch(vsync_ns, vsync_period_ns, &buffer, &acquire_fence)) {
+    return false;
+  }
+
+  if (SetLayerBuffer(buffer, acquire_fence) != HWC2::Error::None) {
+    DLOGW("Invalid frame on sideband stream %d of layer %" PRIu64,
+          sideband_queue_->GetStreamId(), id_);
+    return false;
+  }
+
+  return true;
+}
+
+void HWCLayer::OnSidebandCommitted(const shared_ptr<Fence> &release_fence) {
+  if (sideband_queue_) {
+    sideband_queue_->OnCommitted(release_fence);
+  }
+}
+
 bool HWCLayer::IsRotationPresent() {
   return ((layer_->transform.rotation != 0.0f) ||
          layer_->transform.flip_horizontal ||
          layer_->transform.flip_vertical);
 }
 
+// Buffer and damage updates alone leave the composition decided by the last validate intact.
+bool HWCLayer::HasContentOnlyUpdate() {
+  std::bitset<kLayerUpdateMax> content_updates;
+  content_updates.set(kSurfaceDamage);
+  content_updates.set(kSurfaceInvalidate);
+
+  return (!geometry_changes_ && (layer_->update_mask & ~content_updates).none());
+}
+
 bool HWCLayer::IsScalingPresent() {
   uint32_t src_width  = static_cast<uint32_t>(layer_->src_rect.right - layer_->src_rect.left);
   uint32_t src_height = static_cast<uint32_t>(layer_->src_rect.bottom - layer_->src_rect.top);
@@ -1101,6 +1260,168 @@ bool HWCLayer::IsScalingPresent() {
   return ((src_width != dst_width) || (dst_height != src_height));
 }
 
+// Maps small linear RGB buffers for the CPU checks below. Buffers still being rendered are not
+// waited for, they are not mapped at all.
+const uint32_t *HWCLayer::MapPixels(uint32_t max_pixels, bool *mapped) {
+  const LayerBuffer &layer_buffer = layer_->input_buffer;
+  const private_handle_t *handle =
+      reinterpret_cast<const private_handle_t *>(layer_buffer.buffer_id);
+  *mapped = false;
+
+  switch (layer_buffer.format) {
+    case kFormatARGB8888:
+    case kFormatRGBA8888:
+    case kFormatBGRA8888:
+    case kFormatXRGB8888:
+    case kFormatRGBX8888:
+    case kFormatBGRX8888:
+      break;
+    default:
+      return nullptr;
+  }
+
+  uint32_t width = layer_buffer.unaligned_width;
+  uint32_t height = layer_buffer.unaligned_height;
+  if (!handle || secure_ || !width || !height || (width * height > max_pixels) ||
+      (Fence::GetStatus(layer_buffer.acquire_fence) != Fence::Status::kSignaled)) {
+    return nullptr;
+  }
+
+  if (!handle->base) {
+    if (buffer_allocator_->MapBuffer(handle, nullptr) != kErrorNone || !handle->base) {
+      return nullptr;
+    }
+    *mapped = true;
+  }
+
+  return reinterpret_cast<const uint32_t *>(handle->base);
+}
+
+void HWCLayer::UnmapPixels(bool mapped) {
+  if (mapped) {
+    int release_fence = -1;
+    buffer_allocator_->UnmapBuffer(
+        reinterpret_cast<const private_handle_t *>(layer_->input_buffer.buffer_id),
+        &release_fence);
+  }
+}
+
+// Hashes the whole visible content of small linear RGB buffers and compares it with the hash of
+// the previous frame. Buffers that cannot be read yet count as changed.
+bool HWCLayer::IsContentUnchanged(uint32_t max_pixels) {
+  const LayerBuffer &layer_buffer = layer_->input_buffer;
+  bool prev_valid = content_signature_valid_;
+  content_signature_valid_ = false;
+
+  bool mapped = false;
+  const uint32_t *row = MapPixels(max_pixels, &mapped);
+  if (!row) {
+    return false;
+  }
+
+  // 64 bit FNV-1a over the visible pixels, row by row to skip the stride padding.
+  uint64_t signature = 0xcbf29ce484222325ULL;
+  uint32_t width = layer_buffer.unaligned_width;
+  uint32_t height = layer_buffer.unaligned_height;
+  for (uint32_t y = 0; y < height; y++, row += layer_buffer.planes[0].stride) {
+    for (uint32_t x = 0; x < width; x++) {
+      signature = (signature ^ row[x]) * 0x100000001b3ULL;
+    }
+  }
+  UnmapPixels(mapped);
+
+  bool unchanged = prev_valid && (signature == content_signature_);
+  content_signature_ = signature;
+  content_signature_valid_ = true;
+
+  return unchanged;
+}
+
+// Finds buffers that hold a single color, the way apps draw scrims and letterbox bars. The
+// corners and center are sampled first, so that most buffers are rejected without a full scan.
+bool HWCLayer::GetUniformColor(uint32_t max_pixels, uint32_t *color) {
+  const LayerBuffer &layer_buffer = layer_->input_buffer;
+  bool mapped = false;
+  const uint32_t *pixels = MapPixels(max_pixels, &mapped);
+  if (!pixels) {
+    return false;
+  }
+
+  uint32_t width = layer_buffer.unaligned_width;
+  uint32_t height = layer_buffer.unaligned_height;
+  uint32_t stride = layer_buffer.planes[0].stride;
+  uint32_t pixel = pixels[0];
+  bool uniform = (pixels[width - 1] == pixel) &&
+                 (pixels[(height - 1) * stride] == pixel) &&
+                 (pixels[(height - 1) * stride + width - 1] == pixel) &&
+                 (pixels[(height / 2) * stride + width / 2] == pixel);
+  const uint32_t *row = pixels;
+  for (uint32_t y = 0; uniform && y < height; y++, row += stride) {
+    for (uint32_t x = 0; x < width; x++) {
+      if (row[x] != pixel) {
+        uniform = false;
+        break;
+      }
+    }
+  }
+  UnmapPixels(mapped);
+
+  if (!uniform) {
+    return false;
+  }
+
+  // Little endian words of the byte ordered formats, turned into the ARGB of solid_fill_color.
+  uint32_t alpha = pixel & 0xff000000;
+  switch (layer_buffer.format) {
+    case kFormatRGBA8888:
+      *color = alpha | ((pixel & 0xff) << 16) | (pixel & 0xff00) | ((pixel >> 16) & 0xff);
+      break;
+    case kFormatRGBX8888:
+      *color = 0xff000000 | ((pixel & 0xff) << 16) | (pixel & 0xff00) | ((pixel >> 16) & 0xff);
+      break;
+    case kFormatBGRA8888:
+      *color = pixel;
+      break;
+    case kFormatBGRX8888:
+      *color = 0xff000000 | pixel;
+      break;
+    default:
+      return false;
+  }
+
+  return true;
+}
+
+// Shows a device composed layer whose buffer holds a single color as a solid fill, which frees
+// its pipe and the fetch of the buffer. The uniform check runs once per buffer.
+bool HWCLayer::PromoteUniformColor(uint32_t max_pixels) {
+  if (dirty_mask_ & (kLayerDirtyBuffer | kLayerDirtyGeometry)) {
+    uniform_color_valid_ = GetUniformColor(max_pixels, &uniform_color_);
+  }
+
+  // Solid fill bypasses the pipe color processing, so keep to sRGB content shown unscaled.
+  const ColorMetaData &color_metadata = layer_->input_buffer.color_metadata;
+  bool was_promoted = solid_fill_promoted_;
+  uint32_t prev_color = layer_->solid_fill_color;
+  solid_fill_promoted_ = uniform_color_valid_ && (client_requested_ == HWC2::Composition::Device) &&
+                         !layer_->flags.skip && !layer_->flags.color_transform &&
+                         (color_metadata.colorPrimaries == ColorPrimaries_BT709_5) &&
+                         (color_metadata.transfer == Transfer_sRGB) && !IsScalingPresent();
+  if (solid_fill_promoted_) {
+    layer_->flags.solid_fill = true;
+    layer_->solid_fill_color = uniform_color_;
+  }
+
+  // Moving between a pipe and a solid fill, or a new color, needs a full strategy run.
+  if ((was_promoted != solid_fill_promoted_) ||
+      (solid_fill_promoted_ && (prev_color != uniform_color_))) {
+    geometry_changes_ |= kBufferGeometry;
+    layer_->update_mask.set(kSurfaceInvalidate);
+  }
+
+  return solid_fill_promoted_;
+}
+
 void HWCLayer::SetDirtyRegions(hwc_region_t surface_damage) {
   layer_->dirty_regions.clear();
   for (uint32_t i = 0; i < surface_damage.numRects; i++) {
@@ -1112,6 +1433,7 @@ void HWCLayer::SetDirtyRegions(hwc_region_t surface_damage) {
 
 void HWCLayer::SetLayerAsMask() {
   layer_->input_buffer.flags.mask_layer = true;
+  dirty_mask_ |= kLayerDirtyMetadata;
   DLOGV_IF(kTagClient, " Layer Id: ""[%" PRIu64 "]", id_);
 }
 
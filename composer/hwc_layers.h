@@ -38,18 +38,27 @@
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "core/buffer_allocator.h"
 #include "hwc_buffer_allocator.h"
+#include "hwc_sideband_queue.h"
 
 using PerFrameMetadataKey =
     android::hardware::graphics::composer::V2_3::IComposerClient::PerFrameMetadataKey;
 using vendor::qti::hardware::display::composer::V3_0::IQtiComposerClient;
 
+namespace gralloc {
+struct MetaDataSnapshot;
+}
+
 namespace sdm {
 
 DisplayError SetCSC(const private_handle_t *pvt_handle, ColorMetaData *color_metadata);
+DisplayError SetCSC(const gralloc::MetaDataSnapshot &snapshot, ColorMetaData *color_metadata);
 bool GetColorPrimary(const int32_t &dataspace, ColorPrimaries *color_primary);
 bool GetTransfer(const int32_t &dataspace, GammaTransfer *gamma_transfer);
 bool GetRange(const int32_t &dataspace, ColorRange *color_range);
@@ -71,6 +80,40 @@ enum GeometryChanges {
   kBufferGeometry = 0x200,
 };
 
+// Categories of client updates on a layer since it was last added to a layer stack.
+enum LayerDirty {
+  kLayerDirtyNone     = 0x0,
+  kLayerDirtyGeometry = 0x1,  // Display frame, crop, transform, z, blending, composition type
+  kLayerDirtyBuffer   = 0x2,  // Buffer handle, acquire fence or surface damage
+  kLayerDirtyColor    = 0x4,  // Dataspace, solid color or color transform
+  kLayerDirtyMetadata = 0x8,  // Buffer metadata, buffer flags or per frame HDR metadata
+  kLayerDirtyAll      = 0xF,
+};
+
+// Buffer cadence of a layer, estimated from the times its buffers were latched.
+class LayerCadence {
+ public:
+  enum State {
+    kIdle,       // No recent buffer updates.
+    kIrregular,  // Updating without a steady rate, e.g. touch driven animations.
+    kSteady,     // Updating at a steady rate, e.g. video playback.
+  };
+
+  void OnBufferLatched(int64_t time_ns);
+  // Tolerates one vsync of jitter in intervals, as buffers are latched on vsync boundaries.
+  State GetState(int64_t now_ns, int64_t vsync_period_ns, uint32_t *fps) const;
+
+ private:
+  static constexpr uint32_t kNumIntervals = 8;
+  // Intervals longer than this restart the estimate, a layer not updated for as long is idle.
+  static constexpr int64_t kMaxIntervalNs = 200000000;
+
+  int64_t last_latch_ns_ = 0;
+  int64_t intervals_ns_[kNumIntervals] = {};
+  uint32_t num_intervals_ = 0;
+  uint32_t next_interval_ = 0;
+};
+
 enum LayerTypes {
   kLayerUnknown = 0,
   kLayerApp = 1,
@@ -114,11 +157,16 @@ class HWCLayer {
   int32_t GetLayerDataspace() { return dataspace_; }
   uint32_t GetGeometryChanges() { return geometry_changes_; }
   void ResetGeometryChanges() { geometry_changes_ = GeometryChanges::kNone; }
+  uint32_t GetDirtyMask() { return dirty_mask_; }
+  void ResetDirtyMask() { dirty_mask_ = kLayerDirtyNone; }
+  const LayerFlags &GetCachedFlags() { return cached_flags_; }
+  void SetCachedFlags(const LayerFlags &flags) { cached_flags_ = flags; }
   void PushBackReleaseFence(const shared_ptr<Fence> &fence);
   void PopBackReleaseFence(shared_ptr<Fence> *fence);
   void PopFrontReleaseFence(shared_ptr<Fence> *fence);
   void ResetValidation() { layer_->update_mask.reset(); }
   bool NeedsValidation() { return (geometry_changes_ || layer_->update_mask.any()); }
+  bool HasContentOnlyUpdate();
   bool IsSingleBuffered() { return single_buffer_; }
   bool IsScalingPresent();
   bool IsRotationPresent();
@@ -133,11 +181,21 @@ class HWCLayer {
   void SetLayerAsMask();
   bool BufferLatched() { return buffer_flipped_; }
   void ResetBufferFlip() { buffer_flipped_ = false; }
+  bool IsContentUnchanged(uint32_t max_pixels);
+  bool PromoteUniformColor(uint32_t max_pixels);
+  bool IsSolidFillPromoted() { return solid_fill_promoted_; }
+  const LayerCadence &GetCadence() { return cadence_; }
+  void SetSidebandStream(const shared_ptr<HWCSidebandQueue> &queue);
+  bool HasSidebandStream() { return sideband_queue_ != nullptr; }
+  // Sets the frame of the stream due at the vsync after vsync_ns as the layer buffer.
+  bool LatchSidebandFrame(int64_t vsync_ns, int64_t vsync_period_ns);
+  void OnSidebandCommitted(const shared_ptr<Fence> &release_fence);
 #ifdef FOD_ZPOS
   bool IsFodPressed() { return fod_pressed_; }
 #endif
 
  private:
+  Layer sdm_layer_ = {};  // Embedded, so that a layer costs a single allocation
   Layer *layer_ = nullptr;
   LayerTypes type_ = kLayerUnknown;
   uint32_t z_ = 0;
@@ -158,7 +216,14 @@ class HWCLayer {
   bool has_metadata_refresh_rate_ = false;
   bool color_transform_matrix_set_ = false;
   bool buffer_flipped_ = false;
+  bool content_signature_valid_ = false;
+  uint64_t content_signature_ = 0;
+  bool uniform_color_valid_ = false;  // The current buffer holds uniform_color_ throughout.
+  uint32_t uniform_color_ = 0;
+  bool solid_fill_promoted_ = false;
+  LayerCadence cadence_ = {};
   bool secure_ = false;
+  shared_ptr<HWCSidebandQueue> sideband_queue_ = nullptr;  // Source of the buffers, when set.
 #ifdef FOD_ZPOS
   bool fod_pressed_ = false;
 #endif
@@ -168,6 +233,11 @@ class HWCLayer {
   // Composition selected by SDM
   HWC2::Composition device_selected_ = HWC2::Composition::Device;
   uint32_t geometry_changes_ = GeometryChanges::kNone;
+  uint32_t dirty_mask_ = kLayerDirtyAll;
+  // Layer flags derived from geometry, color and metadata when the layer was last populated.
+  LayerFlags cached_flags_ = {};
+  int buffer_flags_ = 0;
+  int buffer_type_ = 0;
 
   void SetRect(const hwc_rect_t &source, LayerRect *target);
   void SetRect(const hwc_frect_t &source, LayerRect *target);
@@ -175,8 +245,11 @@ class HWCLayer {
   void GetUBWCStatsFromMetaData(UBWCStats *cr_stats, UbwcCrStatsVector *cr_vec);
   DisplayError SetMetaData(const private_handle_t *pvt_handle, Layer *layer);
   uint32_t RoundToStandardFPS(float fps);
-  void ValidateAndSetCSC(const private_handle_t *handle);
+  void ValidateAndSetCSC(const gralloc::MetaDataSnapshot &snapshot);
   void SetDirtyRegions(hwc_region_t surface_damage);
+  const uint32_t *MapPixels(uint32_t max_pixels, bool *mapped);
+  void UnmapPixels(bool mapped);
+  bool GetUniformColor(uint32_t max_pixels, uint32_t *color);
 };
 
 struct SortLayersByZ {
@@ -185,5 +258,11 @@ struct SortLayersByZ {
   }
 };
 
+// Layers of a display in a flat array sorted by Z, and stably ordered among equal Z.
+using HWCLayerList = std::vector<HWCLayer *>;
+// Layers of a display in a flat array sorted by id. Ids are handed out in increasing order, so
+// new layers are appended.
+using HWCLayerMap = std::vector<std::pair<hwc2_layer_t, HWCLayer *>>;
+
 }  // namespace sdm
 #endif  // __HWC_LAYERS_H__
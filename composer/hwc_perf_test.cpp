@@ -0,0 +1,420 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cutils/properties.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/frame_timing.h>
+#include <utils/thread_policy.h>
+
+#include <algorithm>
+#include <string>
+
+#include "hwc_alloc_counter.h"
+#include "hwc_debugger.h"
+#include "hwc_display_builtin.h"
+#include "hwc_perf_test.h"
+
+#define __CLASS__ "HWCPerfTest"
+
+namespace sdm {
+
+static uint64_t ThreadCpuNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return UINT64(ts.tv_sec) * 1000000000ULL + UINT64(ts.tv_nsec);
+}
+
+static HWC2::Transform GetTransform(const LayerTransform &transform) {
+  uint32_t hwc_transform = 0;
+  if (transform.flip_horizontal) {
+    hwc_transform |= HAL_TRANSFORM_FLIP_H;
+  }
+  if (transform.flip_vertical) {
+    hwc_transform |= HAL_TRANSFORM_FLIP_V;
+  }
+  if (transform.rotation == 90.0f) {
+    hwc_transform |= HAL_TRANSFORM_ROT_90;
+  }
+
+  return static_cast<HWC2::Transform>(hwc_transform);
+}
+
+static HWC2::BlendMode GetBlendMode(LayerBlending blending) {
+  switch (blending) {
+    case kBlendingCoverage:
+      return HWC2::BlendMode::Coverage;
+    case kBlendingOpaque:
+      return HWC2::BlendMode::None;
+    default:
+      return HWC2::BlendMode::Premultiplied;
+  }
+}
+
+static void SetRect(const LayerRect &rect, hwc_rect_t *hwc_rect) {
+  hwc_rect->left = INT(rect.left);
+  hwc_rect->top = INT(rect.top);
+  hwc_rect->right = INT(rect.right);
+  hwc_rect->bottom = INT(rect.bottom);
+}
+
+int HWCPerfTest::Init(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
+                      qService::QService *qservice) {
+  char fps_list[PROPERTY_VALUE_MAX] = {};
+  if (HWCDebugHandler::Get()->GetProperty(PERF_TEST_FPS_PROP, fps_list) != kErrorNone ||
+      !strlen(fps_list)) {
+    return 0;
+  }
+
+  core_intf_ = core_intf;
+  buffer_allocator_ = buffer_allocator;
+  qservice_ = qservice;
+  exit_ = false;
+
+  char *save_ptr = nullptr;
+  for (char *token = strtok_r(fps_list, ",", &save_ptr); token && displays_.size() < kMaxDisplays;
+       token = strtok_r(nullptr, ",", &save_ptr)) {
+    int fps = atoi(token);
+    if (fps <= 0) {
+      DLOGW("Ignoring refresh rate %s", token);
+      continue;
+    }
+    if (CreateDisplay(UINT32(displays_.size()), UINT32(fps))) {
+      break;
+    }
+  }
+
+  if (displays_.empty()) {
+    return -EINVAL;
+  }
+
+  for (auto &test : displays_) {
+    test->thread = std::thread(&HWCPerfTest::Run, this, test.get());
+  }
+  DLOGI("Driving %zu synthetic displays with %zu layer stacks", displays_.size(), script_.size());
+
+  return 0;
+}
+
+void HWCPerfTest::Deinit() {
+  exit_ = true;
+  for (auto &test : displays_) {
+    if (test->thread.joinable()) {
+      test->thread.join();
+    }
+    DestroyDisplay(test.get());
+  }
+  displays_.clear();
+  script_.clear();
+}
+
+int HWCPerfTest::CreateDisplay(uint32_t index, uint32_t fps) {
+  // Dummy display ids, out of the range the client uses for real displays.
+  hwc2_display_t id = HWCCallbacks::kNumRealDisplays + index;
+  std::unique_ptr<TestDisplay> test(new TestDisplay());
+  test->fps = fps;
+  int status = HWCDisplayBuiltIn::Create(core_intf_, buffer_allocator_, &callbacks_, this,
+                                         qservice_, id, INT32(id), &test->display);
+  if (status) {
+    DLOGE("Failed to create synthetic display %d, error %d", UINT32(id), status);
+    return status;
+  }
+  test->display->SetPowerMode(HWC2::PowerMode::On, false /* teardown */);
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  test->display->GetFrameBufferResolution(&width, &height);
+  if (script_.empty()) {
+    LoadScript();
+  }
+  if (script_.empty()) {
+    CreateDefaultScript(width, height);
+  }
+
+  for (auto &client_target : test->client_targets) {
+    client_target.buffer_config.width = width;
+    client_target.buffer_config.height = height;
+    client_target.buffer_config.format = kFormatRGBA8888;
+    client_target.buffer_config.buffer_count = 1;
+    if (buffer_allocator_->AllocateBuffer(&client_target) != kErrorNone) {
+      DLOGE("Failed to allocate a %dx%d client target", width, height);
+      DestroyDisplay(test.get());
+      return -ENOMEM;
+    }
+  }
+
+  displays_.push_back(std::move(test));
+
+  return 0;
+}
+
+void HWCPerfTest::DestroyDisplay(TestDisplay *test) {
+  if (test->display) {
+    HWCDisplayBuiltIn::Destroy(test->display);
+    test->display = nullptr;
+  }
+  for (auto &buffer : test->buffers) {
+    buffer_allocator_->FreeBuffer(&buffer.second);
+  }
+  test->buffers.clear();
+  for (auto &client_target : test->client_targets) {
+    if (client_target.private_data) {
+      buffer_allocator_->FreeBuffer(&client_target);
+    }
+  }
+}
+
+void HWCPerfTest::LoadScript() {
+  char record_path[PROPERTY_VALUE_MAX] = {};
+  if (HWCDebugHandler::Get()->GetProperty(PERF_TEST_RECORD_PROP, record_path) != kErrorNone ||
+      !strlen(record_path)) {
+    return;
+  }
+
+  FILE *file = fopen(record_path, "r");
+  if (!file) {
+    DLOGW("Failed to open %s errno = %d, desc = %s", record_path, errno, strerror(errno));
+    return;
+  }
+
+  while (true) {
+    std::unique_ptr<RecordedLayerStack> recorded(new RecordedLayerStack());
+    if (!LayerStackRecorder::Read(file, recorded.get())) {
+      break;
+    }
+    script_.push_back(std::move(recorded));
+  }
+  fclose(file);
+}
+
+void HWCPerfTest::CreateDefaultScript(uint32_t width, uint32_t height) {
+  // Static wallpaper, an app flipping its buffer every frame and a static status bar.
+  LayerRect full_frame = {0.0f, 0.0f, FLOAT(width), FLOAT(height)};
+  LayerRect status_bar = {0.0f, 0.0f, FLOAT(width), FLOAT(height / 20)};
+  for (uint64_t app_buffer_id : {2, 3}) {
+    std::unique_ptr<RecordedLayerStack> recorded(new RecordedLayerStack());
+    for (auto &rect_id : {std::make_pair(full_frame, UINT64(1)),
+                          std::make_pair(full_frame, app_buffer_id),
+                          std::make_pair(status_bar, UINT64(4))}) {
+      Layer layer;
+      layer.input_buffer.width = UINT32(rect_id.first.right);
+      layer.input_buffer.height = UINT32(rect_id.first.bottom);
+      layer.input_buffer.format = kFormatRGBA8888;
+      layer.input_buffer.buffer_id = rect_id.second;
+      layer.src_rect = layer.dst_rect = rect_id.first;
+      layer.blending = recorded->layers.empty() ? kBlendingOpaque : kBlendingPremultiplied;
+      layer.composition = kCompositionGPU;
+      layer.dirty_regions.push_back((rect_id.second == app_buffer_id) ? rect_id.first :
+                                    LayerRect());
+      recorded->layers.push_back(layer);
+    }
+    script_.push_back(std::move(recorded));
+  }
+}
+
+buffer_handle_t HWCPerfTest::GetBuffer(TestDisplay *test, const Layer &layer) {
+  uint64_t buffer_id = layer.input_buffer.buffer_id;
+  auto iter = test->buffers.find(buffer_id);
+  if (iter != test->buffers.end()) {
+    return reinterpret_cast<buffer_handle_t>(iter->second.private_data);
+  }
+
+  if (test->buffers.size() >= kMaxBuffers) {
+    return reinterpret_cast<buffer_handle_t>(test->buffers.begin()->second.private_data);
+  }
+
+  // Same size and format as recorded, content does not matter to the composer.
+  BufferInfo buffer_info = {};
+  buffer_info.buffer_config.width = std::max(layer.input_buffer.unaligned_width,
+                                             layer.input_buffer.width);
+  buffer_info.buffer_config.height = std::max(layer.input_buffer.unaligned_height,
+                                              layer.input_buffer.height);
+  buffer_info.buffer_config.format = layer.input_buffer.format;
+  buffer_info.buffer_config.buffer_count = 1;
+  if (buffer_allocator_->AllocateBuffer(&buffer_info) != kErrorNone) {
+    buffer_info.buffer_config.format = kFormatRGBA8888;
+    if (buffer_allocator_->AllocateBuffer(&buffer_info) != kErrorNone) {
+      return nullptr;
+    }
+  }
+  test->buffers[buffer_id] = buffer_info;
+
+  return reinterpret_cast<buffer_handle_t>(buffer_info.private_data);
+}
+
+void HWCPerfTest::SetLayer(TestDisplay *test, HWCLayer *hwc_layer, const Layer &layer) {
+  buffer_handle_t buffer = GetBuffer(test, layer);
+  if (buffer) {
+    hwc_layer->SetLayerBuffer(buffer, nullptr);
+  }
+
+  hwc_frect_t crop = {layer.src_rect.left, layer.src_rect.top, layer.src_rect.right,
+                      layer.src_rect.bottom};
+  hwc_rect_t frame = {};
+  SetRect(layer.dst_rect, &frame);
+  std::vector<hwc_rect_t> damage_rects;
+  for (auto &rect : layer.dirty_regions) {
+    hwc_rect_t damage_rect = {};
+    SetRect(rect, &damage_rect);
+    damage_rects.push_back(damage_rect);
+  }
+  hwc_region_t damage = {damage_rects.size(), damage_rects.data()};
+
+  hwc_layer->SetLayerSourceCrop(crop);
+  hwc_layer->SetLayerDisplayFrame(frame);
+  hwc_layer->SetLayerSurfaceDamage(damage);
+  hwc_layer->SetLayerCompositionType(HWC2::Composition::Device);
+  hwc_layer->SetLayerBlendMode(GetBlendMode(layer.blending));
+  hwc_layer->SetLayerPlaneAlpha(FLOAT(layer.plane_alpha) / 255.0f);
+  hwc_layer->SetLayerTransform(GetTransform(layer.transform));
+  hwc_layer->SetLayerDataspace(HAL_DATASPACE_V0_SRGB);
+}
+
+void HWCPerfTest::DrawFrame(TestDisplay *test, const RecordedLayerStack &frame) {
+  HWCDisplay *display = test->display;
+  uint32_t layer_count = 0;
+  for (auto &layer : frame.layers) {
+    if (layer.composition == kCompositionGPUTarget) {
+      break;
+    }
+    if (layer_count == test->layers.size()) {
+      hwc2_layer_t layer_id = 0;
+      if (display->CreateLayer(&layer_id) != HWC2::Error::None) {
+        break;
+      }
+      test->layers.push_back(layer_id);
+    }
+
+    hwc2_layer_t layer_id = test->layers.at(layer_count);
+    display->SetLayerZOrder(layer_id, layer_count);
+    SetLayer(test, display->GetHWCLayer(layer_id), layer);
+    layer_count++;
+  }
+
+  // Layers the client no longer shows are destroyed, as on a change of scene.
+  while (test->layers.size() > layer_count) {
+    display->DestroyLayer(test->layers.back());
+    test->layers.pop_back();
+  }
+
+  uint32_t num_types = 0;
+  uint32_t num_requests = 0;
+  HWC2::Error error = display->Validate(&num_types, &num_requests);
+  if (error == HWC2::Error::HasChanges) {
+    display->AcceptDisplayChanges();
+  } else if (error != HWC2::Error::None) {
+    DLOGW("Validate failed on display %d, error %d", display->GetSdmId(), error);
+    return;
+  }
+
+  // The client target is never rendered, every frame gets the next buffer of the pair.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  display->GetFrameBufferResolution(&width, &height);
+  hwc_rect_t full_frame = {0, 0, INT(width), INT(height)};
+  hwc_region_t damage = {1, &full_frame};
+  test->client_target_index = (test->client_target_index + 1) % 2;
+  BufferInfo &client_target = test->client_targets[test->client_target_index];
+  display->SetClientTarget(reinterpret_cast<buffer_handle_t>(client_target.private_data),
+                           nullptr, HAL_DATASPACE_V0_SRGB, damage);
+
+  shared_ptr<Fence> retire_fence = nullptr;
+  display->Present(&retire_fence);
+}
+
+void HWCPerfTest::Run(TestDisplay *test) {
+  ThreadPolicy::Apply(kThreadClassPresent, "HWC_PerfTest");
+
+  uint64_t period_ns = 1000000000ULL / test->fps;
+  uint64_t vsync_ns = FrameTiming::Now();
+  uint32_t frame_index = 0;
+  while (!exit_) {
+    // Fake vsync, at absolute times so that slow frames do not shift the cadence.
+    vsync_ns += period_ns;
+    struct timespec ts = {};
+    ts.tv_sec = time_t(vsync_ns / 1000000000ULL);
+    ts.tv_nsec = long(vsync_ns % 1000000000ULL);  // NOLINT
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+    uint64_t cpu_start_ns = ThreadCpuNs();
+    uint64_t allocations = HWCAllocCounter::ThreadAllocations();
+    uint64_t lock_start_ns = FrameTiming::Now();
+    SCOPE_LOCK(test->locker);
+    uint64_t lock_wait_ns = FrameTiming::Now() - lock_start_ns;
+
+    DrawFrame(test, *script_.at(frame_index));
+    frame_index = (frame_index + 1) % UINT32(script_.size());
+
+    uint64_t cpu_ns = ThreadCpuNs() - cpu_start_ns;
+    allocations = HWCAllocCounter::ThreadAllocations() - allocations;
+    FrameStats &stats = test->stats;
+    stats.frames++;
+    stats.cpu_ns += cpu_ns;
+    stats.max_cpu_ns = std::max(stats.max_cpu_ns, cpu_ns);
+    stats.allocations += allocations;
+    stats.max_allocations = std::max(stats.max_allocations, allocations);
+    stats.lock_wait_ns += lock_wait_ns;
+    stats.max_lock_wait_ns = std::max(stats.max_lock_wait_ns, lock_wait_ns);
+
+    uint64_t now_ns = FrameTiming::Now();
+    if (now_ns > vsync_ns + period_ns) {
+      // Missed the next vsync, start over from this one.
+      stats.late_frames++;
+      vsync_ns = now_ns - ((now_ns - vsync_ns) % period_ns);
+    }
+  }
+}
+
+void HWCPerfTest::Dump(std::ostringstream *os) {
+  if (displays_.empty()) {
+    return;
+  }
+
+  *os << "\nPerf test: " << script_.size() << " layer stacks\n";
+  for (auto &test : displays_) {
+    SCOPE_LOCK(test->locker);
+    const FrameStats &stats = test->stats;
+    uint64_t frames = std::max(stats.frames, UINT64(1));
+    *os << "  display " << test->display->GetSdmId() << " at " << test->fps << " fps: "
+        << stats.frames << " frames, " << stats.late_frames << " late, cpu avg "
+        << stats.cpu_ns / frames / 1000 << " max " << stats.max_cpu_ns / 1000 << " us";
+    if (HWCAllocCounter::IsSupported()) {
+      *os << ", allocations avg " << stats.allocations / frames << " max "
+          << stats.max_allocations;
+    }
+    *os << ", lock wait avg " << stats.lock_wait_ns / frames / 1000 << " max "
+        << stats.max_lock_wait_ns / 1000 << " us\n";
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,115 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_PERF_TEST_H__
+#define __HWC_PERF_TEST_H__
+
+#include <core/core_interface.h>
+#include <utils/layer_stack_recorder.h>
+#include <utils/locker.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "hwc_buffer_allocator.h"
+#include "hwc_callbacks.h"
+#include "hwc_display.h"
+#include "hwc_display_event_handler.h"
+
+namespace sdm {
+
+// Headless performance test mode for null display mode (vendor.display.enable_null_display).
+// vendor.display.perf_test_fps lists refresh rates, e.g. "60,90,120", and one synthetic builtin
+// display is driven per rate from its own fake vsync thread. Each vsync replays the next layer
+// stack of the script through the HWC2 calls the client would make, validate to present. The
+// script is a layer stack recording (vendor.display.layer_stack_record_frames) named by
+// vendor.display.perf_test_record, or a built in wallpaper, app and status bar stack. Composer
+// CPU time, heap allocations and lock waits per frame are reported in dumpsys. The synthetic
+// displays have their own callbacks, the client never sees them.
+class HWCPerfTest : public HWCDisplayEventHandler {
+ public:
+  static const uint32_t kMaxDisplays = 4;
+
+  int Init(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
+           qService::QService *qservice);
+  void Deinit();
+  void Dump(std::ostringstream *os);
+  virtual void DisplayPowerReset() {}
+
+ private:
+  struct FrameStats {
+    uint64_t frames = 0;
+    uint64_t late_frames = 0;   // Presented after the next fake vsync
+    uint64_t cpu_ns = 0;
+    uint64_t max_cpu_ns = 0;
+    uint64_t allocations = 0;
+    uint64_t max_allocations = 0;
+    uint64_t lock_wait_ns = 0;
+    uint64_t max_lock_wait_ns = 0;
+  };
+
+  struct TestDisplay {
+    HWCDisplay *display = nullptr;
+    uint32_t fps = 0;
+    std::vector<hwc2_layer_t> layers;
+    std::map<uint64_t, BufferInfo> buffers;  // By recorded buffer id
+    BufferInfo client_targets[2];
+    uint32_t client_target_index = 0;
+    Locker locker;   // Held for each draw cycle and by Dump, like the session's display lockers
+    FrameStats stats;
+    std::thread thread;
+  };
+
+  static const uint32_t kMaxBuffers = 64;  // Per display, later buffer ids reuse the first one
+
+  void LoadScript();
+  void CreateDefaultScript(uint32_t width, uint32_t height);
+  int CreateDisplay(uint32_t index, uint32_t fps);
+  void DestroyDisplay(TestDisplay *test);
+  void Run(TestDisplay *test);
+  void DrawFrame(TestDisplay *test, const RecordedLayerStack &frame);
+  void SetLayer(TestDisplay *test, HWCLayer *hwc_layer, const Layer &layer);
+  buffer_handle_t GetBuffer(TestDisplay *test, const Layer &layer);
+
+  CoreInterface *core_intf_ = nullptr;
+  HWCBufferAllocator *buffer_allocator_ = nullptr;
+  qService::QService *qservice_ = nullptr;
+  HWCCallbacks callbacks_;   // Not registered with the client, refreshes are dropped
+  std::vector<std::unique_ptr<RecordedLayerStack>> script_;
+  std::vector<std::unique_ptr<TestDisplay>> displays_;
+  std::atomic<bool> exit_{false};
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_PERF_TEST_H__
@@ -0,0 +1,100 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <algorithm>
+
+#include "hwc_refresh_rate_governor.h"
+
+#define __CLASS__ "HWCRefreshRateGovernor"
+
+namespace sdm {
+
+constexpr uint32_t HWCRefreshRateGovernor::kHoldFrames;
+
+uint32_t HWCRefreshRateGovernor::GetRefreshRate(
+    const HWCLayerList &layer_set, int64_t now_ns,
+    uint32_t current_fps, uint32_t min_fps, uint32_t max_fps) {
+  if (!current_fps || !max_fps || min_fps > max_fps) {
+    return 0;
+  }
+
+  int64_t vsync_period_ns = 1000000000LL / current_fps;
+  bool irregular = false;
+  steady_fps_.clear();
+  for (auto hwc_layer : layer_set) {
+    uint32_t fps = 0;
+    LayerCadence::State state = hwc_layer->GetCadence().GetState(now_ns, vsync_period_ns, &fps);
+    if (state == LayerCadence::kIrregular) {
+      irregular = true;
+      break;
+    } else if (state == LayerCadence::kSteady) {
+      steady_fps_.push_back(fps);
+    }
+  }
+
+  uint32_t rate = 0;
+  if (irregular) {
+    rate = max_fps;
+  } else if (!steady_fps_.empty()) {
+    rate = GetLowestCommonRate(min_fps, max_fps);
+  } else {
+    pending_frames_ = 0;
+    return 0;
+  }
+
+  if (rate >= current_rate_ || current_rate_ > max_fps) {
+    current_rate_ = rate;
+    pending_frames_ = 0;
+  } else if (rate != pending_rate_ || pending_frames_ == 0) {
+    pending_rate_ = rate;
+    pending_frames_ = 1;
+  } else if (++pending_frames_ >= kHoldFrames) {
+    DLOGV_IF(kTagClient, "Lowering refresh rate %d -> %d", current_rate_, rate);
+    current_rate_ = rate;
+    pending_frames_ = 0;
+  }
+
+  return current_rate_;
+}
+
+uint32_t HWCRefreshRateGovernor::GetLowestCommonRate(uint32_t min_fps, uint32_t max_fps) {
+  for (uint32_t rate = std::max(min_fps, 1U); rate < max_fps; rate++) {
+    bool common = std::all_of(steady_fps_.begin(), steady_fps_.end(),
+                              [rate](uint32_t fps) { return (rate % fps) == 0; });
+    if (common) {
+      return rate;
+    }
+  }
+
+  return max_fps;
+}
+
+}  // namespace sdm
@@ -0,0 +1,66 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_REFRESH_RATE_GOVERNOR_H__
+#define __HWC_REFRESH_RATE_GOVERNOR_H__
+
+#include <set>
+#include <vector>
+
+#include "hwc_layers.h"
+
+namespace sdm {
+
+// Picks the lowest refresh rate that presents every updating layer of a display at its own
+// cadence. Steady content such as 24/30/60 fps video is shown at the lowest rate that is a
+// multiple of all steady rates, while any irregularly updating layer such as a touch burst keeps
+// the display at its maximum rate. Rate drops are held until the lower rate has been requested
+// for several frames in a row, so a short pause in an animation does not switch the rate.
+class HWCRefreshRateGovernor {
+ public:
+  // Returns 0 if no layer is updating, i.e. the governor has no preference for the frame.
+  uint32_t GetRefreshRate(const HWCLayerList &layer_set,
+                          int64_t now_ns, uint32_t current_fps, uint32_t min_fps,
+                          uint32_t max_fps);
+  uint32_t GetCurrentRate() const { return current_rate_; }
+
+ private:
+  static constexpr uint32_t kHoldFrames = 10;
+
+  uint32_t GetLowestCommonRate(uint32_t min_fps, uint32_t max_fps);
+
+  std::vector<uint32_t> steady_fps_ = {};
+  uint32_t current_rate_ = 0;
+  uint32_t pending_rate_ = 0;
+  uint32_t pending_frames_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_REFRESH_RATE_GOVERNOR_H__
@@ -23,25 +23,30 @@
 #include <cutils/properties.h>
 #include <display_config.h>
 #include <hardware_legacy/uevent.h>
+#include <linux/filter.h>
 #include <private/color_params.h>
 #include <qd_utils.h>
 #include <sync/sync.h>
-#include <sys/prctl.h>
-#include <sys/resource.h>
+#include <sys/socket.h>
 #include <utils/String16.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
+#include <utils/sys.h>
+#include <utils/thread_policy.h>
 #include <QService.h>
 #include <utils/utils.h>
 #include <algorithm>
 #include <utility>
 #include <bitset>
+#include <fstream>
 #include <iterator>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "hwc_alloc_counter.h"
 #include "hwc_buffer_allocator.h"
 #include "hwc_session.h"
 #include "hwc_debugger.h"
@@ -61,7 +66,7 @@ bool HWCSession::pending_power_mode_[HWCCallbacks::kNumDisplays];
 Locker HWCSession::power_state_[HWCCallbacks::kNumDisplays];
 Locker HWCSession::hdr_locker_[HWCCallbacks::kNumDisplays];
 Locker HWCSession::display_config_locker_;
-Locker HWCSession::system_locker_;
+RwLocker HWCSession::system_locker_;
 static const int kSolidFillDelay = 100 * 1000;
 int HWCSession::null_display_mode_ = 0;
 static const uint32_t kBrightnessScaleMax = 100;
@@ -88,11 +93,31 @@ int32_t GetDataspaceFromColorMode(ColorMode mode) {
   }
 }
 
-void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
-  const char *uevent_thread_name = "HWC_UeventThread";
+// Display hotplugs are KOBJ_CHANGE uevents. Only "change@..." messages are woken up for, most of
+// the uevent traffic (USB, drivers binding, power supply add/remove) is dropped by the kernel.
+static void AttachUEventFilter(int fd) {
+  // BPF_ABS loads are big endian: "chan", "ge" and '@'.
+  struct sock_filter filter[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x6368616e, 0, 5),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x6765, 0, 3),
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, '@', 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+  struct sock_fprog program = {};
+  program.len = sizeof(filter) / sizeof(filter[0]);
+  program.filter = filter;
+
+  if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program))) {
+    DLOGW("Failed to attach uevent filter. Error %d '%s'.", errno, strerror(errno));
+  }
+}
 
-  prctl(PR_SET_NAME, uevent_thread_name, 0, 0, 0);
-  setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
+  ThreadPolicy::Apply(kThreadClassUEvent, "HWC_UeventThread");
 
   int status = uevent_init();
   if (!status) {
@@ -101,6 +126,7 @@ void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
     DLOGE("Failed to init uevent with err %d", status);
     return;
   }
+  AttachUEventFilter(uevent_get_fd());
 
   {
     // Signal caller thread that worker thread is ready to listen to events.
@@ -109,11 +135,14 @@ void HWCUEvent::UEventThread(HWCUEvent *hwc_uevent) {
     hwc_uevent->caller_cv_.notify_one();
   }
 
+  char uevent_data[PAGE_SIZE] = {};
   while (1) {
-    char uevent_data[PAGE_SIZE] = {};
-
     // keep last 2 zeros to ensure double 0 termination
     int length = uevent_next_event(uevent_data, INT32(sizeof(uevent_data)) - 2);
+    if (length <= 0) {
+      continue;
+    }
+    uevent_data[length] = uevent_data[length + 1] = '\0';
 
     // scope of lock to this block only, so that caller is free to set event handler to nullptr;
     {
@@ -150,11 +179,39 @@ HWCSession *HWCSession::GetInstance() {
   return hwc_session;
 }
 
+// Libraries SDM core and composer open during display bring-up or on first use.
+static const char *kPreloadLibs[] = {
+  "libsdedrm.so",             // DRMLibLoader
+  "libsdmextension.so",       // CoreImpl and HWInfoDRM
+  "libsdm-color.so",          // ColorManagerProxy
+  "libsnapdragoncolor.so",    // STCIntfClient
+  "libdpps.so",               // DisplayBuiltIn DPPS
+  DISPLAY_API_INTERFACE_LIBRARY_NAME,
+  QDCM_DIAG_CLIENT_LIBRARY_NAME,
+};
+
+void HWCSession::PreloadLibraries() {
+  int disable_preload = 0;
+  HWCDebugHandler::Get()->GetProperty(DISABLE_LIB_PRELOAD_PROP, &disable_preload);
+  if (disable_preload == 1) {
+    return;
+  }
+
+  std::vector<std::string> lib_names(std::begin(kPreloadLibs), std::end(kPreloadLibs));
+  char perf_lib[PROPERTY_VALUE_MAX];
+  if (HWCDebugHandler::Get()->GetProperty("ro.vendor.extension_library", perf_lib) ==
+      kErrorNone) {
+    lib_names.push_back(perf_lib);  // CPUHint
+  }
+  DynLibPreloader::Start(lib_names);
+}
+
 int HWCSession::Init() {
   SCOPE_LOCK(locker_[HWC_DISPLAY_PRIMARY]);
 
   int status = -EINVAL;
   const char *qservice_name = "display.qservice";
+  init_start_ns_ = FrameTiming::Now();
 
   if (!g_hwc_uevent_.InitDone()) {
     return status;
@@ -177,6 +234,20 @@ int HWCSession::Init() {
   HWCDebugHandler::Get()->GetProperty(ENABLE_NULL_DISPLAY_PROP, &null_display_mode_);
   HWCDebugHandler::Get()->GetProperty(DISABLE_HOTPLUG_BWCHECK, &disable_hotplug_bwcheck_);
   HWCDebugHandler::Get()->GetProperty(DISABLE_MASK_LAYER_HINT, &disable_mask_layer_hint_);
+  HWCDebugHandler::Get()->GetProperty(DISABLE_SIDEBAND_STREAM_PROP, &disable_sideband_stream_);
+  HWCDebugHandler::InitLogRing();
+  PreloadLibraries();
+
+  int spin_count = 0;
+  HWCDebugHandler::Get()->GetProperty(LOCKER_SPIN_COUNT_PROP, &spin_count);
+  if (spin_count > 0) {
+    for (int id = 0; id < HWCCallbacks::kNumDisplays; id++) {
+      locker_[id].SetSpinCount(UINT32(spin_count));
+      power_state_[id].SetSpinCount(UINT32(spin_count));
+      hdr_locker_[id].SetSpinCount(UINT32(spin_count));
+    }
+    display_config_locker_.SetSpinCount(UINT32(spin_count));
+  }
 
   if (!null_display_mode_) {
     g_hwc_uevent_.Register(this);
@@ -192,6 +263,17 @@ int HWCSession::Init() {
   async_vds_creation_ = (value == 1);
   DLOGI("async_vds_creation: %d", async_vds_creation_);
 
+  value = 0;
+  Debug::Get()->GetProperty(ENABLE_ASYNC_DISPLAY_INIT, &value);
+  async_display_init_ = (value == 1);
+  DLOGI("async_display_init: %d", async_display_init_);
+
+  value = 0;
+  Debug::Get()->GetProperty(DISABLE_WARM_RESTART_PROP, &value);
+  if (!null_display_mode_ && (value != 1)) {
+    warm_state_.Init();
+  }
+
   InitSupportedDisplaySlots();
   // Create primary display here. Remaining builtin displays will be created after client has set
   // display indexes which may happen sometime before callback is registered.
@@ -201,6 +283,10 @@ int HWCSession::Init() {
     return status;
   }
 
+  if (null_display_mode_ && perf_test_.Init(core_intf_, &buffer_allocator_, qservice_)) {
+    DLOGW("Performance test displays could not be created");
+  }
+
   is_composer_up_ = true;
   StartServices();
 
@@ -221,6 +307,8 @@ void HWCSession::PostInit() {
 }
 
 int HWCSession::Deinit() {
+  perf_test_.Deinit();
+
   // Destroy all connected displays
   DestroyDisplay(&map_info_primary_);
 
@@ -249,6 +337,8 @@ int HWCSession::Deinit() {
     }
   }
 
+  warm_state_.Deinit();
+
   return 0;
 }
 
@@ -330,8 +420,10 @@ void HWCSession::InitSupportedDisplaySlots() {
 
   disp_count = UINT32(std::min(max_builtin, HWCCallbacks::kNumBuiltIn));
   map_info_builtin_.resize(disp_count);
+  builtin_display_slots_.set(UINT32(map_info_primary_.client_id));
   for (auto &map_info : map_info_builtin_) {
     map_info.client_id = base_id++;
+    builtin_display_slots_.set(UINT32(map_info.client_id));
   }
 
   disp_count = UINT32(std::min(max_virtual, HWCCallbacks::kNumVirtual));
@@ -365,6 +457,7 @@ void HWCSession::InitSupportedNullDisplaySlots() {
   }
 
   map_info_primary_.client_id = 0;
+  builtin_display_slots_.set(UINT32(map_info_primary_.client_id));
   // Resize HDR supported map to total number of displays
   is_hdr_display_.resize(1);
 
@@ -527,6 +620,20 @@ int32_t HWCSession::GetVirtualDisplayId() {
   return -1;
 }
 
+// Resident memory of the composer process. Buffers from the allocator are not part of it, the
+// displays report those per subsystem.
+static void DumpProcessMemory(std::ostringstream *os) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  *os << "\nProcess memory:\n";
+  while (std::getline(status, line)) {
+    if (!line.compare(0, 6, "VmRSS:") || !line.compare(0, 6, "VmHWM:") ||
+        !line.compare(0, 8, "RssAnon:") || !line.compare(0, 8, "RssFile:")) {
+      *os << "  " << line << "\n";
+    }
+  }
+}
+
 void HWCSession::Dump(uint32_t *out_size, char *out_buffer) {
   if (!out_size) {
     return;
@@ -537,16 +644,73 @@ void HWCSession::Dump(uint32_t *out_size, char *out_buffer) {
   if (out_buffer == nullptr) {
     *out_size = max_dump_size;
   } else {
+    // Periodic monitoring can set the perf level, which keeps the display locks held only for
+    // as long as the display state and statistics take.
+    int dump_level = kDumpLevelFull;
+    HWCDebugHandler::Get()->GetProperty(DUMP_LEVEL_PROP, &dump_level);
+    DumpLevel level = (dump_level == kDumpLevelPerf) ? kDumpLevelPerf : kDumpLevelFull;
     std::ostringstream os;
+    std::ostringstream bring_up;
+    std::ostringstream contention;
+    for (int id = 0; id < HWCCallbacks::kNumDisplays; id++) {
+      std::string suffix = "[" + std::to_string(id) + "]";
+      locker_[id].Dump(("locker_" + suffix).c_str(), &contention);
+      power_state_[id].Dump(("power_state_" + suffix).c_str(), &contention);
+      hdr_locker_[id].Dump(("hdr_locker_" + suffix).c_str(), &contention);
+    }
+    display_config_locker_.Dump("display_config_locker_", &contention);
+    std::ostringstream allocations;
+    for (int id = 0; id < HWCCallbacks::kNumDisplays; id++) {
+      auto &stats = frame_allocations_[id];
+      if (stats.frames && HWCAllocCounter::IsSupported()) {
+        allocations << "  display " << id << ": " << stats.allocating_frames << "/" << stats.frames
+                    << " frames allocated, " << stats.total << " allocations, max " << stats.max
+                    << " per frame\n";
+      }
+    }
     for (int id = 0; id < HWCCallbacks::kNumRealDisplays; id++) {
       SCOPE_LOCK(locker_[id]);
       if (hwc_display_[id]) {
-        hwc_display_[id]->Dump(&os);
+        hwc_display_[id]->Dump(&os, level);
+      }
+      auto &info = bring_up_[id];
+      if (info.create_ns) {
+        bring_up << "  client id " << id << " sdm id " << info.sdm_id << ": started at "
+                 << info.start_ns / 1000000 << " ms, created in " << info.create_ns / 1000000
+                 << " ms\n";
+      }
+    }
+    if (!bring_up.str().empty()) {
+      os << "\nDisplay bring-up" << (async_display_init_ ? " (async)" : "") << ":\n"
+         << bring_up.str();
+    }
+    if (!contention.str().empty()) {
+      os << "\nLock contention:\n" << contention.str();
+    }
+    if (!allocations.str().empty()) {
+      os << "\nDraw cycle heap allocations:\n" << allocations.str();
+    }
+    {
+      std::lock_guard<std::mutex> lock(sideband_lock_);
+      if (!sideband_queues_.empty()) {
+        os << "\nSideband streams:\n";
+        for (auto &stream : sideband_queues_) {
+          stream.second->Dump(&os);
+        }
       }
     }
+    perf_test_.Dump(&os);
+    callbacks_.DumpRefreshStats(&os);
     Fence::Dump(&os);
+    DynLibPreloader::Dump(&os);
+    ThreadPolicy::Dump(&os);
+    DumpProcessMemory(&os);
+    buffer_allocator_.Dump(&os);
 
     std::string s = os.str();
+    if (s.size() < max_dump_size) {
+      DebugHandler::DumpLogRing(max_dump_size - s.size(), &s);
+    }
     auto copied = s.copy(out_buffer, std::min(s.size(), max_dump_size), 0);
     *out_size = UINT32(copied);
   }
@@ -739,13 +903,14 @@ int32_t HWCSession::PresentDisplay(hwc2_display_t display, shared_ptr<Fence> *ou
   auto status = HWC2::Error::BadDisplay;
   DTRACE_SCOPED();
 
-  SCOPE_LOCK(system_locker_);
+  // Presents of different displays only exclude display teardown, not each other.
+  SCOPE_READ_LOCK(system_locker_);
   if (display >= HWCCallbacks::kNumDisplays) {
     DLOGW("Invalid Display : display = %" PRIu64, display);
     return HWC2_ERROR_BAD_DISPLAY;
   }
 
-  HandleSecureSession();
+  HandleSecureSession(display);
 
 
   hwc2_display_t target_display = display;
@@ -773,16 +938,29 @@ int32_t HWCSession::PresentDisplay(hwc2_display_t display, shared_ptr<Fence> *ou
       status = HWC2::Error::None;
     } else {
       hwc_display_[target_display]->ProcessActiveConfigChange();
+      callbacks_.RefreshConsumed(display);
+      uint64_t allocations = HWCAllocCounter::ThreadAllocations();
       status = PresentDisplayInternal(target_display);
+      CountFrameAllocations(target_display,
+                            HWCAllocCounter::ThreadAllocations() - allocations);
       if (status == HWC2::Error::None) {
         // Check if hwc's refresh trigger is getting exercised.
         if (callbacks_.NeedsRefresh(display)) {
           hwc_display_[target_display]->SetPendingRefresh();
           callbacks_.ResetRefresh(display);
+          VsyncPeriodNanos vsync_period = 0;
+          if (hwc_display_[target_display]->GetDisplayVsyncPeriod(&vsync_period) ==
+              HWC2::Error::None) {
+            callbacks_.SetRefreshWindow(display, vsync_period);
+          }
         }
+        int32_t sdm_id = hwc_display_[target_display]->GetSdmId();
+        uint64_t present_start = FrameTiming::Now();
         status = hwc_display_[target_display]->Present(out_retire_fence);
+        FrameTiming::Record(sdm_id, kFrameStagePresent, FrameTiming::Now() - present_start);
         if (status == HWC2::Error::None) {
           PerformQsyncCallback(target_display);
+          hwc_display_[target_display]->TraceFrameTiming();
         }
       }
     }
@@ -794,11 +972,15 @@ int32_t HWCSession::PresentDisplay(hwc2_display_t display, shared_ptr<Fence> *ou
 
   HandlePendingPowerMode(display, *out_retire_fence);
   HandlePendingHotplug(display, *out_retire_fence);
+  HandlePendingResourceHandoff(display);
   HandlePendingRefresh();
   if (status != HWC2::Error::NotValidated) {
     cwb_.PresentDisplayDone(display);
   }
-  display_ready_.set(UINT32(display));
+  {
+    SCOPE_LOCK(frame_state_locker_);
+    display_ready_.set(UINT32(display));
+  }
   {
     std::unique_lock<std::mutex> caller_lock(hotplug_mutex_);
     hotplug_cv_.notify_one();
@@ -808,13 +990,14 @@ int32_t HWCSession::PresentDisplay(hwc2_display_t display, shared_ptr<Fence> *ou
 }
 
 void HWCSession::HandlePendingRefresh() {
+  SCOPE_LOCK(frame_state_locker_);
   if (pending_refresh_.none()) {
     return;
   }
 
   for (size_t i = 0; i < pending_refresh_.size(); i++) {
     if (pending_refresh_.test(i)) {
-      callbacks_.Refresh(i);
+      callbacks_.Refresh(i, kRefreshReasonPowerMode);
     }
     break;
   }
@@ -859,16 +1042,28 @@ void HWCSession::RegisterCallback(int32_t descriptor, hwc2_callback_data_t callb
       callbacks_.Hotplug(HWC_DISPLAY_PRIMARY, HWC2::Connection::Connected);
     }
     // Create displays since they should now have their final display indices set.
+    auto handle_pluggable = [this]() {
+      DLOGI("Handling pluggable displays...");
+      int32_t err = HandlePluggableDisplays(false);
+      if (err) {
+        DLOGW("All displays could not be created. Error %d '%s'. Hotplug handling %s.", err,
+              strerror(abs(err)), pending_hotplug_event_ == kHotPlugEvent ? "deferred" :
+              "dropped");
+      }
+    };
+    // Built-in and pluggable displays occupy disjoint slots, so their creation can overlap.
+    std::thread pluggable_thread;
+    if (async_display_init_) {
+      pluggable_thread = std::thread(handle_pluggable);
+    }
     DLOGI("Handling built-in displays...");
     if (HandleBuiltInDisplays()) {
       DLOGW("Failed handling built-in displays.");
     }
-    DLOGI("Handling pluggable displays...");
-    int32_t err = HandlePluggableDisplays(false);
-    if (err) {
-      DLOGW("All displays could not be created. Error %d '%s'. Hotplug handling %s.", err,
-            strerror(abs(err)), pending_hotplug_event_ == kHotPlugEvent ? "deferred" :
-            "dropped");
+    if (pluggable_thread.joinable()) {
+      pluggable_thread.join();
+    } else {
+      handle_pluggable();
     }
 
     // If previously registered, call hotplug for all connected displays to refresh
@@ -966,7 +1161,13 @@ int32_t HWCSession::SetLayerBlendMode(hwc2_display_t display, hwc2_layer_t layer
 int32_t HWCSession::SetLayerBuffer(hwc2_display_t display, hwc2_layer_t layer,
                                    buffer_handle_t buffer,
                                    const shared_ptr<Fence> &acquire_fence) {
-  return CallLayerFunction(display, layer, &HWCLayer::SetLayerBuffer, buffer, acquire_fence);
+  int32_t status = CallLayerFunction(display, layer, &HWCLayer::SetLayerBuffer, buffer,
+                                     acquire_fence);
+  if (status == HWC2_ERROR_NONE && buffer) {
+    CallDisplayFunction(display, &HWCDisplay::PrefetchLayerBuffer, layer);
+  }
+
+  return status;
 }
 
 int32_t HWCSession::SetLayerColor(hwc2_display_t display, hwc2_layer_t layer, hwc_color_t color) {
@@ -1023,6 +1224,30 @@ int32_t HWCSession::SetLayerType(hwc2_display_t display, hwc2_layer_t layer,
   return CallDisplayFunction(display, &HWCDisplay::SetLayerType, layer, type);
 }
 
+int32_t HWCSession::SetLayerSidebandStream(hwc2_display_t display, hwc2_layer_t layer,
+                                           const native_handle_t *stream) {
+  if (disable_sideband_stream_) {
+    return HWC2_ERROR_UNSUPPORTED;
+  }
+
+  int32_t stream_id = qdutils::getSidebandStreamId(stream);
+  if (stream_id < 0) {
+    return HWC2_ERROR_BAD_PARAMETER;
+  }
+
+  std::shared_ptr<HWCSidebandQueue> queue = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(sideband_lock_);
+    auto &stream_queue = sideband_queues_[stream_id];
+    if (!stream_queue) {
+      stream_queue = std::make_shared<HWCSidebandQueue>(stream_id);
+    }
+    queue = stream_queue;
+  }
+
+  return CallDisplayFunction(display, &HWCDisplay::SetLayerSidebandStream, layer, queue);
+}
+
 int32_t HWCSession::SetLayerColorTransform(hwc2_display_t display, hwc2_layer_t layer,
                                            const float *matrix) {
   return CallLayerFunction(display, layer, &HWCLayer::SetLayerColorTransform, matrix);
@@ -1059,6 +1284,7 @@ int32_t HWCSession::SetPowerMode(hwc2_display_t display, int32_t int_mode) {
   }
 
   auto mode = static_cast<HWC2::PowerMode>(int_mode);
+  secure_sessions_stale_ = true;
 
   // When secure session going on primary, if power request comes on second built-in, cache it and
   // process once secure session ends.
@@ -1085,7 +1311,11 @@ int32_t HWCSession::SetPowerMode(hwc2_display_t display, int32_t int_mode) {
     return HWC2_ERROR_UNSUPPORTED;
   }
 
-  bool override_mode = async_powermode_ && display_ready_.test(UINT32(display));
+  bool override_mode = false;
+  {
+    SCOPE_LOCK(frame_state_locker_);
+    override_mode = async_powermode_ && display_ready_.test(UINT32(display));
+  }
   if (!override_mode) {
     auto error = CallDisplayFunction(display, &HWCDisplay::SetPowerMode, mode,
                                      false /* teardown */);
@@ -1100,6 +1330,8 @@ int32_t HWCSession::SetPowerMode(hwc2_display_t display, int32_t int_mode) {
   // Reset idle pc ref count on suspend, as we enable idle pc during suspend.
   if (mode == HWC2::PowerMode::Off) {
     idle_pc_ref_cnt_ = 0;
+    // Displays waiting on this display's pipes are released if no built-in display is left on.
+    HandlePendingResourceHandoff(display);
   }
 
 
@@ -1107,6 +1339,7 @@ int32_t HWCSession::SetPowerMode(hwc2_display_t display, int32_t int_mode) {
 
   if (mode == HWC2::PowerMode::Doze) {
     // Trigger one more refresh for PP features to take effect.
+    SCOPE_LOCK(frame_state_locker_);
     pending_refresh_.set(UINT32(display));
   }
 
@@ -1170,6 +1403,23 @@ bool HWCSession::isSmartPanelConfig(uint32_t disp_id, uint32_t config_id) {
   return hwc_display_[disp_id]->IsSmartPanelConfig(config_id);
 }
 
+// Steady state frames are expected not to allocate, so every frame that does is logged.
+void HWCSession::CountFrameAllocations(hwc2_display_t display, uint64_t present_allocations) {
+  FrameAllocations &stats = frame_allocations_[display];
+  uint64_t allocations = stats.pending + present_allocations;
+  stats.pending = 0;
+  stats.frames++;
+  if (!allocations) {
+    return;
+  }
+
+  stats.allocating_frames++;
+  stats.total += allocations;
+  stats.max = std::max(stats.max, allocations);
+  DLOGD_IF(kTagClient, "Display %" PRIu64 " frame %" PRIu64 " made %" PRIu64 " allocations",
+           display, stats.frames, allocations);
+}
+
 int32_t HWCSession::ValidateDisplay(hwc2_display_t display, uint32_t *out_num_types,
                                     uint32_t *out_num_requests) {
   //  out_num_types and out_num_requests will be non-NULL
@@ -1190,7 +1440,7 @@ int32_t HWCSession::ValidateDisplay(hwc2_display_t display, uint32_t *out_num_ty
   DTRACE_SCOPED();
   // TODO(user): Handle secure session, handle QDCM solid fill
   auto status = HWC2::Error::BadDisplay;
-  HandleSecureSession();
+  HandleSecureSession(display);
   {
     SEQUENCE_ENTRY_SCOPE_LOCK(locker_[target_display]);
     if (pending_power_mode_[display]) {
@@ -1198,7 +1448,13 @@ int32_t HWCSession::ValidateDisplay(hwc2_display_t display, uint32_t *out_num_ty
     } else if (hwc_display_[target_display]) {
       hwc_display_[target_display]->ProcessActiveConfigChange();
       hwc_display_[target_display]->SetFastPathComposition(false);
+      hwc_display_[target_display]->MarkClientUpdate();
+      // Refresh requests from here on change state this frame may not see.
+      callbacks_.RefreshConsumed(display);
+      uint64_t allocations = HWCAllocCounter::ThreadAllocations();
       status = ValidateDisplayInternal(target_display, out_num_types, out_num_requests);
+      frame_allocations_[target_display].pending +=
+          HWCAllocCounter::ThreadAllocations() - allocations;
     }
   }
 
@@ -1381,11 +1637,13 @@ android::status_t HWCSession::notifyCallback(uint32_t command, const android::Pa
       break;
 
     case qService::IQService::QDCM_SVC_CMDS:
+    case qService::IQService::QDCM_SVC_CMDS_SHM:
       if (!input_parcel || !output_parcel) {
         DLOGE("QService command = %d: input_parcel and output_parcel needed.", command);
         break;
       }
-      status = QdcmCMDHandler(input_parcel, output_parcel);
+      status = QdcmCMDHandler(input_parcel, output_parcel,
+                              command == qService::IQService::QDCM_SVC_CMDS_SHM);
       break;
 
     case qService::IQService::MIN_HDCP_ENCRYPTION_LEVEL_CHANGED: {
@@ -1634,6 +1892,14 @@ android::status_t HWCSession::notifyCallback(uint32_t command, const android::Pa
       status = GetSupportedDsiClk(input_parcel, output_parcel);
       break;
 
+    case qService::IQService::SET_DSI_CLK_CONSTRAINTS:
+      if (!input_parcel) {
+        DLOGE("QService command = %d: input_parcel needed.", command);
+        break;
+      }
+      status = SetDsiClkConstraints(input_parcel);
+      break;
+
     case qService::IQService::SET_PANEL_LUMINANCE:
       if (!input_parcel) {
         DLOGE("QService command = %d: input_parcel needed.", command);
@@ -1666,6 +1932,46 @@ android::status_t HWCSession::notifyCallback(uint32_t command, const android::Pa
       status = SetDisplayBrightnessScale(input_parcel);
       break;
 
+    case qService::IQService::SET_SDR_DIMMING_SCALE:
+      if (!input_parcel) {
+        DLOGE("QService command = %d: input_parcel needed.", command);
+        break;
+      }
+      status = SetSdrDimmingScale(input_parcel);
+      break;
+
+    case qService::IQService::SET_DISPLAY_PARAMS:
+      if (!input_parcel) {
+        DLOGE("QService command = %d: input_parcel needed.", command);
+        break;
+      }
+      status = SetDisplayParams(input_parcel);
+      break;
+
+    case qService::IQService::GET_DISPLAY_STATE_PAGE:
+      if (!input_parcel || !output_parcel) {
+        DLOGE("QService command = %d: input_parcel and output_parcel needed.", command);
+        break;
+      }
+      status = GetDisplayStatePage(input_parcel, output_parcel);
+      break;
+
+    case qService::IQService::GET_DISPLAY_EVENT_CHANNEL:
+      if (!input_parcel || !output_parcel) {
+        DLOGE("QService command = %d: input_parcel and output_parcel needed.", command);
+        break;
+      }
+      status = GetDisplayEventChannel(input_parcel, output_parcel);
+      break;
+
+    case qService::IQService::QUEUE_SIDEBAND_FRAME:
+      if (!input_parcel || !output_parcel) {
+        DLOGE("QService command = %d: input_parcel and output_parcel needed.", command);
+        break;
+      }
+      status = QueueSidebandFrame(input_parcel, output_parcel);
+      break;
+
     default:
       DLOGW("QService command = %d is not supported.", command);
       break;
@@ -1989,7 +2295,7 @@ android::status_t HWCSession::SetColorModeFromClient(const android::Parcel *inpu
   if (err != HWC2_ERROR_NONE)
     return -EINVAL;
 
-  callbacks_.Refresh(static_cast<hwc2_display_t>(disp_idx));
+  callbacks_.Refresh(static_cast<hwc2_display_t>(disp_idx), kRefreshReasonColor);
 
   return 0;
 }
@@ -2003,7 +2309,7 @@ android::status_t HWCSession::RefreshScreen(const android::Parcel *input_parcel)
     return -EINVAL;
   }
 
-  callbacks_.Refresh(static_cast<hwc2_display_t>(disp_idx));
+  callbacks_.Refresh(static_cast<hwc2_display_t>(disp_idx), kRefreshReasonClient);
 
   return 0;
 }
@@ -2095,7 +2401,8 @@ android::status_t HWCSession::QdcmCMDDispatch(uint32_t display_id,
 }
 
 android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel,
-                                             android::Parcel *output_parcel) {
+                                             android::Parcel *output_parcel,
+                                             bool shared_payload) {
   int ret = 0;
   float *brightness = NULL;
   uint32_t display_id(0);
@@ -2113,13 +2420,21 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
   pending_action.params = NULL;
 
   // Read display_id, payload_size and payload from in_parcel.
-  ret = HWCColorManager::CreatePayloadFromParcel(*input_parcel, &display_id, &req_payload);
+  if (shared_payload) {
+    ret = HWCColorManager::CreatePayloadFromSharedMemory(*input_parcel, &display_id,
+                                                         &req_payload);
+  } else {
+    ret = HWCColorManager::CreatePayloadFromParcel(*input_parcel, &display_id, &req_payload);
+  }
   if (!ret) {
     ret = QdcmCMDDispatch(display_id, req_payload, &resp_payload, &pending_action);
   }
 
   if (ret) {
     output_parcel->writeInt32(ret);  // first field in out parcel indicates return code.
+    if (shared_payload) {
+      HWCColorManager::DestroySharedPayload(&req_payload);
+    }
     req_payload.DestroyPayload();
     resp_payload.DestroyPayload();
     return ret;
@@ -2139,7 +2454,7 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
       DLOGV_IF(kTagQDCM, "pending action = %d, display_id = %d", BITMAP(count), display_id);
       switch (BITMAP(count)) {
         case kInvalidating:
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           break;
         case kEnterQDCMMode:
           ret = color_mgr_->EnableQDCMMode(true, hwc_display_[display_id]);
@@ -2153,7 +2468,7 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
             ret = color_mgr_->SetSolidFill(pending_action.params,
                                            true, hwc_display_[display_id]);
           }
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           usleep(kSolidFillDelay);
           break;
         case kDisableSolidFill:
@@ -2162,7 +2477,7 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
             ret = color_mgr_->SetSolidFill(pending_action.params,
                                            false, hwc_display_[display_id]);
           }
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           usleep(kSolidFillDelay);
           break;
         case kSetPanelBrightness:
@@ -2176,7 +2491,7 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
           break;
         case kEnableFrameCapture:
           ret = color_mgr_->SetFrameCapture(pending_action.params, true, hwc_display_[display_id]);
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           break;
         case kDisableFrameCapture:
           ret = color_mgr_->SetFrameCapture(pending_action.params, false,
@@ -2184,12 +2499,12 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
           break;
         case kConfigureDetailedEnhancer:
           ret = color_mgr_->SetDetailedEnhancer(pending_action.params, hwc_display_[display_id]);
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           break;
         case kModeSet:
           ret = static_cast<int>
                   (hwc_display_[display_id]->RestoreColorTransform());
-          callbacks_.Refresh(display_id);
+          callbacks_.Refresh(display_id, kRefreshReasonColor);
           break;
         case kNoAction:
           break;
@@ -2239,7 +2554,7 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
             }
           }
           if (!ret) {
-            callbacks_.Refresh(display_id);
+            callbacks_.Refresh(display_id, kRefreshReasonColor);
           }
           break;
         default:
@@ -2251,6 +2566,9 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
   // for display API getter case, marshall returned params into out_parcel.
   output_parcel->writeInt32(ret);
   HWCColorManager::MarshallStructIntoParcel(resp_payload, output_parcel);
+  if (shared_payload) {
+    HWCColorManager::DestroySharedPayload(&req_payload);
+  }
   req_payload.DestroyPayload();
   resp_payload.DestroyPayload();
 
@@ -2260,34 +2578,34 @@ android::status_t HWCSession::QdcmCMDHandler(const android::Parcel *input_parcel
   return ret;
 }
 
-int GetEventValue(const char *uevent_data, int length, const char *event_info) {
-  const char *iterator_str = uevent_data;
-  while (((iterator_str - uevent_data) <= length) && (*iterator_str)) {
-    const char *pstr = strstr(iterator_str, event_info);
-    if (pstr != NULL) {
-      return (atoi(iterator_str + strlen(event_info)));
+// Values of the hotplug keys in a uevent, pointing into the uevent data.
+struct HotplugUEvent {
+  const char *status = nullptr;
+  const char *mst_hotplug = nullptr;
+  int bpp = -1;
+  int pattern = -1;
+};
+
+template <size_t N>
+static inline const char *GetKeyValue(const char *token, const char (&key)[N]) {
+  return strncmp(token, key, N - 1) ? nullptr : token + N - 1;
+}
+
+// Walks the "KEY=value" strings of a uevent once, picking the hotplug keys.
+static void ParseHotplugUEvent(const char *uevent_data, int length, HotplugUEvent *event) {
+  const char *end = uevent_data + length;
+  for (const char *token = uevent_data; token < end && *token; token += strlen(token) + 1) {
+    const char *value = nullptr;
+    if ((value = GetKeyValue(token, "status=")) != nullptr) {
+      event->status = value;
+    } else if ((value = GetKeyValue(token, "MST_HOTPLUG=")) != nullptr) {
+      event->mst_hotplug = value;
+    } else if ((value = GetKeyValue(token, "bpp=")) != nullptr) {
+      event->bpp = atoi(value);
+    } else if ((value = GetKeyValue(token, "pattern=")) != nullptr) {
+      event->pattern = atoi(value);
     }
-    iterator_str += strlen(iterator_str) + 1;
   }
-
-  return -1;
-}
-
-const char *GetTokenValue(const char *uevent_data, int length, const char *token) {
-  const char *iterator_str = uevent_data;
-  const char *pstr = NULL;
-  while (((iterator_str - uevent_data) <= length) && (*iterator_str)) {
-    pstr = strstr(iterator_str, token);
-    if (pstr) {
-      break;
-    }
-    iterator_str += strlen(iterator_str) + 1;
-  }
-
-  if (pstr)
-    pstr = pstr+strlen(token);
-
-  return pstr;
 }
 
 android::status_t HWCSession::SetDsiClk(const android::Parcel *input_parcel) {
@@ -2346,6 +2664,26 @@ android::status_t HWCSession::GetSupportedDsiClk(const android::Parcel *input_pa
   return 0;
 }
 
+android::status_t HWCSession::SetDsiClkConstraints(const android::Parcel *input_parcel) {
+  int disp_id = input_parcel->readInt32();
+  int count = input_parcel->readInt32();
+  if (disp_id != HWC_DISPLAY_PRIMARY || count < 0 || count > kMaxDsiClkConstraints) {
+    return -EINVAL;
+  }
+
+  std::vector<uint64_t> avoided_rates;
+  for (int i = 0; i < count; i++) {
+    avoided_rates.push_back(UINT64(input_parcel->readInt64()));
+  }
+
+  SEQUENCE_WAIT_SCOPE_LOCK(locker_[disp_id]);
+  if (!hwc_display_[disp_id]) {
+    return -EINVAL;
+  }
+
+  return hwc_display_[disp_id]->SetDSIClockConstraints(avoided_rates);
+}
+
 android::status_t HWCSession::SetPanelLuminanceAttributes(const android::Parcel *input_parcel) {
   int disp_id = input_parcel->readInt32();
 
@@ -2378,14 +2716,16 @@ void HWCSession::UEventHandler(const char *uevent_data, int length) {
   if (callbacks_.IsClientConnected() && strcasestr(uevent_data, HWC_UEVENT_DRM_EXT_HOTPLUG)) {
     // MST hotplug will not carry connection status/test pattern etc.
     // Pluggable display handler will check all connection status' and take action accordingly.
-    const char *str_status = GetTokenValue(uevent_data, length, "status=");
-    const char *str_mst = GetTokenValue(uevent_data, length, "MST_HOTPLUG=");
+    HotplugUEvent event;
+    ParseHotplugUEvent(uevent_data, length, &event);
+    const char *str_status = event.status;
+    const char *str_mst = event.mst_hotplug;
     if (!str_status && !str_mst) {
       return;
     }
 
-    hpd_bpp_ = GetEventValue(uevent_data, length, "bpp=");
-    hpd_pattern_ = GetEventValue(uevent_data, length, "pattern=");
+    hpd_bpp_ = event.bpp;
+    hpd_pattern_ = event.pattern;
     DLOGI("Uevent = %s, status = %s, MST_HOTPLUG = %s, bpp = %d, pattern = %d", uevent_data,
           str_status ? str_status : "NULL", str_mst ? str_mst : "NULL", hpd_bpp_, hpd_pattern_);
 
@@ -2439,8 +2779,8 @@ int32_t HWCSession::GetVsyncPeriod(hwc2_display_t disp, uint32_t *vsync_period)
   return HWC2_ERROR_NONE;
 }
 
-void HWCSession::Refresh(hwc2_display_t display) {
-  callbacks_.Refresh(display);
+void HWCSession::Refresh(hwc2_display_t display, RefreshReason reason) {
+  callbacks_.Refresh(display, reason);
 }
 
 android::status_t HWCSession::GetVisibleDisplayRect(const android::Parcel *input_parcel,
@@ -2506,6 +2846,7 @@ int HWCSession::CreatePrimaryDisplay() {
 
     auto hwc_display = &hwc_display_[HWC_DISPLAY_PRIMARY];
     hwc2_display_t client_id = map_info_primary_.client_id;
+    uint64_t start_ns = FrameTiming::Now();
 
     if (info.display_type == kBuiltIn) {
       status = HWCDisplayBuiltIn::Create(core_intf_, &buffer_allocator_, &callbacks_, this,
@@ -2520,6 +2861,8 @@ int HWCSession::CreatePrimaryDisplay() {
     }
 
     if (!status) {
+      RecordBringUp(client_id, info.display_id, start_ns);
+      AdoptWarmState(client_id, info.display_id);
       DLOGI("Created primary display type = %d, sdm id = %d, client id = %d", info.display_type,
              info.display_id, UINT32(client_id));
       {
@@ -2559,6 +2902,69 @@ void HWCSession::CreateDummyDisplay(hwc2_display_t client_id) {
   }
 }
 
+void HWCSession::RecordBringUp(hwc2_display_t client_id, int32_t sdm_id, uint64_t start_ns) {
+  // Caller holds locker_[client_id].
+  auto &info = bring_up_[UINT32(client_id)];
+  info.sdm_id = sdm_id;
+  info.start_ns = start_ns - init_start_ns_;
+  info.create_ns = FrameTiming::Now() - start_ns;
+}
+
+void HWCSession::AdoptWarmState(hwc2_display_t client_id, int32_t sdm_id) {
+  // Caller holds locker_[client_id].
+  auto &hwc_display = hwc_display_[client_id];
+  HWCWarmDisplayState state = {};
+  if (warm_state_.GetPrevious(client_id, sdm_id, &state)) {
+    DLOGI("Adopting state of display %d: config %d, color mode %d/%d, brightness %s%f", sdm_id,
+          state.active_config, state.color_mode, state.render_intent,
+          state.has_brightness ? "" : "unset ", state.brightness);
+    // Before the first commit the config is only cached, so the first modeset already uses it.
+    if (state.active_config >= 0) {
+      hwc_display->SetActiveConfig(hwc2_config_t(state.active_config));
+    }
+    if (state.color_mode >= 0) {
+      hwc_display->SetColorModeWithRenderIntent(static_cast<ColorMode>(state.color_mode),
+                                                static_cast<RenderIntent>(state.render_intent));
+    }
+    if (state.has_brightness) {
+      hwc_display->SetPanelBrightness(state.brightness);
+    }
+  }
+
+  hwc_display->SetWarmState(warm_state_.Acquire(client_id, sdm_id));
+}
+
+int HWCSession::CreateBuiltInDisplay(const HWDisplayInfo &info, DisplayMapInfo *map_info) {
+  hwc2_display_t client_id = map_info->client_id;
+  SCOPE_LOCK(locker_[client_id]);
+
+  DLOGI("Create builtin display, sdm id = %d, client id = %d", info.display_id,
+        UINT32(client_id));
+  uint64_t start_ns = FrameTiming::Now();
+  int status = HWCDisplayBuiltIn::Create(core_intf_, &buffer_allocator_, &callbacks_, this,
+                                         qservice_, client_id, info.display_id,
+                                         &hwc_display_[client_id]);
+  if (status) {
+    DLOGE("Builtin display creation failed.");
+    return status;
+  }
+
+  {
+    SCOPE_LOCK(hdr_locker_[client_id]);
+    is_hdr_display_[UINT32(client_id)] = HasHDRSupport(hwc_display_[client_id]);
+  }
+
+  RecordBringUp(client_id, info.display_id, start_ns);
+  AdoptWarmState(client_id, info.display_id);
+  DLOGI("Builtin display created: sdm id = %d, client id = %d", info.display_id,
+        UINT32(client_id));
+  map_info->disp_type = info.display_type;
+  map_info->sdm_id = info.display_id;
+  CreateDummyDisplay(client_id);
+
+  return 0;
+}
+
 int HWCSession::HandleBuiltInDisplays() {
   if (null_display_mode_) {
     DLOGW("Skipped BuiltIn display handling in null-display mode");
@@ -2572,7 +2978,9 @@ int HWCSession::HandleBuiltInDisplays() {
     return -EINVAL;
   }
 
-  int status = 0;
+  // Assign each built-in display a free slot, in display order.
+  std::vector<std::pair<HWDisplayInfo, DisplayMapInfo *>> pending;
+  auto slot = map_info_builtin_.begin();
   for (auto &iter : hw_displays_info) {
     auto &info = iter.second;
 
@@ -2581,43 +2989,47 @@ int HWCSession::HandleBuiltInDisplays() {
       continue;
     }
 
-    for (auto &map_info : map_info_builtin_) {
-      hwc2_display_t client_id = map_info.client_id;
-
-      {
-        SCOPE_LOCK(locker_[client_id]);
-        // Lock confined to this scope
-        if (hwc_display_[client_id]) {
-          continue;
-        }
-
-        DLOGI("Create builtin display, sdm id = %d, client id = %d", info.display_id,
-              UINT32(client_id));
-        status = HWCDisplayBuiltIn::Create(core_intf_, &buffer_allocator_, &callbacks_, this,
-                                           qservice_, client_id, info.display_id,
-                                           &hwc_display_[client_id]);
-        if (status) {
-          DLOGE("Builtin display creation failed.");
-          break;
-        }
-
-        {
-          SCOPE_LOCK(hdr_locker_[client_id]);
-          is_hdr_display_[UINT32(client_id)] = HasHDRSupport(hwc_display_[client_id]);
-        }
-
-        DLOGI("Builtin display created: sdm id = %d, client id = %d", info.display_id,
-              UINT32(client_id));
-        map_info.disp_type = info.display_type;
-        map_info.sdm_id = info.display_id;
-        CreateDummyDisplay(client_id);
+    for (; slot != map_info_builtin_.end(); slot++) {
+      SCOPE_LOCK(locker_[slot->client_id]);
+      if (!hwc_display_[slot->client_id]) {
+        break;
       }
-
-      DLOGI("Hotplugging builtin display, sdm id = %d, client id = %d", info.display_id,
-            UINT32(client_id));
-      callbacks_.Hotplug(client_id, HWC2::Connection::Connected);
+    }
+    if (slot == map_info_builtin_.end()) {
       break;
     }
+    pending.push_back(std::make_pair(info, &(*slot++)));
+  }
+
+  // Create the displays, on worker threads when enabled. The SDM core still creates one display
+  // at a time, the HWC side setup of each display overlaps.
+  std::vector<int> results(pending.size(), 0);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < pending.size(); i++) {
+    auto create = [this, &pending, &results, i]() {
+      results[i] = CreateBuiltInDisplay(pending[i].first, pending[i].second);
+    };
+    if (async_display_init_ && (i + 1) < pending.size()) {
+      workers.push_back(std::thread(create));
+    } else {
+      create();
+    }
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  int status = 0;
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (results[i]) {
+      status = results[i];
+      continue;
+    }
+
+    hwc2_display_t client_id = pending[i].second->client_id;
+    DLOGI("Hotplugging builtin display, sdm id = %d, client id = %d", pending[i].first.display_id,
+          UINT32(client_id));
+    callbacks_.Hotplug(client_id, HWC2::Connection::Connected);
   }
 
   return status;
@@ -2717,7 +3129,7 @@ int HWCSession::HandleConnectedDisplays(HWDisplaysInfo *hw_displays_info, bool d
         if (active_builtin_disp_id >= HWCCallbacks::kNumDisplays) {
           active_builtin_disp_id = HWC_DISPLAY_PRIMARY;
         }
-        callbacks_.Refresh(active_builtin_disp_id);
+        callbacks_.Refresh(active_builtin_disp_id, kRefreshReasonResources);
       }
       break;
     }
@@ -2740,6 +3152,7 @@ int HWCSession::HandleConnectedDisplays(HWDisplaysInfo *hw_displays_info, bool d
 
         // Test pattern generation ?
         map_info.test_pattern = (hpd_bpp_ > 0) && (hpd_pattern_ > 0);
+        uint64_t start_ns = FrameTiming::Now();
         int err = 0;
         if (!map_info.test_pattern) {
           err = HWCDisplayPluggable::Create(core_intf_, &buffer_allocator_,
@@ -2765,6 +3178,7 @@ int HWCSession::HandleConnectedDisplays(HWDisplaysInfo *hw_displays_info, bool d
           is_hdr_display_[UINT32(client_id)] = HasHDRSupport(hwc_display);
         }
 
+        RecordBringUp(client_id, info.display_id, start_ns);
         DLOGI("Created pluggable display successfully: sdm id = %d, client id = %d",
               info.display_id, UINT32(client_id));
         CreateDummyDisplay(client_id);
@@ -2788,7 +3202,20 @@ int HWCSession::HandleConnectedDisplays(HWDisplaysInfo *hw_displays_info, bool d
   // Active builtin display needs revalidation
   hwc2_display_t active_builtin_disp_id = GetActiveBuiltinDisplay();
   if (active_builtin_disp_id < HWCCallbacks::kNumDisplays) {
-    WaitForResources(delay_hotplug, active_builtin_disp_id, client_id);
+    WaitForResources(false, active_builtin_disp_id, client_id);
+    if (delay_hotplug) {
+      // Hotplug is notified from PresentDisplay once the built-in display's revalidated frames
+      // have handed the pipes over, instead of blocking this thread on them.
+      {
+        SCOPE_LOCK(resource_handoff_locker_);
+        pending_resource_handoff_.insert(pending_resource_handoff_.end(), pending_hotplugs.begin(),
+                                         pending_hotplugs.end());
+      }
+      if (client_connected_) {
+        Refresh(active_builtin_disp_id, kRefreshReasonResources);
+      }
+      return status;
+    }
   }
 
   for (auto client_id : pending_hotplugs) {
@@ -2855,7 +3282,7 @@ void HWCSession::DestroyPluggableDisplay(DisplayMapInfo *map_info) {
   DLOGI("Notify hotplug display disconnected: client id = %d", UINT32(client_id));
   callbacks_.Hotplug(client_id, HWC2::Connection::Disconnected);
 
-  SCOPE_LOCK(system_locker_);
+  SCOPE_WRITE_LOCK(system_locker_);
   {
     SEQUENCE_WAIT_SCOPE_LOCK(locker_[client_id]);
     auto &hwc_display = hwc_display_[client_id];
@@ -2878,13 +3305,19 @@ void HWCSession::DestroyPluggableDisplay(DisplayMapInfo *map_info) {
     if (async_powermode_) {
       hwc2_display_t dummy_disp_id = map_hwc_display_.find(client_id)->second;
       auto &hwc_display_dummy = hwc_display_[dummy_disp_id];
-      display_ready_.reset(UINT32(dummy_disp_id));
+      {
+        SCOPE_LOCK(frame_state_locker_);
+        display_ready_.reset(UINT32(dummy_disp_id));
+      }
       if (hwc_display_dummy) {
         HWCDisplayDummy::Destroy(hwc_display_dummy);
         hwc_display_dummy = nullptr;
       }
     }
-    display_ready_.reset(UINT32(client_id));
+    {
+      SCOPE_LOCK(frame_state_locker_);
+      display_ready_.reset(UINT32(client_id));
+    }
     pending_power_mode_[client_id] = false;
     hwc_display = nullptr;
     map_info->Reset();
@@ -2906,6 +3339,7 @@ void HWCSession::DestroyNonPluggableDisplay(DisplayMapInfo *map_info) {
     is_hdr_display_[UINT32(client_id)] = false;
   }
 
+  warm_state_.Release(client_id);
   switch (map_info->disp_type) {
     case kBuiltIn:
       HWCDisplayBuiltIn::Destroy(hwc_display);
@@ -2918,7 +3352,10 @@ void HWCSession::DestroyNonPluggableDisplay(DisplayMapInfo *map_info) {
     if (async_powermode_ && map_info->disp_type == kBuiltIn) {
       hwc2_display_t dummy_disp_id = map_hwc_display_.find(client_id)->second;
       auto &hwc_display_dummy = hwc_display_[dummy_disp_id];
-      display_ready_.reset(UINT32(dummy_disp_id));
+      {
+        SCOPE_LOCK(frame_state_locker_);
+        display_ready_.reset(UINT32(dummy_disp_id));
+      }
       if (hwc_display_dummy) {
         HWCDisplayDummy::Destroy(hwc_display_dummy);
         hwc_display_dummy = nullptr;
@@ -2926,7 +3363,10 @@ void HWCSession::DestroyNonPluggableDisplay(DisplayMapInfo *map_info) {
     }
     pending_power_mode_[client_id] = false;
     hwc_display = nullptr;
-    display_ready_.reset(UINT32(client_id));
+    {
+      SCOPE_LOCK(frame_state_locker_);
+      display_ready_.reset(UINT32(client_id));
+    }
     map_info->Reset();
 }
 
@@ -2935,6 +3375,7 @@ HWC2::Error HWCSession::ValidateDisplayInternal(hwc2_display_t display, uint32_t
   HWCDisplay *hwc_display = hwc_display_[display];
 
   DTRACE_SCOPED();
+  FrameTiming::ScopedStage stage_timing(hwc_display->GetSdmId(), kFrameStageValidate);
   if (hwc_display->IsInternalValidateState()) {
     // Internal Validation has already been done on display, get the Output params.
     return hwc_display->GetValidateDisplayOutput(out_num_types, out_num_requests);
@@ -3025,10 +3466,16 @@ void HWCSession::DisplayPowerReset() {
     locker_[display].Unlock();
   }
 
-  callbacks_.Refresh(vsync_source);
+  callbacks_.Refresh(vsync_source, kRefreshReasonPowerMode);
 }
 
-void HWCSession::HandleSecureSession() {
+void HWCSession::HandleSecureSession(hwc2_display_t disp_id) {
+  // Secure session transitions are driven from the built-in draw cycle, which applies them to
+  // every display below. Other displays need not contend for the built-in display locks.
+  if (disp_id >= HWCCallbacks::kNumDisplays || !builtin_display_slots_.test(UINT32(disp_id))) {
+    return;
+  }
+
   std::bitset<kSecureMax> secure_sessions = 0;
   {
     // TODO(user): Revisit if supporting secure display on non-primary.
@@ -3052,20 +3499,30 @@ void HWCSession::HandleSecureSession() {
     return;
   }
 
+  // Sessions stay the same for the whole of a protected playback. Handing them to the displays
+  // again on every validate and present would only contend for the locks of their commits.
+  if (!secure_sessions_stale_ && (secure_sessions == applied_secure_sessions_)) {
+    return;
+  }
+  applied_secure_sessions_ = secure_sessions;
+  secure_sessions_stale_ = false;
+
   // If it is called during primary prepare/commit, we need to pause any ongoing commit on
   // external/virtual display.
   for (hwc2_display_t display = HWC_DISPLAY_PRIMARY;
     display < HWCCallbacks::kNumDisplays; display++) {
     Locker::ScopeLock lock_d(locker_[display]);
-    if (hwc_display_[display]) {
-      hwc_display_[display]->HandleSecureSession(secure_sessions, &pending_power_mode_[display]);
+    if (hwc_display_[display] &&
+        hwc_display_[display]->HandleSecureSession(secure_sessions, &pending_power_mode_[display])) {
+      // Try again with the next frame.
+      secure_sessions_stale_ = true;
     }
   }
 }
 
 void HWCSession::HandlePendingPowerMode(hwc2_display_t disp_id,
                                         const shared_ptr<Fence> &retire_fence) {
-  if (!secure_session_active_) {
+  if (!secure_session_active_ || !builtin_display_slots_.test(UINT32(disp_id))) {
     // No secure session active. Skip remaining steps.
     return;
   }
@@ -3110,7 +3567,9 @@ void HWCSession::HandlePendingPowerMode(hwc2_display_t disp_id,
           hwc_display_[display]->SetPowerMode(hwc_display_[display]->GetPendingPowerMode(), false);
         if (HWC2::Error::None == error) {
           pending_power_mode_[display] = false;
+          secure_sessions_stale_ = true;
           hwc_display_[display]->ClearPendingPowerMode();
+          SCOPE_LOCK(frame_state_locker_);
           pending_refresh_.set(UINT32(HWC_DISPLAY_PRIMARY));
         } else {
           DLOGE("SetDisplayStatus error = %d (%s)", error, to_string(error).c_str());
@@ -3123,9 +3582,12 @@ void HWCSession::HandlePendingPowerMode(hwc2_display_t disp_id,
 
 void HWCSession::HandlePendingHotplug(hwc2_display_t disp_id,
                                       const shared_ptr<Fence> &retire_fence) {
+  if (kHotPlugNone == pending_hotplug_event_ && !destroy_virtual_disp_pending_) {
+    return;
+  }
+
   hwc2_display_t active_builtin_disp_id = GetActiveBuiltinDisplay();
-  if (disp_id != active_builtin_disp_id ||
-      (kHotPlugNone == pending_hotplug_event_ && !destroy_virtual_disp_pending_)) {
+  if (disp_id != active_builtin_disp_id) {
     return;
   }
 
@@ -3170,6 +3632,58 @@ void HWCSession::HandlePendingHotplug(hwc2_display_t disp_id,
   }
 }
 
+void HWCSession::HandlePendingResourceHandoff(hwc2_display_t disp_id) {
+  SCOPE_LOCK(resource_handoff_locker_);
+  if (pending_resource_handoff_.empty()) {
+    return;
+  }
+
+  hwc2_display_t active_builtin_disp_id = GetActiveBuiltinDisplay();
+  if (disp_id != active_builtin_disp_id && active_builtin_disp_id < HWCCallbacks::kNumDisplays) {
+    return;
+  }
+
+  std::vector<hwc2_display_t> ready;
+  for (auto iter = pending_resource_handoff_.begin(); iter != pending_resource_handoff_.end();) {
+    hwc2_display_t client_id = *iter;
+    bool res_wait = false;
+    {
+      SCOPE_LOCK(locker_[client_id]);
+      if (!hwc_display_[client_id]) {
+        // Disconnected before its resources were handed over.
+        iter = pending_resource_handoff_.erase(iter);
+        continue;
+      }
+      // Nothing left to hand over once all built-in displays are off.
+      if (active_builtin_disp_id < HWCCallbacks::kNumDisplays) {
+        res_wait = hwc_display_[client_id]->CheckResourceState();
+      }
+    }
+
+    if (res_wait) {
+      iter++;
+      continue;
+    }
+    ready.push_back(client_id);
+    iter = pending_resource_handoff_.erase(iter);
+  }
+
+  if (!pending_resource_handoff_.empty()) {
+    // Drive another built-in frame; its strategy was already invalidated on hotplug.
+    callbacks_.Refresh(active_builtin_disp_id, kRefreshReasonResources);
+  }
+
+  if (ready.size()) {
+    // Notify hotplug from a different thread to avoid calling into the client from PresentDisplay.
+    std::thread([this, ready]() {
+      for (auto client_id : ready) {
+        DLOGI("Notify hotplug display connected: client id = %d", UINT32(client_id));
+        callbacks_.Hotplug(client_id, HWC2::Connection::Connected);
+      }
+    }).detach();
+  }
+}
+
 int32_t HWCSession::GetReadbackBufferAttributes(hwc2_display_t display, int32_t *format,
                                                 int32_t *dataspace) {
   if (display >= HWCCallbacks::kNumDisplays) {
@@ -3458,12 +3972,223 @@ int32_t HWCSession::SetDisplayBrightnessScale(const android::Parcel *input_parce
   auto bl_scale = level * kSvBlScaleMax / kBrightnessScaleMax;
   auto error = CallDisplayFunction(display, &HWCDisplay::SetBLScale, (uint32_t)bl_scale);
   if (INT32(error) == HWC2_ERROR_NONE) {
-    callbacks_.Refresh(display);
+    callbacks_.Refresh(display, kRefreshReasonColor);
+  }
+
+  return INT32(error);
+}
+
+int32_t HWCSession::SetSdrDimmingScale(const android::Parcel *input_parcel) {
+  auto display = input_parcel->readInt32();
+  auto level = input_parcel->readInt32();
+  if (level < 0 || level > kBrightnessScaleMax) {
+    DLOGE("Invalid SDR dimming level %d", level);
+    return -EINVAL;
+  }
+  auto scale = FLOAT(level) / FLOAT(kBrightnessScaleMax);
+  auto error = CallDisplayFunction(display, &HWCDisplay::SetSdrDimmingScale, scale);
+  if (INT32(error) == HWC2_ERROR_NONE) {
+    callbacks_.Refresh(display, kRefreshReasonColor);
   }
 
   return INT32(error);
 }
 
+android::status_t HWCSession::SetDisplayParams(const android::Parcel *input_parcel) {
+  auto version = input_parcel->readInt32();
+  auto display = input_parcel->readInt32();
+  auto count = input_parcel->readInt32();
+  if (version < 1 || version > qService::IQService::DISPLAY_PARAMS_VERSION) {
+    DLOGE("Unsupported display params version %d", version);
+    return -ENOTSUP;
+  }
+  if (display < 0 || display >= HWCCallbacks::kNumRealDisplays || count < 0 ||
+      count >= qService::IQService::PARAM_MAX) {
+    DLOGE("Invalid display %d or param count %d", display, count);
+    return -EINVAL;
+  }
+
+  // Validate the whole batch before applying any of it.
+  int32_t values[qService::IQService::PARAM_MAX] = {};
+  uint32_t params = 0;
+  for (int32_t i = 0; i < count; i++) {
+    auto param = input_parcel->readInt32();
+    auto value = input_parcel->readInt32();
+    bool valid = false;
+    switch (param) {
+      case qService::IQService::PARAM_BRIGHTNESS_SCALE:
+      case qService::IQService::PARAM_SDR_DIMMING_SCALE:
+        valid = (value >= 0 && UINT32(value) <= kBrightnessScaleMax);
+        break;
+      case qService::IQService::PARAM_REFRESH_RATE:
+        valid = (value >= 0);
+        break;
+      case qService::IQService::PARAM_IDLE_PC:
+        valid = (value == 0 || value == 1);
+        break;
+      default:
+        break;
+    }
+    if (!valid || (params & (1 << param))) {
+      DLOGE("Invalid display param %d = %d", param, value);
+      return -EINVAL;
+    }
+    params |= (1 << param);
+    values[param] = value;
+  }
+
+  bool idle_pc = (params & (1 << qService::IQService::PARAM_IDLE_PC));
+  if (idle_pc && UINT32(display) != GetActiveBuiltinDisplay()) {
+    DLOGE("Idle PC can only be set along with the active built-in display");
+    return -EINVAL;
+  }
+
+  // One sequence lock for the whole batch: it waits for the frame in flight, and the next frame
+  // picks up every parameter.
+  SEQUENCE_WAIT_SCOPE_LOCK(locker_[display]);
+  HWCDisplay *hwc_display = hwc_display_[display];
+  if (!hwc_display) {
+    DLOGW("Display = %d is not connected.", display);
+    return -ENODEV;
+  }
+
+  int status = 0;
+  if (params & (1 << qService::IQService::PARAM_BRIGHTNESS_SCALE)) {
+    auto level = UINT32(values[qService::IQService::PARAM_BRIGHTNESS_SCALE]);
+    if (hwc_display->SetBLScale(level * kSvBlScaleMax / kBrightnessScaleMax) !=
+        HWC2::Error::None) {
+      status = -EINVAL;
+    }
+  }
+  if (params & (1 << qService::IQService::PARAM_SDR_DIMMING_SCALE)) {
+    auto level = values[qService::IQService::PARAM_SDR_DIMMING_SCALE];
+    if (hwc_display->SetSdrDimmingScale(FLOAT(level) / FLOAT(kBrightnessScaleMax)) !=
+        HWC2::Error::None) {
+      status = -EINVAL;
+    }
+  }
+  if (params & (1 << qService::IQService::PARAM_REFRESH_RATE)) {
+    auto refresh_rate = values[qService::IQService::PARAM_REFRESH_RATE];
+    if (hwc_display->Perform(HWCDisplayBuiltIn::SET_BINDER_DYN_REFRESH_RATE, refresh_rate)) {
+      status = -EINVAL;
+    }
+  }
+
+  if (idle_pc) {
+    // Disabling idle PC also refreshes and waits for that frame to be committed.
+    int err = ControlIdlePowerCollapseLocked(UINT32(display),
+                                             values[qService::IQService::PARAM_IDLE_PC], true);
+    status = status ? status : err;
+  } else if (params) {
+    callbacks_.Refresh(UINT32(display), kRefreshReasonClient);
+  }
+
+  return status;
+}
+
+android::status_t HWCSession::GetDisplayStatePage(const android::Parcel *input_parcel,
+                                                  android::Parcel *output_parcel) {
+  auto display = input_parcel->readInt32();
+  if (display < 0 || display >= HWCCallbacks::kNumRealDisplays) {
+    return -EINVAL;
+  }
+
+  SCOPE_LOCK(locker_[display]);
+  if (!hwc_display_[display]) {
+    return -ENODEV;
+  }
+
+  int fd = hwc_display_[display]->GetStatePageFd();
+  if (fd < 0) {
+    return -ENOMEM;
+  }
+
+  return output_parcel->writeDupFileDescriptor(fd);
+}
+
+android::status_t HWCSession::GetDisplayEventChannel(const android::Parcel *input_parcel,
+                                                     android::Parcel *output_parcel) {
+  auto display = input_parcel->readInt32();
+  if (display < 0 || display >= HWCCallbacks::kNumRealDisplays) {
+    return -EINVAL;
+  }
+
+  SCOPE_LOCK(locker_[display]);
+  if (!hwc_display_[display]) {
+    return -ENODEV;
+  }
+
+  int ring_fd = -1;
+  int event_fd = -1;
+  if (hwc_display_[display]->GetEventChannelFds(&ring_fd, &event_fd)) {
+    return -ENOMEM;
+  }
+
+  // The ring is mapped read-only by the client, the eventfd is polled for new events.
+  android::status_t status = output_parcel->writeDupFileDescriptor(ring_fd);
+  return status ? status : output_parcel->writeDupFileDescriptor(event_fd);
+}
+
+android::status_t HWCSession::QueueSidebandFrame(const android::Parcel *input_parcel,
+                                                 android::Parcel *output_parcel) {
+  if (disable_sideband_stream_) {
+    return -ENOTSUP;
+  }
+
+  int32_t stream_id = input_parcel->readInt32();
+  native_handle_t *buffer = nullptr;
+  if (input_parcel->readInt32()) {
+    buffer = input_parcel->readNativeHandle();
+    if (!buffer || private_handle_t::validate(buffer)) {
+      DLOGE("Invalid buffer queued on sideband stream %d", stream_id);
+      if (buffer) {
+        native_handle_close(buffer);
+        native_handle_delete(buffer);
+      }
+      return -EINVAL;
+    }
+  }
+  shared_ptr<Fence> acquire_fence = nullptr;
+  if (input_parcel->readInt32()) {
+    // The parcel owns the descriptor it read.
+    acquire_fence = Fence::Create(dup(input_parcel->readFileDescriptor()), "sideband");
+  }
+  int64_t present_time_ns = input_parcel->readInt64();
+
+  uint64_t frame_number = 0;
+  std::vector<SidebandRelease> released;
+  {
+    std::lock_guard<std::mutex> lock(sideband_lock_);
+    auto &queue = sideband_queues_[stream_id];
+    if (!queue) {
+      queue = std::make_shared<HWCSidebandQueue>(stream_id);
+    }
+    if (buffer) {
+      frame_number = queue->Queue(buffer, acquire_fence, present_time_ns);
+    } else {
+      queue->Flush();
+    }
+    queue->DequeueReleased(&released);
+    if (!buffer && queue.use_count() == 1) {
+      // Flushed with no layer bound, the stream was torn down.
+      sideband_queues_.erase(stream_id);
+    }
+  }
+
+  output_parcel->writeUint64(frame_number);
+  output_parcel->writeInt32(INT32(released.size()));
+  Fence::ScopedRef scoped_ref;
+  for (auto &release : released) {
+    output_parcel->writeUint64(release.frame_number);
+    output_parcel->writeInt32(release.release_fence != nullptr);
+    if (release.release_fence) {
+      output_parcel->writeDupFileDescriptor(scoped_ref.Get(release.release_fence));
+    }
+  }
+
+  return android::NO_ERROR;
+}
+
 void HWCSession::NotifyClientStatus(bool connected) {
   for (uint32_t i = 0; i < HWCCallbacks::kNumDisplays; i++) {
     if (!hwc_display_[i]) {
@@ -3503,7 +4228,7 @@ void HWCSession::WaitForResources(bool wait_for_resources, hwc2_display_t active
     bool res_wait = true;
     do {
       if (client_connected_) {
-        Refresh(active_builtin_id);
+        Refresh(active_builtin_id, kRefreshReasonResources);
       }
       {
         std::unique_lock<std::mutex> caller_lock(hotplug_mutex_);
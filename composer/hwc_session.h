@@ -27,6 +27,7 @@
 #include <utils/locker.h>
 #include <qd_utils.h>
 #include <display_config.h>
+#include <atomic>
 #include <vector>
 #include <queue>
 #include <utility>
@@ -42,6 +43,8 @@
 #include "hwc_display_dummy.h"
 #include "hwc_display_virtual.h"
 #include "hwc_display_pluggable_test.h"
+#include "hwc_perf_test.h"
+#include "hwc_warm_state.h"
 #include "hwc_color_manager.h"
 #include "hwc_socket_handler.h"
 #include "hwc_display_event_handler.h"
@@ -156,6 +159,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
       auto hwc_layer = hwc_display_[display]->GetHWCLayer(layer);
       if (hwc_layer != nullptr) {
         status = (hwc_layer->*member)(std::forward<Args>(args)...);
+        hwc_display_[display]->MarkClientUpdate();
         if (hwc_display_[display]->GetGeometryChanges()) {
           hwc_display_[display]->ResetValidation();
         }
@@ -237,6 +241,14 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   int32_t SetCursorPosition(hwc2_display_t display, hwc2_layer_t layer, int32_t x, int32_t y);
   int32_t GetDataspaceSaturationMatrix(int32_t /*Dataspace*/ int_dataspace, float *out_matrix);
   int32_t SetDisplayBrightnessScale(const android::Parcel *input_parcel);
+  int32_t SetSdrDimmingScale(const android::Parcel *input_parcel);
+  android::status_t SetDisplayParams(const android::Parcel *input_parcel);
+  android::status_t GetDisplayStatePage(const android::Parcel *input_parcel,
+                                        android::Parcel *output_parcel);
+  android::status_t GetDisplayEventChannel(const android::Parcel *input_parcel,
+                                           android::Parcel *output_parcel);
+  android::status_t QueueSidebandFrame(const android::Parcel *input_parcel,
+                                       android::Parcel *output_parcel);
   int32_t GetDisplayConnectionType(hwc2_display_t display, HwcDisplayConnectionType *type);
 
   // Layer functions
@@ -250,6 +262,8 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   int32_t SetLayerZOrder(hwc2_display_t display, hwc2_layer_t layer, uint32_t z);
   int32_t SetLayerType(hwc2_display_t display, hwc2_layer_t layer,
                        IQtiComposerClient::LayerType type);
+  int32_t SetLayerSidebandStream(hwc2_display_t display, hwc2_layer_t layer,
+                                 const native_handle_t *stream);
   int32_t SetLayerSurfaceDamage(hwc2_display_t display, hwc2_layer_t layer, hwc_region_t damage);
   int32_t SetLayerVisibleRegion(hwc2_display_t display, hwc2_layer_t layer, hwc_region_t damage);
   int32_t SetLayerCompositionType(hwc2_display_t display, hwc2_layer_t layer, int32_t int_type);
@@ -285,7 +299,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   int32_t GetDisplayConfigs(hwc2_display_t display, uint32_t *out_num_configs,
                             hwc2_config_t *out_configs);
   int32_t GetVsyncPeriod(hwc2_display_t disp, uint32_t *vsync_period);
-  void Refresh(hwc2_display_t display);
+  void Refresh(hwc2_display_t display, RefreshReason reason = kRefreshReasonOther);
 
   int32_t GetDisplayVsyncPeriod(hwc2_display_t display, VsyncPeriodNanos *out_vsync_period);
   int32_t SetActiveConfigWithConstraints(
@@ -297,7 +311,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   static Locker power_state_[HWCCallbacks::kNumDisplays];
   static Locker hdr_locker_[HWCCallbacks::kNumDisplays];
   static Locker display_config_locker_;
-  static Locker system_locker_;
+  static RwLocker system_locker_;  // Read by presents, written when displays are torn down.
 
  private:
   class CWB {
@@ -403,8 +417,25 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
     }
   };
 
+  // Bring-up cost of the display in a slot, as reported by the dump.
+  struct DisplayBringUp {
+    int32_t sdm_id = -1;
+    uint64_t start_ns = 0;    // Creation start, relative to HWCSession::Init
+    uint64_t create_ns = 0;   // Time spent creating the HWC and SDM display
+  };
+
+  // Heap allocations made by the validate and present calls of a display, see HWCAllocCounter.
+  struct FrameAllocations {
+    uint64_t pending = 0;          // Made by the validate of the frame not presented yet
+    uint64_t frames = 0;
+    uint64_t allocating_frames = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+  };
+
   static const int kExternalConnectionTimeoutMs = 500;
   static const int kCommitDoneTimeoutMs = 100;
+  static const int kMaxDsiClkConstraints = 32;
   uint32_t throttling_refresh_rate_ = 60;
   std::mutex hotplug_mutex_;
   std::condition_variable hotplug_cv_;
@@ -412,12 +443,16 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   void SetNewThrottlingRate(uint32_t new_rate);
 
   void ResetPanel();
+  void PreloadLibraries();
   void InitSupportedDisplaySlots();
   void InitSupportedNullDisplaySlots();
   int GetDisplayIndex(int dpy);
   int CreatePrimaryDisplay();
   void CreateDummyDisplay(hwc2_display_t client_id);
   int HandleBuiltInDisplays();
+  int CreateBuiltInDisplay(const HWDisplayInfo &info, DisplayMapInfo *map_info);
+  void RecordBringUp(hwc2_display_t client_id, int32_t sdm_id, uint64_t start_ns);
+  void AdoptWarmState(hwc2_display_t client_id, int32_t sdm_id);
   int HandlePluggableDisplays(bool delay_hotplug);
   int HandleConnectedDisplays(HWDisplaysInfo *hw_displays_info, bool delay_hotplug);
   int HandleDisconnectedDisplays(HWDisplaysInfo *hw_displays_info);
@@ -439,6 +474,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
                           uint32_t v_start, uint32_t v_end, uint32_t factor_in,
                           uint32_t factor_out);
   int ControlIdlePowerCollapse(bool enable, bool synchronous);
+  int ControlIdlePowerCollapseLocked(hwc2_display_t disp_id, bool enable, bool synchronous);
   int32_t SetDynamicDSIClock(int64_t disp_id, uint32_t bitrate);
   int32_t getDisplayBrightness(uint32_t display, float *brightness);
   int32_t setDisplayBrightness(uint32_t display, float brightness);
@@ -461,7 +497,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   android::status_t SetDisplayMode(const android::Parcel *input_parcel);
   android::status_t ConfigureRefreshRate(const android::Parcel *input_parcel);
   android::status_t QdcmCMDHandler(const android::Parcel *input_parcel,
-                                   android::Parcel *output_parcel);
+                                   android::Parcel *output_parcel, bool shared_payload);
   android::status_t QdcmCMDDispatch(uint32_t display_id,
                                     const PPDisplayAPIPayload &req_payload,
                                     PPDisplayAPIPayload *resp_payload,
@@ -485,6 +521,7 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   android::status_t GetDsiClk(const android::Parcel *input_parcel, android::Parcel *output_parcel);
   android::status_t GetSupportedDsiClk(const android::Parcel *input_parcel,
                                        android::Parcel *output_parcel);
+  android::status_t SetDsiClkConstraints(const android::Parcel *input_parcel);
   android::status_t SetFrameTriggerMode(const android::Parcel *input_parcel);
   android::status_t SetPanelLuminanceAttributes(const android::Parcel *input_parcel);
   android::status_t setColorSamplingEnabled(const android::Parcel *input_parcel);
@@ -493,9 +530,11 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   HWC2::Error ValidateDisplayInternal(hwc2_display_t display, uint32_t *out_num_types,
                                       uint32_t *out_num_requests);
   HWC2::Error PresentDisplayInternal(hwc2_display_t display);
-  void HandleSecureSession();
+  void HandleSecureSession(hwc2_display_t disp_id);
+  void CountFrameAllocations(hwc2_display_t display, uint64_t present_allocations);
   void HandlePendingPowerMode(hwc2_display_t display, const shared_ptr<Fence> &retire_fence);
   void HandlePendingHotplug(hwc2_display_t disp_id, const shared_ptr<Fence> &retire_fence);
+  void HandlePendingResourceHandoff(hwc2_display_t disp_id);
   bool IsPluggableDisplayConnected();
   hwc2_display_t GetActiveBuiltinDisplay();
   void HandlePendingRefresh();
@@ -539,16 +578,39 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   uint32_t idle_pc_ref_cnt_ = 0;
   int32_t disable_hotplug_bwcheck_ = 0;
   int32_t disable_mask_layer_hint_ = 0;
+  int32_t disable_sideband_stream_ = 0;
+  // Queues of tunneled video streams by stream id, shared with the layers bound to them. Created
+  // by whichever of the producer and the client comes first.
+  std::mutex sideband_lock_;
+  std::map<int32_t, std::shared_ptr<HWCSidebandQueue>> sideband_queues_;
   float set_max_lum_ = -1.0;
   float set_min_lum_ = -1.0;
+  Locker frame_state_locker_;  // Guards pending_refresh_ and display_ready_ across presents.
+  Locker resource_handoff_locker_;  // Guards pending_resource_handoff_.
+  // Pluggable displays created on hotplug, not reported to the client until the active built-in
+  // display has released the pipes they need.
+  std::vector<hwc2_display_t> pending_resource_handoff_;
   std::bitset<HWCCallbacks::kNumDisplays> pending_refresh_;
   CWB cwb_;
   std::weak_ptr<DisplayConfig::ConfigCallback> qsync_callback_;
   bool async_powermode_ = false;
   bool async_vds_creation_ = false;
+  bool async_display_init_ = false;
+  uint64_t init_start_ns_ = 0;
+  DisplayBringUp bring_up_[HWCCallbacks::kNumRealDisplays] = {};
+  FrameAllocations frame_allocations_[HWCCallbacks::kNumDisplays] = {};
+  HWCPerfTest perf_test_;   // Synthetic displays of the headless performance test mode
+  HWCWarmState warm_state_;  // Display state handed over to the next instance on a restart
   bool power_state_transition_[HWCCallbacks::kNumDisplays] = {};
   std::bitset<HWCCallbacks::kNumDisplays> display_ready_;
-  bool secure_session_active_ = false;
+  std::atomic<bool> secure_session_active_{false};
+  // Secure sessions last handed to every display. Stale after power mode changes, which the
+  // displays act on when applying a session.
+  std::bitset<kSecureMax> applied_secure_sessions_ = 0;
+  std::atomic<bool> secure_sessions_stale_{true};
+  // Client ids of the primary and built-in slots. Fixed once the slots are initialized, so the
+  // draw cycle can tell built-in displays apart without taking the display map locks.
+  std::bitset<HWCCallbacks::kNumDisplays> builtin_display_slots_;
 };
 }  // namespace sdm
 
@@ -167,7 +167,7 @@ int HWCSession::SetDisplayStatus(int disp_id, HWCDisplay::DisplayStatus status)
         SEQUENCE_WAIT_SCOPE_LOCK(locker_[active_builtin_disp_id]);
         hwc_display_[active_builtin_disp_id]->ResetValidation();
       }
-      callbacks_.Refresh(active_builtin_disp_id);
+      callbacks_.Refresh(active_builtin_disp_id, kRefreshReasonPowerMode);
     }
   }
 
@@ -259,7 +259,7 @@ int HWCSession::SetActiveConfigIndex(int disp_id, uint32_t config) {
   if (hwc_display_[disp_idx]) {
     error = hwc_display_[disp_idx]->SetActiveDisplayConfig(config);
     if (!error) {
-      callbacks_.Refresh(0);
+      callbacks_.Refresh(0, kRefreshReasonConfig);
     }
   }
 
@@ -355,7 +355,7 @@ int HWCSession::DisplayConfigImpl::MinHdcpEncryptionLevelChanged(DispType dpy,
 
 int HWCSession::DisplayConfigImpl::RefreshScreen() {
   SEQUENCE_WAIT_SCOPE_LOCK(hwc_session_->locker_[HWC_DISPLAY_PRIMARY]);
-  hwc_session_->callbacks_.Refresh(HWC_DISPLAY_PRIMARY);
+  hwc_session_->callbacks_.Refresh(HWC_DISPLAY_PRIMARY, kRefreshReasonClient);
   return 0;
 }
 
@@ -503,7 +503,7 @@ int HWCSession::SetCameraLaunchStatus(uint32_t on) {
   }
 
   // trigger invalidate to apply new bw caps.
-  callbacks_.Refresh(0);
+  callbacks_.Refresh(0, kRefreshReasonResources);
 
   return 0;
 }
@@ -540,6 +540,12 @@ int HWCSession::ControlIdlePowerCollapse(bool enable, bool synchronous) {
   }
   SEQUENCE_WAIT_SCOPE_LOCK(locker_[active_builtin_disp_id]);
 
+  return ControlIdlePowerCollapseLocked(active_builtin_disp_id, enable, synchronous);
+}
+
+int HWCSession::ControlIdlePowerCollapseLocked(hwc2_display_t active_builtin_disp_id, bool enable,
+                                               bool synchronous) {
+  // Caller holds the sequence lock of the active built-in display.
   if (hwc_display_[active_builtin_disp_id]) {
     if (!enable) {
       if (!idle_pc_ref_cnt_) {
@@ -548,7 +554,7 @@ int HWCSession::ControlIdlePowerCollapse(bool enable, bool synchronous) {
         if (err != kErrorNone) {
           return (err == kErrorNotSupported) ? 0 : -EINVAL;
         }
-        callbacks_.Refresh(active_builtin_disp_id);
+        callbacks_.Refresh(active_builtin_disp_id, kRefreshReasonPowerMode);
         int error = locker_[active_builtin_disp_id].WaitFinite(kCommitDoneTimeoutMs);
         if (error == ETIMEDOUT) {
           DLOGE("Timed out!! Next frame commit done event not received!!");
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "hwc_sideband_queue.h"
+
+namespace sdm {
+
+HWCSidebandQueue::~HWCSidebandQueue() {
+  Flush();
+  Release(&latched_, nullptr);
+  Release(&shown_, nullptr);
+}
+
+void HWCSidebandQueue::Release(Frame *frame, const shared_ptr<Fence> &release_fence) {
+  if (!frame->buffer) {
+    return;
+  }
+
+  SidebandRelease release;
+  release.frame_number = frame->frame_number;
+  release.release_fence = release_fence;
+  released_.push_back(release);
+  native_handle_close(frame->buffer);
+  native_handle_delete(frame->buffer);
+  *frame = Frame();
+}
+
+uint64_t HWCSidebandQueue::Queue(native_handle_t *buffer, const shared_ptr<Fence> &acquire_fence,
+                                 int64_t present_time_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (queue_.size() >= kMaxQueuedFrames) {
+    Release(&queue_.front(), nullptr);
+    queue_.pop_front();
+    dropped_++;
+  }
+
+  Frame frame;
+  frame.buffer = buffer;
+  frame.acquire_fence = acquire_fence;
+  frame.present_time_ns = present_time_ns;
+  frame.frame_number = next_frame_number_++;
+  queue_.push_back(frame);
+  queued_++;
+
+  return frame.frame_number;
+}
+
+void HWCSidebandQueue::Flush() {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto &frame : queue_) {
+    Release(&frame, nullptr);
+  }
+  queue_.clear();
+}
+
+bool HWCSidebandQueue::Latch(int64_t vsync_ns, int64_t vsync_period_ns, buffer_handle_t *buffer,
+                             shared_ptr<Fence> *acquire_fence) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // A frame committed now is seen from the next vsync on. Frames without a presentation time are
+  // shown as soon as possible.
+  int64_t target_ns = vsync_ns + vsync_period_ns;
+  int64_t due_ns = target_ns + vsync_period_ns / 2;
+  bool latched = false;
+  while (!queue_.empty() && queue_.front().present_time_ns <= due_ns) {
+    if (latched_.buffer) {
+      // Superseded before it was committed.
+      Release(&latched_, nullptr);
+      dropped_++;
+    }
+    latched_ = queue_.front();
+    queue_.pop_front();
+    latched = true;
+  }
+
+  if (!latched) {
+    repeated_ += !queue_.empty();
+    return false;
+  }
+
+  latched_.target_time_ns = target_ns;
+  latched_.late_ns = vsync_period_ns / 2;
+  *buffer = latched_.buffer;
+  *acquire_fence = latched_.acquire_fence;
+
+  return true;
+}
+
+void HWCSidebandQueue::OnCommitted(const shared_ptr<Fence> &release_fence) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!latched_.buffer) {
+    return;
+  }
+
+  if (latched_.present_time_ns) {
+    int64_t error_ns = latched_.target_time_ns - latched_.present_time_ns;
+    late_ += (error_ns > latched_.late_ns);
+    error_ns = std::abs(error_ns);
+    sync_error_ns_total_ += error_ns;
+    sync_error_ns_max_ = std::max(sync_error_ns_max_, error_ns);
+    timed_frames_++;
+  }
+
+  Release(&shown_, release_fence);
+  shown_ = latched_;
+  shown_.acquire_fence = nullptr;
+  latched_ = Frame();
+  shown_frames_++;
+}
+
+void HWCSidebandQueue::DequeueReleased(std::vector<SidebandRelease> *released) {
+  std::lock_guard<std::mutex> lock(lock_);
+  released->swap(released_);
+  released_.clear();
+}
+
+void HWCSidebandQueue::Dump(std::ostringstream *os) {
+  std::lock_guard<std::mutex> lock(lock_);
+  *os << "  stream " << stream_id_ << ": queued " << queued_ << " shown " << shown_frames_
+      << " dropped " << dropped_ << " late " << late_ << " repeated " << repeated_
+      << " pending " << queue_.size();
+  if (timed_frames_) {
+    int64_t average_ns = sync_error_ns_total_ / static_cast<int64_t>(timed_frames_);
+    *os << " sync error avg " << average_ns / 1000 << " us max "
+        << sync_error_ns_max_ / 1000 << " us";
+  }
+  *os << "\n";
+}
+
+}  // namespace sdm
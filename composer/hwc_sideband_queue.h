@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_SIDEBAND_QUEUE_H__
+#define __HWC_SIDEBAND_QUEUE_H__
+
+#include <cutils/native_handle.h>
+#include <utils/fence.h>
+
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace sdm {
+
+using std::shared_ptr;
+
+// Frame given back to the producer of a sideband stream. The buffer may be written again once
+// release_fence signals; frames dropped before they were shown have no fence.
+struct SidebandRelease {
+  uint64_t frame_number = 0;
+  shared_ptr<Fence> release_fence = nullptr;
+};
+
+// Queue of a tunneled video stream, e.g. of a TV tuner or a decoder rendering to a sideband layer.
+// The producer queues buffers with the time each should be seen at, and the display latches the
+// frame due at each vsync by itself, without the client composing the layer frame by frame.
+class HWCSidebandQueue {
+ public:
+  explicit HWCSidebandQueue(int32_t stream_id) : stream_id_(stream_id) {}
+  ~HWCSidebandQueue();
+  int32_t GetStreamId() const { return stream_id_; }
+  // Takes ownership of buffer. Returns the number the frame is released with later on.
+  uint64_t Queue(native_handle_t *buffer, const shared_ptr<Fence> &acquire_fence,
+                 int64_t present_time_ns);
+  // Drops the frames not shown yet, as on a seek of the producer.
+  void Flush();
+  // Picks the frame to show on the vsync after vsync_ns, the last one due before half a period
+  // past it. Frames due earlier are dropped. Returns false when the shown frame stays.
+  bool Latch(int64_t vsync_ns, int64_t vsync_period_ns, buffer_handle_t *buffer,
+             shared_ptr<Fence> *acquire_fence);
+  // The latched frame was committed, the one shown before it is released with release_fence.
+  void OnCommitted(const shared_ptr<Fence> &release_fence);
+  void DequeueReleased(std::vector<SidebandRelease> *released);
+  void Dump(std::ostringstream *os);
+
+ private:
+  struct Frame {
+    native_handle_t *buffer = nullptr;
+    shared_ptr<Fence> acquire_fence = nullptr;
+    int64_t present_time_ns = 0;
+    uint64_t frame_number = 0;
+    int64_t target_time_ns = 0;  // Of the vsync it was latched for.
+    int64_t late_ns = 0;  // Offset past which it missed its vsync.
+  };
+
+  // Frames of a producer that stopped being read are dropped past this depth.
+  static constexpr size_t kMaxQueuedFrames = 8;
+
+  void Release(Frame *frame, const shared_ptr<Fence> &release_fence);
+
+  const int32_t stream_id_;
+  std::mutex lock_;
+  std::deque<Frame> queue_;
+  Frame latched_;  // Set as the layer buffer, not committed yet.
+  Frame shown_;
+  std::vector<SidebandRelease> released_;
+  uint64_t next_frame_number_ = 1;
+  // A/V sync of the frames shown, against the vsync they were meant for.
+  uint64_t queued_ = 0;
+  uint64_t shown_frames_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t late_ = 0;
+  uint64_t repeated_ = 0;  // Vsyncs the shown frame stayed on while frames were queued.
+  uint64_t timed_frames_ = 0;  // Shown frames that had a presentation time.
+  int64_t sync_error_ns_total_ = 0;  // Absolute offset from the presentation time, summed.
+  int64_t sync_error_ns_max_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_SIDEBAND_QUEUE_H__
@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cutils/ashmem.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <utils/debug.h>
+
+#include "hwc_state_page.h"
+
+#define __CLASS__ "HWCStatePage"
+
+namespace sdm {
+
+int CreateReadOnlyRegion(const char *name, size_t size, void **base) {
+  int fd = ashmem_create_region(name, size);
+  if (fd < 0) {
+    DLOGE("Failed to create %s. Error %d '%s'.", name, errno, strerror(errno));
+    return -ENOMEM;
+  }
+
+  *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (*base == MAP_FAILED) {
+    DLOGE("Failed to map %s. Error %d '%s'.", name, errno, strerror(errno));
+    *base = nullptr;
+    close(fd);
+    return -ENOMEM;
+  }
+
+  // Later mappings, including those of clients, can only be read-only.
+  if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+    DLOGE("Failed to restrict %s. Error %d '%s'.", name, errno, strerror(errno));
+    munmap(*base, size);
+    *base = nullptr;
+    close(fd);
+    return -EPERM;
+  }
+
+  return fd;
+}
+
+int HWCStatePage::Init(const char *name) {
+  if (page_) {
+    return 0;
+  }
+
+  void *base = nullptr;
+  int fd = CreateReadOnlyRegion(name, static_cast<size_t>(getpagesize()), &base);
+  if (fd < 0) {
+    return fd;
+  }
+  fd_ = fd;
+  page_ = reinterpret_cast<DisplayStatePage *>(base);
+  page_->version = DISPLAY_STATE_PAGE_VERSION;
+
+  return 0;
+}
+
+void HWCStatePage::Deinit() {
+  if (page_) {
+    // Clients may keep their mapping, tell them the display is gone.
+    page_->version = 0;
+    BumpConfigGeneration();
+    munmap(page_, static_cast<size_t>(getpagesize()));
+    page_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace sdm
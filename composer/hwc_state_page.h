@@ -0,0 +1,73 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_STATE_PAGE_H__
+#define __HWC_STATE_PAGE_H__
+
+#include <display_state_page.h>
+
+#include <atomic>
+
+namespace sdm {
+
+// Creates an ashmem region mapped writable in the composer and restricted to read-only mappings
+// afterwards. Returns the region fd, or a negative errno.
+int CreateReadOnlyRegion(const char *name, size_t size, void **base);
+
+// Owner and writer of the DisplayStatePage of a display. The page is shared as an ashmem region
+// restricted to read-only mappings, so clients can map it but never write to it.
+class HWCStatePage {
+ public:
+  ~HWCStatePage() { Deinit(); }
+  int Init(const char *name);
+  void Deinit();
+  int GetFd() const { return fd_; }
+
+  // Updates of the page are bracketed by these, from a single writer.
+  DisplayStatePage *BeginUpdate() {
+    page_->sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return page_;
+  }
+  void EndUpdate() { page_->sequence.fetch_add(1, std::memory_order_release); }
+  // May be called from any thread.
+  void BumpConfigGeneration() {
+    if (page_) {
+      page_->config_generation.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+ private:
+  int fd_ = -1;
+  DisplayStatePage *page_ = nullptr;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_STATE_PAGE_H__
@@ -92,6 +92,14 @@ void ToneMapSession::OnTask(const ToneMapTaskCode &task_code,
       }
       break;
 
+    case ToneMapTaskCode::kCodeBatchBlit: {
+        ToneMapBatchBlitContext *ctx = static_cast<ToneMapBatchBlitContext *>(task_context);
+        int fence = gpu_tone_mapper_->blit(INT(ctx->dst_hnds.size()), ctx->dst_hnds.data(),
+                                           ctx->src_hnds.data(), Fence::Dup(ctx->merged));
+        ctx->fence = Fence::Create(fence, "tonemap_batch");
+      }
+      break;
+
     case ToneMapTaskCode::kCodeDestroy: {
         delete gpu_tone_mapper_;
       }
@@ -112,7 +120,7 @@ DisplayError ToneMapSession::AllocateIntermediateBuffers(const Layer *layer) {
     buffer_info.buffer_config.format = layer->request.format;
     buffer_info.buffer_config.secure = layer->request.flags.secure;
     buffer_info.buffer_config.gfx_client = true;
-    error = buffer_allocator_->AllocateBuffer(&buffer_info);
+    error = buffer_allocator_->AllocatePooledBuffer(&buffer_info);
     if (error != kErrorNone) {
       FreeIntermediateBuffers();
       return error;
@@ -126,7 +134,7 @@ void ToneMapSession::FreeIntermediateBuffers() {
   for (uint8_t i = 0; i < kNumIntermediateBuffers; i++) {
     BufferInfo &buffer_info = buffer_info_[i];
     if (buffer_info.private_data) {
-      buffer_allocator_->FreeBuffer(&buffer_info);
+      buffer_allocator_->ReleasePooledBuffer(&buffer_info);
     }
   }
 }
@@ -167,12 +175,36 @@ bool ToneMapSession::IsSameToneMapConfig(Layer *layer, PrimariesTransfer blend_c
           (layer->request.height == UINT32(handle->unaligned_height)));
 }
 
+bool ToneMapSession::CanBatchWith(const ToneMapSession &session) {
+  // Intermediate buffer size and format are per draw, only the LUT and program must match.
+  const ToneMapConfig &config = session.tone_map_config_;
+
+  return ((config.type == tone_map_config_.type) &&
+          (config.blend_cs == tone_map_config_.blend_cs) &&
+          (config.transfer == tone_map_config_.transfer) &&
+          (config.secure == tone_map_config_.secure));
+}
+
+void ToneMapSession::SetCachedOutput(const Layer *layer, const shared_ptr<Fence> &fence) {
+  cached_src_id_ = layer->input_buffer.handle_id;
+  cached_fence_ = fence;
+}
+
+bool ToneMapSession::HasCachedOutput(const Layer *layer) {
+  // A resubmitted buffer that the client did not update still holds the content tonemapped into
+  // the current intermediate buffer. Single buffered layers are always reported as updating.
+  return (cached_src_id_ && (layer->input_buffer.handle_id == cached_src_id_) &&
+          !layer->flags.updating);
+}
+
 int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
   uint32_t gpu_count = 0;
   DisplayError error = kErrorNone;
+  std::vector<ToneMapJob> jobs;
 
   for (uint32_t i = 0; i < layer_stack->layers.size(); i++) {
     uint32_t session_index = 0;
+    bool cached = false;
     Layer *layer = layer_stack->layers.at(i);
     if (layer->composition == kCompositionGPU) {
       gpu_count++;
@@ -192,14 +224,15 @@ int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
             fb_tone_map_session->UpdateBuffer(nullptr /* acquire_fence */, &layer->input_buffer);
             fb_tone_map_session->layer_index_ = INT(i);
             fb_tone_map_session->acquired_ = true;
+            ToneMap(jobs);
             return 0;
           }
         }
-        error = AcquireToneMapSession(layer, &session_index, layer_stack->blend_cs);
+        error = AcquireToneMapSession(layer, &session_index, layer_stack->blend_cs, &cached);
         fb_session_index_ = INT(session_index);
         break;
       default:
-        error = AcquireToneMapSession(layer, &session_index, layer_stack->blend_cs);
+        error = AcquireToneMapSession(layer, &session_index, layer_stack->blend_cs, &cached);
         break;
       }
 
@@ -209,15 +242,47 @@ int HWCToneMapper::HandleToneMap(LayerStack *layer_stack) {
       }
 
       ToneMapSession *session = tone_map_sessions_.at(session_index);
-      ToneMap(layer, session);
+      if (cached) {
+        DLOGV_IF(kTagClient, "Reusing tonemap output of session %d", session_index);
+        session->UpdateBuffer(session->cached_fence_, &layer->input_buffer);
+      } else {
+        jobs.push_back(std::make_pair(layer, session));
+      }
       DLOGI_IF(kTagClient, "Layer %d associated with session index %d", i, session_index);
       session->layer_index_ = INT(i);
     }
   }
 
+  ToneMap(jobs);
+
   return 0;
 }
 
+void HWCToneMapper::ToneMap(const std::vector<ToneMapJob> &jobs) {
+  // Layers whose sessions share a tonemap program are drawn in one pass on the first session's
+  // context, rather than binding a context and creating a fence per layer.
+  std::vector<bool> done(jobs.size(), false);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (done[i]) {
+      continue;
+    }
+
+    std::vector<ToneMapJob> batch = { jobs[i] };
+    for (size_t j = i + 1; j < jobs.size(); j++) {
+      if (!done[j] && jobs[i].second->CanBatchWith(*jobs[j].second)) {
+        batch.push_back(jobs[j]);
+        done[j] = true;
+      }
+    }
+
+    if (batch.size() == 1) {
+      ToneMap(batch[0].first, batch[0].second);
+    } else {
+      ToneMapBatch(batch);
+    }
+  }
+}
+
 void HWCToneMapper::ToneMap(Layer* layer, ToneMapSession *session) {
   ToneMapBlitContext ctx = {};
   ctx.layer = layer;
@@ -234,9 +299,37 @@ void HWCToneMapper::ToneMap(Layer* layer, ToneMapSession *session) {
   DTRACE_END();
 
   DumpToneMapOutput(session, ctx.fence);
+  session->SetCachedOutput(layer, ctx.fence);
   session->UpdateBuffer(ctx.fence, &layer->input_buffer);
 }
 
+void HWCToneMapper::ToneMapBatch(const std::vector<ToneMapJob> &jobs) {
+  ToneMapBatchBlitContext ctx = {};
+  std::vector<shared_ptr<Fence>> fences;
+
+  for (auto &job : jobs) {
+    Layer *layer = job.first;
+    ToneMapSession *session = job.second;
+    uint8_t buffer_index = session->current_buffer_index_;
+    ctx.src_hnds.push_back(reinterpret_cast<const void *>(layer->input_buffer.buffer_id));
+    ctx.dst_hnds.push_back(session->buffer_info_[buffer_index].private_data);
+    fences.push_back(session->release_fence_[buffer_index]);
+    fences.push_back(layer->input_buffer.acquire_fence);
+  }
+
+  ctx.merged = Fence::Merge(fences, true /* ignore_signaled */);
+
+  DTRACE_BEGIN("GPU_TM_BATCH_BLIT");
+  jobs[0].second->tone_map_task_.PerformTask(ToneMapTaskCode::kCodeBatchBlit, &ctx);
+  DTRACE_END();
+
+  for (auto &job : jobs) {
+    DumpToneMapOutput(job.second, ctx.fence);
+    job.second->SetCachedOutput(job.first, ctx.fence);
+    job.second->UpdateBuffer(ctx.fence, &job.first->input_buffer);
+  }
+}
+
 void HWCToneMapper::PostCommit(LayerStack *layer_stack) {
   auto it = tone_map_sessions_.begin();
   while (it != tone_map_sessions_.end()) {
@@ -274,6 +367,17 @@ void HWCToneMapper::Terminate() {
   }
 }
 
+size_t HWCToneMapper::GetMemoryUsage() {
+  size_t bytes = 0;
+  for (auto &session : tone_map_sessions_) {
+    for (auto &buffer_info : session->buffer_info_) {
+      bytes += buffer_info.alloc_buffer_info.size;
+    }
+  }
+
+  return bytes;
+}
+
 void HWCToneMapper::SetFrameDumpConfig(uint32_t count) {
   DLOGI("Dump FrameConfig count = %d", count);
   dump_frame_count_ = count;
@@ -313,7 +417,7 @@ void HWCToneMapper::DumpToneMapOutput(ToneMapSession *session, shared_ptr<Fence>
 }
 
 DisplayError HWCToneMapper::AcquireToneMapSession(Layer *layer, uint32_t *session_index,
-                                                  PrimariesTransfer blend_cs) {
+                                                  PrimariesTransfer blend_cs, bool *cached) {
   // When the property vendor.display.disable_hdr_lut_gen is set, the lutEntries and gridEntries in
   // the Lut3d will be NULL, clients needs to allocate the memory and set correct 3D Lut
   // for Tonemapping.
@@ -323,6 +427,19 @@ DisplayError HWCToneMapper::AcquireToneMapSession(Layer *layer, uint32_t *sessio
     return kErrorParameters;
   }
 
+  // Check if an existing tone map session already holds this buffer tonemapped. Its current
+  // intermediate buffer is kept, so no GPU work is needed.
+  for (uint32_t i = 0; i < tone_map_sessions_.size(); i++) {
+    ToneMapSession *tonemap_session = tone_map_sessions_.at(i);
+    if (!tonemap_session->acquired_ && tonemap_session->IsSameToneMapConfig(layer, blend_cs) &&
+        tonemap_session->HasCachedOutput(layer)) {
+      tonemap_session->acquired_ = true;
+      *session_index = i;
+      *cached = true;
+      return kErrorNone;
+    }
+  }
+
   // Check if we can re-use an existing tone map session.
   for (uint32_t i = 0; i < tone_map_sessions_.size(); i++) {
     ToneMapSession *tonemap_session = tone_map_sessions_.at(i);
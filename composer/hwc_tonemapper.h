@@ -38,9 +38,11 @@
 #include <core/layer_stack.h>
 #include <utils/sys.h>
 #include <utils/sync_task.h>
+#include <utility>
 #include <vector>
 #include "hwc_buffer_sync_handler.h"
 #include "hwc_buffer_allocator.h"
+#include "hwc_gpu_worker.h"
 
 class Tonemapper;
 
@@ -49,6 +51,7 @@ namespace sdm {
 enum class ToneMapTaskCode : int32_t {
   kCodeGetInstance,
   kCodeBlit,
+  kCodeBatchBlit,
   kCodeDestroy,
 };
 
@@ -62,6 +65,13 @@ struct ToneMapBlitContext : public SyncTask<ToneMapTaskCode>::TaskContext {
   shared_ptr<Fence> fence = nullptr;
 };
 
+struct ToneMapBatchBlitContext : public SyncTask<ToneMapTaskCode>::TaskContext {
+  std::vector<const void *> src_hnds = {};
+  std::vector<const void *> dst_hnds = {};
+  shared_ptr<Fence> merged = nullptr;
+  shared_ptr<Fence> fence = nullptr;
+};
+
 struct ToneMapConfig {
   int type = 0;
   PrimariesTransfer blend_cs = {};
@@ -80,13 +90,16 @@ class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
   void SetReleaseFence(const shared_ptr<Fence> &fd);
   void SetToneMapConfig(Layer *layer, PrimariesTransfer blend_cs);
   bool IsSameToneMapConfig(Layer *layer, PrimariesTransfer blend_cs);
+  bool CanBatchWith(const ToneMapSession &session);
+  void SetCachedOutput(const Layer *layer, const shared_ptr<Fence> &fence);
+  bool HasCachedOutput(const Layer *layer);
 
   // TaskHandler methods implementation.
   virtual void OnTask(const ToneMapTaskCode &task_code,
                       SyncTask<ToneMapTaskCode>::TaskContext *task_context);
 
   static const uint8_t kNumIntermediateBuffers = 2;
-  SyncTask<ToneMapTaskCode> tone_map_task_;
+  HWCGPUTask<ToneMapTaskCode> tone_map_task_;
   Tonemapper *gpu_tone_mapper_ = nullptr;
   HWCBufferAllocator *buffer_allocator_ = nullptr;
   ToneMapConfig tone_map_config_ = {};
@@ -95,6 +108,9 @@ class ToneMapSession : public SyncTask<ToneMapTaskCode>::TaskHandler {
   shared_ptr<Fence> release_fence_[kNumIntermediateBuffers] = {nullptr, nullptr};
   bool acquired_ = false;
   int layer_index_ = -1;
+  // Source buffer tonemapped into the current intermediate buffer, and the GPU fence of that blit.
+  uint64_t cached_src_id_ = 0;
+  shared_ptr<Fence> cached_fence_ = nullptr;
 };
 
 class HWCToneMapper {
@@ -104,13 +120,19 @@ class HWCToneMapper {
 
   int HandleToneMap(LayerStack *layer_stack);
   bool IsActive() { return !tone_map_sessions_.empty(); }
+  size_t GetMemoryUsage();  // Bytes of intermediate buffers held by the sessions
   void PostCommit(LayerStack *layer_stack);
   void SetFrameDumpConfig(uint32_t count);
   void Terminate();
 
  private:
+  typedef std::pair<Layer *, ToneMapSession *> ToneMapJob;
+
   void ToneMap(Layer *layer, ToneMapSession *session);
-  DisplayError AcquireToneMapSession(Layer *layer, uint32_t *sess_idx, PrimariesTransfer blend_cs);
+  void ToneMap(const std::vector<ToneMapJob> &jobs);
+  void ToneMapBatch(const std::vector<ToneMapJob> &jobs);
+  DisplayError AcquireToneMapSession(Layer *layer, uint32_t *sess_idx, PrimariesTransfer blend_cs,
+                                     bool *cached);
   void DumpToneMapOutput(ToneMapSession *session, shared_ptr<sdm::Fence> acquire_fence);
 
   std::vector<ToneMapSession*> tone_map_sessions_;
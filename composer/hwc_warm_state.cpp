@@ -0,0 +1,192 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <utils/debug.h>
+
+#include "hwc_debugger.h"
+#include "hwc_warm_state.h"
+
+#define __CLASS__ "HWCWarmState"
+
+namespace sdm {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Sequence must be a plain word");
+
+static bool ReadBootId(char *boot_id, size_t size) {
+  int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  memset(boot_id, 0, size);
+  ssize_t length = read(fd, boot_id, size - 1);
+  close(fd);
+
+  return length > 0;
+}
+
+int HWCWarmState::Init() {
+  if (page_) {
+    return 0;
+  }
+
+  char boot_id[kBootIdLength] = {};
+  if (!ReadBootId(boot_id, sizeof(boot_id))) {
+    DLOGW("Unable to read the boot id. Error %d '%s'.", errno, strerror(errno));
+    return -ENOENT;
+  }
+
+  std::string path = std::string(HWCDebugHandler::DumpDir()) + "/warm_state.bin";
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+  if (fd < 0) {
+    DLOGW("Unable to open %s. Error %d '%s'.", path.c_str(), errno, strerror(errno));
+    return -errno;
+  }
+
+  size_t size = static_cast<size_t>(getpagesize());
+  static_assert(sizeof(Page) <= 4096, "Warm state must fit in a page");
+  struct stat st = {};
+  if (fstat(fd, &st) || (st.st_size < off_t(size) && ftruncate(fd, off_t(size)))) {
+    DLOGW("Unable to size %s. Error %d '%s'.", path.c_str(), errno, strerror(errno));
+    close(fd);
+    return -EIO;
+  }
+
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    DLOGW("Unable to map %s. Error %d '%s'.", path.c_str(), errno, strerror(errno));
+    return -ENOMEM;
+  }
+  page_ = reinterpret_cast<Page *>(base);
+
+  // Only a restart within the same boot adopts the state, the displays are reset across boots.
+  if (page_->magic == kMagic && page_->version == kVersion &&
+      !strncmp(page_->boot_id, boot_id, kBootIdLength)) {
+    for (int i = 0; i < HWCCallbacks::kNumDisplays; i++) {
+      auto &slot = page_->displays[i];
+      auto &previous = previous_[i];
+      // A slot the previous instance died in the middle of updating is not trusted.
+      uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+      previous.sdm_id = (sequence & 1) ? -1 : slot.sdm_id;
+      previous.active_config = slot.active_config;
+      previous.color_mode = slot.color_mode;
+      previous.render_intent = slot.render_intent;
+      previous.has_brightness = slot.has_brightness;
+      previous.brightness = slot.brightness;
+      has_previous_ |= (previous.sdm_id >= 0);
+    }
+  }
+
+  memset(reinterpret_cast<void *>(page_), 0, sizeof(Page));
+  page_->magic = kMagic;
+  page_->version = kVersion;
+  memcpy(page_->boot_id, boot_id, kBootIdLength);
+  for (auto &slot : page_->displays) {
+    slot.sdm_id = -1;
+  }
+
+  DLOGI("Display state of a previous instance %sfound", has_previous_ ? "" : "not ");
+
+  return 0;
+}
+
+void HWCWarmState::Deinit() {
+  if (!page_) {
+    return;
+  }
+
+  // Nothing to adopt after a clean shutdown.
+  page_->magic = 0;
+  munmap(page_, static_cast<size_t>(getpagesize()));
+  page_ = nullptr;
+}
+
+bool HWCWarmState::GetPrevious(hwc2_display_t client_id, int32_t sdm_id,
+                               HWCWarmDisplayState *state) {
+  if (!has_previous_ || client_id >= HWCCallbacks::kNumDisplays) {
+    return false;
+  }
+
+  auto &previous = previous_[client_id];
+  if (previous.sdm_id < 0 || previous.sdm_id != sdm_id) {
+    return false;
+  }
+
+  state->sdm_id = previous.sdm_id;
+  state->active_config = previous.active_config;
+  state->color_mode = previous.color_mode;
+  state->render_intent = previous.render_intent;
+  state->has_brightness = previous.has_brightness;
+  state->brightness = previous.brightness;
+  // Adopted once, a display created again later starts from its defaults.
+  previous.sdm_id = -1;
+
+  return true;
+}
+
+HWCWarmDisplayState *HWCWarmState::Acquire(hwc2_display_t client_id, int32_t sdm_id) {
+  if (!page_ || client_id >= HWCCallbacks::kNumDisplays) {
+    return nullptr;
+  }
+
+  auto *slot = &page_->displays[client_id];
+  BeginUpdate(slot);
+  slot->sdm_id = sdm_id;
+  slot->active_config = -1;
+  slot->color_mode = -1;
+  slot->render_intent = 0;
+  slot->has_brightness = 0;
+  slot->brightness = 0.0f;
+  EndUpdate(slot);
+
+  return slot;
+}
+
+void HWCWarmState::Release(hwc2_display_t client_id) {
+  if (!page_ || client_id >= HWCCallbacks::kNumDisplays) {
+    return;
+  }
+
+  auto *slot = &page_->displays[client_id];
+  BeginUpdate(slot);
+  slot->sdm_id = -1;
+  EndUpdate(slot);
+}
+
+}  // namespace sdm
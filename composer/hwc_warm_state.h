@@ -0,0 +1,100 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_WARM_STATE_H__
+#define __HWC_WARM_STATE_H__
+
+#include <hardware/hwcomposer2.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "hwc_callbacks.h"
+
+namespace sdm {
+
+// Last state of a display, kept where a restarted composer can find it. The sequence is odd
+// while an update is in progress, like in DisplayStatePage.
+struct HWCWarmDisplayState {
+  std::atomic<uint32_t> sequence;
+  int32_t sdm_id;         // -1 when the slot is unused
+  int32_t active_config;  // HWC2 config, -1 when unknown
+  int32_t color_mode;     // -1 when unknown
+  int32_t render_intent;
+  uint32_t has_brightness;
+  float brightness;
+};
+
+// Keeps the active config, color mode and brightness of each display in a file mapped shared,
+// so that its contents outlive the composer process. When the composer service restarts within
+// the same boot, the new instance adopts the state the previous one left behind so displays come
+// back the way the client last set them, instead of in their defaults until the client catches
+// up. A clean shutdown clears the state.
+class HWCWarmState {
+ public:
+  ~HWCWarmState() { Deinit(); }
+  int Init();
+  void Deinit();
+
+  // State left by the previous instance for the display, if it was the same SDM display.
+  bool GetPrevious(hwc2_display_t client_id, int32_t sdm_id, HWCWarmDisplayState *state);
+  // Slot of the display for this instance, reset for the given SDM display.
+  HWCWarmDisplayState *Acquire(hwc2_display_t client_id, int32_t sdm_id);
+  void Release(hwc2_display_t client_id);
+
+  // Updates of a slot are bracketed by these, from a single writer at a time.
+  static void BeginUpdate(HWCWarmDisplayState *state) {
+    state->sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  static void EndUpdate(HWCWarmDisplayState *state) {
+    state->sequence.fetch_add(1, std::memory_order_release);
+  }
+
+ private:
+  static const uint32_t kMagic = 0x4857534d;  // "HWSM"
+  static const uint32_t kVersion = 1;
+  static const size_t kBootIdLength = 40;
+
+  struct Page {
+    uint32_t magic;
+    uint32_t version;
+    char boot_id[kBootIdLength];
+    HWCWarmDisplayState displays[HWCCallbacks::kNumDisplays];
+  };
+
+  Page *page_ = nullptr;
+  // Copy of the page as the previous instance left it, invalid when there was none.
+  HWCWarmDisplayState previous_[HWCCallbacks::kNumDisplays] = {};
+  bool has_previous_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_WARM_STATE_H__
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, 2019 The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2017, 2019-2020 The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -49,10 +49,12 @@ EGLImageBuffer::EGLImageBuffer(android::sp<android::GraphicBuffer> graphicBuffer
   this->eglImageID = create_eglImage(graphicBuffer);
   this->width = graphicBuffer->getWidth();
   this->height = graphicBuffer->getHeight();
+  this->format = graphicBuffer->getPixelFormat();
 
   textureID = 0;
   renderbufferID = 0;
   framebufferID = 0;
+  imageTextureID = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -74,6 +76,11 @@ EGLImageBuffer::~EGLImageBuffer()
     framebufferID = 0;
   }
 
+  if (imageTextureID != 0) {
+    GL(glDeleteTextures(1, &imageTextureID));
+    imageTextureID = 0;
+  }
+
   // Delete the eglImage
   if (eglImageID != 0)
   {
@@ -118,6 +125,19 @@ unsigned int EGLImageBuffer::getFramebuffer()
   return framebufferID;
 }
 
+//-----------------------------------------------------------------------------
+unsigned int EGLImageBuffer::getImageTexture()
+//-----------------------------------------------------------------------------
+{
+  if ((imageTextureID == 0) && (format == HAL_PIXEL_FORMAT_RGBA_8888)) {
+    GL(glGenTextures(1, &imageTextureID));
+    GL(glBindTexture(GL_TEXTURE_2D, imageTextureID));
+    GL(glEGLImageTargetTexStorageEXT(GL_TEXTURE_2D, eglImageID, NULL));
+  }
+
+  return imageTextureID;
+}
+
 //-----------------------------------------------------------------------------
 void EGLImageBuffer::bindAsTexture(int target)
 //-----------------------------------------------------------------------------
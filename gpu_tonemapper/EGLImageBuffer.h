@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016, 2019 The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016, 2019-2020 The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -33,6 +33,8 @@ class EGLImageBuffer {
   uint textureID;
   uint renderbufferID;
   uint framebufferID;
+  uint imageTextureID;
+  int format;
 
  public:
   int getWidth();
@@ -40,6 +42,8 @@ class EGLImageBuffer {
   EGLImageBuffer(android::sp<android::GraphicBuffer>);
   unsigned int getTexture(int target);
   unsigned int getFramebuffer();
+  // Storage texture for compute image stores, 0 if the format is not an ES 3.1 image format.
+  unsigned int getImageTexture();
   void bindAsTexture(int target);
   void bindAsFramebuffer();
   ~EGLImageBuffer();
@@ -22,52 +22,15 @@
 #include <gralloc_priv.h>
 #include <qdMetaData.h>
 #include <ui/GraphicBuffer.h>
-#include <fcntl.h>
-#include <string>
-#include <map>
-#include <utility>
-
-using std::string;
-using std::map;
-using std::pair;
-
-static string pidString = std::to_string(getpid());
 
 //-----------------------------------------------------------------------------
-static string get_ion_buff_str(int buff_fd)
-//-----------------------------------------------------------------------------
-{
-  string retStr = {};
-  if (buff_fd >= 0) {
-    string fdString = std::to_string(buff_fd);
-    string symlinkPath = "/proc/"+pidString+"/fd/"+fdString;
-    char buffer[1024] = {};
-    ssize_t ret = ::readlink(symlinkPath.c_str(), buffer, sizeof(buffer) - 1);
-    if (ret != -1) {
-      buffer[ret] = '\0';
-      retStr = buffer;
-    }
-  }
-
-  return retStr;
-}
-
-//-----------------------------------------------------------------------------
-void EGLImageWrapper::DeleteEGLImageCallback::operator()(int& buffInt, EGLImageBuffer*& eglImage)
+void EGLImageWrapper::DeleteEGLImageCallback::operator()(uint64_t& /* buffId */,
+                                                         EGLImageBuffer*& eglImage)
 //-----------------------------------------------------------------------------
 {
   if (eglImage != 0) {
     delete eglImage;
   }
-
-  if (!mapClearPending) {
-    for (auto it = buffStrbuffIntMapPtr->begin(); it != buffStrbuffIntMapPtr->end(); it++) {
-      if (it->second == buffInt /* counter */) {
-        buffStrbuffIntMapPtr->erase(it);
-        return;
-      }
-    }
-  }
 }
 
 //-----------------------------------------------------------------------------
@@ -88,8 +51,8 @@ EGLImageWrapper::~EGLImageWrapper()
 void EGLImageWrapper::Init()
 //-----------------------------------------------------------------------------
 {
-  eglImageBufferCache = new android::LruCache<int, EGLImageBuffer*>(32);
-  callback = new DeleteEGLImageCallback(&buffStrbuffIntMap);
+  eglImageBufferCache = new android::LruCache<uint64_t, EGLImageBuffer*>(32);
+  callback = new DeleteEGLImageCallback();
   eglImageBufferCache->setOnEntryRemovedListener(callback);
 }
 
@@ -98,13 +61,9 @@ void EGLImageWrapper::Deinit()
 //-----------------------------------------------------------------------------
 {
   if (eglImageBufferCache != 0) {
-    if (callback != 0) {
-      callback->mapClearPending = true;
-    }
     eglImageBufferCache->clear();
     delete eglImageBufferCache;
     eglImageBufferCache = 0;
-    buffStrbuffIntMap.clear();
   }
 
   if (callback != 0) {
@@ -161,20 +120,17 @@ EGLImageBuffer *EGLImageWrapper::wrap(const void *pvt_handle)
 {
   const private_handle_t *src = static_cast<const private_handle_t *>(pvt_handle);
 
-  string buffStr = get_ion_buff_str(src->fd);
-  EGLImageBuffer* eglImage = nullptr;
-  if (!buffStr.empty()) {
-    auto it = buffStrbuffIntMap.find(buffStr);
-    if (it != buffStrbuffIntMap.end()) {
-      eglImage = eglImageBufferCache->get(it->second);
-    } else {
-        eglImage = L_wrap(src);
-        buffStrbuffIntMap.insert(pair<string, int>(buffStr, buffInt));
-        eglImageBufferCache->put(buffInt, eglImage);
-        buffInt++;
-    }
-  } else {
-    ALOGE("Could not provide an eglImage for fd = %d, EGLImageWrapper = %p", src->fd, this);
+  if (!src) {
+    ALOGE("Could not provide an eglImage for a null handle, EGLImageWrapper = %p", this);
+    return nullptr;
+  }
+
+  // The unique id survives re-import and dup'd fds, so it identifies the backing allocation
+  // without resolving the fd through procfs on every blit.
+  EGLImageBuffer* eglImage = eglImageBufferCache->get(src->id);
+  if (eglImage == nullptr) {
+    eglImage = L_wrap(src);
+    eglImageBufferCache->put(src->id, eglImage);
   }
 
   return eglImage;
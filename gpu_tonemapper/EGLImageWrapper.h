@@ -21,28 +21,20 @@
 #define __TONEMAPPER_EGLIMAGEWRAPPER_H__
 
 #include <utils/LruCache.h>
-#include <string>
-#include <map>
 #include <gr_utils.h>
 #include "EGLImageBuffer.h"
 
-using std::string;
-using std::map;
-
 class EGLImageWrapper {
  private:
-  class DeleteEGLImageCallback : public android::OnEntryRemoved<int, EGLImageBuffer*> {
+  // Evicted entries own their EGLImage along with the texture/FBO bound to it.
+  class DeleteEGLImageCallback : public android::OnEntryRemoved<uint64_t, EGLImageBuffer*> {
    public:
-     explicit DeleteEGLImageCallback(map<string, int>* mapPtr) { buffStrbuffIntMapPtr = mapPtr; }
-     void operator()(int& buffInt, EGLImageBuffer*& eglImage);
-     map<string, int>* buffStrbuffIntMapPtr = nullptr;
-     bool mapClearPending = false;
+     void operator()(uint64_t& buffId, EGLImageBuffer*& eglImage);
   };
 
-  android::LruCache<int, EGLImageBuffer *>* eglImageBufferCache;
-  map<string, int> buffStrbuffIntMap = {};
+  // Keyed on the gralloc unique buffer id (private_handle_t::id).
+  android::LruCache<uint64_t, EGLImageBuffer *>* eglImageBufferCache;
   DeleteEGLImageCallback* callback = 0;
-  uint64_t buffInt = 0;
 
  public:
   EGLImageWrapper();
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2017, 2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -30,5 +30,11 @@ Tonemapper *TonemapperFactory_GetInstance(int type, void *colorMap, int colorMap
   // build the tonemapper
   Tonemapper *tonemapper = Tonemapper::build(type, colorMap, colorMapSize, lutXform, lutXformSize, isSecure);
 
+  // prefer the compute variant for forward tonemapping of non-secure content
+  if (tonemapper && (type == TONEMAP_FORWARD) && !isSecure) {
+    bool compute = tonemapper->enableCompute();
+    ALOGI("%s: compute tonemapper %s", __FUNCTION__, compute ? "enabled" : "not supported");
+  }
+
   return tonemapper;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2019, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -22,6 +22,7 @@
 #include "Tonemapper.h"
 #include "engine.h"
 #include "forward_tonemap.inl"
+#include "forward_tonemap_compute.inl"
 #include "fullscreen_vertex_shader.inl"
 #include "rgba_inverse_tonemap.inl"
 
@@ -32,6 +33,7 @@ Tonemapper::Tonemapper()
   tonemapTexture = 0;
   lutXformTexture = 0;
   programID = 0;
+  computeProgramID = 0;
   eglImageWrapper = new EGLImageWrapper();
 
   lutXformScaleOffset[0] = 1.0f;
@@ -49,6 +51,7 @@ Tonemapper::~Tonemapper()
   engine_deleteInputBuffer(tonemapTexture);
   engine_deleteInputBuffer(lutXformTexture);
   engine_deleteProgram(programID);
+  engine_deleteProgram(computeProgramID);
 
   // clear EGLImage mappings
   if (eglImageWrapper != 0) {
@@ -116,18 +119,40 @@ Tonemapper *Tonemapper::build(int type, void *colorMap, int colorMapSize, void *
 }
 
 //-----------------------------------------------------------------------------
-int Tonemapper::blit(const void *dst, const void *src, int srcFenceFd)
+bool Tonemapper::enableCompute()
 //-----------------------------------------------------------------------------
 {
-  // make current
   engine_bind(engineContext);
 
-  // create eglimages if required
-  EGLImageBuffer *dst_buffer = eglImageWrapper->wrap(dst);
-  EGLImageBuffer *src_buffer = eglImageWrapper->wrap(src);
+  if (!engine_supportsCompute()) {
+    return false;
+  }
+
+  const char *computeShaders[3];
+  int computeShaderCount = 0;
+  const char *version = "#version 310 es\n";
+  const char *define = "#define USE_NONUNIFORM_SAMPLING\n";
+
+  computeShaders[computeShaderCount++] = version;
 
+  // non-uniform sampling
+  if (lutXformTexture != 0) {
+    computeShaders[computeShaderCount++] = define;
+  }
+
+  computeShaders[computeShaderCount++] = forward_tonemap_compute_shader;
+
+  computeProgramID = engine_loadComputeProgram(computeShaderCount, computeShaders);
+
+  return (computeProgramID != 0);
+}
+
+//-----------------------------------------------------------------------------
+void Tonemapper::setProgram(unsigned int id)
+//-----------------------------------------------------------------------------
+{
   // bind the program
-  engine_setProgram(programID);
+  engine_setProgram(id);
 
   engine_setData2f(3, tonemapScaleOffset);
   bool bUseXform = (lutXformTexture != 0);
@@ -135,23 +160,67 @@ int Tonemapper::blit(const void *dst, const void *src, int srcFenceFd)
   {
     engine_setData2f(4, lutXformScaleOffset);
   }
+}
 
-  // set destination
-  if (dst_buffer) {
-    engine_setDestination(dst_buffer->getFramebuffer(), 0, 0, dst_buffer->getWidth(),
-                          dst_buffer->getHeight());
-  }
-  // set source
-  if (src_buffer) {
-    engine_setExternalInputBuffer(0, src_buffer->getTexture(0x8D65 /* target texture */));
+//-----------------------------------------------------------------------------
+int Tonemapper::blit(const void *dst, const void *src, int srcFenceFd)
+//-----------------------------------------------------------------------------
+{
+  return blit(1, &dst, &src, srcFenceFd);
+}
+
+//-----------------------------------------------------------------------------
+int Tonemapper::blit(int count, const void *const *dst, const void *const *src, int srcFenceFd)
+//-----------------------------------------------------------------------------
+{
+  // make current
+  engine_bind(engineContext);
+
+  unsigned int boundProgramID = 0;
+
+  for (int i = 0; i < count; i++) {
+    // create eglimages if required
+    EGLImageBuffer *dst_buffer = eglImageWrapper->wrap(dst[i]);
+    EGLImageBuffer *src_buffer = eglImageWrapper->wrap(src[i]);
+
+    unsigned int imageTexture = 0;
+    if (computeProgramID && dst_buffer) {
+      imageTexture = dst_buffer->getImageTexture();
+    }
+
+    unsigned int program = imageTexture ? computeProgramID : programID;
+    if (program != boundProgramID) {
+      setProgram(program);
+      boundProgramID = program;
+    }
+
+    // set destination
+    if (imageTexture) {
+      engine_setImageDestination(0, imageTexture);
+    } else if (dst_buffer) {
+      engine_setDestination(dst_buffer->getFramebuffer(), 0, 0, dst_buffer->getWidth(),
+                            dst_buffer->getHeight());
+    }
+    // set source
+    if (src_buffer) {
+      engine_setExternalInputBuffer(0, src_buffer->getTexture(0x8D65 /* target texture */));
+    }
+    // set 3d lut
+    engine_set3DInputBuffer(1, tonemapTexture);
+    // set non-uniform xform
+    engine_set2DInputBuffer(2, lutXformTexture);
+
+    // the source fence is consumed by the first draw and covers the whole batch
+    if (imageTexture) {
+      engine_dispatch(i ? -1 : srcFenceFd, (dst_buffer->getWidth() + 7) / 8,
+                      (dst_buffer->getHeight() + 7) / 8);
+    } else {
+      engine_draw(i ? -1 : srcFenceFd);
+    }
   }
-  // set 3d lut
-  engine_set3DInputBuffer(1, tonemapTexture);
-  // set non-uniform xform
-  engine_set2DInputBuffer(2, lutXformTexture);
 
   // perform
-  int fenceFD = engine_blit(srcFenceFd);
+  int fenceFD = engine_flush();
 
   return fenceFD;
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2017, 2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -32,16 +32,22 @@ class Tonemapper {
   unsigned int tonemapTexture;
   unsigned int lutXformTexture;
   unsigned int programID;
+  unsigned int computeProgramID;
   float lutXformScaleOffset[2];
   float tonemapScaleOffset[2];
   EGLImageWrapper* eglImageWrapper;
   Tonemapper();
+  void setProgram(unsigned int id);
 
  public:
   ~Tonemapper();
   static Tonemapper *build(int type, void *colorMap, int colorMapSize, void *lutXform,
                            int lutXformSize, bool isSecure);
+  // Loads the compute variant if the GPU supports it. Blits into RGBA8888 targets then use it.
+  bool enableCompute();
   int blit(const void *dst, const void *src, int srcFenceFd);
+  // Tonemaps count src/dst pairs in one pass, returning a single fence for all of them.
+  int blit(int count, const void *const *dst, const void *const *src, int srcFenceFd);
 };
 
 #endif  //__TONEMAPPER_TONEMAP_H__
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2017, 2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -25,6 +25,7 @@ void engine_bind(void*);
 void engine_shutdown(void*);
 
 unsigned int engine_loadProgram(int, const char **, int, const char **);
+unsigned int engine_loadComputeProgram(int, const char **);
 void engine_setProgram(int);
 void engine_deleteProgram(unsigned int);
 
@@ -36,8 +37,17 @@ void engine_set2DInputBuffer(int binding, unsigned int textureID);
 void engine_set3DInputBuffer(int binding, unsigned int textureID);
 void engine_setExternalInputBuffer(int binding, unsigned int textureID);
 void engine_setDestination(int id, int x, int y, int w, int h);
+void engine_setImageDestination(int binding, unsigned int textureID);
 void engine_setData2f(int loc, float* data);
 
 int engine_blit(int);
+// engine_draw() queues a draw into the current destination without creating a fence, so several
+// draws can be retired by a single engine_flush().
+void engine_draw(int);
+int engine_flush();
+
+// Compute path: true when the bound context is GLES 3.1 and EGLImages can back storage textures.
+bool engine_supportsCompute();
+void engine_dispatch(int, int groupsX, int groupsY);
 
 #endif  //__TONEMAPPER_ENGINE_H__
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, The Linux Foundation. All rights reserved.
+ * Copyright (c) 2016-2017, 2020, The Linux Foundation. All rights reserved.
  * Not a Contribution.
  *
  * Copyright 2015 The Android Open Source Project
@@ -19,6 +19,12 @@
 
 #include "glengine.h"
 #include <log/log.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+#include <vector>
 #include "engine.h"
 
 void checkGlError(const char *, int);
@@ -29,14 +35,23 @@ class EngineContext {
     EGLDisplay eglDisplay;
     EGLContext eglContext;
     EGLSurface eglSurface;
+    bool isSecure;
+    int refCount;
     EngineContext()
     {
         eglDisplay = EGL_NO_DISPLAY;
         eglContext = EGL_NO_CONTEXT;
         eglSurface = EGL_NO_SURFACE;
+        isSecure = false;
+        refCount = 0;
     }
 };
 
+// Tonemappers run on the composer's single GPU worker thread and set all their GL state per blit,
+// so they share one context per secure mode instead of creating one each.
+static std::mutex engineContextLock;
+static EngineContext *sharedEngineContexts[2] = {};
+
 //-----------------------------------------------------------------------------
 // Make Current
 void engine_bind(void* context)
@@ -52,7 +67,18 @@ void engine_bind(void* context)
 void* engine_initialize(bool isSecure)
 //-----------------------------------------------------------------------------
 {
+  std::lock_guard<std::mutex> lock(engineContextLock);
+  EngineContext* &sharedContext = sharedEngineContexts[isSecure ? 1 : 0];
+  if (sharedContext) {
+    sharedContext->refCount++;
+    engine_bind(sharedContext);
+    return (void*)(sharedContext);
+  }
+
   EngineContext* engineContext = new EngineContext();
+  engineContext->isSecure = isSecure;
+  engineContext->refCount = 1;
+  sharedContext = engineContext;
 
   // display
   engineContext->eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
@@ -99,7 +125,13 @@ void* engine_initialize(bool isSecure)
 void engine_shutdown(void* context)
 //-----------------------------------------------------------------------------
 {
+  std::lock_guard<std::mutex> lock(engineContextLock);
   EngineContext* engineContext = (EngineContext*)context;
+  if (--engineContext->refCount > 0) {
+    return;
+  }
+
+  sharedEngineContexts[engineContext->isSecure ? 1 : 0] = NULL;
   EGL(eglMakeCurrent(engineContext->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT));
   EGL(eglDestroySurface(engineContext->eglDisplay, engineContext->eglSurface));
   EGL(eglDestroyContext(engineContext->eglDisplay, engineContext->eglContext));
@@ -107,6 +139,7 @@ void engine_shutdown(void* context)
   engineContext->eglDisplay = EGL_NO_DISPLAY;
   engineContext->eglContext = EGL_NO_CONTEXT;
   engineContext->eglSurface = EGL_NO_SURFACE;
+  delete engineContext;
 }
 
 //-----------------------------------------------------------------------------
@@ -184,12 +217,172 @@ void dumpShaderLog(int shader)
   }
 }
 
+// Linked programs are saved with glGetProgramBinary, keyed on the driver and the shader sources,
+// so later context creations skip compiling and linking.
+static const char *kProgramCacheDir = "/data/vendor/display/gl_program_cache";
+static const uint32_t kProgramCacheMagic = 0x50524743;  // "PRGC"
+
+struct ProgramCacheHeader {
+  uint32_t magic;
+  uint32_t format;
+  uint32_t length;
+};
+
+//-----------------------------------------------------------------------------
+static uint64_t hashString(uint64_t hash, const char *str)
+//-----------------------------------------------------------------------------
+{
+  // FNV-1a
+  for (; str && *str; str++) {
+    hash = (hash ^ (uint8_t)(*str)) * 1099511628211ULL;
+  }
+
+  return (hash ^ 0xff) * 1099511628211ULL;
+}
+
+//-----------------------------------------------------------------------------
+static uint64_t programKey(int entries, const char **sources, uint64_t hash)
+//-----------------------------------------------------------------------------
+{
+  if (!hash) {
+    hash = 14695981039346656037ULL;
+    hash = hashString(hash, (const char *)glGetString(GL_VENDOR));
+    hash = hashString(hash, (const char *)glGetString(GL_RENDERER));
+    hash = hashString(hash, (const char *)glGetString(GL_VERSION));
+
+    // binaries from protected and unprotected contexts are not interchangeable
+    EGLint isProtected = EGL_FALSE;
+    eglQueryContext(eglGetCurrentDisplay(), eglGetCurrentContext(), EGL_PROTECTED_CONTENT_EXT,
+                    &isProtected);
+    hash = hashString(hash, isProtected ? "protected" : "unprotected");
+  }
+
+  for (int i = 0; i < entries; i++) {
+    hash = hashString(hash, sources[i]);
+  }
+
+  return hashString(hash, "stage");
+}
+
+//-----------------------------------------------------------------------------
+static void programCachePath(uint64_t key, char *path, size_t size)
+//-----------------------------------------------------------------------------
+{
+  snprintf(path, size, "%s/%016llx.bin", kProgramCacheDir, (unsigned long long)key);
+}
+
+//-----------------------------------------------------------------------------
+static GLuint loadCachedProgram(uint64_t key)
+//-----------------------------------------------------------------------------
+{
+  GLint numFormats = 0;
+  GL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats));
+  if (numFormats <= 0) {
+    return 0;
+  }
+
+  char path[256];
+  programCachePath(key, path, sizeof(path));
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return 0;
+  }
+
+  ProgramCacheHeader header = {};
+  std::vector<uint8_t> binary;
+  bool valid = (fread(&header, sizeof(header), 1, fp) == 1) &&
+               (header.magic == kProgramCacheMagic) && header.length;
+  if (valid) {
+    binary.resize(header.length);
+    valid = (fread(binary.data(), header.length, 1, fp) == 1);
+  }
+  fclose(fp);
+
+  GLuint progId = 0;
+  if (valid) {
+    progId = glCreateProgram();
+    GL(glProgramParameteri(progId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    glProgramBinary(progId, header.format, binary.data(), header.length);
+    // a driver update may reject old binaries without an error, so check the link status
+    int success = 0;
+    glGetProgramiv(progId, GL_LINK_STATUS, &success);
+    if (!success) {
+      GL(glDeleteProgram(progId));
+      progId = 0;
+    }
+  }
+
+  if (!progId) {
+    unlink(path);
+  }
+
+  return progId;
+}
+
+//-----------------------------------------------------------------------------
+static void storeProgram(GLuint progId, uint64_t key)
+//-----------------------------------------------------------------------------
+{
+  GLint length = 0;
+  GL(glGetProgramiv(progId, GL_PROGRAM_BINARY_LENGTH, &length));
+  if (length <= 0) {
+    return;
+  }
+
+  ProgramCacheHeader header = {kProgramCacheMagic, 0, (uint32_t)length};
+  std::vector<uint8_t> binary(length);
+  GLenum format = 0;
+  GL(glGetProgramBinary(progId, length, NULL, &format, binary.data()));
+  header.format = format;
+
+  mkdir(kProgramCacheDir, 0770);
+
+  // write to a temporary file and rename, so a reader never sees a partial binary
+  char path[256], tmpPath[272];
+  programCachePath(key, path, sizeof(path));
+  snprintf(tmpPath, sizeof(tmpPath), "%s.%d", path, getpid());
+  FILE *fp = fopen(tmpPath, "wb");
+  if (!fp) {
+    return;
+  }
+
+  bool written = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                 (fwrite(binary.data(), binary.size(), 1, fp) == 1);
+  written = (fclose(fp) == 0) && written;
+  if (!written || rename(tmpPath, path)) {
+    unlink(tmpPath);
+  }
+}
+
+//-----------------------------------------------------------------------------
+static GLuint storeLinkedProgram(GLuint progId, uint64_t key)
+//-----------------------------------------------------------------------------
+{
+  int success = 0;
+  GL(glGetProgramiv(progId, GL_LINK_STATUS, &success));
+  if (!success) {
+    ALOGI("%s - Program failed to link", __FUNCTION__);
+    return progId;
+  }
+
+  storeProgram(progId, key);
+
+  return progId;
+}
+
 //-----------------------------------------------------------------------------
 GLuint engine_loadProgram(int vertexEntries, const char **vertex, int fragmentEntries,
                           const char **fragment)
 //-----------------------------------------------------------------------------
 {
-  GLuint progId = glCreateProgram();
+  uint64_t key = programKey(fragmentEntries, fragment, programKey(vertexEntries, vertex, 0));
+  GLuint progId = loadCachedProgram(key);
+  if (progId) {
+    return progId;
+  }
+
+  progId = glCreateProgram();
+  GL(glProgramParameteri(progId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
 
   int vertId = glCreateShader(GL_VERTEX_SHADER);
   int fragId = glCreateShader(GL_FRAGMENT_SHADER);
@@ -213,9 +406,67 @@ GLuint engine_loadProgram(int vertexEntries, const char **vertex, int fragmentEn
   GL(glDeleteShader(vertId));
   GL(glDeleteShader(fragId));
 
+  return storeLinkedProgram(progId, key);
+}
+
+//-----------------------------------------------------------------------------
+GLuint engine_loadComputeProgram(int computeEntries, const char **compute)
+//-----------------------------------------------------------------------------
+{
+  uint64_t key = programKey(computeEntries, compute, 0);
+  GLuint progId = loadCachedProgram(key);
+  if (progId) {
+    return progId;
+  }
+
+  progId = glCreateProgram();
+  GL(glProgramParameteri(progId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+  int compId = glCreateShader(GL_COMPUTE_SHADER);
+
+  GL(glShaderSource(compId, computeEntries, compute, 0));
+  GL(glCompileShader(compId));
+  dumpShaderLog(compId);
+
+  GL(glAttachShader(progId, compId));
+  GL(glLinkProgram(progId));
+  GL(glDetachShader(progId, compId));
+  GL(glDeleteShader(compId));
+
+  int success = 0;
+  GL(glGetProgramiv(progId, GL_LINK_STATUS, &success));
+  if (!success) {
+    ALOGI("%s - Compute program failed to link", __FUNCTION__);
+    GL(glDeleteProgram(progId));
+    progId = 0;
+  } else {
+    storeProgram(progId, key);
+  }
+
   return progId;
 }
 
+//-----------------------------------------------------------------------------
+bool engine_supportsCompute()
+//-----------------------------------------------------------------------------
+{
+  GLint major = 0, minor = 0, numExtensions = 0;
+  GL(glGetIntegerv(GL_MAJOR_VERSION, &major));
+  GL(glGetIntegerv(GL_MINOR_VERSION, &minor));
+  if ((major < 3) || ((major == 3) && (minor < 1))) {
+    return false;
+  }
+
+  GL(glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions));
+  for (GLint i = 0; i < numExtensions; i++) {
+    const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+    if (extension && !strcmp(extension, "GL_EXT_EGL_image_storage")) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 //-----------------------------------------------------------------------------
 void WaitOnNativeFence(int fd)
 //-----------------------------------------------------------------------------
@@ -264,6 +515,13 @@ void engine_setDestination(int id, int x, int y, int w, int h)
   GL(glViewport(x, y, w, h));
 }
 
+//-----------------------------------------------------------------------------
+void engine_setImageDestination(int binding, unsigned int id)
+//-----------------------------------------------------------------------------
+{
+  GL(glBindImageTexture(binding, id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8));
+}
+
 //-----------------------------------------------------------------------------
 void engine_setProgram(int id)
 //-----------------------------------------------------------------------------
@@ -299,13 +557,36 @@ void engine_setExternalInputBuffer(int binding, unsigned int id)
 int engine_blit(int srcFenceFd)
 //-----------------------------------------------------------------------------
 {
-  int fd = -1;
+  engine_draw(srcFenceFd);
+  return engine_flush();
+}
+
+//-----------------------------------------------------------------------------
+void engine_draw(int srcFenceFd)
+//-----------------------------------------------------------------------------
+{
   WaitOnNativeFence(srcFenceFd);
   float fullscreen_vertices[]{0.0f, 2.0f, 0.0f, 0.0f, 2.0f, 0.0f};
   GL(glEnableVertexAttribArray(0));
   GL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, fullscreen_vertices));
   GL(glDrawArrays(GL_TRIANGLES, 0, 3));
-  fd = CreateNativeFence();
+}
+
+//-----------------------------------------------------------------------------
+void engine_dispatch(int srcFenceFd, int groupsX, int groupsY)
+//-----------------------------------------------------------------------------
+{
+  WaitOnNativeFence(srcFenceFd);
+  GL(glDispatchCompute(groupsX, groupsY, 1));
+  // image stores must land before any later draw or blit reads the destination
+  GL(glMemoryBarrier(GL_ALL_BARRIER_BITS));
+}
+
+//-----------------------------------------------------------------------------
+int engine_flush()
+//-----------------------------------------------------------------------------
+{
+  int fd = CreateNativeFence();
   GL(glFlush());
   return fd;
 }
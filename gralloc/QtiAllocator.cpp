@@ -48,6 +48,20 @@ static void get_properties(gralloc::GrallocProperties *props) {
   props->ubwc_disable = property_get_bool("vendor.gralloc.disable_ubwc", 0);
 
   props->ahardware_buffer_disable = property_get_bool("vendor.gralloc.disable_ahardware_buffer", 0);
+
+  props->buffer_pool_enable = property_get_bool("vendor.gralloc.enable_buffer_pool", 0);
+
+  props->buffer_pool_budget_mb =
+      UINT(property_get_int32("vendor.gralloc.buffer_pool_budget_mb", 64));
+
+  props->use_dma_buf_heaps = property_get_bool("vendor.gralloc.use_dma_buf_heaps", 1);
+
+  props->zeroed_reserve_enable = property_get_bool("vendor.gralloc.enable_zeroed_reserve", 0);
+
+  props->zeroed_reserve_budget_mb =
+      UINT(property_get_int32("vendor.gralloc.zeroed_reserve_budget_mb", 64));
+
+  props->large_page_min_kb = UINT(property_get_int32("vendor.gralloc.large_page_min_kb", 4096));
 }
 
 namespace vendor {
@@ -92,15 +106,13 @@ Return<void> QtiAllocator::allocate(const hidl_vec<uint32_t> &descriptor, uint32
     return Void();
   }
 
+  // BufferQueue asks for several identical buffers at once, allocate them as a batch.
+  std::vector<buffer_handle_t> handles;
+  err = buf_mgr_->AllocateBuffers(desc, count, &handles);
   std::vector<hidl_handle> buffers;
-  buffers.reserve(count);
-  for (uint32_t i = 0; i < count; i++) {
-    buffer_handle_t buffer;
-    ALOGD_IF(DEBUG, "buffer: %p", &buffer);
-    err = buf_mgr_->AllocateBuffer(desc, &buffer);
-    if (err != Error::NONE) {
-      break;
-    }
+  buffers.reserve(handles.size());
+  for (auto buffer : handles) {
+    ALOGD_IF(DEBUG, "buffer: %p", buffer);
     buffers.emplace_back(hidl_handle(buffer));
   }
 
@@ -159,15 +171,13 @@ Return<void> QtiAllocator::allocate(const hidl_vec<uint8_t> &descriptor, uint32_
     return Void();
   }
 
+  // BufferQueue asks for several identical buffers at once, allocate them as a batch.
+  std::vector<buffer_handle_t> handles;
+  err = buf_mgr_->AllocateBuffers(desc, count, &handles);
   std::vector<hidl_handle> buffers;
-  buffers.reserve(count);
-  for (uint32_t i = 0; i < count; i++) {
-    buffer_handle_t buffer;
-    ALOGD_IF(DEBUG, "buffer: %p", &buffer);
-    err = buf_mgr_->AllocateBuffer(desc, &buffer);
-    if (err != Error::NONE) {
-      break;
-    }
+  buffers.reserve(handles.size());
+  for (auto buffer : handles) {
+    ALOGD_IF(DEBUG, "buffer: %p", buffer);
     buffers.emplace_back(hidl_handle(buffer));
   }
 
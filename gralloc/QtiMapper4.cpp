@@ -259,6 +259,21 @@ Return<void> QtiMapper::get(void *buffer, const MetadataType &metadataType, get_
       return Void();
     }
     auto hnd = static_cast<private_handle_t *>(buffer);
+    if (metadataType.name == GRALLOC4_STANDARD_METADATA_TYPE) {
+      // Scalar metadata is encoded into per thread storage and handed to the callback without a
+      // copy. The callback is synchronous, so the storage is not reused before it returns.
+      thread_local uint8_t fixed_metadata[BufferManager::kMaxFixedMetadataSize];
+      size_t size = 0;
+      err = static_cast<IMapper_4_0_Error>(buf_mgr_->GetFixedMetadata(
+          hnd, metadataType.value, fixed_metadata, sizeof(fixed_metadata), &size));
+      if (err != Error::UNSUPPORTED) {
+        if (err == Error::NONE) {
+          metadata.setToExternal(fixed_metadata, size);
+        }
+        hidl_cb(err, metadata);
+        return Void();
+      }
+    }
     err = static_cast<IMapper_4_0_Error>(buf_mgr_->GetMetadata(hnd, metadataType.value, &metadata));
   }
   hidl_cb(err, metadata);
@@ -30,6 +30,7 @@
 #include <log/log.h>
 #include <cutils/properties.h>
 #include <dlfcn.h>
+#include <cstring>
 #include <mutex>
 
 #include "gr_adreno_info.h"
@@ -42,6 +43,8 @@ using std::mutex;
 namespace gralloc {
 
 AdrenoMemInfo *AdrenoMemInfo::s_instance = nullptr;
+constexpr size_t AdrenoMemInfo::kMaxCachedResults;
+thread_local AdrenoMemInfo::MemoryLayout AdrenoMemInfo::last_layout_;
 
 AdrenoMemInfo *AdrenoMemInfo::GetInstance() {
   static mutex s_lock;
@@ -93,10 +96,41 @@ AdrenoMemInfo::~AdrenoMemInfo() {
 
 void AdrenoMemInfo::AdrenoSetProperties(gralloc::GrallocProperties props) {
   gfx_ahardware_buffer_disable_ = props.ahardware_buffer_disable;
+
+  lock_guard<mutex> lock(cache_lock_);
+  alignments_.clear();
+  layouts_.clear();
+}
+
+bool AdrenoMemInfo::FindAlignment(const AlignmentKey &key, unsigned int *aligned_w,
+                                  unsigned int *aligned_h) {
+  lock_guard<mutex> lock(cache_lock_);
+  auto it = alignments_.find(key);
+  if (it == alignments_.end()) {
+    return false;
+  }
+
+  *aligned_w = it->second.first;
+  *aligned_h = it->second.second;
+  return true;
+}
+
+void AdrenoMemInfo::InsertAlignment(const AlignmentKey &key, unsigned int aligned_w,
+                                    unsigned int aligned_h) {
+  lock_guard<mutex> lock(cache_lock_);
+  if (alignments_.size() >= kMaxCachedResults) {
+    alignments_.clear();
+  }
+  alignments_[key] = std::make_pair(aligned_w, aligned_h);
 }
 
 void AdrenoMemInfo::AlignUnCompressedRGB(int width, int height, int format, int tile_enabled,
                                          unsigned int *aligned_w, unsigned int *aligned_h) {
+  AlignmentKey key = {width, height, format, tile_enabled, false};
+  if (FindAlignment(key, aligned_w, aligned_h)) {
+    return;
+  }
+
   *aligned_w = (unsigned int)ALIGN(width, 32);
   *aligned_h = (unsigned int)ALIGN(height, 32);
 
@@ -145,10 +179,17 @@ void AdrenoMemInfo::AlignUnCompressedRGB(int width, int height, int format, int
         "compute_aligned_width_and_height not found",
         __FUNCTION__);
   }
+
+  InsertAlignment(key, *aligned_w, *aligned_h);
 }
 
 void AdrenoMemInfo::AlignCompressedRGB(int width, int height, int format, unsigned int *aligned_w,
                                        unsigned int *aligned_h) {
+  AlignmentKey key = {width, height, format, SURFACE_TILE_MODE_DISABLE, true};
+  if (FindAlignment(key, aligned_w, aligned_h)) {
+    return;
+  }
+
   if (LINK_adreno_compute_compressedfmt_aligned_width_and_height) {
     int bytesPerPixel = 0;
     surface_rastermode_t raster_mode = SURFACE_RASTER_MODE_UNKNOWN;   // Adreno unknown raster mode.
@@ -162,6 +203,8 @@ void AdrenoMemInfo::AlignCompressedRGB(int width, int height, int format, unsign
     *aligned_h = (unsigned int)ALIGN(height, 32);
     ALOGW("%s: Warning!! compute_compressedfmt_aligned_width_and_height not found", __FUNCTION__);
   }
+
+  InsertAlignment(key, *aligned_w, *aligned_h);
 }
 
 bool AdrenoMemInfo::IsUBWCSupportedByGPU(int format) {
@@ -304,16 +347,52 @@ uint32_t AdrenoMemInfo::AdrenoGetMetadataBlobSize() {
 int AdrenoMemInfo::AdrenoInitMemoryLayout(void *metadata_blob, int width, int height, int depth,
   int format, int num_samples, int isUBWC, uint64_t usage, uint32_t num_planes) {
   if (LINK_adreno_init_memory_layout) {
+    LayoutKey key = {width, height, depth, format, num_samples, isUBWC, usage, num_planes};
+    {
+      lock_guard<mutex> lock(cache_lock_);
+      auto it = layouts_.find(key);
+      if (it != layouts_.end()) {
+        memcpy(metadata_blob, it->second.blob.data(), it->second.blob.size());
+        last_layout_ = it->second;
+        return 0;
+      }
+    }
+
     surface_tile_mode_t tile_mode = static_cast<surface_tile_mode_t> (isUBWC);
-    return LINK_adreno_init_memory_layout(metadata_blob, width, height, depth,
-                                          GetGpuPixelFormat(format), num_samples,
-                                          tile_mode, usage, num_planes);
+    int ret = LINK_adreno_init_memory_layout(metadata_blob, width, height, depth,
+                                             GetGpuPixelFormat(format), num_samples,
+                                             tile_mode, usage, num_planes);
+    if (ret != 0 || !LINK_adreno_get_metadata_blob_size ||
+        !LINK_adreno_get_aligned_gpu_buffer_size) {
+      return ret;
+    }
+
+    // Size the new layout now, so the AdrenoGetAlignedGpuBufferSize call that follows is
+    // answered from last_layout_
+    uint8_t *blob = reinterpret_cast<uint8_t *>(metadata_blob);
+    MemoryLayout layout;
+    layout.blob.assign(blob, blob + LINK_adreno_get_metadata_blob_size());
+    layout.size = static_cast<uint32_t>(LINK_adreno_get_aligned_gpu_buffer_size(metadata_blob));
+    last_layout_ = layout;
+
+    lock_guard<mutex> lock(cache_lock_);
+    if (layouts_.size() >= kMaxCachedResults) {
+      layouts_.clear();
+    }
+    layouts_[key] = std::move(layout);
+    return 0;
   }
   return -1;
 }
 
 uint32_t AdrenoMemInfo::AdrenoGetAlignedGpuBufferSize(void *metadata_blob) {
   if (LINK_adreno_get_aligned_gpu_buffer_size) {
+    // The size is a function of the blob alone
+    if (!last_layout_.blob.empty() &&
+        !memcmp(metadata_blob, last_layout_.blob.data(), last_layout_.blob.size())) {
+      return last_layout_.size;
+    }
+
     uint64_t size = LINK_adreno_get_aligned_gpu_buffer_size(metadata_blob);
     return static_cast<uint32_t>(size);
   }
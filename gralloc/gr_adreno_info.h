@@ -34,6 +34,14 @@
 #include <media/msm_media_info.h>
 #endif
 
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 #include "gr_utils.h"
 
 typedef enum {
@@ -209,6 +217,51 @@ class AdrenoMemInfo {
  private:
   AdrenoMemInfo();
   ~AdrenoMemInfo();
+
+  // The library answers depend only on the arguments, and gralloc asks for the same few
+  // configurations on every allocation and mapper query. Answers are kept until the cache
+  // fills up or properties change.
+  struct AlignmentKey {
+    int width;
+    int height;
+    int format;
+    int tile_mode;
+    bool compressed;
+
+    bool operator<(const AlignmentKey &other) const {
+      return std::tie(width, height, format, tile_mode, compressed) <
+             std::tie(other.width, other.height, other.format, other.tile_mode, other.compressed);
+    }
+  };
+
+  struct LayoutKey {
+    int width;
+    int height;
+    int depth;
+    int format;
+    int num_samples;
+    int tile_mode;
+    uint64_t usage;
+    uint32_t num_planes;
+
+    bool operator<(const LayoutKey &other) const {
+      return std::tie(width, height, depth, format, num_samples, tile_mode, usage, num_planes) <
+             std::tie(other.width, other.height, other.depth, other.format, other.num_samples,
+                      other.tile_mode, other.usage, other.num_planes);
+    }
+  };
+
+  // Metadata blob written by adreno_init_memory_layout and the buffer size it yields
+  struct MemoryLayout {
+    std::vector<uint8_t> blob;
+    uint32_t size = 0;
+  };
+
+  static constexpr size_t kMaxCachedResults = 64;
+
+  bool FindAlignment(const AlignmentKey &key, unsigned int *aligned_w, unsigned int *aligned_h);
+  void InsertAlignment(const AlignmentKey &key, unsigned int aligned_w, unsigned int aligned_h);
+
   // link(s)to adreno surface padding library.
   int (*LINK_adreno_compute_padding)(int width, int bpp, int surface_tile_height,
                                      surface_rastermode_t raster_mode,
@@ -242,6 +295,11 @@ class AdrenoMemInfo {
   bool gfx_ubwc_disable_ = false;
   bool gfx_ahardware_buffer_disable_ = false;
   void *libadreno_utils_ = NULL;
+  std::mutex cache_lock_;
+  std::map<AlignmentKey, std::pair<unsigned int, unsigned int>> alignments_;
+  std::map<LayoutKey, MemoryLayout> layouts_;
+  // Layout most recently written by AdrenoInitMemoryLayout on the calling thread
+  static thread_local MemoryLayout last_layout_;
 
   static AdrenoMemInfo *s_instance;
 };
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <errno.h>
+
+#ifndef QMAA
+#include <linux/msm_ion.h>
+#endif
+
+#include "gr_dma_heap_alloc.h"
+#include "gr_ion_alloc.h"
+#include "gr_utils.h"
+
+namespace {
+
+// Heaps as selected by Allocator::GetIonHeapInfo for the common usages.
+struct HeapConfig {
+  const char *name;
+  unsigned int heap_id;
+  unsigned int flags;
+  bool uncached;
+};
+
+const HeapConfig kHeaps[] = {
+#ifndef QMAA
+  {"system", ION_HEAP(ION_SYSTEM_HEAP_ID), 0, false},
+  {"system-uncached", ION_HEAP(ION_SYSTEM_HEAP_ID), 0, true},
+#if !defined(SLAVE_SIDE_CP) && defined(ION_FLAG_CP_PIXEL)
+  {"secure-pixel", ION_HEAP(ION_SECURE_HEAP_ID), UINT(ION_FLAG_SECURE | ION_FLAG_CP_PIXEL), true},
+#endif
+#else
+  {"default", 0, 0, false},
+#endif
+};
+
+// From a small cursor up to a 4K RGBA buffer.
+void AllocArgs(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"size", "heap"});
+  for (int64_t size : {64 << 10, 1 << 20, 8 << 20, 32 << 20}) {
+    for (int64_t heap = 0; heap < int64_t(sizeof(kHeaps) / sizeof(kHeaps[0])); heap++) {
+      b->Args({size, heap});
+    }
+  }
+}
+
+template <class Backend>
+void BM_AllocBuffer(benchmark::State &state) {
+  static Backend backend;
+  static bool initialized = backend.Init();
+  if (!initialized) {
+    state.SkipWithError("Backend not available");
+    return;
+  }
+
+  const HeapConfig &heap = kHeaps[state.range(1)];
+  state.SetLabel(heap.name);
+  for (auto _ : state) {
+    gralloc::AllocData data;
+    data.size = UINT(state.range(0));
+    data.align = 4096;
+    data.heap_id = heap.heap_id;
+    data.flags = heap.flags;
+    data.uncached = heap.uncached;
+    int ret = backend.AllocBuffer(&data);
+    if (ret) {
+      state.SkipWithError(ret == -ENODEV ? "Heap not available" : "Allocation failed");
+      break;
+    }
+
+    state.PauseTiming();
+    backend.FreeBuffer(nullptr, data.size, 0, data.fd, data.ion_handle);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK_TEMPLATE(BM_AllocBuffer, gralloc::IonAlloc)->Apply(AllocArgs);
+BENCHMARK_TEMPLATE(BM_AllocBuffer, gralloc::DmaHeapAlloc)->Apply(AllocArgs);
+
+}  // namespace
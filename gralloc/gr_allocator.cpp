@@ -27,9 +27,14 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define DEBUG 0
 #include <log/log.h>
 #include <cutils/properties.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <algorithm>
+#include <iterator>
 #include <vector>
 
 #ifndef QMAA
@@ -83,6 +88,43 @@ using std::vector;
 
 namespace gralloc {
 
+// Pooled buffers not reused within this time are freed
+static const std::chrono::seconds kPoolMaxAge(10);
+
+// Allocations from this size on are large enough for kernel zeroing to show in the latency
+static const unsigned int kReserveMinSize = 4 * 1024 * 1024;
+static const size_t kMaxReserveClasses = 4;
+// The reserve is refilled once no buffer was allocated for this long
+static const std::chrono::milliseconds kReserveIdleDelay(200);
+
+static bool IsSameClass(const AllocData &data, unsigned int size, unsigned int heap_id,
+                        unsigned int flags, bool uncached) {
+  return data.size == size && data.heap_id == heap_id && data.flags == flags &&
+         data.uncached == uncached;
+}
+
+// Returns the number of references on the dma-buf file behind fd, or -1 if it is unknown.
+// The count includes other processes the fd was passed to and all mappings of the buffer.
+static int GetDmaBufFileCount(int fd) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+  FILE *file = fopen(path, "re");
+  if (!file) {
+    return -1;
+  }
+
+  int count = -1;
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "count: %d", &count) == 1) {
+      break;
+    }
+  }
+  fclose(file);
+
+  return count;
+}
+
 static BufferInfo GetBufferInfo(const BufferDescriptor &descriptor) {
   return BufferInfo(descriptor.GetWidth(), descriptor.GetHeight(), descriptor.GetFormat(),
                     descriptor.GetUsage());
@@ -92,22 +134,62 @@ Allocator::Allocator() : ion_allocator_(nullptr) {}
 
 bool Allocator::Init() {
   ion_allocator_ = new IonAlloc();
-
   if (!ion_allocator_->Init()) {
-    return false;
+    delete ion_allocator_;
+    ion_allocator_ = nullptr;
   }
 
-  return true;
+  dma_heap_allocator_ = new DmaHeapAlloc();
+  if (!dma_heap_allocator_->Init()) {
+    delete dma_heap_allocator_;
+    dma_heap_allocator_ = nullptr;
+  }
+
+  if (ion_allocator_) {
+    backend_ = ion_allocator_;
+  } else {
+    backend_ = dma_heap_allocator_;
+  }
+
+  return backend_ != nullptr;
 }
 
 Allocator::~Allocator() {
-  if (ion_allocator_) {
-    delete ion_allocator_;
+  if (reserve_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(reserve_lock_);
+      reserve_exit_ = true;
+    }
+    reserve_cv_.notify_one();
+    reserve_thread_.join();
+  }
+
+  if (backend_) {
+    TrimBufferPool();
   }
+  delete ion_allocator_;
+  delete dma_heap_allocator_;
 }
 
 void Allocator::SetProperties(gralloc::GrallocProperties props) {
   use_system_heap_for_sensors_ = props.use_system_heap_for_sensors;
+  use_dma_buf_heaps_ = props.use_dma_buf_heaps;
+  ALOGI_IF(use_dma_buf_heaps_ && dma_heap_allocator_, "%s: Allocating from dma-buf heaps",
+           __FUNCTION__);
+
+  std::lock_guard<std::mutex> lock(pool_lock_);
+  buffer_pool_enabled_ = props.buffer_pool_enable && (props.buffer_pool_budget_mb > 0);
+  buffer_pool_heap_budget_ = uint64_t(props.buffer_pool_budget_mb) * 1024 * 1024;
+  ALOGI_IF(buffer_pool_enabled_, "%s: Buffer pool enabled, %u MiB per heap", __FUNCTION__,
+           props.buffer_pool_budget_mb);
+
+  std::lock_guard<std::mutex> reserve_lock(reserve_lock_);
+  zeroed_reserve_enabled_ = props.zeroed_reserve_enable && (props.zeroed_reserve_budget_mb > 0);
+  zeroed_reserve_budget_ = uint64_t(props.zeroed_reserve_budget_mb) * 1024 * 1024;
+  if (zeroed_reserve_enabled_ && !reserve_thread_.joinable()) {
+    reserve_thread_ = std::thread(&Allocator::ReserveThread, this);
+    ALOGI("%s: Zeroed reserve enabled, %u MiB", __FUNCTION__, props.zeroed_reserve_budget_mb);
+  }
 }
 
 int Allocator::AllocateMem(AllocData *alloc_data, uint64_t usage, int format) {
@@ -117,7 +199,26 @@ int Allocator::AllocateMem(AllocData *alloc_data, uint64_t usage, int format) {
   // After this point we should have the right heap set, there is no fallback
   GetIonHeapInfo(usage, &alloc_data->heap_id, &alloc_data->alloc_type, &alloc_data->flags);
 
-  ret = ion_allocator_->AllocBuffer(alloc_data);
+  if (AllocateFromPool(alloc_data) || AllocateFromReserve(alloc_data)) {
+    alloc_data->alloc_type |= private_handle_t::PRIV_FLAGS_USES_ION;
+    return 0;
+  }
+
+  ret = AllocateFromBackend(alloc_data);
+  if (ret < 0 && TrimBufferPool()) {
+    // Memory is tight, retry once with what the pool held given back
+    ret = AllocateFromBackend(alloc_data);
+  }
+
+  if (ret >= 0) {
+    std::lock_guard<std::mutex> lock(pool_lock_);
+    bool secure = alloc_data->alloc_type & private_handle_t::PRIV_FLAGS_SECURE_BUFFER;
+    if (buffer_pool_enabled_ && !secure) {
+      allocated_buffers_[alloc_data->fd] = {alloc_data->size, alloc_data->heap_id,
+                                            alloc_data->flags, alloc_data->uncached};
+    }
+  }
+
   if (ret >= 0) {
     alloc_data->alloc_type |= private_handle_t::PRIV_FLAGS_USES_ION;
   } else {
@@ -128,33 +229,318 @@ int Allocator::AllocateMem(AllocData *alloc_data, uint64_t usage, int format) {
   return ret;
 }
 
+int Allocator::AllocateFromBackend(AllocData *data) {
+  if (dma_heap_allocator_ && use_dma_buf_heaps_) {
+    int ret = dma_heap_allocator_->AllocBuffer(data);
+    if (ret != -ENODEV || !ion_allocator_) {
+      return ret;
+    }
+  }
+
+  if (!ion_allocator_) {
+    return -ENODEV;
+  }
+
+  return ion_allocator_->AllocBuffer(data);
+}
+
 int Allocator::MapBuffer(void **base, unsigned int size, unsigned int offset, int fd) {
-  if (ion_allocator_) {
-    return ion_allocator_->MapBuffer(base, size, offset, fd);
+  if (backend_) {
+    return backend_->MapBuffer(base, size, offset, fd);
+  }
+
+  return -EINVAL;
+}
+
+int Allocator::UnmapBuffer(void *base, unsigned int size, unsigned int offset) {
+  if (backend_) {
+    return backend_->UnmapBuffer(base, size, offset);
   }
 
   return -EINVAL;
 }
 
 int Allocator::ImportBuffer(int fd) {
-  if (ion_allocator_) {
-    return ion_allocator_->ImportBuffer(fd);
+  if (backend_) {
+    return backend_->ImportBuffer(fd);
   }
   return -EINVAL;
 }
 
 int Allocator::FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int handle) {
-  if (ion_allocator_) {
-    return ion_allocator_->FreeBuffer(base, size, offset, fd, handle);
+  if (backend_) {
+    if (ReleaseToPool(base, size, offset, fd)) {
+      return 0;
+    }
+    return backend_->FreeBuffer(base, size, offset, fd, handle);
   }
 
   return -EINVAL;
 }
 
+bool Allocator::AllocateFromPool(AllocData *data) {
+  PooledBuffer buffer;
+  {
+    std::lock_guard<std::mutex> lock(pool_lock_);
+    if (!buffer_pool_enabled_ || buffer_pool_.empty()) {
+      return false;
+    }
+
+    TrimExpiredLocked(std::chrono::steady_clock::now());
+
+    // Most recently released first, it is the most likely to be idle already
+    auto it = buffer_pool_.rbegin();
+    for (; it != buffer_pool_.rend(); it++) {
+      if (it->size == data->size && it->heap_id == data->heap_id && it->flags == data->flags &&
+          it->uncached == data->uncached && GetDmaBufFileCount(it->fd) == 1) {
+        break;
+      }
+    }
+    if (it == buffer_pool_.rend()) {
+      return false;
+    }
+
+    buffer = *it;
+    pooled_bytes_[buffer.heap_id] -= buffer.size;
+    buffer_pool_.erase(std::next(it).base());
+  }
+
+  // Clear the previous contents, the buffer may have belonged to another client
+  void *base = nullptr;
+  if (backend_->MapBuffer(&base, buffer.size, 0, buffer.fd) != 0) {
+    backend_->FreeBuffer(nullptr, buffer.size, 0, buffer.fd, buffer.fd);
+    return false;
+  }
+  memset(base, 0, buffer.size);
+  if (!buffer.uncached) {
+    backend_->CleanBuffer(base, buffer.size, 0, buffer.fd, CACHE_CLEAN, buffer.fd);
+  }
+  backend_->UnmapBuffer(base, buffer.size, 0);
+
+  data->fd = buffer.fd;
+  data->ion_handle = buffer.fd;
+  {
+    std::lock_guard<std::mutex> lock(pool_lock_);
+    allocated_buffers_[buffer.fd] = {buffer.size, buffer.heap_id, buffer.flags, buffer.uncached};
+  }
+  ALOGD_IF(DEBUG, "%s: Reused buffer size:%u fd:%d", __FUNCTION__, buffer.size, buffer.fd);
+
+  return true;
+}
+
+bool Allocator::AllocateFromReserve(AllocData *data) {
+  bool secure = data->alloc_type & private_handle_t::PRIV_FLAGS_SECURE_BUFFER;
+  if (secure || data->size < kReserveMinSize) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(reserve_lock_);
+  if (!zeroed_reserve_enabled_) {
+    return false;
+  }
+
+  last_alloc_time_ = std::chrono::steady_clock::now();
+  auto class_it = std::find_if(reserve_classes_.begin(), reserve_classes_.end(),
+                               [data](const PoolKey &key) {
+                                 return IsSameClass(*data, key.size, key.heap_id, key.flags,
+                                                    key.uncached);
+                               });
+  if (class_it != reserve_classes_.end()) {
+    reserve_classes_.splice(reserve_classes_.begin(), reserve_classes_, class_it);
+  } else {
+    reserve_classes_.push_front({data->size, data->heap_id, data->flags, data->uncached});
+    if (reserve_classes_.size() > kMaxReserveClasses) {
+      const PoolKey &dropped = reserve_classes_.back();
+      for (auto it = reserve_.begin(); it != reserve_.end();) {
+        if (IsSameClass(*it, dropped.size, dropped.heap_id, dropped.flags, dropped.uncached)) {
+          backend_->FreeBuffer(nullptr, it->size, 0, it->fd, it->ion_handle);
+          reserve_bytes_ -= it->size;
+          it = reserve_.erase(it);
+        } else {
+          it++;
+        }
+      }
+      reserve_classes_.pop_back();
+    }
+  }
+  // Either way the reserve changes, the thread picks it up once allocations go idle
+  reserve_cv_.notify_one();
+
+  auto it = std::find_if(reserve_.begin(), reserve_.end(), [data](const AllocData &buffer) {
+    return IsSameClass(buffer, data->size, data->heap_id, data->flags, data->uncached);
+  });
+  if (it == reserve_.end()) {
+    return false;
+  }
+
+  data->fd = it->fd;
+  data->ion_handle = it->ion_handle;
+  reserve_bytes_ -= it->size;
+  reserve_.erase(it);
+  ALOGD_IF(DEBUG, "%s: Reserved buffer size:%u fd:%d", __FUNCTION__, data->size, data->fd);
+
+  return true;
+}
+
+bool Allocator::GetMissingReserveLocked(PoolKey *key) {
+  for (auto &reserve_class : reserve_classes_) {
+    bool reserved = std::any_of(reserve_.begin(), reserve_.end(),
+                                [&reserve_class](const AllocData &buffer) {
+                                  return IsSameClass(buffer, reserve_class.size,
+                                                     reserve_class.heap_id, reserve_class.flags,
+                                                     reserve_class.uncached);
+                                });
+    if (!reserved && reserve_bytes_ + reserve_class.size <= zeroed_reserve_budget_) {
+      *key = reserve_class;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Allocator::ReserveThread() {
+  std::unique_lock<std::mutex> lock(reserve_lock_);
+  while (!reserve_exit_) {
+    PoolKey key;
+    if (!zeroed_reserve_enabled_ || !GetMissingReserveLocked(&key)) {
+      reserve_cv_.wait(lock);
+      continue;
+    }
+
+    // Stay out of the way of a burst of allocations in progress
+    auto idle_time = last_alloc_time_ + kReserveIdleDelay;
+    if (std::chrono::steady_clock::now() < idle_time) {
+      reserve_cv_.wait_until(lock, idle_time);
+      continue;
+    }
+
+    lock.unlock();
+    AllocData data;
+    data.size = key.size;
+    data.heap_id = key.heap_id;
+    data.flags = key.flags;
+    data.uncached = key.uncached;
+    int ret = AllocateFromBackend(&data);
+    lock.lock();
+
+    if (ret < 0) {
+      // Do not insist under memory pressure, retry after the next allocation
+      last_alloc_time_ = std::chrono::steady_clock::now();
+      reserve_cv_.wait(lock);
+      continue;
+    }
+
+    // The class may have been dropped or the reserve trimmed in the meantime
+    bool wanted = std::any_of(reserve_classes_.begin(), reserve_classes_.end(),
+                              [&data](const PoolKey &reserve_class) {
+                                return IsSameClass(data, reserve_class.size,
+                                                   reserve_class.heap_id, reserve_class.flags,
+                                                   reserve_class.uncached);
+                              });
+    if (!wanted || reserve_exit_ || reserve_bytes_ + data.size > zeroed_reserve_budget_) {
+      backend_->FreeBuffer(nullptr, data.size, 0, data.fd, data.ion_handle);
+      continue;
+    }
+
+    reserve_.push_back(data);
+    reserve_bytes_ += data.size;
+    ALOGD_IF(DEBUG, "%s: Reserved size:%u fd:%d, %" PRIu64 " bytes total", __FUNCTION__,
+             data.size, data.fd, reserve_bytes_);
+  }
+}
+
+bool Allocator::TrimReserve() {
+  std::lock_guard<std::mutex> lock(reserve_lock_);
+  bool trimmed = !reserve_.empty();
+  for (auto &buffer : reserve_) {
+    backend_->FreeBuffer(nullptr, buffer.size, 0, buffer.fd, buffer.ion_handle);
+  }
+  reserve_.clear();
+  reserve_bytes_ = 0;
+
+  return trimmed;
+}
+
+bool Allocator::ReleaseToPool(void *base, unsigned int size, unsigned int offset, int fd) {
+  std::lock_guard<std::mutex> lock(pool_lock_);
+  auto key_it = allocated_buffers_.find(fd);
+  if (key_it == allocated_buffers_.end()) {
+    return false;
+  }
+
+  PoolKey key = key_it->second;
+  allocated_buffers_.erase(key_it);
+  if (!buffer_pool_enabled_ || key.size > buffer_pool_heap_budget_) {
+    return false;
+  }
+
+  if (base) {
+    backend_->UnmapBuffer(base, size, offset);
+  }
+
+  // Make room within the heap budget, oldest buffers go first
+  auto now = std::chrono::steady_clock::now();
+  TrimExpiredLocked(now);
+  uint64_t &heap_bytes = pooled_bytes_[key.heap_id];
+  for (auto it = buffer_pool_.begin();
+       it != buffer_pool_.end() && heap_bytes + key.size > buffer_pool_heap_budget_;) {
+    auto next = std::next(it);
+    if (it->heap_id == key.heap_id) {
+      EvictLocked(it);
+    }
+    it = next;
+  }
+
+  PooledBuffer buffer;
+  buffer.fd = fd;
+  buffer.size = key.size;
+  buffer.heap_id = key.heap_id;
+  buffer.flags = key.flags;
+  buffer.uncached = key.uncached;
+  buffer.release_time = now;
+  buffer_pool_.push_back(buffer);
+  pooled_bytes_[key.heap_id] += key.size;
+
+  return true;
+}
+
+void Allocator::EvictLocked(std::list<PooledBuffer>::iterator it) {
+  pooled_bytes_[it->heap_id] -= it->size;
+  backend_->FreeBuffer(nullptr, it->size, 0, it->fd, it->fd);
+  buffer_pool_.erase(it);
+}
+
+void Allocator::TrimExpiredLocked(std::chrono::steady_clock::time_point now) {
+  while (!buffer_pool_.empty() && (now - buffer_pool_.front().release_time) > kPoolMaxAge) {
+    EvictLocked(buffer_pool_.begin());
+  }
+}
+
+bool Allocator::TrimBufferPool() {
+  bool trimmed = TrimReserve();
+
+  std::lock_guard<std::mutex> lock(pool_lock_);
+  trimmed |= !buffer_pool_.empty();
+  while (!buffer_pool_.empty()) {
+    EvictLocked(buffer_pool_.begin());
+  }
+
+  return trimmed;
+}
+
 int Allocator::CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op,
                            int fd) {
-  if (ion_allocator_) {
-    return ion_allocator_->CleanBuffer(base, size, offset, handle, op, fd);
+  if (backend_) {
+    return backend_->CleanBuffer(base, size, offset, handle, op, fd);
+  }
+
+  return -EINVAL;
+}
+
+int Allocator::SetBufferName(int fd, const char *name) {
+  if (backend_) {
+    return backend_->SetBufferName(fd, name);
   }
 
   return -EINVAL;
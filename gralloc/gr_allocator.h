@@ -30,9 +30,16 @@
 #ifndef __GR_ALLOCATOR_H__
 #define __GR_ALLOCATOR_H__
 
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "gr_buf_descriptor.h"
+#include "gr_dma_heap_alloc.h"
 #include "gr_ion_alloc.h"
 #include "gr_utils.h"
 #include "gralloc_priv.h"
@@ -46,21 +53,82 @@ class Allocator {
   bool Init();
   void SetProperties(gralloc::GrallocProperties props);
   int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
+  int UnmapBuffer(void *base, unsigned int size, unsigned int offset);
   int ImportBuffer(int fd);
   int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int handle);
   int CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op, int fd);
+  int SetBufferName(int fd, const char *name);
   int AllocateMem(AllocData *data, uint64_t usage, int format);
   // @return : index of the descriptor with maximum buffer size req
   bool CheckForBufferSharing(uint32_t num_descriptors,
                              const std::vector<std::shared_ptr<BufferDescriptor>> &descriptors,
                              ssize_t *max_index);
+  // Releases all buffers held by the recycling pool and the zeroed reserve, returns false if
+  // both were empty
+  bool TrimBufferPool();
+
  private:
+  // Buffer freed by its owner and kept around for reuse by an allocation of the same kind
+  struct PooledBuffer {
+    int fd = -1;
+    unsigned int size = 0;
+    unsigned int heap_id = 0;
+    unsigned int flags = 0;
+    bool uncached = false;
+    std::chrono::steady_clock::time_point release_time;
+  };
+
+  // Allocation parameters of buffers allocated by this process, to recognize them on free
+  struct PoolKey {
+    unsigned int size = 0;
+    unsigned int heap_id = 0;
+    unsigned int flags = 0;
+    bool uncached = false;
+  };
+
   void GetIonHeapInfo(uint64_t usage, unsigned int *ion_heap_id, unsigned int *alloc_type,
                       unsigned int *ion_flags);
+  // Allocates from dma-buf heaps when enabled and the heap has an equivalent, ion otherwise
+  int AllocateFromBackend(AllocData *data);
+  bool AllocateFromPool(AllocData *data);
+  bool AllocateFromReserve(AllocData *data);
+  // Refills the zeroed reserve while allocations are idle
+  void ReserveThread();
+  // Caller must hold reserve_lock_
+  bool GetMissingReserveLocked(PoolKey *key);
+  bool TrimReserve();
+  bool ReleaseToPool(void *base, unsigned int size, unsigned int offset, int fd);
+  // Caller must hold pool_lock_
+  void EvictLocked(std::list<PooledBuffer>::iterator it);
+  void TrimExpiredLocked(std::chrono::steady_clock::time_point now);
 
   IonAlloc *ion_allocator_ = NULL;
+  DmaHeapAlloc *dma_heap_allocator_ = NULL;
+  // Maps, cleans and frees the dma-buf fds of either backend
+  AllocBackend *backend_ = NULL;
 
   bool use_system_heap_for_sensors_ = true;
+  bool use_dma_buf_heaps_ = true;
+
+  bool buffer_pool_enabled_ = false;
+  uint64_t buffer_pool_heap_budget_ = 0;
+  std::mutex pool_lock_;
+  std::list<PooledBuffer> buffer_pool_;  // Oldest first
+  std::map<unsigned int, uint64_t> pooled_bytes_;  // Per ion heap mask
+  std::map<int, PoolKey> allocated_buffers_;  // Keyed by fd, only tracked with the pool enabled
+
+  // Freshly allocated buffers, zeroed by the kernel off the allocating thread, for the large
+  // size classes allocated most recently. Secure buffers are never reserved.
+  bool zeroed_reserve_enabled_ = false;
+  uint64_t zeroed_reserve_budget_ = 0;
+  std::mutex reserve_lock_;
+  std::condition_variable reserve_cv_;
+  std::thread reserve_thread_;
+  bool reserve_exit_ = false;
+  std::chrono::steady_clock::time_point last_alloc_time_;
+  std::list<PoolKey> reserve_classes_;  // Most recently allocated first
+  std::list<AllocData> reserve_;
+  uint64_t reserve_bytes_ = 0;
 };
 
 }  // namespace gralloc
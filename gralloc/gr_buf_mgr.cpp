@@ -21,15 +21,20 @@
 
 #include "gr_buf_mgr.h"
 
+#include <cutils/properties.h>
 #include <QtiGralloc.h>
 #include <QtiGrallocPriv.h>
 #include <gralloctypes/Gralloc4.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <fstream>
@@ -113,6 +118,14 @@ static int validateAndMap(private_handle_t *handle, uint64_t reserved_region_siz
   return 0;
 }
 
+static uint64_t getDmaBufInode(int fd) {
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    return 0;
+  }
+  return static_cast<uint64_t>(st.st_ino);
+}
+
 static Error dataspaceToColorMetadata(Dataspace dataspace, ColorMetaData *color_metadata) {
   ColorMetaData out;
   uint32_t primaries = (uint32_t)dataspace & (uint32_t)Dataspace::STANDARD_MASK;
@@ -692,10 +705,13 @@ static Error getFormatLayout(private_handle_t *handle, std::vector<PlaneLayout>
   return Error::NONE;
 }
 
+constexpr uint32_t BufferManager::kNumShards;
+
 BufferManager::BufferManager() : next_id_(0) {
-  handles_map_.clear();
   allocator_ = new Allocator();
   allocator_->Init();
+  map_budget_ = uint64_t(property_get_int32("vendor.gralloc.map_budget_mb", 0)) * 1024 * 1024;
+  usage_stats_sample_ = UINT(property_get_int32("vendor.gralloc.usage_stats_sample", 1));
 }
 
 BufferManager *BufferManager::GetInstance() {
@@ -712,26 +728,49 @@ BufferManager::~BufferManager() {
 void BufferManager::SetGrallocDebugProperties(gralloc::GrallocProperties props) {
   allocator_->SetProperties(props);
   AdrenoMemInfo::GetInstance()->AdrenoSetProperties(props);
+  large_page_min_size_ = props.large_page_min_kb * 1024;
 }
 
 Error BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
   auto hnd = buf->handle;
   ALOGD_IF(DEBUG, "FreeBuffer handle:%p", hnd);
+  ForgetMappingLocked(buf);
 
   if (private_handle_t::validate(hnd) != 0) {
     ALOGE("FreeBuffer: Invalid handle: %p", hnd);
     return Error::BAD_BUFFER;
   }
 
+  if (buf->usage_accounted) {
+    UsageStats &stats = usage_stats_[buf->usage_bucket];
+    stats.buffers--;
+    stats.bytes -= hnd->size;
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED) {
+      stats.ubwc_bytes -= hnd->size;
+    }
+    if (buf->large_pages) {
+      stats.large_page_bytes -= hnd->size;
+    }
+  }
+
   auto meta_size = getMetaDataSize(buf->reserved_size);
 
-  if (allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset, hnd->fd,
-                             buf->ion_handle_main) != 0) {
+  // Mappings still used by other handles of the same dma-buf stay, only the fds are closed
+  void *base = reinterpret_cast<void *>(hnd->base);
+  if (base && !ReleaseMapping(&data_mappings_, buf->data_inode)) {
+    base = nullptr;
+  }
+  void *base_metadata = reinterpret_cast<void *>(hnd->base_metadata);
+  if (base_metadata && !ReleaseMapping(&meta_mappings_, buf->meta_inode)) {
+    base_metadata = nullptr;
+  }
+
+  if (allocator_->FreeBuffer(base, hnd->size, hnd->offset, hnd->fd, buf->ion_handle_main) != 0) {
     return Error::BAD_BUFFER;
   }
 
-  if (allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base_metadata), meta_size,
-                             hnd->offset_metadata, hnd->fd_metadata, buf->ion_handle_meta) != 0) {
+  if (allocator_->FreeBuffer(base_metadata, meta_size, hnd->offset_metadata, hnd->fd_metadata,
+                             buf->ion_handle_meta) != 0) {
     return Error::BAD_BUFFER;
   }
 
@@ -751,17 +790,35 @@ Error BufferManager::ValidateBufferSize(private_handle_t const *hnd, BufferInfo
   if (ret < 0) {
     return Error::BAD_BUFFER;
   }
+  // Buffers allocated in large page chunks are larger than their layout.
   auto ion_fd_size = static_cast<unsigned int>(lseek(hnd->fd, 0, SEEK_END));
-  if (size != ion_fd_size) {
+  if (size > ion_fd_size) {
     return Error::BAD_VALUE;
   }
   return Error::NONE;
 }
 
-void BufferManager::RegisterHandleLocked(const private_handle_t *hnd, int ion_handle,
-                                         int ion_handle_meta) {
+std::shared_ptr<BufferManager::Buffer> BufferManager::RegisterHandleLocked(
+    const private_handle_t *hnd, int ion_handle, int ion_handle_meta, bool imported) {
   auto buffer = std::make_shared<Buffer>(hnd, ion_handle, ion_handle_meta);
 
+  // Sampling by id keeps the same buffers counted in every process they are imported to
+  if (usage_stats_sample_ && (hnd->id % usage_stats_sample_) == 0) {
+    buffer->usage_accounted = true;
+    buffer->usage_bucket = GetUsageBucket(hnd->usage);
+    UsageStats &stats = usage_stats_[buffer->usage_bucket];
+    if (imported) {
+      stats.imports++;
+    } else {
+      stats.allocations++;
+    }
+    stats.buffers++;
+    stats.bytes += hnd->size;
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED) {
+      stats.ubwc_bytes += hnd->size;
+    }
+  }
+
   if (hnd->base_metadata) {
     auto metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
 #ifdef METADATA_V2
@@ -778,7 +835,9 @@ void BufferManager::RegisterHandleLocked(const private_handle_t *hnd, int ion_ha
 #endif
   }
 
-  handles_map_.emplace(std::make_pair(hnd, buffer));
+  GetShard(hnd).handles_map.emplace(std::make_pair(hnd, buffer));
+  PublishHandle(hnd);
+  return buffer;
 }
 
 Error BufferManager::ImportHandleLocked(private_handle_t *hnd) {
@@ -806,24 +865,167 @@ Error BufferManager::ImportHandleLocked(private_handle_t *hnd) {
   hnd->base_metadata = 0;
   hnd->gpuaddr = 0;
 
-  if (validateAndMap(hnd)) {
+  uint64_t meta_inode = 0;
+  if (MapMetadataShared(hnd, &meta_inode)) {
     ALOGE("Failed to map metadata: hnd: %p, fd:%d, id:%" PRIu64, hnd, hnd->fd, hnd->id);
     return Error::BAD_BUFFER;
   }
 
-  RegisterHandleLocked(hnd, ion_handle, ion_handle_meta);
-  allocated_ += hnd->size;
+  auto buf = RegisterHandleLocked(hnd, ion_handle, ion_handle_meta, true);
+  buf->meta_inode = meta_inode;
+  return Error::NONE;
+}
+
+int BufferManager::MapMetadataShared(private_handle_t *hnd, uint64_t *inode) {
+  *inode = getDmaBufInode(hnd->fd_metadata);
+  std::lock_guard<std::mutex> lock(mapping_lock_);
+  auto it = *inode ? meta_mappings_.find(*inode) : meta_mappings_.end();
+  if (it != meta_mappings_.end()) {
+    hnd->base_metadata = reinterpret_cast<uintptr_t>(it->second.base);
+    it->second.refs++;
+    return 0;
+  }
+
+  if (validateAndMap(hnd)) {
+    return -1;
+  }
+  if (*inode) {
+    meta_mappings_[*inode] = {reinterpret_cast<void *>(hnd->base_metadata), 1};
+  }
+
+  return 0;
+}
+
+Error BufferManager::MapBufferShared(std::shared_ptr<Buffer> buf) {
+  private_handle_t *hnd = const_cast<private_handle_t *>(buf->handle);
+  uint64_t inode = getDmaBufInode(hnd->fd);
+  std::lock_guard<std::mutex> lock(mapping_lock_);
+  auto it = inode ? data_mappings_.find(inode) : data_mappings_.end();
+  if (it != data_mappings_.end()) {
+    hnd->base = reinterpret_cast<uintptr_t>(it->second.base);
+    it->second.refs++;
+    buf->data_inode = inode;
+    return Error::NONE;
+  }
+
+  auto err = MapBuffer(hnd);
+  if (err == Error::NONE && inode) {
+    data_mappings_[inode] = {reinterpret_cast<void *>(hnd->base), 1};
+    buf->data_inode = inode;
+  }
+
+  return err;
+}
+
+bool BufferManager::ReleaseMapping(SharedMappings *mappings, uint64_t inode) {
+  if (!inode) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mapping_lock_);
+  auto it = mappings->find(inode);
+  if (it == mappings->end()) {
+    return true;
+  }
+  if (--it->second.refs) {
+    return false;
+  }
+
+  mappings->erase(it);
+  return true;
+}
+
+BufferManager::UsageBucket BufferManager::GetUsageBucket(uint64_t usage) {
+  if (usage & (BufferUsage::CAMERA_OUTPUT | BufferUsage::CAMERA_INPUT)) {
+    return kUsageCamera;
+  }
+  if (usage & (BufferUsage::VIDEO_ENCODER | BufferUsage::VIDEO_DECODER)) {
+    return kUsageVideo;
+  }
+  if (usage & (BufferUsage::GPU_RENDER_TARGET | BufferUsage::GPU_TEXTURE)) {
+    return kUsageGpu;
+  }
+  if (usage & (BufferUsage::COMPOSER_OVERLAY | BufferUsage::COMPOSER_CLIENT_TARGET)) {
+    return kUsageComposer;
+  }
+  if (usage & (BufferUsage::CPU_READ_MASK | BufferUsage::CPU_WRITE_MASK)) {
+    return kUsageCpu;
+  }
+
+  return kUsageOther;
+}
+
+BufferManager::Shard &BufferManager::GetShard(const private_handle_t *hnd) {
+  // Handles are heap allocated, drop the low bits that are the same for all of them.
+  uintptr_t key = reinterpret_cast<uintptr_t>(hnd) >> 4;
+  return shards_[(key ^ (key >> 8)) % kNumShards];
+}
+
+void BufferManager::PublishHandle(const private_handle_t *hnd) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(hnd) >> 4;
+  for (uint32_t i = 0; i < kHandleTableProbes; i++) {
+    HandleSlot &slot = handle_table_[(key + i) % kHandleTableSize];
+    const private_handle_t *expected = nullptr;
+    // Readers see the previous id until it is stored below, and fall back to the shard lookup.
+    if (slot.handle.compare_exchange_strong(expected, hnd, std::memory_order_acq_rel)) {
+      slot.id.store(hnd->id, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+void BufferManager::UnpublishHandle(const private_handle_t *hnd) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(hnd) >> 4;
+  for (uint32_t i = 0; i < kHandleTableProbes; i++) {
+    HandleSlot &slot = handle_table_[(key + i) % kHandleTableSize];
+    if (slot.handle.load(std::memory_order_relaxed) == hnd) {
+      slot.handle.store(nullptr, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+bool BufferManager::IsHandlePublished(const private_handle_t *hnd) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(hnd) >> 4;
+  for (uint32_t i = 0; i < kHandleTableProbes; i++) {
+    HandleSlot &slot = handle_table_[(key + i) % kHandleTableSize];
+    if (slot.handle.load(std::memory_order_acquire) == hnd) {
+      return slot.id.load(std::memory_order_acquire) == hnd->id;
+    }
+  }
+  return false;
+}
+
+bool BufferManager::IsHandleValid(const private_handle_t *hnd) {
+  if (IsHandlePublished(hnd)) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
+  return GetBufferFromHandleLocked(hnd) != nullptr;
+}
+
+void BufferManager::AddImportedSize(uint64_t size) {
+  std::lock_guard<std::mutex> lock(dump_lock_);
+  allocated_ += size;
   if (allocated_ >=  kAllocThreshold) {
     kAllocThreshold += kMemoryOffset;
     BuffersDump();
   }
-  return Error::NONE;
+}
+
+void BufferManager::RemoveImportedSize(uint64_t size) {
+  std::lock_guard<std::mutex> lock(dump_lock_);
+  if (allocated_ >= size) {
+    allocated_ -= size;
+  }
 }
 
 std::shared_ptr<BufferManager::Buffer> BufferManager::GetBufferFromHandleLocked(
     const private_handle_t *hnd) {
-  auto it = handles_map_.find(hnd);
-  if (it != handles_map_.end()) {
+  auto &handles_map = GetShard(hnd).handles_map;
+  auto it = handles_map.find(hnd);
+  if (it != handles_map.end()) {
     return it->second;
   } else {
     return nullptr;
@@ -843,7 +1045,7 @@ Error BufferManager::MapBuffer(private_handle_t const *handle) {
 }
 
 Error BufferManager::IsBufferImported(const private_handle_t *hnd) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
   auto buf = GetBufferFromHandleLocked(hnd);
   if (buf != nullptr) {
     return Error::NONE;
@@ -854,81 +1056,108 @@ Error BufferManager::IsBufferImported(const private_handle_t *hnd) {
 Error BufferManager::RetainBuffer(private_handle_t const *hnd) {
   ALOGD_IF(DEBUG, "Retain buffer handle:%p id: %" PRIu64, hnd, hnd->id);
   auto err = Error::NONE;
-  std::lock_guard<std::mutex> lock(buffer_lock_);
-  auto buf = GetBufferFromHandleLocked(hnd);
-  if (buf != nullptr) {
-    buf->IncRef();
-  } else {
+  {
+    std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
+    auto buf = GetBufferFromHandleLocked(hnd);
+    if (buf != nullptr) {
+      buf->IncRef();
+      return err;
+    }
+
     private_handle_t *handle = const_cast<private_handle_t *>(hnd);
     err = ImportHandleLocked(handle);
   }
+
+  if (err == Error::NONE) {
+    AddImportedSize(hnd->size);
+  }
   return err;
 }
 
 Error BufferManager::ReleaseBuffer(private_handle_t const *hnd) {
   ALOGD_IF(DEBUG, "Release buffer handle:%p", hnd);
-  std::lock_guard<std::mutex> lock(buffer_lock_);
-  auto buf = GetBufferFromHandleLocked(hnd);
-  if (buf == nullptr) {
-    ALOGE("Could not find handle: %p id: %" PRIu64, hnd, hnd->id);
-    return Error::BAD_BUFFER;
-  } else {
-    if (buf->DecRef()) {
-      handles_map_.erase(hnd);
-      // Unmap, close ion handle and close fd
-      if (allocated_ >= hnd->size) {
-        allocated_ -= hnd->size;
+  uint64_t freed_size = 0;
+  {
+    Shard &shard = GetShard(hnd);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto buf = GetBufferFromHandleLocked(hnd);
+    if (buf == nullptr) {
+      ALOGE("Could not find handle: %p id: %" PRIu64, hnd, hnd->id);
+      return Error::BAD_BUFFER;
+    } else {
+      if (buf->DecRef()) {
+        UnpublishHandle(hnd);
+        shard.handles_map.erase(hnd);
+        // Unmap, close ion handle and close fd
+        freed_size = hnd->size;
+        FreeBuffer(buf);
       }
-      FreeBuffer(buf);
     }
   }
+
+  if (freed_size) {
+    RemoveImportedSize(freed_size);
+  }
   return Error::NONE;
 }
 
 Error BufferManager::LockBuffer(const private_handle_t *hnd, uint64_t usage) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
   auto err = Error::NONE;
-  ALOGD_IF(DEBUG, "LockBuffer buffer handle:%p id: %" PRIu64, hnd, hnd->id);
+  {
+    std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
+    ALOGD_IF(DEBUG, "LockBuffer buffer handle:%p id: %" PRIu64, hnd, hnd->id);
 
-  // If buffer is not meant for CPU return err
-  if (!CpuCanAccess(usage)) {
-    return Error::BAD_VALUE;
-  }
+    // If buffer is not meant for CPU return err
+    if (!CpuCanAccess(usage)) {
+      return Error::BAD_VALUE;
+    }
 
-  auto buf = GetBufferFromHandleLocked(hnd);
-  if (buf == nullptr) {
-    return Error::BAD_BUFFER;
-  }
+    auto buf = GetBufferFromHandleLocked(hnd);
+    if (buf == nullptr) {
+      return Error::BAD_BUFFER;
+    }
 
-  if (hnd->base == 0) {
-    // we need to map for real
-    err = MapBuffer(hnd);
-  }
+    if (hnd->base == 0) {
+      // we need to map for real
+      err = MapBufferShared(buf);
+      buf->lock_mapped = (err == Error::NONE);
+    }
 
-  // Invalidate if CPU reads in software and there are non-CPU
-  // writers. No need to do this for the metadata buffer as it is
-  // only read/written in software.
+    if (err != Error::NONE) {
+      return err;
+    }
 
-  // todo use handle here
-  if (err == Error::NONE && (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
-      (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED)) {
-    if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
-                                buf->ion_handle_main, CACHE_INVALIDATE, hnd->fd)) {
-      return Error::BAD_BUFFER;
+    bool cached = (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
+                  (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED);
+
+    // Invalidate if there are non-CPU writers, lines cached by the CPU stay coherent otherwise.
+    // This holds for write locks too, a partial write would clean stale lines back to memory.
+    // No need to do this for the metadata buffer as it is only read/written in software.
+    if (cached && NonCpuCanWrite(hnd->usage)) {
+      if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
+                                  buf->ion_handle_main, CACHE_INVALIDATE, hnd->fd)) {
+        return Error::BAD_BUFFER;
+      }
+      buf->cpu_read_synced = true;
     }
-  }
 
-  // Mark the buffer to be flushed after CPU write.
-  if (err == Error::NONE && CpuCanWrite(usage)) {
-    private_handle_t *handle = const_cast<private_handle_t *>(hnd);
-    handle->flags |= private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
+    // Mark the buffer to be flushed after CPU write.
+    if (cached && CpuCanWrite(usage)) {
+      private_handle_t *handle = const_cast<private_handle_t *>(hnd);
+      handle->flags |= private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
+    }
+
+    buf->lock_count++;
+    TouchMappingLocked(buf);
   }
 
+  TrimMappings();
+
   return err;
 }
 
 Error BufferManager::FlushBuffer(const private_handle_t *handle) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetShard(handle).lock);
   auto status = Error::NONE;
 
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
@@ -946,7 +1175,7 @@ Error BufferManager::FlushBuffer(const private_handle_t *handle) {
 }
 
 Error BufferManager::RereadBuffer(const private_handle_t *handle) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetShard(handle).lock);
   auto status = Error::NONE;
 
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
@@ -964,7 +1193,7 @@ Error BufferManager::RereadBuffer(const private_handle_t *handle) {
 }
 
 Error BufferManager::UnlockBuffer(const private_handle_t *handle) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
+  std::lock_guard<std::mutex> lock(GetShard(handle).lock);
   auto status = Error::NONE;
 
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
@@ -979,46 +1208,182 @@ Error BufferManager::UnlockBuffer(const private_handle_t *handle) {
       status = Error::BAD_BUFFER;
     }
     hnd->flags &= ~private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
-  } else {
+  } else if (buf->cpu_read_synced) {
     if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
                                 buf->ion_handle_main, CACHE_READ_DONE, hnd->fd) != 0) {
       status = Error::BAD_BUFFER;
     }
   }
+  buf->cpu_read_synced = false;
+
+  if (buf->lock_count > 0) {
+    buf->lock_count--;
+  }
 
   return status;
 }
 
+void BufferManager::TouchMappingLocked(std::shared_ptr<Buffer> buf) {
+  if (!map_budget_ || !buf->lock_mapped) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(map_lru_lock_);
+  if (!buf->in_map_lru) {
+    buf->map_lru_it = map_lru_.insert(map_lru_.end(), buf->handle);
+    buf->in_map_lru = true;
+    lock_mapped_bytes_ += buf->handle->size;
+  } else {
+    map_lru_.splice(map_lru_.end(), map_lru_, buf->map_lru_it);
+  }
+}
+
+void BufferManager::ForgetMappingLocked(std::shared_ptr<Buffer> buf) {
+  if (!map_budget_ || !buf->lock_mapped) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(map_lru_lock_);
+  if (buf->in_map_lru) {
+    map_lru_.erase(buf->map_lru_it);
+    buf->in_map_lru = false;
+    lock_mapped_bytes_ -= buf->handle->size;
+  }
+  buf->lock_mapped = false;
+}
+
+void BufferManager::TrimMappings() {
+  std::vector<const private_handle_t *> candidates;
+  {
+    std::lock_guard<std::mutex> lock(map_lru_lock_);
+    if (!map_budget_ || lock_mapped_bytes_ <= map_budget_) {
+      return;
+    }
+
+    uint64_t excess = lock_mapped_bytes_ - map_budget_;
+    uint64_t candidate_bytes = 0;
+    for (auto it = map_lru_.begin(); it != map_lru_.end() && candidate_bytes < excess; it++) {
+      candidates.push_back(*it);
+      candidate_bytes += (*it)->size;
+    }
+  }
+
+  // Candidates may have been locked or freed meanwhile, check again under their shard lock
+  for (auto hnd : candidates) {
+    std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
+    auto buf = GetBufferFromHandleLocked(hnd);
+    if (buf == nullptr || buf->lock_count || !buf->lock_mapped) {
+      continue;
+    }
+
+    private_handle_t *handle = const_cast<private_handle_t *>(hnd);
+    ForgetMappingLocked(buf);
+    if (ReleaseMapping(&data_mappings_, buf->data_inode)) {
+      allocator_->UnmapBuffer(reinterpret_cast<void *>(handle->base), handle->size,
+                              handle->offset);
+    }
+    buf->data_inode = 0;
+    handle->base = 0;
+    ALOGD_IF(DEBUG, "Unmapped idle buffer handle:%p id: %" PRIu64, hnd, hnd->id);
+  }
+}
+
+Error BufferManager::GetBufferLayout(const BufferDescriptor &descriptor, unsigned int bufferSize,
+                                     BufferLayout *layout) {
+  uint64_t usage = descriptor.GetUsage();
+  layout->format = GetImplDefinedFormat(usage, descriptor.GetFormat());
+  layout->buffer_type = GetBufferType(layout->format);
+
+  BufferInfo info = GetBufferInfo(descriptor);
+  info.format = layout->format;
+  info.layer_count = descriptor.GetLayerCount();
+
+  int err = GetBufferSizeAndDimensions(info, &layout->size, &layout->alignedw, &layout->alignedh,
+                                       &layout->graphics_metadata);
+  if (err < 0) {
+    return Error::BAD_DESCRIPTOR;
+  }
+
+  layout->size = (bufferSize >= layout->size) ? bufferSize : layout->size;
+  return Error::NONE;
+}
+
 Error BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_handle_t *handle,
                                     unsigned int bufferSize, bool testAlloc) {
   if (!handle)
     return Error::BAD_BUFFER;
-  std::lock_guard<std::mutex> buffer_lock(buffer_lock_);
 
-  uint64_t usage = descriptor.GetUsage();
-  int format = GetImplDefinedFormat(usage, descriptor.GetFormat());
-  uint32_t layer_count = descriptor.GetLayerCount();
+  BufferLayout layout;
+  Error error = GetBufferLayout(descriptor, bufferSize, &layout);
+  if (error != Error::NONE || testAlloc) {
+    return error;
+  }
 
-  unsigned int size;
-  unsigned int alignedw, alignedh;
-  int err = 0;
+  return AllocateBufferWithLayout(descriptor, layout, handle);
+}
 
-  int buffer_type = GetBufferType(format);
-  BufferInfo info = GetBufferInfo(descriptor);
-  info.format = format;
-  info.layer_count = layer_count;
+Error BufferManager::AllocateBuffers(const BufferDescriptor &descriptor, uint32_t count,
+                                     std::vector<buffer_handle_t> *handles) {
+  handles->clear();
+  BufferLayout layout;
+  Error error = GetBufferLayout(descriptor, 0, &layout);
+  if (error != Error::NONE || !count) {
+    return error;
+  }
+
+  // Secure heaps allocate out of a carveout one buffer at a time, only spread system heap
+  // allocations over threads.
+  handles->resize(count, nullptr);
+  std::vector<Error> errors(count, Error::NONE);
+  bool parallel = (count > 1) && (layout.size >= kParallelAllocSize) &&
+                  !(descriptor.GetUsage() & BufferUsage::PROTECTED);
+  uint32_t num_threads = parallel ? std::min(count, kMaxParallelAllocs) : 1;
+  auto allocate = [&](uint32_t first) {
+    for (uint32_t i = first; i < count; i += num_threads) {
+      errors[i] = AllocateBufferWithLayout(descriptor, layout, &(*handles)[i]);
+    }
+  };
 
-  GraphicsMetadata graphics_metadata = {};
-  err = GetBufferSizeAndDimensions(info, &size, &alignedw, &alignedh, &graphics_metadata);
-  if (err < 0) {
-    return Error::BAD_DESCRIPTOR;
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(allocate, i);
+  }
+  allocate(0);
+  for (auto &thread : threads) {
+    thread.join();
   }
 
-  if (testAlloc) {
-    return Error::NONE;
+  for (uint32_t i = 0; i < count; i++) {
+    if (errors[i] != Error::NONE) {
+      error = errors[i];
+    }
+  }
+
+  if (error != Error::NONE) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (errors[i] == Error::NONE) {
+        ReleaseBuffer(static_cast<const private_handle_t *>((*handles)[i]));
+      }
+    }
+    handles->clear();
   }
 
-  size = (bufferSize >= size) ? bufferSize : size;
+  return error;
+}
+
+Error BufferManager::AllocateBufferWithLayout(const BufferDescriptor &descriptor,
+                                              const BufferLayout &layout,
+                                              buffer_handle_t *handle) {
+  uint64_t usage = descriptor.GetUsage();
+  int format = layout.format;
+  int buffer_type = layout.buffer_type;
+  uint32_t layer_count = descriptor.GetLayerCount();
+  unsigned int size = layout.size;
+  unsigned int alignedw = layout.alignedw;
+  unsigned int alignedh = layout.alignedh;
+  GraphicsMetadata graphics_metadata = layout.graphics_metadata;
+  int err = 0;
+
   uint64_t flags = 0;
   auto page_size = UINT(getpagesize());
   AllocData data;
@@ -1027,8 +1392,27 @@ Error BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_h
   data.handle = (uintptr_t)handle;
   data.uncached = UseUncached(format, usage);
 
+  // Heaps back an allocation from their largest free pages that fit in what is left of it, a
+  // size in whole large pages keeps scanout buffers off 4 KB pages and eases the SMMU TLB of the
+  // display. Allocated as is when the heap is out of large pages.
+  unsigned int large_page = GetLargePageSize(usage, size, large_page_min_size_);
+  if (large_page) {
+    data.size = ALIGN(size, large_page);
+    data.align = std::max(data.align, large_page);
+    err = allocator_->AllocateMem(&data, usage, format);
+    if (err) {
+      ALOGW("gralloc failed to allocate %u bytes in %u byte chunks, falling back", data.size,
+            large_page);
+      large_page = 0;
+      data.size = size;
+      data.align = GetDataAlignment(format, usage);
+    }
+  }
+
   // Allocate buffer memory
-  err = allocator_->AllocateMem(&data, usage, format);
+  if (!large_page) {
+    err = allocator_->AllocateMem(&data, usage, format);
+  }
   if (err) {
     ALOGE("gralloc failed to allocate err=%s format %d size %d WxH %dx%d usage %" PRIu64,
           strerror(-err), format, size, alignedw, alignedh, usage);
@@ -1050,6 +1434,15 @@ Error BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_h
   flags = GetHandleFlags(format, usage);
   flags |= data.alloc_type;
 
+  // libmemtrack attributes the graphics memory of a process by these names
+  static const char *kBufferNames[kNumUsageBuckets][2] = {
+    {"gralloc-camera", "gralloc-camera-ubwc"}, {"gralloc-video", "gralloc-video-ubwc"},
+    {"gralloc-gpu", "gralloc-gpu-ubwc"},       {"gralloc-composer", "gralloc-composer-ubwc"},
+    {"gralloc-cpu", "gralloc-cpu-ubwc"},       {"gralloc-other", "gralloc-other-ubwc"},
+  };
+  bool ubwc = flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED;
+  allocator_->SetBufferName(data.fd, kBufferNames[GetUsageBucket(usage)][ubwc ? 1 : 0]);
+
   // Create handle
   private_handle_t *hnd = new private_handle_t(
       data.fd, e_data.fd, INT(flags), INT(alignedw), INT(alignedh), descriptor.GetWidth(),
@@ -1095,7 +1488,16 @@ Error BufferManager::AllocateBuffer(const BufferDescriptor &descriptor, buffer_h
 
   *handle = hnd;
 
-  RegisterHandleLocked(hnd, data.ion_handle, e_data.ion_handle);
+  {
+    std::lock_guard<std::mutex> lock(GetShard(hnd).lock);
+    auto buffer = RegisterHandleLocked(hnd, data.ion_handle, e_data.ion_handle, false);
+    if (large_page) {
+      buffer->large_pages = true;
+      if (buffer->usage_accounted) {
+        usage_stats_[buffer->usage_bucket].large_page_bytes += hnd->size;
+      }
+    }
+  }
   ALOGD_IF(DEBUG, "Allocated buffer handle: %p id: %" PRIu64, hnd, hnd->id);
   if (DEBUG) {
     private_handle_t::Dump(hnd);
@@ -1123,18 +1525,26 @@ void BufferManager:: BuffersDump() {
   }
   fs << "============================" << std::endl;
   fs << timeStamp << std::endl;
-  fs << "Total layers = " << handles_map_.size() << std::endl;
+  // Shards are dumped one at a time, buffers imported or freed meanwhile may be missed.
+  std::ostringstream os;
+  size_t total_layers = 0;
   uint64_t totalAllocationSize = 0;
-  for (auto it : handles_map_) {
-    auto buf = it.second;
-    auto hnd = buf->handle;
-    auto metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
-    fs  << std::setw(80) << "Client:" << (metadata ? metadata->name: "No name");
-    fs  << std::setw(20) << "WxH:" << std::setw(4) << hnd->width << " x "
-        << std::setw(4) << hnd->height;
-    fs  << std::setw(20) << "Size: " << std::setw(9) << hnd->size <<  std::endl;
-    totalAllocationSize += hnd->size;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    total_layers += shard.handles_map.size();
+    for (auto it : shard.handles_map) {
+      auto buf = it.second;
+      auto hnd = buf->handle;
+      auto metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+      os  << std::setw(80) << "Client:" << (metadata ? metadata->name: "No name");
+      os  << std::setw(20) << "WxH:" << std::setw(4) << hnd->width << " x "
+          << std::setw(4) << hnd->height;
+      os  << std::setw(20) << "Size: " << std::setw(9) << hnd->size <<  std::endl;
+      totalAllocationSize += hnd->size;
+    }
   }
+  fs << "Total layers = " << total_layers << std::endl;
+  fs << os.str();
   fs << "Total allocation  = " << totalAllocationSize/1024 << "KiB" << std::endl;
   file_dump_.position = fs.tellp();
   if (file_dump_.position > (20 * 1024 * 1024)) {
@@ -1143,49 +1553,84 @@ void BufferManager:: BuffersDump() {
   fs.close();
 }
 
+void BufferManager::DumpUsageStats(std::ostringstream *os) {
+  static const char *kBucketNames[kNumUsageBuckets] = {"camera",   "video", "gpu",
+                                                       "composer", "cpu",   "other"};
+  if (!usage_stats_sample_) {
+    return;
+  }
+
+  *os << "Usage accounting, pid " << getpid() << ", 1 in " << usage_stats_sample_
+      << " buffers sampled" << std::endl;
+  uint64_t total_bytes = 0;
+  uint64_t total_large_page_bytes = 0;
+  for (int i = 0; i < kNumUsageBuckets; i++) {
+    const UsageStats &stats = usage_stats_[i];
+    uint64_t bytes = stats.bytes * usage_stats_sample_;
+    uint64_t ubwc_bytes = stats.ubwc_bytes * usage_stats_sample_;
+    total_bytes += bytes;
+    total_large_page_bytes += stats.large_page_bytes * usage_stats_sample_;
+    *os << std::setw(10) << kBucketNames[i] << ":";
+    *os << " buffers: " << std::setw(5) << stats.buffers * usage_stats_sample_;
+    *os << " KiB: " << std::setw(8) << bytes / 1024;
+    *os << " ubwc KiB: " << std::setw(8) << ubwc_bytes / 1024;
+    *os << " linear KiB: " << std::setw(8) << (bytes - ubwc_bytes) / 1024;
+    *os << " allocations: " << stats.allocations * usage_stats_sample_;
+    *os << " imports: " << stats.imports * usage_stats_sample_ << std::endl;
+  }
+  *os << "Large page chunks, from " << large_page_min_size_ / 1024 << " KiB: "
+      << total_large_page_bytes / 1024 << " KiB, "
+      << (total_bytes ? total_large_page_bytes * 100 / total_bytes : 0) << "% of live bytes"
+      << std::endl;
+}
+
 Error BufferManager::Dump(std::ostringstream *os) {
-  std::lock_guard<std::mutex> buffer_lock(buffer_lock_);
-  for (auto it : handles_map_) {
-    auto buf = it.second;
-    auto hnd = buf->handle;
-    *os << "handle id: " << std::setw(4) << hnd->id;
-    *os << " fd: " << std::setw(3) << hnd->fd;
-    *os << " fd_meta: " << std::setw(3) << hnd->fd_metadata;
-    *os << " wxh: " << std::setw(4) << hnd->width << " x " << std::setw(4) << hnd->height;
-    *os << " uwxuh: " << std::setw(4) << hnd->unaligned_width << " x ";
-    *os << std::setw(4) << hnd->unaligned_height;
-    *os << " size: " << std::setw(9) << hnd->size;
-    *os << std::hex << std::setfill('0');
-    *os << " priv_flags: "
-        << "0x" << std::setw(8) << hnd->flags;
-    *os << " usage: "
-        << "0x" << std::setw(8) << hnd->usage;
-    // TODO(user): get format string from qdutils
-    *os << " format: "
-        << "0x" << std::setw(8) << hnd->format;
-    *os << std::dec << std::setfill(' ') << std::endl;
+  DumpUsageStats(os);
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    for (auto it : shard.handles_map) {
+      auto buf = it.second;
+      auto hnd = buf->handle;
+      *os << "handle id: " << std::setw(4) << hnd->id;
+      *os << " fd: " << std::setw(3) << hnd->fd;
+      *os << " fd_meta: " << std::setw(3) << hnd->fd_metadata;
+      *os << " wxh: " << std::setw(4) << hnd->width << " x " << std::setw(4) << hnd->height;
+      *os << " uwxuh: " << std::setw(4) << hnd->unaligned_width << " x ";
+      *os << std::setw(4) << hnd->unaligned_height;
+      *os << " size: " << std::setw(9) << hnd->size;
+      *os << std::hex << std::setfill('0');
+      *os << " priv_flags: "
+          << "0x" << std::setw(8) << hnd->flags;
+      *os << " usage: "
+          << "0x" << std::setw(8) << hnd->usage;
+      // TODO(user): get format string from qdutils
+      *os << " format: "
+          << "0x" << std::setw(8) << hnd->format;
+      *os << std::dec << std::setfill(' ') << std::endl;
+    }
   }
   return Error::NONE;
 }
 
-// Get list of private handles in handles_map_
+// Get list of private handles in all shards
 Error BufferManager::GetAllHandles(std::vector<const private_handle_t *> *out_handle_list) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
-  if (handles_map_.empty()) {
-    return Error::NO_RESOURCES;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    for (auto handle : shard.handles_map) {
+      out_handle_list->push_back(handle.first);
+    }
   }
-  out_handle_list->reserve(handles_map_.size());
-  for (auto handle : handles_map_) {
-    out_handle_list->push_back(handle.first);
+  if (out_handle_list->empty()) {
+    return Error::NO_RESOURCES;
   }
   return Error::NONE;
 }
 
 Error BufferManager::GetReservedRegion(private_handle_t *handle, void **reserved_region,
                                        uint64_t *reserved_region_size) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
   if (!handle)
     return Error::BAD_BUFFER;
+  std::lock_guard<std::mutex> lock(GetShard(handle).lock);
 
   auto buf = GetBufferFromHandleLocked(handle);
   if (buf == nullptr)
@@ -1200,13 +1645,171 @@ Error BufferManager::GetReservedRegion(private_handle_t *handle, void **reserved
   return Error::NONE;
 }
 
+// Standard metadata types up to BLEND_MODE are the ones that can be scalars.
+static const int64_t kMaxFixedMetadataType = (int64_t)StandardMetadataType::BLEND_MODE;
+
+// Encoding of a scalar standard metadata type: the encoded metadata type followed by the raw
+// value, as laid out by the gralloc4 encoders.
+struct FixedMetadataEncoding {
+  std::vector<uint8_t> header;
+  size_t value_size = 0;
+};
+
+template <typename T, typename Encoder>
+static void InitFixedMetadataEncoding(FixedMetadataEncoding *encoding, Encoder encode) {
+  // Learn the header from the encoder itself, and only use it once the value is confirmed to
+  // follow it as is.
+  T value;
+  memset(&value, 0x5a, sizeof(value));
+  hidl_vec<uint8_t> encoded;
+  if (encode(value, &encoded) != android::NO_ERROR || encoded.size() <= sizeof(T)) {
+    return;
+  }
+
+  size_t header_size = encoded.size() - sizeof(T);
+  if (memcmp(encoded.data() + header_size, &value, sizeof(T)) != 0) {
+    return;
+  }
+
+  encoding->header.assign(encoded.data(), encoded.data() + header_size);
+  encoding->value_size = sizeof(T);
+}
+
+static const FixedMetadataEncoding *GetFixedMetadataEncoding(int64_t metadatatype_value) {
+  static FixedMetadataEncoding encodings[kMaxFixedMetadataType + 1];
+  static std::once_flag once;
+  std::call_once(once, [] {
+    using android::gralloc4::encodeAllocationSize;
+    using android::gralloc4::encodeBlendMode;
+    using android::gralloc4::encodeBufferId;
+    using android::gralloc4::encodeDataspace;
+    using android::gralloc4::encodeHeight;
+    using android::gralloc4::encodeLayerCount;
+    using android::gralloc4::encodePixelFormatFourCC;
+    using android::gralloc4::encodePixelFormatModifier;
+    using android::gralloc4::encodePixelFormatRequested;
+    using android::gralloc4::encodeProtectedContent;
+    using android::gralloc4::encodeUsage;
+    using android::gralloc4::encodeWidth;
+    InitFixedMetadataEncoding<uint64_t>(&encodings[(int64_t)StandardMetadataType::BUFFER_ID],
+                                        encodeBufferId);
+    InitFixedMetadataEncoding<uint64_t>(&encodings[(int64_t)StandardMetadataType::WIDTH],
+                                        encodeWidth);
+    InitFixedMetadataEncoding<uint64_t>(&encodings[(int64_t)StandardMetadataType::HEIGHT],
+                                        encodeHeight);
+    InitFixedMetadataEncoding<uint64_t>(&encodings[(int64_t)StandardMetadataType::LAYER_COUNT],
+                                        encodeLayerCount);
+    InitFixedMetadataEncoding<PixelFormat>(
+        &encodings[(int64_t)StandardMetadataType::PIXEL_FORMAT_REQUESTED],
+        encodePixelFormatRequested);
+    InitFixedMetadataEncoding<uint32_t>(
+        &encodings[(int64_t)StandardMetadataType::PIXEL_FORMAT_FOURCC], encodePixelFormatFourCC);
+    InitFixedMetadataEncoding<uint64_t>(
+        &encodings[(int64_t)StandardMetadataType::PIXEL_FORMAT_MODIFIER],
+        encodePixelFormatModifier);
+    InitFixedMetadataEncoding<uint64_t>(&encodings[(int64_t)StandardMetadataType::USAGE],
+                                        encodeUsage);
+    InitFixedMetadataEncoding<uint64_t>(
+        &encodings[(int64_t)StandardMetadataType::ALLOCATION_SIZE], encodeAllocationSize);
+    InitFixedMetadataEncoding<uint64_t>(
+        &encodings[(int64_t)StandardMetadataType::PROTECTED_CONTENT], encodeProtectedContent);
+    InitFixedMetadataEncoding<Dataspace>(&encodings[(int64_t)StandardMetadataType::DATASPACE],
+                                         encodeDataspace);
+    InitFixedMetadataEncoding<BlendMode>(&encodings[(int64_t)StandardMetadataType::BLEND_MODE],
+                                         encodeBlendMode);
+  });
+
+  if (metadatatype_value < 0 || metadatatype_value > kMaxFixedMetadataType ||
+      !encodings[metadatatype_value].value_size) {
+    return nullptr;
+  }
+
+  return &encodings[metadatatype_value];
+}
+
+Error BufferManager::GetFixedMetadata(private_handle_t *handle, int64_t metadatatype_value,
+                                      uint8_t *out_data, size_t capacity, size_t *out_size) {
+  const FixedMetadataEncoding *encoding = GetFixedMetadataEncoding(metadatatype_value);
+  if (!encoding || (encoding->header.size() + encoding->value_size) > capacity) {
+    return Error::UNSUPPORTED;
+  }
+
+  if (!handle || !IsHandleValid(handle) || !handle->base_metadata) {
+    return Error::BAD_BUFFER;
+  }
+
+  auto metadata = reinterpret_cast<MetaData_t *>(handle->base_metadata);
+  union {
+    uint64_t u64;
+    uint32_t u32;
+    PixelFormat pixel_format;
+    Dataspace dataspace;
+    BlendMode blend_mode;
+  } value = {};
+
+  uint32_t drm_format = 0;
+  uint64_t drm_format_modifier = 0;
+  switch (metadatatype_value) {
+    case (int64_t)StandardMetadataType::BUFFER_ID:
+      value.u64 = handle->id;
+      break;
+    case (int64_t)StandardMetadataType::WIDTH:
+      value.u64 = (uint64_t)handle->unaligned_width;
+      break;
+    case (int64_t)StandardMetadataType::HEIGHT:
+      value.u64 = (uint64_t)handle->unaligned_height;
+      break;
+    case (int64_t)StandardMetadataType::LAYER_COUNT:
+      value.u64 = (uint64_t)handle->layer_count;
+      break;
+    case (int64_t)StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+      value.pixel_format = (PixelFormat)handle->format;
+      break;
+    case (int64_t)StandardMetadataType::PIXEL_FORMAT_FOURCC:
+      GetDRMFormat(handle->format, handle->flags, &drm_format, &drm_format_modifier);
+      value.u32 = drm_format;
+      break;
+    case (int64_t)StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+      GetDRMFormat(handle->format, handle->flags, &drm_format, &drm_format_modifier);
+      value.u64 = drm_format_modifier;
+      break;
+    case (int64_t)StandardMetadataType::USAGE:
+      value.u64 = (uint64_t)handle->usage;
+      break;
+    case (int64_t)StandardMetadataType::ALLOCATION_SIZE:
+      value.u64 = (uint64_t)handle->size;
+      break;
+    case (int64_t)StandardMetadataType::PROTECTED_CONTENT:
+      value.u64 = (handle->flags & qtigralloc::PRIV_FLAGS_SECURE_BUFFER) ? 1 : 0;
+      break;
+    case (int64_t)StandardMetadataType::DATASPACE:
+      value.dataspace = Dataspace::UNKNOWN;
+#ifdef METADATA_V2
+      if (!metadata->isStandardMetadataSet[GET_STANDARD_METADATA_STATUS_INDEX(metadatatype_value)]) {
+        break;
+      }
+#endif
+      colorMetadataToDataspace(metadata->color, &value.dataspace);
+      break;
+    case (int64_t)StandardMetadataType::BLEND_MODE:
+      value.blend_mode = (BlendMode)metadata->blendMode;
+      break;
+    default:
+      return Error::UNSUPPORTED;
+  }
+
+  memcpy(out_data, encoding->header.data(), encoding->header.size());
+  memcpy(out_data + encoding->header.size(), &value, encoding->value_size);
+  *out_size = encoding->header.size() + encoding->value_size;
+
+  return Error::NONE;
+}
+
 Error BufferManager::GetMetadata(private_handle_t *handle, int64_t metadatatype_value,
                                  hidl_vec<uint8_t> *out) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
-  if (!handle)
-    return Error::BAD_BUFFER;
-  auto buf = GetBufferFromHandleLocked(handle);
-  if (buf == nullptr)
+  // Metadata is read without the shard lock, other processes write the shared region without it
+  // anyway.
+  if (!handle || !IsHandleValid(handle))
     return Error::BAD_BUFFER;
 
   if (!handle->base_metadata) {
@@ -1452,9 +2055,9 @@ Error BufferManager::GetMetadata(private_handle_t *handle, int64_t metadatatype_
 
 Error BufferManager::SetMetadata(private_handle_t *handle, int64_t metadatatype_value,
                                  hidl_vec<uint8_t> in) {
-  std::lock_guard<std::mutex> lock(buffer_lock_);
   if (!handle)
     return Error::BAD_BUFFER;
+  std::lock_guard<std::mutex> lock(GetShard(handle).lock);
 
   auto buf = GetBufferFromHandleLocked(handle);
   if (buf == nullptr)
@@ -22,6 +22,8 @@
 
 #include <pthread.h>
 
+#include <atomic>
+#include <list>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -37,10 +39,17 @@ namespace gralloc {
 using gralloc::Error;
 class BufferManager {
  public:
+  // Largest encoding GetFixedMetadata produces, a metadata type followed by a scalar.
+  static constexpr size_t kMaxFixedMetadataSize = 128;
+
   ~BufferManager();
 
   Error AllocateBuffer(const BufferDescriptor &descriptor, buffer_handle_t *handle,
                        unsigned int bufferSize = 0, bool testAlloc = false);
+  // Allocates count identical buffers, computing their layout once. On failure no buffer is left
+  // allocated and handles is empty.
+  Error AllocateBuffers(const BufferDescriptor &descriptor, uint32_t count,
+                        std::vector<buffer_handle_t> *handles);
   Error RetainBuffer(private_handle_t const *hnd);
   Error ReleaseBuffer(private_handle_t const *hnd);
   Error LockBuffer(const private_handle_t *hnd, uint64_t usage);
@@ -53,6 +62,10 @@ class BufferManager {
   void SetGrallocDebugProperties(gralloc::GrallocProperties props);
   Error GetMetadata(private_handle_t *handle, int64_t metadatatype_value, hidl_vec<uint8_t> *out);
   Error SetMetadata(private_handle_t *handle, int64_t metadatatype_value, hidl_vec<uint8_t> in);
+  // Encodes scalar standard metadata such as width, usage, dataspace or blend mode straight into
+  // out_data, skipping the gralloc4 encoders. Returns UNSUPPORTED for any other metadata type.
+  Error GetFixedMetadata(private_handle_t *handle, int64_t metadatatype_value, uint8_t *out_data,
+                         size_t capacity, size_t *out_size);
   Error GetReservedRegion(private_handle_t *handle, void **reserved_region,
                           uint64_t *reserved_region_size);
   Error FlushBuffer(const private_handle_t *handle);
@@ -63,11 +76,100 @@ class BufferManager {
   BufferManager();
   Error MapBuffer(private_handle_t const *hnd);
 
+  // Layout shared by all buffers allocated from one descriptor
+  struct BufferLayout {
+    int format = 0;
+    int buffer_type = 0;
+    unsigned int size = 0;
+    unsigned int alignedw = 0;
+    unsigned int alignedh = 0;
+    GraphicsMetadata graphics_metadata = {};
+  };
+
+  Error GetBufferLayout(const BufferDescriptor &descriptor, unsigned int bufferSize,
+                        BufferLayout *layout);
+  Error AllocateBufferWithLayout(const BufferDescriptor &descriptor, const BufferLayout &layout,
+                                 buffer_handle_t *handle);
+
+  struct Buffer;
+
+  // Buffers are spread over independently locked shards by handle address, so that clients
+  // working on different buffers do not serialize on one lock.
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<const private_handle_t *, std::shared_ptr<Buffer>> handles_map;
+  };
+
+  Shard &GetShard(const private_handle_t *hnd);
+
+  // Registered handles are also published in a table that metadata reads check without taking a
+  // lock. A slot is tagged with the buffer id of its handle, so a new handle allocated at the
+  // address of a freed one does not match the stale entry. Handles that do not fit in their
+  // probe window are only in their shard, a miss here falls back to the shard lookup.
+  struct HandleSlot {
+    std::atomic<const private_handle_t *> handle{nullptr};
+    std::atomic<uint64_t> id{0};
+  };
+
+  void PublishHandle(const private_handle_t *hnd);
+  void UnpublishHandle(const private_handle_t *hnd);
+  bool IsHandlePublished(const private_handle_t *hnd);
+  // Checks the handle is registered, without a lock for published handles.
+  bool IsHandleValid(const private_handle_t *hnd);
+
   // Imports the ion fds into the current process. Returns an error for invalid handles
+  // Caller must hold the lock of the handle's shard.
   Error ImportHandleLocked(private_handle_t *hnd);
 
   // Creates a Buffer from the valid private handle and adds it to the map
-  void RegisterHandleLocked(const private_handle_t *hnd, int ion_handle, int ion_handle_meta);
+  // Caller must hold the lock of the handle's shard.
+  std::shared_ptr<Buffer> RegisterHandleLocked(const private_handle_t *hnd, int ion_handle,
+                                               int ion_handle_meta, bool imported);
+
+  // A dma-buf imported through several handles, e.g. a buffer sent again to a new slot, is mapped
+  // once per process. Mappings are shared by dma-buf inode and unmapped with their last handle.
+  struct SharedMapping {
+    void *base = nullptr;
+    uint32_t refs = 0;
+  };
+  typedef std::unordered_map<uint64_t, SharedMapping> SharedMappings;
+
+  // Maps the metadata of an imported handle, returns the inode the mapping is shared under or 0
+  int MapMetadataShared(private_handle_t *hnd, uint64_t *inode);
+  // Caller must hold the lock of the buffer's shard.
+  Error MapBufferShared(std::shared_ptr<Buffer> buf);
+  // Drops a reference on a shared mapping, returns true if the caller has to unmap it
+  bool ReleaseMapping(SharedMappings *mappings, uint64_t inode);
+
+  // Graphics memory held by this process, by the usage that dominates a buffer's memory
+  enum UsageBucket {
+    kUsageCamera,
+    kUsageVideo,
+    kUsageGpu,
+    kUsageComposer,
+    kUsageCpu,
+    kUsageOther,
+    kNumUsageBuckets,
+  };
+
+  // Live buffers and bytes, and the allocations and imports since start. Only buffers with an
+  // id that is a multiple of usage_stats_sample_ are counted, the dump scales them back.
+  struct UsageStats {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> imports{0};
+    std::atomic<uint64_t> buffers{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> ubwc_bytes{0};
+    std::atomic<uint64_t> large_page_bytes{0};  // Allocated in large page chunks by this process
+  };
+
+  static UsageBucket GetUsageBucket(uint64_t usage);
+  void DumpUsageStats(std::ostringstream *os);
+
+  // Accounts imported buffer memory and dumps the buffer list when it crosses the threshold.
+  // Must not be called with a shard lock held.
+  void AddImportedSize(uint64_t size);
+  void RemoveImportedSize(uint64_t size);
 
   // Wrapper structure over private handle
   // Values associated with the private handle
@@ -77,6 +179,14 @@ class BufferManager {
   struct Buffer {
     const private_handle_t *handle = nullptr;
     int ref_count = 1;
+    int lock_count = 0;
+    // CPU caches were invalidated on lock and the read access has to be ended on unlock
+    bool cpu_read_synced = false;
+    // base was mapped by LockBuffer and may be unmapped again once unlocked
+    bool lock_mapped = false;
+    // Position in map_lru_, guarded by map_lru_lock_
+    bool in_map_lru = false;
+    std::list<const private_handle_t *>::iterator map_lru_it;
     // Hold the main and metadata ion handles
     // Freed from the allocator process
     // and unused in the mapping process
@@ -90,16 +200,53 @@ class BufferManager {
     bool DecRef() { return --ref_count == 0; }
     uint64_t reserved_size = 0;
     void *reserved_region_ptr = nullptr;
+    // Counted in usage_stats_[usage_bucket]
+    bool usage_accounted = false;
+    UsageBucket usage_bucket = kUsageOther;
+    // Size was rounded up to large page chunks at allocation
+    bool large_pages = false;
+    // Inodes the data and metadata mappings are shared under, 0 for private mappings
+    uint64_t data_inode = 0;
+    uint64_t meta_inode = 0;
   };
 
   Error FreeBuffer(std::shared_ptr<Buffer> buf);
 
   // Get the wrapper Buffer object from the handle, returns nullptr if handle is not found
+  // Caller must hold the lock of the handle's shard.
   std::shared_ptr<Buffer> GetBufferFromHandleLocked(const private_handle_t *hnd);
+
+  // Mappings made by LockBuffer outlive the unlock, these keep their total within map_budget_
+  // Caller must hold the lock of the buffer's shard.
+  void TouchMappingLocked(std::shared_ptr<Buffer> buf);
+  void ForgetMappingLocked(std::shared_ptr<Buffer> buf);
+  // Unmaps least recently locked buffers over the budget, must not be called with a shard lock
+  void TrimMappings();
   Allocator *allocator_ = NULL;
-  std::mutex buffer_lock_;
-  std::unordered_map<const private_handle_t *, std::shared_ptr<Buffer>> handles_map_ = {};
+  static constexpr uint32_t kNumShards = 16;
+  // Batched buffers at least this large are allocated from several threads, as clearing their
+  // pages dominates the allocation time.
+  static constexpr unsigned int kParallelAllocSize = 2 * 1024 * 1024;
+  static constexpr uint32_t kMaxParallelAllocs = 4;
+  Shard shards_[kNumShards];
+  static constexpr uint32_t kHandleTableSize = 1024;
+  static constexpr uint32_t kHandleTableProbes = 8;
+  HandleSlot handle_table_[kHandleTableSize];
   std::atomic<uint64_t> next_id_;
+  // Taken after shard locks
+  std::mutex map_lru_lock_;
+  std::list<const private_handle_t *> map_lru_;  // Least recently locked first
+  uint64_t lock_mapped_bytes_ = 0;
+  uint64_t map_budget_ = 0;  // 0 keeps all mappings until the buffer is freed
+  // Taken after shard locks
+  std::mutex mapping_lock_;
+  SharedMappings data_mappings_;
+  SharedMappings meta_mappings_;
+  uint32_t usage_stats_sample_ = 1;  // 0 disables the usage accounting
+  unsigned int large_page_min_size_ = 0;  // Smallest buffer allocated in large page chunks
+  UsageStats usage_stats_[kNumUsageBuckets];
+  // Guards the imported size accounting and the buffer dump file, taken before shard locks.
+  std::mutex dump_lock_;
   uint64_t allocated_ = 0;
   uint64_t kAllocThreshold = (uint64_t)2*1024*1024*1024;
   uint64_t kMemoryOffset = 50*1024*1024;
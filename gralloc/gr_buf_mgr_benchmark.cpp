@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <gralloctypes/Gralloc4.h>
+
+#include "gr_buf_descriptor.h"
+#include "gr_buf_mgr.h"
+
+namespace {
+
+using aidl::android::hardware::graphics::common::BlendMode;
+using aidl::android::hardware::graphics::common::StandardMetadataType;
+using android::hardware::hidl_vec;
+
+// Metadata queried for every buffer of every frame by SurfaceFlinger and the composer.
+const StandardMetadataType kTypes[] = {
+  StandardMetadataType::WIDTH,
+  StandardMetadataType::USAGE,
+  StandardMetadataType::DATASPACE,
+  StandardMetadataType::BLEND_MODE,
+};
+
+void TypeArgs(benchmark::internal::Benchmark *b) {
+  b->ArgName("type");
+  for (auto type : kTypes) {
+    b->Arg(static_cast<int64_t>(type));
+  }
+}
+
+private_handle_t *GetBuffer() {
+  static buffer_handle_t handle = [] {
+    gralloc::BufferDescriptor descriptor(1);
+    descriptor.SetDimensions(1080, 2340);
+    descriptor.SetColorFormat(HAL_PIXEL_FORMAT_RGBA_8888);
+    descriptor.SetUsage(BufferUsage::GPU_TEXTURE | BufferUsage::COMPOSER_OVERLAY);
+    descriptor.SetName("gralloc_mapper_benchmark");
+    buffer_handle_t buffer = nullptr;
+    if (gralloc::BufferManager::GetInstance()->AllocateBuffer(descriptor, &buffer) !=
+        gralloc::Error::NONE) {
+      buffer = nullptr;
+    }
+    return buffer;
+  }();
+
+  return const_cast<private_handle_t *>(static_cast<const private_handle_t *>(handle));
+}
+
+void BM_GetMetadata(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer();
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  for (auto _ : state) {
+    hidl_vec<uint8_t> out;
+    buf_mgr->GetMetadata(hnd, state.range(0), &out);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+BENCHMARK(BM_GetMetadata)->Apply(TypeArgs)->ThreadRange(1, 4);
+
+void BM_GetFixedMetadata(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer();
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  uint8_t out[gralloc::BufferManager::kMaxFixedMetadataSize];
+  size_t size = 0;
+  for (auto _ : state) {
+    buf_mgr->GetFixedMetadata(hnd, state.range(0), out, sizeof(out), &size);
+    benchmark::DoNotOptimize(size);
+  }
+}
+BENCHMARK(BM_GetFixedMetadata)->Apply(TypeArgs)->ThreadRange(1, 4);
+
+void BM_SetMetadata(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer();
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  hidl_vec<uint8_t> in;
+  android::gralloc4::encodeBlendMode(BlendMode::PREMULTIPLIED, &in);
+  for (auto _ : state) {
+    buf_mgr->SetMetadata(hnd, static_cast<int64_t>(StandardMetadataType::BLEND_MODE), in);
+  }
+}
+BENCHMARK(BM_SetMetadata)->ThreadRange(1, 4);
+
+}  // namespace
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cutils/native_handle.h>
+#include <gralloctypes/Gralloc4.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "gr_buf_descriptor.h"
+#include "gr_buf_mgr.h"
+
+namespace {
+
+using aidl::android::hardware::graphics::common::BlendMode;
+using aidl::android::hardware::graphics::common::StandardMetadataType;
+using android::hardware::hidl_vec;
+
+struct Descriptor {
+  const char *name;
+  int width;
+  int height;
+  int format;
+  uint64_t usage;
+};
+
+// Framebuffers, decoded video and camera raw, as allocated and imported on every use case change.
+const Descriptor kDescriptors[] = {
+  {"rgba8888_1080p", 1920, 1080, HAL_PIXEL_FORMAT_RGBA_8888,
+   BufferUsage::GPU_TEXTURE | BufferUsage::GPU_RENDER_TARGET | BufferUsage::COMPOSER_OVERLAY},
+  {"rgba8888_4k", 3840, 2160, HAL_PIXEL_FORMAT_RGBA_8888,
+   BufferUsage::GPU_TEXTURE | BufferUsage::GPU_RENDER_TARGET | BufferUsage::COMPOSER_OVERLAY},
+  {"nv12_ubwc_4k", 3840, 2160, HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS_UBWC,
+   BufferUsage::VIDEO_DECODER | BufferUsage::COMPOSER_OVERLAY},
+  {"p010_4k", 3840, 2160, HAL_PIXEL_FORMAT_YCbCr_420_P010,
+   BufferUsage::VIDEO_DECODER | BufferUsage::COMPOSER_OVERLAY},
+  {"raw10_12mp", 4000, 3000, HAL_PIXEL_FORMAT_RAW10,
+   BufferUsage::CAMERA_OUTPUT | BufferUsage::CPU_READ_OFTEN},
+};
+const int kNumDescriptors = INT(sizeof(kDescriptors) / sizeof(kDescriptors[0]));
+
+// Single threaded, and all threads hammering the same buffer manager for contention.
+void DescriptorArgs(benchmark::internal::Benchmark *b) {
+  b->ArgName("buffer");
+  b->DenseRange(0, kNumDescriptors - 1);
+  b->ThreadRange(1, 4);
+}
+
+gralloc::BufferDescriptor GetDescriptor(const Descriptor &desc) {
+  gralloc::BufferDescriptor descriptor(1);
+  descriptor.SetDimensions(desc.width, desc.height);
+  descriptor.SetColorFormat(desc.format);
+  descriptor.SetUsage(desc.usage);
+  descriptor.SetName("gralloc_buffer_benchmark");
+  return descriptor;
+}
+
+// One buffer per descriptor, shared by all threads and kept for the whole run.
+private_handle_t *GetBuffer(int index) {
+  static std::mutex lock;
+  static buffer_handle_t buffers[kNumDescriptors] = {};
+  std::lock_guard<std::mutex> guard(lock);
+  if (!buffers[index] &&
+      gralloc::BufferManager::GetInstance()->AllocateBuffer(
+          GetDescriptor(kDescriptors[index]), &buffers[index]) != gralloc::Error::NONE) {
+    buffers[index] = nullptr;
+  }
+
+  return const_cast<private_handle_t *>(static_cast<const private_handle_t *>(buffers[index]));
+}
+
+// Times every iteration so that the tail is reported along with the throughput. Each thread
+// reports its own p99, the counter is their average.
+class Latency {
+ public:
+  static const size_t kMaxSamples = 1 << 20;
+
+  Latency() { samples_.reserve(1024); }
+  void Start() { start_ = std::chrono::steady_clock::now(); }
+  void Stop() {
+    if (samples_.size() < kMaxSamples) {
+      samples_.push_back(std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start_).count());
+    }
+  }
+
+  void Report(benchmark::State *state) {
+    state->SetItemsProcessed(state->iterations());
+    state->SetLabel(kDescriptors[state->range(0)].name);
+    if (samples_.empty()) {
+      return;
+    }
+    auto p99 = samples_.begin() + (samples_.size() - 1) * 99 / 100;
+    std::nth_element(samples_.begin(), p99, samples_.end());
+    state->counters["p99_us"] = benchmark::Counter(*p99, benchmark::Counter::kAvgThreads);
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::vector<double> samples_;
+};
+
+void BM_AllocateBuffer(benchmark::State &state) {
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  gralloc::BufferDescriptor descriptor = GetDescriptor(kDescriptors[state.range(0)]);
+  Latency latency;
+  for (auto _ : state) {
+    buffer_handle_t handle = nullptr;
+    latency.Start();
+    gralloc::Error error = buf_mgr->AllocateBuffer(descriptor, &handle);
+    latency.Stop();
+    if (error != gralloc::Error::NONE) {
+      state.SkipWithError("Buffer allocation failed");
+      break;
+    }
+
+    state.PauseTiming();
+    buf_mgr->ReleaseBuffer(static_cast<const private_handle_t *>(handle));
+    state.ResumeTiming();
+  }
+  latency.Report(&state);
+}
+BENCHMARK(BM_AllocateBuffer)->Apply(DescriptorArgs);
+
+// The importBuffer path of the mapper: a clone of a handle from another process is retained,
+// which imports its fds and maps its metadata.
+void BM_ImportBuffer(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer(INT(state.range(0)));
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  Latency latency;
+  for (auto _ : state) {
+    state.PauseTiming();
+    native_handle_t *clone = native_handle_clone(hnd);
+    state.ResumeTiming();
+    if (!clone) {
+      state.SkipWithError("Handle clone failed");
+      break;
+    }
+
+    latency.Start();
+    gralloc::Error error = buf_mgr->RetainBuffer(static_cast<const private_handle_t *>(clone));
+    latency.Stop();
+    state.PauseTiming();
+    if (error == gralloc::Error::NONE) {
+      buf_mgr->ReleaseBuffer(static_cast<const private_handle_t *>(clone));
+    } else {
+      native_handle_close(clone);
+      native_handle_delete(clone);
+    }
+    state.ResumeTiming();
+    if (error != gralloc::Error::NONE) {
+      state.SkipWithError("Buffer import failed");
+      break;
+    }
+  }
+  latency.Report(&state);
+}
+BENCHMARK(BM_ImportBuffer)->Apply(DescriptorArgs);
+
+void BM_LockBuffer(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer(INT(state.range(0)));
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  uint64_t usage = static_cast<uint64_t>(BufferUsage::CPU_READ_OFTEN);
+  Latency latency;
+  for (auto _ : state) {
+    latency.Start();
+    gralloc::Error error = buf_mgr->LockBuffer(hnd, usage);
+    if (error == gralloc::Error::NONE) {
+      buf_mgr->UnlockBuffer(hnd);
+    }
+    latency.Stop();
+    if (error != gralloc::Error::NONE) {
+      state.SkipWithError("Buffer lock failed");
+      break;
+    }
+  }
+  latency.Report(&state);
+}
+BENCHMARK(BM_LockBuffer)->Apply(DescriptorArgs);
+
+void BM_GetMetadata(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer(INT(state.range(0)));
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  Latency latency;
+  for (auto _ : state) {
+    hidl_vec<uint8_t> out;
+    latency.Start();
+    buf_mgr->GetMetadata(hnd, static_cast<int64_t>(StandardMetadataType::PLANE_LAYOUTS), &out);
+    latency.Stop();
+    benchmark::DoNotOptimize(out.data());
+  }
+  latency.Report(&state);
+}
+BENCHMARK(BM_GetMetadata)->Apply(DescriptorArgs);
+
+void BM_SetMetadata(benchmark::State &state) {
+  private_handle_t *hnd = GetBuffer(INT(state.range(0)));
+  if (!hnd) {
+    state.SkipWithError("Buffer allocation failed");
+    return;
+  }
+
+  auto buf_mgr = gralloc::BufferManager::GetInstance();
+  hidl_vec<uint8_t> in;
+  android::gralloc4::encodeBlendMode(BlendMode::PREMULTIPLIED, &in);
+  Latency latency;
+  for (auto _ : state) {
+    latency.Start();
+    buf_mgr->SetMetadata(hnd, static_cast<int64_t>(StandardMetadataType::BLEND_MODE), in);
+    latency.Stop();
+  }
+  latency.Report(&state);
+}
+BENCHMARK(BM_SetMetadata)->Apply(DescriptorArgs);
+
+}  // namespace
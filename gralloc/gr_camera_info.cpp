@@ -29,6 +29,7 @@
 
 #include <dlfcn.h>
 #include <log/log.h>
+#include <algorithm>
 #include <mutex>
 
 #include "gr_camera_info.h"
@@ -39,16 +40,31 @@ using std::mutex;
 
 namespace gralloc {
 
-CameraInfo *CameraInfo::s_instance = nullptr;
+constexpr size_t CameraInfo::kMaxCachedAnswers;
 
 CameraInfo *CameraInfo::GetInstance() {
-  static mutex s_lock;
-  lock_guard<mutex> obj(s_lock);
-  if (!s_instance) {
-    s_instance = new CameraInfo();
+  // Created once, without taking a lock on every query
+  static CameraInfo *instance = new CameraInfo();
+  return instance;
+}
+
+bool CameraInfo::FindAnswer(const QueryKey &key, int64_t *value) {
+  lock_guard<mutex> lock(cache_lock_);
+  auto it = answers_.find(key);
+  if (it == answers_.end()) {
+    return false;
   }
 
-  return s_instance;
+  *value = it->second;
+  return true;
+}
+
+void CameraInfo::InsertAnswer(const QueryKey &key, int64_t value) {
+  lock_guard<mutex> lock(cache_lock_);
+  if (answers_.size() >= kMaxCachedAnswers) {
+    answers_.clear();
+  }
+  answers_[key] = value;
 }
 
 CameraInfo::CameraInfo() {
@@ -139,11 +155,20 @@ CamxPixelFormat CameraInfo::GetCameraPixelFormat(int hal_format) {
 }
 
 int CameraInfo::GetBufferSize(int format, int width, int height, unsigned int *size) {
+  QueryKey key = {kQueryBufferSize, format, 0, width, height};
+  int64_t value = 0;
+  if (FindAnswer(key, &value)) {
+    *size = static_cast<unsigned int>(value);
+    return 0;
+  }
+
   CamxFormatResult result = (CamxFormatResult)-1;
   if (LINK_camera_get_buffer_size) {
     result = LINK_camera_get_buffer_size(GetCameraPixelFormat(format), width, height, size);
     if (result != 0) {
       ALOGE("%s: Failed to get the buffer size. Error code: %d", __FUNCTION__, result);
+    } else {
+      InsertAnswer(key, *size);
     }
   } else {
     ALOGW("%s: Failed to link CamxFormatUtil_GetBufferSize. Error code : %d", __FUNCTION__, result);
@@ -153,12 +178,21 @@ int CameraInfo::GetBufferSize(int format, int width, int height, unsigned int *s
 }
 
 int CameraInfo::GetStrideInBytes(int format, int plane_type, int width, int *stride_bytes) {
+  QueryKey key = {kQueryStrideInBytes, format, plane_type, width, 0};
+  int64_t value = 0;
+  if (FindAnswer(key, &value)) {
+    *stride_bytes = static_cast<int>(value);
+    return 0;
+  }
+
   CamxFormatResult result = (CamxFormatResult)-1;
   if (LINK_camera_get_stride_in_bytes) {
     result = LINK_camera_get_stride_in_bytes(GetCameraPixelFormat(format),
                                              GetCamxPlaneType(plane_type), width, stride_bytes);
     if (result != 0) {
       ALOGE("%s: Failed to get the stride in bytes. Error code: %d", __FUNCTION__, result);
+    } else {
+      InsertAnswer(key, *stride_bytes);
     }
   } else {
     ALOGW("%s: Failed to link CamxFormatUtil_GetStrideInBytes. Error code : %d", __FUNCTION__,
@@ -255,12 +289,21 @@ int CameraInfo::GetPlaneTypes(int format, PlaneComponent *plane_component_array,
 }
 
 int CameraInfo::GetScanline(int format, int plane_type, int height, int *scanlines) {
+  QueryKey key = {kQueryScanline, format, plane_type, 0, height};
+  int64_t value = 0;
+  if (FindAnswer(key, &value)) {
+    *scanlines = static_cast<int>(value);
+    return 0;
+  }
+
   CamxFormatResult result = (CamxFormatResult)-1;
   if (LINK_camera_get_scanline) {
     result = LINK_camera_get_scanline(GetCameraPixelFormat(format), GetCamxPlaneType(plane_type),
                                       height, scanlines);
     if (result != 0) {
       ALOGE("%s: Failed to get the scanlines. Error code: %d", __FUNCTION__, result);
+    } else {
+      InsertAnswer(key, *scanlines);
     }
   } else {
     ALOGW("%s: Failed to link CamxFormatUtil_GetScanline. Error code : %d", __FUNCTION__, result);
@@ -287,6 +330,36 @@ int CameraInfo::GetPlaneSize(int format, int plane_type, int width, int height,
 
 int CameraInfo::GetCameraFormatPlaneInfo(int format, int width, int height, int *plane_count,
                                          PlaneLayoutInfo *plane_info) {
+  QueryKey key = {kQueryPlaneInfo, format, 0, width, height};
+  {
+    lock_guard<mutex> lock(cache_lock_);
+    auto it = plane_infos_.find(key);
+    if (it != plane_infos_.end()) {
+      *plane_count = it->second.plane_count;
+      std::copy(it->second.plane_info, it->second.plane_info + it->second.plane_count,
+                plane_info);
+      return 0;
+    }
+  }
+
+  PlaneInfo info;
+  int result = ComputeCameraFormatPlaneInfo(format, width, height, &info.plane_count,
+                                            info.plane_info);
+  *plane_count = info.plane_count;
+  std::copy(info.plane_info, info.plane_info + std::min(info.plane_count, 8), plane_info);
+  if (result == 0 && info.plane_count <= 8) {
+    lock_guard<mutex> lock(cache_lock_);
+    if (plane_infos_.size() >= kMaxCachedAnswers) {
+      plane_infos_.clear();
+    }
+    plane_infos_[key] = info;
+  }
+
+  return result;
+}
+
+int CameraInfo::ComputeCameraFormatPlaneInfo(int format, int width, int height, int *plane_count,
+                                             PlaneLayoutInfo *plane_info) {
   int h_subsampling = 0;
   int v_subsampling = 0;
   int offset = 0;
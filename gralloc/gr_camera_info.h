@@ -30,6 +30,10 @@
 #ifndef __GR_CAMERA_INFO_H__
 #define __GR_CAMERA_INFO_H__
 
+#include <map>
+#include <mutex>
+#include <tuple>
+
 #include "gr_utils.h"
 
 // Plane types supported by the camera format
@@ -125,12 +129,47 @@ class CameraInfo {
 
   CamxPixelFormat GetCameraPixelFormat(int hal_format);
 
+  // Also loads the camera library, called at allocator service start to keep it off the first
+  // camera session.
   static CameraInfo *GetInstance();
 
  private:
   CameraInfo();
   ~CameraInfo();
 
+  // The library answers depend only on the arguments. Camera sessions allocate and query many
+  // buffers of a few configurations, so the answers gralloc asks for repeatedly are kept.
+  enum Query {
+    kQueryBufferSize,
+    kQueryStrideInBytes,
+    kQueryScanline,
+    kQueryPlaneInfo,
+  };
+
+  struct QueryKey {
+    Query query;
+    int format;
+    int plane_type;
+    int width;
+    int height;
+    bool operator<(const QueryKey &other) const {
+      return std::tie(query, format, plane_type, width, height) <
+             std::tie(other.query, other.format, other.plane_type, other.width, other.height);
+    }
+  };
+
+  struct PlaneInfo {
+    int plane_count = 0;
+    PlaneLayoutInfo plane_info[8] = {};
+  };
+
+  static constexpr size_t kMaxCachedAnswers = 64;
+
+  bool FindAnswer(const QueryKey &key, int64_t *value);
+  void InsertAnswer(const QueryKey &key, int64_t value);
+  int ComputeCameraFormatPlaneInfo(int format, int width, int height, int *plane_count,
+                                   PlaneLayoutInfo *plane_info);
+
   PlaneComponent GetPlaneComponent(CamxPlaneType plane_type);
 
   CamxPlaneType GetCamxPlaneType(int plane_type);
@@ -192,7 +231,10 @@ class CameraInfo {
                                                                     int *pAlignment) = nullptr;
 
   void *libcamera_utils_ = nullptr;
-  static CameraInfo *s_instance;
+
+  std::mutex cache_lock_;
+  std::map<QueryKey, int64_t> answers_;
+  std::map<QueryKey, PlaneInfo> plane_infos_;
 };
 
 }  // namespace gralloc
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define DEBUG 0
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <linux/dma-heap.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <cutils/trace.h>
+#include <errno.h>
+#include <utils/Trace.h>
+#include <string.h>
+#include <vector>
+
+#ifndef QMAA
+#include <linux/msm_ion.h>
+#endif
+
+#include "gr_utils.h"
+#include "gr_dma_heap_alloc.h"
+
+namespace gralloc {
+
+static const char *kDmaHeapDir = "/dev/dma_heap";
+
+// Node names of the dma-buf heap equivalent to the ion heap selected by
+// Allocator::GetIonHeapInfo, vendor name first. Heaps without an equivalent stay on ion.
+static std::vector<const char *> GetHeapNames(const AllocData &data) {
+#ifndef QMAA
+  if (data.heap_id == ION_HEAP(ION_SYSTEM_HEAP_ID) && !data.flags) {
+    if (data.uncached) {
+      return {"qcom,system-uncached", "system-uncached"};
+    }
+    return {"qcom,system", "system"};
+  }
+#if !defined(SLAVE_SIDE_CP) && defined(ION_FLAG_CP_PIXEL)
+  if (data.heap_id == ION_HEAP(ION_SECURE_HEAP_ID) &&
+      data.flags == UINT(ION_FLAG_SECURE | ION_FLAG_CP_PIXEL)) {
+    return {"qcom,secure-pixel"};
+  }
+#endif
+#endif
+  (void)data;
+  return {};
+}
+
+DmaHeapAlloc::~DmaHeapAlloc() {
+  for (auto &heap : heap_fds_) {
+    if (heap.second >= 0) {
+      close(heap.second);
+    }
+  }
+}
+
+bool DmaHeapAlloc::Init() {
+  if (access(kDmaHeapDir, R_OK) != 0) {
+    ALOGI("%s: No dma-buf heaps - %s", __FUNCTION__, strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+int DmaHeapAlloc::GetHeapFd(const AllocData &data) {
+  std::lock_guard<std::mutex> lock(heap_lock_);
+  for (auto name : GetHeapNames(data)) {
+    auto it = heap_fds_.find(name);
+    if (it == heap_fds_.end()) {
+      std::string path = std::string(kDmaHeapDir) + "/" + name;
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      ALOGI_IF(fd >= 0, "%s: Using dma-buf heap %s", __FUNCTION__, name);
+      it = heap_fds_.emplace(name, fd).first;
+    }
+    if (it->second >= 0) {
+      return it->second;
+    }
+  }
+
+  return -ENODEV;
+}
+
+int DmaHeapAlloc::AllocBuffer(AllocData *data) {
+  ATRACE_CALL();
+  int heap_fd = GetHeapFd(*data);
+  if (heap_fd < 0) {
+    return heap_fd;
+  }
+
+  std::string tag_name{};
+  if (ATRACE_ENABLED()) {
+    tag_name = "dma-buf heap alloc size: " + std::to_string(data->size);
+  }
+
+  // Heap allocations are page aligned, which covers every alignment gralloc asks for
+  struct dma_heap_allocation_data heap_data = {};
+  heap_data.len = data->size;
+  heap_data.fd_flags = O_RDWR | O_CLOEXEC;
+  ATRACE_BEGIN(tag_name.c_str());
+  int err = ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &heap_data);
+  ATRACE_END();
+  if (err) {
+    err = -errno;
+    ALOGE("dma-buf heap alloc failed size %d heap_id %x flags %x - %s", data->size,
+          data->heap_id, data->flags, strerror(errno));
+    return err;
+  }
+
+  data->fd = INT(heap_data.fd);
+  data->ion_handle = data->fd;
+  ALOGD_IF(DEBUG, "dma-buf heap: Allocated buffer size:%u fd:%d", data->size, data->fd);
+
+  return 0;
+}
+
+}  // namespace gralloc
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GR_DMA_HEAP_ALLOC_H__
+#define __GR_DMA_HEAP_ALLOC_H__
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "gr_ion_alloc.h"
+
+namespace gralloc {
+
+// Allocates from the per heap /dev/dma_heap nodes, which unlike ion do not serialize all
+// allocations of the system on one device lock.
+class DmaHeapAlloc : public AllocBackend {
+ public:
+  ~DmaHeapAlloc();
+
+  bool Init() override;
+  int AllocBuffer(AllocData *data) override;
+
+ private:
+  // Returns the fd of the dma-buf heap matching the ion heap and flags, or -ENODEV
+  int GetHeapFd(const AllocData &data);
+
+  std::mutex heap_lock_;
+  std::map<std::string, int> heap_fds_;  // Opened on first use, -1 for missing nodes
+};
+
+}  // namespace gralloc
+
+#endif  // __GR_DMA_HEAP_ALLOC_H__
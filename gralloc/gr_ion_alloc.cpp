@@ -103,8 +103,8 @@ int IonAlloc::AllocBuffer(AllocData *data) {
   return 0;
 }
 
-int IonAlloc::FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd,
-                         int /*ion_handle*/) {
+int AllocBackend::FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd,
+                             int /*ion_handle*/) {
   ATRACE_CALL();
   int err = 0;
   ALOGD_IF(DEBUG, "libion: Freeing buffer base:%p size:%u fd:%d", base, size, fd);
@@ -117,13 +117,13 @@ int IonAlloc::FreeBuffer(void *base, unsigned int size, unsigned int offset, int
   return err;
 }
 
-int IonAlloc::ImportBuffer(int fd) {
+int AllocBackend::ImportBuffer(int fd) {
   // For new ion api ion_handle does not exists so reusing fd for now
   return fd;
 }
 
-int IonAlloc::CleanBuffer(void */*base*/, unsigned int /*size*/, unsigned int /*offset*/,
-                          int /*handle*/, int op, int dma_buf_fd) {
+int AllocBackend::CleanBuffer(void */*base*/, unsigned int /*size*/, unsigned int /*offset*/,
+                              int /*handle*/, int op, int dma_buf_fd) {
   ATRACE_CALL();
   ATRACE_INT("operation id", op);
 
@@ -154,7 +154,22 @@ int IonAlloc::CleanBuffer(void */*base*/, unsigned int /*size*/, unsigned int /*
   return 0;
 }
 
-int IonAlloc::MapBuffer(void **base, unsigned int size, unsigned int offset, int fd) {
+int AllocBackend::SetBufferName(int fd, const char *name) {
+#ifdef DMA_BUF_SET_NAME
+  if (ioctl(fd, DMA_BUF_SET_NAME, name)) {
+    ALOGD_IF(DEBUG, "%s: DMA_BUF_SET_NAME failed - %s", __FUNCTION__, strerror(errno));
+    return -errno;
+  }
+
+  return 0;
+#else
+  (void)fd;
+  (void)name;
+  return -ENOTSUP;
+#endif
+}
+
+int AllocBackend::MapBuffer(void **base, unsigned int size, unsigned int offset, int fd) {
   ATRACE_CALL();
   int err = 0;
   void *addr = 0;
@@ -171,7 +186,7 @@ int IonAlloc::MapBuffer(void **base, unsigned int size, unsigned int offset, int
   return err;
 }
 
-int IonAlloc::UnmapBuffer(void *base, unsigned int size, unsigned int /*offset*/) {
+int AllocBackend::UnmapBuffer(void *base, unsigned int size, unsigned int /*offset*/) {
   ATRACE_CALL();
   ALOGD_IF(DEBUG, "ion: Unmapping buffer  base:%p size:%u", base, size);
 
@@ -55,19 +55,34 @@ struct AllocData {
   unsigned int alloc_type = 0x0;
 };
 
-class IonAlloc {
+// Kernel interface buffers are allocated from. Every backend hands out dma-buf fds, so the
+// defaults for everything but allocation work on buffers of any backend.
+class AllocBackend {
+ public:
+  virtual ~AllocBackend() {}
+
+  virtual bool Init() = 0;
+  // Returns -ENODEV if the backend has no heap matching data->heap_id and data->flags
+  virtual int AllocBuffer(AllocData *data) = 0;
+  virtual int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd,
+                         int ion_handle);
+  virtual int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
+  virtual int ImportBuffer(int fd);
+  virtual int UnmapBuffer(void *base, unsigned int size, unsigned int offset);
+  virtual int CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op,
+                          int fd);
+  // Names the dma-buf in its fdinfo, for memory attribution by other processes
+  virtual int SetBufferName(int fd, const char *name);
+};
+
+class IonAlloc : public AllocBackend {
  public:
   IonAlloc() { ion_dev_fd_ = FD_INIT; }
 
   ~IonAlloc() { CloseIonDevice(); }
 
-  bool Init();
-  int AllocBuffer(AllocData *data);
-  int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int ion_handle);
-  int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
-  int ImportBuffer(int fd);
-  int UnmapBuffer(void *base, unsigned int size, unsigned int offset);
-  int CleanBuffer(void *base, unsigned int size, unsigned int offset, int handle, int op, int fd);
+  bool Init() override;
+  int AllocBuffer(AllocData *data) override;
 
  private:
   int OpenIonDevice();
@@ -35,6 +35,8 @@
 
 #include <cutils/properties.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #include "gr_adreno_info.h"
 #include "gr_camera_info.h"
@@ -44,6 +46,128 @@
 
 namespace gralloc {
 
+namespace {
+
+struct AlignedDimensions {
+  unsigned int alignedw;
+  unsigned int alignedh;
+};
+
+struct GpuLayout {
+  unsigned int size;
+  unsigned int alignedw;
+  unsigned int alignedh;
+  GraphicsMetadata graphics_metadata;
+};
+
+struct PlaneLayout {
+  int plane_count;
+  PlaneLayoutInfo plane_info[8];
+};
+
+// Buffer description the library layouts depend on
+struct BufferKey {
+  BufferKey() = default;
+  BufferKey(const BufferInfo &info)  // NOLINT, converts at the lookups
+      : width(info.width), height(info.height), format(info.format),
+        layer_count(info.layer_count), usage(info.usage) {}
+  bool operator==(const BufferKey &other) const {
+    return width == other.width && height == other.height && format == other.format &&
+           layer_count == other.layer_count && usage == other.usage;
+  }
+
+  int width = 0;
+  int height = 0;
+  int format = 0;
+  int layer_count = 0;
+  uint64_t usage = 0;
+};
+
+// Arguments of GetYUVPlaneInfo, the aligned dimensions and the unaligned ones a few formats use
+struct PlaneLayoutKey {
+  bool operator==(const PlaneLayoutKey &other) const {
+    return format == other.format && width == other.width && height == other.height &&
+           flags == other.flags && unaligned_width == other.unaligned_width &&
+           unaligned_height == other.unaligned_height;
+  }
+
+  int32_t format = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t flags = 0;
+  int unaligned_width = 0;
+  int unaligned_height = 0;
+};
+
+// Memoizes layouts computed by libadreno_utils and YUV plane layouts. They depend only on the
+// key and on properties read once per process, so allocations, locks and framebuffer creations
+// repeating a buffer configuration can skip the computation. Entries are replaced in insertion
+// order.
+template <class Key, class Layout>
+class LayoutCache {
+ public:
+  bool Find(const Key &key, Layout *layout) {
+    if (!enabled_) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count_; i++) {
+      if (entries_[i].key == key) {
+        *layout = entries_[i].layout;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Insert(const Key &key, const Layout &layout) {
+    if (!enabled_) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[next_].key = key;
+    entries_[next_].layout = layout;
+    next_ = (next_ + 1) % kMaxEntries;
+    count_ = std::min(count_ + 1, kMaxEntries);
+  }
+
+  static std::atomic<bool> enabled_;
+
+ private:
+  static constexpr uint32_t kMaxEntries = 16;
+
+  struct Entry {
+    Key key;
+    Layout layout;
+  };
+
+  std::mutex mutex_;
+  Entry entries_[kMaxEntries] = {};
+  uint32_t count_ = 0;
+  uint32_t next_ = 0;
+};
+
+template <class Key, class Layout>
+std::atomic<bool> LayoutCache<Key, Layout>::enabled_(true);
+
+template <class Key, class Layout>
+constexpr uint32_t LayoutCache<Key, Layout>::kMaxEntries;
+
+LayoutCache<BufferKey, AlignedDimensions> g_rgb_alignment_cache;
+LayoutCache<BufferKey, GpuLayout> g_gpu_layout_cache;
+LayoutCache<PlaneLayoutKey, PlaneLayout> g_yuv_layout_cache;
+
+}  // namespace
+
+void SetLayoutCacheEnabled(bool enable) {
+  LayoutCache<BufferKey, AlignedDimensions>::enabled_ = enable;
+  LayoutCache<BufferKey, GpuLayout>::enabled_ = enable;
+  LayoutCache<PlaneLayoutKey, PlaneLayout>::enabled_ = enable;
+}
+
 bool IsYuvFormat(int format) {
   switch (format) {
     case HAL_PIXEL_FORMAT_YCbCr_420_SP:
@@ -232,6 +356,19 @@ bool CpuCanWrite(uint64_t usage) {
   return false;
 }
 
+bool NonCpuCanWrite(uint64_t usage) {
+  // Any usage other than these may let a device write the buffer behind the CPU caches
+  uint64_t read_only_usage = BufferUsage::CPU_READ_MASK | BufferUsage::CPU_WRITE_MASK |
+                             BufferUsage::GPU_TEXTURE | BufferUsage::COMPOSER_OVERLAY |
+                             BufferUsage::COMPOSER_CURSOR | BufferUsage::VIDEO_ENCODER |
+                             BufferUsage::CAMERA_INPUT;
+  if (usage & ~read_only_usage) {
+    return true;
+  }
+
+  return false;
+}
+
 uint32_t GetDataAlignment(int format, uint64_t usage) {
   uint32_t align = UINT(getpagesize());
   if (format == HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED) {
@@ -250,6 +387,22 @@ uint32_t GetDataAlignment(int format, uint64_t usage) {
   return align;
 }
 
+unsigned int GetLargePageSize(uint64_t usage, unsigned int size, unsigned int min_size) {
+  // Secure buffers are aligned for their own mmu already.
+  if (!min_size || (size < min_size) || (usage & BufferUsage::PROTECTED) ||
+      !(usage & (BufferUsage::COMPOSER_OVERLAY | BufferUsage::COMPOSER_CLIENT_TARGET |
+                 BufferUsage::VIDEO_DECODER))) {
+    return 0;
+  }
+
+  // 2 MB chunks for buffers they waste at most a sixteenth of, like 4K scanout buffers.
+  if (size >= 16 * SZ_2M) {
+    return SZ_2M;
+  }
+
+  return SZ_64K;
+}
+
 bool IsGPUFlagSupported(uint64_t usage) {
   bool ret = true;
   if ((usage & BufferUsage::GPU_MIPMAP_COMPLETE)) {
@@ -978,6 +1131,46 @@ void GetCustomDimensions(private_handle_t *hnd, int *stride, int *height) {
   }
 }
 
+int GetMetaDataSnapshot(private_handle_t *hnd, MetaDataSnapshot *snapshot) {
+  *snapshot = MetaDataSnapshot();
+  if (private_handle_t::validate(hnd)) {
+    return -1;
+  }
+
+  int32_t interlaced = 0;
+  if (!hnd->base_metadata) {
+    // Not mapped in this process yet, getMetaData maps it on the first read.
+    if (getMetaData(hnd, GET_PP_PARAM_INTERLACED, &interlaced) == 0) {
+      snapshot->interlaced = interlaced;
+    }
+    if (!hnd->base_metadata) {
+      return -1;
+    }
+  }
+
+  // getMetaDataVa applies the same per field checks as getMetaData without revalidating the
+  // handle each time.
+  auto metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+  if (getMetaDataVa(metadata, GET_PP_PARAM_INTERLACED, &interlaced) == 0) {
+    snapshot->interlaced = interlaced;
+  }
+  snapshot->has_refresh_rate =
+      (getMetaDataVa(metadata, GET_REFRESH_RATE, &snapshot->refresh_rate) == 0);
+  snapshot->has_linear_format =
+      (getMetaDataVa(metadata, GET_LINEAR_FORMAT, &snapshot->linear_format) == 0);
+  snapshot->has_ubwc_cr_stats =
+      (getMetaDataVa(metadata, GET_UBWC_CR_STATS_INFO, snapshot->ubwc_cr_stats) == 0);
+  getMetaDataVa(metadata, GET_SINGLE_BUFFER_MODE, &snapshot->single_buffer_mode);
+  snapshot->has_color_metadata =
+      (getMetaDataVa(metadata, GET_COLOR_METADATA, &snapshot->color_metadata) == 0);
+  if (!snapshot->has_color_metadata) {
+    snapshot->has_color_space =
+        (getMetaDataVa(metadata, GET_COLOR_SPACE, &snapshot->color_space) == 0);
+  }
+
+  return 0;
+}
+
 void GetColorSpaceFromMetadata(private_handle_t *hnd, int *color_space) {
   ColorMetaData color_metadata;
   if (getMetaData(hnd, GET_COLOR_METADATA, &color_metadata) == 0) {
@@ -1047,10 +1240,19 @@ void GetAlignedWidthAndHeight(const BufferInfo &info, unsigned int *alignedw,
     return;
   }
 
+  AlignedDimensions dimensions = {};
+  if ((IsUncompressedRGBFormat(format) || (!ubwc_enabled && IsCompressedRGBFormat(format))) &&
+      g_rgb_alignment_cache.Find(info, &dimensions)) {
+    *alignedw = dimensions.alignedw;
+    *alignedh = dimensions.alignedh;
+    return;
+  }
+
   if (IsUncompressedRGBFormat(format)) {
     if (AdrenoMemInfo::GetInstance()) {
       AdrenoMemInfo::GetInstance()->AlignUnCompressedRGB(width, height, format, tile, alignedw,
                                                          alignedh);
+      g_rgb_alignment_cache.Insert(info, {*alignedw, *alignedh});
     }
     return;
   }
@@ -1063,6 +1265,7 @@ void GetAlignedWidthAndHeight(const BufferInfo &info, unsigned int *alignedw,
   if (IsCompressedRGBFormat(format)) {
     if (AdrenoMemInfo::GetInstance()) {
       AdrenoMemInfo::GetInstance()->AlignCompressedRGB(width, height, format, alignedw, alignedh);
+      g_rgb_alignment_cache.Insert(info, {*alignedw, *alignedh});
     }
     return;
   }
@@ -1224,6 +1427,15 @@ int GetBufferLayout(private_handle_t *hnd, uint32_t stride[4], uint32_t offset[4
 int GetGpuResourceSizeAndDimensions(const BufferInfo &info, unsigned int *size,
                                     unsigned int *alignedw, unsigned int *alignedh,
                                     GraphicsMetadata *graphics_metadata) {
+  GpuLayout layout = {};
+  if (g_gpu_layout_cache.Find(info, &layout)) {
+    *size = layout.size;
+    *alignedw = layout.alignedw;
+    *alignedh = layout.alignedh;
+    *graphics_metadata = layout.graphics_metadata;
+    return 0;
+  }
+
   GetAlignedWidthAndHeight(info, alignedw, alignedh);
   AdrenoMemInfo* adreno_mem_info = AdrenoMemInfo::GetInstance();
   graphics_metadata->size = adreno_mem_info->AdrenoGetMetadataBlobSize();
@@ -1251,6 +1463,12 @@ int GetGpuResourceSizeAndDimensions(const BufferInfo &info, unsigned int *size,
   }
   // Call adreno api with the metadata blob to get buffer size
   *size = adreno_mem_info->AdrenoGetAlignedGpuBufferSize(graphics_metadata->data);
+
+  layout.size = *size;
+  layout.alignedw = *alignedw;
+  layout.alignedh = *alignedh;
+  layout.graphics_metadata = *graphics_metadata;
+  g_gpu_layout_cache.Insert(info, layout);
   return 0;
 }
 
@@ -1427,23 +1645,13 @@ int GetBufferType(int inputFormat) {
 }
 
 // Here width and height are aligned width and aligned height.
-int GetYUVPlaneInfo(const BufferInfo &info, int32_t format, int32_t width, int32_t height,
-                    int32_t flags, int *plane_count, PlaneLayoutInfo *plane_info) {
+static int ComputeYUVPlaneInfo(const BufferInfo &info, int32_t format, int32_t width,
+                               int32_t height, int32_t flags, int *plane_count,
+                               PlaneLayoutInfo *plane_info) {
   int err = 0;
   unsigned int y_stride, c_stride, y_height, c_height, y_size, c_size;
   uint64_t yOffset, cOffset, crOffset, cbOffset;
   int h_subsampling = 0, v_subsampling = 0;
-  if (IsCameraCustomFormat(format) && CameraInfo::GetInstance()) {
-    int result = CameraInfo::GetInstance()->GetCameraFormatPlaneInfo(
-        format, info.width, info.height, plane_count, plane_info);
-    if (result != 0) {
-      ALOGE(
-          "%s: Failed to get the plane info through camera library. width: %d, height: %d,"
-          "format: %d, Error code: %d",
-          __FUNCTION__, width, height, format, result);
-    }
-    return result;
-  }
 
   switch (format) {
     // Semiplanar
@@ -1674,6 +1882,68 @@ int GetYUVPlaneInfo(const BufferInfo &info, int32_t format, int32_t width, int32
   return err;
 }
 
+#ifndef NDEBUG
+static bool IsSamePlaneLayout(int plane_count, const PlaneLayoutInfo *a,
+                              const PlaneLayoutInfo *b) {
+  for (int i = 0; i < plane_count; i++) {
+    if (a[i].component != b[i].component || a[i].h_subsampling != b[i].h_subsampling ||
+        a[i].v_subsampling != b[i].v_subsampling || a[i].offset != b[i].offset ||
+        a[i].step != b[i].step || a[i].stride != b[i].stride ||
+        a[i].stride_bytes != b[i].stride_bytes || a[i].scanlines != b[i].scanlines ||
+        a[i].size != b[i].size) {
+      return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+int GetYUVPlaneInfo(const BufferInfo &info, int32_t format, int32_t width, int32_t height,
+                    int32_t flags, int *plane_count, PlaneLayoutInfo *plane_info) {
+  if (IsCameraCustomFormat(format) && CameraInfo::GetInstance()) {
+    int result = CameraInfo::GetInstance()->GetCameraFormatPlaneInfo(
+        format, info.width, info.height, plane_count, plane_info);
+    if (result != 0) {
+      ALOGE(
+          "%s: Failed to get the plane info through camera library. width: %d, height: %d,"
+          "format: %d, Error code: %d",
+          __FUNCTION__, width, height, format, result);
+    }
+    return result;
+  }
+
+  PlaneLayoutKey key = {format, width, height, flags, info.width, info.height};
+  PlaneLayout cached = {};
+  bool hit = g_yuv_layout_cache.Find(key, &cached);
+#ifdef NDEBUG
+  if (hit) {
+    *plane_count = cached.plane_count;
+    std::copy(cached.plane_info, cached.plane_info + cached.plane_count, plane_info);
+    return 0;
+  }
+#endif
+
+  PlaneLayout layout = {};
+  int err = ComputeYUVPlaneInfo(info, format, width, height, flags, &layout.plane_count,
+                                layout.plane_info);
+#ifndef NDEBUG
+  // Debug builds always compute, to catch a layout input missing from the key
+  if (hit && (err != 0 || layout.plane_count != cached.plane_count ||
+              !IsSamePlaneLayout(layout.plane_count, layout.plane_info, cached.plane_info))) {
+    ALOGE("%s: Cached layout of format 0x%x %dx%d flags 0x%x differs from the computed one",
+          __FUNCTION__, format, width, height, flags);
+  }
+#endif
+  *plane_count = layout.plane_count;
+  std::copy(layout.plane_info, layout.plane_info + layout.plane_count, plane_info);
+  if (err == 0 && !hit) {
+    g_yuv_layout_cache.Insert(key, layout);
+  }
+
+  return err;
+}
+
 void GetYuvSubSamplingFactor(int32_t format, int *h_subsampling, int *v_subsampling) {
   switch (format) {
     case HAL_PIXEL_FORMAT_YCbCr_420_SP:
@@ -36,6 +36,7 @@
 
 #define SZ_2M 0x200000
 #define SZ_1M 0x100000
+#define SZ_64K 0x10000
 #define SZ_4K 0x1000
 
 #define SIZE_4K 4096
@@ -67,6 +68,12 @@ struct GrallocProperties {
   bool use_system_heap_for_sensors = true;
   bool ubwc_disable = false;
   bool ahardware_buffer_disable = false;
+  bool buffer_pool_enable = false;
+  unsigned int buffer_pool_budget_mb = 64;
+  bool use_dma_buf_heaps = true;
+  bool zeroed_reserve_enable = false;
+  unsigned int zeroed_reserve_budget_mb = 64;
+  unsigned int large_page_min_kb = 4096;  // 0 allocates every buffer in small pages
 };
 
 template <class Type1, class Type2>
@@ -158,6 +165,23 @@ struct PlaneLayoutInfo {
   uint32_t size;
 };
 
+// Metadata fields the display HAL reads for every new layer buffer. The has_* flags are set for
+// the fields getMetaData would have returned.
+struct MetaDataSnapshot {
+  bool has_refresh_rate = false;
+  float refresh_rate = 0.0f;
+  int32_t interlaced = 0;
+  bool has_linear_format = false;
+  uint32_t linear_format = 0;
+  bool has_ubwc_cr_stats = false;
+  UBWCStats ubwc_cr_stats[NUM_UBWC_CR_STATS_LAYERS] = {};
+  uint32_t single_buffer_mode = 0;
+  bool has_color_metadata = false;
+  ColorMetaData color_metadata = {};
+  bool has_color_space = false;
+  ColorSpace_t color_space = ITU_R_601;
+};
+
 bool IsYuvFormat(int format);
 bool IsCompressedRGBFormat(int format);
 bool IsUncompressedRGBFormat(int format);
@@ -165,6 +189,7 @@ uint32_t GetBppForUncompressedRGB(int format);
 bool CpuCanAccess(uint64_t usage);
 bool CpuCanRead(uint64_t usage);
 bool CpuCanWrite(uint64_t usage);
+bool NonCpuCanWrite(uint64_t usage);
 int GetBpp(int format);
 unsigned int GetSize(const BufferInfo &d, unsigned int alignedw, unsigned int alignedh);
 int GetBufferSizeAndDimensions(const BufferInfo &d, unsigned int *size, unsigned int *alignedw,
@@ -173,6 +198,8 @@ int GetBufferSizeAndDimensions(const BufferInfo &d, unsigned int *size, unsigned
                                unsigned int *alignedh, GraphicsMetadata *graphics_metadata);
 void GetCustomDimensions(private_handle_t *hnd, int *stride, int *height);
 void GetColorSpaceFromMetadata(private_handle_t *hnd, int *color_space);
+// Validates the handle once and reads all MetaDataSnapshot fields from the mapped metadata.
+int GetMetaDataSnapshot(private_handle_t *hnd, MetaDataSnapshot *snapshot);
 void GetAlignedWidthAndHeight(const BufferInfo &d, unsigned int *aligned_w,
                               unsigned int *aligned_h);
 int GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr ycbcr[2]);
@@ -205,6 +232,9 @@ unsigned int GetUBwcSize(int width, int height, int format, unsigned int aligned
 int GetBufferLayout(private_handle_t *hnd, uint32_t stride[4], uint32_t offset[4],
                     uint32_t *num_planes);
 uint32_t GetDataAlignment(int format, uint64_t usage);
+// Chunk size to round scanout and video buffers of at least min_size up to, so that the heap
+// backs them with its large pages only. 0 for buffers allocated as they are.
+unsigned int GetLargePageSize(uint64_t usage, unsigned int size, unsigned int min_size);
 int GetGpuResourceSizeAndDimensions(const BufferInfo &info, unsigned int *size,
                                     unsigned int *alignedw, unsigned int *alignedh,
                                     GraphicsMetadata *graphics_metadata);
@@ -221,6 +251,10 @@ bool HasAlphaComponent(int32_t format);
 void GetDRMFormat(uint32_t format, uint32_t flags, uint32_t *drm_format,
                   uint64_t *drm_format_modifier);
 bool CanAllocateZSLForSecureCamera();
+// Layouts computed by libadreno_utils and YUV plane layouts are memoized per process. Disabling
+// the cache, meant for benchmarks and debugging, makes lookups bypass it without dropping cached
+// entries.
+void SetLayoutCacheEnabled(bool enable);
 }  // namespace gralloc
 
 #endif  // __GR_UTILS_H__
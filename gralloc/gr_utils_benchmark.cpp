@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "gr_utils.h"
+
+namespace {
+
+// Typical client buffers: a phone sized framebuffer, a 4K texture and a compressed texture.
+const gralloc::BufferInfo kBuffers[] = {
+  {1080, 2340, HAL_PIXEL_FORMAT_RGBA_8888,
+   BufferUsage::GPU_TEXTURE | BufferUsage::GPU_RENDER_TARGET | BufferUsage::COMPOSER_OVERLAY},
+  {3840, 2160, HAL_PIXEL_FORMAT_RGBA_1010102, BufferUsage::GPU_TEXTURE},
+  {1024, 1024, HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8_KHR, BufferUsage::GPU_TEXTURE},
+};
+
+// Runs every buffer with the layout cache disabled, i.e. the library path, and enabled.
+void LayoutArgs(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"cache", "buffer"});
+  for (int cache = 0; cache <= 1; cache++) {
+    for (int buffer = 0; buffer < INT(sizeof(kBuffers) / sizeof(kBuffers[0])); buffer++) {
+      b->Args({cache, buffer});
+    }
+  }
+}
+
+void BM_GetBufferSizeAndDimensions(benchmark::State &state) {
+  gralloc::SetLayoutCacheEnabled(state.range(0));
+  const gralloc::BufferInfo &info = kBuffers[state.range(1)];
+  unsigned int size = 0, alignedw = 0, alignedh = 0;
+  GraphicsMetadata graphics_metadata = {};
+  for (auto _ : state) {
+    gralloc::GetBufferSizeAndDimensions(info, &size, &alignedw, &alignedh, &graphics_metadata);
+    benchmark::DoNotOptimize(size);
+  }
+  gralloc::SetLayoutCacheEnabled(true);
+}
+BENCHMARK(BM_GetBufferSizeAndDimensions)->Apply(LayoutArgs);
+
+void BM_GetAlignedWidthAndHeight(benchmark::State &state) {
+  gralloc::SetLayoutCacheEnabled(state.range(0));
+  const gralloc::BufferInfo &info = kBuffers[state.range(1)];
+  unsigned int alignedw = 0, alignedh = 0;
+  for (auto _ : state) {
+    gralloc::GetAlignedWidthAndHeight(info, &alignedw, &alignedh);
+    benchmark::DoNotOptimize(alignedw);
+  }
+  gralloc::SetLayoutCacheEnabled(true);
+}
+BENCHMARK(BM_GetAlignedWidthAndHeight)->Apply(LayoutArgs);
+
+// Video buffers locked by codecs and turned into framebuffers by the composer.
+const gralloc::BufferInfo kYuvBuffers[] = {
+  {3840, 2160, HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS_UBWC,
+   BufferUsage::VIDEO_DECODER | BufferUsage::COMPOSER_OVERLAY},
+  {3840, 2160, HAL_PIXEL_FORMAT_YCbCr_420_TP10_UBWC,
+   BufferUsage::VIDEO_DECODER | BufferUsage::COMPOSER_OVERLAY},
+  {1920, 1080, HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS, BufferUsage::VIDEO_ENCODER},
+};
+
+void YuvLayoutArgs(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"cache", "buffer"});
+  for (int cache = 0; cache <= 1; cache++) {
+    for (int buffer = 0; buffer < INT(sizeof(kYuvBuffers) / sizeof(kYuvBuffers[0])); buffer++) {
+      b->Args({cache, buffer});
+    }
+  }
+}
+
+void BM_GetYUVPlaneInfo(benchmark::State &state) {
+  gralloc::SetLayoutCacheEnabled(state.range(0));
+  const gralloc::BufferInfo &info = kYuvBuffers[state.range(1)];
+  unsigned int alignedw = 0, alignedh = 0;
+  gralloc::GetAlignedWidthAndHeight(info, &alignedw, &alignedh);
+  gralloc::PlaneLayoutInfo plane_info[8] = {};
+  int plane_count = 0;
+  for (auto _ : state) {
+    gralloc::GetYUVPlaneInfo(info, info.format, INT(alignedw), INT(alignedh), 0, &plane_count,
+                             plane_info);
+    benchmark::DoNotOptimize(plane_info[0].size);
+  }
+  gralloc::SetLayoutCacheEnabled(true);
+}
+BENCHMARK(BM_GetYUVPlaneInfo)->Apply(YuvLayoutArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -29,6 +29,7 @@
 #include <hidl/LegacySupport.h>
 
 #include "QtiAllocator.h"
+#include "gr_camera_info.h"
 
 using android::hardware::configureRpcThreadpool;
 using android::hardware::joinRpcThreadpool;
@@ -36,6 +37,9 @@ using IQtiAllocator3 = vendor::qti::hardware::display::allocator::V3_0::IQtiAllo
 using IQtiAllocator4 = vendor::qti::hardware::display::allocator::V4_0::IQtiAllocator;
 
 int main(int, char **) {
+  // Load the camera format library before the first camera session needs it
+  gralloc::CameraInfo::GetInstance();
+
   android::sp<IQtiAllocator3> service3 =
       new vendor::qti::hardware::display::allocator::V3_0::implementation::QtiAllocator();
 
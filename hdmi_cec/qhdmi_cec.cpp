@@ -30,6 +30,7 @@
 #define DEBUG 0
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 #include <cstdlib>
+#include <inttypes.h>
 #include <log/log.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -42,8 +43,10 @@ namespace qhdmicec {
 
 const int NUM_HDMI_PORTS = 1;
 const int MAX_SYSFS_DATA = 128;
-const int MAX_CEC_FRAME_SIZE = 20;
+const int MAX_CEC_FRAME_SIZE = CEC_FRAME_SIZE;
 const int MAX_SEND_MESSAGE_RETRIES = 1;
+// Deliveries slower than this are logged, CEC responses are due within 200ms
+const nsecs_t CEC_SLOW_DELIVERY_NS = ms2ns(50);
 
 enum {
     LOGICAL_ADDRESS_SET   =  1,
@@ -63,7 +66,7 @@ enum {
 };
 
 //Forward declarations
-static void cec_close_context(cec_context_t* ctx __unused);
+static void cec_close_context(cec_context_t* ctx);
 static int cec_enable(cec_context_t *ctx, int enable);
 static int cec_is_connected(const struct hdmi_cec_device* dev, int port_id);
 
@@ -277,11 +280,8 @@ static int cec_send_message(const struct hdmi_cec_device* dev,
     }
 }
 
-void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len)
+static void cec_deliver_message(cec_context_t *ctx, const char *msg, ssize_t len)
 {
-    if(!ctx->system_control)
-        return;
-
     char dump[128];
     if(len > 0) {
         hex_to_string(msg, len, dump);
@@ -304,6 +304,120 @@ void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len)
     ctx->callback.callback_func(&event, ctx->callback.callback_arg);
 }
 
+static void *cec_msg_thread(void *arg)
+{
+    cec_context_t *ctx = (cec_context_t *) arg;
+    cec_msg_queue_t *queue = &ctx->msg_queue;
+    cec_queued_msg_t batch[CEC_MSG_QUEUE_SIZE];
+
+    pthread_mutex_lock(&queue->lock);
+    while (true) {
+        while (queue->running && !queue->count)
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        if (!queue->running)
+            break;
+
+        // Take everything queued so far with a single lock hold.
+        uint32_t count = queue->count;
+        for (uint32_t i = 0; i < count; i++)
+            batch[i] = queue->msgs[(queue->head + i) % CEC_MSG_QUEUE_SIZE];
+        queue->head = (queue->head + count) % CEC_MSG_QUEUE_SIZE;
+        queue->count = 0;
+        pthread_mutex_unlock(&queue->lock);
+
+        ATRACE_INT("CECMessageBatch", (int32_t) count);
+        nsecs_t total_latency = 0;
+        nsecs_t max_latency = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            cec_deliver_message(ctx, batch[i].frame, sizeof(batch[i].frame));
+            nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) -
+                    batch[i].received_time;
+            total_latency += latency;
+            if (latency > max_latency)
+                max_latency = latency;
+            if (latency > CEC_SLOW_DELIVERY_NS) {
+                ALOGW("%s: CEC message delivered after %" PRId64 " us",
+                        __FUNCTION__, ns2us(latency));
+            }
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        queue->delivered += count;
+        queue->total_latency += total_latency;
+        if (max_latency > queue->max_latency)
+            queue->max_latency = max_latency;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len)
+{
+    if(!ctx->system_control)
+        return;
+
+    // The frame length and the retransmit count are the last header fields.
+    if (len <= CEC_OFFSET_FRAME_LENGTH) {
+        ALOGE("%s: Dropping truncated CEC frame of %zd bytes", __FUNCTION__, len);
+        return;
+    }
+
+    cec_msg_queue_t *queue = &ctx->msg_queue;
+    pthread_mutex_lock(&queue->lock);
+    if (!queue->running || queue->count == CEC_MSG_QUEUE_SIZE) {
+        queue->dropped++;
+        pthread_mutex_unlock(&queue->lock);
+        ALOGE("%s: CEC message queue unavailable, message dropped", __FUNCTION__);
+        return;
+    }
+
+    cec_queued_msg_t *queued =
+            &queue->msgs[(queue->head + queue->count) % CEC_MSG_QUEUE_SIZE];
+    size_t copy_size = (size_t) len < sizeof(queued->frame) ?
+                       (size_t) len : sizeof(queued->frame);
+    memset(queued->frame, 0, sizeof(queued->frame));
+    memcpy(queued->frame, msg, copy_size);
+    queued->received_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    queue->count++;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void cec_start_msg_thread(cec_context_t *ctx)
+{
+    cec_msg_queue_t *queue = &ctx->msg_queue;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    queue->running = true;
+    if (pthread_create(&queue->thread, NULL, cec_msg_thread, ctx)) {
+        ALOGE("%s: Failed to create CEC message thread", __FUNCTION__);
+        queue->running = false;
+        return;
+    }
+    pthread_setname_np(queue->thread, "cec_msg");
+}
+
+static void cec_stop_msg_thread(cec_context_t *ctx)
+{
+    cec_msg_queue_t *queue = &ctx->msg_queue;
+    pthread_mutex_lock(&queue->lock);
+    bool running = queue->running;
+    queue->running = false;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    if (running)
+        pthread_join(queue->thread, NULL);
+
+    ALOGD("%s: %" PRIu64 " CEC messages delivered, %" PRIu64 " dropped, "
+            "average latency %" PRId64 " us, max %" PRId64 " us", __FUNCTION__,
+            queue->delivered, queue->dropped,
+            queue->delivered ? ns2us(queue->total_latency) / (nsecs_t) queue->delivered : 0,
+            ns2us(queue->max_latency));
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+}
+
 void cec_hdmi_hotplug(cec_context_t *ctx, int connected)
 {
     //Ignore unplug events when system control is disabled
@@ -445,6 +559,9 @@ static void cec_init_context(cec_context_t *ctx)
     ctx->vendor_id = 0xA47733;
     cec_clear_logical_address((hdmi_cec_device_t*)ctx);
 
+    //Deliver CEC messages from the display HAL off the binder thread
+    cec_start_msg_thread(ctx);
+
     //Set up listener for HDMI events
     ctx->disp_client = new qClient::QHDMIClient();
     ctx->disp_client->setCECContext(ctx);
@@ -456,9 +573,10 @@ static void cec_init_context(cec_context_t *ctx)
     ALOGD("%s: CEC enabled", __FUNCTION__);
 }
 
-static void cec_close_context(cec_context_t* ctx __unused)
+static void cec_close_context(cec_context_t* ctx)
 {
     ALOGD("%s: Closing context", __FUNCTION__);
+    cec_stop_msg_thread(ctx);
 }
 
 static int cec_device_open(const struct hw_module_t* module,
@@ -30,7 +30,9 @@
 #define QHDMI_CEC_H
 
 #include <hardware/hdmi_cec.h>
+#include <pthread.h>
 #include <utils/RefBase.h>
+#include <utils/Timers.h>
 
 namespace qClient {
     class QHDMIClient;
@@ -40,6 +42,8 @@ namespace qhdmicec {
 
 #define SYSFS_BASE  "/sys/class/graphics/fb"
 #define MAX_PATH_LENGTH  128
+#define CEC_FRAME_SIZE  20
+#define CEC_MSG_QUEUE_SIZE  32
 
 struct cec_callback_t {
     // Function in HDMI service to call back on CEC messages
@@ -49,6 +53,29 @@ struct cec_callback_t {
 
 };
 
+struct cec_queued_msg_t {
+    char frame[CEC_FRAME_SIZE];  // Frame as written by the driver
+    nsecs_t received_time;       // When the display HAL handed it over
+};
+
+// Messages received from the display HAL are queued by the binder thread and
+// handed to the framework by a dedicated thread, which drains the queue in
+// batches to keep the binder thread and the lock hold times short.
+struct cec_msg_queue_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    cec_queued_msg_t msgs[CEC_MSG_QUEUE_SIZE];
+    uint32_t head;               // Oldest queued message
+    uint32_t count;
+    // Delivery statistics, message received to framework callback returned
+    uint64_t delivered;
+    uint64_t dropped;
+    nsecs_t total_latency;
+    nsecs_t max_latency;
+};
+
 struct cec_context_t {
     hdmi_cec_device_t device;    // Device for HW module
     cec_callback_t callback;     // Struct storing callback object
@@ -65,6 +92,7 @@ struct cec_context_t {
     int version;
     uint32_t vendor_id;
     android::sp<qClient::QHDMIClient> disp_client;
+    cec_msg_queue_t msg_queue;
 };
 
 void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len);
@@ -0,0 +1,89 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DISPLAY_EVENT_RING_H__
+#define __DISPLAY_EVENT_RING_H__
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Read-only ring of per-display timing events, obtained with an eventfd through IQService
+// GET_DISPLAY_EVENT_CHANNEL. The composer appends events as they happen and signals the eventfd,
+// so a client can poll() it and read the new events with ReadDisplayEvent() without any binder
+// call. Events are numbered from 0; a client more than DISPLAY_EVENT_RING_SIZE events behind
+// loses the oldest ones.
+
+#define DISPLAY_EVENT_RING_VERSION 1
+#define DISPLAY_EVENT_RING_SIZE 64
+
+enum DisplayEventType {
+  DISPLAY_EVENT_VSYNC = 1,    // Hardware vsync, while vsync is enabled by the client
+  DISPLAY_EVENT_PRESENT = 2,  // Frame committed to the driver
+  DISPLAY_EVENT_RETIRE = 3,   // Frame shown, reported when the retire fence is found signaled
+};
+
+struct DisplayEventData {
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t frame;         // Present count of the frame, 0 for vsync
+  int64_t timestamp_ns;   // CLOCK_MONOTONIC
+};
+
+struct DisplayEventSlot {
+  std::atomic<uint64_t> number;  // Event number + 1 once written, 0 while being written
+  DisplayEventData data;
+};
+
+struct DisplayEventRing {
+  uint32_t version;
+  uint32_t size;
+  std::atomic<uint64_t> head;  // Number of events published
+  DisplayEventSlot slots[DISPLAY_EVENT_RING_SIZE];
+};
+
+// Reads event number. Returns 1 when read, 0 when it is not published yet and -1 when it was
+// already overwritten, in which case the oldest readable event is head - DISPLAY_EVENT_RING_SIZE.
+inline int ReadDisplayEvent(const DisplayEventRing *ring, uint64_t number,
+                            DisplayEventData *event) {
+  if (number >= ring->head.load(std::memory_order_acquire)) {
+    return 0;
+  }
+
+  const DisplayEventSlot &slot = ring->slots[number % DISPLAY_EVENT_RING_SIZE];
+  if (slot.number.load(std::memory_order_acquire) != number + 1) {
+    return -1;
+  }
+  *event = slot.data;
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return (slot.number.load(std::memory_order_relaxed) == number + 1) ? 1 : -1;
+}
+
+#endif  // __DISPLAY_EVENT_RING_H__
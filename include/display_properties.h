@@ -63,6 +63,7 @@
 #define SIMULATED_CONFIG_PROP                DISPLAY_PROP("simulated_config")
 #define MAX_EXTERNAL_LAYERS_PROP             DISPLAY_PROP("max_external_layers")
 #define PERF_HINT_WINDOW_PROP                DISPLAY_PROP("perf_hint_window")
+#define ENABLE_PERF_HINT_FEEDBACK_PROP       DISPLAY_PROP("enable_perf_hint_feedback")
 #define ENABLE_EXTERNAL_DOWNSCALE_PROP       DISPLAY_PROP("enable_external_downscale")
 #define EXTERNAL_ACTION_SAFE_WIDTH_PROP      DISPLAY_PROP("external_action_safe_width")
 #define EXTERNAL_ACTION_SAFE_HEIGHT_PROP     DISPLAY_PROP("external_action_safe_height")
@@ -80,12 +81,30 @@
 #define PRIORITIZE_CACHE_COMPOSITION_PROP    DISPLAY_PROP("prioritize_cache_comp")
 #define DISABLE_HW_RECOVERY_PROP             DISPLAY_PROP("disable_hw_recovery")
 #define DISABLE_HW_RECOVERY_DUMP_PROP        DISPLAY_PROP("disable_hw_recovery_dump")
+#define FRAME_DUMP_RING_SIZE_PROP            DISPLAY_PROP("frame_dump_ring_size_mb")
+#define FRAME_DUMP_COMPRESS_PROP             DISPLAY_PROP("frame_dump_compress")
+#define FRAME_DUMP_USAGE_MASK_PROP           DISPLAY_PROP("frame_dump_usage_mask")
+#define FRAME_DUMP_NAME_PROP                 DISPLAY_PROP("frame_dump_name")
+#define BUFFER_POOL_BUDGET_MB_PROP           DISPLAY_PROP("buffer_pool_budget_mb")
+#define LAYER_STACK_RECORD_FRAMES_PROP       DISPLAY_PROP("layer_stack_record_frames")
 #define DISABLE_SRC_TONEMAP_PROP             DISPLAY_PROP("disable_src_tonemap")
 #define ENABLE_NULL_DISPLAY_PROP             DISPLAY_PROP("enable_null_display")
 #define DISABLE_EXCL_RECT_PROP               DISPLAY_PROP("disable_excl_rect")
 #define ENABLE_PIPE_PRIORITY_PROP            DISPLAY_PROP("enable_pipe_priority")
 #define DISABLE_EXCl_RECT_PARTIAL_FB         DISPLAY_PROP("disable_excl_rect_partial_fb")
 #define DISABLE_FBID_CACHE                   DISPLAY_PROP("disable_fbid_cache")
+#define ENABLE_FBID_PREFETCH                 DISPLAY_PROP("enable_fbid_prefetch")
+#define DISABLE_PIPE_CONFIG_CACHE            DISPLAY_PROP("disable_pipe_config_cache")
+// Time in ms a lowered QoS vote is held back for, 0 votes every request as is
+#define QOS_VOTE_HOLD_MS                     DISPLAY_PROP("qos_vote_hold_ms")
+// Lowest percentage of a bandwidth request left after scaling it by the UBWC compression ratio
+// of the frame, 100 votes the request as is
+#define QOS_UBWC_MIN_PCT                     DISPLAY_PROP("qos_ubwc_min_pct")
+#define ENABLE_PIPE_ARBITRATION_PROP         DISPLAY_PROP("enable_pipe_arbitration")
+#define DISABLE_AUTO_MIXER_SCALING_PROP      DISPLAY_PROP("disable_auto_mixer_scaling")
+#define DISABLE_IDLE_PC_PREWAKE_PROP         DISPLAY_PROP("disable_idle_pc_prewake")
+// Thermal degradation ladder: "<level>:fps=<n>,stages=<n>,mixer=<percent>;<level>:..."
+#define THERMAL_LADDER_PROP                  DISPLAY_PROP("thermal_ladder")
 #define DISABLE_HOTPLUG_BWCHECK              DISPLAY_PROP("disable_hotplug_bwcheck")
 #define DISABLE_MASK_LAYER_HINT              DISPLAY_PROP("disable_mask_layer_hint")
 #define DISABLE_HDR_LUT_GEN                  DISPLAY_PROP("disable_hdr_lut_gen")
@@ -112,6 +131,12 @@
 #define ENABLE_FORCE_SPLIT                   DISPLAY_PROP("enable_force_split")
 #define DISABLE_GPU_COLOR_CONVERT            DISPLAY_PROP("disable_gpu_color_convert")
 #define ENABLE_ASYNC_VDS_CREATION            DISPLAY_PROP("enable_async_vds_creation")
+// Create secondary built-in and pluggable displays concurrently on hotplug callback registration
+#define ENABLE_ASYNC_DISPLAY_INIT            DISPLAY_PROP("enable_async_display_init")
+// GPU composed virtual display frames allowed in flight before new ones are dropped, 0 disables
+#define VDS_MAX_PENDING_FRAMES_PROP          DISPLAY_PROP("vds_max_pending_frames")
+// Time in ms a virtual display frame may wait for an in flight frame before it is dropped
+#define VDS_FRAME_DEADLINE_PROP              DISPLAY_PROP("vds_frame_deadline_ms")
 // MMNOC efficiency factor for Camera and Non-Camera cases
 #define NORMAL_NOC_EFFICIENCY_FACTOR         DISPLAY_PROP("normal_noc_efficiency_factor")
 #define CAMERA_NOC_EFFICIENCY_FACTOR         DISPLAY_PROP("camera_noc_efficiency_factor")
@@ -122,6 +147,58 @@
 #define DISABLE_INLINE_ROTATOR_UI_PROP       DISPLAY_PROP("disable_inline_rotator_ui")
 #define ENABLE_POMS_DURING_DOZE              DISPLAY_PROP("enable_poms_during_doze")
 #define DISABLE_DYNAMIC_FPS                  DISPLAY_PROP("disable_dynamic_fps")
+#define ENABLE_REFRESH_RATE_GOVERNOR_PROP    DISPLAY_PROP("enable_refresh_rate_governor")
+#define ENABLE_AVR_SCHEDULER_PROP            DISPLAY_PROP("enable_avr_scheduler")
+#define CONTENT_SIGNATURE_MAX_PIXELS_PROP    DISPLAY_PROP("content_signature_max_pixels")
+#define CONTENT_SAMPLING_BINS_PROP           DISPLAY_PROP("content_sampling_bins")
+#define ENABLE_ASYNC_BRIGHTNESS_PROP         DISPLAY_PROP("enable_async_brightness")
+#define TRACE_LOG_MASK_PROP                  DISPLAY_PROP("trace_log_mask")
+#define LOG_RATE_LIMIT_PROP                  DISPLAY_PROP("log_rate_limit")
+#define LOCKER_SPIN_COUNT_PROP               DISPLAY_PROP("locker_spin_count")
+// 1 limits dumpsys to display state and statistics, skipping the per layer details
+#define DUMP_LEVEL_PROP                      DISPLAY_PROP("dump_level")
+#define DISABLE_LIB_PRELOAD_PROP             DISPLAY_PROP("disable_lib_preload")
+#define ENABLE_CLIENT_TARGET_REUSE_PROP      DISPLAY_PROP("enable_client_target_reuse")
+#define ENABLE_GPU_TARGET_CROP_PROP          DISPLAY_PROP("enable_gpu_target_crop")
+#define ENABLE_EARLY_CONFIG_SUBMIT_PROP      DISPLAY_PROP("enable_early_config_submit")
+#define SOLID_FILL_DETECT_MAX_PIXELS_PROP    DISPLAY_PROP("solid_fill_detect_max_pixels")
+#define ENABLE_NULL_PRESENT_PROP             DISPLAY_PROP("enable_null_present")
+// Null display mode only: "<fps>,<fps>,..." drives one synthetic display per refresh rate
+#define PERF_TEST_FPS_PROP                   DISPLAY_PROP("perf_test_fps")
+#define PERF_TEST_RECORD_PROP                DISPLAY_PROP("perf_test_record")
+#define COMMAND_RECORD_BATCHES_PROP          DISPLAY_PROP("command_record_batches")
+// Query the driver for hardware resource info on every start instead of using the stored copy
+#define DISABLE_HW_INFO_CACHE_PROP           DISPLAY_PROP("disable_hw_info_cache")
+// Bring displays up in their default state after a composer restart, like on boot
+#define DISABLE_WARM_RESTART_PROP            DISPLAY_PROP("disable_warm_restart")
+// Compose layers hidden behind opaque layers like visible ones
+#define DISABLE_OCCLUSION_CULLING_PROP       DISPLAY_PROP("disable_occlusion_culling")
+// Refuse sideband streams, so that tunneled video is composed by the client
+#define DISABLE_SIDEBAND_STREAM_PROP         DISPLAY_PROP("disable_sideband_stream")
+// Do not tell producers by when the display needs their buffers
+#define DISABLE_FENCE_DEADLINE_PROP          DISPLAY_PROP("disable_fence_deadline")
+// Prefixes of the per thread class scheduling policy and CPU list, see utils/thread_policy.h
+#define THREAD_POLICY_PROP                   DISPLAY_PROP("thread_policy.")
+#define THREAD_CPUS_PROP                     DISPLAY_PROP("thread_cpus.")
+// 1 creates layer stitch and color sampling memory on first use and frees it once idle, 0 keeps
+// it allocated. Follows ro.config.low_ram when not set.
+#define LOW_RAM_MODE_PROP                    DISPLAY_PROP("low_ram_mode")
+// Frames kept for each capture of a missed vsync, 0 stops recording them. Captures are written
+// to the directory when one is set, and are always in dumpsys.
+#define JANK_RECORD_FRAMES_PROP              DISPLAY_PROP("jank_record_frames")
+#define JANK_RECORD_DIR_PROP                 DISPLAY_PROP("jank_record_dir")
+// Static frames after which unchanged command mode frames are no longer committed, 0 disables.
+#define SELF_REFRESH_STATIC_FRAMES_PROP      DISPLAY_PROP("self_refresh_static_frames")
+// Recover from ESD by power cycling only the panel of a built-in display, keeping its state.
+#define FAST_PANEL_RECOVERY_PROP             DISPLAY_PROP("fast_panel_recovery")
+// Lower the DSI bit clock of command mode panels to what the frame ROI and refresh rate need.
+#define ADAPTIVE_DSI_CLOCK_PROP              DISPLAY_PROP("adaptive_dsi_clock")
+// Drop frames of pluggable displays that would wait in the driver for the previous commit.
+#define ASYNC_PLUGGABLE_PRESENT_PROP         DISPLAY_PROP("async_pluggable_present")
+// Fall back to GPU on idle timeout even when the bandwidth model says SDE composition is cheaper.
+#define DISABLE_IDLE_FALLBACK_COST_MODEL_PROP DISPLAY_PROP("disable_idle_fallback_cost_model")
+// Skip commits of video mode panels showing an unchanged, fully GPU composed client target.
+#define ENABLE_CLIENT_TARGET_ELISION_PROP    DISPLAY_PROP("enable_client_target_elision")
 
 // Add all vendor.display properties above
 
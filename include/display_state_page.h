@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DISPLAY_STATE_PAGE_H__
+#define __DISPLAY_STATE_PAGE_H__
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Read-only page the composer exports per display, obtained through IQService
+// GET_DISPLAY_STATE_PAGE and mapped with PROT_READ. The composer updates it after every present.
+// The sequence is odd while an update is in progress: readers copy the page and retry until the
+// sequence read before and after the copy is the same even value, see ReadDisplayStatePage().
+// Answers of display config queries, such as the active config or the panel brightness, can be
+// cached for as long as config_generation does not move. The composer bumps it outside of the
+// sequence, as soon as any of them may have changed, and zeroes the version of a page whose
+// display is gone.
+
+#define DISPLAY_STATE_PAGE_VERSION 1
+#define DISPLAY_STATE_FRAME_TIME_BUCKETS 32  // 1 ms buckets, the last one open ended
+#define DISPLAY_STATE_COMPOSITION_TYPES 6    // Indexed by HWC2 composition type
+
+struct DisplayStatePage {
+  uint32_t version;
+  std::atomic<uint32_t> sequence;
+  uint64_t frame_count;
+  uint64_t last_present_ns;  // CLOCK_MONOTONIC
+  int32_t active_config;
+  uint32_t refresh_rate;
+  uint32_t fps;  // Presents over the last second
+  int32_t power_mode;  // HWC2 power mode
+  uint32_t qsync_enabled;
+  std::atomic<uint32_t> config_generation;
+  // Layers composed with each composition type since the page was created.
+  uint64_t composition_counts[DISPLAY_STATE_COMPOSITION_TYPES];
+  // Time between consecutive presents.
+  uint64_t frame_time_histogram[DISPLAY_STATE_FRAME_TIME_BUCKETS];
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Sequence must be a plain word");
+
+// Copies a consistent snapshot of the page. Returns false if the page is not a known version.
+inline bool ReadDisplayStatePage(const DisplayStatePage *page, DisplayStatePage *snapshot) {
+  if (page->version != DISPLAY_STATE_PAGE_VERSION) {
+    return false;
+  }
+
+  uint32_t sequence = 0;
+  do {
+    sequence = page->sequence.load(std::memory_order_acquire);
+    snapshot->frame_count = page->frame_count;
+    snapshot->last_present_ns = page->last_present_ns;
+    snapshot->active_config = page->active_config;
+    snapshot->refresh_rate = page->refresh_rate;
+    snapshot->fps = page->fps;
+    snapshot->power_mode = page->power_mode;
+    snapshot->qsync_enabled = page->qsync_enabled;
+    snapshot->config_generation.store(page->config_generation.load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+    for (int i = 0; i < DISPLAY_STATE_COMPOSITION_TYPES; i++) {
+      snapshot->composition_counts[i] = page->composition_counts[i];
+    }
+    for (int i = 0; i < DISPLAY_STATE_FRAME_TIME_BUCKETS; i++) {
+      snapshot->frame_time_histogram[i] = page->frame_time_histogram[i];
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) || sequence != page->sequence.load(std::memory_order_relaxed));
+
+  snapshot->version = page->version;
+  snapshot->sequence.store(sequence, std::memory_order_relaxed);
+
+  return true;
+}
+
+#endif  // __DISPLAY_STATE_PAGE_H__
@@ -109,6 +109,11 @@ C2D_STATUS (*LINK_c2dFillSurface) ( uint32 surface_id, uint32 fill_color,
 #define MAX_SURFACES (MAX_RGB_SURFACES + MAX_YUV_2_PLANE_SURFACES + MAX_YUV_3_PLANE_SURFACES + 1)
 #define NUM_SURFACE_TYPES 3      // RGB_SURFACE + YUV_SURFACE_2_PLANES + YUV_SURFACE_3_PLANES
 #define MAX_BLIT_OBJECT_COUNT 50 // Max. blit objects that can be passed per draw
+#define MAX_GPUADDR_CACHE_ENTRIES 32 // GPU mappings of client buffers kept across draws
+#define GPUADDR_CACHE_IDLE_DRAWS 120 // Mappings unused for this many draws are released
+#define MAX_TEMP_BUFFERS 4 // Temp buffers kept for the unaligned YUV blit path
+#define TEMP_BUFFER_BUCKET_SIZE (1 << 20) // Temp buffer sizes are rounded up to this
+#define TEMP_BUFFER_IDLE_DRAWS 120 // Temp buffers unused for this many draws are freed
 
 enum {
     RGB_SURFACE,
@@ -131,6 +136,32 @@ enum eC2DFlags {
 static gralloc::IAllocController* sAlloc = 0;
 /******************************************************************************/
 
+/** GPU mapping of a client buffer, reused by later blits of the same buffer */
+struct gpuaddr_cache_entry {
+    uint64_t buffer_id;      // 0 for a free entry
+    int fd;
+    unsigned int offset;
+    unsigned int size;
+    uint64_t base;
+    uintptr_t gpuaddr;
+    unsigned int last_draw;  // Last draw that used the mapping
+};
+
+/** Temp buffer of the unaligned YUV blit path, kept for later blits */
+struct temp_buffer_entry {
+    alloc_data data;         // fd is -1 for a free entry
+    unsigned int last_draw;  // Last draw that used the buffer
+};
+
+/** How often blits needed a temp buffer and how often one was allocated */
+struct temp_buffer_stats {
+    unsigned int src_blits;
+    unsigned int dst_blits;
+    unsigned int allocations;
+    unsigned int reuses;
+    unsigned int trims;
+};
+
 /** State information for each device instance */
 struct copybit_context_t {
     struct copybit_device_t device;
@@ -142,10 +173,14 @@ struct copybit_context_t {
     C2D_OBJECT_STR blit_list[MAX_BLIT_OBJECT_COUNT]; // Z-ordered list of blit objects
     C2D_DRIVER_INFO c2d_driver_info;
     void *libc2d2;
-    alloc_data temp_src_buffer;
-    alloc_data temp_dst_buffer;
+    temp_buffer_entry temp_buffers[MAX_TEMP_BUFFERS];
+    temp_buffer_stats temp_stats;
     unsigned int dst[NUM_SURFACE_TYPES]; // dst surfaces
     uintptr_t mapped_gpu_addr[MAX_SURFACES]; // GPU addresses mapped inside copybit
+    gpuaddr_cache_entry gpuaddr_cache[MAX_GPUADDR_CACHE_ENTRIES];
+    unsigned int draw_id;         // Draw being built, numbered from 1
+    unsigned int flushed_draw_id; // Last draw handed to the wait thread
+    unsigned int done_draw_id;    // Last draw known to be complete on the GPU
     int blit_rgb_count;         // Total RGB surfaces being blit
     int blit_yuv_2_plane_count; // Total 2 plane YUV surfaces being
     int blit_yuv_3_plane_count; // Total 3 plane YUV  surfaces being blit
@@ -213,6 +248,9 @@ struct copybit_module_t HAL_MODULE_INFO_SYM = {
 };
 
 
+static void trim_gpuaddr_cache(copybit_context_t* ctx, bool all = false);
+static void trim_temp_buffers(copybit_context_t* ctx, bool all = false);
+
 /* thread function which waits on the timeStamp and cleans up the surfaces */
 static void* c2d_wait_loop(void* ptr) {
     copybit_context_t* ctx = (copybit_context_t*)(ptr);
@@ -231,7 +269,9 @@ static void* c2d_wait_loop(void* ptr) {
                 ALOGE("%s: LINK_c2dWaitTimeStamp ERROR!!", __FUNCTION__);
             }
             ctx->wait_timestamp = false;
-            // Unmap any mapped addresses.
+            ctx->done_draw_id = ctx->flushed_draw_id;
+            trim_gpuaddr_cache(ctx);
+            // Unmap any addresses mapped for this draw only.
             for (int i = 0; i < MAX_SURFACES; i++) {
                 if (ctx->mapped_gpu_addr[i]) {
                     LINK_c2dUnMapAddr( (void*)ctx->mapped_gpu_addr[i]);
@@ -341,6 +381,59 @@ int c2diGetBpp(int32 colorformat)
     return c2dBpp;
 }
 
+/*
+ * Returns the cache entry mapping handle, or else an entry it can be mapped
+ * into, with a zero buffer id. Returns NULL if the handle cannot be cached.
+ */
+static gpuaddr_cache_entry* find_gpuaddr_cache_entry(copybit_context_t* ctx,
+                                                     struct private_handle_t *handle)
+{
+    if (!handle->id)
+        return NULL;
+
+    gpuaddr_cache_entry *free_entry = NULL;
+    gpuaddr_cache_entry *idle_entry = NULL;
+    for (int i = 0; i < MAX_GPUADDR_CACHE_ENTRIES; i++) {
+        gpuaddr_cache_entry *entry = &ctx->gpuaddr_cache[i];
+        if (!entry->buffer_id) {
+            if (!free_entry)
+                free_entry = entry;
+            continue;
+        }
+        if (entry->buffer_id == handle->id && entry->fd == handle->fd &&
+            entry->offset == handle->offset && entry->size == handle->size &&
+            entry->base == handle->base) {
+            return entry;
+        }
+        // Only mappings no pending draw uses can be replaced.
+        if (entry->last_draw <= ctx->done_draw_id &&
+            (!idle_entry || entry->last_draw < idle_entry->last_draw)) {
+            idle_entry = entry;
+        }
+    }
+
+    if (!free_entry && idle_entry) {
+        LINK_c2dUnMapAddr((void*)idle_entry->gpuaddr);
+        memset(idle_entry, 0, sizeof(*idle_entry));
+        free_entry = idle_entry;
+    }
+    return free_entry;
+}
+
+/* Release cached mappings idle for a while, or all idle ones */
+static void trim_gpuaddr_cache(copybit_context_t* ctx, bool all)
+{
+    for (int i = 0; i < MAX_GPUADDR_CACHE_ENTRIES; i++) {
+        gpuaddr_cache_entry *entry = &ctx->gpuaddr_cache[i];
+        if (!entry->buffer_id || entry->last_draw > ctx->done_draw_id)
+            continue;
+        if (all || entry->last_draw + GPUADDR_CACHE_IDLE_DRAWS < ctx->draw_id) {
+            LINK_c2dUnMapAddr((void*)entry->gpuaddr);
+            memset(entry, 0, sizeof(*entry));
+        }
+    }
+}
+
 static size_t c2d_get_gpuaddr(copybit_context_t* ctx,
                               struct private_handle_t *handle, int &mapped_idx)
 {
@@ -360,6 +453,28 @@ static size_t c2d_get_gpuaddr(copybit_context_t* ctx,
         return 0;
     }
 
+    // Buffers seen before keep their mapping. Buffers without an id, such as
+    // the temporary ones, are mapped for the current draw only.
+    gpuaddr_cache_entry *entry = find_gpuaddr_cache_entry(ctx, handle);
+    if (entry && entry->buffer_id) {
+        entry->last_draw = ctx->draw_id;
+        return entry->gpuaddr;
+    }
+    if (entry) {
+        rc = LINK_c2dMapAddr(handle->fd, (void*)handle->base, handle->size,
+                             handle->offset, memtype, (void**)&gpuaddr);
+        if (rc == C2D_STATUS_OK) {
+            entry->buffer_id = handle->id;
+            entry->fd = handle->fd;
+            entry->offset = handle->offset;
+            entry->size = handle->size;
+            entry->base = handle->base;
+            entry->gpuaddr = (uintptr_t)gpuaddr;
+            entry->last_draw = ctx->draw_id;
+        }
+        return (size_t)gpuaddr;
+    }
+
     // Check for a freeindex in the mapped_gpu_addr list
     for (freeindex = 0; freeindex < MAX_SURFACES; freeindex++) {
         if (ctx->mapped_gpu_addr[freeindex] == 0) {
@@ -659,6 +774,7 @@ static int flush_get_fence_copybit (struct copybit_device_t *dev, int* fd)
     }
     if(status == COPYBIT_SUCCESS) {
         //signal the wait_thread
+        ctx->flushed_draw_id = ctx->draw_id++;
         ctx->wait_timestamp = true;
         pthread_cond_signal(&ctx->wait_cleanup_cond);
     }
@@ -678,8 +794,11 @@ static int finish_copybit(struct copybit_device_t *dev)
         ALOGE("%s: LINK_c2dFinish ERROR", __FUNCTION__);
         return COPYBIT_FAILURE;
     }
+    ctx->done_draw_id = ctx->draw_id++;
+    trim_gpuaddr_cache(ctx);
+    trim_temp_buffers(ctx);
 
-    // Unmap any mapped addresses.
+    // Unmap any addresses mapped for this draw only.
     for (int i = 0; i < MAX_SURFACES; i++) {
         if (ctx->mapped_gpu_addr[i]) {
             LINK_c2dUnMapAddr( (void*)ctx->mapped_gpu_addr[i]);
@@ -988,7 +1107,8 @@ static int get_size(const bufferInfo& info)
 
 /* Function to allocate memory for the temporary buffer. This memory is
  * allocated from Ashmem. It is the caller's responsibility to free this
- * memory.
+ * memory. The size is rounded up to TEMP_BUFFER_BUCKET_SIZE, so that the
+ * buffer can be reused for a range of resolutions.
  */
 static int get_temp_buffer(const bufferInfo& info, alloc_data& data)
 {
@@ -997,7 +1117,7 @@ static int get_temp_buffer(const bufferInfo& info, alloc_data& data)
     data.base = 0;
     data.fd = -1;
     data.offset = 0;
-    data.size = get_size(info);
+    data.size = ALIGN(get_size(info), TEMP_BUFFER_BUCKET_SIZE);
     data.align = getpagesize();
     data.uncached = true;
     int allocFlags = 0;
@@ -1027,6 +1147,69 @@ static void free_temp_buffer(alloc_data &data)
     if (-1 != data.fd) {
         IMemAlloc* memalloc = sAlloc->getAllocator(data.allocType);
         memalloc->free_buffer(data.base, data.size, 0, data.fd);
+        data.fd = -1;
+        data.base = 0;
+        data.size = 0;
+    }
+}
+
+/* Function to get a temporary buffer large enough for info from the pool,
+ * other than exclude. A pooled buffer is reused if it is at most twice the
+ * required size, otherwise the least recently used one is replaced.
+ */
+static alloc_data* acquire_temp_buffer(copybit_context_t* ctx,
+                                       const bufferInfo& info,
+                                       const alloc_data *exclude)
+{
+    unsigned int size = ALIGN(get_size(info), TEMP_BUFFER_BUCKET_SIZE);
+    temp_buffer_entry *best = NULL;
+    temp_buffer_entry *victim = NULL;
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        temp_buffer_entry *entry = &ctx->temp_buffers[i];
+        if (&entry->data == exclude)
+            continue;
+        if (entry->data.fd != -1 && entry->data.size >= size &&
+            entry->data.size <= size * 2) {
+            if (!best || entry->data.size < best->data.size)
+                best = entry;
+            continue;
+        }
+        if (!victim || (victim->data.fd != -1 &&
+            (entry->data.fd == -1 || entry->last_draw < victim->last_draw))) {
+            victim = entry;
+        }
+    }
+
+    if (best) {
+        ctx->temp_stats.reuses++;
+        best->last_draw = ctx->draw_id;
+        return &best->data;
+    }
+    if (!victim)
+        return NULL;
+
+    free_temp_buffer(victim->data);
+    if (COPYBIT_SUCCESS != get_temp_buffer(info, victim->data)) {
+        victim->data.fd = -1;
+        victim->data.size = 0;
+        return NULL;
+    }
+    ctx->temp_stats.allocations++;
+    victim->last_draw = ctx->draw_id;
+    return &victim->data;
+}
+
+/* Function to free the pooled temporary buffers idle for a while, or all */
+static void trim_temp_buffers(copybit_context_t* ctx, bool all)
+{
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        temp_buffer_entry *entry = &ctx->temp_buffers[i];
+        if (entry->data.fd == -1)
+            continue;
+        if (all || entry->last_draw + TEMP_BUFFER_IDLE_DRAWS < ctx->draw_id) {
+            free_temp_buffer(entry->data);
+            ctx->temp_stats.trims++;
+        }
     }
 }
 
@@ -1179,21 +1362,21 @@ static int stretch_copybit_internal(
         ALOGE("%s: dst_hnd is null", __FUNCTION__);
         return COPYBIT_FAILURE;
     }
+    alloc_data *temp_dst_buffer = NULL;
     if (need_temp_dst) {
-        if (get_size(dst_info) != (int) ctx->temp_dst_buffer.size) {
-            free_temp_buffer(ctx->temp_dst_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_FAILURE == get_temp_buffer(dst_info, ctx->temp_dst_buffer)) {
-                ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                return COPYBIT_FAILURE;
-            }
+        ctx->temp_stats.dst_blits++;
+        // Get a temp buffer and set that as the destination.
+        temp_dst_buffer = acquire_temp_buffer(ctx, dst_info, NULL);
+        if (!temp_dst_buffer) {
+            ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
+            delete_handle(dst_hnd);
+            return COPYBIT_FAILURE;
         }
-        dst_hnd->fd = ctx->temp_dst_buffer.fd;
-        dst_hnd->size = ctx->temp_dst_buffer.size;
-        dst_hnd->flags = ctx->temp_dst_buffer.allocType;
-        dst_hnd->base = (uintptr_t)(ctx->temp_dst_buffer.base);
-        dst_hnd->offset = ctx->temp_dst_buffer.offset;
+        dst_hnd->fd = temp_dst_buffer->fd;
+        dst_hnd->size = temp_dst_buffer->size;
+        dst_hnd->flags = temp_dst_buffer->allocType;
+        dst_hnd->base = (uintptr_t)(temp_dst_buffer->base);
+        dst_hnd->offset = temp_dst_buffer->offset;
         dst_hnd->gpuaddr = 0;
         dst_image.handle = dst_hnd;
     }
@@ -1262,23 +1445,22 @@ static int stretch_copybit_internal(
         return COPYBIT_FAILURE;
     }
     if (need_temp_src) {
-        if (get_size(src_info) != (int) ctx->temp_src_buffer.size) {
-            free_temp_buffer(ctx->temp_src_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_SUCCESS != get_temp_buffer(src_info,
-                                               ctx->temp_src_buffer)) {
-                ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                delete_handle(src_hnd);
-                unmap_gpuaddr(ctx, mapped_dst_idx);
-                return COPYBIT_FAILURE;
-            }
+        ctx->temp_stats.src_blits++;
+        // Get a temp buffer, other than the destination one, for the source.
+        alloc_data *temp_src_buffer = acquire_temp_buffer(ctx, src_info,
+                                                          temp_dst_buffer);
+        if (!temp_src_buffer) {
+            ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
+            delete_handle(dst_hnd);
+            delete_handle(src_hnd);
+            unmap_gpuaddr(ctx, mapped_dst_idx);
+            return COPYBIT_FAILURE;
         }
-        src_hnd->fd = ctx->temp_src_buffer.fd;
-        src_hnd->size = ctx->temp_src_buffer.size;
-        src_hnd->flags = ctx->temp_src_buffer.allocType;
-        src_hnd->base = (uintptr_t)(ctx->temp_src_buffer.base);
-        src_hnd->offset = ctx->temp_src_buffer.offset;
+        src_hnd->fd = temp_src_buffer->fd;
+        src_hnd->size = temp_src_buffer->size;
+        src_hnd->flags = temp_src_buffer->allocType;
+        src_hnd->base = (uintptr_t)(temp_src_buffer->base);
+        src_hnd->offset = temp_src_buffer->offset;
         src_hnd->gpuaddr = 0;
         src_image.handle = src_hnd;
 
@@ -1471,6 +1653,10 @@ static void clean_up(copybit_context_t* ctx)
     pthread_mutex_destroy(&ctx->wait_cleanup_lock);
     pthread_cond_destroy (&ctx->wait_cleanup_cond);
 
+    // Nothing is pending once the wait thread is gone.
+    ctx->done_draw_id = ctx->draw_id;
+    trim_gpuaddr_cache(ctx, true);
+
     for (int i = 0; i < NUM_SURFACE_TYPES; i++) {
         if (ctx->dst[i])
             LINK_c2dDestroySurface(ctx->dst[i]);
@@ -1504,8 +1690,11 @@ static int close_copybit(struct hw_device_t *dev)
 {
     struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
     if (ctx) {
-        free_temp_buffer(ctx->temp_src_buffer);
-        free_temp_buffer(ctx->temp_dst_buffer);
+        ALOGD("%s: temp buffers for %u src and %u dst blits, %u allocated, "
+              "%u reused, %u trimmed", __FUNCTION__, ctx->temp_stats.src_blits,
+              ctx->temp_stats.dst_blits, ctx->temp_stats.allocations,
+              ctx->temp_stats.reuses, ctx->temp_stats.trims);
+        trim_temp_buffers(ctx, true);
     }
     clean_up(ctx);
     return 0;
@@ -1742,13 +1931,11 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
     // Initialize context variables.
     ctx->trg_transform = C2D_TARGET_ROTATE_0;
 
-    ctx->temp_src_buffer.fd = -1;
-    ctx->temp_src_buffer.base = 0;
-    ctx->temp_src_buffer.size = 0;
-
-    ctx->temp_dst_buffer.fd = -1;
-    ctx->temp_dst_buffer.base = 0;
-    ctx->temp_dst_buffer.size = 0;
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        ctx->temp_buffers[i].data.fd = -1;
+        ctx->temp_buffers[i].data.base = 0;
+        ctx->temp_buffers[i].data.size = 0;
+    }
 
     ctx->fb_width = 0;
     ctx->fb_height = 0;
@@ -1760,6 +1947,7 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
 
     ctx->wait_timestamp = false;
     ctx->stop_thread = false;
+    ctx->draw_id = 1;
     pthread_mutex_init(&(ctx->wait_cleanup_lock), NULL);
     pthread_cond_init(&(ctx->wait_cleanup_cond), NULL);
     /* Start the wait thread */
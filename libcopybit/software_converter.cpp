@@ -30,8 +30,62 @@
 #include <log/log.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#include <thread>
+#include <vector>
 #include "software_converter.h"
 
+// Frames with at least this many rows are converted by several threads,
+// each taking a band of rows. Smaller frames are not worth the thread start.
+#define CONVERTER_THREAD_MIN_ROWS 1080
+#define CONVERTER_MAX_THREADS     4
+
+/* Run fn(first_row, last_row) over [0, rows), split in bands for large frames */
+template <class RowFunc>
+static void for_each_row_band(unsigned int rows, RowFunc fn)
+{
+    unsigned int num_threads = 1;
+    if (rows >= CONVERTER_THREAD_MIN_ROWS) {
+        num_threads = std::thread::hardware_concurrency();
+        if (num_threads > CONVERTER_MAX_THREADS)
+            num_threads = CONVERTER_MAX_THREADS;
+        if (num_threads < 1)
+            num_threads = 1;
+    }
+
+    unsigned int band = (rows + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < num_threads && t * band < rows; t++) {
+        unsigned int last = (t + 1) * band < rows ? (t + 1) * band : rows;
+        threads.emplace_back(fn, t * band, last);
+    }
+    fn(0, band < rows ? band : rows);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+/* Interleave count bytes of v and u into vu, as V0 U0 V1 U1 ... */
+static void interleave_chroma(const unsigned char *v, const unsigned char *u,
+                              unsigned char *vu, unsigned int count)
+{
+    unsigned int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t pair;
+        pair.val[0] = vld1q_u8(v + i);
+        pair.val[1] = vld1q_u8(u + i);
+        vst2q_u8(vu + i * 2, pair);
+    }
+#endif
+    for (; i < count; i++) {
+        vu[i * 2]     = v[i];
+        vu[i * 2 + 1] = u[i];
+    }
+}
+
 /** Convert YV12 to YCrCb_420_SP */
 int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_handle)
 {
@@ -54,71 +108,25 @@ int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_h
     unsigned int   y_size  = stride * src->h;
     unsigned int   c_width = ALIGN(stride/2, (unsigned int)16);
     unsigned int   c_size  = c_width * src->h/2;
-    unsigned int   chromaPadding = c_width - width/2;
-    unsigned int   chromaSize = c_size * 2;
     unsigned char* newChroma = (unsigned char *)(yv12_handle->base + y_size);
     unsigned char* oldChroma = (unsigned char*)(hnd->base + y_size);
-    memcpy((char *)yv12_handle->base,(char *)hnd->base,y_size);
 
-#if defined(__ARM_HAVE_NEON) && !defined(__aarch64__)
-   /* interleave */
-    if(!chromaPadding) {
-        unsigned char * t1 = newChroma;
-        unsigned char * t2 = oldChroma;
-        unsigned char * t3 = t2 + chromaSize/2;
-        for(unsigned int i=0; i < (chromaSize/2)>>3; i++) {
-            __asm__ __volatile__ (
-                                    "vld1.u8 d0, [%0]! \n"
-                                    "vld1.u8 d1, [%1]! \n"
-                                    "vst2.u8 {d0, d1}, [%2]! \n"
-                                    :"+r"(t2), "+r"(t3), "+r"(t1)
-                                    :
-                                    :"memory","d0","d1"
-                                 );
+    unsigned char *new_y = (unsigned char *)yv12_handle->base;
+    unsigned char *old_y = (unsigned char *)hnd->base;
+    for_each_row_band(height, [=](unsigned int first, unsigned int last) {
+        memcpy(new_y + first * stride, old_y + first * stride, (last - first) * stride);
+    });
 
+    // Each source chroma row gives width/2 VU pairs, written back to back
+    // so the pairs from the padding are skipped. Without padding the rows
+    // are contiguous on both sides.
+    unsigned int row_bytes = width/2;
+    for_each_row_band(height/2, [=](unsigned int first, unsigned int last) {
+        for (unsigned int r = first; r < last; r++) {
+            interleave_chroma(oldChroma + r * c_width, oldChroma + c_size + r * c_width,
+                              newChroma + r * row_bytes * 2, row_bytes);
         }
-    }
-#else  //__ARM_HAVE_NEON
-    if(!chromaPadding) {
-        for(unsigned int i = 0; i< chromaSize/2; i++) {
-            newChroma[i*2]   = oldChroma[i];
-            newChroma[i*2+1] = oldChroma[i+chromaSize/2];
-        }
-
-    }
-#endif
-    // If the image is not aligned to 16 pixels,
-    // convert using the C routine below
-    // r1 tracks the row of the source buffer
-    // r2 tracks the row of the destination buffer
-    // The width/2 checks are to avoid copying
-    // from the padding
-
-    if(chromaPadding) {
-        unsigned int r1 = 0, r2 = 0, i = 0, j = 0;
-        while(r1 < height/2) {
-            if(j == width) {
-                j = 0;
-                r2++;
-                continue;
-            }
-            if (j+1 == width) {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                r2++;
-                newChroma[r2*width] = oldChroma[r1*c_width+i+c_size];
-                j = 1;
-            } else {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                newChroma[r2*width + j + 1] = oldChroma[r1*c_width+i+c_size];
-                j+=2;
-            }
-            i++;
-            if (i == width/2 ) {
-                i = 0;
-                r1++;
-            }
-        }
-    }
+    });
 
   return 0;
 }
@@ -134,6 +142,25 @@ struct copyInfo{
     size_t dst_plane2_offset;
 };
 
+/* Copy rows of width bytes between planes of different strides */
+static void copy_plane(const unsigned char *src, unsigned char *dst, int width,
+                       int height, int src_stride, int dst_stride)
+{
+    if (src_stride == dst_stride) {
+        for_each_row_band(height, [=](unsigned int first, unsigned int last) {
+            memcpy(dst + first * dst_stride, src + first * src_stride,
+                   (last - first) * src_stride);
+        });
+        return;
+    }
+
+    for_each_row_band(height, [=](unsigned int first, unsigned int last) {
+        for (unsigned int i = first; i < last; i++) {
+            memcpy(dst + i * dst_stride, src + i * src_stride, width);
+        }
+    });
+}
+
 /* Internal function to do the actual copy of source to destination */
 static int copy_source_to_destination(const uintptr_t src_base,
                                       const uintptr_t dst_base,
@@ -145,28 +172,16 @@ static int copy_source_to_destination(const uintptr_t src_base,
          return COPYBIT_FAILURE;
     }
 
-    int width = info.width;
-    int height = info.height;
-    unsigned char *src = (unsigned char*)src_base;
-    unsigned char *dst = (unsigned char*)dst_base;
-
     // Copy the luma
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    copy_plane((unsigned char*)src_base, (unsigned char*)dst_base, info.width,
+               info.height, info.src_stride, info.dst_stride);
 
-    // Copy plane 1
-    src = (unsigned char*)(src_base + info.src_plane1_offset);
-    dst = (unsigned char*)(dst_base + info.dst_plane1_offset);
-    width = width/2;
-    height = height/2;
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, info.src_stride);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    // Copy plane 1, interleaved chroma of half the height. Only width bytes
+    // of a row are copied, so the last row does not run past the plane
+    // when the source stride is the larger one.
+    copy_plane((unsigned char*)(src_base + info.src_plane1_offset),
+               (unsigned char*)(dst_base + info.dst_plane1_offset), info.width,
+               info.height/2, info.src_stride, info.dst_stride);
     return 0;
 }
 
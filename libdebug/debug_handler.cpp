@@ -27,6 +27,17 @@
 * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
 #include "debug_handler.h"
 
 namespace display {
@@ -41,6 +52,7 @@ class DefaultDebugHandler : public DebugHandler {
   virtual void Verbose(const char *, ...) { }
   virtual void BeginTrace(const char *, const char *, const char *) { }
   virtual void EndTrace() { }
+  virtual bool IsTraceEnabled() { return false; }
   virtual int GetProperty(const char *, int *) { return -1; }
   virtual int GetProperty(const char *, char *) { return -1; }
 };
@@ -48,6 +60,132 @@ class DefaultDebugHandler : public DebugHandler {
 DefaultDebugHandler g_default_debug_handler;
 DebugHandler * DebugHandler::debug_handler_ = &g_default_debug_handler;
 std::bitset<32> DebugHandler::log_mask_ = 0x1;  // Always print logs tagged with value 0
+std::bitset<32> DebugHandler::trace_mask_ = 0;
+std::atomic<uint32_t> DebugHandler::log_rate_limit_(0);
+
+namespace {
+
+const uint32_t kLogRingSize = 512;
+const uint32_t kNumTags = 32;
+
+// Writers claim the next slot and skip the record if a writer that wrapped around still holds it,
+// so recording never waits on another thread.
+struct LogSlot {
+  std::atomic<bool> busy;
+  LogRecord record;
+};
+
+struct RateLimitState {
+  std::atomic<int64_t> window_start_ms;
+  std::atomic<uint32_t> count;
+  std::atomic<uint64_t> dropped;
+};
+
+LogSlot g_log_ring[kLogRingSize];
+std::atomic<uint64_t> g_log_ring_head(0);
+std::atomic<uint64_t> g_log_ring_dropped(0);
+RateLimitState g_rate_limit[kNumTags];
+
+uint64_t NowNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void Append(std::string *out, const char *format, ...) __attribute__((__format__(printf, 2, 3)));
+
+void Append(std::string *out, const char *format, ...) {
+  char buffer[256];
+  va_list list;
+  va_start(list, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, list);
+  va_end(list);
+  if (len > 0) {
+    out->append(buffer, std::min(static_cast<size_t>(len), sizeof(buffer) - 1));
+  }
+}
+
+// Applies the record's arguments to its format. Conversions take the type the argument was
+// recorded with rather than the length modifier in the format, which the recorded type supersedes.
+void FormatRecord(const LogRecord &record, std::string *out) {
+  uint32_t next_arg = 0;
+  const char *p = record.format;
+  while (*p) {
+    if (*p != '%') {
+      const char *end = strchr(p, '%');
+      size_t len = end ? static_cast<size_t>(end - p) : strlen(p);
+      out->append(p, len);
+      p += len;
+      continue;
+    }
+    if (p[1] == '%') {
+      out->push_back('%');
+      p += 2;
+      continue;
+    }
+
+    std::string spec = "%";
+    p++;
+    while (*p && strchr("-+ #0", *p)) {
+      spec.push_back(*p++);
+    }
+    for (bool precision = false; ; precision = true) {
+      if (*p == '*') {
+        const LogArg *arg = (next_arg < record.num_args) ? &record.args[next_arg++] : nullptr;
+        spec += std::to_string(arg && arg->kind == LogArg::kSigned ? arg->i : 0);
+        p++;
+      } else {
+        while (isdigit(*p)) {
+          spec.push_back(*p++);
+        }
+      }
+      if (precision || *p != '.') {
+        break;
+      }
+      spec.push_back(*p++);
+    }
+    while (*p && strchr("hljztLq", *p)) {
+      p++;
+    }
+    char conversion = *p;
+    if (!conversion) {
+      break;
+    }
+    p++;
+
+    if (next_arg >= record.num_args) {
+      out->append("<?>");
+      continue;
+    }
+    const LogArg &arg = record.args[next_arg++];
+    switch (arg.kind) {
+    case LogArg::kSigned:
+    case LogArg::kUnsigned:
+      if (conversion == 'c') {
+        Append(out, (spec + "c").c_str(), static_cast<int>(arg.i));
+      } else if (strchr("ouxX", conversion)) {
+        Append(out, (spec + "ll" + conversion).c_str(), static_cast<unsigned long long>(arg.u));
+      } else if (arg.kind == LogArg::kUnsigned) {
+        Append(out, (spec + "llu").c_str(), static_cast<unsigned long long>(arg.u));
+      } else {
+        Append(out, (spec + "lld").c_str(), static_cast<long long>(arg.i));
+      }
+      break;
+    case LogArg::kDouble:
+      spec.push_back(strchr("fFeEgGaA", conversion) ? conversion : 'f');
+      Append(out, spec.c_str(), arg.d);
+      break;
+    case LogArg::kString:
+      Append(out, (spec + "s").c_str(), record.strings + arg.string_offset);
+      break;
+    case LogArg::kPointer:
+      Append(out, "%p", arg.p);
+      break;
+    }
+  }
+}
+
+}  // namespace
 
 void DebugHandler::Set(DebugHandler *debug_handler) {
   if (debug_handler) {
@@ -57,4 +195,118 @@ void DebugHandler::Set(DebugHandler *debug_handler) {
   }
 }
 
+bool DebugHandler::AllowRateLimitedLog(uint32_t tag) {
+  RateLimitState &state = g_rate_limit[tag % kNumTags];
+  int64_t now_ms = static_cast<int64_t>(NowNs() / 1000000);
+  int64_t window_start_ms = state.window_start_ms.load(std::memory_order_relaxed);
+  if (now_ms - window_start_ms >= 1000 &&
+      state.window_start_ms.compare_exchange_strong(window_start_ms, now_ms)) {
+    state.count.store(0, std::memory_order_relaxed);
+  }
+
+  if (state.count.fetch_add(1, std::memory_order_relaxed) < log_rate_limit_) {
+    return true;
+  }
+  state.dropped.fetch_add(1, std::memory_order_relaxed);
+
+  return false;
+}
+
+LogRecord *DebugHandler::BeginRecord(uint32_t tag, const char *format) {
+  uint64_t sequence = g_log_ring_head.fetch_add(1, std::memory_order_relaxed);
+  LogSlot &slot = g_log_ring[sequence % kLogRingSize];
+  if (slot.busy.exchange(true, std::memory_order_acquire)) {
+    g_log_ring_dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  LogRecord *record = &slot.record;
+  record->sequence = sequence;
+  record->timestamp_ns = NowNs();
+  record->format = format;
+  record->tid = static_cast<int32_t>(gettid());
+  record->tag = tag;
+  record->num_args = 0;
+  record->strings_used = 0;
+
+  return record;
+}
+
+void DebugHandler::EndRecord(LogRecord *record) {
+  g_log_ring[record->sequence % kLogRingSize].busy.store(false, std::memory_order_release);
+}
+
+LogArg *DebugHandler::NextArg(LogRecord *record) {
+  if (record->num_args >= LogRecord::kMaxArgs) {
+    return nullptr;
+  }
+
+  return &record->args[record->num_args++];
+}
+
+void DebugHandler::Encode(LogRecord *record, const char *value) {
+  LogArg *arg = NextArg(record);
+  if (!arg) {
+    return;
+  }
+
+  // Strings may not outlive the call, so they are truncated into the record's string space.
+  uint32_t offset = std::min(record->strings_used, LogRecord::kStringSpace - 1);
+  uint32_t space = LogRecord::kStringSpace - offset;
+  int len = snprintf(record->strings + offset, space, "%s", value ? value : "(null)");
+  arg->kind = LogArg::kString;
+  arg->string_offset = offset;
+  record->strings_used = offset + std::min(static_cast<uint32_t>(std::max(len, 0)), space - 1) + 1;
+}
+
+void DebugHandler::DumpLogRing(size_t max_size, std::string *out) {
+  uint64_t head = g_log_ring_head.load(std::memory_order_relaxed);
+  uint64_t first = (head > kLogRingSize) ? head - kLogRingSize : 0;
+
+  std::string header;
+  Append(&header, "\nLog ring: %" PRIu64 " recorded, %" PRIu64 " skipped, trace mask 0x%lx\n",
+         head, g_log_ring_dropped.load(std::memory_order_relaxed), trace_mask_.to_ulong());
+  for (uint32_t tag = 0; tag < kNumTags; tag++) {
+    uint64_t dropped = g_rate_limit[tag].dropped.load(std::memory_order_relaxed);
+    if (dropped) {
+      Append(&header, "  tag %u: %" PRIu64 " lines over the %u lines/s limit\n", tag, dropped,
+             log_rate_limit_.load());
+    }
+  }
+  if (header.size() > max_size) {
+    return;
+  }
+
+  // Newest records first until the budget runs out, then emitted in order.
+  std::vector<std::string> lines;
+  size_t size = header.size();
+  for (uint64_t sequence = head; sequence-- > first; ) {
+    LogSlot &slot = g_log_ring[sequence % kLogRingSize];
+    if (slot.busy.exchange(true, std::memory_order_acquire)) {
+      continue;
+    }
+    LogRecord record = slot.record;
+    slot.busy.store(false, std::memory_order_release);
+    if (record.sequence != sequence || !record.format) {
+      continue;
+    }
+
+    std::string line;
+    Append(&line, "  %" PRIu64 ".%06" PRIu64 " %5d %2u ", record.timestamp_ns / 1000000000,
+           (record.timestamp_ns / 1000) % 1000000, record.tid, record.tag);
+    FormatRecord(record, &line);
+    line.push_back('\n');
+    if (size + line.size() > max_size) {
+      break;
+    }
+    size += line.size();
+    lines.push_back(std::move(line));
+  }
+
+  out->append(header);
+  for (auto it = lines.rbegin(); it != lines.rend(); it++) {
+    out->append(*it);
+  }
+}
+
 }  // namespace display
@@ -30,14 +30,24 @@
 #ifndef __DEBUG_HANDLER_H__
 #define __DEBUG_HANDLER_H__
 
+#include <stdint.h>
+#include <atomic>
 #include <bitset>
+#include <string>
+#include <type_traits>
 
 #define DLOG(method, format, ...) \
   display::DebugHandler::Get()->method(__CLASS__ "::%s: " format, __FUNCTION__, ##__VA_ARGS__)
 
+// Tags enabled in the log mask go to the log, subject to the per tag rate limit. Tags enabled only
+// in the trace mask are recorded in the binary log ring instead and formatted when it is dumped.
 #define DLOG_IF(tag, method, format, ...) \
   if (display::DebugHandler::GetLogMask()[tag]) { \
-    DLOG(method, format, ##__VA_ARGS__); \
+    if (display::DebugHandler::AllowLog(tag)) { \
+      DLOG(method, format, ##__VA_ARGS__); \
+    } \
+  } else if (display::DebugHandler::GetTraceMask()[tag]) { \
+    display::DebugHandler::Record(tag, __CLASS__ "::%s: " format, __FUNCTION__, ##__VA_ARGS__); \
   }
 
 #define DLOGE_IF(tag, format, ...) DLOG_IF(tag, Error, format, ##__VA_ARGS__)
@@ -60,6 +70,36 @@
 
 namespace display {
 
+// One argument of a log ring record, stored raw so that formatting can wait for the dump.
+struct LogArg {
+  enum Kind : uint32_t { kSigned, kUnsigned, kDouble, kString, kPointer };
+
+  Kind kind;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const void *p;
+    uint32_t string_offset;  // Into LogRecord::strings, copied at record time.
+  };
+};
+
+// Fixed size log ring record. The format must be a string literal, which DLOG_IF guarantees.
+struct LogRecord {
+  static const uint32_t kMaxArgs = 12;
+  static const uint32_t kStringSpace = 64;
+
+  uint64_t sequence;
+  uint64_t timestamp_ns;
+  const char *format;
+  int32_t tid;
+  uint32_t tag;
+  uint32_t num_args;
+  uint32_t strings_used;
+  LogArg args[kMaxArgs];
+  char strings[kStringSpace];
+};
+
 class DebugHandler {
  public:
   // __format__(printf hints the compiler to validate format specifiers vs arguments provided.
@@ -71,6 +111,8 @@ class DebugHandler {
   virtual void BeginTrace(const char *class_name, const char *function_name,
                           const char *custom_string) = 0;
   virtual void EndTrace() = 0;
+  // Lets callers skip building trace strings nobody records.
+  virtual bool IsTraceEnabled() = 0;
   virtual int GetProperty(const char *property_name, int *value) = 0;
   virtual int GetProperty(const char *property_name, char *value) = 0;
 
@@ -78,13 +120,69 @@ class DebugHandler {
   static void Set(DebugHandler *debug_handler);
   static inline std::bitset<32> & GetLogMask() { return log_mask_; }
   static void SetLogMask(const std::bitset<32> &log_mask) { log_mask_ = log_mask; }
+  static inline std::bitset<32> & GetTraceMask() { return trace_mask_; }
+  static void SetTraceMask(const std::bitset<32> &trace_mask) { trace_mask_ = trace_mask; }
+
+  // Caps the lines per second each tag may log, 0 removes the limit.
+  static void SetLogRateLimit(uint32_t lines_per_sec) { log_rate_limit_ = lines_per_sec; }
+  static inline bool AllowLog(uint32_t tag) { return !log_rate_limit_ || AllowRateLimitedLog(tag); }
+
+  template <typename... Args>
+  static void Record(uint32_t tag, const char *format, Args... args) {
+    LogRecord *record = BeginRecord(tag, format);
+    if (record) {
+      int unused[] = { 0, (Encode(record, args), 0)... };
+      (void)unused;
+      EndRecord(record);
+    }
+  }
+
+  // Formats the newest log ring records that fit in max_size, oldest first, along with the number
+  // of lines the rate limit dropped.
+  static void DumpLogRing(size_t max_size, std::string *out);
 
  protected:
   virtual ~DebugHandler() { }
 
  private:
+  static bool AllowRateLimitedLog(uint32_t tag);
+  static LogRecord *BeginRecord(uint32_t tag, const char *format);
+  static void EndRecord(LogRecord *record);
+  static LogArg *NextArg(LogRecord *record);
+  static void Encode(LogRecord *record, const char *value);
+  static void Encode(LogRecord *record, char *value) { Encode(record, (const char *)value); }
+
+  template <typename T>
+  static void Encode(LogRecord *record, T value) {
+    LogArg *arg = NextArg(record);
+    if (!arg) {
+      return;
+    }
+    if (std::is_floating_point<T>::value) {
+      arg->kind = LogArg::kDouble;
+      arg->d = static_cast<double>(value);
+    } else if (std::is_signed<T>::value) {
+      arg->kind = LogArg::kSigned;
+      arg->i = static_cast<int64_t>(value);
+    } else {
+      arg->kind = LogArg::kUnsigned;
+      arg->u = static_cast<uint64_t>(value);
+    }
+  }
+
+  template <typename T>
+  static void Encode(LogRecord *record, T *value) {
+    LogArg *arg = NextArg(record);
+    if (arg) {
+      arg->kind = LogArg::kPointer;
+      arg->p = value;
+    }
+  }
+
   static DebugHandler *debug_handler_;
   static std::bitset<32> log_mask_;
+  static std::bitset<32> trace_mask_;
+  static std::atomic<uint32_t> log_rate_limit_;
 };
 
 template <class T>
@@ -864,6 +864,26 @@ struct DRMSolidfillStage {
   uint32_t plane_alpha = 0xff;
 };
 
+/* Per frame configuration of a plane, see DRMAtomicReqInterface::SetPlaneState().
+ * Each member matches the argument of the PLANE_SET_* op noted next to it. */
+struct DRMPlaneState {
+  uint32_t alpha = 0xff;                                       // PLANE_SET_ALPHA
+  uint32_t z_order = 0;                                        // PLANE_SET_ZORDER
+  DRMBlendType blending = DRMBlendType::UNDEFINED;             // PLANE_SET_BLEND_TYPE
+  DRMRect src = {};                                            // PLANE_SET_SRC_RECT
+  DRMRect dst = {};                                            // PLANE_SET_DST_RECT
+  DRMSSPPLayoutIndex layout_index = DRMSSPPLayoutIndex::NONE;  // PLANE_SET_SSPP_LAYOUT
+  DRMRect excl = {};                                           // PLANE_SET_EXCL_RECT
+  uint32_t rotation = 0;                                       // PLANE_SET_ROTATION
+  uint32_t h_decimation = 0;                                   // PLANE_SET_H_DECIMATION
+  uint32_t v_decimation = 0;                                   // PLANE_SET_V_DECIMATION
+  DRMSecureMode fb_secure_mode = DRMSecureMode::NON_SECURE;    // PLANE_SET_FB_SECURE_MODE
+  uint32_t src_config = 0;                                     // PLANE_SET_SRC_CONFIG
+  uint64_t scaler = 0;  // PLANE_SET_SCALER_CONFIG, 0 leaves the scaler untouched
+  DRMCscType csc_type = kCscTypeMax;                           // PLANE_SET_CSC_CONFIG
+  DRMMultiRectMode multirect_mode = DRMMultiRectMode::NONE;    // PLANE_SET_MULTIRECT_MODE
+};
+
 enum struct DRMFrameTriggerMode {
   FRAME_DONE_WAIT_DEFAULT = 0,
   FRAME_DONE_WAIT_SERIALIZE,
@@ -904,6 +924,14 @@ class DRMAtomicReqInterface {
    */
   virtual int Perform(DRMOps opcode, uint32_t obj_id, ...) = 0;
 
+  /* Sets all the properties of DRMPlaneState on a plane, in place of one Perform() per op.
+   *
+   * [input]: plane_id: Plane to configure
+   *          state: Configuration of the plane for this request
+   * [return]: Error code if the API fails, 0 on success.
+   */
+  virtual int SetPlaneState(uint32_t plane_id, const DRMPlaneState &state) = 0;
+
   /*
    * Commit the params set via Perform(). Also resets the properties after commit. Needs to be
    * called every frame.
@@ -968,6 +996,13 @@ class DRMManagerInterface {
    */
   virtual int GetConnectorsInfo(DRMConnectorsInfo *info) = 0;
 
+  /*
+   * Drops the cached info of a connector changed outside of hotplug, such as the mode list of a
+   * writeback connector. The next GetConnectorInfo probes it again.
+   * [input]: Connector id
+   */
+  virtual void InvalidateConnectorInfo(uint32_t conn_id) = 0;
+
   /*
    * Provides information on a selected encoder.
    * [output]: DRMEncoderInfo: Resource info for the given encoder id.
@@ -1037,6 +1072,17 @@ class DRMManagerInterface {
    */
   virtual int DestroyAtomicReq(DRMAtomicReqInterface *intf) = 0;
 
+  /*
+   * Commits the params staged on several displays with a single atomic commit, so that displays
+   * sharing a vsync domain latch their updates together. Resets the properties of every request
+   * after the commit, as DRMAtomicReqInterface::Commit does.
+   * [input]: reqs: DRMAtomicReqInterface instances of the displays to commit, one per CRTC
+   * [input]: synchronous: Determines if the call should block until a h/w flip
+   * [return]: Error code if the API fails, 0 on success.
+   */
+  virtual int CommitAtomicReqs(const std::vector<DRMAtomicReqInterface *> &reqs,
+                               bool synchronous) = 0;
+
   /*
    * Sets the global scaler LUT
    * [input]: LUT Info
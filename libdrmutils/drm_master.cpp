@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2017 - 2018, The Linux Foundation. All rights reserved.
+* Copyright (c) 2017 - 2018, 2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -29,6 +29,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <xf86drm.h>
@@ -46,6 +47,9 @@
 
 using std::mutex;
 using std::lock_guard;
+using std::unique_lock;
+using std::thread;
+using std::vector;
 using std::begin;
 using std::copy;
 using std::end;
@@ -89,6 +93,15 @@ int DRMMaster::Init() {
 }
 
 DRMMaster::~DRMMaster() {
+  {
+    lock_guard<mutex> lock(deferred_lock_);
+    deferred_exit_ = true;
+  }
+  deferred_cv_.notify_one();
+  if (deferred_thread_.joinable()) {
+    deferred_thread_.join();
+  }
+
   drmClose(dev_fd_);
   dev_fd_ = -1;
 }
@@ -145,6 +158,49 @@ int DRMMaster::RemoveFbId(uint32_t fb_id) {
   return ret;
 }
 
+int DRMMaster::RemoveFbIdDeferred(uint32_t fb_id) {
+  // Legacy rmfb disables the planes still scanning out the FB, so only the ref counted version
+  // can be issued at an arbitrary later point.
+  if (!IsRmFbRefCounted()) {
+    return RemoveFbId(fb_id);
+  }
+
+  {
+    lock_guard<mutex> lock(deferred_lock_);
+    if (!deferred_thread_.joinable()) {
+      deferred_thread_ = thread(&DRMMaster::RemoveFbIdThread, this);
+    }
+    deferred_fb_ids_.push_back(fb_id);
+  }
+  deferred_cv_.notify_one();
+
+  return 0;
+}
+
+void DRMMaster::RemoveFbIdThread() {
+  setpriority(PRIO_PROCESS, 0, 10);
+
+  vector<uint32_t> fb_ids;
+  unique_lock<mutex> lock(deferred_lock_);
+  while (true) {
+    deferred_cv_.wait(lock, [this] { return deferred_exit_ || !deferred_fb_ids_.empty(); });
+    // Everything queued so far, e.g. a whole buffer map being cleared, is removed in one pass.
+    fb_ids.swap(deferred_fb_ids_);
+    bool exiting = deferred_exit_;
+    lock.unlock();
+
+    for (uint32_t fb_id : fb_ids) {
+      RemoveFbId(fb_id);
+    }
+    fb_ids.clear();
+
+    if (exiting) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
 bool DRMMaster::IsRmFbRefCounted() {
 #ifdef DRM_IOCTL_MSM_RMFB2
   return true;
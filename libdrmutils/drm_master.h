@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+* Copyright (c) 2017, 2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -30,7 +30,10 @@
 #ifndef __DRM_MASTER_H__
 #define __DRM_MASTER_H__
 
+#include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "drm_logger.h"
 
@@ -66,6 +69,15 @@ class DRMMaster {
    *   ioctl error code
    */
   int RemoveFbId(uint32_t fb_id);
+  /* Removes the fb_id from DRM on a low priority worker when the ref counted version of rmfb is
+   * in use, in which case the driver keeps the FB alive for as long as it is being scanned out.
+   * Falls back to RemoveFbId() otherwise.
+   * Input:
+   *   fb_id: DRM FB to be removed
+   * Returns:
+   *   0 if the removal was queued, else ioctl error code
+   */
+  int RemoveFbIdDeferred(uint32_t fb_id);
   /* Poplulates master DRM fd
    * Input:
    *   fd: Pointer to store master fd into
@@ -86,8 +98,14 @@ class DRMMaster {
  private:
   DRMMaster() {}
   int Init();
+  void RemoveFbIdThread();
 
   int dev_fd_ = -1;              // Master fd for DRM
+  std::mutex deferred_lock_;
+  std::condition_variable deferred_cv_;
+  std::vector<uint32_t> deferred_fb_ids_;  // FBs waiting to be removed by the worker
+  std::thread deferred_thread_;            // Started on first deferred removal
+  bool deferred_exit_ = false;
   static DRMMaster *s_instance;  // Singleton instance
   static std::mutex s_lock;
 };
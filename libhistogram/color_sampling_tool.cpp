@@ -32,7 +32,8 @@ void show_usage(char *progname) {
             << "\t-h      display this help message\n"
             << "\t-o      write output to specified filename\n"
             << "\t-t NUM  Collect results over NUM seconds, and then exit\n"
-            << "\t-m NUM  Only store the last NUM frames of statistics\n";
+            << "\t-m NUM  Only store the last NUM frames of statistics\n"
+            << "\t-b NUM  Report NUM bins, a divisor of the hardware bin count (default 8)\n";
 }
 
 int main(int argc, char **argv) {
@@ -45,7 +46,8 @@ int main(int argc, char **argv) {
   int c;
   char *output_filename = NULL;
   int timeout = -1;
-  while ((c = getopt(argc, argv, "o:t:h")) != -1) {
+  uint32_t bins = 0;
+  while ((c = getopt(argc, argv, "o:t:b:h")) != -1) {
     switch (c) {
       case 'o':
         output_filename = optarg;
@@ -53,6 +55,9 @@ int main(int argc, char **argv) {
       case 't':
         timeout = strtol(optarg, NULL, 10);
         break;
+      case 'b':
+        bins = strtoul(optarg, NULL, 10);
+        break;
       default:
       case 'h':
         show_usage(argv[0]);
@@ -61,6 +66,10 @@ int main(int argc, char **argv) {
   }
 
   histogram::HistogramCollector histogram;
+  if (bins && !histogram.set_bin_count(bins)) {
+    std::cerr << "Unsupported bin count: " << bins << "\n";
+    return EXIT_FAILURE;
+  }
   histogram.start();
 
   bool cancelled_during_wait = false;
@@ -30,6 +30,7 @@
 #include <sstream>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <drm/msm_drm.h>
@@ -41,39 +42,48 @@
 #include "ringbuffer.h"
 
 constexpr static auto implementation_defined_max_frame_ringbuffer = 300;
+constexpr static uint32_t default_bin_count = 8;
+static_assert((HIST_V_SIZE % default_bin_count) == 0,
+              "histogram cannot be rebucketed to smaller number of buckets");
 
-histogram::HistogramCollector::HistogramCollector()
-    : histogram(histogram::Ringbuffer::create(implementation_defined_max_frame_ringbuffer,
-                                              std::make_unique<histogram::DefaultTimeKeeper>())) {}
+histogram::HistogramCollector::HistogramCollector() : bin_count(default_bin_count) {}
 
 histogram::HistogramCollector::~HistogramCollector() {
   stop();
 }
 
-namespace {
-static constexpr size_t numBuckets = 8;
-static_assert((HIST_V_SIZE % numBuckets) == 0,
-              "histogram cannot be rebucketed to smaller number of buckets");
-static constexpr int bucket_compression = HIST_V_SIZE / numBuckets;
-
-std::array<uint64_t, numBuckets> rebucketTo8Buckets(
-    std::array<uint64_t, HIST_V_SIZE> const &frame) {
-  std::array<uint64_t, numBuckets> bins;
-  bins.fill(0);
-  for (auto i = 0u; i < HIST_V_SIZE; i++)
-    bins[i / bucket_compression] += frame[i];
-  return bins;
+bool histogram::HistogramCollector::set_bin_count(uint32_t count) {
+  if ((count == 0) || (count > HIST_V_SIZE) || (HIST_V_SIZE % count) != 0)
+    return false;
+  bin_count = count;
+  return true;
 }
-}  // namespace
 
 std::string histogram::HistogramCollector::Dump() const {
   uint64_t num_frames;
   std::array<uint64_t, HIST_V_SIZE> all_sample_buckets;
-  std::tie(num_frames, all_sample_buckets) = histogram->collect_cumulative();
-  std::array<uint64_t, numBuckets> samples = rebucketTo8Buckets(all_sample_buckets);
+  auto const ring = std::atomic_load(&histogram);
+  if (ring) {
+    std::tie(num_frames, all_sample_buckets) = ring->collect_cumulative();
+  } else {
+    num_frames = 0;
+    all_sample_buckets.fill(0);
+  }
+  std::vector<uint64_t> samples(bin_count);
+  histogram::Ringbuffer::reduce(all_sample_buckets, static_cast<uint32_t>(samples.size()),
+                                samples.data());
+
+  uint64_t coalesced;
+  uint64_t dropped;
+  {
+    std::unique_lock<decltype(mutex)> lk(mutex);
+    coalesced = coalesced_events;
+    dropped = dropped_blobs;
+  }
 
   std::stringstream ss;
   ss << "Color Sampling, dark (0.0) to light (1.0): sampled frames: " << num_frames << '\n';
+  ss << "\tcoalesced events: " << coalesced << ", unreadable blobs: " << dropped << '\n';
   if (num_frames == 0) {
     ss << "\tno color statistics collected\n";
     return ss.str();
@@ -96,28 +106,31 @@ HWC2::Error histogram::HistogramCollector::collect(
   if (!out_samples_size || !out_num_frames)
     return HWC2::Error::BadParameter;
 
+  uint32_t const num_bins = bin_count;
   out_samples_size[0] = 0;
   out_samples_size[1] = 0;
-  out_samples_size[2] = numBuckets;
+  out_samples_size[2] = static_cast<int32_t>(num_bins);
   out_samples_size[3] = 0;
 
-  uint64_t num_frames;
-  std::array<uint64_t, HIST_V_SIZE> samples;
+  uint64_t num_frames = 0;
+  std::array<uint64_t, HIST_V_SIZE> samples = {};
 
-  if (max_frames == 0 && timestamp == 0) {
-    std::tie(num_frames, samples) = histogram->collect_cumulative();
+  auto const ring = std::atomic_load(&histogram);
+  if (!ring) {
+    // Sampling was never started, or the ring was released since.
+  } else if (max_frames == 0 && timestamp == 0) {
+    std::tie(num_frames, samples) = ring->collect_cumulative();
   } else if (max_frames == 0) {
-    std::tie(num_frames, samples) = histogram->collect_after(timestamp);
+    std::tie(num_frames, samples) = ring->collect_after(timestamp);
   } else if (timestamp == 0) {
-    std::tie(num_frames, samples) = histogram->collect_max(max_frames);
+    std::tie(num_frames, samples) = ring->collect_max(max_frames);
   } else {
-    std::tie(num_frames, samples) = histogram->collect_max_after(timestamp, max_frames);
+    std::tie(num_frames, samples) = ring->collect_max_after(timestamp, max_frames);
   }
 
-  auto samples_rebucketed = rebucketTo8Buckets(samples);
   *out_num_frames = num_frames;
   if (out_samples && out_samples[2])
-    memcpy(out_samples[2], samples_rebucketed.data(), sizeof(uint64_t) * samples_rebucketed.size());
+    histogram::Ringbuffer::reduce(samples, num_bins, out_samples[2]);
 
   return HWC2::Error::None;
 }
@@ -144,8 +157,9 @@ void histogram::HistogramCollector::start(uint64_t max_frames) {
   }
 
   started = true;
-  histogram =
+  std::shared_ptr<histogram::Ringbuffer> ring =
       histogram::Ringbuffer::create(max_frames, std::make_unique<histogram::DefaultTimeKeeper>());
+  std::atomic_store(&histogram, ring);
   monitoring_thread = std::thread(&HistogramCollector::blob_processing_thread, this);
 }
 
@@ -163,6 +177,20 @@ void histogram::HistogramCollector::stop() {
     monitoring_thread.join();
 }
 
+void histogram::HistogramCollector::release() {
+  std::unique_lock<decltype(mutex)> lk(mutex);
+  if (started) {
+    return;
+  }
+
+  std::atomic_store(&histogram, std::shared_ptr<histogram::Ringbuffer>());
+}
+
+size_t histogram::HistogramCollector::memory_usage() const {
+  auto const ring = std::atomic_load(&histogram);
+  return ring ? ring->memory_usage() : 0;
+}
+
 void histogram::HistogramCollector::notify_histogram_event(int blob_source_fd, BlobId id) {
   std::unique_lock<decltype(mutex)> lk(mutex);
   if (!started) {
@@ -170,7 +198,9 @@ void histogram::HistogramCollector::notify_histogram_event(int blob_source_fd, B
     return;
   }
   if (work_available) {
-    ALOGI("notified of histogram event before consuming last one. prior event discarded");
+    // Only the latest histogram matters; the older blob is never read.
+    ALOGV("notified of histogram event before consuming last one. prior event discarded");
+    coalesced_events++;
   }
 
   work_available = true;
@@ -178,8 +208,16 @@ void histogram::HistogramCollector::notify_histogram_event(int blob_source_fd, B
   cv.notify_all();
 }
 
+void histogram::HistogramCollector::set_thread_init(std::function<void()> init) {
+  std::unique_lock<decltype(mutex)> lk(mutex);
+  thread_init = std::move(init);
+}
+
 void histogram::HistogramCollector::blob_processing_thread() {
   pthread_setname_np(pthread_self(), "histogram_blob");
+  if (thread_init) {
+    thread_init();
+  }
 
   std::unique_lock<decltype(mutex)> lk(mutex);
 
@@ -193,14 +231,21 @@ void histogram::HistogramCollector::blob_processing_thread() {
     work_available = false;
     lk.unlock();
 
-    drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(work.fd, work.id);
-    if (!blob) {
-      lk.lock();
-      continue;
-    }
-    histogram->insert(*static_cast<struct drm_msm_hist *>(blob->data));
-    drmModeFreePropertyBlob(blob);
+    // Read the blob straight into the ring rather than through drmModeGetPropertyBlob, which
+    // allocates a copy of every blob.
+    auto inserted = std::atomic_load(&histogram)->insert_in_place([&work](drm_msm_hist &hist) {
+      struct drm_mode_get_blob blob_get = {};
+      blob_get.blob_id = work.id;
+      blob_get.length = sizeof(hist);
+      blob_get.data = reinterpret_cast<uintptr_t>(&hist);
+      // The kernel only copies the blob when the length matches, and reports the blob length.
+      return (drmIoctl(work.fd, DRM_IOCTL_MODE_GETPROPBLOB, &blob_get) == 0) &&
+          (blob_get.length == sizeof(hist));
+    });
 
     lk.lock();
+    if (!inserted) {
+      dropped_blobs++;
+    }
   }
 }
@@ -17,7 +17,9 @@
 #ifndef HISTOGRAM_HISTOGRAM_COLLECTOR_H_
 #define HISTOGRAM_HISTOGRAM_COLLECTOR_H_
 #include <android-base/thread_annotations.h>
+#include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -42,6 +44,14 @@ class HistogramCollector {
   void start();
   void start(uint64_t max_frames);
   void stop();
+  // Frees the frame ring, which is otherwise kept after stop() for later collect() calls. Does
+  // nothing while started; the next start() creates a new ring.
+  void release();
+  size_t memory_usage() const;
+  // Number of bins of the V component returned by collect(); must divide HIST_V_SIZE.
+  bool set_bin_count(uint32_t bin_count);
+  // Run first thing on the processing thread, e.g. to set its scheduling policy. Set before start.
+  void set_thread_init(std::function<void()> thread_init);
 
   void notify_histogram_event(int blob_source_fd, BlobId id);
 
@@ -69,10 +79,16 @@ class HistogramCollector {
   // no optional in c++14.
   bool work_available = false; /* GUARDED_BY(mutex) */
   ;
+  // Events replaced by a newer one before the processing thread picked them up.
+  uint64_t coalesced_events /* GUARDED_BY(mutex) */ = 0;
+  uint64_t dropped_blobs /* GUARDED_BY(mutex) */ = 0;
+  std::atomic<uint32_t> bin_count;
 
+  std::function<void()> thread_init;
   std::thread monitoring_thread;
 
-  std::unique_ptr<histogram::Ringbuffer> histogram;
+  // Created by start(). Swapped atomically, since collect() runs without the mutex.
+  std::shared_ptr<histogram::Ringbuffer> histogram;
 };
 
 }  // namespace histogram
@@ -17,19 +17,98 @@
 #include <log/log.h>
 #include <unistd.h>
 #include <algorithm>
-#include <iostream>
+#include <chrono>
+#include <limits>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "ringbuffer.h"
 
+namespace {
+
+using Bins = std::array<uint64_t, HIST_V_SIZE>;
+static_assert(HIST_V_SIZE % 4 == 0, "histogram kernels process four bins at a time");
+
+// bins[i] += data[i] * weight, modulo 2^64.
+void accumulate_weighted(Bins &bins, uint32_t const *data, uint64_t weight) {
+#if defined(__ARM_NEON)
+  if (weight <= std::numeric_limits<uint32_t>::max()) {
+    uint32x2_t const w = vdup_n_u32(static_cast<uint32_t>(weight));
+    for (auto i = 0u; i < HIST_V_SIZE; i += 4) {
+      uint32x4_t const d = vld1q_u32(data + i);
+      vst1q_u64(&bins[i], vmlal_u32(vld1q_u64(&bins[i]), vget_low_u32(d), w));
+      vst1q_u64(&bins[i + 2], vmlal_u32(vld1q_u64(&bins[i + 2]), vget_high_u32(d), w));
+    }
+    return;
+  }
+#endif
+  for (auto i = 0u; i < HIST_V_SIZE; i++)
+    bins[i] += data[i] * weight;
+}
+
+// bins[i] += data[i] * weight, clamping to the maximum value when the increment or the sum
+// overflows.
+void accumulate_weighted_saturating(Bins &bins, uint32_t const *data, uint64_t weight) {
+#if defined(__ARM_NEON)
+  // For weights in [1, 2^32) the 32x32 bit product cannot overflow and is never smaller than
+  // the sample, so only the addition needs saturating.
+  if ((weight != 0) && (weight <= std::numeric_limits<uint32_t>::max())) {
+    uint32x2_t const w = vdup_n_u32(static_cast<uint32_t>(weight));
+    for (auto i = 0u; i < HIST_V_SIZE; i += 4) {
+      uint32x4_t const d = vld1q_u32(data + i);
+      vst1q_u64(&bins[i], vqaddq_u64(vld1q_u64(&bins[i]), vmull_u32(vget_low_u32(d), w)));
+      vst1q_u64(&bins[i + 2],
+                vqaddq_u64(vld1q_u64(&bins[i + 2]), vmull_u32(vget_high_u32(d), w)));
+    }
+    return;
+  }
+#endif
+  for (auto i = 0u; i < HIST_V_SIZE; i++) {
+    auto const increment = data[i] * weight;
+    if (CC_UNLIKELY((bins[i] + increment < bins[i]) || (increment < data[i]))) {
+      bins[i] = std::numeric_limits<uint64_t>::max();
+    } else {
+      bins[i] += increment;
+    }
+  }
+}
+
+// out[i] = a[i] - b[i], modulo 2^64.
+void subtract_bins(Bins &out, Bins const &a, Bins const &b) {
+#if defined(__ARM_NEON)
+  for (auto i = 0u; i < HIST_V_SIZE; i += 2)
+    vst1q_u64(&out[i], vsubq_u64(vld1q_u64(&a[i]), vld1q_u64(&b[i])));
+#else
+  for (auto i = 0u; i < HIST_V_SIZE; i++)
+    out[i] = a[i] - b[i];
+#endif
+}
+
+}  // namespace
+
 nsecs_t histogram::DefaultTimeKeeper::current_time() const {
   return systemTime(SYSTEM_TIME_MONOTONIC);
 }
 
-histogram::Ringbuffer::Ringbuffer(size_t ringbuffer_size, std::unique_ptr<histogram::TimeKeeper> tk)
-    : rb_max_size(ringbuffer_size), timekeeper(std::move(tk)), cumulative_frame_count(0) {
+histogram::Ringbuffer::Storage::Storage(size_t capacity)
+    : entries(capacity + 1),
+      start_times(capacity + 1),
+      sequence(0),
+      head(0),
+      size(0),
+      cumulative_frame_count(0) {
   cumulative_bins.fill(0);
 }
 
+size_t histogram::Ringbuffer::Storage::slot(size_t index) const {
+  return (head + entries.size() - index) % entries.size();
+}
+
+histogram::Ringbuffer::Ringbuffer(size_t ringbuffer_size, std::unique_ptr<histogram::TimeKeeper> tk)
+    : storage(std::make_shared<Storage>(ringbuffer_size)), timekeeper(std::move(tk)) {}
+
 std::unique_ptr<histogram::Ringbuffer> histogram::Ringbuffer::create(
     size_t ringbuffer_size, std::unique_ptr<histogram::TimeKeeper> tk) {
   if ((ringbuffer_size == 0) || !tk)
@@ -38,114 +117,181 @@ std::unique_ptr<histogram::Ringbuffer> histogram::Ringbuffer::create(
       new histogram::Ringbuffer(ringbuffer_size, std::move(tk)));
 }
 
-void histogram::Ringbuffer::update_cumulative(nsecs_t now, uint64_t &count,
+uint64_t histogram::Ringbuffer::weight_ms(nsecs_t start, nsecs_t end) {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   std::chrono::nanoseconds(end - start))
+                                   .count());
+}
+
+void histogram::Ringbuffer::update_cumulative(Storage const &storage, nsecs_t now,
+                                              uint64_t &count,
                                               std::array<uint64_t, HIST_V_SIZE> &bins) const {
-  if (ringbuffer.empty())
+  if (storage.size == 0)
     return;
 
   count++;
-  ALOGI("count : %llu", static_cast<unsigned long long>(count));
 
-  const auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::nanoseconds(now - ringbuffer.front().start_timestamp));
-
-  for (auto i = 0u; i < bins.size(); i++) {
-    ALOGI("histogram.data[%d]: %u\n", i, ringbuffer.front().histogram.data[i]);
-    auto const increment = ringbuffer.front().histogram.data[i] * delta.count();
-    if (CC_UNLIKELY((bins[i] + increment < bins[i]) ||
-                    (increment < ringbuffer.front().histogram.data[i]))) {
-      bins[i] = std::numeric_limits<uint64_t>::max();
-    } else {
-      bins[i] += increment;
-    }
-    ALOGI("bins[%d]: %llu\n", i, static_cast<unsigned long long>(bins[i]));
-  }
+  accumulate_weighted_saturating(bins, storage.at(0).histogram.data,
+                                 weight_ms(storage.start_time(0), now));
 }
 
 void histogram::Ringbuffer::insert(drm_msm_hist const &frame) {
-  std::cout << "Enter insert ringbuffer" << std::endl;
+  std::unique_lock<decltype(write_mutex)> lk(write_mutex);
+  auto &s = *storage;
+  s.next().histogram = frame;
+  publish_next(s);
+}
 
-  std::unique_lock<decltype(mutex)> lk(mutex);
+// Makes the next entry, whose histogram the caller has written, the most recent one.
+void histogram::Ringbuffer::publish_next(Storage &s) {
   auto now = timekeeper->current_time();
 
-  std::cout << "update cumulative count" << std::endl;
-  update_cumulative(now, cumulative_frame_count, cumulative_bins);
+  // Odd sequence marks the update in progress; readers sampling across it will retry.
+  auto const seq = s.sequence.load(std::memory_order_relaxed);
+  s.sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
 
-  if (ringbuffer.size() == rb_max_size)
-    ringbuffer.pop_back();
-  if (!ringbuffer.empty())
-    ringbuffer.front().end_timestamp = now;
+  update_cumulative(s, now, s.cumulative_frame_count, s.cumulative_bins);
 
-  std::cout << "Exit insert ringbuffer" << std::endl;
-  ringbuffer.push_front({frame, now, 0});
+  Bins prefix;
+  if (s.size != 0) {
+    auto &front = s.at(0);
+    front.end_timestamp = now;
+    prefix = front.prefix_before;
+    accumulate_weighted(prefix, front.histogram.data, weight_ms(s.start_time(0), now));
+  } else {
+    prefix.fill(0);
+  }
+  s.head = (s.head + 1) % s.entries.size();
+  auto &entry = s.at(0);
+  s.start_times[s.head] = now;
+  entry.end_timestamp = 0;
+  entry.prefix_before = prefix;
+  if (s.size < s.capacity())
+    s.size++;
+
+  s.sequence.store(seq + 2, std::memory_order_release);
 }
 
 bool histogram::Ringbuffer::resize(size_t ringbuffer_size) {
-  std::unique_lock<decltype(mutex)> lk(mutex);
+  std::unique_lock<decltype(write_mutex)> lk(write_mutex);
   if (ringbuffer_size == 0)
     return false;
-  rb_max_size = ringbuffer_size;
-  if (ringbuffer.size() > rb_max_size)
-    ringbuffer.resize(rb_max_size);
+
+  // Readers may still hold the old array; build the new one aside and publish it atomically.
+  auto const &old_storage = *storage;
+  auto new_storage = std::make_shared<Storage>(ringbuffer_size);
+  auto const keep = std::min(old_storage.size, ringbuffer_size);
+  for (auto i = 0u; i < keep; i++) {
+    new_storage->entries[keep - 1 - i] = old_storage.at(i);
+    new_storage->start_times[keep - 1 - i] = old_storage.start_time(i);
+  }
+  new_storage->head = keep - 1;
+  new_storage->size = keep;
+  new_storage->cumulative_frame_count = old_storage.cumulative_frame_count;
+  new_storage->cumulative_bins = old_storage.cumulative_bins;
+  std::atomic_store(&storage, std::shared_ptr<Storage>(std::move(new_storage)));
   return true;
 }
 
+size_t histogram::Ringbuffer::memory_usage() const {
+  auto const s = std::atomic_load(&storage);
+  return sizeof(Storage) + s->entries.capacity() * sizeof(HistogramEntry) +
+         s->start_times.capacity() * sizeof(nsecs_t);
+}
+
+template <typename Fn>
+histogram::Ringbuffer::Sample histogram::Ringbuffer::read_consistent(Fn &&fn) const {
+  auto const s = std::atomic_load(&storage);
+  while (true) {
+    auto const seq = s->sequence.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+    auto sample = fn(*s);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s->sequence.load(std::memory_order_relaxed) == seq)
+      return sample;
+  }
+}
+
 histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_cumulative() const {
-  std::unique_lock<decltype(mutex)> lk(mutex);
-  histogram::Ringbuffer::Sample sample{cumulative_frame_count, cumulative_bins};
-  update_cumulative(timekeeper->current_time(), std::get<0>(sample), std::get<1>(sample));
-  return sample;
+  auto const now = timekeeper->current_time();
+  return read_consistent([this, now](Storage const &s) {
+    histogram::Ringbuffer::Sample sample{s.cumulative_frame_count, s.cumulative_bins};
+    update_cumulative(s, now, std::get<0>(sample), std::get<1>(sample));
+    return sample;
+  });
 }
 
 histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_ringbuffer_all() const {
-  std::unique_lock<decltype(mutex)> lk(mutex);
-  return collect_max(ringbuffer.size(), lk);
+  return read_consistent([this](Storage const &s) {
+    return collect_max(s, static_cast<uint32_t>(s.size));
+  });
 }
 
 histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_after(nsecs_t timestamp) const {
-  std::unique_lock<decltype(mutex)> lk(mutex);
-  return collect_max_after(timestamp, ringbuffer.size(), lk);
+  return read_consistent([this, timestamp](Storage const &s) {
+    return collect_max(s, static_cast<uint32_t>(count_after(s, timestamp)));
+  });
 }
 
 histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_max(uint32_t max_frames) const {
-  std::unique_lock<decltype(mutex)> lk(mutex);
-  return collect_max(max_frames, lk);
+  return read_consistent([this, max_frames](Storage const &s) {
+    return collect_max(s, max_frames);
+  });
 }
 
 histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_max_after(nsecs_t timestamp,
                                                                        uint32_t max_frames) const {
-  std::unique_lock<decltype(mutex)> lk(mutex);
-  return collect_max_after(timestamp, max_frames, lk);
+  return read_consistent([this, timestamp, max_frames](Storage const &s) {
+    auto const collect_last = std::min(count_after(s, timestamp), static_cast<size_t>(max_frames));
+    return collect_max(s, static_cast<uint32_t>(collect_last));
+  });
 }
 
-histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_max(
-    uint32_t max_frames, std::unique_lock<std::mutex> const &) const {
-  auto collect_first = std::min(static_cast<size_t>(max_frames), ringbuffer.size());
+histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_max(Storage const &s,
+                                                                 uint32_t max_frames) const {
+  auto collect_first = std::min(static_cast<size_t>(max_frames), s.size);
   if (collect_first == 0)
     return {0, {}};
+
+  // Closed entries come from the prefix difference; only the displayed frame is weighted here.
+  auto const &front = s.at(0);
   std::array<uint64_t, HIST_V_SIZE> bins;
-  bins.fill(0);
-  for (auto it = ringbuffer.begin(); it != ringbuffer.begin() + collect_first; it++) {
-    nsecs_t end_timestamp = it->end_timestamp;
-    if (it == ringbuffer.begin()) {
-      end_timestamp = timekeeper->current_time();
-    }
-    const auto time_displayed = std::chrono::nanoseconds(end_timestamp - it->start_timestamp);
-    const auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(time_displayed);
-    for (auto i = 0u; i < HIST_V_SIZE; i++) {
-      bins[i] += it->histogram.data[i] * delta.count();
-    }
-  }
+  subtract_bins(bins, front.prefix_before, s.at(collect_first - 1).prefix_before);
+  accumulate_weighted(bins, front.histogram.data,
+                      weight_ms(s.start_time(0), timekeeper->current_time()));
   return {collect_first, bins};
 }
 
-histogram::Ringbuffer::Sample histogram::Ringbuffer::collect_max_after(
-    nsecs_t timestamp, uint32_t max_frames, std::unique_lock<std::mutex> const &lk) const {
-  auto ts_filter_begin = std::lower_bound(
-      ringbuffer.begin(), ringbuffer.end(), HistogramEntry{{}, timestamp, 0},
-      [](auto const &a, auto const &b) { return a.start_timestamp >= b.start_timestamp; });
+bool histogram::Ringbuffer::reduce(std::array<uint64_t, HIST_V_SIZE> const &bins,
+                                   uint32_t num_bins, uint64_t *out) {
+  if (!out || (num_bins == 0) || (HIST_V_SIZE % num_bins) != 0)
+    return false;
+
+  auto const group = HIST_V_SIZE / num_bins;
+  for (auto i = 0u; i < num_bins; i++) {
+    uint64_t sum = 0;
+    for (auto j = i * group; j < (i + 1) * group; j++)
+      sum += bins[j];
+    out[i] = sum;
+  }
+  return true;
+}
 
-  auto collect_last = std::min(std::distance(ringbuffer.begin(), ts_filter_begin),
-                               static_cast<std::ptrdiff_t>(max_frames));
-  return collect_max(collect_last, lk);
+// Entries are ordered newest first with non-increasing start timestamps, so the number of
+// entries starting at or after |timestamp| can be found by binary search over logical indices.
+// Together with the prefix sums, a time window query costs O(log N + bins).
+size_t histogram::Ringbuffer::count_after(Storage const &s, nsecs_t timestamp) const {
+  size_t low = 0;
+  size_t high = s.size;
+  while (low < high) {
+    auto const mid = low + (high - low) / 2;
+    if (s.start_time(mid) >= timestamp) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
 }
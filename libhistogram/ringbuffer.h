@@ -23,10 +23,11 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <array>
-#include <deque>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <tuple>
+#include <vector>
 
 namespace histogram {
 
@@ -48,7 +49,14 @@ class Ringbuffer {
  public:
   static std::unique_ptr<Ringbuffer> create(size_t ringbuffer_size, std::unique_ptr<TimeKeeper> tk);
   void insert(drm_msm_hist const &frame);
+  // Inserts a frame written in place by fill(drm_msm_hist &), saving the copy of insert() for
+  // producers that can read the frame straight into the ring. Nothing is inserted if fill
+  // returns false.
+  template <typename Fill>
+  bool insert_in_place(Fill &&fill);
   bool resize(size_t ringbuffer_size);
+  // Bytes held by the frame array.
+  size_t memory_usage() const;
 
   using Sample = std::tuple<uint64_t /* numFrames */, std::array<uint64_t, HIST_V_SIZE> /* bins */>;
   Sample collect_cumulative() const;
@@ -56,6 +64,10 @@ class Ringbuffer {
   Sample collect_after(nsecs_t timestamp) const;
   Sample collect_max(uint32_t max_frames) const;
   Sample collect_max_after(nsecs_t timestamp, uint32_t max_frames) const;
+  // Writes the bins of a sample summed into num_bins groups of adjacent bins to out. num_bins
+  // must divide HIST_V_SIZE.
+  static bool reduce(std::array<uint64_t, HIST_V_SIZE> const &bins, uint32_t num_bins,
+                     uint64_t *out);
   ~Ringbuffer() = default;
 
  private:
@@ -63,24 +75,60 @@ class Ringbuffer {
   Ringbuffer(Ringbuffer const &) = delete;
   Ringbuffer &operator=(Ringbuffer const &) = delete;
 
-  Sample collect_max(uint32_t max_frames, std::unique_lock<std::mutex> const &) const;
-  Sample collect_max_after(nsecs_t timestamp, uint32_t max_frames,
-                           std::unique_lock<std::mutex> const &) const;
-  void update_cumulative(nsecs_t now, uint64_t &count,
-                         std::array<uint64_t, HIST_V_SIZE> &bins) const;
-
-  std::mutex mutable mutex;
   struct HistogramEntry {
     drm_msm_hist histogram;
-    nsecs_t start_timestamp;
     nsecs_t end_timestamp;
+    // Running (modulo 2^64) time-weighted sum of every entry closed before this one, so the
+    // weighted sum over any window of closed entries is the difference of two prefixes.
+    std::array<uint64_t, HIST_V_SIZE> prefix_before;
   };
-  std::deque<HistogramEntry> ringbuffer;
-  size_t rb_max_size;
-  std::unique_ptr<TimeKeeper> const timekeeper;
 
-  uint64_t cumulative_frame_count;
-  std::array<uint64_t, HIST_V_SIZE> cumulative_bins;
+  // Preallocated circular array of the most recent frames. A single writer, serialized by
+  // write_mutex, publishes updates under an odd/even sequence count so that readers never
+  // block insert(); readers retry if the sequence changed while they were sampling. The array
+  // holds one entry more than the capacity, the next one to be written, which readers never
+  // look at. Start timestamps live in an array of their own, parallel to the entries, so a
+  // timestamp search touches a few cache lines rather than one multi-kilobyte entry per step.
+  struct Storage {
+    explicit Storage(size_t capacity);
+    size_t slot(size_t index) const;  // index 0 is the most recent entry
+    HistogramEntry const &at(size_t index) const { return entries[slot(index)]; }
+    HistogramEntry &at(size_t index) { return entries[slot(index)]; }
+    nsecs_t start_time(size_t index) const { return start_times[slot(index)]; }
+    HistogramEntry &next() { return at(entries.size() - 1); }
+    size_t capacity() const { return entries.size() - 1; }
+
+    std::vector<HistogramEntry> entries;
+    std::vector<nsecs_t> start_times;
+    std::atomic<uint32_t> sequence;
+    size_t head;
+    size_t size;
+    uint64_t cumulative_frame_count;
+    std::array<uint64_t, HIST_V_SIZE> cumulative_bins;
+  };
+
+  template <typename Fn>
+  Sample read_consistent(Fn &&fn) const;
+  void publish_next(Storage &storage);
+  Sample collect_max(Storage const &storage, uint32_t max_frames) const;
+  size_t count_after(Storage const &storage, nsecs_t timestamp) const;
+  void update_cumulative(Storage const &storage, nsecs_t now, uint64_t &count,
+                         std::array<uint64_t, HIST_V_SIZE> &bins) const;
+  static uint64_t weight_ms(nsecs_t start, nsecs_t end);
+
+  std::mutex write_mutex;
+  std::shared_ptr<Storage> storage;
+  std::unique_ptr<TimeKeeper> const timekeeper;
 };
 
+template <typename Fill>
+bool Ringbuffer::insert_in_place(Fill &&fill) {
+  std::unique_lock<decltype(write_mutex)> lk(write_mutex);
+  auto &s = *storage;
+  if (!fill(s.next().histogram))
+    return false;
+  publish_next(s);
+  return true;
+}
+
 }  // namespace histogram
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <vector>
+
+#include "ringbuffer.h"
+
+namespace {
+
+struct FakeTimeKeeper : histogram::TimeKeeper {
+  void tick() { fake_time += std::chrono::nanoseconds(std::chrono::milliseconds(16)).count(); }
+  nsecs_t current_time() const final { return fake_time; }
+
+ private:
+  nsecs_t fake_time = 0;
+};
+
+std::unique_ptr<histogram::Ringbuffer> createFilledRingbuffer(size_t size, FakeTimeKeeper *&tk) {
+  auto timekeeper = std::make_unique<FakeTimeKeeper>();
+  tk = timekeeper.get();
+  auto rb = histogram::Ringbuffer::create(size, std::move(timekeeper));
+  drm_msm_hist frame;
+  for (auto n = 0u; n < size; n++) {
+    for (auto i = 0u; i < HIST_V_SIZE; i++)
+      frame.data[i] = n + i;
+    rb->insert(frame);
+    tk->tick();
+  }
+  return rb;
+}
+
+void BM_Insert(benchmark::State &state) {
+  FakeTimeKeeper *tk = nullptr;
+  auto rb = createFilledRingbuffer(state.range(0), tk);
+  drm_msm_hist frame;
+  for (auto i = 0u; i < HIST_V_SIZE; i++)
+    frame.data[i] = i;
+  for (auto _ : state) {
+    rb->insert(frame);
+    tk->tick();
+  }
+}
+BENCHMARK(BM_Insert)->Arg(300);
+
+void BM_CollectCumulative(benchmark::State &state) {
+  FakeTimeKeeper *tk = nullptr;
+  auto rb = createFilledRingbuffer(state.range(0), tk);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(rb->collect_cumulative());
+}
+BENCHMARK(BM_CollectCumulative)->Arg(300);
+
+void BM_CollectMax(benchmark::State &state) {
+  FakeTimeKeeper *tk = nullptr;
+  auto rb = createFilledRingbuffer(300, tk);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(rb->collect_max(state.range(0)));
+}
+BENCHMARK(BM_CollectMax)->Arg(1)->Arg(30)->Arg(300);
+
+void BM_CollectMaxAfter(benchmark::State &state) {
+  FakeTimeKeeper *tk = nullptr;
+  auto rb = createFilledRingbuffer(300, tk);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(rb->collect_max_after(1, state.range(0)));
+}
+BENCHMARK(BM_CollectMaxAfter)->Arg(30)->Arg(300);
+
+void BM_CollectMaxReduced(benchmark::State &state) {
+  FakeTimeKeeper *tk = nullptr;
+  auto rb = createFilledRingbuffer(300, tk);
+  std::vector<uint64_t> bins(state.range(0));
+  for (auto _ : state) {
+    histogram::Ringbuffer::reduce(std::get<1>(rb->collect_max(30)),
+                                  static_cast<uint32_t>(bins.size()), bins.data());
+    benchmark::DoNotOptimize(bins.data());
+  }
+}
+BENCHMARK(BM_CollectMaxReduced)->Arg(8)->Arg(32)->Arg(HIST_V_SIZE);
+
+}  // namespace
+
+BENCHMARK_MAIN();
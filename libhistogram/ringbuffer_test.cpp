@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <chrono>
 #include <numeric>
+#include <thread>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -50,6 +52,15 @@ struct TickingTimeKeeper : histogram::TimeKeeper {
   nsecs_t mutable fake_time = 0;
 };
 
+struct AtomicTickingTimeKeeper : histogram::TimeKeeper {
+  void tick() { fake_time += toNsecs(1ms); }
+
+  nsecs_t current_time() const final { return fake_time; }
+
+ private:
+  std::atomic<nsecs_t> fake_time{0};
+};
+
 void insertFrameIncrementTimeline(histogram::Ringbuffer &rb, TickingTimeKeeper &tk,
                                   drm_msm_hist &frame) {
   rb.insert(frame);
@@ -181,6 +192,58 @@ TEST_F(RingbufferTestCases, TestEvictionMultiple) {
   EXPECT_THAT(bins, Each(fill_frame2 + fill_frame3 + fill_frame0));
 }
 
+TEST_F(RingbufferTestCases, TestInsertInPlace) {
+  auto tk = std::make_shared<TickingTimeKeeper>();
+  auto rb = histogram::Ringbuffer::create(2, std::make_unique<TimeKeeperWrapper>(tk));
+
+  auto fill_with = [](drm_msm_hist const &frame) {
+    return [&frame](drm_msm_hist &hist) {
+      hist = frame;
+      return true;
+    };
+  };
+  EXPECT_TRUE(rb->insert_in_place(fill_with(frame0)));
+  tk->tick();
+  EXPECT_TRUE(rb->insert_in_place(fill_with(frame1)));
+  tk->tick();
+  EXPECT_TRUE(rb->insert_in_place(fill_with(frame2)));
+  tk->tick();
+
+  std::tie(numFrames, bins) = rb->collect_ringbuffer_all();
+  EXPECT_THAT(numFrames, Eq(2));
+  EXPECT_THAT(bins, Each(fill_frame1 + fill_frame2));
+
+  // A failed fill inserts nothing, even though it wrote into the ring.
+  EXPECT_FALSE(rb->insert_in_place([this](drm_msm_hist &hist) {
+    hist = frame3;
+    return false;
+  }));
+  std::tie(numFrames, bins) = rb->collect_ringbuffer_all();
+  EXPECT_THAT(numFrames, Eq(2));
+  EXPECT_THAT(bins, Each(fill_frame1 + fill_frame2));
+}
+
+TEST_F(RingbufferTestCases, TestReduce) {
+  std::array<uint64_t, HIST_V_SIZE> in;
+  std::iota(in.begin(), in.end(), 0);
+
+  std::array<uint64_t, 8> out;
+  ASSERT_TRUE(histogram::Ringbuffer::reduce(in, out.size(), out.data()));
+  auto const group = HIST_V_SIZE / out.size();
+  for (auto i = 0u; i < out.size(); i++) {
+    auto const first = i * group;
+    EXPECT_THAT(out[i], Eq(group * first + group * (group - 1) / 2));
+  }
+
+  std::array<uint64_t, HIST_V_SIZE> all;
+  ASSERT_TRUE(histogram::Ringbuffer::reduce(in, all.size(), all.data()));
+  EXPECT_THAT(all, Eq(in));
+
+  EXPECT_FALSE(histogram::Ringbuffer::reduce(in, 0, out.data()));
+  EXPECT_FALSE(histogram::Ringbuffer::reduce(in, 3, out.data()));
+  EXPECT_FALSE(histogram::Ringbuffer::reduce(in, 8, nullptr));
+}
+
 TEST_F(RingbufferTestCases, TestResizeToZero) {
   auto rb = histogram::Ringbuffer::create(4, std::make_unique<TickingTimeKeeper>());
   EXPECT_FALSE(rb->resize(0));
@@ -234,6 +297,19 @@ TEST_F(RingbufferTestCases, TestResizeUp) {
   EXPECT_THAT(bins, Each(fill_frame1 + fill_frame2 + fill_frame3));
 }
 
+TEST_F(RingbufferTestCases, TestMemoryUsageFollowsResize) {
+  auto rb = histogram::Ringbuffer::create(4, std::make_unique<TickingTimeKeeper>());
+  auto const small = rb->memory_usage();
+  EXPECT_THAT(small, Gt(0u));
+
+  EXPECT_TRUE(rb->resize(8));
+  auto const large = rb->memory_usage();
+  EXPECT_THAT(large, Gt(small));
+
+  EXPECT_TRUE(rb->resize(4));
+  EXPECT_THAT(rb->memory_usage(), Eq(small));
+}
+
 TEST_F(RingbufferTestCases, TestTimestampFiltering) {
   auto rb = createFilledRingbuffer(std::make_shared<TickingTimeKeeper>());
 
@@ -264,6 +340,25 @@ TEST_F(RingbufferTestCases, TestTimestampFilteringSameTimestamp) {
   EXPECT_THAT(bins, Each(fill_frame4));
 }
 
+TEST_F(RingbufferTestCases, TestTimestampFilteringAfterWrap) {
+  auto tk = std::make_shared<TickingTimeKeeper>();
+  auto rb = createFilledRingbuffer(tk);
+  insertFrameIncrementTimeline(*rb, *tk, frame4);
+  insertFrameIncrementTimeline(*rb, *tk, frame0);
+
+  std::tie(numFrames, bins) = rb->collect_after(toNsecs(3500us));
+  EXPECT_THAT(numFrames, Eq(2));
+  EXPECT_THAT(bins, Each(fill_frame4 + fill_frame0));
+
+  std::tie(numFrames, bins) = rb->collect_after(toNsecs(2000us));
+  EXPECT_THAT(numFrames, Eq(4));
+  EXPECT_THAT(bins, Each(fill_frame2 + fill_frame3 + fill_frame4 + fill_frame0));
+
+  std::tie(numFrames, bins) = rb->collect_max_after(0, 3);
+  EXPECT_THAT(numFrames, Eq(3));
+  EXPECT_THAT(bins, Each(fill_frame3 + fill_frame4 + fill_frame0));
+}
+
 TEST_F(RingbufferTestCases, TestFrameFiltering) {
   auto rb = createFilledRingbuffer(std::make_shared<TickingTimeKeeper>());
 
@@ -407,6 +502,36 @@ TEST_F(RingbufferTestCases, TimeWeightingTest) {
   }
 }
 
+TEST_F(RingbufferTestCases, CollectionDoesNotTearConcurrentInsertion) {
+  static constexpr int numInsertions = 5000;
+  auto tk = std::make_shared<AtomicTickingTimeKeeper>();
+  auto rb = histogram::Ringbuffer::create(7, std::make_unique<TimeKeeperWrapper>(tk));
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    drm_msm_hist frame;
+    for (auto n = 1; n <= numInsertions; n++) {
+      for (auto i = 0u; i < HIST_V_SIZE; i++)
+        frame.data[i] = n;
+      rb->insert(frame);
+      tk->tick();
+    }
+    done = true;
+  });
+
+  while (!done) {
+    std::tie(numFrames, bins) = rb->collect_ringbuffer_all();
+    EXPECT_THAT(numFrames, Le(7));
+    EXPECT_THAT(bins, Each(bins[0]));
+    std::tie(numFrames, bins) = rb->collect_cumulative();
+    EXPECT_THAT(bins, Each(bins[0]));
+  }
+  writer.join();
+
+  std::tie(numFrames, bins) = rb->collect_cumulative();
+  EXPECT_THAT(numFrames, Eq(numInsertions));
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
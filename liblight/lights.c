@@ -47,6 +47,7 @@ static struct light_state_t g_battery;
 static int g_last_backlight_mode = BRIGHTNESS_MODE_USER;
 static int g_attention = 0;
 static bool g_has_persistence_node = false;
+static int g_backlight_fd = -1;
 
 char const*const LCD_FILE
         = "/sys/class/leds/lcd-backlight/brightness";
@@ -102,6 +103,36 @@ static int write_int(char const* path, int value)
     }
 }
 
+/* Writes the LCD backlight through a node kept open across calls. */
+static int write_backlight(int value)
+{
+    static int already_warned = 0;
+
+    if (g_backlight_fd < 0) {
+        char const* path = access(LCD_FILE, F_OK) ? LCD_FILE2 : LCD_FILE;
+        g_backlight_fd = open(path, O_RDWR | O_CLOEXEC);
+        if (g_backlight_fd < 0) {
+            int err = -errno;
+            if (already_warned == 0) {
+                ALOGE("write_backlight failed to open %s, errno = %d\n", path, -err);
+                already_warned = 1;
+            }
+            return err;
+        }
+    }
+
+    char buffer[20];
+    int bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
+    if (pwrite(g_backlight_fd, buffer, (size_t)bytes, 0) == -1) {
+        int err = -errno;
+        // Reopen on the next call in case the node went away.
+        close(g_backlight_fd);
+        g_backlight_fd = -1;
+        return err;
+    }
+    return 0;
+}
+
 static bool file_exists(const char *file)
 {
     int fd;
@@ -162,11 +193,7 @@ set_light_backlight(struct light_device_t* dev,
     }
 
     if (!err) {
-        if (!access(LCD_FILE, F_OK)) {
-            err = write_int(LCD_FILE, brightness);
-        } else {
-            err = write_int(LCD_FILE2, brightness);
-        }
+        err = write_backlight(brightness);
     }
 
     pthread_mutex_unlock(&g_lock);
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <hardware/memtrack.h>
+
+#include "memtrack_msm.h"
+
+#define MAX_DMABUFS 1024
+
+/* Buffers allocated by gralloc are named gralloc-<usage>[-ubwc] */
+static const char gralloc_prefix[] = "gralloc-";
+
+/* Returns the value of the "<key>:" line of an fdinfo, or NULL */
+static const char *fdinfo_field(const char *info, const char *key)
+{
+    size_t key_len = strlen(key);
+    const char *line = info;
+
+    while (line && *line) {
+        if (!strncmp(line, key, key_len) && line[key_len] == ':') {
+            line += key_len + 1;
+            while (*line == ' ' || *line == '\t')
+                line++;
+            return line;
+        }
+        line = strchr(line, '\n');
+        if (line)
+            line++;
+    }
+    return NULL;
+}
+
+static bool read_gralloc_dmabuf_size(pid_t pid, const char *fd, size_t *size)
+{
+    char path[128];
+    char info[512];
+    const char *value;
+    ssize_t len;
+    int info_fd;
+
+    snprintf(path, sizeof(path), "/proc/%d/fdinfo/%s", pid, fd);
+    info_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (info_fd < 0)
+        return false;
+
+    /* The dma-buf fields are short and come first, one read is enough */
+    len = read(info_fd, info, sizeof(info) - 1);
+    close(info_fd);
+    if (len <= 0)
+        return false;
+    info[len] = '\0';
+
+    value = fdinfo_field(info, "name");
+    if (value == NULL || strncmp(value, gralloc_prefix, sizeof(gralloc_prefix) - 1))
+        return false;
+
+    value = fdinfo_field(info, "size");
+    *size = value ? (size_t)strtoull(value, NULL, 10) : 0;
+    return true;
+}
+
+/*
+ * Sums the gralloc buffers the process holds an fd of. Buffers are counted
+ * once however many fds of them it holds, and wherever they were allocated.
+ */
+int dmabuf_memtrack_get_graphics(pid_t pid, size_t *size)
+{
+    ino_t seen[MAX_DMABUFS];
+    size_t num_seen = 0;
+    char path[128];
+    char link[64];
+    struct dirent *entry;
+    DIR *dir;
+
+    *size = 0;
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+    dir = opendir(path);
+    if (dir == NULL)
+        return -errno;
+
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        size_t buf_size;
+        ssize_t len;
+        bool duplicate = false;
+        size_t i;
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/%d/fd/%s", pid, entry->d_name);
+        len = readlink(path, link, sizeof(link) - 1);
+        if (len < 0)
+            continue;
+        link[len] = '\0';
+        if (strstr(link, "dmabuf") == NULL || stat(path, &st))
+            continue;
+
+        for (i = 0; i < num_seen && !duplicate; i++)
+            duplicate = seen[i] == st.st_ino;
+        if (duplicate)
+            continue;
+
+        if (!read_gralloc_dmabuf_size(pid, entry->d_name, &buf_size))
+            continue;
+
+        if (num_seen < MAX_DMABUFS)
+            seen[num_seen++] = st.st_ino;
+        *size += buf_size;
+    }
+    closedir(dir);
+
+    return 0;
+}
@@ -15,10 +15,15 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <hardware/memtrack.h>
 
@@ -27,6 +32,89 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
+/*
+ * dumpsys meminfo and the activity manager query every process, often
+ * several times in a row. Results are reused for this long.
+ */
+#define CACHE_ENTRIES 64
+#define CACHE_TTL_NS 1000000000LL
+
+struct cache_entry {
+    pid_t pid;
+    enum memtrack_type type;
+    long long time_ns;
+    size_t accounted_size;
+    size_t unaccounted_size;
+};
+
+static struct cache_entry cache[CACHE_ENTRIES];
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct cache_entry *cache_slot(pid_t pid, enum memtrack_type type)
+{
+    return &cache[((unsigned int)pid * 2 + (type == MEMTRACK_TYPE_GL)) % CACHE_ENTRIES];
+}
+
+static bool cache_lookup(pid_t pid, enum memtrack_type type,
+                         size_t *accounted_size, size_t *unaccounted_size)
+{
+    struct cache_entry *entry = cache_slot(pid, type);
+    bool hit;
+
+    pthread_mutex_lock(&cache_lock);
+    hit = entry->pid == pid && entry->type == type && entry->time_ns &&
+          now_ns() - entry->time_ns < CACHE_TTL_NS;
+    if (hit) {
+        *accounted_size = entry->accounted_size;
+        *unaccounted_size = entry->unaccounted_size;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return hit;
+}
+
+static void cache_store(pid_t pid, enum memtrack_type type,
+                        size_t accounted_size, size_t unaccounted_size)
+{
+    struct cache_entry *entry = cache_slot(pid, type);
+
+    pthread_mutex_lock(&cache_lock);
+    entry->pid = pid;
+    entry->type = type;
+    entry->time_ns = now_ns();
+    entry->accounted_size = accounted_size;
+    entry->unaccounted_size = unaccounted_size;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/* Reads a kgsl per-process total, a single decimal number */
+static int read_size_node(const char *path, size_t *size)
+{
+    char buf[32];
+    char *end;
+    ssize_t len;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return -EINVAL;
+    buf[len] = '\0';
+
+    *size = (size_t)strtoull(buf, &end, 10);
+    return end == buf ? -EINVAL : 0;
+}
+
 struct memtrack_record record_templates[] = {
     {
         .flags = MEMTRACK_FLAG_SMAPS_ACCOUNTED |
@@ -48,7 +136,6 @@ int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
     char syspath[128];
     size_t accounted_size = 0;
     size_t unaccounted_size = 0;
-    FILE *fp;
     int ret;
 
     *num_records = ARRAY_SIZE(record_templates);
@@ -60,54 +147,45 @@ int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
     memcpy(records, record_templates,
             sizeof(struct memtrack_record) * allocated_records);
 
+    if (cache_lookup(pid, type, &accounted_size, &unaccounted_size))
+        goto done;
+
     if (type == MEMTRACK_TYPE_GL) {
 
         snprintf(syspath, sizeof(syspath),
                  "/sys/class/kgsl/kgsl/proc/%d/gpumem_mapped", pid);
 
-        fp = fopen(syspath, "r");
-        if (fp == NULL)
-            return -errno;
-
-        ret = fscanf(fp, "%zu", &accounted_size);
-        if (ret != 1) {
-            fclose(fp);
-            return -EINVAL;
-        }
-        fclose(fp);
+        ret = read_size_node(syspath, &accounted_size);
+        if (ret)
+            return ret;
 
         snprintf(syspath, sizeof(syspath),
                  "/sys/class/kgsl/kgsl/proc/%d/gpumem_unmapped", pid);
 
-        fp = fopen(syspath, "r");
-        if (fp == NULL) {
-            return -errno;
-        }
-
-        ret = fscanf(fp, "%zu", &unaccounted_size);
-        if (ret != 1) {
-            fclose(fp);
-            return -EINVAL;
-        }
-        fclose(fp);
+        ret = read_size_node(syspath, &unaccounted_size);
+        if (ret)
+            return ret;
 
     } else if (type == MEMTRACK_TYPE_GRAPHICS) {
 
-        snprintf(syspath, sizeof(syspath),
-                 "/sys/class/kgsl/kgsl/proc/%d/imported_mem", pid);
-
-        fp = fopen(syspath, "r");
-        if (fp == NULL)
-            return -errno;
-
-        ret = fscanf(fp, "%zu", &unaccounted_size);
-        if (ret != 1) {
-            fclose(fp);
-            return -EINVAL;
+        /*
+         * Gralloc names its buffers, which attributes them to every process
+         * holding them. Older kernels cannot, fall back to what kgsl imported.
+         */
+        if (dmabuf_memtrack_get_graphics(pid, &unaccounted_size) != 0 ||
+            unaccounted_size == 0) {
+            snprintf(syspath, sizeof(syspath),
+                     "/sys/class/kgsl/kgsl/proc/%d/imported_mem", pid);
+
+            ret = read_size_node(syspath, &unaccounted_size);
+            if (ret)
+                return ret;
         }
-        fclose(fp);
     }
 
+    cache_store(pid, type, accounted_size, unaccounted_size);
+
+done:
     if (allocated_records > 0)
     records[0].size_in_bytes = accounted_size;
 
@@ -20,5 +20,6 @@
 int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
                              struct memtrack_record *records,
                              size_t *num_records);
+int dmabuf_memtrack_get_graphics(pid_t pid, size_t *size);
 
 #endif
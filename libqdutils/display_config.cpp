@@ -29,18 +29,129 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <display_config.h>
+#include <display_state_page.h>
 #include <QServiceUtils.h>
 #include <qd_utils.h>
 
+#include <map>
+#include <mutex>
+
 using namespace android;
 using namespace qService;
 
 namespace qdutils {
 
+// Answers of queries about the primary display, kept while the config generation in the state
+// page the composer shares for it stays the same. The composer bumps the generation whenever the
+// configs, the active config or the brightness may have changed, so repeated queries cost no
+// binder call. The page is dropped when the composer dies or retires it.
+class ConfigCache : public IBinder::DeathRecipient {
+public:
+    // Locks the cache and brings it up to date. Returns false if answers cannot be cached.
+    bool validate(std::unique_lock<std::mutex> *lock);
+    // Generation the current answers belong to, valid after validate() returned true.
+    uint32_t generation() const { return mGeneration; }
+
+    int mConfigCount = -1;
+    int mActiveConfig = -1;
+    int mBrightness = -1;
+    std::map<int, DisplayAttributes> mAttributes;
+    std::mutex mLock;
+
+private:
+    bool mapPage();
+    void unmapPage();
+    void clear();
+    virtual void binderDied(const wp<IBinder>& who);
+
+    const DisplayStatePage *mPage = nullptr;
+    bool mUnavailable = false;  // The composer does not share the page, do not keep asking
+    uint32_t mGeneration = 0;
+};
+
+static sp<ConfigCache> getConfigCache() {
+    static sp<ConfigCache> sCache = new ConfigCache();
+    return sCache;
+}
+
+bool ConfigCache::validate(std::unique_lock<std::mutex> *lock) {
+    *lock = std::unique_lock<std::mutex>(mLock);
+    if (!mPage && (mUnavailable || !mapPage())) {
+        return false;
+    }
+
+    if (mPage->version != DISPLAY_STATE_PAGE_VERSION) {
+        unmapPage();
+        return false;
+    }
+
+    uint32_t generation = mPage->config_generation.load(std::memory_order_acquire);
+    if (generation != mGeneration) {
+        clear();
+        mGeneration = generation;
+    }
+
+    return true;
+}
+
+bool ConfigCache::mapPage() {
+    sp<IQService> binder = getBinder();
+    if (binder == NULL) {
+        return false;
+    }
+
+    Parcel inParcel, outParcel;
+    inParcel.writeInt32(DISPLAY_PRIMARY);
+    status_t err = binder->dispatch(IQService::GET_DISPLAY_STATE_PAGE, &inParcel, &outParcel);
+    int fd = err ? -1 : outParcel.readFileDescriptor();
+    if (fd < 0) {
+        ALOGI("%s() display state page not available, err %d", __FUNCTION__, err);
+        mUnavailable = true;
+        return false;
+    }
+
+    void *base = mmap(NULL, static_cast<size_t>(getpagesize()), PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("%s() failed to map the display state page", __FUNCTION__);
+        mUnavailable = true;
+        return false;
+    }
+
+    IInterface::asBinder(binder)->linkToDeath(this);
+    mPage = reinterpret_cast<const DisplayStatePage *>(base);
+    mGeneration = mPage->config_generation.load(std::memory_order_acquire);
+    clear();
+
+    return true;
+}
+
+void ConfigCache::unmapPage() {
+    if (mPage) {
+        munmap(const_cast<DisplayStatePage *>(mPage), static_cast<size_t>(getpagesize()));
+        mPage = nullptr;
+    }
+    clear();
+}
+
+void ConfigCache::clear() {
+    mConfigCount = -1;
+    mActiveConfig = -1;
+    mBrightness = -1;
+    mAttributes.clear();
+}
+
+void ConfigCache::binderDied(const wp<IBinder>& /* who */) {
+    std::lock_guard<std::mutex> lock(mLock);
+    // A restarted composer shares a new page.
+    unmapPage();
+    mUnavailable = false;
+}
+
 //=============================================================================
 // The functions below run in the client process and wherever necessary
 // do a binder call to HWC to get/set data.
@@ -115,6 +226,18 @@ int configureDynRefreshRate(uint32_t op, uint32_t refreshRate) {
 }
 
 int getConfigCount(int /*dpy*/) {
+    sp<ConfigCache> cache = getConfigCache();
+    uint32_t generation = 0;
+    bool cacheable = false;
+    {
+        std::unique_lock<std::mutex> lock;
+        cacheable = cache->validate(&lock);
+        if (cacheable && cache->mConfigCount >= 0) {
+            return cache->mConfigCount;
+        }
+        generation = cache->generation();
+    }
+
     int numConfigs = -1;
     sp<IQService> binder = getBinder();
     if(binder != NULL) {
@@ -129,10 +252,27 @@ int getConfigCount(int /*dpy*/) {
             ALOGE("%s() failed with err %d", __FUNCTION__, err);
         }
     }
+
+    std::unique_lock<std::mutex> lock;
+    if (cacheable && cache->validate(&lock) && cache->generation() == generation) {
+        cache->mConfigCount = numConfigs;
+    }
     return numConfigs;
 }
 
 int getActiveConfig(int dpy) {
+    sp<ConfigCache> cache = getConfigCache();
+    uint32_t generation = 0;
+    bool cacheable = false;
+    if (dpy == DISPLAY_PRIMARY) {
+        std::unique_lock<std::mutex> lock;
+        cacheable = cache->validate(&lock);
+        if (cacheable && cache->mActiveConfig >= 0) {
+            return cache->mActiveConfig;
+        }
+        generation = cache->generation();
+    }
+
     int configIndex = -1;
     sp<IQService> binder = getBinder();
     if(binder != NULL) {
@@ -148,6 +288,11 @@ int getActiveConfig(int dpy) {
             ALOGE("%s() failed with err %d", __FUNCTION__, err);
         }
     }
+
+    std::unique_lock<std::mutex> lock;
+    if (cacheable && cache->validate(&lock) && cache->generation() == generation) {
+        cache->mActiveConfig = configIndex;
+    }
     return configIndex;
 }
 
@@ -171,7 +316,21 @@ int setActiveConfig(int configIndex, int /*dpy*/) {
 }
 
 DisplayAttributes getDisplayAttributes(int configIndex, int dpy) {
+    sp<ConfigCache> cache = getConfigCache();
+    uint32_t generation = 0;
+    bool cacheable = false;
+    if (dpy == DISPLAY_PRIMARY) {
+        std::unique_lock<std::mutex> lock;
+        cacheable = cache->validate(&lock);
+        auto it = cache->mAttributes.find(configIndex);
+        if (cacheable && it != cache->mAttributes.end()) {
+            return it->second;
+        }
+        generation = cache->generation();
+    }
+
     DisplayAttributes dpyattr = {};
+    bool received = false;
     sp<IQService> binder = getBinder();
     if(binder != NULL) {
         Parcel inParcel, outParcel;
@@ -188,12 +347,18 @@ DisplayAttributes getDisplayAttributes(int configIndex, int dpy) {
             dpyattr.ydpi = outParcel.readFloat();
             dpyattr.panel_type = outParcel.readInt32();
             dpyattr.is_yuv = outParcel.readInt32();
+            received = true;
             ALOGI("%s() Received attrs for index %d: xres %d, yres %d",
                     __FUNCTION__, configIndex, dpyattr.xres, dpyattr.yres);
         } else {
             ALOGE("%s() failed with err %d", __FUNCTION__, err);
         }
     }
+
+    std::unique_lock<std::mutex> lock;
+    if (received && cacheable && cache->validate(&lock) && cache->generation() == generation) {
+        cache->mAttributes[configIndex] = dpyattr;
+    }
     return dpyattr;
 }
 
@@ -232,6 +397,18 @@ int setPanelBrightness(int level) {
 }
 
 int getPanelBrightness() {
+    sp<ConfigCache> cache = getConfigCache();
+    uint32_t generation = 0;
+    bool cacheable = false;
+    {
+        std::unique_lock<std::mutex> lock;
+        cacheable = cache->validate(&lock);
+        if (cacheable && cache->mBrightness >= 0) {
+            return cache->mBrightness;
+        }
+        generation = cache->generation();
+    }
+
     int panel_brightness = -1;
     sp<IQService> binder = getBinder();
     Parcel inParcel, outParcel;
@@ -247,6 +424,11 @@ int getPanelBrightness() {
             ALOGE("%s() failed with err %d", __FUNCTION__, err);
         }
     }
+
+    std::unique_lock<std::mutex> lock;
+    if (cacheable && cache->validate(&lock) && cache->generation() == generation) {
+        cache->mBrightness = panel_brightness;
+    }
     return panel_brightness;
 }
 
@@ -321,6 +503,69 @@ int setPanelLuminanceAttributes(int dpy, float min_lum, float max_lum) {
     return err;
 }
 
+static const int kSidebandStreamMagic = 0x53425354;  // 'SBST'
+
+native_handle_t *createSidebandStream(int streamId) {
+    native_handle_t *stream = native_handle_create(0, 2);
+    if (stream) {
+        stream->data[0] = kSidebandStreamMagic;
+        stream->data[1] = streamId;
+    }
+    return stream;
+}
+
+int getSidebandStreamId(const native_handle_t *stream) {
+    if (!stream || stream->numFds != 0 || stream->numInts != 2 ||
+            stream->data[0] != kSidebandStreamMagic) {
+        return -1;
+    }
+    return stream->data[1];
+}
+
+int queueSidebandFrame(int streamId, const native_handle_t *buffer, int acquireFence,
+                       int64_t presentTimeNs, uint64_t *frameNumber,
+                       std::vector<SidebandRelease>& released) {
+    sp<IQService> binder = getBinder();
+    if (binder == NULL) {
+        return FAILED_TRANSACTION;
+    }
+
+    Parcel inParcel, outParcel;
+    inParcel.writeInt32(streamId);
+    inParcel.writeInt32(buffer != NULL);
+    if (buffer) {
+        inParcel.writeNativeHandle(buffer);
+    }
+    inParcel.writeInt32(acquireFence >= 0);
+    if (acquireFence >= 0) {
+        inParcel.writeDupFileDescriptor(acquireFence);
+    }
+    inParcel.writeInt64(presentTimeNs);
+    status_t err = binder->dispatch(IQService::QUEUE_SIDEBAND_FRAME, &inParcel, &outParcel);
+    if (err) {
+        ALOGE("%s() failed with err %d", __FUNCTION__, err);
+        return err;
+    }
+
+    uint64_t number = outParcel.readUint64();
+    if (frameNumber) {
+        *frameNumber = number;
+    }
+    for (int32_t count = outParcel.readInt32(); count > 0; count--) {
+        SidebandRelease release = {outParcel.readUint64(), -1};
+        if (outParcel.readInt32()) {
+            // The parcel owns the descriptor it read.
+            release.releaseFence = dup(outParcel.readFileDescriptor());
+        }
+        released.push_back(release);
+    }
+    return 0;
+}
+
+int flushSidebandStream(int streamId, std::vector<SidebandRelease>& released) {
+    return queueSidebandFrame(streamId, NULL, -1, 0, NULL, released);
+}
+
 }// namespace
 
 // ----------------------------------------------------------------------------
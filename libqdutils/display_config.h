@@ -170,6 +170,30 @@ int getSupportedBitClk(int dpy, std::vector<uint64_t>& bit_rates);
 // Sets the specified min and max luminance values.
 int setPanelLuminanceAttributes(int dpy, float min_lum, float max_lum);
 
+// Tunneled video. The producer of a stream hands the handle of createSidebandStream() to the
+// client for its sideband layer, and queues frames to the composer, which shows each on the vsync
+// of its presentation time by itself. Frames come back on later calls once the composer is done
+// with them; the buffer may be written again after releaseFence signals, -1 if it was dropped.
+struct SidebandRelease {
+    uint64_t frameNumber;
+    int releaseFence;
+};
+
+// Returns the stream handle of streamId, to be freed with native_handle_delete().
+native_handle_t *createSidebandStream(int streamId);
+
+// Returns the stream id of a handle made by createSidebandStream(), -1 for any other handle.
+int getSidebandStreamId(const native_handle_t *stream);
+
+// Queues a frame to be shown at presentTimeNs on CLOCK_MONOTONIC, or as soon as possible if 0.
+// The acquire fence is duplicated, and may be -1.
+int queueSidebandFrame(int streamId, const native_handle_t *buffer, int acquireFence,
+                       int64_t presentTimeNs, uint64_t *frameNumber,
+                       std::vector<SidebandRelease>& released);
+
+// Drops the frames of the stream not shown yet, as on a seek.
+int flushSidebandStream(int streamId, std::vector<SidebandRelease>& released);
+
 }; //namespace
 
 
@@ -34,6 +34,13 @@
 static const int kFBNodeMax = 4;
 namespace qdutils {
 
+// The DP framebuffer node index and its kept-open connected node. Framebuffer nodes are created
+// at probe time, so the index is looked up once and only again after invalidation or a failed
+// read of the connected node.
+static android::Mutex sDPNodeLock;
+static int sDPNodeId = -1;
+static int sDPConnectedFd = -1;
+
 static int parseLine(char *input, char *tokens[], const uint32_t maxToken, uint32_t *count) {
     char *tmpToken = NULL;
     char *tmpPtr;
@@ -84,36 +91,64 @@ static int getExternalNode(const char *type) {
     return -1;
 }
 
+// Called with sDPNodeLock held.
+static void resetDPNodeLocked() {
+    if (sDPConnectedFd >= 0) {
+        close(sDPConnectedFd);
+    }
+    sDPConnectedFd = -1;
+    sDPNodeId = -1;
+}
+
+// Called with sDPNodeLock held.
+static int getDPNodeLocked() {
+    if (sDPNodeId < 0) {
+        sDPNodeId = getExternalNode("dp panel");
+    }
+    return sDPNodeId;
+}
+
+void invalidateDisplayNodes() {
+    android::Mutex::Autolock lock(sDPNodeLock);
+    resetDPNodeLocked();
+}
+
 bool isDPConnected() {
     char connectPath[MAX_FRAME_BUFFER_NAME_SIZE];
-    FILE *connectFile = NULL;
-    size_t len = MAX_STRING_LENGTH;
     char stringBuffer[MAX_STRING_LENGTH];
-    char *line = stringBuffer;
+    android::Mutex::Autolock lock(sDPNodeLock);
 
-    int nodeId = getExternalNode("dp panel");
-    if (nodeId < 0) {
-        ALOGE("%s no DP node found", __func__);
-        return false;
-    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (sDPConnectedFd < 0) {
+            int nodeId = getDPNodeLocked();
+            if (nodeId < 0) {
+                ALOGE("%s no DP node found", __func__);
+                return false;
+            }
 
-    snprintf(connectPath, sizeof(connectPath),
-             "/sys/devices/virtual/graphics/fb%d/connected", nodeId);
+            snprintf(connectPath, sizeof(connectPath),
+                     "/sys/devices/virtual/graphics/fb%d/connected", nodeId);
 
-    connectFile = fopen(connectPath, "rb");
-    if (!connectFile) {
-        ALOGW("Failed to open connect node for device node %s", connectPath);
-        return false;
-    }
+            sDPConnectedFd = open(connectPath, O_RDONLY | O_CLOEXEC);
+            if (sDPConnectedFd < 0) {
+                ALOGW("Failed to open connect node for device node %s", connectPath);
+                resetDPNodeLocked();
+                continue;
+            }
+        }
 
-    if (getline(&line, &len, connectFile) < 0) {
-        fclose(connectFile);
-        return false;
-    }
+        // sysfs regenerates the attribute on every read from offset 0.
+        ssize_t len = pread(sDPConnectedFd, stringBuffer, sizeof(stringBuffer) - 1, 0);
+        if (len > 0) {
+            stringBuffer[len] = '\0';
+            return atoi(stringBuffer);
+        }
 
-    fclose(connectFile);
+        // The node may have gone away; look it up again.
+        resetDPNodeLocked();
+    }
 
-    return atoi(line);
+    return false;
 }
 
 int getDPTestConfig(uint32_t *panelBpp, uint32_t *patternType) {
@@ -130,7 +165,11 @@ int getDPTestConfig(uint32_t *panelBpp, uint32_t *patternType) {
     char stringBuffer[MAX_STRING_LENGTH];
     char *line = stringBuffer;
 
-    int nodeId = getExternalNode("dp panel");
+    int nodeId = -1;
+    {
+        android::Mutex::Autolock lock(sDPNodeLock);
+        nodeId = getDPNodeLocked();
+    }
     if (nodeId < 0) {
         ALOGE("%s no DP node found", __func__);
         return -EINVAL;
@@ -142,6 +181,7 @@ int getDPTestConfig(uint32_t *panelBpp, uint32_t *patternType) {
     configFile = fopen(configPath, "rb");
     if (!configFile) {
         ALOGW("Failed to open config node for device node %s", configPath);
+        invalidateDisplayNodes();
         return -EINVAL;
     }
 
@@ -61,6 +61,8 @@ enum {
 int getEdidRawData(char *buffer);
 int getHDMINode(void);
 bool isDPConnected();
+// Drops the cached display node lookups; call on hotplug uevents.
+void invalidateDisplayNodes();
 int getDPTestConfig(uint32_t *panelBpp, uint32_t *patternType);
 
 const char *GetHALPixelFormatString(int format);
@@ -79,6 +79,13 @@ public:
       SET_PANEL_LUMINANCE = 47,                // Set Panel Luminance attributes.
       SET_BRIGHTNESS_SCALE = 48,               // Set brightness scale ratio
       SET_COLOR_SAMPLING_ENABLED = 49,         // Toggle the collection of display color stats
+      SET_SDR_DIMMING_SCALE = 50,              // Set luminance scale of SDR layers shown with HDR
+      SET_DISPLAY_PARAMS = 51,                 // Apply a batch of display parameters at once
+      GET_DISPLAY_STATE_PAGE = 52,             // Get the read-only state page of a display
+      GET_DISPLAY_EVENT_CHANNEL = 53,          // Get the vsync/present/retire event ring of a display
+      QUEUE_SIDEBAND_FRAME = 54,               // Queue a frame of a tunneled video stream
+      QDCM_SVC_CMDS_SHM = 55,                  // QDCM services, payload in shared memory
+      SET_DSI_CLK_CONSTRAINTS = 56,            // DSI Clks to avoid for RF interference
       COMMAND_LIST_END = 400,
     };
 
@@ -109,6 +116,19 @@ public:
         ENABLE_PARTIAL_UPDATE,
     };
 
+    // SET_DISPLAY_PARAMS parcel: version, display, count, then count (parameter, value) pairs.
+    enum {
+        DISPLAY_PARAMS_VERSION = 1,
+    };
+
+    enum {
+        PARAM_BRIGHTNESS_SCALE = 1,  // Backlight scale, 0 - 100
+        PARAM_SDR_DIMMING_SCALE,     // SDR layer luminance scale with HDR content, 0 - 100
+        PARAM_REFRESH_RATE,          // Binder refresh rate in fps, 0 releases it
+        PARAM_IDLE_PC,               // 0 - disable, 1 - enable idle power collapse
+        PARAM_MAX,
+    };
+
     enum {
         QSYNC_MODE_NONE,
         QSYNC_MODE_CONTINUOUS,
@@ -22,6 +22,7 @@ LOCAL_SRC_FILES           := drm_manager.cpp \
                              drm_plane.cpp \
                              drm_atomic_req.cpp \
                              drm_utils.cpp \
+                             drm_blob_cache.cpp \
                              drm_pp_manager.cpp \
                              drm_property.cpp \
                              drm_dpps_mgr_imp.cpp
@@ -36,4 +37,19 @@ endif
 
 LOCAL_VENDOR_MODULE       := true
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE              := sde_drm_plane_benchmark
+LOCAL_MODULE_TAGS         := optional
+LOCAL_SHARED_LIBRARIES    := libdrm libdrmutils libdisplaydebug libsdedrm
+LOCAL_HEADER_LIBRARIES    := display_headers
+LOCAL_C_INCLUDES          := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                             -isystem external/libdrm
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS              := -Wno-missing-field-initializers -Wall -Werror -fno-operator-names \
+                             -Wno-unused-parameter -DLOG_TAG=\"SDE_DRM\"
+LOCAL_CLANG               := true
+LOCAL_SRC_FILES           := drm_plane_benchmark.cpp
+LOCAL_VENDOR_MODULE       := true
+include $(BUILD_EXECUTABLE)
 endif
@@ -40,6 +40,9 @@
 
 namespace sde_drm {
 
+// Covers a frame staging all planes of a display, requests grow beyond as needed
+static const int kReservedAtomicProps = 256;
+
 DRMAtomicReq::DRMAtomicReq(int fd, DRMManager *drm_mgr) : drm_mgr_(drm_mgr), fd_(fd) {}
 
 DRMAtomicReq::~DRMAtomicReq() {
@@ -56,10 +59,25 @@ int DRMAtomicReq::Init(const DRMDisplayToken &tok) {
     return -ENOMEM;
   }
 
+  if (!ReserveAtomicReq(drm_atomic_req_, kReservedAtomicProps)) {
+    reserved_props_ = kReservedAtomicProps;
+  }
+
   return 0;
 }
 
+void DRMAtomicReq::UpdateReservedSize() {
+  int cursor = drmModeAtomicGetCursor(drm_atomic_req_);
+  if (cursor > reserved_props_) {
+    reserved_props_ = cursor;
+    num_reallocs_++;
+    DRM_LOGI("crtc %d: Request grew to %d properties, %d reallocations", token_.crtc_id, cursor,
+             num_reallocs_);
+  }
+}
+
 int DRMAtomicReq::Perform(DRMOps opcode, uint32_t obj_id, ...) {
+  int cursor = drmModeAtomicGetCursor(drm_atomic_req_);
   va_list args;
   va_start(args, obj_id);
   switch (opcode) {
@@ -136,37 +154,73 @@ int DRMAtomicReq::Perform(DRMOps opcode, uint32_t obj_id, ...) {
       DRM_LOGE("Invalid opcode %d", opcode);
   }
   va_end(args);
+
+  if (!IsBufferOp(opcode) && drmModeAtomicGetCursor(drm_atomic_req_) != cursor) {
+    config_changed_ = true;
+  }
+
   return 0;
 }
 
+int DRMAtomicReq::SetPlaneState(uint32_t plane_id, const DRMPlaneState &state) {
+  int cursor = drmModeAtomicGetCursor(drm_atomic_req_);
+  drm_mgr_->GetPlaneMgr()->SetState(plane_id, drm_atomic_req_, state);
+  if (drmModeAtomicGetCursor(drm_atomic_req_) != cursor) {
+    config_changed_ = true;
+  }
+
+  return 0;
+}
+
+bool DRMAtomicReq::IsBufferOp(DRMOps opcode) {
+  switch (opcode) {
+    case DRMOps::PLANE_SET_FB_ID:
+    case DRMOps::PLANE_SET_ROT_FB_ID:
+    case DRMOps::PLANE_SET_INPUT_FENCE:
+    case DRMOps::CRTC_GET_RELEASE_FENCE:
+    case DRMOps::CONNECTOR_GET_RETIRE_FENCE:
+    case DRMOps::CONNECTOR_SET_OUTPUT_FB_ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
 int DRMAtomicReq::Validate() {
   // Call UnsetUnusedPlanes to find planes that need to be unset. Do not call CommitPlaneState,
   // because we just want to validate, not actually mark planes as removed
+  int cursor = drmModeAtomicGetCursor(drm_atomic_req_);
   drm_mgr_->GetPlaneMgr()->UnsetUnusedResources(token_.crtc_id, false/*is_commit*/,
                                                 drm_atomic_req_);
+  if (drmModeAtomicGetCursor(drm_atomic_req_) != cursor) {
+    config_changed_ = true;
+  }
 
-  int ret = drmModeAtomicCommit(fd_, drm_atomic_req_,
-                                DRM_MODE_ATOMIC_ALLOW_MODESET | DRM_MODE_ATOMIC_TEST_ONLY, nullptr);
-  if (ret) {
-    DRM_LOGE("drmModeAtomicCommit failed with error %d (%s).", errno, strerror(errno));
+  UpdateReservedSize();
+
+  int ret = 0;
+  if (config_changed_ || !last_commit_succeeded_) {
+    ret = drmModeAtomicCommit(fd_, drm_atomic_req_,
+                              DRM_MODE_ATOMIC_ALLOW_MODESET | DRM_MODE_ATOMIC_TEST_ONLY, nullptr);
+    if (ret) {
+      DRM_LOGE("drmModeAtomicCommit failed with error %d (%s).", errno, strerror(errno));
+    }
+  } else {
+    DRM_LOGV("crtc %d: Only buffers changed since last commit, skipping test", token_.crtc_id);
   }
 
   drm_mgr_->GetPlaneMgr()->PostValidate(token_.crtc_id, !ret);
   drm_mgr_->GetCrtcMgr()->PostValidate(token_.crtc_id, !ret);
+  drm_mgr_->GetConnectorMgr()->PostValidate(token_.conn_id, !ret);
   drmModeAtomicSetCursor(drm_atomic_req_, 0);
+  config_changed_ = false;
 
   return ret;
 }
 
 int DRMAtomicReq::Commit(bool synchronous, bool retain_planes) {
   DTRACE_SCOPED();
-  if (retain_planes) {
-    // It is not enough to simply avoid calling UnsetUnusedPlanes, since state transitons have to
-    // be correct when CommitPlaneState is called
-    drm_mgr_->GetPlaneMgr()->RetainPlanes(token_.crtc_id);
-  }
-
-  drm_mgr_->GetPlaneMgr()->UnsetUnusedResources(token_.crtc_id, true/*is_commit*/, drm_atomic_req_);
+  PrepareCommit(retain_planes);
 
   uint32_t flags = DRM_MODE_ATOMIC_ALLOW_MODESET;
 
@@ -179,11 +233,29 @@ int DRMAtomicReq::Commit(bool synchronous, bool retain_planes) {
     DRM_LOGE("drmModeAtomicCommit failed with error %d (%s).", errno, strerror(errno));
   }
 
-  drm_mgr_->GetPlaneMgr()->PostCommit(token_.crtc_id, !ret);
-  drm_mgr_->GetCrtcMgr()->PostCommit(token_.crtc_id, !ret);
-  drmModeAtomicSetCursor(drm_atomic_req_, 0);
+  PostCommit(!ret);
 
   return ret;
 }
 
+void DRMAtomicReq::PrepareCommit(bool retain_planes) {
+  if (retain_planes) {
+    // It is not enough to simply avoid calling UnsetUnusedPlanes, since state transitons have to
+    // be correct when CommitPlaneState is called
+    drm_mgr_->GetPlaneMgr()->RetainPlanes(token_.crtc_id);
+  }
+
+  drm_mgr_->GetPlaneMgr()->UnsetUnusedResources(token_.crtc_id, true/*is_commit*/, drm_atomic_req_);
+  UpdateReservedSize();
+}
+
+void DRMAtomicReq::PostCommit(bool success) {
+  drm_mgr_->GetPlaneMgr()->PostCommit(token_.crtc_id, success);
+  drm_mgr_->GetCrtcMgr()->PostCommit(token_.crtc_id, success);
+  drm_mgr_->GetConnectorMgr()->PostCommit(token_.conn_id, success);
+  drmModeAtomicSetCursor(drm_atomic_req_, 0);
+  config_changed_ = false;
+  last_commit_succeeded_ = success;
+}
+
 }  // namespace sde_drm
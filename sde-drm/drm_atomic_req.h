@@ -45,15 +45,30 @@ class DRMAtomicReq : public DRMAtomicReqInterface {
   DRMAtomicReq(int fd, DRMManager *drm_manager);
   virtual ~DRMAtomicReq();
   virtual int Perform(DRMOps op_code, uint32_t obj_id, ...);
+  virtual int SetPlaneState(uint32_t plane_id, const DRMPlaneState &state);
   virtual int Commit(bool synchronous, bool retain_planes);
   virtual int Validate();
   int Init(const DRMDisplayToken &tok);
+  // Split phases of Commit, used by DRMManager to commit several displays in one request.
+  void PrepareCommit(bool retain_planes);
+  void PostCommit(bool success);
+  drmModeAtomicReq *GetAtomicReq() { return drm_atomic_req_; }
 
  private:
+  bool IsBufferOp(DRMOps op_code);
+  // Tracks requests outgrowing their reserved size, libdrm reallocates them when that happens
+  void UpdateReservedSize();
+
   drmModeAtomicReq *drm_atomic_req_ = {};
   DRMManager *drm_mgr_ = {};
   int fd_ = -1;
   DRMDisplayToken token_ = {};
+  // Properties are only added when they differ from the committed state. A request that only
+  // carries new buffers and fences therefore repeats the last successful commit and needs no test.
+  bool config_changed_ = false;
+  bool last_commit_succeeded_ = false;
+  int reserved_props_ = 0;
+  uint32_t num_reallocs_ = 0;
 };
 
 }  // namespace sde_drm
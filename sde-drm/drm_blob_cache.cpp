@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm_logger.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <string.h>
+
+#include <functional>
+#include <string>
+
+#include "drm_blob_cache.h"
+
+#define __CLASS__ "DRMBlobCache"
+
+namespace sde_drm {
+
+using std::lock_guard;
+using std::mutex;
+
+static size_t HashPayload(const void *data, uint32_t size) {
+  return std::hash<std::string>()(std::string(reinterpret_cast<const char *>(data), size));
+}
+
+DRMBlobCache *DRMBlobCache::GetInstance() {
+  static DRMBlobCache *instance = new DRMBlobCache();
+  return instance;
+}
+
+uint32_t DRMBlobCache::Acquire(int fd, const void *data, uint32_t size) {
+  lock_guard<mutex> lock(lock_);
+  size_t hash = HashPayload(data, size);
+  auto range = blob_ids_.equal_range(hash);
+  for (auto it = range.first; it != range.second; it++) {
+    Blob &blob = blobs_.at(it->second);
+    if (blob.payload.size() != size || memcmp(blob.payload.data(), data, size)) {
+      continue;
+    }
+
+    if (blob.idle) {
+      idle_blobs_.erase(blob.idle_it);
+      blob.idle = false;
+    }
+    blob.ref_count++;
+    DRM_LOGV("Reusing blob %d, refs %d", it->second, blob.ref_count);
+    return it->second;
+  }
+
+  uint32_t blob_id = 0;
+  if (drmModeCreatePropertyBlob(fd, data, size, &blob_id) || !blob_id) {
+    DRM_LOGE("drmModeCreatePropertyBlob failed, size %d", size);
+    return 0;
+  }
+
+  Blob &blob = blobs_[blob_id];
+  const uint8_t *payload = reinterpret_cast<const uint8_t *>(data);
+  blob.payload.assign(payload, payload + size);
+  blob.ref_count = 1;
+  blob_ids_.emplace(hash, blob_id);
+
+  return blob_id;
+}
+
+void DRMBlobCache::Release(int fd, uint32_t blob_id) {
+  lock_guard<mutex> lock(lock_);
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end()) {
+    DRM_LOGE("Unknown blob %d", blob_id);
+    return;
+  }
+
+  Blob &blob = it->second;
+  if (!blob.ref_count || --blob.ref_count) {
+    return;
+  }
+
+  // The kernel holds its own reference on blobs in use, keeping ours only allows reuse
+  blob.idle_it = idle_blobs_.insert(idle_blobs_.end(), blob_id);
+  blob.idle = true;
+  if (idle_blobs_.size() > kMaxIdleBlobs) {
+    DestroyLocked(fd, idle_blobs_.front());
+  }
+}
+
+void DRMBlobCache::DestroyLocked(int fd, uint32_t blob_id) {
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end()) {
+    return;
+  }
+
+  Blob &blob = it->second;
+  if (blob.idle) {
+    idle_blobs_.erase(blob.idle_it);
+  }
+
+  auto range = blob_ids_.equal_range(HashPayload(blob.payload.data(),
+                                                 static_cast<uint32_t>(blob.payload.size())));
+  for (auto id_it = range.first; id_it != range.second; id_it++) {
+    if (id_it->second == blob_id) {
+      blob_ids_.erase(id_it);
+      break;
+    }
+  }
+
+  drmModeDestroyPropertyBlob(fd, blob_id);
+  blobs_.erase(it);
+}
+
+}  // namespace sde_drm
@@ -0,0 +1,73 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DRM_BLOB_CACHE_H__
+#define __DRM_BLOB_CACHE_H__
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sde_drm {
+
+// Content addressed cache of property blobs. Payloads staged again with identical content, like
+// a mode or a PP feature set again unchanged, share one blob instead of creating a new one and
+// destroying the old one each time. Released blobs linger until kMaxIdleBlobs newer ones are idle.
+class DRMBlobCache {
+ public:
+  static DRMBlobCache *GetInstance();
+  // Returns a blob holding the payload and takes a reference on it, 0 on failure
+  uint32_t Acquire(int fd, const void *data, uint32_t size);
+  // Drops a reference taken by Acquire
+  void Release(int fd, uint32_t blob_id);
+
+ private:
+  static const uint32_t kMaxIdleBlobs = 16;
+
+  struct Blob {
+    std::vector<uint8_t> payload;
+    uint32_t ref_count = 0;
+    bool idle = false;
+    std::list<uint32_t>::iterator idle_it;
+  };
+
+  DRMBlobCache() {}
+  void DestroyLocked(int fd, uint32_t blob_id);
+
+  std::mutex lock_;
+  std::unordered_map<uint32_t, Blob> blobs_;
+  std::unordered_multimap<size_t, uint32_t> blob_ids_;  // Keyed by payload hash
+  std::list<uint32_t> idle_blobs_;  // Least recently released first
+};
+
+}  // namespace sde_drm
+
+#endif  // __DRM_BLOB_CACHE_H__
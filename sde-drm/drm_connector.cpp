@@ -56,6 +56,7 @@ using std::stringstream;
 using std::pair;
 using std::vector;
 using std::unique_ptr;
+using std::shared_ptr;
 using std::map;
 using std::mutex;
 using std::lock_guard;
@@ -244,22 +245,27 @@ static int32_t GetColorspace(DRMColorspace drm_colorspace) {
 #define __CLASS__ "DRMConnectorManager"
 
 void DRMConnectorManager::Init(drmModeRes *resource) {
-  lock_guard<mutex> lock(lock_);
+  lock_guard<mutex> update(update_lock_);
+  auto pool = std::make_shared<ConnectorPool>();
   for (int i = 0; i < resource->count_connectors; i++) {
-    unique_ptr<DRMConnector> conn(new DRMConnector(fd_));
+    shared_ptr<DRMConnector> conn(new DRMConnector(fd_));
     drmModeConnector *libdrm_conn = drmModeGetConnector(fd_, resource->connectors[i]);
     if (libdrm_conn) {
-      conn->InitAndParse(libdrm_conn);
-      connector_pool_[resource->connectors[i]] = std::move(conn);
+      conn->Init(libdrm_conn);
+      (*pool)[resource->connectors[i]] = std::move(conn);
     } else {
       DRM_LOGE("Critical error: drmModeGetConnector() failed for connector %u.",
                resource->connectors[i]);
     }
   }
+
+  std::atomic_store(&pool_, shared_ptr<const ConnectorPool>(pool));
 }
 
 void DRMConnectorManager::Update() {
-  lock_guard<mutex> lock(lock_);
+  // Only one update builds the next pool at a time. Queries keep using the published pool, and
+  // reservations are only held off while it is swapped in.
+  lock_guard<mutex> update(update_lock_);
   drmModeRes *resource = drmModeGetResources(fd_);
 
   if (NULL == resource) {
@@ -268,94 +274,108 @@ void DRMConnectorManager::Update() {
   }
 
   // Build a map of the updated list of connector ids.
-  std::map<uint32_t, uint32_t> drm_connectors;
+  std::set<uint32_t> drm_connectors;
   for (int i = 0; i < resource->count_connectors; i++) {
-    drm_connectors[resource->connectors[i]] = resource->connectors[i];
+    drm_connectors.insert(resource->connectors[i]);
   }
+  drmModeFreeResources(resource);
 
-  // Delete connectors in connector pool.
-  for (auto conn = connector_pool_.cbegin(); conn != connector_pool_.cend();) {
-    auto drmconn = drm_connectors.find(conn->first);
-    if (drmconn == drm_connectors.end()) {
-      // A DRM Connector in our pool was deleted.
-      if (conn->second->GetStatus() == DRMStatus::FREE) {
-        DRM_LOGD("Removing connector id %u from pool.", conn->first);
-        conn = connector_pool_.erase(conn);
-      } else {
-        // Physically removed DRM Connectors (displays) first go to disconnected state. When its
-        // reserved resources are freed up, they are removed from the driver's connector list. Do
-        // not remove DRM Connectors that are DRMStatus::BUSY.
-        DRM_LOGW("In-use connector id %u removed by DRM.", conn->first);
-        conn++;
-      }
+  // Probe new connectors before anything is locked, this may take a while for pluggable ones.
+  auto current = GetPool();
+  ConnectorPool added;
+  for (auto id : drm_connectors) {
+    if (current->count(id)) {
+      continue;
+    }
+    DRM_LOGD("Adding connector id %u to pool.", id);
+    shared_ptr<DRMConnector> conn(new DRMConnector(fd_));
+    drmModeConnector *libdrm_conn = drmModeGetConnector(fd_, id);
+    if (libdrm_conn) {
+      conn->Init(libdrm_conn);
+      conn->SetSkipConnectorReload(true);
+      added[id] = std::move(conn);
     } else {
-      // Remove DRM Connector present in both lists to ensure that only new connector ids remain.
-      drm_connectors.erase(drmconn);
-      conn++;
+      DRM_LOGW("Critical error: drmModeGetConnector() failed for connector %u.", id);
     }
   }
 
-  // Add new connectors in connector pool.
-  for (auto &drmconn : drm_connectors) {
-    DRM_LOGD("Adding connector id %u to pool.", drmconn.first);
-    unique_ptr<DRMConnector> conn(new DRMConnector(fd_));
-    drmModeConnector *libdrm_conn = drmModeGetConnector(fd_, drmconn.first);
-    if (libdrm_conn) {
-      conn->InitAndParse(libdrm_conn);
-      conn->SetSkipConnectorReload(true);
-      connector_pool_[drmconn.first] = std::move(conn);
+  // Whether a removed connector can be dropped depends on its reservation, so that part is done
+  // under the reservation lock.
+  lock_guard<mutex> lock(lock_);
+  auto next = std::make_shared<ConnectorPool>(added);
+  for (auto &conn : *current) {
+    if (drm_connectors.count(conn.first)) {
+      next->insert(conn);
+    } else if (conn.second->GetStatus() == DRMStatus::FREE) {
+      // A DRM Connector in our pool was deleted.
+      DRM_LOGD("Removing connector id %u from pool.", conn.first);
     } else {
-      DRM_LOGW("Critical error: drmModeGetConnector() failed for connector %u.", drmconn.first);
+      // Physically removed DRM Connectors (displays) first go to disconnected state. When its
+      // reserved resources are freed up, they are removed from the driver's connector list. Do
+      // not remove DRM Connectors that are DRMStatus::BUSY.
+      DRM_LOGW("In-use connector id %u removed by DRM.", conn.first);
+      next->insert(conn);
     }
   }
 
-  drmModeFreeResources(resource);
+  // Modes and capabilities of pluggable connectors may have changed, probe them again.
+  generation_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_store(&pool_, shared_ptr<const ConnectorPool>(next));
+}
+
+shared_ptr<DRMConnector> DRMConnectorManager::Find(uint32_t conn_id) {
+  auto pool = GetPool();
+  auto it = pool->find(conn_id);
+  return (it != pool->end()) ? it->second : nullptr;
 }
 
 void DRMConnectorManager::DumpByID(uint32_t id) {
-  lock_guard<mutex> lock(lock_);
-  connector_pool_[id]->Dump();
+  auto conn = Find(id);
+  if (conn) {
+    conn->Dump();
+  }
 }
 
 void DRMConnectorManager::DumpAll() {
-  lock_guard<mutex> lock(lock_);
-  for (auto &conn : connector_pool_) {
+  for (auto &conn : *GetPool()) {
     conn.second->Dump();
   }
 }
 
 void DRMConnectorManager::Perform(DRMOps code, uint32_t obj_id, drmModeAtomicReq *req,
                                   va_list args) {
-  lock_guard<mutex> lock(lock_);
-  auto it = connector_pool_.find(obj_id);
-  if (it == connector_pool_.end()) {
+  auto conn = Find(obj_id);
+  if (!conn) {
     DRM_LOGE("Invalid connector id %d", obj_id);
     return;
   }
 
-  it->second->Perform(code, req, args);
+  conn->Perform(code, req, args);
 }
 
 int DRMConnectorManager::GetConnectorInfo(uint32_t conn_id, DRMConnectorInfo *info) {
-  lock_guard<mutex> lock(lock_);
-  int ret = -ENODEV;
-  auto iter = connector_pool_.find(conn_id);
-
-  if (iter !=  connector_pool_.end()) {
-    ret = connector_pool_[conn_id]->GetInfo(info);
+  auto conn = Find(conn_id);
+  if (!conn) {
+    return -ENODEV;
   }
 
-  return ret;
+  return conn->GetInfo(generation_.load(std::memory_order_relaxed), info);
+}
+
+void DRMConnectorManager::InvalidateConnectorInfo(uint32_t conn_id) {
+  auto conn = Find(conn_id);
+  if (conn) {
+    conn->InvalidateInfo();
+  }
 }
 
 void DRMConnectorManager::GetConnectorList(std::vector<uint32_t> *conn_ids) {
-  lock_guard<mutex> lock(lock_);
   if (!conn_ids) {
     DRM_LOGE("No output parameter provided.");
     return;
   }
   conn_ids->clear();
-  for (auto &conn : connector_pool_) {
+  for (auto &conn : *GetPool()) {
     conn_ids->push_back(conn.first);
   }
 }
@@ -371,7 +391,9 @@ int DRMConnectorManager::Reserve(DRMDisplayType disp_type, DRMDisplayToken *toke
   int ret = -ENODEV;
   token->conn_id = 0;
 
-  for (auto &conn : connector_pool_) {
+  // The pool cannot be swapped while lock_ is held, so the connectors reserved below stay in it.
+  auto pool = GetPool();
+  for (auto &conn : *pool) {
     if (conn.second->GetStatus() == DRMStatus::FREE) {
       uint32_t conn_type;
       conn.second->GetType(&conn_type);
@@ -381,7 +403,7 @@ int DRMConnectorManager::Reserve(DRMDisplayType disp_type, DRMDisplayToken *toke
         if (conn.second->IsConnected()) {
           // Free-up previously reserved connector, if any.
           if (token->conn_id) {
-            connector_pool_[token->conn_id]->Unlock();
+            pool->at(token->conn_id)->Unlock();
           }
           conn.second->Lock();
           token->conn_id = conn.first;
@@ -408,10 +430,10 @@ int DRMConnectorManager::Reserve(uint32_t conn_id, DRMDisplayToken *token) {
   lock_guard<mutex> lock(lock_);
   int ret = -ENODEV;
 
-  auto iter = connector_pool_.find(conn_id);
-  if ((iter != connector_pool_.end()) && (iter->second->GetStatus() == DRMStatus::FREE)) {
-    iter->second->Lock();
-    token->conn_id = iter->first;
+  auto conn = Find(conn_id);
+  if (conn && (conn->GetStatus() == DRMStatus::FREE)) {
+    conn->Lock();
+    token->conn_id = conn_id;
     ret = 0;
   }
 
@@ -420,17 +442,39 @@ int DRMConnectorManager::Reserve(uint32_t conn_id, DRMDisplayToken *token) {
 
 int DRMConnectorManager::GetPossibleEncoders(uint32_t connector_id,
                                              set<uint32_t> *possible_encoders) {
-  lock_guard<mutex> lock(lock_);
-  return connector_pool_[connector_id]->GetPossibleEncoders(possible_encoders);
+  auto conn = Find(connector_id);
+  if (!conn) {
+    return -ENODEV;
+  }
+
+  return conn->GetPossibleEncoders(possible_encoders);
 }
 
 
 void DRMConnectorManager::Free(DRMDisplayToken *token) {
   lock_guard<mutex> lock(lock_);
-  connector_pool_.at(token->conn_id)->Unlock();
+  // A reserved connector is never dropped from the pool.
+  auto conn = Find(token->conn_id);
+  if (conn) {
+    conn->Unlock();
+  }
   token->conn_id = 0;
 }
 
+void DRMConnectorManager::PostValidate(uint32_t conn_id, bool success) {
+  auto conn = Find(conn_id);
+  if (conn) {
+    conn->PostValidate(success);
+  }
+}
+
+void DRMConnectorManager::PostCommit(uint32_t conn_id, bool success) {
+  auto conn = Find(conn_id);
+  if (conn) {
+    conn->PostCommit(success);
+  }
+}
+
 // ==============================================================================================//
 
 #undef __CLASS__
@@ -685,10 +729,20 @@ void DRMConnector::ParseCapabilities(uint64_t blob_id, std::vector<uint8_t> *edi
   drmModeFreePropertyBlob(blob);
 }
 
-int DRMConnector::GetInfo(DRMConnectorInfo *info) {
+int DRMConnector::GetInfo(uint64_t generation, DRMConnectorInfo *info) {
+  lock_guard<mutex> lock(access_lock_);
+  // Probing a TV connector may read the EDID over DDC. Until a hotplug moves the generation on,
+  // config queries get what the last probe found.
+  bool reloadable = IsTVConnector(drm_connector_->connector_type) ||
+                    (DRM_MODE_CONNECTOR_VIRTUAL == drm_connector_->connector_type);
+  if (reloadable && (info_generation_ == generation)) {
+    *info = info_;
+    return 0;
+  }
+
+  ParsePropertiesOnce();
   uint32_t conn_id = drm_connector_->connector_id;
-  if (!skip_connector_reload_ && (IsTVConnector(drm_connector_->connector_type)
-      || (DRM_MODE_CONNECTOR_VIRTUAL == drm_connector_->connector_type))) {
+  if (!skip_connector_reload_ && reloadable) {
     // Reload since for some connectors like Virtual and DP, modes may change.
     drmModeConnectorPtr drm_connector = drmModeGetConnector(fd_, conn_id);
     if (!drm_connector) {
@@ -726,7 +780,7 @@ int DRMConnector::GetInfo(DRMConnectorInfo *info) {
   info->mmHeight = drm_connector_->mmHeight;
   info->type = drm_connector_->connector_type;
   info->type_id = drm_connector_->connector_type_id;
-  info->is_connected = IsConnected();
+  info->is_connected = (DRM_MODE_CONNECTED == drm_connector_->connection);
 
   drmModeObjectProperties *props =
       drmModeObjectGetProperties(fd_, drm_connector_->connector_id, DRM_MODE_OBJECT_CONNECTOR);
@@ -791,23 +845,37 @@ int DRMConnector::GetInfo(DRMConnectorInfo *info) {
 
   drmModeFreeObjectProperties(props);
 
+  if (reloadable) {
+    info_ = *info;
+    info_generation_ = generation;
+  }
+
   return 0;
 }
 
-void DRMConnector::InitAndParse(drmModeConnector *conn) {
-  drm_connector_ = conn;
+void DRMConnector::ParsePropertiesOnce() {
+  // Properties are fetched when the connector is first queried or programmed instead of during
+  // DRMManager::Init, so connectors that come and go before that never pay for the parsing.
+  if (properties_parsed_) {
+    return;
+  }
+
+  properties_parsed_ = true;
   ParseProperties();
   pp_mgr_ = std::unique_ptr<DRMPPManager>(new DRMPPManager(fd_));
   pp_mgr_->Init(prop_mgr_, DRM_MODE_OBJECT_CONNECTOR);
 }
 
 void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
+  lock_guard<mutex> lock(access_lock_);
+  ParsePropertiesOnce();
   uint32_t obj_id = drm_connector_->connector_id;
 
   switch (code) {
     case DRMOps::CONNECTOR_SET_CRTC: {
       uint32_t crtc = va_arg(args, uint32_t);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::CRTC_ID), crtc);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::CRTC_ID), crtc,
+                  true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting CRTC %d", obj_id, crtc);
     } break;
 
@@ -820,14 +888,14 @@ void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
 
     case DRMOps::CONNECTOR_SET_OUTPUT_RECT: {
       DRMRect rect = va_arg(args, DRMRect);
-      drmModeAtomicAddProperty(req, obj_id,
-                               prop_mgr_.GetPropertyId(DRMProperty::DST_X), rect.left);
-      drmModeAtomicAddProperty(req, obj_id,
-                               prop_mgr_.GetPropertyId(DRMProperty::DST_Y), rect.top);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_W),
-                               rect.right - rect.left);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_H),
-                               rect.bottom - rect.top);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_X), rect.left,
+                  true /* cache */, tmp_prop_val_map_);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_Y), rect.top,
+                  true /* cache */, tmp_prop_val_map_);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_W),
+                  rect.right - rect.left, true /* cache */, tmp_prop_val_map_);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::DST_H),
+                  rect.bottom - rect.top, true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting dst [x,y,w,h][%d,%d,%d,%d]", obj_id, rect.left,
                   rect.top, (rect.right - rect.left), (rect.bottom - rect.top));
     } break;
@@ -858,7 +926,8 @@ void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
           DRM_LOGE("Invalid power mode %d to set on connector %d", drm_power_mode, obj_id);
           break;
       }
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::LP), power_mode);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::LP), power_mode,
+                  true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting power_mode %d", obj_id, power_mode);
     } break;
 
@@ -870,17 +939,16 @@ void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
 
     case DRMOps::CONNECTOR_SET_AUTOREFRESH: {
       uint32_t enable = va_arg(args, uint32_t);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::AUTOREFRESH),
-                               enable);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::AUTOREFRESH), enable,
+                  true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting autorefresh %d", obj_id, enable);
     } break;
 
     case DRMOps::CONNECTOR_SET_FB_SECURE_MODE: {
       int secure_mode = va_arg(args, int);
       uint32_t fb_secure_mode = (secure_mode == (int)DRMSecureMode::SECURE) ? SECURE : NON_SECURE;
-      drmModeAtomicAddProperty(req, obj_id,
-                               prop_mgr_.GetPropertyId(DRMProperty::FB_TRANSLATION_MODE),
-                               fb_secure_mode);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::FB_TRANSLATION_MODE),
+                  fb_secure_mode, true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting FB secure mode %d", obj_id, fb_secure_mode);
     } break;
 
@@ -902,15 +970,15 @@ void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
       }
       int drm_qsync_mode = va_arg(args, int);
       uint32_t qsync_mode = static_cast<uint32_t>(drm_qsync_mode);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::QSYNC_MODE),
-                               qsync_mode);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::QSYNC_MODE), qsync_mode,
+                  true /* cache */, tmp_prop_val_map_);
       DRM_LOGD("Connector %d: Setting Qsync mode %d", obj_id, qsync_mode);
     } break;
 
     case DRMOps::CONNECTOR_SET_TOPOLOGY_CONTROL: {
       uint32_t topology_control = va_arg(args, uint32_t);
-      drmModeAtomicAddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::TOPOLOGY_CONTROL),
-                               topology_control);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::TOPOLOGY_CONTROL),
+                  topology_control, true /* cache */, tmp_prop_val_map_);
     } break;
 
     case DRMOps::CONNECTOR_SET_FRAME_TRIGGER: {
@@ -956,13 +1024,9 @@ void DRMConnector::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
       colorspace = GetColorspace(drm_colorspace);
       if (colorspace >= 0) {
         uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::COLORSPACE);
-        int ret = drmModeAtomicAddProperty(req, obj_id, prop_id, colorspace);
-        if (ret < 0) {
-          DRM_LOGE("AtomicAddProperty failed obj_id 0x%x, prop_id %d mode %d ret %d",
-                   obj_id, prop_id, colorspace, ret);
-        } else {
-          DRM_LOGD("Connector %d: Setting colorspace %d", obj_id, colorspace);
-        }
+        AddProperty(req, obj_id, prop_id, static_cast<uint32_t>(colorspace), true /* cache */,
+                    tmp_prop_val_map_);
+        DRM_LOGD("Connector %d: Setting colorspace %d", obj_id, colorspace);
       } else {
         DRM_LOGE("Invalid colorspace %d", colorspace);
       }
@@ -1008,6 +1072,8 @@ int DRMConnector::GetPossibleEncoders(set<uint32_t> *possible_encoders) {
     return -EINVAL;
   }
 
+  lock_guard<mutex> lock(access_lock_);
+
   uint32_t count_enc = drm_connector_->count_encoders;
   if (count_enc == 0) {
     DRM_LOGW("No possible encoders for connector %u", drm_connector_->connector_id);
@@ -1021,7 +1087,29 @@ int DRMConnector::GetPossibleEncoders(set<uint32_t> *possible_encoders) {
   return 0;
 }
 
+void DRMConnector::Unlock() {
+  lock_guard<mutex> lock(access_lock_);
+  tmp_prop_val_map_.clear();
+  committed_prop_val_map_.clear();
+  status_ = DRMStatus::FREE;
+}
+
+void DRMConnector::PostValidate(bool /*success*/) {
+  lock_guard<mutex> lock(access_lock_);
+  tmp_prop_val_map_ = committed_prop_val_map_;
+}
+
+void DRMConnector::PostCommit(bool success) {
+  lock_guard<mutex> lock(access_lock_);
+  if (success) {
+    committed_prop_val_map_ = tmp_prop_val_map_;
+  } else {
+    tmp_prop_val_map_ = committed_prop_val_map_;
+  }
+}
+
 void DRMConnector::Dump() {
+  lock_guard<mutex> lock(access_lock_);
   DRM_LOGE("id: %d\tenc_id: %d\tconn: %d\ttype: %d\tPhy: %dx%d\n", drm_connector_->connector_id,
            drm_connector_->encoder_id, drm_connector_->connection, drm_connector_->connector_type,
            drm_connector_->mmWidth, drm_connector_->mmHeight);
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+* Copyright (c) 2019-2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -33,12 +33,13 @@
 #include <drm_interface.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
+#include <atomic>
 #include <map>
 #include <memory>
-#include <memory>
 #include <drm/msm_drm.h>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 #include "drm_pp_manager.h"
 
 #include "drm_utils.h"
@@ -50,20 +51,33 @@ class DRMConnector {
  public:
   explicit DRMConnector(int fd) : fd_(fd) {}
   ~DRMConnector();
-  void InitAndParse(drmModeConnector *conn);
+  void Init(drmModeConnector *conn) { drm_connector_ = conn; }
   void Lock() { status_ = DRMStatus::BUSY; }
-  void Unlock() { status_ = DRMStatus::FREE; }
+  void Unlock();
   DRMStatus GetStatus() { return status_; }
-  int GetInfo(DRMConnectorInfo *info);
-  void GetType(uint32_t *conn_type) { *conn_type = drm_connector_->connector_type; }
+  int GetInfo(uint64_t generation, DRMConnectorInfo *info);
+  void InvalidateInfo() {
+    std::lock_guard<std::mutex> lock(access_lock_);
+    info_generation_ = 0;
+  }
+  void GetType(uint32_t *conn_type) {
+    std::lock_guard<std::mutex> lock(access_lock_);
+    *conn_type = drm_connector_->connector_type;
+  }
   void Perform(DRMOps code, drmModeAtomicReq *req, va_list args);
-  int IsConnected() { return (DRM_MODE_CONNECTED == drm_connector_->connection); }
+  int IsConnected() {
+    std::lock_guard<std::mutex> lock(access_lock_);
+    return (DRM_MODE_CONNECTED == drm_connector_->connection);
+  }
   int GetPossibleEncoders(std::set<uint32_t> *possible_encoders);
   void SetSkipConnectorReload(bool skip_reload) { skip_connector_reload_ = skip_reload; };
   void Dump();
+  void PostValidate(bool success);
+  void PostCommit(bool success);
 
  private:
   void ParseProperties();
+  void ParsePropertiesOnce();
   void ParseCapabilities(uint64_t blob_id, DRMConnectorInfo *info);
   void ParseCapabilities(uint64_t blob_id, drm_panel_hdr_properties *hdr_info);
   void ParseModeProperties(uint64_t blob_id, DRMConnectorInfo *info);
@@ -73,11 +87,19 @@ class DRMConnector {
               DRMRect *conn_rois);
 
   int fd_ = -1;
+  // Serializes queries, which may reload drm_connector_, against programming of the connector.
+  // The reservation status is guarded by the connector manager instead.
+  std::mutex access_lock_;
   drmModeConnector *drm_connector_ = {};
   DRMPropertyManager prop_mgr_ {};
   bool skip_connector_reload_ = false; //  Usually set to true for new TV/pluggable displays.
   DRMStatus status_ = DRMStatus::FREE;
   std::unique_ptr<DRMPPManager> pp_mgr_{};
+  bool properties_parsed_ = false;  // Properties are parsed on first GetInfo/Perform
+  std::unordered_map<uint32_t, uint64_t> tmp_prop_val_map_ {};
+  std::unordered_map<uint32_t, uint64_t> committed_prop_val_map_ {};
+  DRMConnectorInfo info_ {};      // Last probe of a TV or virtual connector
+  uint64_t info_generation_ = 0;  // Connector manager generation of info_, 0 when not probed
 };
 
 class DRMConnectorManager {
@@ -93,15 +115,26 @@ class DRMConnectorManager {
   void Free(DRMDisplayToken *token);
   void Perform(DRMOps code, uint32_t obj_id, drmModeAtomicReq *req, va_list args);
   int GetConnectorInfo(uint32_t conn_id, DRMConnectorInfo *info);
+  void InvalidateConnectorInfo(uint32_t conn_id);
   void GetConnectorList(std::vector<uint32_t> *conn_ids);
   int GetPossibleEncoders(uint32_t connector_id, std::set<uint32_t> *possible_encoders);
+  void PostValidate(uint32_t conn_id, bool success);
+  void PostCommit(uint32_t conn_id, bool success);
   ~DRMConnectorManager() {}
 
  private:
+  // Map of connector id to DRMConnector. A published pool is never modified, Update builds the
+  // next one and swaps it in, so queries use whichever pool is current without locking.
+  typedef std::map<uint32_t, std::shared_ptr<DRMConnector>> ConnectorPool;
+
+  std::shared_ptr<const ConnectorPool> GetPool() { return std::atomic_load(&pool_); }
+  std::shared_ptr<DRMConnector> Find(uint32_t conn_id);
+
   int fd_ = -1;
-  std::mutex lock_;
-  // Map of connector id to DRMConnector *
-  std::map<uint32_t, std::unique_ptr<DRMConnector>> connector_pool_{};
+  std::mutex update_lock_;  // Serializes Init and Update
+  std::mutex lock_;         // Guards connector reservations, and the pool swap against them
+  std::atomic<uint64_t> generation_{1};  // Bumped by each Update, hotplugs go through it
+  std::shared_ptr<const ConnectorPool> pool_ = std::make_shared<const ConnectorPool>();
 };
 
 }  // namespace sde_drm
@@ -42,6 +42,7 @@
 #include <vector>
 #include <utility>
 
+#include "drm_blob_cache.h"
 #include "drm_utils.h"
 #include "drm_crtc.h"
 #include "drm_property.h"
@@ -170,32 +171,23 @@ void DRMCrtcManager::SetScalerLUT(const DRMScalerLUTInfo &lut_info) {
   }
 
   if (lut_info.dir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut),
-                              lut_info.dir_lut_size, &dir_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut), lut_info.dir_lut_size,
+                    &dir_lut_, &dir_lut_blob_id_);
   }
   if (lut_info.cir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut),
-                              lut_info.cir_lut_size, &cir_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut), lut_info.cir_lut_size,
+                    &cir_lut_, &cir_lut_blob_id_);
   }
   if (lut_info.sep_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut),
-                              lut_info.sep_lut_size, &sep_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut), lut_info.sep_lut_size,
+                    &sep_lut_, &sep_lut_blob_id_);
   }
 }
 
 void DRMCrtcManager::UnsetScalerLUT() {
-  if (dir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, dir_lut_blob_id_);
-    dir_lut_blob_id_ = 0;
-  }
-  if (cir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, cir_lut_blob_id_);
-    cir_lut_blob_id_ = 0;
-  }
-  if (sep_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, sep_lut_blob_id_);
-    sep_lut_blob_id_ = 0;
-  }
+  DestroyPropertyBlob(fd_, &dir_lut_, &dir_lut_blob_id_);
+  DestroyPropertyBlob(fd_, &cir_lut_, &cir_lut_blob_id_);
+  DestroyPropertyBlob(fd_, &sep_lut_, &sep_lut_blob_id_);
 }
 
 int DRMCrtcManager::GetCrtcInfo(uint32_t crtc_id, DRMCrtcInfo *info) {
@@ -532,7 +524,7 @@ void DRMCrtc::Lock() {
 
 void DRMCrtc::Unlock() {
   if (mode_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, mode_blob_id_);
+    DRMBlobCache::GetInstance()->Release(fd_, static_cast<uint32_t>(mode_blob_id_));
     mode_blob_id_ = 0;
   }
 
@@ -543,7 +535,7 @@ void DRMCrtc::Unlock() {
 
 void DRMCrtc::SetModeBlobID(uint64_t blob_id) {
   if (mode_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, mode_blob_id_);
+    DRMBlobCache::GetInstance()->Release(fd_, static_cast<uint32_t>(mode_blob_id_));
   }
 
   mode_blob_id_ = blob_id;
@@ -566,7 +558,9 @@ void DRMCrtc::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
       uint32_t blob_id = 0;
 
       if (mode) {
-        if (drmModeCreatePropertyBlob(fd_, (const void *)mode, sizeof(drmModeModeInfo), &blob_id)) {
+        // The same mode maps to the same blob, so the unchanged MODE_ID is not sent again
+        blob_id = DRMBlobCache::GetInstance()->Acquire(fd_, mode, sizeof(drmModeModeInfo));
+        if (!blob_id) {
           DRM_LOGE("drmModeCreatePropertyBlob failed for CRTC_SET_MODE, crtc %d", obj_id);
           return;
         }
@@ -635,8 +629,8 @@ void DRMCrtc::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
 
     case DRMOps::CRTC_SET_ROT_PREFILL_BW: {
       uint64_t rot_bw = va_arg(args, uint64_t);
-      drmModeAtomicAddProperty(req, obj_id,
-                               prop_mgr_.GetPropertyId(DRMProperty::ROT_PREFILL_BW), rot_bw);
+      AddProperty(req, obj_id, prop_mgr_.GetPropertyId(DRMProperty::ROT_PREFILL_BW), rot_bw,
+                  true /* cache */, tmp_prop_val_map_);
     }; break;
 
     case DRMOps::CRTC_SET_ROT_CLK: {
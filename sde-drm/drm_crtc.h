@@ -116,10 +116,13 @@ class DRMCrtcManager {
  private:
   int fd_ = -1;
   std::map<uint32_t, std::unique_ptr<DRMCrtc>> crtc_pool_{};
-    // GLobal Scaler LUT blobs
+    // GLobal Scaler LUT blobs, and the LUTs they were created from
   uint32_t dir_lut_blob_id_ = 0;
   uint32_t cir_lut_blob_id_ = 0;
   uint32_t sep_lut_blob_id_ = 0;
+  std::vector<uint8_t> dir_lut_ = {};
+  std::vector<uint8_t> cir_lut_ = {};
+  std::vector<uint8_t> sep_lut_ = {};
   std::mutex lock_;
 };
 
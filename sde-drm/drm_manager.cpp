@@ -29,16 +29,22 @@
 
 #include <drm_logger.h>
 
+#include <inttypes.h>
 #include <string.h>
+#include <chrono>
 #include "drm_atomic_req.h"
 #include "drm_connector.h"
 #include "drm_crtc.h"
 #include "drm_encoder.h"
 #include "drm_manager.h"
 #include "drm_plane.h"
+#include "drm_utils.h"
 
 using std::lock_guard;
 using std::mutex;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 extern "C" {
 
@@ -92,6 +98,16 @@ void DRMManager::Destroy() {
 int DRMManager::Init(int drm_fd) {
   fd_ = drm_fd;
 
+  // Boot profile of the object parsing below, in microseconds per manager.
+  auto stage_start = steady_clock::now();
+  auto init_start = stage_start;
+  auto elapsed_us = [&stage_start]() {
+    auto now = steady_clock::now();
+    int64_t us = duration_cast<microseconds>(now - stage_start).count();
+    stage_start = now;
+    return us;
+  };
+
   drmSetClientCap(fd_, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
   drmSetClientCap(fd_, DRM_CLIENT_CAP_ATOMIC, 1);
 
@@ -100,6 +116,7 @@ int DRMManager::Init(int drm_fd) {
     DRM_LOGE("drmModeGetResources failed");
     return DRM_ERR_INVALID;
   }
+  int64_t resources_us = elapsed_us();
 
   conn_mgr_ = new DRMConnectorManager(fd_);
   if (!conn_mgr_) {
@@ -107,6 +124,7 @@ int DRMManager::Init(int drm_fd) {
     return DRM_ERR_INVALID;
   }
   conn_mgr_->Init(resource);
+  int64_t connectors_us = elapsed_us();
 
   encoder_mgr_ = new DRMEncoderManager(fd_);
   if (!encoder_mgr_) {
@@ -114,6 +132,7 @@ int DRMManager::Init(int drm_fd) {
     return DRM_ERR_INVALID;
   }
   encoder_mgr_->Init(resource);
+  int64_t encoders_us = elapsed_us();
 
   crtc_mgr_ = new DRMCrtcManager(fd_);
   if (!crtc_mgr_) {
@@ -121,6 +140,7 @@ int DRMManager::Init(int drm_fd) {
     return DRM_ERR_INVALID;
   }
   crtc_mgr_->Init(resource);
+  int64_t crtcs_us = elapsed_us();
 
   plane_mgr_ = new DRMPlaneManager(fd_);
   if (!plane_mgr_) {
@@ -128,10 +148,18 @@ int DRMManager::Init(int drm_fd) {
     return DRM_ERR_INVALID;
   }
   plane_mgr_->Init();
+  int64_t planes_us = elapsed_us();
 
   dpps_mgr_intf_ = GetDppsManagerIntf();
   if (dpps_mgr_intf_)
     dpps_mgr_intf_->Init(fd_, resource);
+  int64_t dpps_us = elapsed_us();
+
+  DLOGI("Init profile (us): resources %" PRId64 ", %d connectors %" PRId64 ", %d encoders %"
+        PRId64 ", %d crtcs %" PRId64 ", planes %" PRId64 ", dpps %" PRId64 ", total %" PRId64,
+        resources_us, resource->count_connectors, connectors_us, resource->count_encoders,
+        encoders_us, resource->count_crtcs, crtcs_us, planes_us, dpps_us,
+        duration_cast<microseconds>(stage_start - init_start).count());
   drmModeFreeResources(resource);
 
   return 0;
@@ -142,6 +170,10 @@ int DRMManager::GetConnectorInfo(uint32_t conn_id, DRMConnectorInfo *info) {
   return conn_mgr_->GetConnectorInfo(conn_id, info);
 }
 
+void DRMManager::InvalidateConnectorInfo(uint32_t conn_id) {
+  conn_mgr_->InvalidateConnectorInfo(conn_id);
+}
+
 int DRMManager::GetConnectorsInfo(DRMConnectorsInfo *infos) {
   *infos = {};
   int ret = -ENODEV;
@@ -316,6 +348,11 @@ void DRMManager::UnregisterDisplay(DRMDisplayToken *token) {
 }
 
 DRMManager::~DRMManager() {
+  for (auto &batch_req : batch_req_pool_) {
+    drmModeAtomicFree(batch_req.first);
+  }
+  batch_req_pool_.clear();
+
   if (conn_mgr_) {
     conn_mgr_->DeInit();
     delete conn_mgr_;
@@ -358,6 +395,110 @@ int DRMManager::DestroyAtomicReq(DRMAtomicReqInterface *intf) {
   return 0;
 }
 
+int DRMManager::CommitAtomicReqs(const std::vector<DRMAtomicReqInterface *> &reqs,
+                                 bool synchronous) {
+  DTRACE_SCOPED();
+  if (reqs.empty()) {
+    return -EINVAL;
+  }
+
+  int num_props = 0;
+  for (auto intf : reqs) {
+    DRMAtomicReq *req = static_cast<DRMAtomicReq *>(intf);
+    req->PrepareCommit(false /* retain_planes */);
+    num_props += drmModeAtomicGetCursor(req->GetAtomicReq());
+  }
+
+  int batch_size = 0;
+  drmModeAtomicReq *batch_req = AcquireBatchReq(num_props, &batch_size);
+  if (!batch_req) {
+    for (auto intf : reqs) {
+      static_cast<DRMAtomicReq *>(intf)->PostCommit(false);
+    }
+    return -ENOMEM;
+  }
+
+  int ret = 0;
+  for (auto intf : reqs) {
+    DRMAtomicReq *req = static_cast<DRMAtomicReq *>(intf);
+    ret = drmModeAtomicMerge(batch_req, req->GetAtomicReq());
+    if (ret) {
+      DRM_LOGE("drmModeAtomicMerge failed with error %d (%s).", ret, strerror(abs(ret)));
+      break;
+    }
+  }
+
+  if (!ret) {
+    uint32_t flags = DRM_MODE_ATOMIC_ALLOW_MODESET;
+    if (!synchronous) {
+      flags |= DRM_MODE_ATOMIC_NONBLOCK;
+    }
+
+    ret = drmModeAtomicCommit(fd_, batch_req, flags, nullptr);
+    if (ret) {
+      DRM_LOGE("drmModeAtomicCommit of %zu displays failed with error %d (%s).", reqs.size(),
+               errno, strerror(errno));
+    }
+  }
+
+  for (auto intf : reqs) {
+    static_cast<DRMAtomicReq *>(intf)->PostCommit(!ret);
+  }
+
+  ReleaseBatchReq(batch_req, batch_size);
+
+  return ret;
+}
+
+drmModeAtomicReq *DRMManager::AcquireBatchReq(int num_props, int *size) {
+  lock_guard<mutex> lock(batch_req_lock_);
+  // Smallest pooled request that fits, else the largest one which then grows
+  auto best = batch_req_pool_.end();
+  for (auto it = batch_req_pool_.begin(); it != batch_req_pool_.end(); it++) {
+    if (best == batch_req_pool_.end()) {
+      best = it;
+    } else if (it->second >= num_props) {
+      if (best->second < num_props || it->second < best->second) {
+        best = it;
+      }
+    } else if (best->second < num_props && it->second > best->second) {
+      best = it;
+    }
+  }
+
+  if (best == batch_req_pool_.end()) {
+    drmModeAtomicReq *req = drmModeAtomicAlloc();
+    if (req && !ReserveAtomicReq(req, num_props)) {
+      *size = num_props;
+    }
+    return req;
+  }
+
+  drmModeAtomicReq *req = best->first;
+  *size = best->second;
+  if (*size < num_props) {
+    batch_req_reallocs_++;
+    DRM_LOGI("Batch request grows to %d properties, %d reallocations", num_props,
+             batch_req_reallocs_);
+    *size = num_props;
+  }
+  batch_req_pool_.erase(best);
+
+  return req;
+}
+
+void DRMManager::ReleaseBatchReq(drmModeAtomicReq *req, int size) {
+  lock_guard<mutex> lock(batch_req_lock_);
+  drmModeAtomicSetCursor(req, 0);
+  // One batch per concurrently committing thread is plenty
+  if (batch_req_pool_.size() >= kMaxPooledBatchReqs) {
+    drmModeAtomicFree(req);
+    return;
+  }
+
+  batch_req_pool_.push_back(std::make_pair(req, size));
+}
+
 int DRMManager::SetScalerLUT(const DRMScalerLUTInfo &lut_info) {
   plane_mgr_->SetScalerLUT(lut_info);
   crtc_mgr_->SetScalerLUT(lut_info);
@@ -31,7 +31,9 @@
 #define __DRM_MANAGER_H__
 
 #include <drm_interface.h>
+#include <xf86drmMode.h>
 #include <mutex>
+#include <vector>
 #include "drm_dpps_mgr_intf.h"
 
 namespace sde_drm {
@@ -55,11 +57,14 @@ class DRMManager : public DRMManagerInterface {
   virtual int GetCrtcInfo(uint32_t crtc_id, DRMCrtcInfo *info);
   virtual int GetConnectorInfo(uint32_t conn_id, DRMConnectorInfo *info);
   virtual int GetConnectorsInfo(DRMConnectorsInfo *infos);
+  virtual void InvalidateConnectorInfo(uint32_t conn_id);
   virtual int GetEncoderInfo(uint32_t encoder_id, DRMEncoderInfo *info);
   virtual int GetEncodersInfo(DRMEncodersInfo *infos);
   virtual void GetCrtcPPInfo(uint32_t crtc_id, DRMPPFeatureInfo *info);
   virtual int CreateAtomicReq(const DRMDisplayToken &token, DRMAtomicReqInterface **intf);
   virtual int DestroyAtomicReq(DRMAtomicReqInterface *intf);
+  virtual int CommitAtomicReqs(const std::vector<DRMAtomicReqInterface *> &reqs,
+                               bool synchronous);
   virtual int SetScalerLUT(const DRMScalerLUTInfo &lut_info);
   virtual int UnsetScalerLUT();
   virtual void GetDppsFeatureInfo(DRMDppsFeatureInfo *info);
@@ -75,6 +80,10 @@ class DRMManager : public DRMManagerInterface {
 
  private:
   int Init(int drm_fd);
+  // Batch requests of CommitAtomicReqs are pooled, so that merging into them does not reallocate
+  // once they have grown to the size of the usual batches
+  drmModeAtomicReq *AcquireBatchReq(int num_props, int *size);
+  void ReleaseBatchReq(drmModeAtomicReq *req, int size);
 
   int fd_ = -1;
   DRMPlaneManager *plane_mgr_ = {};
@@ -82,6 +91,10 @@ class DRMManager : public DRMManagerInterface {
   DRMEncoderManager *encoder_mgr_ = {};
   DRMCrtcManager *crtc_mgr_ = {};
   DRMDppsManagerIntf *dpps_mgr_intf_ = {};
+  static const size_t kMaxPooledBatchReqs = 4;
+  std::mutex batch_req_lock_;
+  std::vector<std::pair<drmModeAtomicReq *, int>> batch_req_pool_;  // Request and its size
+  uint32_t batch_req_reallocs_ = 0;
 
   static DRMManager *s_drm_instance;
   static std::mutex s_lock;
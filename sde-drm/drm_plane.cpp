@@ -308,6 +308,22 @@ void DRMPlaneManager::Perform(DRMOps code, uint32_t obj_id, drmModeAtomicReq *re
   it->second->Perform(code, req, args);
 }
 
+void DRMPlaneManager::SetState(uint32_t obj_id, drmModeAtomicReq *req,
+                               const DRMPlaneState &state) {
+  auto it = plane_pool_.find(obj_id);
+  if (it == plane_pool_.end()) {
+    DRM_LOGE("Invalid plane id %d", obj_id);
+    return;
+  }
+
+  if (state.scaler && it->second->ConfigureScalerLUT(req, dir_lut_blob_id_, cir_lut_blob_id_,
+                                                     sep_lut_blob_id_)) {
+    DRM_LOGD("Plane %d: Configuring scaler LUTs", obj_id);
+  }
+
+  it->second->SetState(req, state);
+}
+
 void DRMPlaneManager::Perform(DRMOps code, drmModeAtomicReq *req, uint32_t obj_id, ...) {
   lock_guard<mutex> lock(lock_);
   va_list args;
@@ -376,32 +392,23 @@ void DRMPlaneManager::PostCommit(uint32_t crtc_id, bool success) {
 
 void DRMPlaneManager::SetScalerLUT(const DRMScalerLUTInfo &lut_info) {
   if (lut_info.dir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut),
-                              lut_info.dir_lut_size, &dir_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut), lut_info.dir_lut_size,
+                    &dir_lut_, &dir_lut_blob_id_);
   }
   if (lut_info.cir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut),
-                              lut_info.cir_lut_size, &cir_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut), lut_info.cir_lut_size,
+                    &cir_lut_, &cir_lut_blob_id_);
   }
   if (lut_info.sep_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut),
-                              lut_info.sep_lut_size, &sep_lut_blob_id_);
+    SetPropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut), lut_info.sep_lut_size,
+                    &sep_lut_, &sep_lut_blob_id_);
   }
 }
 
 void DRMPlaneManager::UnsetScalerLUT() {
-  if (dir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, dir_lut_blob_id_);
-    dir_lut_blob_id_ = 0;
-  }
-  if (cir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, cir_lut_blob_id_);
-    cir_lut_blob_id_ = 0;
-  }
-  if (sep_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, sep_lut_blob_id_);
-    sep_lut_blob_id_ = 0;
-  }
+  DestroyPropertyBlob(fd_, &dir_lut_, &dir_lut_blob_id_);
+  DestroyPropertyBlob(fd_, &cir_lut_, &cir_lut_blob_id_);
+  DestroyPropertyBlob(fd_, &sep_lut_, &sep_lut_blob_id_);
 }
 
 // ==============================================================================================//
@@ -777,6 +784,146 @@ void DRMPlane::PostCommit(uint32_t crtc_id, bool success) {
   }
 }
 
+void DRMPlane::SetSrcRect(drmModeAtomicReq *req, const DRMRect &rect) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  // source co-ordinates accepted by DRM are 16.16 fixed point
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_X);
+  AddProperty(req, obj_id, prop_id, rect.left << 16, true /* cache */, tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_Y);
+  AddProperty(req, obj_id, prop_id, rect.top << 16, true /* cache */, tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_W);
+  AddProperty(req, obj_id, prop_id, (rect.right - rect.left) << 16, true /* cache */,
+              tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_H);
+  AddProperty(req, obj_id, prop_id, (rect.bottom - rect.top) << 16, true /* cache */,
+              tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting crop [x,y,w,h][%d,%d,%d,%d]", obj_id, rect.left,
+           rect.top, (rect.right - rect.left), (rect.bottom - rect.top));
+}
+
+void DRMPlane::SetDstRect(drmModeAtomicReq *req, const DRMRect &rect) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_X);
+  AddProperty(req, obj_id, prop_id, rect.left, true /* cache */, tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_Y);
+  AddProperty(req, obj_id, prop_id, rect.top, true /* cache */, tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_W);
+  AddProperty(req, obj_id, prop_id, (rect.right - rect.left), true /* cache */,
+              tmp_prop_val_map_);
+  prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_H);
+  AddProperty(req, obj_id, prop_id, (rect.bottom - rect.top), true /* cache */,
+              tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting dst [x,y,w,h][%d,%d,%d,%d]", obj_id, rect.left,
+           rect.top, (rect.right - rect.left), (rect.bottom - rect.top));
+}
+
+void DRMPlane::SetZorder(drmModeAtomicReq *req, uint32_t zpos) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::ZPOS);
+  AddProperty(req, obj_id, prop_id, zpos, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGD("Plane %d: Setting z %d", obj_id, zpos);
+}
+
+void DRMPlane::SetRotation(drmModeAtomicReq *req, uint32_t rot_bit_mask) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t drm_rot_bit_mask = 0;
+  if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::FLIP_H)) {
+    drm_rot_bit_mask |= 1 << REFLECT_X;
+  }
+  if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::FLIP_V)) {
+    drm_rot_bit_mask |= 1 << REFLECT_Y;
+  }
+  if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::ROT_90)) {
+    drm_rot_bit_mask |= 1 << ROTATE_90;
+  } else {
+    drm_rot_bit_mask |= 1 << ROTATE_0;
+  }
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::ROTATION);
+  AddProperty(req, obj_id, prop_id, drm_rot_bit_mask, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting rotation mask %x", obj_id, drm_rot_bit_mask);
+}
+
+void DRMPlane::SetAlpha(drmModeAtomicReq *req, uint32_t alpha) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::ALPHA);
+  AddProperty(req, obj_id, prop_id, alpha, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting alpha %d", obj_id, alpha);
+}
+
+void DRMPlane::SetBlendType(drmModeAtomicReq *req, uint32_t blending) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::BLEND_OP);
+  AddProperty(req, obj_id, prop_id, blending, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting blending %d", obj_id, blending);
+}
+
+void DRMPlane::SetSrcConfig(drmModeAtomicReq *req, uint32_t src_config) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_CONFIG);
+  AddProperty(req, obj_id, prop_id, src_config, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGV("Plane %d: Setting src_config flags-%x", obj_id, src_config);
+}
+
+void DRMPlane::SetFbSecureMode(drmModeAtomicReq *req, int secure_mode) {
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t fb_secure_mode = NON_SECURE;
+  switch (secure_mode) {
+    case (int)DRMSecureMode::NON_SECURE:
+      fb_secure_mode = NON_SECURE;
+      break;
+    case (int)DRMSecureMode::SECURE:
+      fb_secure_mode = SECURE;
+      break;
+    case (int)DRMSecureMode::NON_SECURE_DIR_TRANSLATION:
+      fb_secure_mode = NON_SECURE_DIR_TRANSLATION;
+      break;
+    case (int)DRMSecureMode::SECURE_DIR_TRANSLATION:
+      fb_secure_mode = SECURE_DIR_TRANSLATION;
+      break;
+    default:
+      DRM_LOGE("Invalid secure mode %d to set on plane %d", secure_mode, obj_id);
+      break;
+  }
+
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::FB_TRANSLATION_MODE);
+  AddProperty(req, obj_id, prop_id, fb_secure_mode, true /* cache */, tmp_prop_val_map_);
+  DRM_LOGD("Plane %d: Setting FB secure mode %d", obj_id, fb_secure_mode);
+}
+
+void DRMPlane::SetSsppLayout(drmModeAtomicReq *req, DRMSSPPLayoutIndex layout_index) {
+  if (!prop_mgr_.IsPropertyAvailable(DRMProperty::SDE_SSPP_LAYOUT)) {
+    DRM_LOGD("SSPP_LAYOUT property isn't exposed");
+    return;
+  }
+  uint32_t obj_id = drm_plane_->plane_id;
+  uint32_t prop_id = prop_mgr_.GetPropertyId(DRMProperty::SDE_SSPP_LAYOUT);
+  AddProperty(req, obj_id, prop_id, (uint32_t)layout_index , true /* cache */,
+              tmp_prop_val_map_);
+  DRM_LOGD("Plane %d: Setting SSPP Layout to %d", obj_id, layout_index);
+}
+
+// Same properties in the same order as the PLANE_SET_* ops of HWDeviceDRM used, without
+// unpacking each of them from a va_list.
+void DRMPlane::SetState(drmModeAtomicReq *req, const DRMPlaneState &state) {
+  SetAlpha(req, state.alpha);
+  SetZorder(req, state.z_order);
+  SetBlendType(req, static_cast<uint32_t>(state.blending));
+  SetSrcRect(req, state.src);
+  SetDstRect(req, state.dst);
+  SetSsppLayout(req, state.layout_index);
+  SetExclRect(req, state.excl);
+  SetRotation(req, state.rotation);
+  SetDecimation(req, prop_mgr_.GetPropertyId(DRMProperty::H_DECIMATE), state.h_decimation);
+  SetDecimation(req, prop_mgr_.GetPropertyId(DRMProperty::V_DECIMATE), state.v_decimation);
+  SetFbSecureMode(req, static_cast<int>(state.fb_secure_mode));
+  SetSrcConfig(req, state.src_config);
+  if (state.scaler && SetScalerConfig(req, state.scaler)) {
+    DRM_LOGV("Plane %d: Setting scaler config", drm_plane_->plane_id);
+  }
+  SetCscConfig(req, state.csc_type);
+  SetMultiRectMode(req, state.multirect_mode);
+}
+
 void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
   uint32_t prop_id = 0;
   uint32_t obj_id = drm_plane_->plane_id;
@@ -784,36 +931,11 @@ void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
   switch (code) {
     // TODO(user): Check if these exist in map before attempting to access
     case DRMOps::PLANE_SET_SRC_RECT: {
-      DRMRect rect = va_arg(args, DRMRect);
-      // source co-ordinates accepted by DRM are 16.16 fixed point
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_X);
-      AddProperty(req, obj_id, prop_id, rect.left << 16, true /* cache */, tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_Y);
-      AddProperty(req, obj_id, prop_id, rect.top << 16, true /* cache */, tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_W);
-      AddProperty(req, obj_id, prop_id, (rect.right - rect.left) << 16, true /* cache */,
-                  tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_H);
-      AddProperty(req, obj_id, prop_id, (rect.bottom - rect.top) << 16, true /* cache */,
-                  tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting crop [x,y,w,h][%d,%d,%d,%d]", obj_id, rect.left,
-               rect.top, (rect.right - rect.left), (rect.bottom - rect.top));
+      SetSrcRect(req, va_arg(args, DRMRect));
     } break;
 
     case DRMOps::PLANE_SET_DST_RECT: {
-      DRMRect rect = va_arg(args, DRMRect);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_X);
-      AddProperty(req, obj_id, prop_id, rect.left, true /* cache */, tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_Y);
-      AddProperty(req, obj_id, prop_id, rect.top, true /* cache */, tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_W);
-      AddProperty(req, obj_id, prop_id, (rect.right - rect.left), true /* cache */,
-                  tmp_prop_val_map_);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::CRTC_H);
-      AddProperty(req, obj_id, prop_id, (rect.bottom - rect.top), true /* cache */,
-                  tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting dst [x,y,w,h][%d,%d,%d,%d]", obj_id, rect.left,
-               rect.top, (rect.right - rect.left), (rect.bottom - rect.top));
+      SetDstRect(req, va_arg(args, DRMRect));
     } break;
     case DRMOps::PLANE_SET_EXCL_RECT: {
       DRMRect excl_rect = va_arg(args, DRMRect);
@@ -821,43 +943,19 @@ void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
     } break;
 
     case DRMOps::PLANE_SET_ZORDER: {
-      uint32_t zpos = va_arg(args, uint32_t);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::ZPOS);
-      AddProperty(req, obj_id, prop_id, zpos, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGD("Plane %d: Setting z %d", obj_id, zpos);
+      SetZorder(req, va_arg(args, uint32_t));
     } break;
 
     case DRMOps::PLANE_SET_ROTATION: {
-      uint32_t rot_bit_mask = va_arg(args, uint32_t);
-      uint32_t drm_rot_bit_mask = 0;
-      if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::FLIP_H)) {
-        drm_rot_bit_mask |= 1 << REFLECT_X;
-      }
-      if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::FLIP_V)) {
-        drm_rot_bit_mask |= 1 << REFLECT_Y;
-      }
-      if (rot_bit_mask & static_cast<uint32_t>(DRMRotation::ROT_90)) {
-        drm_rot_bit_mask |= 1 << ROTATE_90;
-      } else {
-        drm_rot_bit_mask |= 1 << ROTATE_0;
-      }
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::ROTATION);
-      AddProperty(req, obj_id, prop_id, drm_rot_bit_mask, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting rotation mask %x", obj_id, drm_rot_bit_mask);
+      SetRotation(req, va_arg(args, uint32_t));
     } break;
 
     case DRMOps::PLANE_SET_ALPHA: {
-      uint32_t alpha = va_arg(args, uint32_t);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::ALPHA);
-      AddProperty(req, obj_id, prop_id, alpha, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting alpha %d", obj_id, alpha);
+      SetAlpha(req, va_arg(args, uint32_t));
     } break;
 
     case DRMOps::PLANE_SET_BLEND_TYPE: {
-      uint32_t blending = va_arg(args, uint32_t);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::BLEND_OP);
-      AddProperty(req, obj_id, prop_id, blending, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting blending %d", obj_id, blending);
+      SetBlendType(req, va_arg(args, uint32_t));
     } break;
 
     case DRMOps::PLANE_SET_H_DECIMATION: {
@@ -874,9 +972,7 @@ void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
 
     case DRMOps::PLANE_SET_SRC_CONFIG: {
       bool src_config = va_arg(args, uint32_t);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SRC_CONFIG);
-      AddProperty(req, obj_id, prop_id, src_config, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGV("Plane %d: Setting src_config flags-%x", obj_id, src_config);
+      SetSrcConfig(req, src_config);
     } break;
 
     case DRMOps::PLANE_SET_CRTC: {
@@ -916,29 +1012,7 @@ void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
     } break;
 
     case DRMOps::PLANE_SET_FB_SECURE_MODE: {
-      int secure_mode = va_arg(args, int);
-      uint32_t fb_secure_mode = NON_SECURE;
-      switch (secure_mode) {
-        case (int)DRMSecureMode::NON_SECURE:
-          fb_secure_mode = NON_SECURE;
-          break;
-        case (int)DRMSecureMode::SECURE:
-          fb_secure_mode = SECURE;
-          break;
-        case (int)DRMSecureMode::NON_SECURE_DIR_TRANSLATION:
-          fb_secure_mode = NON_SECURE_DIR_TRANSLATION;
-          break;
-        case (int)DRMSecureMode::SECURE_DIR_TRANSLATION:
-          fb_secure_mode = SECURE_DIR_TRANSLATION;
-          break;
-        default:
-          DRM_LOGE("Invalid secure mode %d to set on plane %d", secure_mode, obj_id);
-          break;
-      }
-
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::FB_TRANSLATION_MODE);
-      AddProperty(req, obj_id, prop_id, fb_secure_mode, true /* cache */, tmp_prop_val_map_);
-      DRM_LOGD("Plane %d: Setting FB secure mode %d", obj_id, fb_secure_mode);
+      SetFbSecureMode(req, va_arg(args, int));
     } break;
 
     case DRMOps::PLANE_SET_CSC_CONFIG: {
@@ -977,15 +1051,7 @@ void DRMPlane::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
     } break;
 
     case DRMOps::PLANE_SET_SSPP_LAYOUT: {
-      if (!prop_mgr_.IsPropertyAvailable(DRMProperty::SDE_SSPP_LAYOUT)) {
-        DRM_LOGD("SSPP_LAYOUT property isn't exposed");
-        break;
-      }
-      DRMSSPPLayoutIndex layout_index = (DRMSSPPLayoutIndex) va_arg(args, uint32_t);
-      prop_id = prop_mgr_.GetPropertyId(DRMProperty::SDE_SSPP_LAYOUT);
-      AddProperty(req, obj_id, prop_id, (uint32_t)layout_index , true /* cache */,
-                  tmp_prop_val_map_);
-      DRM_LOGD("Plane %d: Setting SSPP Layout to %d", obj_id, layout_index);
+      SetSsppLayout(req, (DRMSSPPLayoutIndex) va_arg(args, uint32_t));
     } break;
 
     default:
@@ -39,6 +39,7 @@
 #include <string>
 #include <tuple>
 #include <mutex>
+#include <vector>
 
 #include "drm_property.h"
 #include "drm_pp_manager.h"
@@ -73,6 +74,16 @@ class DRMPlane {
   const DRMPlaneTypeInfo& GetPlaneTypeInfo() { return plane_type_info_; }
   void SetDecimation(drmModeAtomicReq *req, uint32_t prop_id, uint32_t prop_value);
   void SetExclRect(drmModeAtomicReq *req, DRMRect rect);
+  void SetSrcRect(drmModeAtomicReq *req, const DRMRect &rect);
+  void SetDstRect(drmModeAtomicReq *req, const DRMRect &rect);
+  void SetZorder(drmModeAtomicReq *req, uint32_t zpos);
+  void SetRotation(drmModeAtomicReq *req, uint32_t rot_bit_mask);
+  void SetAlpha(drmModeAtomicReq *req, uint32_t alpha);
+  void SetBlendType(drmModeAtomicReq *req, uint32_t blending);
+  void SetSrcConfig(drmModeAtomicReq *req, uint32_t src_config);
+  void SetFbSecureMode(drmModeAtomicReq *req, int secure_mode);
+  void SetSsppLayout(drmModeAtomicReq *req, DRMSSPPLayoutIndex layout_index);
+  void SetState(drmModeAtomicReq *req, const DRMPlaneState &state);
   void Perform(DRMOps code, drmModeAtomicReq *req, va_list args);
   void Dump();
   void SetMultiRectMode(drmModeAtomicReq *req, DRMMultiRectMode drm_multirect_mode);
@@ -126,6 +137,7 @@ class DRMPlaneManager {
   void DumpAll();
   void DumpByID(uint32_t id);
   void Perform(DRMOps code, uint32_t obj_id, drmModeAtomicReq *req, va_list args);
+  void SetState(uint32_t obj_id, drmModeAtomicReq *req, const DRMPlaneState &state);
   void UnsetUnusedResources(uint32_t crtc_id, bool is_commit, drmModeAtomicReq *req);
   void ResetColorLutsOnUsedPlanes(uint32_t crtc_id, bool is_commit, drmModeAtomicReq *req);
   void RetainPlanes(uint32_t crtc_id);
@@ -140,10 +152,13 @@ class DRMPlaneManager {
   int fd_ = -1;
   // Map of plane id to DRMPlane *
   std::map<uint32_t, std::unique_ptr<DRMPlane>> plane_pool_{};
-  // Global Scaler LUT blobs
+  // Global Scaler LUT blobs, and the LUTs they were created from
   uint32_t dir_lut_blob_id_ = 0;
   uint32_t cir_lut_blob_id_ = 0;
   uint32_t sep_lut_blob_id_ = 0;
+  std::vector<uint8_t> dir_lut_ = {};
+  std::vector<uint8_t> cir_lut_ = {};
+  std::vector<uint8_t> sep_lut_ = {};
   std::mutex lock_;
 };
 
@@ -0,0 +1,171 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Sets up the planes of a display the way HWDeviceDRM does for each frame, once through one
+// Perform() per PLANE_SET_* op and once through SetPlaneState(), and reports the CPU cost of each
+// per plane. The geometry changes on every round so that no property is skipped as unchanged.
+// The request is rewound after each round and never committed, so the display is not touched.
+//
+// Usage: sde_drm_plane_benchmark [iterations]
+
+#include <drm_master.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xf86drmMode.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "drm_atomic_req.h"
+#include "drm_manager.h"
+
+namespace sde_drm {
+
+static uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static DRMPlaneState GetState(uint32_t index, uint32_t round) {
+  uint32_t shift = round & 1;
+  DRMPlaneState state;
+  state.alpha = 0xff - shift;
+  state.z_order = index + shift;
+  state.blending = shift ? DRMBlendType::COVERAGE : DRMBlendType::PREMULTIPLIED;
+  state.src = {0, 0, 256 + shift, 256};
+  state.dst = {index * 8 + shift, 0, index * 8 + shift + 256, 256};
+  state.excl = {0, 0, shift, shift};
+  state.rotation = shift ? static_cast<uint32_t>(DRMRotation::FLIP_H) : 0;
+  state.src_config = 0;
+  state.csc_type = kCscTypeMax;
+  return state;
+}
+
+static void PerformState(DRMAtomicReqInterface *req, uint32_t plane_id,
+                         const DRMPlaneState &state) {
+  req->Perform(DRMOps::PLANE_SET_ALPHA, plane_id, state.alpha);
+  req->Perform(DRMOps::PLANE_SET_ZORDER, plane_id, state.z_order);
+  req->Perform(DRMOps::PLANE_SET_BLEND_TYPE, plane_id, state.blending);
+  req->Perform(DRMOps::PLANE_SET_SRC_RECT, plane_id, state.src);
+  req->Perform(DRMOps::PLANE_SET_DST_RECT, plane_id, state.dst);
+  req->Perform(DRMOps::PLANE_SET_SSPP_LAYOUT, plane_id, state.layout_index);
+  req->Perform(DRMOps::PLANE_SET_EXCL_RECT, plane_id, state.excl);
+  req->Perform(DRMOps::PLANE_SET_ROTATION, plane_id, state.rotation);
+  req->Perform(DRMOps::PLANE_SET_H_DECIMATION, plane_id, state.h_decimation);
+  req->Perform(DRMOps::PLANE_SET_V_DECIMATION, plane_id, state.v_decimation);
+  req->Perform(DRMOps::PLANE_SET_FB_SECURE_MODE, plane_id, state.fb_secure_mode);
+  req->Perform(DRMOps::PLANE_SET_SRC_CONFIG, plane_id, state.src_config);
+  req->Perform(DRMOps::PLANE_SET_CSC_CONFIG, plane_id, &state.csc_type);
+  req->Perform(DRMOps::PLANE_SET_MULTIRECT_MODE, plane_id, state.multirect_mode);
+}
+
+static int Run(uint32_t iterations) {
+  drm_utils::DRMMaster *master = nullptr;
+  int fd = -1;
+  if (drm_utils::DRMMaster::GetInstance(&master) < 0) {
+    fprintf(stderr, "Unable to open the DRM device\n");
+    return -1;
+  }
+  master->GetHandle(&fd);
+
+  DRMManager *drm_mgr = DRMManager::GetInstance(fd);
+  if (!drm_mgr) {
+    fprintf(stderr, "Unable to initialize the DRM manager\n");
+    return -1;
+  }
+
+  DRMPlanesInfo planes_info;
+  drm_mgr->GetPlanesInfo(&planes_info);
+  std::vector<uint32_t> planes;
+  for (auto &plane : planes_info) {
+    if (plane.second.type == DRMPlaneType::VIG || plane.second.type == DRMPlaneType::DMA) {
+      planes.push_back(plane.first);
+    }
+  }
+
+  DRMDisplayToken token = {};
+  DRMAtomicReqInterface *req = nullptr;
+  if (planes.empty() || drm_mgr->RegisterDisplay(DRMDisplayType::PERIPHERAL, &token) ||
+      drm_mgr->CreateAtomicReq(token, &req)) {
+    fprintf(stderr, "Unable to set up a request for a built-in display\n");
+    DRMManager::Destroy();
+    return -1;
+  }
+  drmModeAtomicReq *atomic_req = static_cast<DRMAtomicReq *>(req)->GetAtomicReq();
+  int cursor = drmModeAtomicGetCursor(atomic_req);
+
+  uint64_t perform_ns = 0;
+  uint64_t state_ns = 0;
+  uint64_t perform_props = 0;
+  uint64_t state_props = 0;
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    uint64_t start_ns = NowNs();
+    for (uint32_t i = 0; i < planes.size(); i++) {
+      PerformState(req, planes.at(i), GetState(i, 2 * iteration));
+    }
+    perform_ns += NowNs() - start_ns;
+    perform_props += static_cast<uint64_t>(drmModeAtomicGetCursor(atomic_req) - cursor);
+    drmModeAtomicSetCursor(atomic_req, cursor);
+
+    start_ns = NowNs();
+    for (uint32_t i = 0; i < planes.size(); i++) {
+      req->SetPlaneState(planes.at(i), GetState(i, 2 * iteration + 1));
+    }
+    state_ns += NowNs() - start_ns;
+    state_props += static_cast<uint64_t>(drmModeAtomicGetCursor(atomic_req) - cursor);
+    drmModeAtomicSetCursor(atomic_req, cursor);
+  }
+
+  drm_mgr->DestroyAtomicReq(req);
+  drm_mgr->UnregisterDisplay(&token);
+  DRMManager::Destroy();
+
+  uint64_t plane_count = static_cast<uint64_t>(planes.size()) * iterations;
+  printf("%zu planes x %u iterations\n", planes.size(), iterations);
+  printf("%-16s %12s %12s\n", "path", "ns/plane", "props/plane");
+  printf("%-16s %12" PRIu64 " %12" PRIu64 "\n", "Perform", perform_ns / plane_count,
+         perform_props / plane_count);
+  printf("%-16s %12" PRIu64 " %12" PRIu64 "\n", "SetPlaneState", state_ns / plane_count,
+         state_props / plane_count);
+
+  return 0;
+}
+
+}  // namespace sde_drm
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 1000;
+  if (argc > 1) {
+    iterations = static_cast<uint32_t>(std::max(1, atoi(argv[1])));
+  }
+
+  return (sde_drm::Run(iterations) == 0) ? 0 : 1;
+}
@@ -39,6 +39,7 @@
 #include <map>
 #include <string>
 
+#include "drm_blob_cache.h"
 #include "drm_pp_manager.h"
 #include "drm_property.h"
 
@@ -56,7 +57,7 @@ DRMPPManager::~DRMPPManager() {
   for (int i = 0; i < kPPFeaturesMax; i++) {
     prop_info = pp_prop_map_[i];
     if (prop_info.blob_id > 0) {
-      drmModeDestroyPropertyBlob(fd_, prop_info.blob_id);
+      DRMBlobCache::GetInstance()->Release(fd_, prop_info.blob_id);
       prop_info.blob_id = 0;
     }
   }
@@ -234,15 +235,10 @@ int DRMPPManager::SetPPBlobProperty(drmModeAtomicReq *req, uint32_t obj_id,
 #ifdef PP_DRM_ENABLE
   uint32_t blob_id = 0;
 
-  /* free previously created blob for this feature if exist */
+  /* release previously created blob for this feature if exist */
   if (prop_info->blob_id > 0) {
-    ret = drmModeDestroyPropertyBlob(fd_, prop_info->blob_id);
-    if (ret) {
-      DRM_LOGE("failed to destroy property blob for feature %d, ret = %d", feature.id, ret);
-      return ret;
-    } else {
-      prop_info->blob_id = 0;
-    }
+    DRMBlobCache::GetInstance()->Release(fd_, prop_info->blob_id);
+    prop_info->blob_id = 0;
   }
 
   if (!feature.payload) {
@@ -251,12 +247,13 @@ int DRMPPManager::SetPPBlobProperty(drmModeAtomicReq *req, uint32_t obj_id,
     return 0;
   }
 
-  ret = drmModeCreatePropertyBlob(fd_, feature.payload, feature.payload_size, &blob_id);
-  if (ret || blob_id == 0) {
-    DRM_LOGE("failed to create property blob ret %d, blob_id = %d", ret, blob_id);
+  blob_id = DRMBlobCache::GetInstance()->Acquire(fd_, feature.payload, feature.payload_size);
+  if (blob_id == 0) {
+    DRM_LOGE("failed to create property blob for feature %d", feature.id);
     return DRM_ERR_INVALID;
   }
 
+  ret = 0;
   prop_info->blob_id = blob_id;
   drmModeAtomicAddProperty(req, obj_id, prop_info->prop_id, blob_id);
 
@@ -29,6 +29,7 @@
 
 #include <drm/drm_fourcc.h>
 #include <drm_utils.h>
+#include <string.h>
 #include <regex>
 #include <sstream>
 #include <sstream>
@@ -115,4 +116,47 @@ void AddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_
 #endif
 }
 
+int ReserveAtomicReq(drmModeAtomicReqPtr req, int num_props) {
+  // libdrm has no reserve call, fill with placeholders and rewind. A request is only sent up to
+  // its cursor, so the placeholders are never seen by the kernel.
+  int cursor = drmModeAtomicGetCursor(req);
+  for (int i = cursor; i < num_props; i++) {
+    int ret = drmModeAtomicAddProperty(req, 0, 0, 0);
+    if (ret < 0) {
+      drmModeAtomicSetCursor(req, cursor);
+      return ret;
+    }
+  }
+  drmModeAtomicSetCursor(req, cursor);
+
+  return 0;
+}
+
+int SetPropertyBlob(int fd, const void *data, uint32_t size, vector<uint8_t> *contents,
+                    uint32_t *blob_id) {
+  if (*blob_id && contents->size() == size && !memcmp(contents->data(), data, size)) {
+    return 0;
+  }
+
+  DestroyPropertyBlob(fd, contents, blob_id);
+  int ret = drmModeCreatePropertyBlob(fd, data, size, blob_id);
+  if (ret) {
+    *blob_id = 0;
+    return ret;
+  }
+
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  contents->assign(bytes, bytes + size);
+
+  return 0;
+}
+
+void DestroyPropertyBlob(int fd, vector<uint8_t> *contents, uint32_t *blob_id) {
+  if (*blob_id) {
+    drmModeDestroyPropertyBlob(fd, *blob_id);
+    *blob_id = 0;
+  }
+  contents->clear();
+}
+
 }  // namespace sde_drm
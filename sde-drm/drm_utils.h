@@ -49,6 +49,13 @@ void ParseFormats(const std::string &line, std::vector<std::pair<uint32_t, uint6
 void Tokenize(const std::string &str, std::vector<std::string> *tokens, char delim);
 void AddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value,
                  bool cache, std::unordered_map<uint32_t, uint64_t> &prop_val_map);
+// Grows an empty request to hold num_props properties, so that adding them does not reallocate
+int ReserveAtomicReq(drmModeAtomicReqPtr req, int num_props);
+// Points *blob_id at a property blob holding size bytes from data. The blob of a previous call is
+// kept when *contents shows it holds the same bytes, and destroyed otherwise.
+int SetPropertyBlob(int fd, const void *data, uint32_t size, std::vector<uint8_t> *contents,
+                    uint32_t *blob_id);
+void DestroyPropertyBlob(int fd, std::vector<uint8_t> *contents, uint32_t *blob_id);
 
 }  // namespace sde_drm
 
@@ -56,6 +56,9 @@ struct BufferConfig {
   bool secure_camera = false;                 //!< Specifies buffer to be allocated from specific
                                               //!< secure heap and with a specific alignment.
   bool gfx_client = false;                    //!< Specifies whether buffer is used by gfx.
+  bool prefer_compression = false;            //!< Specifies whether the compressed variant of
+                                              //!< format may be allocated, when every consumer
+                                              //!< of the buffer supports it.
 };
 
 /*! @brief Holds the information about the allocated buffer.
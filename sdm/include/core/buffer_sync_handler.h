@@ -112,6 +112,19 @@ class BufferSyncHandler {
  */
   virtual void GetSyncInfo(int fd, std::ostringstream *os) = 0;
 
+  /*! @brief Method to tell the signaler of a sync fd when it needs to be signaled
+
+    @details This method passes a deadline to the drivers behind the fences of the sync fd, so
+    that they can raise their clocks when the deadline is at risk. It is a hint only, a driver
+    without support ignores it. It is responsibility of the caller to close file descriptor.
+
+    @param[in] fd file descriptor
+    @param[in] deadline_ns CLOCK_MONOTONIC time by which the fd is needed
+
+    @return \link DisplayError \endlink
+ */
+  virtual DisplayError SyncSetDeadline(int fd, uint64_t deadline_ns) { return kErrorNotSupported; }
+
  protected:
   virtual ~BufferSyncHandler() { }
 };
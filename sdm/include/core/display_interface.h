@@ -185,6 +185,12 @@ enum FrameTriggerMode {
   kFrameTriggerMax,
 };
 
+/*! @brief This enum defines the amount of detail in a display state dump. */
+enum DumpLevel {
+  kDumpLevelFull,  //!< Display state along with the per layer composition details
+  kDumpLevelPerf,  //!< Display state and statistics only, cheap enough for periodic monitoring
+};
+
 /*! @brief This structure defines configuration for fixed properties of a display device.
 
   @sa DisplayInterface::GetConfig
@@ -855,9 +861,9 @@ class DisplayInterface {
 
   /*
    * Returns a string consisting of a dump of SDM's display and layer related state
-   * as programmed to driver
+   * as programmed to driver, limited to the given \link DumpLevel \endlink
   */
-  virtual std::string Dump() = 0;
+  virtual std::string Dump(DumpLevel level = kDumpLevelFull) = 0;
 
   /*! @brief Method to dynamically set DSI clock rate.
 
@@ -883,6 +889,15 @@ class DisplayInterface {
   */
   virtual DisplayError GetSupportedDSIClock(std::vector<uint64_t> *bitclk_rates) = 0;
 
+  /*! @brief Method to set the DSI clock rates the display must not use, e.g. to avoid RF
+      interference, and to hand the choice among the others back to the display.
+
+      @param[in] avoided_rates DSI bit clock rates in HZ to avoid.
+
+      @return \link DisplayError \endlink
+  */
+  virtual DisplayError SetDSIClockConstraints(const std::vector<uint64_t> &avoided_rates) = 0;
+
   /*! @brief Method to retrieve the EDID information and HW port ID for display
 
     @param[out] HW port ID
@@ -940,6 +955,34 @@ class DisplayInterface {
   */
   virtual DisplayError GetQSyncMode(QSyncMode *qsync_mode) = 0;
 
+  /*! @brief Method to request fb_id creation for the current buffer of a layer ahead of the
+    next Prepare/Commit, so that it does not happen on the commit path.
+
+    @param[in] layer \link Layer \endlink whose input buffer was updated.
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError PrefetchFbId(Layer *layer) = 0;
+
+  /*! @brief Method to get the next vsync predicted from the recent hardware vsync timestamps.
+    Predictions stay available for a while after hardware vsync has been disabled.
+
+    @param[out] next_vsync_ns CLOCK_MONOTONIC time of the first vsync after now.
+    @param[out] vsync_period_ns Measured vsync period in nanoseconds.
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError GetPredictedVSync(int64_t *next_vsync_ns, int64_t *vsync_period_ns) = 0;
+
+  /*! @brief Method to notify the time at which the next frame is expected to be presented. Lets
+    the display leave low power states such as idle power collapse ahead of the frame.
+
+    @param[in] expected_present_ns CLOCK_MONOTONIC time the next frame is expected on screen.
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError SetExpectedPresentTime(uint64_t expected_present_ns) = 0;
+
  protected:
   virtual ~DisplayInterface() { }
 };
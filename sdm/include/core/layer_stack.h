@@ -40,6 +40,7 @@
 #include <unordered_map>
 #include <memory>
 #include <bitset>
+#include <list>
 
 #include "layer_buffer.h"
 #include "sdm_types.h"
@@ -124,6 +125,7 @@ enum LayerUpdate {
   kSurfaceInvalidate,
   kClientCompRequest,
   kColorTransformUpdate,
+  kLuminanceScaleUpdate,
   kLayerUpdateMax,
 };
 
@@ -340,6 +342,7 @@ struct LayerSolidFill {
 
 struct LayerBufferMap {
   std::unordered_map<uint64_t, std::shared_ptr<LayerBufferObject>> buffer_map;
+  std::list<uint64_t> lru_list;  //!< handle_ids of buffer_map, most recently used first.
 };
 
 /*! @brief This structure defines display layer object which contains layer properties and a drawing
@@ -416,6 +419,8 @@ struct Layer {
                                                               0.0, 1.0, 0.0, 0.0,
                                                               0.0, 0.0, 1.0, 0.0,
                                                               0.0, 0.0, 0.0, 1.0 };
+  float luminance_scale = 1.0f;                    //!< Scale applied to the luminance of the
+                                                   //!< layer, 1.0 leaves it as is.
   std::bitset<kLayerUpdateMax> update_mask = 0;
 };
 
@@ -462,6 +467,11 @@ struct LayerStack {
 
   PrimariesTransfer blend_cs = {};     //!< o/p - Blending color space of the frame, updated by SDM
 
+  uint32_t qos_clock_hz = 0;           //!< o/p - Core clock voted for the frame, updated by SDM
+
+  uint64_t qos_dram_ib_bps = 0;        //!< o/p - DRAM instantaneous bandwidth voted for the frame,
+                                       //!< updated by SDM
+
   uint64_t elapse_timestamp = 0;       //!< system time until which display commit needs to be held
 };
 
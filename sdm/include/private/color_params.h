@@ -192,6 +192,10 @@ struct PPHWAttributes : HWResourceInfo, HWPanelInfo, DisplayConfigVariableInfo {
   char panel_name[256] = "generic_panel";
   PPFeatureVersion version;
   DppsControlInterface *dpps_intf = NULL;
+  // Calibration of the panel mapped from its blob, see qdcm_calib_blob.h. NULL when the color
+  // library has to parse the XML itself.
+  const void *calib_blob = NULL;
+  size_t calib_blob_size = 0;
 
   void Set(const HWResourceInfo &hw_res, const HWPanelInfo &panel_info,
            const DisplayConfigVariableInfo &attr, const PPFeatureVersion &feature_ver,
@@ -31,6 +31,7 @@
 #include <utils/locker.h>
 #include <utils/fence.h>
 #include <utils/debug.h>
+#include <algorithm>
 #include <bitset>
 #include <map>
 #include <memory>
@@ -287,6 +288,7 @@ const int  kPipeDmaLimit       = (1 << 1);
 const int  kPipeScalingLimit   = (1 << 2);
 const int  kPipeRotationLimit  = (1 << 3);
 
+// Stored across restarts by HWInfoCache, which must be updated along with any field change here.
 struct HWResourceInfo {
   uint32_t hw_version = 0;
   uint32_t num_dma_pipe = 0;
@@ -679,6 +681,11 @@ struct LayerExt {
   std::vector<LayerRect> excl_rects = {};  // list of exclusion rects
 };
 
+struct HWMultiRectPair {
+  uint32_t layer_index[2] = {};  // App layers that can share the two rects of a source pipe
+  bool parallel = false;         // Rects fetch side by side, else one after the other
+};
+
 struct HWLayersInfo {
   LayerStack *stack = NULL;          // Input layer stack. Set by the caller.
   uint32_t app_layer_count = 0;      // Total number of app layers. Must not be 0.
@@ -689,6 +696,10 @@ struct HWLayersInfo {
   std::vector<Layer> hw_layers = {};  // Layers which need to be programmed on the HW
   std::vector<LayerExt> layer_exts = {};  // Extention layer having list of
                                           // exclusion rectangles for each layer
+  std::vector<uint32_t> occluded_index {};  // App layers fully hidden behind opaque layers above
+                                            // them. Left out of composition.
+  std::vector<HWMultiRectPair> multirect_pairs {};  // Layer pairs the strategy may place on
+                                                    // the two rects of one source pipe.
   std::vector<uint32_t> index {};   // Indexes of the layers from the layer stack which need to
                                  // be programmed on hardware.
   std::vector<uint32_t> roi_index {};  // Stores the ROI index where the layers are visible.
@@ -719,6 +730,23 @@ struct HWQosData {
   uint32_t rot_clock_hz = 0;
 };
 
+struct HWFbIdCacheStats {
+  uint64_t hits = 0;       // Lookups that found a cached fb_id with matching format and size.
+  uint64_t misses = 0;     // Lookups that had to create a new fb_id.
+  uint64_t evictions = 0;  // Least recently used fb_ids dropped to stay within the cache limit.
+  uint64_t prefetched = 0; // Misses served by an fb_id created ahead of time on prefetch thread.
+};
+
+struct HWQosVoteStats {
+  uint64_t frames = 0;           // Commits that carried a QoS vote.
+  uint64_t request_changes = 0;  // Commits whose strategy request differed from the last one.
+  uint64_t vote_changes = 0;     // Commits that changed the programmed vote.
+  uint64_t ubwc_frames = 0;      // Commits whose request was scaled for UBWC compression.
+  uint64_t ubwc_in_kbps = 0;     // DRAM AB of those commits, summed before scaling
+  uint64_t ubwc_out_kbps = 0;    // and after.
+  uint32_t ubwc_last_pct = 0;    // DRAM AB saved by the last commit.
+};
+
 enum UpdateType {
   kUpdateResources,  // Indicates Strategy & RM execution, which can update resources.
   kSwapBuffers,      // Indicates Strategy & RM execution, which can update buffer handler and crop.
@@ -733,6 +761,49 @@ struct HWLayers {
   HWAVRInfo hw_avr_info = {};
   std::bitset<kUpdateMax> updates_mask = 0;
   uint64_t elapse_timestamp = 0;
+  uint32_t config_count = 0;  // Leading configs that may have been written since the last Reset.
+
+  // Called after the resource manager assigned configs for the current hw_layers.
+  void UpdateConfigCount() {
+    config_count = std::max(config_count, std::min(UINT32(info.hw_layers.size()),
+                                                   UINT32(kMaxSDELayers)));
+  }
+
+  // Cleans up for reuse in the next draw cycle. Unlike assigning HWLayers(), only the configs the
+  // last cycle wrote are cleared and the layer info vectors keep their capacity.
+  void Reset() {
+    for (uint32_t i = 0; i < config_count; i++) {
+      config[i] = HWLayerConfig();
+    }
+    config_count = 0;
+
+    HWLayersInfo cleared;
+    info.wide_color_primaries.clear();
+    info.hw_layers.clear();
+    info.layer_exts.clear();
+    info.occluded_index.clear();
+    info.multirect_pairs.clear();
+    info.index.clear();
+    info.roi_index.clear();
+    info.left_frame_roi.clear();
+    info.right_frame_roi.clear();
+    cleared.wide_color_primaries.swap(info.wide_color_primaries);
+    cleared.hw_layers.swap(info.hw_layers);
+    cleared.layer_exts.swap(info.layer_exts);
+    cleared.occluded_index.swap(info.occluded_index);
+    cleared.multirect_pairs.swap(info.multirect_pairs);
+    cleared.index.swap(info.index);
+    cleared.roi_index.swap(info.roi_index);
+    cleared.left_frame_roi.swap(info.left_frame_roi);
+    cleared.right_frame_roi.swap(info.right_frame_roi);
+    info = std::move(cleared);
+
+    output_compression = 1.0f;
+    qos_data = {};
+    hw_avr_info = {};
+    updates_mask = 0;
+    elapse_timestamp = 0;
+  }
 };
 
 struct HWDisplayAttributes : DisplayConfigVariableInfo {
@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __QDCM_CALIB_BLOB_H__
+#define __QDCM_CALIB_BLOB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sdm {
+
+// Binary form of a qdcm_calib_data_<panel>.xml file. It is compiled at build time or on the
+// first boot and mapped read only by the color manager, so the XML isn't parsed on each start.
+// All offsets are from the start of the blob, all sections are 8 byte aligned.
+//
+//   QdcmCalibHeader
+//   QdcmCalibMode[num_modes]
+//   QdcmCalibFeature[num_features]  features of each mode are contiguous
+//   QdcmCalibLut[num_luts]
+//   attributes                      "key\0value\0" pairs of each XML element
+//   data                            decoded payloads of the Feature and Lut elements
+
+static const uint32_t kQdcmCalibMagic = 0x42434451;  // "QDCB"
+static const uint32_t kQdcmCalibVersion = 1;
+
+struct QdcmCalibAttrs {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+
+struct QdcmCalibHeader {
+  uint32_t magic = kQdcmCalibMagic;
+  uint32_t version = kQdcmCalibVersion;
+  uint32_t size = 0;           // Size of the blob
+  uint32_t num_modes = 0;
+  uint32_t num_features = 0;
+  uint32_t num_luts = 0;
+  uint32_t modes_offset = 0;
+  uint32_t features_offset = 0;
+  uint32_t luts_offset = 0;
+  uint32_t reserved = 0;
+  uint64_t source_size = 0;    // Size and modification time of the XML compiled
+  int64_t source_mtime = 0;
+  QdcmCalibAttrs modes_attrs;  // Attributes of Disp_Modes, NumModes and DefaultMode
+};
+
+struct QdcmCalibMode {
+  int32_t mode_id = -1;
+  uint32_t first_feature = 0;
+  uint32_t num_features = 0;
+  uint32_t reserved = 0;
+  QdcmCalibAttrs attrs;        // Name, ColorGamut, DynamicRange and so on
+};
+
+struct QdcmCalibFeature {
+  uint32_t type = 0;
+  uint32_t disabled = 0;
+  uint32_t data_offset = 0;
+  uint32_t data_size = 0;
+};
+
+struct QdcmCalibLut {
+  uint32_t type = 0;
+  uint32_t num_packets = 0;
+  uint32_t data_offset = 0;
+  uint32_t data_size = 0;
+};
+
+class QdcmCalibBlob {
+ public:
+  QdcmCalibBlob() = default;
+  QdcmCalibBlob(const QdcmCalibBlob &) = delete;
+  QdcmCalibBlob &operator=(const QdcmCalibBlob &) = delete;
+  ~QdcmCalibBlob() { Unmap(); }
+
+  // Compiles an XML into a blob at blob_path, replacing it atomically. Returns 0 or -errno.
+  static int Compile(const char *xml_path, const char *blob_path);
+
+  // Maps a blob of this version, compiled from the XML at xml_path as it is now. Returns 0 or
+  // -errno.
+  int Map(const char *blob_path, const char *xml_path);
+  void Unmap();
+
+  const void *GetData() const { return addr_; }
+  size_t GetSize() const { return size_; }
+  const QdcmCalibHeader *GetHeader() const {
+    return reinterpret_cast<const QdcmCalibHeader *>(addr_);
+  }
+
+ private:
+  void *addr_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __QDCM_CALIB_BLOB_H__
@@ -0,0 +1,219 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __ASYNC_TASK_H__
+#define __ASYNC_TASK_H__
+
+#include <utils/sync_task.h>
+
+#include <atomic>
+#include <condition_variable>   // NOLINT
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace sdm {
+
+// Asynchronous sibling of SyncTask with the same context and handler interface. Callers post tasks
+// to a bounded lock-free queue and get back a ticket, a timeline value which completes in posting
+// order, and only block when they Wait() on it. Task contexts must stay valid until their ticket
+// completes. With batch completion, waiters are woken once per drained batch instead of per task.
+template <class TaskCode>
+class AsyncTask {
+ public:
+  typedef typename SyncTask<TaskCode>::TaskContext TaskContext;
+  typedef typename SyncTask<TaskCode>::TaskHandler TaskHandler;
+
+  // queue_size is rounded up to a power of two.
+  explicit AsyncTask(TaskHandler &task_handler, uint32_t queue_size = 64,
+                     bool batch_completion = false)
+    : task_handler_(task_handler), batch_completion_(batch_completion) {
+    uint32_t size = 1;
+    while (size < queue_size) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (uint32_t i = 0; i < size; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    std::thread worker_thread(AsyncTaskThread, this);
+    worker_thread_.swap(worker_thread);
+  }
+
+  // Runs every task already posted before the worker exits.
+  ~AsyncTask() {
+    {
+      std::lock_guard<std::mutex> worker_lock(worker_mutex_);
+      worker_thread_exit_ = true;
+      worker_cv_.notify_one();
+    }
+    worker_thread_.join();
+  }
+
+  // Queues the task and returns its ticket. Blocks only while the queue is full, which must not
+  // happen on the worker thread itself.
+  uint64_t PostTask(const TaskCode &task_code, TaskContext *task_context) {
+    Cell *cell = nullptr;
+    uint64_t position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & mask_];
+      uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+      int64_t available = static_cast<int64_t>(sequence - position);
+      if (available == 0) {
+        if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                    std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (available < 0) {
+        // Full, the oldest queued task has to complete first.
+        Wait(position - mask_);
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->task_code = task_code;
+    cell->task_context = task_context;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in WaitForTask() so that either the worker sees this task or this
+    // thread sees the worker asleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker_waiting_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> worker_lock(worker_mutex_);
+      worker_cv_.notify_one();
+    }
+
+    return position + 1;
+  }
+
+  bool IsDone(uint64_t ticket) const {
+    return completed_.load(std::memory_order_acquire) >= ticket;
+  }
+
+  void Wait(uint64_t ticket) {
+    if (IsDone(ticket)) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> caller_lock(caller_mutex_);
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    caller_cv_.wait(caller_lock, [this, ticket] {
+      return completed_.load(std::memory_order_seq_cst) >= ticket;
+    });
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Same semantics as SyncTask::PerformTask, ordered after everything already posted.
+  void PerformTask(const TaskCode &task_code, TaskContext *task_context) {
+    Wait(PostTask(task_code, task_context));
+  }
+
+ private:
+  struct Cell {
+    std::atomic<uint64_t> sequence;
+    TaskCode task_code;
+    TaskContext *task_context = nullptr;
+  };
+
+  static void AsyncTaskThread(AsyncTask *async_task) {
+    if (async_task) {
+      async_task->OnThreadCallback();
+    }
+  }
+
+  bool HasTask() {
+    Cell &cell = cells_[dequeue_position_ & mask_];
+    return cell.sequence.load(std::memory_order_acquire) == dequeue_position_ + 1;
+  }
+
+  // Returns false once exit is requested and the queue is drained.
+  bool WaitForTask() {
+    if (HasTask()) {
+      return true;
+    }
+
+    std::unique_lock<std::mutex> worker_lock(worker_mutex_);
+    worker_waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    worker_cv_.wait(worker_lock, [this] { return worker_thread_exit_ || HasTask(); });
+    worker_waiting_.store(false, std::memory_order_relaxed);
+
+    return HasTask();
+  }
+
+  void Complete(uint64_t ticket) {
+    completed_.store(ticket, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> caller_lock(caller_mutex_);
+      caller_cv_.notify_all();
+    }
+  }
+
+  void OnThreadCallback() {
+    while (WaitForTask()) {
+      // Drain everything queued so far, tasks posted meanwhile join the batch.
+      while (HasTask()) {
+        Cell &cell = cells_[dequeue_position_ & mask_];
+        TaskCode task_code = cell.task_code;
+        TaskContext *task_context = cell.task_context;
+        cell.sequence.store(dequeue_position_ + mask_ + 1, std::memory_order_release);
+        dequeue_position_++;
+
+        // Call task handler which is implemented by the caller.
+        task_handler_.OnTask(task_code, task_context);
+
+        if (!batch_completion_) {
+          Complete(dequeue_position_);
+        }
+      }
+
+      if (batch_completion_) {
+        Complete(dequeue_position_);
+      }
+    }
+  }
+
+  TaskHandler &task_handler_;
+  bool batch_completion_ = false;
+  std::unique_ptr<Cell[]> cells_;
+  uint64_t mask_ = 0;
+  std::atomic<uint64_t> enqueue_position_ {0};
+  uint64_t dequeue_position_ = 0;  // Worker thread only.
+  std::atomic<uint64_t> completed_ {0};
+  std::atomic<uint32_t> waiters_ {0};
+  std::atomic<bool> worker_waiting_ {false};
+  std::thread worker_thread_;
+  std::mutex caller_mutex_;
+  std::mutex worker_mutex_;
+  std::condition_variable caller_cv_;
+  std::condition_variable worker_cv_;
+  bool worker_thread_exit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __ASYNC_TASK_H__
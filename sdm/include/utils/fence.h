@@ -31,7 +31,11 @@
 #define __FENCE_H__
 
 #include <core/buffer_sync_handler.h>
+#include <utils/locker.h>
 #include <unistd.h>
+#include <array>
+#include <atomic>
+#include <map>
 #include <utility>
 #include <memory>
 #include <string>
@@ -51,16 +55,19 @@ class Fence {
   };
 
   // This class methods allow client to get access to the native file descriptor of fence object
-  // during the scope of this class object. Underlying file descriptor is duped and returned to
-  // the client. Duped file descriptors are closed as soon as scope ends. Client can get access
-  // to multiple fences using the same scoped reference.
+  // during the scope of this class object. The fence is referenced until the scope ends, so its
+  // own file descriptor is lent to the client without a dup. Client must not close it or keep it
+  // beyond the scope. Client can get access to multiple fences using the same scoped reference.
   class ScopedRef {
    public:
-    ~ScopedRef();
     int Get(const shared_ptr<Fence> &fence);
 
    private:
-    std::vector<int> dup_fds_ = {};
+    static const uint32_t kInlineRefs = 16;  // Enough for the planes of one commit.
+
+    std::array<shared_ptr<Fence>, kInlineRefs> refs_ = {};
+    uint32_t num_refs_ = 0;
+    std::vector<shared_ptr<Fence>> overflow_refs_ = {};
   };
 
   ~Fence();
@@ -76,35 +83,61 @@ class Fence {
   // Ownership of returned fd lies with caller. Caller must explicitly close the fd.
   static int Dup(const shared_ptr<Fence> &fence);
 
+  // Returns the other fence without a new fd if either fence is null or both are the same.
   static shared_ptr<Fence> Merge(const shared_ptr<Fence> &fence1, const shared_ptr<Fence> &fence2);
 
+  // Merges all fences into one. Null and repeated fences are skipped, so a set that reduces to a
+  // single fence returns it as is. Signaled fences are dropped if ignore_signaled is set.
   static shared_ptr<Fence> Merge(const std::vector<shared_ptr<Fence>> &fences,
                                  bool ignore_signaled);
 
-  // Wait on null fence will return success.
+  // Wait on null fence will return success. Signaled state is cached in the fence object, so
+  // waits and status checks on a fence already seen signaled do not query the driver again.
   static DisplayError Wait(const shared_ptr<Fence> &fence);
   static DisplayError Wait(const shared_ptr<Fence> &fence, int timeout);
 
   // Status check on null fence will return signaled.
   static Status GetStatus(const shared_ptr<Fence> &fence);
 
+  // Hints the signaler that the fence is needed by deadline_ns. Null and signaled fences are
+  // skipped.
+  static void SetDeadline(const shared_ptr<Fence> &fence, uint64_t deadline_ns);
+
   static string GetStr(const shared_ptr<Fence> &fence);
 
-  // Write all fences info to the output stream.
+  // Write all fences info and wait time histograms to the output stream.
   static void Dump(std::ostringstream *os);
 
  private:
+  struct PooledFence;
+
   explicit Fence(int fd, const string &name);
   Fence(const Fence &fence) = delete;
   Fence& operator=(const Fence &fence) = delete;
   Fence(Fence &&fence) = delete;
   Fence& operator=(Fence &&fence) = delete;
   static int Get(const shared_ptr<Fence> &fence);
+  static void RecordWait(const string &name, uint64_t wait_us);
+
+  // Upper bounds of the wait time histogram buckets in milliseconds. Waits not below the last
+  // bound are counted in an extra overflow bucket.
+  static constexpr uint32_t kWaitBucketBoundsMs[] = {1, 2, 4, 8, 16, 33, 66};
+  static constexpr uint32_t kNumWaitBuckets = 8;
+
+  struct WaitStats {
+    uint64_t count = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    uint64_t buckets[kNumWaitBuckets] = {};
+  };
 
   static BufferSyncHandler *g_buffer_sync_handler_;
   static std::vector<std::weak_ptr<Fence>> wps_;
+  static Locker wait_stats_locker_;
+  static std::map<string, WaitStats> wait_stats_;  // Keyed by fence name without fd suffix.
   int fd_ = -1;
   string name_ = "";
+  std::atomic<bool> signaled_ = {false};  // Signaled is final, so it is safe to remember.
 };
 
 }  // namespace sdm
@@ -0,0 +1,94 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FRAME_TIMING_H__
+#define __FRAME_TIMING_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <sstream>
+
+namespace sdm {
+
+enum FrameStage {
+  kFrameStageValidate,     // HWCSession::ValidateDisplay
+  kFrameStagePrepare,      // DisplayBase::Prepare
+  kFrameStageStrategy,     // Strategy selection inside CompManager::Prepare
+  kFrameStageResources,    // Resource allocation inside CompManager::Prepare
+  kFrameStageHWValidate,   // HWDeviceDRM::Validate
+  kFrameStagePresent,      // HWCSession::PresentDisplay
+  kFrameStageCommit,       // DisplayBase::Commit
+  kFrameStageDRMCommit,    // Atomic commit ioctl issued by HWDeviceDRM
+  kFrameStageHWEvent,      // HWEventsDRM dispatch, from event loop wake up to handler return
+  kFrameStageMax,
+};
+
+// Per display ring of stage durations for the recent frames. Each stage of a display is written
+// by a single thread, and readers only take relaxed snapshots, so recording never blocks.
+class FrameTiming {
+ public:
+  class ScopedStage {
+   public:
+    ScopedStage(int32_t display_id, FrameStage stage);
+    ~ScopedStage();
+
+   private:
+    int32_t display_id_;
+    FrameStage stage_;
+    uint64_t start_ns_;
+  };
+
+  static uint64_t Now();
+  static void Record(int32_t display_id, FrameStage stage, uint64_t duration_ns);
+  static uint64_t GetLatest(int32_t display_id, FrameStage stage);
+  static const char *GetStageName(FrameStage stage);
+  static void Dump(int32_t display_id, std::ostringstream *os);
+
+ private:
+  static const uint32_t kMaxDisplays = 8;
+  static const uint32_t kMaxSamples = 256;
+
+  struct StageRing {
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> samples[kMaxSamples];
+  };
+
+  struct DisplayTiming {
+    std::atomic<int32_t> display_id;
+    StageRing stages[kFrameStageMax];
+  };
+
+  static DisplayTiming *GetDisplayTiming(int32_t display_id, bool create);
+
+  static DisplayTiming display_timing_[kMaxDisplays];
+};
+
+}  // namespace sdm
+
+#endif  // __FRAME_TIMING_H__
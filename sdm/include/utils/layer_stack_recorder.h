@@ -0,0 +1,61 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __LAYER_STACK_RECORDER_H__
+#define __LAYER_STACK_RECORDER_H__
+
+#include <core/layer_stack.h>
+#include <stdio.h>
+#include <vector>
+
+namespace sdm {
+
+// Layer stack read back from a recording. The stack points into the layers owned here.
+struct RecordedLayerStack {
+  RecordedLayerStack() = default;
+  RecordedLayerStack(const RecordedLayerStack &) = delete;
+  RecordedLayerStack &operator=(const RecordedLayerStack &) = delete;
+
+  std::vector<Layer> layers;
+  LayerStack stack;
+};
+
+// Serializes the composition relevant attributes of a layer stack, one frame per record, so that
+// frames captured on device can be replayed against the composition manager off line. Buffer
+// handles and fences are not recorded.
+class LayerStackRecorder {
+ public:
+  static bool Write(FILE *file, const LayerStack &stack);
+  static bool Read(FILE *file, RecordedLayerStack *recorded);
+};
+
+}  // namespace sdm
+
+#endif  // __LAYER_STACK_RECORDER_H__
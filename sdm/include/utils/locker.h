@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2014 - 2016, 2018 - 2019, The Linux Foundation. All rights reserved.
+* Copyright (c) 2014 - 2016, 2018 - 2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without modification, are permitted
 * provided that the following conditions are met:
@@ -29,12 +29,17 @@
 #include <errno.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <time.h>
+#include <algorithm>
+#include <sstream>
 
 #define SCOPE_LOCK(locker) Locker::ScopeLock lock(locker)
 #define SEQUENCE_ENTRY_SCOPE_LOCK(locker) Locker::SequenceEntryScopeLock lock(locker)
 #define SEQUENCE_EXIT_SCOPE_LOCK(locker) Locker::SequenceExitScopeLock lock(locker)
 #define SEQUENCE_WAIT_SCOPE_LOCK(locker) Locker::SequenceWaitScopeLock lock(locker)
 #define SEQUENCE_CANCEL_SCOPE_LOCK(locker) Locker::SequenceCancelScopeLock lock(locker)
+#define SCOPE_READ_LOCK(locker) RwLocker::ScopeReadLock lock(locker)
+#define SCOPE_WRITE_LOCK(locker) RwLocker::ScopeWriteLock lock(locker)
 
 namespace sdm {
 
@@ -145,7 +150,38 @@ class Locker {
     pthread_condattr_destroy(&cond_attr_);
   }
 
-  void Lock() { pthread_mutex_lock(&mutex_); }
+  // Uncontended acquires take the trylock fast path. Contended ones spin for up to spin_count_
+  // attempts before sleeping in the mutex, and the time they waited is recorded.
+  void Lock() {
+    if (pthread_mutex_trylock(&mutex_)) {
+      LockContended();
+    } else {
+      last_wait_ns_ = 0;
+    }
+    acquisitions_++;
+  }
+
+  // Time the current holder waited for the lock, 0 when it was not contended.
+  uint64_t GetLastWaitNs() { return last_wait_ns_; }
+
+  // Critical sections of a few microseconds are cheaper to spin on than to sleep on.
+  void SetSpinCount(uint32_t spin_count) { spin_count_ = spin_count; }
+
+  // Contention statistics, printed only for lockers that were contended.
+  void Dump(const char *name, std::ostringstream *os) {
+    if (!contended_) {
+      return;
+    }
+
+    *os << "  " << name << ": " << contended_ << "/" << acquisitions_ << " contended, "
+        << spin_acquired_ << " by spinning, max wait " << max_wait_ns_ / 1000 << " us, waits";
+    for (uint32_t i = 0; i < kWaitBuckets; i++) {
+      *os << " " << (i < kWaitBuckets - 1 ? "<" : ">=")
+          << (1U << (2 * std::min(i, kWaitBuckets - 2))) << "us:" << wait_histogram_[i];
+    }
+    *os << "\n";
+  }
+
   int32_t TryLock() { return pthread_mutex_trylock(&mutex_); }
   void Unlock() { pthread_mutex_unlock(&mutex_); }
   void Signal() { pthread_cond_signal(&condition_); }
@@ -163,9 +199,54 @@ class Locker {
   }
 
  private:
+  // Buckets of waits below 1, 4, 16, 64, 256, 1024 and 4096 us, and the rest.
+  static const uint32_t kWaitBuckets = 8;
+
+  static uint64_t NowNs() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+  }
+
+  void LockContended() {
+    uint64_t start_ns = NowNs();
+    bool acquired = false;
+    for (uint32_t i = 0; i < spin_count_ && !acquired; i++) {
+#if defined(__aarch64__) || defined(__arm__)
+      __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+      __asm__ __volatile__("pause");
+#endif
+      acquired = !pthread_mutex_trylock(&mutex_);
+    }
+    if (!acquired) {
+      pthread_mutex_lock(&mutex_);
+    }
+
+    // Counters are only updated with the mutex held.
+    uint64_t wait_ns = NowNs() - start_ns;
+    uint64_t wait_us = wait_ns / 1000;
+    uint32_t bucket = 0;
+    while (bucket < kWaitBuckets - 1 && wait_us >= (1ULL << (2 * bucket))) {
+      bucket++;
+    }
+    wait_histogram_[bucket]++;
+    max_wait_ns_ = std::max(max_wait_ns_, wait_ns);
+    last_wait_ns_ = wait_ns;
+    contended_++;
+    spin_acquired_ += acquired;
+  }
+
   pthread_mutex_t mutex_;
   pthread_cond_t condition_;
   pthread_condattr_t cond_attr_;
+  uint32_t spin_count_ = 0;
+  uint64_t acquisitions_ = 0;
+  uint64_t contended_ = 0;
+  uint64_t spin_acquired_ = 0;
+  uint64_t max_wait_ns_ = 0;
+  uint64_t last_wait_ns_ = 0;
+  uint64_t wait_histogram_[kWaitBuckets] = {};
   int sequence_wait_;   // This flag is set to 1 on sequence entry, 0 on exit, and -1 on cancel.
                         // Some routines will wait for sequence of function calls to finish
                         // so that capturing a transitionary snapshot of context is prevented.
@@ -173,6 +254,58 @@ class Locker {
                         // further processing.
 };
 
+// Reader/writer lock for state that is read on every frame and changed only on rare events such
+// as hotplug, so that readers of different displays do not serialize against each other. Read
+// locks are not recursive.
+class RwLocker {
+ public:
+  class ScopeReadLock {
+   public:
+    explicit ScopeReadLock(RwLocker& locker) : locker_(locker) {
+      locker_.ReadLock();
+    }
+
+    ~ScopeReadLock() {
+      locker_.Unlock();
+    }
+
+   private:
+    RwLocker &locker_;
+  };
+
+  class ScopeWriteLock {
+   public:
+    explicit ScopeWriteLock(RwLocker& locker) : locker_(locker) {
+      locker_.WriteLock();
+    }
+
+    ~ScopeWriteLock() {
+      locker_.Unlock();
+    }
+
+   private:
+    RwLocker &locker_;
+  };
+
+  RwLocker() {
+    // Prefer writers so that a steady stream of overlapping readers cannot starve them.
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&rwlock_, &attr);
+    pthread_rwlockattr_destroy(&attr);
+  }
+
+  ~RwLocker() { pthread_rwlock_destroy(&rwlock_); }
+
+  void ReadLock() { pthread_rwlock_rdlock(&rwlock_); }
+  void WriteLock() { pthread_rwlock_wrlock(&rwlock_); }
+  void Unlock() { pthread_rwlock_unlock(&rwlock_); }
+
+ private:
+  pthread_rwlock_t rwlock_;
+};
+
 }  // namespace sdm
 
 #endif  // __LOCKER_H__
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2015-2018, The Linux Foundation. All rights reserved.
+* Copyright (c) 2015-2018, 2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -31,6 +31,7 @@
 #define __RECT_H__
 
 #include <stdint.h>
+#include <vector>
 #include <core/sdm_types.h>
 #include <core/layer_stack.h>
 #include <utils/debug.h>
@@ -68,6 +69,12 @@ namespace sdm {
                                      float *dst_width, float *dst_height);
   DisplayError GetScaleFactor(const LayerRect &crop, const LayerRect &dst, bool rotate90,
                               float *scale_x, float *scale_y);
+  // Reduces rects to at most max_count disjoint rects covering all of them. Overlapping rects are
+  // merged first, then the pair whose bounding box adds the fewest pixels until the count fits.
+  void MergeRects(uint32_t max_count, std::vector<LayerRect> *rects);
+  // Batched forms of Union and Intersection over a whole list of rects.
+  LayerRect UnionAll(const LayerRect *rects, size_t count);
+  void IntersectAll(const LayerRect &clip, LayerRect *rects, size_t count);
 }  // namespace sdm
 
 #endif  // __RECT_H__
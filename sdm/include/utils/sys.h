@@ -33,6 +33,9 @@
 #include <poll.h>
 #include <pthread.h>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #ifdef SDM_VIRTUAL_DRIVER
 #include <virtual_driver.h>
@@ -92,6 +95,14 @@ class DynLib {
   void *lib_ = NULL;
 };
 
+// Opens libraries on a background thread ahead of their first DynLib::Open, so that the open on
+// the display path only takes another reference. Handles are kept for the life of the process.
+class DynLibPreloader {
+ public:
+  static void Start(const std::vector<std::string> &lib_names);
+  static void Dump(std::ostringstream *os);
+};
+
 }  // namespace sdm
 
 #endif  // __SYS_H__
@@ -0,0 +1,78 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __THREAD_POLICY_H__
+#define __THREAD_POLICY_H__
+
+#include <stdint.h>
+#include <mutex>
+#include <sstream>
+
+namespace sdm {
+
+// Scheduling classes of the display threads. Each class gets its policy and CPU affinity from
+// vendor.display.thread_policy.<class> ("fifo:<priority>", "nice:<nice>" or "default" to leave
+// the inherited policy alone) and vendor.display.thread_cpus.<class> (e.g. "4-7" or "0,2").
+enum ThreadClass {
+  kThreadClassEvent,       // Hardware event loops, e.g. the DRM vsync event reader
+  kThreadClassPresent,     // Vsync delivery and presents driven by the composer itself
+  kThreadClassUEvent,      // Hotplug uevent listener
+  kThreadClassGPU,         // GPU composition work like tone mapping, stitch and color convert
+  kThreadClassBackground,  // Monitoring, dumping and loading off the frame path
+  kThreadClassMax,
+};
+
+class ThreadPolicy {
+ public:
+  // Names the calling thread and applies the policy of its class. Display threads call this
+  // first thing, so that tuning them needs no code changes.
+  static void Apply(ThreadClass thread_class, const char *name);
+  static void Dump(std::ostringstream *os);
+
+ private:
+  struct Policy {
+    bool set = false;        // Leave the inherited policy when not set
+    int fifo_priority = 0;   // SCHED_FIFO priority, SCHED_OTHER when 0
+    int nice = 0;
+    uint64_t cpu_mask = 0;   // No affinity when 0
+    uint32_t applied = 0;    // Threads this policy was applied to
+  };
+
+  static void Load();
+  static bool ParsePolicy(const char *value, Policy *policy);
+  static uint64_t ParseCpus(const char *value);
+
+  static std::once_flag load_once_;
+  static std::mutex lock_;
+  static Policy policies_[kThreadClassMax];
+};
+
+}  // namespace sdm
+
+#endif  // __THREAD_POLICY_H__
@@ -0,0 +1,78 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __VSYNC_MODEL_H__
+#define __VSYNC_MODEL_H__
+
+#include <stdint.h>
+#include <mutex>
+
+namespace sdm {
+
+// Phase locked estimate of the vsync period and phase of a display, fit to the recent hardware
+// vsync timestamps. Timestamps that do not land near the current vsync grid are filtered out as
+// jitter, and a run of them relocks the model, e.g. once a refresh rate switch takes effect.
+// Samples are added from the event thread while clients query predictions, so all access is
+// serialized internally.
+class VSyncModel {
+ public:
+  void Reset(int64_t nominal_period_ns);
+  void AddSample(int64_t timestamp_ns);
+  // Predicts the first vsync after now_ns. Returns false until enough vsyncs have been seen, or
+  // once hardware vsync has been off for long enough that the phase is no longer trusted.
+  bool Predict(int64_t now_ns, int64_t *next_vsync_ns, int64_t *period_ns);
+
+ private:
+  static const uint32_t kMaxSamples = 16;
+  static const uint32_t kMinSamples = 4;
+  static const uint32_t kMaxOutliers = 3;
+  static const int64_t kMaxExtrapolationNs = 5000000000LL;
+
+  struct Sample {
+    int64_t timestamp_ns = 0;
+    int64_t index = 0;  // Number of vsync periods since the first sample
+  };
+
+  void ResetLocked();
+  void AddSampleLocked(int64_t timestamp_ns, int64_t index);
+  void UpdateModelLocked();
+
+  std::mutex lock_;
+  int64_t nominal_period_ns_ = 0;
+  Sample samples_[kMaxSamples] = {};
+  uint32_t num_samples_ = 0;
+  uint32_t next_sample_ = 0;
+  uint32_t outliers_ = 0;
+  int64_t period_ns_ = 0;     // Zero while the model is not locked
+  int64_t reference_ns_ = 0;  // A vsync on the fitted grid
+};
+
+}  // namespace sdm
+
+#endif  // __VSYNC_MODEL_H__
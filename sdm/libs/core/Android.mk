@@ -37,19 +37,78 @@ LOCAL_SRC_FILES               := core_interface.cpp \
                                  strategy.cpp \
                                  resource_default.cpp \
                                  color_manager.cpp \
+                                 qdcm_calib_blob.cpp \
                                  hw_events_interface.cpp \
                                  hw_info_interface.cpp \
-                                 hw_interface.cpp
+                                 hw_interface.cpp \
+                                 hw_qos_governor.cpp \
+                                 rotation_cost.cpp \
+                                 multirect_packer.cpp
 
 ifneq ($(TARGET_IS_HEADLESS), true)
     LOCAL_SRC_FILES           += $(LOCAL_HW_INTF_PATH_2)/hw_info_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_info_cache.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_device_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_peripheral_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_tv_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_events_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_scale_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_virtual_drm.cpp \
-                                 $(LOCAL_HW_INTF_PATH_2)/hw_color_manager_drm.cpp
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_color_manager_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_color_lut_pack.cpp
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+include $(LOCAL_PATH)/../../../common.mk
+
+LOCAL_MODULE                  := sdm_comp_benchmark
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_CFLAGS                  := -fno-operator-names -Wno-unused-parameter -DLOG_TAG=\"SDM\" \
+                                 $(common_flags)
+LOCAL_SHARED_LIBRARIES        := libdl libdisplaydebug libsdmutils
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_SRC_FILES               := comp_manager_benchmark.cpp \
+                                 comp_manager.cpp \
+                                 strategy.cpp \
+                                 resource_default.cpp
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := sdm_color_lut_pack_test
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_CFLAGS                  := -Wall -Werror -std=c++14
+LOCAL_STATIC_LIBRARIES        := libgtest
+LOCAL_SRC_FILES               := drm/hw_color_lut_pack_test.cpp \
+                                 drm/hw_color_lut_pack.cpp
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := sdm_color_lut_pack_benchmark
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_CFLAGS                  := -Wall -Werror -std=c++14
+LOCAL_SRC_FILES               := drm/hw_color_lut_pack_benchmark.cpp \
+                                 drm/hw_color_lut_pack.cpp
+
+include $(BUILD_NATIVE_BENCHMARK)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := qdcm_calib_compiler
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(LOCAL_PATH)/../../include
+LOCAL_CFLAGS                  := -Wall -Werror -std=c++14
+LOCAL_SRC_FILES               := qdcm_calib_compiler.cpp \
+                                 qdcm_calib_blob.cpp
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -28,6 +28,7 @@
 */
 
 #include <dlfcn.h>
+#include <unistd.h>
 #include <private/color_interface.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
@@ -280,6 +281,7 @@ ColorManagerProxy *ColorManagerProxy::CreateColorManagerProxy(DisplayType type,
             hw_attr.version.version[kGlobalColorFeaturePaV2],
             versions.version[kGlobalColorFeaturePaV2]);
     }
+    color_manager_proxy->MapCalibBlob();
 
     // 2. instantiate concrete ColorInterface from libsdm-color.so, pass all hardware info in.
     error = create_intf_(COLOR_VERSION_TAG, color_manager_proxy->display_id_,
@@ -311,6 +313,34 @@ ColorManagerProxy *ColorManagerProxy::CreateColorManagerProxy(DisplayType type,
   return color_manager_proxy;
 }
 
+void ColorManagerProxy::MapCalibBlob() {
+  std::string name = std::string("qdcm_calib_data_") + pp_hw_attributes_.panel_name;
+  std::string xml_path = "/vendor/etc/" + name + ".xml";
+  std::string vendor_blob_path = "/vendor/etc/" + name + ".bin";
+  std::string blob_path = "/data/vendor/display/" + name + ".bin";
+
+  // The blob shipped with the build, else the one compiled from the XML by an earlier start.
+  if (calib_blob_.Map(vendor_blob_path.c_str(), xml_path.c_str()) &&
+      calib_blob_.Map(blob_path.c_str(), xml_path.c_str())) {
+    if (access(xml_path.c_str(), R_OK)) {
+      return;
+    }
+
+    int ret = QdcmCalibBlob::Compile(xml_path.c_str(), blob_path.c_str());
+    if (!ret) {
+      ret = calib_blob_.Map(blob_path.c_str(), xml_path.c_str());
+    }
+    if (ret) {
+      DLOGW("Unable to compile %s, error %d", xml_path.c_str(), ret);
+      return;
+    }
+    DLOGI("Compiled %s", blob_path.c_str());
+  }
+
+  pp_hw_attributes_.calib_blob = calib_blob_.GetData();
+  pp_hw_attributes_.calib_blob_size = calib_blob_.GetSize();
+}
+
 ColorManagerProxy::~ColorManagerProxy() {
   if (destroy_intf_)
     destroy_intf_(display_id_);
@@ -467,6 +497,8 @@ DisplayError ColorManagerProxy::Validate(HWLayers *hw_layers) {
   }
 
   if (updates) {
+    // Assets rendered earlier are stale now.
+    mode_hwassets_.clear();
     update_mode_Hwassets = true;
   }
 
@@ -602,16 +634,12 @@ bool ColorManagerProxy::NeedHwassetsUpdate() {
   return need_update;
 }
 
-DisplayError ColorManagerProxy::UpdateModeHwassets(int32_t mode_id,
+DisplayError ColorManagerProxy::RenderModeHwassets(int32_t mode_id,
                                   snapdragoncolor::ColorMode color_mode, bool valid_meta_data,
-                                  const ColorMetaData &meta_data) {
-  if (!stc_intf_client_) {
-    return kErrorUndefined;
-  }
-
+                                  const ColorMetaData &meta_data,
+                                  HwConfigOutputParams *hw_params) {
   DisplayError error = kErrorNone;
   struct snapdragoncolor::ModeRenderInputParams mode_params = {};
-  struct snapdragoncolor::HwConfigOutputParams hw_params = {};
   mode_params.valid_meta_data = valid_meta_data;
   mode_params.meta_data = meta_data;
   mode_params.color_mode = color_mode;
@@ -621,17 +649,17 @@ DisplayError ColorManagerProxy::UpdateModeHwassets(int32_t mode_id,
   payload.hw_asset = kPbGamut;
   payload.hw_payload_len = sizeof(GamutConfig);
   payload.hw_payload = std::make_shared<GamutConfig>();
-  hw_params.payload.push_back(payload);
+  hw_params->payload.push_back(payload);
 
   payload.hw_asset = kPbIgc;
   payload.hw_payload = std::make_shared<GammaPostBlendConfig>(LUT1D_ENTRIES_SIZE);
   payload.hw_payload_len = sizeof(GammaPostBlendConfig);
-  hw_params.payload.push_back(payload);
+  hw_params->payload.push_back(payload);
 
   payload.hw_asset = kPbGC;
   payload.hw_payload_len = sizeof(GammaPostBlendConfig);
   payload.hw_payload = std::make_shared<GammaPostBlendConfig>(LUT3D_GC_ENTRIES_SIZE);
-  hw_params.payload.push_back(payload);
+  hw_params->payload.push_back(payload);
 
   ScPayload in_data = {};
   ScPayload out_data = {};
@@ -640,15 +668,75 @@ DisplayError ColorManagerProxy::UpdateModeHwassets(int32_t mode_id,
   in_data.payload = reinterpret_cast<uint64_t>(&mode_params);
 
   out_data.prop = kHwConfigPayloadParam;
-  out_data.len = sizeof(hw_params);
-  out_data.payload = reinterpret_cast<uint64_t>(&hw_params);
+  out_data.len = sizeof(*hw_params);
+  out_data.payload = reinterpret_cast<uint64_t>(hw_params);
   error = stc_intf_client_->ProcessOps(kScModeRenderIntent, in_data, &out_data);
   if (error != kErrorNone) {
     DLOGE("Failed to call ProcessOps, error = %d", error);
-    return error;
   }
 
-  error = ConvertToPPFeatures(&hw_params, &pp_features_);
+  return error;
+}
+
+HwConfigOutputParams *ColorManagerProxy::FindModeHwassets(int32_t mode_id,
+                                  snapdragoncolor::ColorMode color_mode, bool valid_meta_data,
+                                  const ColorMetaData &meta_data) {
+  for (auto it = mode_hwassets_.begin(); it != mode_hwassets_.end(); it++) {
+    if (it->mode_id != mode_id || it->color_mode.gamut != color_mode.gamut ||
+        it->color_mode.gamma != color_mode.gamma || it->color_mode.intent != color_mode.intent ||
+        it->valid_meta_data != valid_meta_data) {
+      continue;
+    }
+    if (valid_meta_data && memcmp(&it->meta_data, &meta_data, sizeof(meta_data))) {
+      continue;
+    }
+
+    mode_hwassets_.splice(mode_hwassets_.begin(), mode_hwassets_, it);
+    return &mode_hwassets_.front().hw_params;
+  }
+
+  return nullptr;
+}
+
+DisplayError ColorManagerProxy::UpdateModeHwassets(int32_t mode_id,
+                                  snapdragoncolor::ColorMode color_mode, bool valid_meta_data,
+                                  const ColorMetaData &meta_data) {
+  if (!stc_intf_client_) {
+    return kErrorUndefined;
+  }
+
+  // Switching back to a mode, or staying in one for HDR content with static metadata, converts
+  // the assets STC rendered the first time instead of having it render them again.
+  DisplayError error = kErrorNone;
+  HwConfigOutputParams params = {};
+  HwConfigOutputParams *hw_params = FindModeHwassets(mode_id, color_mode, valid_meta_data,
+                                                     meta_data);
+  if (!hw_params) {
+    error = RenderModeHwassets(mode_id, color_mode, valid_meta_data, meta_data, &params);
+    if (error != kErrorNone) {
+      return error;
+    }
+    hw_params = &params;
+
+    // Dynamic metadata changes every frame, so there is nothing to reuse.
+    if (!valid_meta_data || !meta_data.dynamicMetaDataValid) {
+      if (mode_hwassets_.size() >= kMaxModeHwassets) {
+        mode_hwassets_.pop_back();
+      }
+      mode_hwassets_.emplace_front();
+      ModeHwassets &assets = mode_hwassets_.front();
+      assets.mode_id = mode_id;
+      assets.color_mode = color_mode;
+      assets.valid_meta_data = valid_meta_data;
+      if (valid_meta_data) {
+        assets.meta_data = meta_data;
+      }
+      assets.hw_params.payload = std::move(params.payload);
+      hw_params = &assets.hw_params;
+    }
+  }
+
+  error = ConvertToPPFeatures(hw_params, &pp_features_);
   if (error != kErrorNone) {
     DLOGE("Failed to convert hw assets to PP features, error = %d", error);
     return kErrorUndefined;
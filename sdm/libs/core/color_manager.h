@@ -34,10 +34,12 @@
 #include <core/sdm_types.h>
 #include <utils/locker.h>
 #include <private/color_interface.h>
+#include <private/qdcm_calib_blob.h>
 #include <private/snapdragon_color_intf.h>
 #include <utils/sys.h>
 #include <utils/debug.h>
 #include <array>
+#include <list>
 #include <vector>
 #include <map>
 #include <string>
@@ -169,9 +171,25 @@ class ColorManagerProxy {
                                         PPFeaturesConfig *out_data);
   typedef std::map<std::string, ConvertProc> ConvertTable;
 
+  // Hw assets STC rendered for a mode. Switching back to a mode reuses them until STC reports
+  // that its assets need an update.
+  struct ModeHwassets {
+    int32_t mode_id = -1;
+    snapdragoncolor::ColorMode color_mode = {};
+    bool valid_meta_data = false;
+    ColorMetaData meta_data = {};
+    HwConfigOutputParams hw_params = {};
+  };
+  static const uint32_t kMaxModeHwassets = 8;
+
   bool NeedHwassetsUpdate();
   DisplayError UpdateModeHwassets(int32_t mode_id, snapdragoncolor::ColorMode color_mode,
                                   bool valid_meta_data, const ColorMetaData &meta_data);
+  DisplayError RenderModeHwassets(int32_t mode_id, snapdragoncolor::ColorMode color_mode,
+                                  bool valid_meta_data, const ColorMetaData &meta_data,
+                                  HwConfigOutputParams *hw_params);
+  HwConfigOutputParams *FindModeHwassets(int32_t mode_id, snapdragoncolor::ColorMode color_mode,
+                                         bool valid_meta_data, const ColorMetaData &meta_data);
   DisplayError ConvertToPPFeatures(HwConfigOutputParams *params, PPFeaturesConfig *out_data);
   DisplayError ConvertToIgc(const HwConfigPayload &in_data, PPFeaturesConfig *out_data);
   DisplayError ConvertToGc(const HwConfigPayload &in_data, PPFeaturesConfig *out_data);
@@ -181,6 +199,7 @@ class ColorManagerProxy {
                                                uint32_t intent);
 
   bool GetSupportStcTonemap();
+  void MapCalibBlob();
   ConvertTable convert_;
 
   int32_t display_id_;
@@ -197,6 +216,8 @@ class ColorManagerProxy {
   ColorMetaData meta_data_ = {};
   STCIntfClient *stc_intf_client_ = NULL;
   bool support_stc_tonemap_ = false;
+  std::list<ModeHwassets> mode_hwassets_;  // Most recently used first
+  QdcmCalibBlob calib_blob_;
 };
 
 class ColorFeatureCheckingImpl : public FeatureInterface {
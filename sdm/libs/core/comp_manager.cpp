@@ -25,6 +25,9 @@
 #include <core/buffer_allocator.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/formats.h>
+#include <utils/frame_timing.h>
+#include <algorithm>
 #include <set>
 #include <string>
 #include <vector>
@@ -62,6 +65,15 @@ DisplayError CompManager::Init(const HWResourceInfo &hw_res_info,
   buffer_allocator_ = buffer_allocator;
   extension_intf_ = extension_intf;
 
+  int value = 0;
+  if (Debug::GetProperty(ENABLE_PIPE_ARBITRATION_PROP, &value) == kErrorNone) {
+    pipe_arbitration_ = (value == 1);
+  }
+  value = 0;
+  if (Debug::GetProperty(DISABLE_IDLE_FALLBACK_COST_MODEL_PROP, &value) == kErrorNone) {
+    idle_fallback_cost_model_ = (value != 1);
+  }
+
   return error;
 }
 
@@ -144,6 +156,7 @@ DisplayError CompManager::RegisterDisplay(int32_t display_id, DisplayType type,
   }
 
   registered_displays_.insert(display_id);
+  display_comp_ctxs_.push_back(display_comp_ctx);
   display_comp_ctx->is_primary_panel = hw_panel_info.is_primary_panel;
   display_comp_ctx->display_id = display_id;
   display_comp_ctx->display_type = type;
@@ -181,6 +194,8 @@ DisplayError CompManager::UnregisterDisplay(Handle display_ctx) {
 
   registered_displays_.erase(display_comp_ctx->display_id);
   powered_on_displays_.erase(display_comp_ctx->display_id);
+  display_comp_ctxs_.erase(std::remove(display_comp_ctxs_.begin(), display_comp_ctxs_.end(),
+                                       display_comp_ctx), display_comp_ctxs_.end());
 
   if (display_comp_ctx->display_type == kPluggable) {
     max_layers_ = kMaxSDELayers;
@@ -252,6 +267,7 @@ DisplayError CompManager::ReconfigureDisplay(Handle comp_handle,
 
   // Update new resolution.
   display_comp_ctx->fb_config = fb_config;
+  ClearStrategyCache(display_comp_ctx);
   return error;
 }
 
@@ -273,12 +289,27 @@ void CompManager::PrepareStrategyConstraints(Handle comp_handle, HWLayers *hw_la
     constraints->safe_mode = (low_end_hw && !hw_res_info_.separate_rotator) ? true : safe_mode_;
   }
 
+  // With several displays active, size each display's share on its demand instead.
+  display_comp_ctx->pipe_demand = UINT32(hw_layers->info.stack->layers.size()) - 1;
+  if (pipe_arbitration_ && (powered_on_displays_.size() > 1)) {
+    ArbitratePipeBudget(display_comp_ctx);
+    constraints->max_layers = display_comp_ctx->pipe_budget;
+  } else {
+    display_comp_ctx->pipe_budget = 0;
+    display_comp_ctx->pipe_budget_hold = 0;
+  }
+
   // If a strategy fails after successfully allocating resources, then set safe mode
   if (display_comp_ctx->remaining_strategies != display_comp_ctx->max_strategies) {
     constraints->safe_mode = true;
   }
 
-  uint32_t app_layer_count = UINT32(hw_layers->info.stack->layers.size()) - 1;
+  uint32_t app_layer_count = display_comp_ctx->pipe_demand;
+  if (display_comp_ctx->idle_fallback && (app_layer_count > 1) &&
+      !IsIdleFallbackCheaper(display_comp_ctx, hw_layers)) {
+    // Stay on SDE until the next idle timeout.
+    display_comp_ctx->idle_fallback = false;
+  }
   if (display_comp_ctx->idle_fallback || display_comp_ctx->thermal_fallback_) {
     // Handle the idle timeout by falling back
     constraints->safe_mode = true;
@@ -290,6 +321,42 @@ void CompManager::PrepareStrategyConstraints(Handle comp_handle, HWLayers *hw_la
   }
 }
 
+// Compares the bytes fetched per refresh of an idle screen. SDE composition fetches every app
+// layer on each refresh. Falling back fetches the frame buffer instead, after one GPU pass that
+// reads the layers and writes the frame buffer, spread over the refreshes of the idle period.
+bool CompManager::IsIdleFallbackCheaper(DisplayCompositionContext *display_comp_ctx,
+                                        HWLayers *hw_layers) {
+  if (!idle_fallback_cost_model_) {
+    return true;
+  }
+
+  const HWLayersInfo &info = hw_layers->info;
+  float sde_bytes = 0.0f;
+  for (uint32_t i = 0; i < info.app_layer_count; i++) {
+    const Layer *layer = info.stack->layers.at(i);
+    const LayerRect &src = layer->src_rect;
+    LayerBufferFormat format = layer->input_buffer.format;
+    float fetch_ratio = IsUBWCFormat(format) ? kUBWCFetchRatio : 1.0f;
+    sde_bytes += (src.right - src.left) * (src.bottom - src.top) * GetBufferFormatBpp(format) *
+                 fetch_ratio;
+  }
+
+  const DisplayConfigVariableInfo &fb_config = display_comp_ctx->fb_config;
+  float fb_ratio = Debug::IsUbwcTiledFrameBuffer() ? kUBWCFetchRatio : 1.0f;
+  float fb_bytes = FLOAT(fb_config.x_pixels) * FLOAT(fb_config.y_pixels) *
+                   GetBufferFormatBpp(kFormatRGBA8888) * fb_ratio;
+  float refreshes = FLOAT(std::max(fb_config.fps, 1U) * kIdleFallbackAmortizeSeconds);
+  float gpu_bytes = fb_bytes + (sde_bytes + fb_bytes) * kGPUTrafficWeight / refreshes;
+
+  bool cheaper = (gpu_bytes < sde_bytes);
+  DLOGI("Display %d-%d idle fallback %s: %u layers, SDE %.0f KB, GPU %.0f KB per refresh",
+        display_comp_ctx->display_id, display_comp_ctx->display_type,
+        cheaper ? "taken" : "skipped", info.app_layer_count, sde_bytes / 1024.0f,
+        gpu_bytes / 1024.0f);
+
+  return cheaper;
+}
+
 void CompManager::GenerateROI(Handle display_ctx, HWLayers *hw_layers) {
   SCOPE_LOCK(locker_);
   DisplayCompositionContext *disp_comp_ctx =
@@ -322,22 +389,57 @@ DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
   bool exit = false;
   uint32_t &count = display_comp_ctx->remaining_strategies;
+  if (count == display_comp_ctx->max_strategies) {
+    // First pass of this draw cycle. If the same scene was composed before, the strategies ahead
+    // of the one that succeeded are known to fail, so skip their resource allocation.
+    display_comp_ctx->strategy_hash = GetStrategyHash(display_comp_ctx, hw_layers);
+    display_comp_ctx->cached_attempt = 0;
+    for (auto &entry : display_comp_ctx->strategy_cache) {
+      if (entry.hash == display_comp_ctx->strategy_hash) {
+        display_comp_ctx->cached_attempt = entry.attempt;
+        break;
+      }
+    }
+  }
+
+  uint64_t strategy_ns = 0;
+  uint64_t resources_ns = 0;
   for (; !exit && count > 0; count--) {
+    uint64_t start_ns = FrameTiming::Now();
     error = display_comp_ctx->strategy->GetNextStrategy(&display_comp_ctx->constraints);
+    strategy_ns += FrameTiming::Now() - start_ns;
     if (error != kErrorNone) {
       // Composition strategies exhausted. Resource Manager could not allocate resources even for
       // GPU composition. This will never happen.
       exit = true;
     }
 
+    uint32_t attempt = display_comp_ctx->max_strategies - count + 1;
+    if (!exit && attempt < display_comp_ctx->cached_attempt) {
+      continue;
+    }
+
     if (!exit) {
+      start_ns = FrameTiming::Now();
       error = resource_intf_->Prepare(display_resource_ctx, hw_layers);
+      resources_ns += FrameTiming::Now() - start_ns;
+      hw_layers->UpdateConfigCount();
       // Exit if successfully prepared resource, else try next strategy.
       exit = (error == kErrorNone);
+      if (!exit && attempt == display_comp_ctx->cached_attempt) {
+        // Cached strategy no longer fits; carry on with the remaining ones.
+        DLOGV_IF(kTagCompManager, "Cached strategy %d failed for display %d-%d", attempt,
+                 display_comp_ctx->display_id, display_comp_ctx->display_type);
+        display_comp_ctx->cached_attempt = 0;
+      }
     }
   }
 
+  FrameTiming::Record(display_comp_ctx->display_id, kFrameStageStrategy, strategy_ns);
+  FrameTiming::Record(display_comp_ctx->display_id, kFrameStageResources, resources_ns);
+
   if (error != kErrorNone) {
+    ClearStrategyCache(display_comp_ctx);
     resource_intf_->Stop(display_resource_ctx, hw_layers);
     if (safe_mode_ && display_comp_ctx->first_cycle_) {
       DLOGW("Composition strategies exhausted for display = %d on first cycle",
@@ -362,6 +464,7 @@ DisplayError CompManager::PostPrepare(Handle display_ctx, HWLayers *hw_layers) {
   display_comp_ctx->strategy->Stop();
 
   error = resource_intf_->PostPrepare(display_resource_ctx, hw_layers);
+  hw_layers->UpdateConfigCount();
   if (error != kErrorNone) {
     return error;
   }
@@ -389,6 +492,7 @@ DisplayError CompManager::ReConfigure(Handle display_ctx, HWLayers *hw_layers) {
   DisplayError error = kErrorUndefined;
   resource_intf_->Start(display_resource_ctx);
   error = resource_intf_->Prepare(display_resource_ctx, hw_layers);
+  hw_layers->UpdateConfigCount();
 
   if (error != kErrorNone) {
     DLOGE("Reconfigure failed for display = %d", display_comp_ctx->display_type);
@@ -420,6 +524,7 @@ DisplayError CompManager::PostCommit(Handle display_ctx, HWLayers *hw_layers) {
     return error;
   }
 
+  UpdateStrategyCache(display_comp_ctx);
   display_comp_ctx->idle_fallback = false;
   display_comp_ctx->first_cycle_ = false;
 
@@ -439,6 +544,7 @@ void CompManager::Purge(Handle display_ctx) {
   resource_intf_->Purge(display_comp_ctx->display_resource_ctx);
 
   display_comp_ctx->strategy->Purge();
+  ClearStrategyCache(display_comp_ctx);
 }
 
 DisplayError CompManager::SetIdleTimeoutMs(Handle display_ctx, uint32_t active_ms) {
@@ -498,6 +604,7 @@ DisplayError CompManager::SetMaxMixerStages(Handle display_ctx, uint32_t max_mix
   if (display_comp_ctx) {
     error = resource_intf_->SetMaxMixerStages(display_comp_ctx->display_resource_ctx,
                                               max_mixer_stages);
+    ClearStrategyCache(display_comp_ctx);
   }
 
   return error;
@@ -560,6 +667,8 @@ DisplayError CompManager::SetCompositionState(Handle display_ctx,
   DisplayCompositionContext *display_comp_ctx =
                              reinterpret_cast<DisplayCompositionContext *>(display_ctx);
 
+  ClearStrategyCache(display_comp_ctx);
+
   return display_comp_ctx->strategy->SetCompositionState(composition_type, enable);
 }
 
@@ -640,11 +749,183 @@ std::string CompManager::StringDisplayList(const std::set<int32_t> &displays) {
   return displays_str;
 }
 
+uint64_t CompManager::GetStrategyHash(DisplayCompositionContext *display_comp_ctx,
+                                      HWLayers *hw_layers) {
+  // FNV-1a over the layer attributes the strategy decisions depend on.
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const void *data, size_t size) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+
+  const StrategyConstraints &constraints = display_comp_ctx->constraints;
+  uint32_t num_displays = UINT32(powered_on_displays_.size());
+  mix(&display_comp_ctx->max_strategies, sizeof(display_comp_ctx->max_strategies));
+  mix(&constraints.safe_mode, sizeof(constraints.safe_mode));
+  mix(&constraints.max_layers, sizeof(constraints.max_layers));
+  mix(&num_displays, sizeof(num_displays));
+
+  for (Layer *layer : hw_layers->info.stack->layers) {
+    const LayerBuffer &buffer = layer->input_buffer;
+    mix(&buffer.format, sizeof(buffer.format));
+    mix(&buffer.width, sizeof(buffer.width));
+    mix(&buffer.height, sizeof(buffer.height));
+    mix(&buffer.flags.flags, sizeof(buffer.flags.flags));
+    mix(&layer->src_rect, sizeof(layer->src_rect));
+    mix(&layer->dst_rect, sizeof(layer->dst_rect));
+    mix(&layer->transform.rotation, sizeof(layer->transform.rotation));
+    mix(&layer->transform.flip_horizontal, sizeof(layer->transform.flip_horizontal));
+    mix(&layer->transform.flip_vertical, sizeof(layer->transform.flip_vertical));
+    mix(&layer->blending, sizeof(layer->blending));
+    mix(&layer->plane_alpha, sizeof(layer->plane_alpha));
+    mix(&layer->flags.flags, sizeof(layer->flags.flags));
+  }
+
+  return hash;
+}
+
+void CompManager::UpdateStrategyCache(DisplayCompositionContext *display_comp_ctx) {
+  // Nothing to record for draw cycles that skipped strategy selection.
+  if (!display_comp_ctx->strategy_hash) {
+    return;
+  }
+
+  std::deque<StrategyCacheEntry> &cache = display_comp_ctx->strategy_cache;
+  uint32_t attempt = display_comp_ctx->max_strategies - display_comp_ctx->remaining_strategies;
+
+  if (display_comp_ctx->cached_attempt) {
+    display_comp_ctx->strategy_cache_hits++;
+  } else {
+    display_comp_ctx->strategy_cache_misses++;
+  }
+
+  for (auto it = cache.begin(); it != cache.end(); it++) {
+    if (it->hash == display_comp_ctx->strategy_hash) {
+      cache.erase(it);
+      break;
+    }
+  }
+
+  // There is nothing to skip when the first strategy succeeds.
+  if (attempt > 1) {
+    StrategyCacheEntry entry;
+    entry.hash = display_comp_ctx->strategy_hash;
+    entry.attempt = attempt;
+    cache.push_front(entry);
+    if (cache.size() > kStrategyCacheSize) {
+      cache.pop_back();
+    }
+  }
+
+  display_comp_ctx->cached_attempt = 0;
+  display_comp_ctx->strategy_hash = 0;
+
+  DLOGV_IF(kTagCompManager, "Display %d-%d strategy cache hits %" PRIu64 " misses %" PRIu64,
+           display_comp_ctx->display_id, display_comp_ctx->display_type,
+           display_comp_ctx->strategy_cache_hits, display_comp_ctx->strategy_cache_misses);
+}
+
+void CompManager::ClearStrategyCache(DisplayCompositionContext *display_comp_ctx) {
+  display_comp_ctx->strategy_cache.clear();
+  display_comp_ctx->cached_attempt = 0;
+}
+
+uint32_t CompManager::GetPipePriority(const DisplayCompositionContext *display_comp_ctx) {
+  // Lower value is served first.
+  if (display_comp_ctx->is_primary_panel) {
+    return 0;
+  }
+
+  switch (display_comp_ctx->display_type) {
+  case kBuiltIn:
+    return 1;
+  case kPluggable:
+    return 2;
+  default:
+    return 3;
+  }
+}
+
+void CompManager::ArbitratePipeBudget(DisplayCompositionContext *display_comp_ctx) {
+  uint32_t total_pipes = hw_res_info_.num_vig_pipe + hw_res_info_.num_rgb_pipe +
+                         hw_res_info_.num_dma_pipe;
+
+  std::vector<DisplayCompositionContext *> displays;
+  for (auto ctx : display_comp_ctxs_) {
+    if (ctx == display_comp_ctx || powered_on_displays_.count(ctx->display_id)) {
+      displays.push_back(ctx);
+    }
+  }
+  std::stable_sort(displays.begin(), displays.end(),
+                   [this](const DisplayCompositionContext *a, const DisplayCompositionContext *b) {
+                     return GetPipePriority(a) < GetPipePriority(b);
+                   });
+
+  // Serve the displays in priority order on their last known demand, always keeping one pipe
+  // back for each display still to be served so that it can at least present its GPU target.
+  uint32_t remaining = total_pipes;
+  uint32_t target = 0;
+  size_t pending = displays.size();
+  for (auto ctx : displays) {
+    pending--;
+    uint32_t share = (remaining > pending) ? UINT32(remaining - pending) : 1;
+    uint32_t grant = std::max(std::min(ctx->pipe_demand, share), UINT32(1));
+    remaining -= std::min(grant, remaining);
+    if (ctx == display_comp_ctx) {
+      target = grant;
+    }
+  }
+
+  // Pipes nobody asked for are lent to the highest priority display, so that a layer showing up
+  // there does not have to wait for the next arbitration to be composed by SDE.
+  if (remaining && (displays.front() == display_comp_ctx)) {
+    target += remaining;
+  }
+
+  uint32_t &budget = display_comp_ctx->pipe_budget;
+  uint32_t &hold = display_comp_ctx->pipe_budget_hold;
+  // Give up pipes at once when a higher priority display needs them, but hold a lower budget
+  // back for a while when only this display's own demand dropped, so that a briefly shrinking
+  // layer stack does not flip the strategy back and forth.
+  bool squeezed = (display_comp_ctx->pipe_demand > target);
+  if (target >= budget || squeezed || (++hold >= kPipeBudgetHoldFrames)) {
+    if (target != budget) {
+      DLOGV_IF(kTagCompManager, "Display %d-%d pipe budget %d -> %d of %d, demand %d",
+               display_comp_ctx->display_id, display_comp_ctx->display_type, budget, target,
+               total_pipes, display_comp_ctx->pipe_demand);
+      budget = target;
+      display_comp_ctx->pipe_budget_changes++;
+    }
+    hold = 0;
+  }
+}
+
+DisplayError CompManager::GetPipeBudgetStats(Handle display_ctx, PipeBudgetStats *stats) {
+  SCOPE_LOCK(locker_);
+  DisplayCompositionContext *display_comp_ctx =
+      reinterpret_cast<DisplayCompositionContext *>(display_ctx);
+
+  if (!pipe_arbitration_) {
+    return kErrorNotSupported;
+  }
+
+  stats->demand = display_comp_ctx->pipe_demand;
+  stats->budget = display_comp_ctx->pipe_budget;
+  stats->total_pipes = hw_res_info_.num_vig_pipe + hw_res_info_.num_rgb_pipe +
+                       hw_res_info_.num_dma_pipe;
+  stats->changes = display_comp_ctx->pipe_budget_changes;
+
+  return kErrorNone;
+}
+
 DisplayError CompManager::SetBlendSpace(Handle display_ctx, const PrimariesTransfer &blend_space) {
   DisplayCompositionContext *display_comp_ctx =
       reinterpret_cast<DisplayCompositionContext *>(display_ctx);
 
   display_comp_ctx->strategy->SetBlendSpace(blend_space);
+  ClearStrategyCache(display_comp_ctx);
 
   return kErrorNone;
 }
@@ -679,6 +960,13 @@ bool CompManager::CanSkipValidate(Handle display_ctx, bool *needs_buffer_swap) {
   return display_comp_ctx->strategy->CanSkipValidate(needs_buffer_swap);
 }
 
+bool CompManager::IsIdleFallback(Handle display_ctx) {
+  DisplayCompositionContext *display_comp_ctx =
+      reinterpret_cast<DisplayCompositionContext *>(display_ctx);
+
+  return display_comp_ctx->idle_fallback;
+}
+
 bool CompManager::CheckResourceState(Handle display_ctx) {
   SCOPE_LOCK(locker_);
   DisplayCompositionContext *display_comp_ctx =
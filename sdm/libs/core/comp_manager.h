@@ -29,6 +29,7 @@
 #include <private/extension_interface.h>
 #include <utils/locker.h>
 #include <bitset>
+#include <deque>
 #include <set>
 #include <vector>
 #include <string>
@@ -41,6 +42,14 @@ namespace sdm {
 
 class CompManager {
  public:
+  // Share of the source pipes the cross display arbiter currently grants a display.
+  struct PipeBudgetStats {
+    uint32_t demand = 0;       // App layers in the last prepared layer stack.
+    uint32_t budget = 0;       // Max layers handed to the strategy, 0 if not arbitrated.
+    uint32_t total_pipes = 0;  // Source pipes shared by all displays.
+    uint64_t changes = 0;      // Number of times the budget has been changed.
+  };
+
   DisplayError Init(const HWResourceInfo &hw_res_info_, ExtensionInterface *extension_intf,
                     BufferAllocator *buffer_allocator, SocketHandler *socket_handler);
   DisplayError Deinit();
@@ -85,6 +94,7 @@ class CompManager {
   void HandleSecureEvent(Handle display_ctx, SecureEvent secure_event);
   void SetSafeMode(bool enable) { safe_mode_ = enable; }
   bool CanSkipValidate(Handle display_ctx, bool *needs_buffer_swap);
+  bool IsIdleFallback(Handle display_ctx);
   bool IsSafeMode() { return safe_mode_; }
   void GenerateROI(Handle display_ctx, HWLayers *hw_layers);
   DisplayError CheckEnforceSplit(Handle comp_handle, uint32_t new_refresh_rate);
@@ -92,15 +102,30 @@ class CompManager {
   bool CheckResourceState(Handle display_ctx);
   bool IsRotatorSupportedFormat(LayerBufferFormat format);
   DisplayError SwapBuffers(Handle display_ctx);
+  DisplayError GetPipeBudgetStats(Handle display_ctx, PipeBudgetStats *stats);
 
  private:
   static const int kMaxThermalLevel = 3;
   static const int kSafeModeThreshold = 4;
+  static const uint32_t kStrategyCacheSize = 8;
+  static const uint32_t kPipeBudgetHoldFrames = 30;
+  // Idle fallback cost model. UBWC buffers are assumed to fetch at half their size, GPU memory
+  // traffic to cost twice the energy of DPU fetches, and the GPU pass to be spread over the
+  // refreshes of at least one second of idle screen.
+  static constexpr float kUBWCFetchRatio = 0.5f;
+  static constexpr float kGPUTrafficWeight = 2.0f;
+  static const uint32_t kIdleFallbackAmortizeSeconds = 1;
 
   void PrepareStrategyConstraints(Handle display_ctx, HWLayers *hw_layers);
   void UpdateStrategyConstraints(bool is_primary, bool disabled);
   std::string StringDisplayList(const std::set<int32_t> &displays);
 
+  // Strategy attempt (1-based) that last composed a layer stack with a given geometry hash.
+  struct StrategyCacheEntry {
+    uint64_t hash = 0;
+    uint32_t attempt = 0;
+  };
+
   struct DisplayCompositionContext {
     Strategy *strategy = NULL;
     StrategyConstraints constraints;
@@ -118,13 +143,32 @@ class CompManager {
     DisplayConfigVariableInfo fb_config = {};
     bool first_cycle_ = true;
     uint32_t dest_scaler_blocks_used = 0;
+    std::deque<StrategyCacheEntry> strategy_cache;  // Most recently used first.
+    uint64_t strategy_hash = 0;     // Geometry hash of the layer stack being prepared.
+    uint32_t cached_attempt = 0;    // Strategy attempt replayed for this draw cycle, 0 if none.
+    uint64_t strategy_cache_hits = 0;
+    uint64_t strategy_cache_misses = 0;
+    uint32_t pipe_demand = 0;       // App layers of the last prepared layer stack.
+    uint32_t pipe_budget = 0;       // Pipes granted by the arbiter, 0 if not arbitrated.
+    uint32_t pipe_budget_hold = 0;  // Frames a lower budget has been held back for.
+    uint64_t pipe_budget_changes = 0;
   };
 
+  uint64_t GetStrategyHash(DisplayCompositionContext *display_comp_ctx, HWLayers *hw_layers);
+  void UpdateStrategyCache(DisplayCompositionContext *display_comp_ctx);
+  void ClearStrategyCache(DisplayCompositionContext *display_comp_ctx);
+  void ArbitratePipeBudget(DisplayCompositionContext *display_comp_ctx);
+  uint32_t GetPipePriority(const DisplayCompositionContext *display_comp_ctx);
+  bool IsIdleFallbackCheaper(DisplayCompositionContext *display_comp_ctx, HWLayers *hw_layers);
+
   Locker locker_;
   ResourceInterface *resource_intf_ = NULL;
   std::set<int32_t> registered_displays_;  // List of registered displays
   std::set<int32_t> configured_displays_;  // List of sucessfully configured displays
   std::set<int32_t> powered_on_displays_;  // List of powered on displays.
+  std::vector<DisplayCompositionContext *> display_comp_ctxs_;  // Registered display contexts.
+  bool pipe_arbitration_ = false;       // Share pipes between displays based on their demand
+  bool idle_fallback_cost_model_ = true;  // Fall back on idle only when it saves bandwidth
   bool safe_mode_ = false;              // Flag to notify all displays to be in resource crunch
                                         // mode, where strategy manager chooses the best strategy
                                         // that uses optimal number of pipes for each display
@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Replays layer stacks recorded by HWCDisplay (vendor.display.layer_stack_record_frames) against
+// CompManager, Strategy and ResourceDefault, with fixed hardware capabilities standing in for the
+// driver, and reports the cost of each composition stage per frame.
+//
+// Usage: sdm_comp_benchmark <layer stack record> [iterations] [--extension]
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/constants.h>
+#include <utils/frame_timing.h>
+#include <utils/layer_stack_recorder.h>
+#include <utils/sys.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "comp_manager.h"
+
+namespace sdm {
+
+enum BenchmarkStage {
+  kStagePrePrepare,
+  kStagePrepare,
+  kStageStrategy,
+  kStageResources,
+  kStagePostPrepare,
+  kStageCommit,
+  kStagePostCommit,
+  kStageMax,
+};
+
+static const char *kStageNames[kStageMax] = {
+  "PrePrepare", "Prepare", "  Strategy", "  Resources", "PostPrepare", "Commit", "PostCommit",
+};
+
+struct StageStats {
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+
+  void Add(uint64_t ns) {
+    total_ns += ns;
+    max_ns = std::max(max_ns, ns);
+  }
+};
+
+// Pipe and mixer limits of a typical SDE target, in place of what HWInfoDRM reads from the driver.
+static void GetResourceInfo(HWResourceInfo *hw_res_info) {
+  uint32_t id = 0;
+  for (auto type : {kPipeTypeVIG, kPipeTypeVIG, kPipeTypeVIG, kPipeTypeVIG,
+                    kPipeTypeDMA, kPipeTypeDMA, kPipeTypeDMA, kPipeTypeDMA}) {
+    HWPipeCaps pipe_caps;
+    pipe_caps.type = type;
+    pipe_caps.id = id++;
+    hw_res_info->hw_pipes.push_back(pipe_caps);
+  }
+  hw_res_info->num_vig_pipe = 4;
+  hw_res_info->num_dma_pipe = 4;
+  hw_res_info->num_blending_stages = 11;
+  hw_res_info->max_scale_up = 20;
+  hw_res_info->max_scale_down = 4;
+  hw_res_info->max_mixer_width = 2560;
+  hw_res_info->max_pipe_width = 2560;
+  hw_res_info->has_ubwc = true;
+  hw_res_info->has_qseed3 = true;
+  hw_res_info->is_src_split = true;
+}
+
+// Display configuration matching the GPU target of the recording.
+static bool GetDisplayConfig(const RecordedLayerStack &recorded, HWDisplayAttributes *attributes,
+                             HWPanelInfo *panel_info, HWMixerAttributes *mixer_attributes,
+                             DisplayConfigVariableInfo *fb_config) {
+  for (auto &layer : recorded.layers) {
+    if (layer.composition != kCompositionGPUTarget) {
+      continue;
+    }
+
+    fb_config->x_pixels = UINT32(layer.dst_rect.right - layer.dst_rect.left);
+    fb_config->y_pixels = UINT32(layer.dst_rect.bottom - layer.dst_rect.top);
+    fb_config->fps = 60;
+    fb_config->vsync_period_ns = 1000000000 / fb_config->fps;
+    static_cast<DisplayConfigVariableInfo &>(*attributes) = *fb_config;
+    mixer_attributes->width = fb_config->x_pixels;
+    mixer_attributes->height = fb_config->y_pixels;
+    panel_info->is_primary_panel = true;
+    panel_info->min_fps = panel_info->max_fps = fb_config->fps;
+    return true;
+  }
+
+  return false;
+}
+
+// Mirrors DisplayBase::BuildLayerStackStats and the per frame reset done by HWCDisplay.
+static bool PrepareFrame(RecordedLayerStack *recorded, HWLayers *hw_layers) {
+  hw_layers->Reset();
+  HWLayersInfo &info = hw_layers->info;
+  info.stack = &recorded->stack;
+  for (auto &layer : recorded->layers) {
+    if (!layer.buffer_map) {
+      layer.buffer_map = std::make_shared<LayerBufferMap>();
+    }
+    if (layer.composition == kCompositionGPUTarget) {
+      info.gpu_target_index = info.app_layer_count;
+    } else if (layer.composition == kCompositionStitchTarget) {
+      break;
+    } else {
+      layer.composition = kCompositionGPU;
+      layer.request = LayerRequest();
+      info.app_layer_count++;
+    }
+  }
+  info.stitch_target_index = info.gpu_target_index + 1;
+
+  return info.app_layer_count && info.gpu_target_index;
+}
+
+static int Run(const char *record_path, uint32_t iterations, bool use_extension) {
+  FILE *file = fopen(record_path, "r");
+  if (!file) {
+    fprintf(stderr, "Unable to open %s: %s\n", record_path, strerror(errno));
+    return -1;
+  }
+
+  std::vector<std::unique_ptr<RecordedLayerStack>> frames;
+  while (true) {
+    std::unique_ptr<RecordedLayerStack> recorded(new RecordedLayerStack());
+    if (!LayerStackRecorder::Read(file, recorded.get())) {
+      break;
+    }
+    frames.push_back(std::move(recorded));
+  }
+  fclose(file);
+
+  if (frames.empty()) {
+    fprintf(stderr, "No layer stacks in %s\n", record_path);
+    return -1;
+  }
+
+  HWResourceInfo hw_res_info;
+  HWDisplayAttributes attributes;
+  HWPanelInfo panel_info;
+  HWMixerAttributes mixer_attributes;
+  DisplayConfigVariableInfo fb_config;
+  GetResourceInfo(&hw_res_info);
+  if (!GetDisplayConfig(*frames.front(), &attributes, &panel_info, &mixer_attributes,
+                        &fb_config)) {
+    fprintf(stderr, "Recording has no GPU target layer\n");
+    return -1;
+  }
+
+  DynLib extension_lib;
+  ExtensionInterface *extension_intf = nullptr;
+  CreateExtensionInterface create_extension_intf = nullptr;
+  DestroyExtensionInterface destroy_extension_intf = nullptr;
+  if (use_extension) {
+    if (!extension_lib.Open(EXTENSION_LIBRARY_NAME) ||
+        !extension_lib.Sym(CREATE_EXTENSION_INTERFACE_NAME,
+                           reinterpret_cast<void **>(&create_extension_intf)) ||
+        !extension_lib.Sym(DESTROY_EXTENSION_INTERFACE_NAME,
+                           reinterpret_cast<void **>(&destroy_extension_intf)) ||
+        create_extension_intf(EXTENSION_VERSION_TAG, &extension_intf) != kErrorNone) {
+      fprintf(stderr, "Unable to load %s: %s\n", EXTENSION_LIBRARY_NAME, extension_lib.Error());
+      return -1;
+    }
+  }
+
+  const int32_t display_id = 0;
+  CompManager comp_manager;
+  Handle display_ctx = nullptr;
+  uint32_t default_clk_hz = 0;
+  if (comp_manager.Init(hw_res_info, extension_intf, nullptr, nullptr) != kErrorNone ||
+      comp_manager.RegisterDisplay(display_id, kBuiltIn, attributes, panel_info, mixer_attributes,
+                                   fb_config, &display_ctx, &default_clk_hz) != kErrorNone) {
+    fprintf(stderr, "Unable to set up the composition manager\n");
+    if (extension_intf) {
+      destroy_extension_intf(extension_intf);
+    }
+    return -1;
+  }
+
+  StageStats stats[kStageMax];
+  uint32_t frame_count = 0;
+  uint32_t failed_count = 0;
+  HWLayers hw_layers;
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    for (auto &recorded : frames) {
+      if (!PrepareFrame(recorded.get(), &hw_layers)) {
+        continue;
+      }
+
+      uint64_t start_ns = FrameTiming::Now();
+      comp_manager.PrePrepare(display_ctx, &hw_layers);
+      uint64_t prepare_ns = FrameTiming::Now();
+      DisplayError error = comp_manager.Prepare(display_ctx, &hw_layers);
+      uint64_t post_prepare_ns = FrameTiming::Now();
+      comp_manager.PostPrepare(display_ctx, &hw_layers);
+      uint64_t commit_ns = FrameTiming::Now();
+      if (error == kErrorNone) {
+        comp_manager.Commit(display_ctx, &hw_layers);
+      }
+      uint64_t post_commit_ns = FrameTiming::Now();
+      if (error == kErrorNone) {
+        comp_manager.PostCommit(display_ctx, &hw_layers);
+      }
+      uint64_t end_ns = FrameTiming::Now();
+
+      stats[kStagePrePrepare].Add(prepare_ns - start_ns);
+      stats[kStagePrepare].Add(post_prepare_ns - prepare_ns);
+      stats[kStageStrategy].Add(FrameTiming::GetLatest(display_id, kFrameStageStrategy));
+      stats[kStageResources].Add(FrameTiming::GetLatest(display_id, kFrameStageResources));
+      stats[kStagePostPrepare].Add(commit_ns - post_prepare_ns);
+      stats[kStageCommit].Add(post_commit_ns - commit_ns);
+      stats[kStagePostCommit].Add(end_ns - post_commit_ns);
+      frame_count++;
+      failed_count += (error != kErrorNone);
+    }
+  }
+
+  comp_manager.UnregisterDisplay(display_ctx);
+  comp_manager.Deinit();
+  if (extension_intf) {
+    destroy_extension_intf(extension_intf);
+  }
+
+  if (!frame_count) {
+    fprintf(stderr, "No replayable layer stacks in %s\n", record_path);
+    return -1;
+  }
+
+  printf("%zu layer stacks x %u iterations, %u frames, %u failed prepare, %s strategy\n",
+         frames.size(), iterations, frame_count, failed_count,
+         use_extension ? "extension" : "default");
+  printf("%-12s %14s %14s\n", "stage", "ns/frame", "max ns");
+  for (uint32_t i = 0; i < kStageMax; i++) {
+    printf("%-12s %14" PRIu64 " %14" PRIu64 "\n", kStageNames[i], stats[i].total_ns / frame_count,
+           stats[i].max_ns);
+  }
+
+  return 0;
+}
+
+}  // namespace sdm
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <layer stack record> [iterations] [--extension]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t iterations = 100;
+  bool use_extension = false;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--extension")) {
+      use_extension = true;
+    } else {
+      iterations = UINT32(std::max(1, atoi(argv[i])));
+    }
+  }
+
+  return (sdm::Run(argv[1], iterations, use_extension) == 0) ? 0 : 1;
+}
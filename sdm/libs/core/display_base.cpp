@@ -26,6 +26,7 @@
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/formats.h>
+#include <utils/frame_timing.h>
 #include <utils/rect.h>
 #include <utils/utils.h>
 
@@ -91,6 +92,8 @@ DisplayError DisplayBase::Init() {
   if (hw_info_intf_) {
     hw_info_intf_->GetHWResourceInfo(&hw_resource_info_);
   }
+  rotation_cost_model_.Init(hw_resource_info_);
+  multirect_packer_.Init(hw_resource_info_);
   auto max_mixer_stages = hw_resource_info_.num_blending_stages;
   int property_value = Debug::GetMaxPipesPerMixer(display_type_);
 
@@ -99,6 +102,7 @@ DisplayError DisplayBase::Init() {
   hw_intf_->GetActiveConfig(&active_index);
   hw_intf_->GetDisplayAttributes(active_index, &display_attributes_);
   fb_config_ = display_attributes_;
+  vsync_model_.Reset(display_attributes_.vsync_period_ns);
 
   error = Debug::GetMixerResolution(&mixer_attributes_.width, &mixer_attributes_.height);
   if (error == kErrorNone) {
@@ -175,6 +179,8 @@ DisplayError DisplayBase::Init() {
   Debug::Get()->GetProperty(DROP_SKEWED_VSYNC, &drop_vsync);
   drop_skewed_vsync_ = (drop_vsync == 1);
 
+  Debug::GetProperty(DISABLE_OCCLUSION_CULLING_PROP, &disable_occlusion_culling_);
+
   return kErrorNone;
 
 CleanupOnError:
@@ -241,6 +247,9 @@ DisplayError DisplayBase::BuildLayerStackStats(LayerStack *layer_stack) {
     return kErrorNoAppLayers;
   }
 
+  ComputeOcclusion();
+  multirect_packer_.Pack(&hw_layers_info);
+
   if (hw_layers_info.gpu_target_index) {
     return ValidateGPUTargetParams();
   }
@@ -248,6 +257,69 @@ DisplayError DisplayBase::BuildLayerStackStats(LayerStack *layer_stack) {
   return kErrorNone;
 }
 
+// Walks the app layers from the top down, collecting the frames of opaque layers. A layer whose
+// frame they cover entirely adds nothing to the output and is left out of composition. Where the
+// pipes support an exclusion rect, the covered parts of partly hidden layers are listed so that
+// the strategy can save their fetch bandwidth.
+void DisplayBase::ComputeOcclusion() {
+  const uint32_t kMaxOpaqueRects = 8;
+  HWLayersInfo &hw_layers_info = hw_layers_.info;
+  std::vector<Layer *> &layers = hw_layers_info.stack->layers;
+  hw_layers_info.occluded_index.clear();
+  hw_layers_info.layer_exts.clear();
+
+  if (disable_occlusion_culling_ || !hw_layers_info.gpu_target_index) {
+    return;
+  }
+
+  bool list_excl_rects = hw_resource_info_.has_excl_rect;
+  if (list_excl_rects) {
+    hw_layers_info.layer_exts.resize(hw_layers_info.app_layer_count);
+  }
+
+  LayerRect opaque_rects[kMaxOpaqueRects];
+  uint32_t opaque_count = 0;
+  for (uint32_t i = hw_layers_info.app_layer_count; i-- > 0;) {
+    Layer *layer = layers.at(i);
+    // Skip layers are composed by the client however SDM decides, and the content of a cursor
+    // may move without a new frame.
+    if (layer->flags.skip || layer->flags.cursor || !IsValid(layer->dst_rect)) {
+      continue;
+    }
+
+    LayerRect visible = layer->dst_rect;
+    for (uint32_t j = 0; j < opaque_count && IsValid(visible); j++) {
+      if (Contains(opaque_rects[j], visible)) {
+        visible = LayerRect();
+        break;
+      }
+      // Only trims rects covering a full edge, which keeps the visible part a single rect.
+      visible = Subtract(visible, opaque_rects[j]);
+      if (list_excl_rects) {
+        LayerRect excl = Intersection(layer->dst_rect, opaque_rects[j]);
+        if (IsValid(excl)) {
+          hw_layers_info.layer_exts.at(i).excl_rects.push_back(excl);
+        }
+      }
+    }
+
+    if (!IsValid(visible)) {
+      hw_layers_info.occluded_index.push_back(i);
+      if (list_excl_rects) {
+        hw_layers_info.layer_exts.at(i).excl_rects.clear();
+      }
+      DLOGV_IF(kTagDisplay, "Layer %d is occluded, display: %d-%d", i, display_id_,
+               display_type_);
+      continue;
+    }
+
+    if (layer->blending == kBlendingOpaque && layer->plane_alpha == 0xff &&
+        opaque_count < kMaxOpaqueRects) {
+      opaque_rects[opaque_count++] = layer->dst_rect;
+    }
+  }
+}
+
 DisplayError DisplayBase::ValidateGPUTargetParams() {
   HWLayersInfo &hw_layers_info = hw_layers_.info;
   Layer *gpu_target_layer = hw_layers_info.stack->layers.at(hw_layers_info.gpu_target_index);
@@ -289,8 +361,10 @@ DisplayError DisplayBase::ValidateGPUTargetParams() {
 
 DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
+  FrameTiming::ScopedStage stage_timing(display_id_, kFrameStagePrepare);
   DisplayError error = kErrorNone;
   needs_validate_ = true;
+  frame_prepared_ = true;
 
   DTRACE_SCOPED();
   // Allow prepare as pending doze/pending_power_on is handled as a part of draw cycle
@@ -351,6 +425,11 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
   if (color_mgr_)
     color_mgr_->Validate(&hw_layers_);
 
+  if (error == kErrorNone) {
+    UpdateRotationDecisions(layer_stack);
+    multirect_packer_.UpdateStats(hw_layers_);
+  }
+
   comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
 
   DLOGI_IF(kTagDisplay, "Exiting Prepare for display type : %d error: %d", display_type_, error);
@@ -359,6 +438,7 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
 
 DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
+  FrameTiming::ScopedStage stage_timing(display_id_, kFrameStageCommit);
   DisplayError error = kErrorNone;
 
   // Allow commit as pending doze/pending_power_on is handled as a part of draw cycle
@@ -395,6 +475,10 @@ DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
 
   error = hw_intf_->Commit(&hw_layers_);
   if (error != kErrorNone) {
+    if (error == kErrorTimeOut) {
+      // An earlier frame is stuck in the driver, capture its state before the client recovers.
+      HwRecovery(HWRecoveryEvent::kCapture);
+    }
     if (layer_stack->flags.fast_path && hw_layers_.info.fast_path_composition) {
       // If COMMIT fails on the Fast Path, set Safe Mode.
       DLOGE("COMMIT failed in Fast Path, set Safe Mode!");
@@ -404,6 +488,8 @@ DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
     return error;
   }
 
+  TraceComposition(layer_stack, !frame_prepared_);
+  frame_prepared_ = false;
   PostCommitLayerParams(layer_stack);
 
   if (partial_update_control_) {
@@ -583,13 +669,17 @@ DisplayError DisplayBase::SetDisplayState(DisplayState state, bool teardown,
       }
     }
 
-    error = comp_manager_->ReconfigureDisplay(display_comp_ctx_, display_attributes_,
-                                              hw_panel_info_, mixer_attributes_, fb_config_,
-                                              &(default_clock_hz_));
-    if (error != kErrorNone) {
-      return error;
+    // The panel keeps its mode through Doze and DozeSuspend, so the strategy cache and resource
+    // configuration stay valid. ReconfigureDisplay() below still catches any mode change.
+    if (state_ != kStateDoze && state_ != kStateDozeSuspend) {
+      error = comp_manager_->ReconfigureDisplay(display_comp_ctx_, display_attributes_,
+                                                hw_panel_info_, mixer_attributes_, fb_config_,
+                                                &(default_clock_hz_));
+      if (error != kErrorNone) {
+        return error;
+      }
+      cached_qos_data_.clock_hz = default_clock_hz_;
     }
-    cached_qos_data_.clock_hz = default_clock_hz_;
 
     active = true;
     break;
@@ -698,57 +788,20 @@ DisplayError DisplayBase::SetMaxMixerStages(uint32_t max_mixer_stages) {
   return error;
 }
 
-std::string DisplayBase::Dump() {
-  lock_guard<recursive_mutex> obj(recursive_mutex_);
+void DisplayBase::TakeDumpSnapshot(DumpLevel level, DumpSnapshot *snapshot) {
   HWDisplayAttributes attrib;
-  uint32_t active_index = 0;
-  uint32_t num_modes = 0;
-  std::ostringstream os;
 
-  hw_intf_->GetNumDisplayAttributes(&num_modes);
-  hw_intf_->GetActiveConfig(&active_index);
-  hw_intf_->GetDisplayAttributes(active_index, &attrib);
-
-  os << "device type:" << display_type_;
-  os << "\nstate: " << state_ << " vsync on: " << vsync_enable_
-     << " max. mixer stages: " << max_mixer_stages_;
-  os << "\nnum configs: " << num_modes << " active config index: " << active_index;
-  os << "\nDisplay Attributes:";
-  os << "\n Mode:" << (hw_panel_info_.mode == kModeVideo ? "Video" : "Command");
-  os << std::boolalpha;
-  os << " Primary:" << hw_panel_info_.is_primary_panel;
-  os << " DynFPS:" << hw_panel_info_.dynamic_fps;
-  os << "\n HDR Panel:" << hw_panel_info_.hdr_enabled;
-  os << " QSync:" << hw_panel_info_.qsync_support;
-  os << " DynBitclk:" << hw_panel_info_.dyn_bitclk_support;
-  os << "\n Left Split:" << hw_panel_info_.split_info.left_split
-     << " Right Split:" << hw_panel_info_.split_info.right_split;
-  os << "\n PartialUpdate:" << hw_panel_info_.partial_update;
-  if (hw_panel_info_.partial_update) {
-    os << "\n ROI Min w:" << hw_panel_info_.min_roi_width;
-    os << " Min h:" << hw_panel_info_.min_roi_height;
-    os << " NeedsMerge: " << hw_panel_info_.needs_roi_merge;
-    os << " Alignment: l:" << hw_panel_info_.left_align << " w:" << hw_panel_info_.width_align;
-    os << " t:" << hw_panel_info_.top_align << " b:" << hw_panel_info_.height_align;
-  }
-  os << "\n FPS min:" << hw_panel_info_.min_fps << " max:" << hw_panel_info_.max_fps
-     << " cur:" << display_attributes_.fps;
-  os << " TransferTime: " << hw_panel_info_.transfer_time_us << "us";
-  os << " MaxBrightness:" << hw_panel_info_.panel_max_brightness;
-  os << "\n Display WxH: " << display_attributes_.x_pixels << "x" << display_attributes_.y_pixels;
-  os << " MixerWxH: " << mixer_attributes_.width << "x" << mixer_attributes_.height;
-  os << " DPI: " << display_attributes_.x_dpi << "x" << display_attributes_.y_dpi;
-  os << " LM_Split: " << display_attributes_.is_device_split;
-  os << "\n vsync_period " << display_attributes_.vsync_period_ns;
-  os << " v_back_porch: " << display_attributes_.v_back_porch;
-  os << " v_front_porch: " << display_attributes_.v_front_porch;
-  os << " v_pulse_width: " << display_attributes_.v_pulse_width;
-  os << "\n v_total: " << display_attributes_.v_total;
-  os << " h_total: " << display_attributes_.h_total;
-  os << " clk: " << display_attributes_.clock_khz;
-  os << " Topology: " << display_attributes_.topology;
-  os << std::noboolalpha;
+  snapshot->state = state_;
+  snapshot->vsync_enable = vsync_enable_;
+  snapshot->max_mixer_stages = max_mixer_stages_;
+  hw_intf_->GetNumDisplayAttributes(&snapshot->num_modes);
+  hw_intf_->GetActiveConfig(&snapshot->active_index);
+  hw_intf_->GetDisplayAttributes(snapshot->active_index, &attrib);
+  snapshot->panel_info = hw_panel_info_;
+  snapshot->display_attributes = display_attributes_;
+  snapshot->mixer_attributes = mixer_attributes_;
 
+  std::ostringstream os;
   os << "\nCurrent Color Mode: " << current_color_mode_.c_str();
   os << "\nAvailable Color Modes:\n";
   for (auto it : color_mode_map_) {
@@ -760,38 +813,146 @@ std::string DisplayBase::Dump() {
     }
     os << "\n";
   }
+  snapshot->color_modes = os.str();
+
+  snapshot->has_fbid_stats = (hw_intf_->GetFbIdCacheStats(&snapshot->fbid_stats) == kErrorNone);
+  snapshot->has_qos_stats = (hw_intf_->GetQosVoteStats(&snapshot->qos_stats) == kErrorNone);
+  snapshot->has_pipe_stats = (comp_manager_->GetPipeBudgetStats(display_comp_ctx_,
+                              &snapshot->pipe_stats) == kErrorNone);
+  snapshot->multirect_stats = multirect_packer_.GetStats();
+
+  if (level == kDumpLevelPerf) {
+    return;
+  }
+
+  snapshot->rotation_decisions = rotation_decisions_;
 
-  uint32_t num_hw_layers = 0;
   if (hw_layers_.info.stack) {
-    num_hw_layers = UINT32(hw_layers_.info.hw_layers.size());
+    snapshot->num_hw_layers = UINT32(hw_layers_.info.hw_layers.size());
   }
 
-  if (num_hw_layers == 0) {
-    os << "\nNo hardware layers programmed";
-    return os.str();
+  if (snapshot->num_hw_layers == 0) {
+    return;
   }
 
   LayerBuffer *out_buffer = hw_layers_.info.stack->output_buffer;
   if (out_buffer) {
-    os << "\n Output buffer res: " << out_buffer->width << "x" << out_buffer->height
-       << " format: " << GetFormatString(out_buffer->format);
+    snapshot->has_output_buffer = true;
+    snapshot->output_width = out_buffer->width;
+    snapshot->output_height = out_buffer->height;
+    snapshot->output_format = out_buffer->format;
+  }
+  snapshot->left_frame_roi = hw_layers_.info.left_frame_roi;
+  snapshot->right_frame_roi = hw_layers_.info.right_frame_roi;
+  snapshot->partial_fb_roi = hw_layers_.info.partial_fb_roi;
+  SnapshotLayerRows(&snapshot->rows);
+}
+
+void DisplayBase::SnapshotLayerRows(std::vector<DumpLayerRow> *rows) {
+  uint32_t num_hw_layers = UINT32(hw_layers_.info.hw_layers.size());
+  const char *pipe_split[2] = { "Pipe-1", "Pipe-2" };
+  const char *rot_pipe[2] = { "Rot-inl-1", "Rot-inl-2" };
+
+  // Two pipe rows per layer are the common worst case, rotator rows are rare.
+  rows->reserve(num_hw_layers * 2);
+  for (uint32_t i = 0; i < num_hw_layers; i++) {
+    uint32_t layer_index = hw_layers_.info.index.at(i);
+    // sdm-layer from client layer stack
+    Layer *sdm_layer = hw_layers_.info.stack->layers.at(layer_index);
+    // hw-layer from hw layers info
+    Layer &hw_layer = hw_layers_.info.hw_layers.at(i);
+    LayerBuffer *input_buffer = &hw_layer.input_buffer;
+    HWLayerConfig &layer_config = hw_layers_.config[i];
+    HWRotatorSession &hw_rotator_session = layer_config.hw_rotator_session;
+    size_t first_row = rows->size();
+
+    for (uint32_t count = 0; count < hw_rotator_session.hw_block_count; count++) {
+      HWRotateInfo &rotate = hw_rotator_session.hw_rotate_info[count];
+      DumpLayerRow row;
+      row.kind = DumpLayerRow::kRotator;
+      row.format = GetFormatString(input_buffer->format);
+      snprintf(row.split, sizeof(row.split), "Rot-%s-%d", layer_config.use_inline_rot ?
+               "inl" : "off", count + 1);
+      row.width = input_buffer->width;
+      row.height = input_buffer->height;
+      row.src_roi = rotate.src_roi;
+      row.dst_roi = rotate.dst_roi;
+      rows->push_back(row);
+    }
+
+    if (hw_rotator_session.hw_block_count > 0) {
+      input_buffer = &hw_rotator_session.output_buffer;
+    }
+
+    if (layer_config.use_solidfill_stage) {
+      LayerRect &src_roi = layer_config.hw_solidfill_stage.roi;
+      DumpLayerRow row;
+      row.kind = DumpLayerRow::kSolidFill;
+      row.format = GetFormatString(input_buffer->format);
+      snprintf(row.split, sizeof(row.split), "%s", pipe_split[0]);
+      row.width = UINT32(src_roi.right);
+      row.height = UINT32(src_roi.bottom);
+      row.src_roi = src_roi;
+      row.dst_roi = src_roi;
+      row.z_order = layer_config.hw_solidfill_stage.z_order;
+      row.flags = hw_layer.flags.flags;
+      rows->push_back(row);
+    } else {
+      ColorMetaData &color_metadata = hw_layer.input_buffer.color_metadata;
+      for (uint32_t count = 0; count < 2; count++) {
+        HWPipeInfo &pipe = (count == 0) ? layer_config.left_pipe : layer_config.right_pipe;
+        if (!pipe.valid) {
+          continue;
+        }
+
+        DumpLayerRow row;
+        row.format = GetFormatString(input_buffer->format);
+        snprintf(row.split, sizeof(row.split), "%s",
+                 layer_config.use_inline_rot ? rot_pipe[count] : pipe_split[count]);
+        row.pipe_id = pipe.pipe_id;
+        row.width = input_buffer->width;
+        row.height = input_buffer->height;
+        row.src_roi = pipe.src_roi;
+        row.dst_roi = pipe.dst_roi;
+        row.z_order = pipe.z_order;
+        row.flags = pipe.flags;
+        row.horizontal_decimation = pipe.horizontal_decimation;
+        row.vertical_decimation = pipe.vertical_decimation;
+        row.color_primaries = INT(color_metadata.colorPrimaries);
+        row.range = INT(color_metadata.range);
+        row.transfer = INT(color_metadata.transfer);
+        rows->push_back(row);
+      }
+    }
+
+    // print the below only once per layer block, fill with spaces for rest.
+    if (rows->size() > first_row) {
+      rows->at(first_row).layer_index = INT(layer_index);
+      rows->at(first_row).comp_type = GetName(sdm_layer->composition);
+    }
   }
-  HWLayersInfo &layer_info = hw_layers_.info;
-  for (uint32_t i = 0; i < layer_info.left_frame_roi.size(); i++) {
-    LayerRect &l_roi = layer_info.left_frame_roi.at(i);
-    LayerRect &r_roi = layer_info.right_frame_roi.at(i);
+}
 
-    os << "\nROI(LTRB)#" << i << " LEFT(" << INT(l_roi.left) << " " << INT(l_roi.top) << " " <<
+void DisplayBase::FormatDumpLayers(const DumpSnapshot &snapshot, std::ostringstream *os) {
+  if (snapshot.has_output_buffer) {
+    *os << "\n Output buffer res: " << snapshot.output_width << "x" << snapshot.output_height
+        << " format: " << GetFormatString(snapshot.output_format);
+  }
+  for (uint32_t i = 0; i < snapshot.left_frame_roi.size(); i++) {
+    const LayerRect &l_roi = snapshot.left_frame_roi.at(i);
+    const LayerRect &r_roi = snapshot.right_frame_roi.at(i);
+
+    *os << "\nROI(LTRB)#" << i << " LEFT(" << INT(l_roi.left) << " " << INT(l_roi.top) << " " <<
       INT(l_roi.right) << " " << INT(l_roi.bottom) << ")";
     if (IsValid(r_roi)) {
-    os << " RIGHT(" << INT(r_roi.left) << " " << INT(r_roi.top) << " " << INT(r_roi.right) << " "
+    *os << " RIGHT(" << INT(r_roi.left) << " " << INT(r_roi.top) << " " << INT(r_roi.right) << " "
       << INT(r_roi.bottom) << ")";
     }
   }
 
-  LayerRect &fb_roi = layer_info.partial_fb_roi;
+  const LayerRect &fb_roi = snapshot.partial_fb_roi;
   if (IsValid(fb_roi)) {
-    os << "\nPartial FB ROI(LTRB):(" << INT(fb_roi.left) << " " << INT(fb_roi.top) << " " <<
+    *os << "\nPartial FB ROI(LTRB):(" << INT(fb_roi.left) << " " << INT(fb_roi.top) << " " <<
       INT(fb_roi.right) << " " << INT(fb_roi.bottom) << ")";
   }
 
@@ -799,122 +960,202 @@ std::string DisplayBase::Dump() {
   const char *newline = "\n|-----|---------------|-----------|------|-------------|--------------------------|---------------------|---------------------|----|------------|-----------|----|-----|----|";  //NOLINT
   const char *format  = "\n| %3s | %13s | %9s | %4d | %4d x %4d | %24s | %4d %4d %4d %4d | %4d %4d %4d %4d | %2s | %10s | %9s | %2s | %3s | %2s |";  //NOLINT
 
-  os << "\n";
-  os << newline;
-  os << header;
-  os << newline;
+  *os << "\n";
+  *os << newline;
+  *os << header;
+  *os << newline;
+
+  for (const DumpLayerRow &row : snapshot.rows) {
+    char idx[8] = { 0 };
+    char z_order[8] = "-";
+    char flags[16] = "-    ";
+    char decimation[16] = "-    ";
+    char color_primary[8] = "-";
+    char range[8] = "-";
+    char transfer[8] = "-";
+    char line[1024];
+
+    if (row.layer_index >= 0) {
+      snprintf(idx, sizeof(idx), "%d", row.layer_index);
+    }
+    if (row.kind != DumpLayerRow::kRotator) {
+      snprintf(z_order, sizeof(z_order), "%d", row.z_order);
+      snprintf(flags, sizeof(flags), "0x%08x", row.flags);
+      decimation[0] = color_primary[0] = range[0] = transfer[0] = 0;
+    }
+    if (row.kind == DumpLayerRow::kPipe) {
+      snprintf(decimation, sizeof(decimation), "%3d x %3d", row.horizontal_decimation,
+               row.vertical_decimation);
+      snprintf(color_primary, sizeof(color_primary), "%d", row.color_primaries);
+      snprintf(range, sizeof(range), "%d", row.range);
+      snprintf(transfer, sizeof(transfer), "%d", row.transfer);
+    }
 
-  for (uint32_t i = 0; i < num_hw_layers; i++) {
-    uint32_t layer_index = hw_layers_.info.index.at(i);
-    // sdm-layer from client layer stack
-    Layer *sdm_layer = hw_layers_.info.stack->layers.at(layer_index);
-    // hw-layer from hw layers info
-    Layer &hw_layer = hw_layers_.info.hw_layers.at(i);
-    LayerBuffer *input_buffer = &hw_layer.input_buffer;
-    HWLayerConfig &layer_config = hw_layers_.config[i];
-    HWRotatorSession &hw_rotator_session = layer_config.hw_rotator_session;
+    snprintf(line, sizeof(line), format, idx, row.comp_type, row.split, row.pipe_id,
+             row.width, row.height, row.format,
+             INT(row.src_roi.left), INT(row.src_roi.top), INT(row.src_roi.right),
+             INT(row.src_roi.bottom), INT(row.dst_roi.left), INT(row.dst_roi.top),
+             INT(row.dst_roi.right), INT(row.dst_roi.bottom),
+             z_order, flags, decimation, color_primary, range, transfer);
+    *os << line;
+  }
 
-    const char *comp_type = GetName(sdm_layer->composition);
-    const char *buffer_format = GetFormatString(input_buffer->format);
-    const char *pipe_split[2] = { "Pipe-1", "Pipe-2" };
-    const char *rot_pipe[2] = { "Rot-inl-1", "Rot-inl-2" };
-    char idx[8];
+  *os << newline << "\n";
+}
 
-    snprintf(idx, sizeof(idx), "%d", layer_index);
+std::string DisplayBase::Dump(DumpLevel level) {
+  DumpSnapshot snapshot;
+  {
+    lock_guard<recursive_mutex> obj(recursive_mutex_);
+    TakeDumpSnapshot(level, &snapshot);
+  }
 
-    for (uint32_t count = 0; count < hw_rotator_session.hw_block_count; count++) {
-      char row[1024];
-      HWRotateInfo &rotate = hw_rotator_session.hw_rotate_info[count];
-      LayerRect &src_roi = rotate.src_roi;
-      LayerRect &dst_roi = rotate.dst_roi;
-      char rot[12] = { 0 };
+  const HWPanelInfo &panel_info = snapshot.panel_info;
+  const HWDisplayAttributes &display_attributes = snapshot.display_attributes;
+  std::ostringstream os;
 
-      snprintf(rot, sizeof(rot), "Rot-%s-%d", layer_config.use_inline_rot ?
-               "inl" : "off", count + 1);
+  os << "device type:" << display_type_;
+  os << "\nstate: " << snapshot.state << " vsync on: " << snapshot.vsync_enable
+     << " max. mixer stages: " << snapshot.max_mixer_stages;
+  os << "\nnum configs: " << snapshot.num_modes << " active config index: "
+     << snapshot.active_index;
+  os << "\nDisplay Attributes:";
+  os << "\n Mode:" << (panel_info.mode == kModeVideo ? "Video" : "Command");
+  os << std::boolalpha;
+  os << " Primary:" << panel_info.is_primary_panel;
+  os << " DynFPS:" << panel_info.dynamic_fps;
+  os << "\n HDR Panel:" << panel_info.hdr_enabled;
+  os << " QSync:" << panel_info.qsync_support;
+  os << " DynBitclk:" << panel_info.dyn_bitclk_support;
+  os << "\n Left Split:" << panel_info.split_info.left_split
+     << " Right Split:" << panel_info.split_info.right_split;
+  os << "\n PartialUpdate:" << panel_info.partial_update;
+  if (panel_info.partial_update) {
+    os << "\n ROI Min w:" << panel_info.min_roi_width;
+    os << " Min h:" << panel_info.min_roi_height;
+    os << " NeedsMerge: " << panel_info.needs_roi_merge;
+    os << " Alignment: l:" << panel_info.left_align << " w:" << panel_info.width_align;
+    os << " t:" << panel_info.top_align << " b:" << panel_info.height_align;
+  }
+  os << "\n FPS min:" << panel_info.min_fps << " max:" << panel_info.max_fps
+     << " cur:" << display_attributes.fps;
+  os << " TransferTime: " << panel_info.transfer_time_us << "us";
+  os << " MaxBrightness:" << panel_info.panel_max_brightness;
+  os << "\n Display WxH: " << display_attributes.x_pixels << "x" << display_attributes.y_pixels;
+  os << " MixerWxH: " << snapshot.mixer_attributes.width << "x"
+     << snapshot.mixer_attributes.height;
+  os << " DPI: " << display_attributes.x_dpi << "x" << display_attributes.y_dpi;
+  os << " LM_Split: " << display_attributes.is_device_split;
+  os << "\n vsync_period " << display_attributes.vsync_period_ns;
+  os << " v_back_porch: " << display_attributes.v_back_porch;
+  os << " v_front_porch: " << display_attributes.v_front_porch;
+  os << " v_pulse_width: " << display_attributes.v_pulse_width;
+  os << "\n v_total: " << display_attributes.v_total;
+  os << " h_total: " << display_attributes.h_total;
+  os << " clk: " << display_attributes.clock_khz;
+  os << " Topology: " << display_attributes.topology;
+  os << std::noboolalpha;
 
-      snprintf(row, sizeof(row), format, idx, comp_type, rot,
-               0, input_buffer->width, input_buffer->height, buffer_format,
-               INT(src_roi.left), INT(src_roi.top), INT(src_roi.right), INT(src_roi.bottom),
-               INT(dst_roi.left), INT(dst_roi.top), INT(dst_roi.right), INT(dst_roi.bottom),
-               "-", "-    ", "-    ", "-", "-", "-");
-      os << row;
-      // print the below only once per layer block, fill with spaces for rest.
-      idx[0] = 0;
-      comp_type = "";
-    }
+  os << snapshot.color_modes;
 
-    if (hw_rotator_session.hw_block_count > 0) {
-      input_buffer = &hw_rotator_session.output_buffer;
-      buffer_format = GetFormatString(input_buffer->format);
-    }
+  if (snapshot.has_fbid_stats) {
+    const HWFbIdCacheStats &fbid_stats = snapshot.fbid_stats;
+    os << "FbId Cache: hits: " << fbid_stats.hits << " misses: " << fbid_stats.misses
+       << " evictions: " << fbid_stats.evictions << " prefetched: " << fbid_stats.prefetched
+       << "\n";
+  }
 
-    if (layer_config.use_solidfill_stage) {
-      LayerRect src_roi = layer_config.hw_solidfill_stage.roi;
-      const char *decimation = "";
-      char flags[16] = { 0 };
-      char z_order[8] = { 0 };
-      const char *color_primary = "";
-      const char *range = "";
-      const char *transfer = "";
-      char row[1024] = { 0 };
-
-      snprintf(z_order, sizeof(z_order), "%d", layer_config.hw_solidfill_stage.z_order);
-      snprintf(flags, sizeof(flags), "0x%08x", hw_layer.flags.flags);
-      snprintf(row, sizeof(row), format, idx, comp_type, pipe_split[0],
-               0, INT(src_roi.right), INT(src_roi.bottom),
-               buffer_format, INT(src_roi.left), INT(src_roi.top),
-               INT(src_roi.right), INT(src_roi.bottom), INT(src_roi.left),
-               INT(src_roi.top), INT(src_roi.right), INT(src_roi.bottom),
-               z_order, flags, decimation, color_primary, range, transfer);
-      os << row;
-      continue;
+  if (snapshot.has_qos_stats) {
+    const HWQosVoteStats &qos_stats = snapshot.qos_stats;
+    os << "QoS votes: frames: " << qos_stats.frames << " request changes: "
+       << qos_stats.request_changes << " vote changes: " << qos_stats.vote_changes << "\n";
+    if (qos_stats.ubwc_frames && qos_stats.ubwc_in_kbps) {
+      uint64_t saved_kbps = qos_stats.ubwc_in_kbps - qos_stats.ubwc_out_kbps;
+      os << "QoS UBWC scaling: frames: " << qos_stats.ubwc_frames << " DRAM AB saved: "
+         << (saved_kbps * 100 / qos_stats.ubwc_in_kbps) << "% last: "
+         << qos_stats.ubwc_last_pct << "%\n";
     }
+  }
 
-    for (uint32_t count = 0; count < 2; count++) {
-      char decimation[16] = { 0 };
-      char flags[16] = { 0 };
-      char z_order[8] = { 0 };
-      char color_primary[8] = { 0 };
-      char range[8] = { 0 };
-      char transfer[8] = { 0 };
-      bool rot = layer_config.use_inline_rot;
+  if (snapshot.has_pipe_stats) {
+    const CompManager::PipeBudgetStats &pipe_stats = snapshot.pipe_stats;
+    os << "Pipe budget: demand: " << pipe_stats.demand << " budget: " << pipe_stats.budget
+       << " of " << pipe_stats.total_pipes << " changes: " << pipe_stats.changes << "\n";
+  }
+
+  const MultiRectStats &multirect_stats = snapshot.multirect_stats;
+  if (multirect_stats.max_pairs && multirect_stats.frames) {
+    os << "Multirect: SDE layers: " << multirect_stats.sde_layers << " pairs in use: "
+       << multirect_stats.pairs_in_use << " planned: " << multirect_stats.pairs_planned << " of "
+       << multirect_stats.max_pairs << " per frame in use: " << std::fixed << std::setprecision(2)
+       << (FLOAT(multirect_stats.total_pairs_in_use) / FLOAT(multirect_stats.frames))
+       << " planned: "
+       << (FLOAT(multirect_stats.total_pairs_planned) / FLOAT(multirect_stats.frames)) << "\n";
+  }
 
-      HWPipeInfo &pipe = (count == 0) ? layer_config.left_pipe : layer_config.right_pipe;
+  if (level == kDumpLevelPerf) {
+    return os.str();
+  }
 
-      if (!pipe.valid) {
+  for (auto &decision : snapshot.rotation_decisions) {
+    RotationPath best = RotationCostModel::GetBestPath(decision.cost);
+    os << "Rotation: layer " << decision.layer_index << " path: "
+       << RotationCostModel::GetPathName(decision.path) << " best: "
+       << RotationCostModel::GetPathName(best) << " scores:";
+    for (uint32_t i = 0; i < kRotationPathMax; i++) {
+      const RotationCost &cost = decision.cost[i];
+      os << " " << RotationCostModel::GetPathName(RotationPath(i)) << ": ";
+      if (!cost.feasible) {
+        os << "-";
         continue;
       }
+      os << std::fixed << std::setprecision(2) << cost.score << " (" << INT(cost.bandwidth_mbps)
+         << " MBps " << INT(cost.clock_mhz) << " MHz " << cost.passes << " pass)";
+    }
+    os << "\n";
+  }
 
-      LayerRect src_roi = pipe.src_roi;
-      LayerRect &dst_roi = pipe.dst_roi;
+  if (snapshot.num_hw_layers == 0) {
+    os << "\nNo hardware layers programmed";
+    return os.str();
+  }
 
-      snprintf(z_order, sizeof(z_order), "%d", pipe.z_order);
-      snprintf(flags, sizeof(flags), "0x%08x", pipe.flags);
-      snprintf(decimation, sizeof(decimation), "%3d x %3d", pipe.horizontal_decimation,
-               pipe.vertical_decimation);
-      ColorMetaData &color_metadata = hw_layer.input_buffer.color_metadata;
-      snprintf(color_primary, sizeof(color_primary), "%d", color_metadata.colorPrimaries);
-      snprintf(range, sizeof(range), "%d", color_metadata.range);
-      snprintf(transfer, sizeof(transfer), "%d", color_metadata.transfer);
+  FormatDumpLayers(snapshot, &os);
 
-      char row[1024];
-      snprintf(row, sizeof(row), format, idx, comp_type, rot ? rot_pipe[count] : pipe_split[count],
-               pipe.pipe_id, input_buffer->width, input_buffer->height,
-               buffer_format, INT(src_roi.left), INT(src_roi.top),
-               INT(src_roi.right), INT(src_roi.bottom), INT(dst_roi.left),
-               INT(dst_roi.top), INT(dst_roi.right), INT(dst_roi.bottom),
-               z_order, flags, decimation, color_primary, range, transfer);
+  return os.str();
+}
+
+void DisplayBase::UpdateRotationDecisions(LayerStack *layer_stack) {
+  rotation_decisions_.clear();
 
-      os << row;
-      // print the below only once per layer block, fill with spaces for rest.
-      idx[0] = 0;
-      comp_type = "";
+  std::vector<Layer *> &layers = layer_stack->layers;
+  for (uint32_t i = 0; i < UINT32(layers.size()); i++) {
+    Layer *layer = layers.at(i);
+    if (layer->transform.rotation != 90.0f || layer->composition == kCompositionGPUTarget) {
+      continue;
     }
-  }
 
-  os << newline << "\n";
+    RotationDecision decision;
+    decision.layer_index = i;
+    decision.path = kRotationPathGPU;
+    for (uint32_t j = 0; j < UINT32(hw_layers_.info.index.size()); j++) {
+      if (hw_layers_.info.index.at(j) != i || layer->composition == kCompositionGPU) {
+        continue;
+      }
+      HWLayerConfig &layer_config = hw_layers_.config[j];
+      bool offline = !layer_config.use_inline_rot &&
+                     (layer_config.hw_rotator_session.mode == kRotatorOffline ||
+                      layer_config.hw_rotator_session.hw_block_count);
+      decision.path = offline ? kRotationPathOffline : kRotationPathInline;
+      break;
+    }
 
-  return os.str();
+    rotation_cost_model_.Evaluate(*layer, display_attributes_.fps, decision.cost);
+    DLOGV_IF(kTagDisplay, "Rotated layer %d on %s, cheapest is %s", i,
+             RotationCostModel::GetPathName(decision.path),
+             RotationCostModel::GetPathName(RotationCostModel::GetBestPath(decision.cost)));
+    rotation_decisions_.push_back(decision);
+  }
 }
 
 const char * DisplayBase::GetName(const LayerComposition &composition) {
@@ -929,6 +1170,56 @@ const char * DisplayBase::GetName(const LayerComposition &composition) {
   }
 }
 
+// One slice per committed frame carrying its composition decisions, so that why a frame went to
+// GPU is a trace query instead of a log search. Per layer: composition, SSPP ids of the left and
+// right pipes, whether the pipes scale and the rotator mode.
+void DisplayBase::TraceComposition(LayerStack *layer_stack, bool skip_validate) {
+  if (!DebugHandler::Get()->IsTraceEnabled()) {
+    return;
+  }
+
+  static const char *kRotatorModes[] = { "none", "offline", "inline" };
+  const HWLayersInfo &info = hw_layers_.info;
+  const HWQosData &qos = hw_layers_.qos_data;
+  std::ostringstream os;
+  os << "display=" << display_id_ << " layers=" << layer_stack->layers.size();
+  os << " skip_validate=" << skip_validate;
+  os << " idle_fallback=" << comp_manager_->IsIdleFallback(display_comp_ctx_);
+  os << " clk=" << qos.clock_hz << " core_ab=" << qos.core_ab_bps << " core_ib=" << qos.core_ib_bps;
+  os << " llcc_ab=" << qos.llcc_ab_bps << " llcc_ib=" << qos.llcc_ib_bps;
+  os << " dram_ab=" << qos.dram_ab_bps << " dram_ib=" << qos.dram_ib_bps;
+
+  // info.index maps the hardware layers, in stack order, to their layer stack index.
+  uint32_t hw_index = 0;
+  for (uint32_t i = 0; i < layer_stack->layers.size(); i++) {
+    os << " [" << i << " " << GetName(layer_stack->layers.at(i)->composition);
+    while (hw_index < info.index.size() && info.index.at(hw_index) < i) {
+      hw_index++;
+    }
+    if (hw_index < info.index.size() && info.index.at(hw_index) == i &&
+        hw_index < kMaxSDELayers) {
+      const HWLayerConfig &config = hw_layers_.config[hw_index];
+      bool scaled = false;
+      os << " pipes=";
+      for (const HWPipeInfo *pipe : { &config.left_pipe, &config.right_pipe }) {
+        if (!pipe->valid) {
+          continue;
+        }
+        os << ((pipe == &config.left_pipe) ? "" : "/") << pipe->pipe_id;
+        scaled |= (pipe->src_roi.right - pipe->src_roi.left) !=
+                  (pipe->dst_roi.right - pipe->dst_roi.left) ||
+                  (pipe->src_roi.bottom - pipe->src_roi.top) !=
+                  (pipe->dst_roi.bottom - pipe->dst_roi.top);
+      }
+      os << " scale=" << scaled << " rot=" << kRotatorModes[config.hw_rotator_session.mode];
+    }
+    os << "]";
+  }
+
+  DTRACE_BEGIN(os.str().c_str());
+  DTRACE_END();
+}
+
 DisplayError DisplayBase::ColorSVCRequestRoute(const PPDisplayAPIPayload &in_payload,
                                                PPDisplayAPIPayload *out_payload,
                                                PPPendingParams *pending_action) {
@@ -1208,7 +1499,13 @@ DisplayError DisplayBase::SetCursorPosition(int x, int y) {
   DisplayError error = comp_manager_->ValidateAndSetCursorPosition(display_comp_ctx_, &hw_layers_,
                                                                    x, y);
   if (error == kErrorNone) {
-    return hw_intf_->SetCursorPosition(&hw_layers_, x, y);
+    error = hw_intf_->SetCursorPosition(&hw_layers_, x, y);
+    if (error == kErrorNotSupported) {
+      // The move could not be committed on its own, so it goes with the next frame.
+      event_handler_->Refresh();
+      return kErrorNone;
+    }
+    return error;
   }
 
   return kErrorNone;
@@ -1335,6 +1632,9 @@ DisplayError DisplayBase::ReconfigureDisplay() {
     DisablePartialUpdateOneFrame();
   }
 
+  if (display_attributes.vsync_period_ns != display_attributes_.vsync_period_ns) {
+    vsync_model_.Reset(display_attributes.vsync_period_ns);
+  }
   display_attributes_ = display_attributes;
   mixer_attributes_ = mixer_attributes;
   hw_panel_info_ = hw_panel_info;
@@ -1679,7 +1979,16 @@ void DisplayBase::PostCommitLayerParams(LayerStack *layer_stack) {
               hw_layer.input_buffer.release_fence, sdm_layer->input_buffer.release_fence);
     }
   }
+  // Dropped layers were never read.
+  for (uint32_t index : hw_layers_.info.occluded_index) {
+    Layer *sdm_layer = layer_stack->layers.at(index);
+    if (sdm_layer->composition == kCompositionNone) {
+      sdm_layer->input_buffer.release_fence = nullptr;
+    }
+  }
   cached_qos_data_ = hw_layers_.qos_data;
+  layer_stack->qos_clock_hz = cached_qos_data_.clock_hz;
+  layer_stack->qos_dram_ib_bps = cached_qos_data_.dram_ib_bps;
 
   return;
 }
@@ -2115,6 +2424,32 @@ bool DisplayBase::GameEnhanceSupported() {
   return false;
 }
 
+DisplayError DisplayBase::PrefetchFbId(Layer *layer) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  if (!layer) {
+    return kErrorParameters;
+  }
+
+  if (layer->buffer_map == nullptr) {
+    layer->buffer_map = std::make_shared<LayerBufferMap>();
+  }
+
+  return hw_intf_->PrefetchFbId(layer);
+}
+
+DisplayError DisplayBase::GetPredictedVSync(int64_t *next_vsync_ns, int64_t *vsync_period_ns) {
+  if (!next_vsync_ns || !vsync_period_ns) {
+    return kErrorParameters;
+  }
+
+  // Hardware vsync timestamps are CLOCK_MONOTONIC, as is FrameTiming::Now().
+  if (!vsync_model_.Predict(static_cast<int64_t>(FrameTiming::Now()), next_vsync_ns, vsync_period_ns)) {
+    return kErrorNotSupported;
+  }
+
+  return kErrorNone;
+}
+
 DisplayError DisplayBase::OnMinHdcpEncryptionLevelChange(uint32_t min_enc_level) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   return hw_intf_->OnMinHdcpEncryptionLevelChange(min_enc_level);
@@ -28,9 +28,11 @@
 #include <core/display_interface.h>
 #include <private/strategy_interface.h>
 #include <private/color_interface.h>
+#include <utils/vsync_model.h>
 
 #include <map>
 #include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -38,6 +40,8 @@
 #include "comp_manager.h"
 #include "color_manager.h"
 #include "hw_events_interface.h"
+#include "multirect_packer.h"
+#include "rotation_cost.h"
 
 namespace sdm {
 
@@ -99,6 +103,9 @@ class DisplayBase : public DisplayInterface {
   virtual DisplayError GetSupportedDSIClock(std::vector<uint64_t> *bitclk_rates) {
     return kErrorNotSupported;
   }
+  virtual DisplayError SetDSIClockConstraints(const std::vector<uint64_t> &avoided_rates) {
+    return kErrorNotSupported;
+  }
   virtual DisplayError SetPanelLuminanceAttributes(float min_lum, float max_lum) {
     return kErrorNotSupported;
   }
@@ -141,7 +148,7 @@ class DisplayBase : public DisplayInterface {
     return kErrorNotSupported;
   }
   virtual DisplayError SetQSyncMode(QSyncMode qsync_mode) { return kErrorNotSupported; }
-  virtual std::string Dump();
+  virtual std::string Dump(DumpLevel level = kDumpLevelFull);
   virtual DisplayError InitializeColorModes();
   virtual DisplayError ControlIdlePowerCollapse(bool enable, bool synchronous) {
     return kErrorNotSupported;
@@ -158,6 +165,11 @@ class DisplayBase : public DisplayInterface {
   virtual bool CheckResourceState();
   virtual bool GameEnhanceSupported();
   virtual DisplayError GetQSyncMode(QSyncMode *qsync_mode) { return kErrorNotSupported; }
+  virtual DisplayError PrefetchFbId(Layer *layer);
+  virtual DisplayError GetPredictedVSync(int64_t *next_vsync_ns, int64_t *vsync_period_ns);
+  virtual DisplayError SetExpectedPresentTime(uint64_t expected_present_ns) {
+    return kErrorNotSupported;
+  }
   virtual DisplayError colorSamplingOn();
   virtual DisplayError colorSamplingOff();
   virtual DisplayError ReconfigureDisplay();
@@ -167,6 +179,7 @@ class DisplayBase : public DisplayInterface {
   const char *kBt2020Hlg = "bt2020_hlg";
   const char *kDisplayBt2020 = "display_bt2020";
   DisplayError BuildLayerStackStats(LayerStack *layer_stack);
+  void ComputeOcclusion();
   virtual DisplayError ValidateGPUTargetParams();
   void CommitLayerParams(LayerStack *layer_stack);
   void PostCommitLayerParams(LayerStack *layer_stack);
@@ -175,6 +188,7 @@ class DisplayBase : public DisplayInterface {
   void HwRecovery(const HWRecoveryEvent sdm_event_code);
 
   const char *GetName(const LayerComposition &composition);
+  void TraceComposition(LayerStack *layer_stack, bool skip_validate);
   bool NeedsMixerReconfiguration(LayerStack *layer_stack, uint32_t *new_mixer_width,
                                  uint32_t *new_mixer_height);
   DisplayError ReconfigureMixer(uint32_t width, uint32_t height);
@@ -194,6 +208,69 @@ class DisplayBase : public DisplayInterface {
   bool SetHdrModeAtStart(LayerStack *layer_stack);
   PrimariesTransfer GetBlendSpaceFromColorMode();
   bool IsHdrMode(const AttrVal &attr);
+  void UpdateRotationDecisions(LayerStack *layer_stack);
+
+  // Path the strategy took for a 90 degree rotated layer, next to the cost of each option.
+  struct RotationDecision {
+    uint32_t layer_index = 0;
+    RotationPath path = kRotationPathMax;
+    RotationCost cost[kRotationPathMax] = {};
+  };
+
+  // One row of the hardware layer table in Dump(), copied out of hw_layers_ under the lock.
+  struct DumpLayerRow {
+    enum Kind { kRotator, kSolidFill, kPipe };
+    Kind kind = kPipe;
+    int32_t layer_index = -1;  // Only set on the first row of a layer block
+    const char *comp_type = "";
+    const char *format = "";
+    char split[12] = {};
+    uint32_t pipe_id = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    LayerRect src_roi = {};
+    LayerRect dst_roi = {};
+    uint32_t z_order = 0;
+    uint32_t flags = 0;
+    uint8_t horizontal_decimation = 0;
+    uint8_t vertical_decimation = 0;
+    int32_t color_primaries = 0;
+    int32_t range = 0;
+    int32_t transfer = 0;
+  };
+
+  // State Dump() captures under recursive_mutex_, so that formatting runs after it is released.
+  struct DumpSnapshot {
+    DisplayState state = kStateOff;
+    bool vsync_enable = false;
+    uint32_t max_mixer_stages = 0;
+    uint32_t num_modes = 0;
+    uint32_t active_index = 0;
+    HWPanelInfo panel_info;
+    HWDisplayAttributes display_attributes;
+    HWMixerAttributes mixer_attributes;
+    std::string color_modes;  // Formatted in place, the mode maps are not worth copying
+    bool has_fbid_stats = false;
+    HWFbIdCacheStats fbid_stats = {};
+    bool has_qos_stats = false;
+    HWQosVoteStats qos_stats = {};
+    bool has_pipe_stats = false;
+    CompManager::PipeBudgetStats pipe_stats = {};
+    MultiRectStats multirect_stats = {};
+    std::vector<RotationDecision> rotation_decisions;
+    uint32_t num_hw_layers = 0;
+    bool has_output_buffer = false;
+    uint32_t output_width = 0;
+    uint32_t output_height = 0;
+    LayerBufferFormat output_format = kFormatInvalid;
+    std::vector<LayerRect> left_frame_roi;
+    std::vector<LayerRect> right_frame_roi;
+    LayerRect partial_fb_roi = {};
+    std::vector<DumpLayerRow> rows;
+  };
+  void TakeDumpSnapshot(DumpLevel level, DumpSnapshot *snapshot);
+  void SnapshotLayerRows(std::vector<DumpLayerRow> *rows);
+  void FormatDumpLayers(const DumpSnapshot &snapshot, std::ostringstream *os);
   void InsertBT2020PqHlgModes(const std::string &str_render_intent);
   DisplayError HandlePendingVSyncEnable(const shared_ptr<Fence> &retire_fence);
   DisplayError HandlePendingPowerState(const shared_ptr<Fence> &retire_fence);
@@ -214,6 +291,7 @@ class DisplayBase : public DisplayInterface {
   Handle display_comp_ctx_ = 0;
   HWLayers hw_layers_;
   bool needs_validate_ = true;
+  bool frame_prepared_ = false;  // Prepare ran since the last commit, else validate was skipped.
   bool vsync_enable_ = false;
   uint32_t max_mixer_stages_ = 0;
   HWInfoInterface *hw_info_intf_ = NULL;
@@ -239,6 +317,7 @@ class DisplayBase : public DisplayInterface {
   std::string current_color_mode_ = "hal_native";
   bool hw_recovery_logs_captured_ = false;
   int disable_hw_recovery_dump_ = 0;
+  int disable_occlusion_culling_ = 0;
   HWQosData cached_qos_data_;
   uint32_t default_clock_hz_ = 0;
   bool drop_hw_vsync_ = false;
@@ -250,6 +329,10 @@ class DisplayBase : public DisplayInterface {
   bool pending_power_on_ = false;
   QSyncMode qsync_mode_ = kQSyncModeNone;
   bool needs_avr_update_ = false;
+  VSyncModel vsync_model_;  // Fed by the hardware vsync events of the derived displays
+  RotationCostModel rotation_cost_model_;
+  std::vector<RotationDecision> rotation_decisions_;  // Of the last prepared frame
+  MultiRectPacker multirect_packer_;
 
   static Locker display_power_reset_lock_;
   static bool display_power_reset_pending_;
@@ -22,14 +22,20 @@
 * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
 #include <utils/rect.h>
+#include <utils/thread_policy.h>
 #include <utils/utils.h>
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <map>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -121,13 +127,43 @@ DisplayError DisplayBuiltIn::Init() {
   DebugHandler::Get()->GetProperty(DISABLE_DYNAMIC_FPS, &value);
   disable_dyn_fps_ = (value == 1);
 
+  value = 0;
+  DebugHandler::Get()->GetProperty(DISABLE_AUTO_MIXER_SCALING_PROP, &value);
+  auto_mixer_scaling_ = (value != 1) && hw_resource_info_.hw_dest_scalar_info.count &&
+                        !custom_mixer_resolution_;
+
+  value = 0;
+  DebugHandler::Get()->GetProperty(DISABLE_IDLE_PC_PREWAKE_PROP, &value);
+  ipc_prewake_ = (value != 1) && (hw_panel_info_.mode == kModeCommand);
+
+  value = 0;
+  DebugHandler::Get()->GetProperty(ENABLE_NULL_PRESENT_PROP, &value);
+  enable_null_present_ = (value == 1);
+
+  value = INT(self_refresh_static_frames_);
+  DebugHandler::Get()->GetProperty(SELF_REFRESH_STATIC_FRAMES_PROP, &value);
+  self_refresh_static_frames_ = UINT32(std::max(value, 0));
+
+  value = 0;
+  DebugHandler::Get()->GetProperty(FAST_PANEL_RECOVERY_PROP, &value);
+  fast_panel_recovery_ = (value == 1);
+
+  value = 0;
+  DebugHandler::Get()->GetProperty(ADAPTIVE_DSI_CLOCK_PROP, &value);
+  adaptive_dsi_clock_ = (value == 1) && hw_panel_info_.dyn_bitclk_support;
+
+  char ladder[256] = {};
+  Debug::GetProperty(THERMAL_LADDER_PROP, ladder);
+  ParseThermalLadder(ladder);
+
   return error;
 }
 
 DisplayError DisplayBuiltIn::Deinit() {
-  lock_guard<recursive_mutex> obj(recursive_mutex_);
-
+  // Ahead of the display lock, DPPS callbacks made from its notify thread take that lock too.
   dpps_info_.Deinit();
+
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
   return DisplayBase::Deinit();
 }
 
@@ -140,12 +176,38 @@ DisplayError DisplayBuiltIn::Prepare(LayerStack *layer_stack) {
   uint32_t display_height = display_attributes_.y_pixels;
 
   DTRACE_SCOPED();
-  if (NeedsMixerReconfiguration(layer_stack, &new_mixer_width, &new_mixer_height)) {
+  null_present_ = false;
+  UpdateSelfRefresh(layer_stack);
+  if (ipc_active_) {
+    PrewakeIdlePowerCollapse(FrameTiming::Now());
+  }
+  if (thermal_ladder_.size() > 1) {
+    UpdateThermalStep(FrameTiming::Now());
+  }
+
+  bool needs_mixer_reconfig = NeedsThermalMixerScaling(&new_mixer_width, &new_mixer_height);
+  if (!needs_mixer_reconfig && !thermal_mixer_active_) {
+    needs_mixer_reconfig = auto_mixer_scaling_ ?
+        NeedsAutoMixerScaling(layer_stack, &new_mixer_width, &new_mixer_height) :
+        NeedsMixerReconfiguration(layer_stack, &new_mixer_width, &new_mixer_height);
+  }
+  if (needs_mixer_reconfig) {
     error = ReconfigureMixer(new_mixer_width, new_mixer_height);
     if (error != kErrorNone) {
       ReconfigureMixer(display_width, display_height);
+      auto_mixer_active_ = false;
+      auto_mixer_frames_ = 0;
+      if (thermal_mixer_active_) {
+        DLOGW("Thermal step %d cannot lower the mixer, dropping its mixer action", thermal_step_);
+        thermal_ladder_[thermal_step_].mixer_scale = 100;
+        thermal_mixer_active_ = false;
+      }
     }
   } else {
+    if (CanNullPresent(layer_stack)) {
+      null_present_ = true;
+      return kErrorNone;
+    }
     if (CanSkipDisplayPrepare(layer_stack)) {
       hw_layers_.hw_avr_info.update = needs_avr_update_;
       hw_layers_.hw_avr_info.mode = GetAvrMode(qsync_mode_);
@@ -154,7 +216,7 @@ DisplayError DisplayBuiltIn::Prepare(LayerStack *layer_stack) {
   }
 
   // Clean hw layers for reuse.
-  hw_layers_ = HWLayers();
+  hw_layers_.Reset();
 
   hw_layers_.hw_avr_info.update = needs_avr_update_;
   hw_layers_.hw_avr_info.mode = GetAvrMode(qsync_mode_);
@@ -237,6 +299,19 @@ DisplayError DisplayBuiltIn::Commit(LayerStack *layer_stack) {
 
   DTRACE_SCOPED();
 
+  if (reset_panel_) {
+    RecoverPanel();
+  }
+
+  // The panel already holds this frame, hand back the state of the commit that put it there.
+  if (null_present_) {
+    null_present_ = false;
+    null_presents_++;
+    layer_stack->retire_fence = previous_retire_fence_;
+    DLOGV_IF(kTagDisplay, "Null present on display %d-%d", display_id_, display_type_);
+    return kErrorNone;
+  }
+
   // Enabling auto refresh is async and needs to happen before commit ioctl
   if (hw_panel_info_.mode == kModeCommand) {
     bool enable = (app_layer_count == 1) && layer_stack->flags.single_buffered_layer_present;
@@ -272,7 +347,40 @@ DisplayError DisplayBuiltIn::Commit(LayerStack *layer_stack) {
     DppsProcessOps(kDppsSetFeature, &histogramIRQ, sizeof(histogramIRQ));
   }
 
+  // First frame after idle power collapse pays for the wake up, unless it was pre-woken.
+  bool ipc_wake = ipc_active_ || ipc_prewoken_;
+  uint64_t commit_start_ns = FrameTiming::Now();
+  if (ipc_active_) {
+    ExitIdlePowerCollapse(commit_start_ns);
+  }
+
+  committed_handles_.clear();
   error = DisplayBase::Commit(layer_stack);
+  if (error == kErrorNone && (enable_null_present_ || self_refresh_static_frames_)) {
+    CacheCommittedBuffers(layer_stack);
+  }
+  if (panel_recovered_) {
+    LogPanelRecovery(FrameTiming::Now());
+  }
+  if (error == kErrorNone && adaptive_dsi_clock_) {
+    UpdateDSIClock();
+  }
+
+  if (ipc_wake) {
+    uint64_t commit_ns = FrameTiming::Now() - commit_start_ns;
+    if (ipc_prewoken_) {
+      ipc_prewakes_++;
+      ipc_prewake_ns_ += commit_ns;
+      if (!vsync_enable_) {
+        hw_events_intf_->SetEventState(HWEvent::VSYNC, false);
+      }
+      ipc_prewoken_ = false;
+    } else {
+      ipc_cold_wakes_++;
+      ipc_cold_wake_ns_ += commit_ns;
+    }
+  }
+
   if (error != kErrorNone) {
     return error;
   }
@@ -355,6 +463,7 @@ DisplayError DisplayBuiltIn::SetDisplayState(DisplayState state, bool teardown,
     SetDeferredFpsConfig();
   }
 
+  committed_handles_.clear();
   error = DisplayBase::SetDisplayState(state, teardown, release_fence);
   if (error != kErrorNone) {
     return error;
@@ -512,6 +621,11 @@ DisplayError DisplayBuiltIn::SetRefreshRate(uint32_t refresh_rate, bool final_ra
     return kErrorParameters;
   }
 
+  uint32_t thermal_max_fps = thermal_ladder_.empty() ? 0 : thermal_ladder_[thermal_step_].max_fps;
+  if (thermal_max_fps && refresh_rate > thermal_max_fps) {
+    refresh_rate = std::max(thermal_max_fps, hw_panel_info_.min_fps);
+  }
+
   if (handle_idle_timeout_ && !final_rate) {
     refresh_rate = hw_panel_info_.min_fps;
   }
@@ -540,6 +654,7 @@ DisplayError DisplayBuiltIn::SetRefreshRate(uint32_t refresh_rate, bool final_ra
 }
 
 DisplayError DisplayBuiltIn::VSync(int64_t timestamp) {
+  vsync_model_.AddSample(timestamp);
   if (vsync_enable_ && !drop_hw_vsync_) {
     DisplayEventVSync vsync;
     vsync.timestamp = timestamp;
@@ -568,8 +683,158 @@ void DisplayBuiltIn::PingPongTimeout() {
 
 void DisplayBuiltIn::ThermalEvent(int64_t thermal_level) {
   event_handler_->HandleEvent(kThermalEvent);
-  lock_guard<recursive_mutex> obj(recursive_mutex_);
-  comp_manager_->ProcessThermalEvent(display_comp_ctx_, thermal_level);
+  bool step_changed = false;
+  {
+    lock_guard<recursive_mutex> obj(recursive_mutex_);
+    comp_manager_->ProcessThermalEvent(display_comp_ctx_, thermal_level);
+    thermal_level_ = thermal_level;
+    step_changed = (thermal_ladder_.size() > 1) && (GetThermalStep(thermal_level) != thermal_step_);
+  }
+
+  // The ladder moves with the next frame.
+  if (step_changed) {
+    event_handler_->Refresh();
+  }
+}
+
+void DisplayBuiltIn::ParseThermalLadder(const char *ladder) {
+  thermal_ladder_.assign(1, ThermalStep());
+  thermal_step_ = 0;
+  thermal_step_start_ns_ = FrameTiming::Now();
+
+  std::istringstream steps(ladder);
+  std::string step_str;
+  while (std::getline(steps, step_str, ';')) {
+    size_t colon = step_str.find(':');
+    ThermalStep step;
+    step.level = strtoll(step_str.c_str(), nullptr, 10);
+    if (colon == std::string::npos || step.level <= 0) {
+      DLOGW("Invalid thermal step '%s'", step_str.c_str());
+      continue;
+    }
+
+    std::istringstream actions(step_str.substr(colon + 1));
+    std::string action;
+    while (std::getline(actions, action, ',')) {
+      uint32_t value = 0;
+      if (sscanf(action.c_str(), "fps=%u", &value) == 1) {
+        step.max_fps = value;
+      } else if (sscanf(action.c_str(), "stages=%u", &value) == 1) {
+        step.max_mixer_stages = value;
+      } else if (sscanf(action.c_str(), "mixer=%u", &value) == 1 && value && value <= 100) {
+        step.mixer_scale = value;
+      } else {
+        DLOGW("Invalid thermal action '%s' for level %d", action.c_str(), INT32(step.level));
+      }
+    }
+    thermal_ladder_.push_back(step);
+  }
+
+  std::sort(thermal_ladder_.begin() + 1, thermal_ladder_.end(),
+            [](const ThermalStep &a, const ThermalStep &b) { return a.level < b.level; });
+
+  // Each step keeps the limits of the steps below it unless it tightens them.
+  for (size_t i = 2; i < thermal_ladder_.size(); i++) {
+    ThermalStep &step = thermal_ladder_[i];
+    const ThermalStep &prev = thermal_ladder_[i - 1];
+    if (prev.max_fps && (!step.max_fps || prev.max_fps < step.max_fps)) {
+      step.max_fps = prev.max_fps;
+    }
+    if (prev.max_mixer_stages &&
+        (!step.max_mixer_stages || prev.max_mixer_stages < step.max_mixer_stages)) {
+      step.max_mixer_stages = prev.max_mixer_stages;
+    }
+    step.mixer_scale = std::min(step.mixer_scale, prev.mixer_scale);
+  }
+
+  for (size_t i = 1; i < thermal_ladder_.size(); i++) {
+    const ThermalStep &step = thermal_ladder_[i];
+    DLOGI("Thermal step %zu: level %d fps %d stages %d mixer %d%%", i, INT32(step.level),
+          step.max_fps, step.max_mixer_stages, step.mixer_scale);
+  }
+}
+
+uint32_t DisplayBuiltIn::GetThermalStep(int64_t thermal_level) {
+  uint32_t step = 0;
+  for (uint32_t i = 1; i < thermal_ladder_.size(); i++) {
+    if (thermal_ladder_[i].level <= thermal_level) {
+      step = i;
+    }
+  }
+
+  return step;
+}
+
+void DisplayBuiltIn::UpdateThermalStep(uint64_t now_ns) {
+  uint32_t step = GetThermalStep(thermal_level_);
+  if (step >= thermal_step_) {
+    thermal_cooler_since_ns_ = 0;
+    if (step == thermal_step_) {
+      return;
+    }
+  } else {
+    // Hysteresis: hotter levels apply at once, cooler ones once they have held for a while.
+    if (!thermal_cooler_since_ns_) {
+      thermal_cooler_since_ns_ = now_ns;
+    }
+    if (now_ns - thermal_cooler_since_ns_ < kThermalStepDownHoldNs) {
+      return;
+    }
+    thermal_cooler_since_ns_ = 0;
+  }
+
+  DLOGI("Thermal level %d, moving from step %d to %d", INT32(thermal_level_), thermal_step_,
+        step);
+  thermal_ladder_[thermal_step_].residency_ns += now_ns - thermal_step_start_ns_;
+  thermal_ladder_[step].entries++;
+  thermal_step_ = step;
+  thermal_step_start_ns_ = now_ns;
+  ApplyThermalMixerStages();
+}
+
+void DisplayBuiltIn::ApplyThermalMixerStages() {
+  uint32_t max_mixer_stages = max_mixer_stages_;
+  if (thermal_ladder_[thermal_step_].max_mixer_stages) {
+    max_mixer_stages = std::min(max_mixer_stages, thermal_ladder_[thermal_step_].max_mixer_stages);
+  }
+  comp_manager_->SetMaxMixerStages(display_comp_ctx_, max_mixer_stages);
+}
+
+bool DisplayBuiltIn::NeedsThermalMixerScaling(uint32_t *new_mixer_width,
+                                              uint32_t *new_mixer_height) {
+  uint32_t display_width = display_attributes_.x_pixels;
+  uint32_t display_height = display_attributes_.y_pixels;
+  uint32_t scale = thermal_ladder_.empty() ? 100 : thermal_ladder_[thermal_step_].mixer_scale;
+  const HWDestScalarInfo &ds_info = hw_resource_info_.hw_dest_scalar_info;
+
+  uint32_t align_x = display_attributes_.is_device_split ? 4 : 2;
+  uint32_t width = FloorToMultipleOf(display_width * scale / 100, align_x);
+  uint32_t height = FloorToMultipleOf(display_height * scale / 100, UINT32(2));
+  uint32_t num_ds = std::max(mixer_attributes_.dest_scaler_blocks_used, UINT32(1));
+  bool can_scale = (scale < 100) && ds_info.count && !req_mixer_width_ && width && height &&
+                   (display_width <= width * ds_info.max_scale_up) &&
+                   (display_height <= height * ds_info.max_scale_up) &&
+                   (!ds_info.max_input_width || (width <= ds_info.max_input_width * num_ds));
+  if (!can_scale) {
+    if (!thermal_mixer_active_) {
+      return false;
+    }
+    // Left the step, run the mixer at panel resolution again.
+    thermal_mixer_active_ = false;
+    width = display_width;
+    height = display_height;
+    DLOGI("Thermal step %d, restoring mixer to %dx%d", thermal_step_, width, height);
+  } else if (!thermal_mixer_active_) {
+    thermal_mixer_active_ = true;
+    auto_mixer_active_ = false;
+    auto_mixer_frames_ = 0;
+    DLOGI("Thermal step %d, lowering mixer to %dx%d", thermal_step_, width, height);
+  }
+
+  *new_mixer_width = width;
+  *new_mixer_height = height;
+
+  return (width != mixer_attributes_.width || height != mixer_attributes_.height);
 }
 
 void DisplayBuiltIn::IdlePowerCollapse() {
@@ -577,16 +842,139 @@ void DisplayBuiltIn::IdlePowerCollapse() {
     event_handler_->HandleEvent(kIdlePowerCollapse);
     lock_guard<recursive_mutex> obj(recursive_mutex_);
     comp_manager_->ProcessIdlePowerCollapse(display_comp_ctx_);
+    if (!ipc_active_) {
+      ipc_active_ = true;
+      ipc_entry_ns_ = FrameTiming::Now();
+      ipc_entries_++;
+    }
   }
 }
 
-void DisplayBuiltIn::PanelDead() {
-  event_handler_->HandleEvent(kPanelDeadEvent);
-  event_handler_->Refresh();
+DisplayError DisplayBuiltIn::SetMaxMixerStages(uint32_t max_mixer_stages) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  DisplayError error = DisplayBase::SetMaxMixerStages(max_mixer_stages);
+  if (error == kErrorNone && !thermal_ladder_.empty()) {
+    ApplyThermalMixerStages();
+  }
+
+  return error;
+}
+
+DisplayError DisplayBuiltIn::SetExpectedPresentTime(uint64_t expected_present_ns) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
+  if (!ipc_prewake_) {
+    return kErrorNotSupported;
+  }
+
+  expected_present_ns_ = expected_present_ns;
+  if (ipc_active_) {
+    PrewakeIdlePowerCollapse(FrameTiming::Now());
+  }
+
+  return kErrorNone;
+}
+
+void DisplayBuiltIn::PrewakeIdlePowerCollapse(uint64_t now_ns) {
+  if (!ipc_prewake_ || !active_ || !expected_present_ns_) {
+    return;
+  }
+
+  // Waking up too early only burns power until the frame shows up, so wait until the expected
+  // present time is within a vsync. Prepare of the frame checks again.
+  if (expected_present_ns_ > now_ns + display_attributes_.vsync_period_ns) {
+    return;
+  }
+
+  // A vblank request powers the display core back up, the event is not forwarded unless the
+  // client enabled vsync.
+  if (!vsync_enable_ && hw_events_intf_->SetEventState(HWEvent::VSYNC, true) != kErrorNone) {
+    return;
+  }
+
+  DTRACE_SCOPED();
+  DLOGV_IF(kTagDisplay, "Pre-wake %uus ahead of expected present",
+           expected_present_ns_ > now_ns ? UINT32((expected_present_ns_ - now_ns) / 1000) : 0);
+  ipc_prewoken_ = true;
+  expected_present_ns_ = 0;
+  ExitIdlePowerCollapse(now_ns);
+}
+
+void DisplayBuiltIn::ExitIdlePowerCollapse(uint64_t now_ns) {
+  ipc_residency_ns_ += now_ns - ipc_entry_ns_;
+  ipc_active_ = false;
+}
+
+std::string DisplayBuiltIn::Dump(DumpLevel level) {
+  std::ostringstream os;
+  // DisplayBase formats its snapshot without the lock, the few counters below are read under it.
+  os << DisplayBase::Dump(level);
+
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+
+  if (ipc_entries_) {
+    uint64_t residency_ns = ipc_residency_ns_;
+    if (ipc_active_) {
+      residency_ns += FrameTiming::Now() - ipc_entry_ns_;
+    }
+    os << "\nIdle PC: entries: " << ipc_entries_ << " residency: " << residency_ns / 1000000
+       << "ms pre-wake: " << ipc_prewake_;
+    os << "\n Wake commit latency: cold: " << ipc_cold_wakes_ << " avg "
+       << (ipc_cold_wakes_ ? ipc_cold_wake_ns_ / ipc_cold_wakes_ / 1000 : 0) << "us"
+       << " pre-woken: " << ipc_prewakes_ << " avg "
+       << (ipc_prewakes_ ? ipc_prewake_ns_ / ipc_prewakes_ / 1000 : 0) << "us\n";
+  }
+
+  if (null_presents_) {
+    os << "\nNull presents: " << null_presents_ << "\n";
+  }
+  if (self_refresh_entries_) {
+    os << "Self refresh: entries: " << self_refresh_entries_ << " after "
+       << self_refresh_static_frames_ << " static frames, active: " << self_refresh_ << "\n";
+  }
+  if (adaptive_dsi_clock_) {
+    uint64_t bit_clk_rate = 0;
+    hw_intf_->GetDynamicDSIClock(&bit_clk_rate);
+    os << "Adaptive DSI clock: " << bit_clk_rate << " changes: " << dsi_clock_changes_
+       << " pinned: " << dsi_clock_pinned_ << " avoided: " << avoided_dsi_clocks_.size() << "\n";
+  }
+  if (panel_recoveries_) {
+    os << "Panel recoveries: " << panel_recoveries_ << " avg "
+       << panel_recovery_total_ns_ / panel_recoveries_ / 1000 << "us max "
+       << panel_recovery_max_ns_ / 1000 << "us\n";
+  }
+
+  if (thermal_ladder_.size() > 1) {
+    os << "\nThermal ladder: level " << thermal_level_ << " step " << thermal_step_;
+    for (uint32_t i = 0; i < thermal_ladder_.size(); i++) {
+      const ThermalStep &step = thermal_ladder_[i];
+      uint64_t residency_ns = step.residency_ns;
+      if (i == thermal_step_) {
+        residency_ns += FrameTiming::Now() - thermal_step_start_ns_;
+      }
+      os << "\n step " << i << " level " << step.level << " fps " << step.max_fps << " stages "
+         << step.max_mixer_stages << " mixer " << step.mixer_scale << "%: entries "
+         << step.entries << " residency " << residency_ns / 1000000 << "ms";
+    }
+    os << "\n";
+  }
+
+  return os.str();
+}
+
+void DisplayBuiltIn::PanelDead() {
+  bool reset_panel = false;
   {
-    reset_panel_ = true;
+    lock_guard<recursive_mutex> obj(recursive_mutex_);
+    panel_dead_ns_ = FrameTiming::Now();
+    // The next commit power cycles the panel. Doze states would not survive the power on.
+    reset_panel = fast_panel_recovery_ && (state_ == kStateOn) && !pending_power_on_;
+    reset_panel_ = reset_panel;
   }
+
+  if (!reset_panel) {
+    event_handler_->HandleEvent(kPanelDeadEvent);
+  }
+  event_handler_->Refresh();
 }
 
 // HWEventHandler overload, not DisplayBase
@@ -838,6 +1226,7 @@ void DppsInfo::Init(DppsPropIntf *intf, const std::string &panel_name) {
   }
 
   display_id_.push_back(info_payload.display_id);
+  StartNotifyThread();
   DLOGI("Register display id %d successfully", info_payload.display_id);
   return;
 
@@ -847,6 +1236,7 @@ exit:
 }
 
 void DppsInfo::Deinit() {
+  StopNotifyThread();
   if (dpps_intf_) {
     dpps_intf_->Deinit();
     dpps_intf_ = NULL;
@@ -855,10 +1245,77 @@ void DppsInfo::Deinit() {
 }
 
 void DppsInfo::DppsNotifyOps(enum DppsNotifyOps op, void *payload, size_t size) {
-  int ret = 0;
-  ret = dpps_intf_->DppsNotifyOps(op, payload, size);
-  if (ret)
-    DLOGE("DppsNotifyOps op %d error %d", op, ret);
+  if (!notify_thread_.joinable()) {
+    return;
+  }
+
+  if (size > kNotifyPayloadSize || (size && !payload)) {
+    DLOGE("Invalid payload for op %d size %zu", op, size);
+    return;
+  }
+
+  uint32_t tail = notify_tail_.load(std::memory_order_relaxed);
+  if (tail - notify_head_.load(std::memory_order_acquire) == kNotifyQueueSize) {
+    DLOGW("DPPS is %d notifications behind, dropping op %d", kNotifyQueueSize, op);
+    return;
+  }
+
+  NotifyEvent &event = notify_queue_[tail % kNotifyQueueSize];
+  event.op = op;
+  event.size = size;
+  if (size) {
+    memcpy(event.payload, payload, size);
+  }
+  notify_tail_.store(tail + 1, std::memory_order_release);
+  sem_post(&notify_sem_);
+}
+
+void DppsInfo::StartNotifyThread() {
+  if (notify_thread_.joinable()) {
+    return;
+  }
+
+  notify_head_ = 0;
+  notify_tail_ = 0;
+  notify_exit_ = false;
+  sem_init(&notify_sem_, 0, 0);
+  notify_thread_ = std::thread(&DppsInfo::NotifyThread, this);
+}
+
+void DppsInfo::StopNotifyThread() {
+  if (!notify_thread_.joinable()) {
+    return;
+  }
+
+  notify_exit_ = true;
+  sem_post(&notify_sem_);
+  notify_thread_.join();
+  sem_destroy(&notify_sem_);
+}
+
+void DppsInfo::NotifyThread() {
+  ThreadPolicy::Apply(kThreadClassBackground, "SDM_DppsNotify");
+
+  while (true) {
+    if (sem_wait(&notify_sem_) && errno == EINTR) {
+      continue;
+    }
+    if (notify_exit_) {
+      break;
+    }
+
+    uint32_t head = notify_head_.load(std::memory_order_relaxed);
+    if (head == notify_tail_.load(std::memory_order_acquire)) {
+      continue;
+    }
+
+    NotifyEvent &event = notify_queue_[head % kNotifyQueueSize];
+    int ret = dpps_intf_->DppsNotifyOps(event.op, event.payload, event.size);
+    if (ret) {
+      DLOGE("DppsNotifyOps op %d error %d", event.op, ret);
+    }
+    notify_head_.store(head + 1, std::memory_order_release);
+  }
 }
 
 DisplayError DisplayBuiltIn::HandleSecureEvent(SecureEvent secure_event, LayerStack *layer_stack) {
@@ -930,6 +1387,10 @@ DisplayError DisplayBuiltIn::SetDynamicDSIClock(uint64_t bit_clk_rate) {
   std::vector<uint64_t> &clk_rates = hw_panel_info_.bitclk_rates;
   GetDynamicDSIClock(&current_clk);
   bool valid = std::find(clk_rates.begin(), clk_rates.end(), bit_clk_rate) != clk_rates.end();
+  if (valid && adaptive_dsi_clock_) {
+    // An explicit choice stands until the client hands it back with SetDSIClockConstraints().
+    dsi_clock_pinned_ = true;
+  }
   if (current_clk == bit_clk_rate || !valid) {
     DLOGI("Invalid setting %d, Clk. already set %d", !valid, (current_clk == bit_clk_rate));
     return kErrorNone;
@@ -938,6 +1399,21 @@ DisplayError DisplayBuiltIn::SetDynamicDSIClock(uint64_t bit_clk_rate) {
   return hw_intf_->SetDynamicDSIClock(bit_clk_rate);
 }
 
+DisplayError DisplayBuiltIn::SetDSIClockConstraints(const std::vector<uint64_t> &avoided_rates) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  if (!adaptive_dsi_clock_) {
+    return kErrorNotSupported;
+  }
+
+  avoided_dsi_clocks_ = avoided_rates;
+  dsi_clock_pinned_ = false;
+  dsi_clock_frames_ = 0;
+  dsi_clock_needed_ = 0;
+  event_handler_->Refresh();
+
+  return kErrorNone;
+}
+
 DisplayError DisplayBuiltIn::GetDynamicDSIClock(uint64_t *bit_clk_rate) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   if (!hw_panel_info_.dyn_bitclk_support) {
@@ -947,6 +1423,124 @@ DisplayError DisplayBuiltIn::GetDynamicDSIClock(uint64_t *bit_clk_rate) {
   return hw_intf_->GetDynamicDSIClock(bit_clk_rate);
 }
 
+// Lowest supported bit clock of at least needed_rate that is not avoided, else the highest one.
+uint64_t DisplayBuiltIn::GetDSIClockFor(uint64_t needed_rate) {
+  uint64_t lowest = 0;
+  uint64_t highest = 0;
+  for (uint64_t rate : hw_panel_info_.bitclk_rates) {
+    if (std::find(avoided_dsi_clocks_.begin(), avoided_dsi_clocks_.end(), rate) !=
+        avoided_dsi_clocks_.end()) {
+      continue;
+    }
+    highest = std::max(highest, rate);
+    if (rate >= needed_rate && (!lowest || rate < lowest)) {
+      lowest = rate;
+    }
+  }
+
+  return lowest ? lowest : highest;
+}
+
+// The supported bit clocks of a command mode panel all carry a full frame at its highest refresh
+// rate, so what a frame needs scales with the share of the panel in its ROI and with the current
+// refresh rate. The clock goes up as soon as a frame needs more, and down once a lower one has
+// sufficed for kDSIClockDownFrames frames, as each change costs a full frame update.
+void DisplayBuiltIn::UpdateDSIClock() {
+  std::vector<uint64_t> &clk_rates = hw_panel_info_.bitclk_rates;
+  uint64_t current_clk = 0;
+  if (dsi_clock_pinned_ || (hw_panel_info_.mode != kModeCommand) || (clk_rates.size() < 2) ||
+      !hw_panel_info_.max_fps || (hw_intf_->GetDynamicDSIClock(&current_clk) != kErrorNone)) {
+    return;
+  }
+
+  float panel_area = FLOAT(mixer_attributes_.width) * FLOAT(mixer_attributes_.height);
+  float roi_area = 0.0f;
+  for (auto *frame_roi : {&hw_layers_.info.left_frame_roi, &hw_layers_.info.right_frame_roi}) {
+    for (const LayerRect &roi : *frame_roi) {
+      roi_area += (roi.right - roi.left) * (roi.bottom - roi.top);
+    }
+  }
+  float share = (roi_area > 0.0f && panel_area > 0.0f) ? std::min(roi_area / panel_area, 1.0f) :
+                1.0f;
+  uint64_t max_clk = *std::max_element(clk_rates.begin(), clk_rates.end());
+  uint64_t needed_clk = UINT64(FLOAT(max_clk) * share * FLOAT(display_attributes_.fps) /
+                               FLOAT(hw_panel_info_.max_fps) * kDSIClockHeadroom);
+  dsi_clock_needed_ = std::max(dsi_clock_needed_, needed_clk);
+  dsi_clock_frames_++;
+
+  uint64_t now_ns = FrameTiming::Now();
+  bool avoided = std::find(avoided_dsi_clocks_.begin(), avoided_dsi_clocks_.end(), current_clk) !=
+                 avoided_dsi_clocks_.end();
+  uint64_t target_clk = current_clk;
+  if (avoided || needed_clk > current_clk) {
+    target_clk = GetDSIClockFor(needed_clk);
+  } else if (dsi_clock_frames_ >= kDSIClockDownFrames) {
+    if (now_ns - dsi_clock_change_ns_ >= kDSIClockHoldNs) {
+      target_clk = GetDSIClockFor(dsi_clock_needed_);
+    }
+    dsi_clock_frames_ = 0;
+    dsi_clock_needed_ = 0;
+  }
+
+  if (!target_clk || (target_clk == current_clk) ||
+      (hw_intf_->SetDynamicDSIClock(target_clk) != kErrorNone)) {
+    return;
+  }
+
+  // The new clock takes effect with a mode switch on the next commit, which updates the full frame.
+  DisablePartialUpdateOneFrame();
+  DLOGI_IF(kTagDisplay, "DSI clock %" PRIu64 " -> %" PRIu64 " for ROI share %.2f at %d fps",
+           current_clk, target_clk, share, display_attributes_.fps);
+  dsi_clock_frames_ = 0;
+  dsi_clock_needed_ = 0;
+  dsi_clock_change_ns_ = now_ns;
+  dsi_clock_changes_++;
+}
+
+// Unlike the power reset of kPanelDeadEvent, which takes every display through SetDisplayState()
+// off and on, only the panel and its DSI link are power cycled here. The display stays on to SDM,
+// so the prepared layers, strategy cache and buffer registrations carry over and the frame being
+// committed goes out right after. Times of each step are logged for fleet analysis.
+void DisplayBuiltIn::RecoverPanel() {
+  reset_panel_ = false;
+
+  panel_recovery_ns_[0] = FrameTiming::Now();
+  DisplayError error = hw_intf_->PowerOff(false /* teardown */);
+  panel_recovery_ns_[1] = FrameTiming::Now();
+  if (error == kErrorNone) {
+    error = hw_intf_->PowerOn(cached_qos_data_, nullptr /* release_fence */);
+  }
+  panel_recovery_ns_[2] = FrameTiming::Now();
+  if (error != kErrorNone) {
+    DLOGE("Panel recovery of display %d-%d failed with error = %d, resetting display power",
+          display_id_, display_type_, error);
+    event_handler_->HandleEvent(kPanelDeadEvent);
+    return;
+  }
+
+  // The panel lost its frame with the power, the next one has to be transferred in full.
+  DisablePartialUpdateOneFrame();
+  if (null_present_) {
+    // A null present would leave the panel blank, have the frame after it transferred instead.
+    event_handler_->Refresh();
+  }
+  panel_recovered_ = true;
+}
+
+void DisplayBuiltIn::LogPanelRecovery(uint64_t commit_end_ns) {
+  panel_recovered_ = false;
+  uint64_t total_ns = commit_end_ns - panel_dead_ns_;
+  panel_recoveries_++;
+  panel_recovery_total_ns_ += total_ns;
+  panel_recovery_max_ns_ = std::max(panel_recovery_max_ns_, total_ns);
+  DLOGI("Panel recovery of display %d-%d: event to commit %" PRIu64 "us power off %" PRIu64
+        "us power on %" PRIu64 "us commit %" PRIu64 "us total %" PRIu64 "us", display_id_,
+        display_type_, (panel_recovery_ns_[0] - panel_dead_ns_) / 1000,
+        (panel_recovery_ns_[1] - panel_recovery_ns_[0]) / 1000,
+        (panel_recovery_ns_[2] - panel_recovery_ns_[1]) / 1000,
+        (commit_end_ns - panel_recovery_ns_[2]) / 1000, total_ns / 1000);
+}
+
 void DisplayBuiltIn::ResetPanel() {
   DisplayError status = kErrorNone;
   shared_ptr<Fence> release_fence = nullptr;
@@ -1038,6 +1632,183 @@ bool DisplayBuiltIn::CanCompareFrameROI(LayerStack *layer_stack) {
   return surface_damage;
 }
 
+void DisplayBuiltIn::UpdateFrameIntervalStats() {
+  uint64_t now = FrameTiming::Now();
+  uint64_t interval = now - last_prepare_ns_;
+  last_prepare_ns_ = now;
+
+  if (interval > kMaxFrameIntervalNs || !frame_interval_mean_) {
+    frame_interval_mean_ = (interval > kMaxFrameIntervalNs) ? 0.0f : FLOAT(interval);
+    frame_interval_var_ = 0.0f;
+    return;
+  }
+
+  // Exponentially weighted mean and variance over roughly the last 16 frames.
+  float delta = FLOAT(interval) - frame_interval_mean_;
+  frame_interval_mean_ += delta / 16.0f;
+  frame_interval_var_ += (delta * delta - frame_interval_var_) / 16.0f;
+}
+
+bool DisplayBuiltIn::GetAutoMixerResolution(LayerStack *layer_stack, uint32_t *width,
+                                            uint32_t *height) {
+  uint32_t display_width = display_attributes_.x_pixels;
+  uint32_t display_height = display_attributes_.y_pixels;
+  uint32_t fb_width = fb_config_.x_pixels;
+  uint32_t fb_height = fb_config_.y_pixels;
+  LayerRect fb_rect = {0.0f, 0.0f, FLOAT(fb_width), FLOAT(fb_height)};
+  const HWDestScalarInfo &ds_info = hw_resource_info_.hw_dest_scalar_info;
+
+  // Look for a full screen layer rendered below the panel resolution, such as a game surface.
+  Layer *scene_layer = nullptr;
+  for (Layer *layer : layer_stack->layers) {
+    if (layer->composition == kCompositionGPUTarget || layer->transform.rotation != 0.0f) {
+      continue;
+    }
+    uint32_t layer_width = UINT32(layer->src_rect.right - layer->src_rect.left);
+    uint32_t layer_height = UINT32(layer->src_rect.bottom - layer->src_rect.top);
+    if (IsCongruent(layer->dst_rect, fb_rect) && layer_width < display_width &&
+        layer_height < display_height) {
+      scene_layer = layer;
+      break;
+    }
+  }
+
+  if (!scene_layer) {
+    return false;
+  }
+
+  // Match the mixer to the content, keeping the aspect ratio of the frame buffer.
+  uint32_t align_x = display_attributes_.is_device_split ? 4 : 2;
+  uint32_t layer_height = UINT32(scene_layer->src_rect.bottom - scene_layer->src_rect.top);
+  uint32_t mixer_width = FloorToMultipleOf(UINT32((FLOAT(fb_width) / FLOAT(fb_height)) *
+                                           layer_height), align_x);
+  uint32_t mixer_height = FloorToMultipleOf(layer_height, UINT32(2));
+  if (!mixer_width || !mixer_height) {
+    return false;
+  }
+
+  // Dest scaler has to be able to bring the mixer back up to the panel resolution.
+  uint32_t num_ds = std::max(mixer_attributes_.dest_scaler_blocks_used, UINT32(1));
+  if ((display_width > mixer_width * ds_info.max_scale_up) ||
+      (display_height > mixer_height * ds_info.max_scale_up) ||
+      (ds_info.max_input_width && (mixer_width > ds_info.max_input_width * num_ds))) {
+    return false;
+  }
+
+  *width = mixer_width;
+  *height = mixer_height;
+
+  return true;
+}
+
+bool DisplayBuiltIn::NeedsAutoMixerScaling(LayerStack *layer_stack, uint32_t *new_mixer_width,
+                                           uint32_t *new_mixer_height) {
+  UpdateFrameIntervalStats();
+
+  // An explicitly requested mixer resolution always wins.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool has_scene = !req_mixer_width_ && GetAutoMixerResolution(layer_stack, &width, &height);
+
+  if (!auto_mixer_active_) {
+    float jitter = frame_interval_mean_ ?
+                   (std::sqrt(frame_interval_var_) / frame_interval_mean_) : 0.0f;
+    auto_mixer_frames_ = (has_scene && jitter > kAutoMixerJitterThreshold) ?
+                         (auto_mixer_frames_ + 1) : 0;
+    if (auto_mixer_frames_ < kAutoMixerEngageFrames) {
+      return NeedsMixerReconfiguration(layer_stack, new_mixer_width, new_mixer_height);
+    }
+
+    DLOGI("Frame interval jitter %.2f, lowering mixer to %dx%d", jitter, width, height);
+    auto_mixer_active_ = true;
+  } else if (!has_scene) {
+    // Content went away, run the mixer at panel resolution again.
+    width = display_attributes_.x_pixels;
+    height = display_attributes_.y_pixels;
+    auto_mixer_active_ = false;
+    auto_mixer_frames_ = 0;
+    DLOGI("Restoring mixer to %dx%d", width, height);
+  }
+
+  *new_mixer_width = width;
+  *new_mixer_height = height;
+
+  return (width != mixer_attributes_.width || height != mixer_attributes_.height);
+}
+
+void DisplayBuiltIn::UpdateSelfRefresh(LayerStack *layer_stack) {
+  if (!self_refresh_static_frames_ || (hw_panel_info_.mode != kModeCommand)) {
+    return;
+  }
+
+  bool updating = layer_stack->flags.geometry_changed;
+  for (Layer *layer : layer_stack->layers) {
+    updating |= layer->flags.updating;
+  }
+
+  // The next update is committed as usual, which takes the panel out of refreshing itself.
+  if (updating) {
+    if (self_refresh_) {
+      DLOGV_IF(kTagDisplay, "Display %d-%d leaves self refresh", display_id_, display_type_);
+    }
+    static_frames_ = 0;
+    self_refresh_ = false;
+    return;
+  }
+
+  if (!self_refresh_ && (++static_frames_ >= self_refresh_static_frames_)) {
+    DLOGV_IF(kTagDisplay, "Display %d-%d enters self refresh after %u static frames",
+             display_id_, display_type_, static_frames_);
+    self_refresh_ = true;
+    self_refresh_entries_++;
+  }
+}
+
+bool DisplayBuiltIn::CanNullPresent(LayerStack *layer_stack) {
+  // Video mode panels refresh on their own, only command mode panels pay a transfer per commit.
+  // The vsync source is left alone, its retire fences time the client's vsync model.
+  if ((!enable_null_present_ && !self_refresh_) || (hw_panel_info_.mode != kModeCommand) ||
+      first_cycle_ || needs_validate_ || !active_ || pending_doze_ || pending_power_on_ ||
+      vsync_enable_ || vsync_enable_pending_ || needs_avr_update_ || pending_brightness_ ||
+      switch_to_cmd_ || disable_pu_one_frame_ || dpps_pu_nofiy_pending_ ||
+      deferred_config_.IsDeferredState() || (trigger_mode_debug_ != kFrameTriggerMax) ||
+      comp_manager_->IsSafeMode()) {
+    return false;
+  }
+
+  if (layer_stack->flags.geometry_changed || layer_stack->flags.config_changed ||
+      layer_stack->flags.single_buffered_layer_present || layer_stack->output_buffer ||
+      (layer_stack->layers.size() != committed_handles_.size()) ||
+      (color_mgr_ && color_mgr_->NeedsPartialUpdateDisable())) {
+    return false;
+  }
+
+  // Same buffers with no new acquire fence and no damage, the frame ROI would be empty.
+  // The client target arrives after Prepare, so frames that need one are always committed.
+  for (uint32_t i = 0; i < layer_stack->layers.size(); i++) {
+    Layer *layer = layer_stack->layers.at(i);
+    if ((layer->composition == kCompositionGPU) ||
+        (layer->input_buffer.handle_id != committed_handles_.at(i)) ||
+        layer->input_buffer.acquire_fence || layer->update_mask.any() ||
+        layer->dirty_regions.empty()) {
+      return false;
+    }
+    for (auto &rect : layer->dirty_regions) {
+      if (IsValid(rect)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void DisplayBuiltIn::CacheCommittedBuffers(LayerStack *layer_stack) {
+  for (Layer *layer : layer_stack->layers) {
+    committed_handles_.push_back(layer->input_buffer.handle_id);
+  }
+}
+
 bool DisplayBuiltIn::CanSkipDisplayPrepare(LayerStack *layer_stack) {
   if (!CanCompareFrameROI(layer_stack)) {
     return false;
@@ -26,7 +26,10 @@
 #define __DISPLAY_BUILTIN_H__
 
 #include <core/dpps_interface.h>
+#include <semaphore.h>
+#include <atomic>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "display_base.h"
@@ -83,12 +86,43 @@ class DppsInfo {
   bool disable_pu_ = false;
 
  private:
+  // Notifications are queued by the commit thread and handed to the DPPS library by a worker, so
+  // its algorithms never run on the commit path. One producer and one consumer, no locks.
+  static const uint32_t kNotifyQueueSize = 16;
+  static const size_t kNotifyPayloadSize = 16;
+
+  struct NotifyEvent {
+    enum DppsNotifyOps op = kDppsNotifyMax;
+    size_t size = 0;
+    uint8_t payload[kNotifyPayloadSize] = {};
+  };
+
+  void StartNotifyThread();
+  void StopNotifyThread();
+  void NotifyThread();
+
   const char *kDppsLib_ = "libdpps.so";
   DynLib dpps_impl_lib_;
   static DppsInterface *dpps_intf_;
   static std::vector<int32_t> display_id_;
   std::mutex lock_;
   DppsInterface *(*GetDppsInterface)() = NULL;
+  NotifyEvent notify_queue_[kNotifyQueueSize];
+  std::atomic<uint32_t> notify_head_ {0};
+  std::atomic<uint32_t> notify_tail_ {0};
+  std::atomic<bool> notify_exit_ {false};
+  sem_t notify_sem_ = {};
+  std::thread notify_thread_;
+};
+
+// Actions taken from a thermal level on. Zero limits keep the normal configuration.
+struct ThermalStep {
+  int64_t level = 0;
+  uint32_t max_fps = 0;
+  uint32_t max_mixer_stages = 0;
+  uint32_t mixer_scale = 100;  // Mixer size in percent of the panel, brought back by dest scaler
+  uint64_t entries = 0;
+  uint64_t residency_ns = 0;
 };
 
 class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
@@ -123,11 +157,15 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   virtual DisplayError SetDynamicDSIClock(uint64_t bit_clk_rate);
   virtual DisplayError GetDynamicDSIClock(uint64_t *bit_clk_rate);
   virtual DisplayError GetSupportedDSIClock(std::vector<uint64_t> *bitclk_rates);
+  virtual DisplayError SetDSIClockConstraints(const std::vector<uint64_t> &avoided_rates);
   virtual DisplayError SetFrameTriggerMode(FrameTriggerMode mode);
   virtual DisplayError SetBLScale(uint32_t level);
   virtual DisplayError GetQSyncMode(QSyncMode *qsync_mode);
   virtual DisplayError colorSamplingOn();
   virtual DisplayError colorSamplingOff();
+  virtual DisplayError SetExpectedPresentTime(uint64_t expected_present_ns);
+  virtual DisplayError SetMaxMixerStages(uint32_t max_mixer_stages);
+  virtual std::string Dump(DumpLevel level = kDumpLevelFull);
 
   // Implement the HWEventHandlers
   virtual DisplayError VSync(int64_t timestamp);
@@ -151,13 +189,38 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
  private:
   bool CanCompareFrameROI(LayerStack *layer_stack);
   bool CanSkipDisplayPrepare(LayerStack *layer_stack);
+  void UpdateSelfRefresh(LayerStack *layer_stack);
+  void RecoverPanel();
+  void LogPanelRecovery(uint64_t commit_end_ns);
+  void UpdateDSIClock();
+  uint64_t GetDSIClockFor(uint64_t needed_rate);
+  bool CanNullPresent(LayerStack *layer_stack);
+  void CacheCommittedBuffers(LayerStack *layer_stack);
   HWAVRModes GetAvrMode(QSyncMode mode);
   bool CanDeferFpsConfig(uint32_t fps);
   void SetDeferredFpsConfig();
   void GetFpsConfig(HWDisplayAttributes *display_attributes, HWPanelInfo *panel_info);
   void UpdateDisplayModeParams();
+  bool NeedsAutoMixerScaling(LayerStack *layer_stack, uint32_t *new_mixer_width,
+                             uint32_t *new_mixer_height);
+  bool GetAutoMixerResolution(LayerStack *layer_stack, uint32_t *width, uint32_t *height);
+  void UpdateFrameIntervalStats();
+  void PrewakeIdlePowerCollapse(uint64_t now_ns);
+  void ExitIdlePowerCollapse(uint64_t now_ns);
+  void ParseThermalLadder(const char *ladder);
+  uint32_t GetThermalStep(int64_t thermal_level);
+  void UpdateThermalStep(uint64_t now_ns);
+  void ApplyThermalMixerStages();
+  bool NeedsThermalMixerScaling(uint32_t *new_mixer_width, uint32_t *new_mixer_height);
 
   const uint32_t kPuTimeOutMs = 1000;
+  const uint32_t kAutoMixerEngageFrames = 30;
+  const float kAutoMixerJitterThreshold = 0.1f;  // Frame interval deviation relative to its mean
+  const uint64_t kMaxFrameIntervalNs = 100000000;  // Longer gaps are idle time, not frames
+  const uint64_t kThermalStepDownHoldNs = 5000000000;  // Cooler levels must last this long
+  const uint32_t kDSIClockDownFrames = 120;     // Frames a lower bit clock must suffice for
+  const uint64_t kDSIClockHoldNs = 2000000000;  // Minimum time between bit clock reductions
+  const float kDSIClockHeadroom = 1.1f;
   std::vector<HWEvent> event_list_;
   bool avr_prop_disabled_ = false;
   bool switch_to_cmd_ = false;
@@ -185,6 +248,51 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   sde_drm::DppsFeaturePayload histogramIRQ;
   void initColorSamplingState();
   DeferFpsConfig deferred_config_ = {};
+  bool auto_mixer_scaling_ = false;  // Lower the mixer for janky full screen content
+  bool auto_mixer_active_ = false;
+  uint32_t auto_mixer_frames_ = 0;   // Consecutive janky frames seen
+  uint64_t last_prepare_ns_ = 0;
+  float frame_interval_mean_ = 0.0f;  // Moving average of the frame interval in ns
+  float frame_interval_var_ = 0.0f;
+  bool ipc_prewake_ = false;      // Wake from idle power collapse ahead of expected frames
+  bool ipc_active_ = false;       // Idle power collapsed since the last wake up
+  bool ipc_prewoken_ = false;     // Vsync requested to wake up ahead of the next commit
+  uint64_t ipc_entry_ns_ = 0;
+  uint64_t expected_present_ns_ = 0;
+  uint64_t ipc_entries_ = 0;
+  uint64_t ipc_residency_ns_ = 0;
+  uint64_t ipc_cold_wakes_ = 0;    // First commits after collapse without a pre-wake
+  uint64_t ipc_cold_wake_ns_ = 0;
+  uint64_t ipc_prewakes_ = 0;      // First commits after collapse following a pre-wake
+  uint64_t ipc_prewake_ns_ = 0;
+  std::vector<ThermalStep> thermal_ladder_;  // By level, starting with the nominal step
+  int64_t thermal_level_ = 0;
+  uint32_t thermal_step_ = 0;
+  uint64_t thermal_step_start_ns_ = 0;
+  uint64_t thermal_cooler_since_ns_ = 0;   // Level has been below the active step since
+  bool thermal_mixer_active_ = false;
+  bool enable_null_present_ = false;   // Skip the kernel commit of unchanged command mode frames
+  bool null_present_ = false;          // Prepared frame repeats the last commit
+  std::vector<uint64_t> committed_handles_;  // Buffers of the last commit, by layer
+  uint64_t null_presents_ = 0;
+  uint32_t self_refresh_static_frames_ = 8;  // Static frames before the panel refreshes itself
+  uint32_t static_frames_ = 0;
+  bool self_refresh_ = false;          // Unchanged frames are null presented, as when enabled
+  uint64_t self_refresh_entries_ = 0;
+  bool fast_panel_recovery_ = false;   // Power cycle only the panel on ESD, see RecoverPanel()
+  uint64_t panel_dead_ns_ = 0;
+  uint64_t panel_recovery_ns_[3] = {};   // Panel dead event, power off and power on done
+  bool panel_recovered_ = false;         // Next kernel commit completes the recovery
+  uint64_t panel_recoveries_ = 0;
+  uint64_t panel_recovery_total_ns_ = 0;  // From the panel dead event to the end of the commit
+  uint64_t panel_recovery_max_ns_ = 0;
+  bool adaptive_dsi_clock_ = false;      // Pick the lowest bit clock the frames need
+  bool dsi_clock_pinned_ = false;        // Set by a client, adaptation waits for constraints
+  std::vector<uint64_t> avoided_dsi_clocks_;  // RF interference constraints from a client
+  uint32_t dsi_clock_frames_ = 0;        // Frames evaluated since the last change of clock
+  uint64_t dsi_clock_needed_ = 0;        // Highest bit clock those frames needed
+  uint64_t dsi_clock_change_ns_ = 0;
+  uint64_t dsi_clock_changes_ = 0;
 };
 
 }  // namespace sdm
@@ -136,7 +136,7 @@ DisplayError DisplayPluggable::Prepare(LayerStack *layer_stack) {
   }
 
   // Clean hw layers for reuse.
-  hw_layers_ = HWLayers();
+  hw_layers_.Reset();
 
   return DisplayBase::Prepare(layer_stack);
 }
@@ -247,6 +247,7 @@ void DisplayPluggable::HwRecovery(const HWRecoveryEvent sdm_event_code) {
 void DisplayPluggable::Histogram(int /* histogram_fd */, uint32_t /* blob_id */) {}
 
 DisplayError DisplayPluggable::VSync(int64_t timestamp) {
+  vsync_model_.AddSample(timestamp);
   if (vsync_enable_) {
     DisplayEventVSync vsync;
     vsync.timestamp = timestamp;
@@ -167,7 +167,7 @@ DisplayError DisplayVirtual::Prepare(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
 
   // Clean hw layers for reuse.
-  hw_layers_ = HWLayers();
+  hw_layers_.Reset();
 
   return DisplayBase::Prepare(layer_stack);
 }
@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "hw_color_lut_pack.h"
+
+namespace sdm {
+
+void PackGamutEntries(const uint32_t *c0, const uint32_t *c1_c2, uint32_t count, uint32_t *out) {
+  uint32_t i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 4 <= count; i += 4) {
+    uint32x4x2_t entries = {{vld1q_u32(c0 + i), vld1q_u32(c1_c2 + i)}};
+    vst2q_u32(out + 2 * i, entries);
+  }
+#endif
+  for (; i < count; i++) {
+    out[2 * i] = c0[i];
+    out[2 * i + 1] = c1_c2[i];
+  }
+}
+
+void PackIgcEntries(const uint32_t *c0_c1, const uint32_t *c2, uint32_t count, uint32_t mask,
+                    uint32_t shift, uint32_t *out_c0, uint32_t *out_c1, uint32_t *out_c2) {
+  uint32_t i = 0;
+#if defined(__ARM_NEON)
+  const uint32x4_t vmask = vdupq_n_u32(mask);
+  const int32x4_t vshift = vdupq_n_s32(-static_cast<int32_t>(shift));  // Negative shifts right
+  for (; i + 4 <= count; i += 4) {
+    uint32x4_t c0_c1_data = vld1q_u32(c0_c1 + i);
+    vst1q_u32(out_c0 + i, vandq_u32(c0_c1_data, vmask));
+    vst1q_u32(out_c1 + i, vandq_u32(vshlq_u32(c0_c1_data, vshift), vmask));
+    vst1q_u32(out_c2 + i, vandq_u32(vld1q_u32(c2 + i), vmask));
+  }
+#endif
+  for (; i < count; i++) {
+    out_c0[i] = c0_c1[i] & mask;
+    out_c1[i] = (c0_c1[i] >> shift) & mask;
+    out_c2[i] = c2[i] & mask;
+  }
+}
+
+void PackPgcEntries(const uint32_t *in, uint32_t count, uint32_t mask, uint32_t shift,
+                    uint32_t *out) {
+  uint32_t i = 0;
+#if defined(__ARM_NEON)
+  const uint32x4_t vmask = vdupq_n_u32(mask);
+  const int32x4_t vshift = vdupq_n_s32(static_cast<int32_t>(shift));
+  for (; i + 4 <= count; i += 4) {
+    uint32x4x2_t pairs = vld2q_u32(in + 2 * i);  // Even entries in val[0], odd ones in val[1]
+    uint32x4_t low = vandq_u32(pairs.val[0], vmask);
+    uint32x4_t high = vshlq_u32(vandq_u32(pairs.val[1], vmask), vshift);
+    vst1q_u32(out + i, vorrq_u32(low, high));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = (in[2 * i] & mask) | (in[2 * i + 1] & mask) << shift;
+  }
+}
+
+void PackSixZoneEntries(const uint32_t *p0, const uint32_t *p1, uint32_t count, uint32_t p0_mask,
+                        uint32_t p1_mask, uint32_t *out) {
+  uint32_t i = 0;
+#if defined(__ARM_NEON)
+  const uint32x4_t vp0_mask = vdupq_n_u32(p0_mask);
+  const uint32x4_t vp1_mask = vdupq_n_u32(p1_mask);
+  for (; i + 4 <= count; i += 4) {
+    uint32x4x2_t entries = {{vandq_u32(vld1q_u32(p0 + i), vp0_mask),
+                             vandq_u32(vld1q_u32(p1 + i), vp1_mask)}};
+    vst2q_u32(out + 2 * i, entries);
+  }
+#endif
+  for (; i < count; i++) {
+    out[2 * i] = p0[i] & p0_mask;
+    out[2 * i + 1] = p1[i] & p1_mask;
+  }
+}
+
+}  // namespace sdm
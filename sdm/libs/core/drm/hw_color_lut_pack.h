@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_COLOR_LUT_PACK_H__
+#define __HW_COLOR_LUT_PACK_H__
+
+#include <stdint.h>
+
+namespace sdm {
+
+// Repacking of SDM PP LUTs into the layout of the drm_msm_* payloads. The tables are thousands of
+// entries, so these take NEON paths where available. Results match the element-wise loops bit
+// for bit, see hw_color_lut_pack_test.cpp.
+
+// out[2 * i] = c0[i], out[2 * i + 1] = c1_c2[i], as in an array of drm_msm_3d_gamut_entry.
+void PackGamutEntries(const uint32_t *c0, const uint32_t *c1_c2, uint32_t count, uint32_t *out);
+
+// out_c0[i] = c0_c1[i] & mask, out_c1[i] = (c0_c1[i] >> shift) & mask, out_c2[i] = c2[i] & mask
+void PackIgcEntries(const uint32_t *c0_c1, const uint32_t *c2, uint32_t count, uint32_t mask,
+                    uint32_t shift, uint32_t *out_c0, uint32_t *out_c1, uint32_t *out_c2);
+
+// out[i] = (in[2 * i] & mask) | (in[2 * i + 1] & mask) << shift, for count output entries
+void PackPgcEntries(const uint32_t *in, uint32_t count, uint32_t mask, uint32_t shift,
+                    uint32_t *out);
+
+// out[2 * i] = p0[i] & p0_mask, out[2 * i + 1] = p1[i] & p1_mask, as in an array of
+// drm_msm_sixzone_curve.
+void PackSixZoneEntries(const uint32_t *p0, const uint32_t *p1, uint32_t count, uint32_t p0_mask,
+                        uint32_t p1_mask, uint32_t *out);
+
+}  // namespace sdm
+
+#endif  // __HW_COLOR_LUT_PACK_H__
@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "hw_color_lut_pack.h"
+
+namespace {
+
+// Four tables of the fine 17x17x17 gamut mode, as GetDrmGamut converts on every update.
+const uint32_t kGamutTables = 4;
+const uint32_t kGamutTableSize = 1229;
+const uint32_t kIgcTableSize = 256;
+const uint32_t kPgcTableSize = 512;
+
+// The element-wise loop the kernels replaced, for comparison.
+void BM_PackGamutEntriesScalar(benchmark::State &state) {
+  std::vector<uint32_t> c0(kGamutTableSize, 0x123), c1_c2(kGamutTableSize, 0x4560789);
+  std::vector<uint32_t> out(2 * kGamutTableSize);
+  for (auto _ : state) {
+    for (uint32_t row = 0; row < kGamutTables; row++) {
+      for (uint32_t col = 0; col < kGamutTableSize; col++) {
+        out[2 * col] = c0[col];
+        out[2 * col + 1] = c1_c2[col];
+      }
+      benchmark::DoNotOptimize(out.data());
+    }
+  }
+}
+BENCHMARK(BM_PackGamutEntriesScalar);
+
+void BM_PackGamutEntries(benchmark::State &state) {
+  std::vector<uint32_t> c0(kGamutTableSize, 0x123), c1_c2(kGamutTableSize, 0x4560789);
+  std::vector<uint32_t> out(2 * kGamutTableSize);
+  for (auto _ : state) {
+    for (uint32_t row = 0; row < kGamutTables; row++) {
+      sdm::PackGamutEntries(c0.data(), c1_c2.data(), kGamutTableSize, out.data());
+      benchmark::DoNotOptimize(out.data());
+    }
+  }
+}
+BENCHMARK(BM_PackGamutEntries);
+
+void BM_PackIgcEntries(benchmark::State &state) {
+  std::vector<uint32_t> c0_c1(kIgcTableSize, 0x04560123), c2(kIgcTableSize, 0x789);
+  std::vector<uint32_t> out_c0(kIgcTableSize), out_c1(kIgcTableSize), out_c2(kIgcTableSize);
+  for (auto _ : state) {
+    sdm::PackIgcEntries(c0_c1.data(), c2.data(), kIgcTableSize, 0xFFF, 16, out_c0.data(),
+                        out_c1.data(), out_c2.data());
+    benchmark::DoNotOptimize(out_c2.data());
+  }
+}
+BENCHMARK(BM_PackIgcEntries);
+
+void BM_PackPgcEntries(benchmark::State &state) {
+  std::vector<uint32_t> in(2 * kPgcTableSize, 0x3FF);
+  std::vector<uint32_t> out(kPgcTableSize);
+  for (auto _ : state) {
+    sdm::PackPgcEntries(in.data(), kPgcTableSize, 0x3FF, 16, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+BENCHMARK(BM_PackPgcEntries);
+
+}  // namespace
+
+BENCHMARK_MAIN();
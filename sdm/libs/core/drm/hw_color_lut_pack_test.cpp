@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "hw_color_lut_pack.h"
+
+namespace sdm {
+namespace {
+
+// Table sizes around the vector width, and the real table sizes.
+const uint32_t kCounts[] = {0, 1, 3, 4, 5, 7, 8, 13, 256, 550, 1229};
+
+std::vector<uint32_t> RandomTable(uint32_t count, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::vector<uint32_t> table(count);
+  for (auto &entry : table) {
+    entry = gen();
+  }
+  return table;
+}
+
+TEST(HWColorLutPackTest, GamutMatchesScalar) {
+  for (uint32_t count : kCounts) {
+    auto c0 = RandomTable(count, 1);
+    auto c1_c2 = RandomTable(count, 2);
+    std::vector<uint32_t> expected(2 * count), out(2 * count + 1, 0xdeadbeef);
+    for (uint32_t i = 0; i < count; i++) {
+      expected[2 * i] = c0[i];
+      expected[2 * i + 1] = c1_c2[i];
+    }
+
+    PackGamutEntries(c0.data(), c1_c2.data(), count, out.data());
+    EXPECT_EQ(expected, std::vector<uint32_t>(out.begin(), out.end() - 1)) << "count " << count;
+    EXPECT_EQ(0xdeadbeef, out.back()) << "count " << count;
+  }
+}
+
+TEST(HWColorLutPackTest, IgcMatchesScalar) {
+  const uint32_t mask = 0xFFF, shift = 16;
+  for (uint32_t count : kCounts) {
+    auto c0_c1 = RandomTable(count, 3);
+    auto c2 = RandomTable(count, 4);
+    std::vector<uint32_t> expected_c0(count), expected_c1(count), expected_c2(count);
+    for (uint32_t i = 0; i < count; i++) {
+      expected_c0[i] = c0_c1[i] & mask;
+      expected_c1[i] = (c0_c1[i] >> shift) & mask;
+      expected_c2[i] = c2[i] & mask;
+    }
+
+    std::vector<uint32_t> out_c0(count), out_c1(count), out_c2(count);
+    PackIgcEntries(c0_c1.data(), c2.data(), count, mask, shift, out_c0.data(), out_c1.data(),
+                   out_c2.data());
+    EXPECT_EQ(expected_c0, out_c0) << "count " << count;
+    EXPECT_EQ(expected_c1, out_c1) << "count " << count;
+    EXPECT_EQ(expected_c2, out_c2) << "count " << count;
+  }
+}
+
+TEST(HWColorLutPackTest, PgcMatchesScalar) {
+  const uint32_t mask = 0x3FF, shift = 16;
+  for (uint32_t count : kCounts) {
+    auto in = RandomTable(2 * count, 5);
+    std::vector<uint32_t> expected(count), out(count + 1, 0xdeadbeef);
+    for (uint32_t i = 0; i < count; i++) {
+      expected[i] = (in[2 * i] & mask) | (in[2 * i + 1] & mask) << shift;
+    }
+
+    PackPgcEntries(in.data(), count, mask, shift, out.data());
+    EXPECT_EQ(expected, std::vector<uint32_t>(out.begin(), out.end() - 1)) << "count " << count;
+    EXPECT_EQ(0xdeadbeef, out.back()) << "count " << count;
+  }
+}
+
+TEST(HWColorLutPackTest, SixZoneMatchesScalar) {
+  const uint32_t p0_mask = 0x0FFF, p1_mask = 0x0FFF0FFF;
+  for (uint32_t count : kCounts) {
+    auto p0 = RandomTable(count, 6);
+    auto p1 = RandomTable(count, 7);
+    std::vector<uint32_t> expected(2 * count), out(2 * count);
+    for (uint32_t i = 0; i < count; i++) {
+      expected[2 * i] = p0[i] & p0_mask;
+      expected[2 * i + 1] = p1[i] & p1_mask;
+    }
+
+    PackSixZoneEntries(p0.data(), p1.data(), count, p0_mask, p1_mask, out.data());
+    EXPECT_EQ(expected, out) << "count " << count;
+  }
+}
+
+}  // namespace
+}  // namespace sdm
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -31,6 +31,7 @@
 
 #include <array>
 #include <map>
+#include <cstddef>
 #include <cstring>
 #include <vector>
 
@@ -38,9 +39,20 @@
 #include <drm/msm_drm_pp.h>
 #endif
 #include <utils/debug.h>
+#include "hw_color_lut_pack.h"
 #include "hw_color_manager_drm.h"
 
 #ifdef PP_DRM_ENABLE
+// The LUT pack kernels write entries as pairs of words.
+static_assert(sizeof(drm_msm_3d_gamut_entry) == 2 * sizeof(uint32_t) &&
+              offsetof(drm_msm_3d_gamut_entry, c2_c1) == sizeof(uint32_t),
+              "gamut entries are {c0, c2_c1} pairs");
+#ifdef DRM_MSM_SIXZONE
+static_assert(sizeof(drm_msm_sixzone_curve) == 2 * sizeof(uint32_t) &&
+              offsetof(drm_msm_sixzone_curve, p1) == sizeof(uint32_t),
+              "sixzone curve points are {p0, p1} pairs");
+#endif
+
 static const uint32_t kPgcDataMask = 0x3FF;
 static const uint32_t kPgcShift = 16;
 
@@ -240,6 +252,42 @@ DisplayError HWColorManagerDrm::GetDrmFeature(PPFeatureInfo *in_data,
   return ret;
 }
 
+bool HWColorManagerDrm::StageFeature(uint32_t obj_id, const DRMPPFeatureInfo &feature) {
+  uint64_t key = (static_cast<uint64_t>(obj_id) << 32) | feature.id;
+  FeaturePayload payload;
+  payload.enabled = (feature.payload != NULL);
+  if (payload.enabled) {
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(feature.payload);
+    payload.data.assign(data, data + feature.payload_size);
+  }
+
+  auto it = staged_features_.find(key);
+  if (it == staged_features_.end()) {
+    it = committed_features_.find(key);
+    if (it != committed_features_.end() && it->second.enabled == payload.enabled &&
+        it->second.data == payload.data) {
+      return false;
+    }
+  }
+
+  staged_features_[key] = std::move(payload);
+  return true;
+}
+
+void HWColorManagerDrm::CommitStagedFeatures(bool success) {
+  if (!success) {
+    // Nothing is known about what the driver holds now, so everything is set again.
+    committed_features_.clear();
+    staged_features_.clear();
+    return;
+  }
+
+  for (auto &staged : staged_features_) {
+    committed_features_[staged.first] = std::move(staged.second);
+  }
+  staged_features_.clear();
+}
+
 void HWColorManagerDrm::FreeDrmFeatureData(DRMPPFeatureInfo *feature) {
   if (feature && feature->payload) {
 #ifdef PP_DRM_ENABLE
@@ -457,11 +505,8 @@ DisplayError HWColorManagerDrm::GetDrmIGC(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  for (int i = 0; i < IGC_TBL_LEN; i++) {
-    mdp_igc->c0[i] = c0_c1_data_ptr[i] & kIgcDataMask;
-    mdp_igc->c1[i] = (c0_c1_data_ptr[i] >> kIgcShift) & kIgcDataMask;
-    mdp_igc->c2[i] = c2_data_ptr[i] & kIgcDataMask;
-  }
+  PackIgcEntries(c0_c1_data_ptr, c2_data_ptr, IGC_TBL_LEN, kIgcDataMask, kIgcShift, mdp_igc->c0,
+                 mdp_igc->c1, mdp_igc->c2);
   out_data->payload = mdp_igc;
 #endif
   return ret;
@@ -497,14 +542,9 @@ DisplayError HWColorManagerDrm::GetDrmPGC(const PPFeatureInfo &in_data,
 
   mdp_pgc->flags = 0;
 
-  for (int i = 0, j = 0; i < PGC_TBL_LEN; i++, j += 2) {
-    mdp_pgc->c0[i] = (sde_pgc->c0_data[j] & kPgcDataMask) |
-        (sde_pgc->c0_data[j + 1] & kPgcDataMask) << kPgcShift;
-    mdp_pgc->c1[i] = (sde_pgc->c1_data[j] & kPgcDataMask) |
-        (sde_pgc->c1_data[j + 1] & kPgcDataMask) << kPgcShift;
-    mdp_pgc->c2[i] = (sde_pgc->c2_data[j] & kPgcDataMask) |
-        (sde_pgc->c2_data[j + 1] & kPgcDataMask) << kPgcShift;
-  }
+  PackPgcEntries(sde_pgc->c0_data, PGC_TBL_LEN, kPgcDataMask, kPgcShift, mdp_pgc->c0);
+  PackPgcEntries(sde_pgc->c1_data, PGC_TBL_LEN, kPgcDataMask, kPgcShift, mdp_pgc->c1);
+  PackPgcEntries(sde_pgc->c2_data, PGC_TBL_LEN, kPgcDataMask, kPgcShift, mdp_pgc->c2);
   out_data->payload = mdp_pgc;
 #endif
   return ret;
@@ -646,10 +686,9 @@ DisplayError HWColorManagerDrm::GetDrmPASixZone(const PPFeatureInfo &in_data,
     mdp_sixzone->sat_hold = sde_pa->six_zone_sat_hold;
     mdp_sixzone->val_hold = sde_pa->six_zone_val_hold;
 
-    for (int i = 0; i < SIXZONE_LUT_SIZE; i++) {
-      mdp_sixzone->curve[i].p0 = sde_pa->six_zone_curve_p0[i] & kSixZoneP0Mask;
-      mdp_sixzone->curve[i].p1 = sde_pa->six_zone_curve_p1[i] & kSixZoneP1Mask;
-    }
+    PackSixZoneEntries(sde_pa->six_zone_curve_p0, sde_pa->six_zone_curve_p1, SIXZONE_LUT_SIZE,
+                       kSixZoneP0Mask, kSixZoneP1Mask,
+                       reinterpret_cast<uint32_t *>(&mdp_sixzone->curve[0]));
     out_data->payload = mdp_sixzone;
     out_data->payload_size = sizeof(struct drm_msm_sixzone);
   } else {
@@ -979,10 +1018,8 @@ DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data,
   }
 
   for (uint32_t row = 0; row < GAMUT_3D_TBL_NUM; row++) {
-    for (uint32_t col = 0; col < size; col++) {
-      mdp_gamut->col[row][col].c0 = sde_gamut->c0_data[row][col];
-      mdp_gamut->col[row][col].c2_c1 = sde_gamut->c1_c2_data[row][col];
-    }
+    PackGamutEntries(sde_gamut->c0_data[row], sde_gamut->c1_c2_data[row], size,
+                     reinterpret_cast<uint32_t *>(&mdp_gamut->col[row][0]));
   }
   out_data->payload = mdp_gamut;
 #endif
@@ -32,6 +32,7 @@
 
 #include <drm_interface.h>
 #include <private/color_params.h>
+#include <unordered_map>
 #include <vector>
 
 using sde_drm::DRMPPFeatureID;
@@ -76,10 +77,23 @@ class HWColorManagerDrm {
   uint32_t GetFeatureVersion(const DRMPPFeatureInfo &feature);
   DisplayError ToDrmFeatureId(const PPBlock block, const uint32_t id,
                               std::vector<DRMPPFeatureID> *drm_id);
+  // Stages the translated feature for obj_id and returns false when it matches the payload the
+  // driver already holds, so that the property need not be set again.
+  bool StageFeature(uint32_t obj_id, const DRMPPFeatureInfo &feature);
+  // Called once the staged features were committed, or failed to be.
+  void CommitStagedFeatures(bool success);
   HWColorManagerDrm() {}
   ~HWColorManagerDrm() {}
 
  private:
+  struct FeaturePayload {
+    bool enabled = false;
+    std::vector<uint8_t> data;
+  };
+
+  std::unordered_map<uint64_t, FeaturePayload> committed_features_;  // Keyed by object, feature
+  std::unordered_map<uint64_t, FeaturePayload> staged_features_;
+
   static DisplayError GetDrmPCC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
   static DisplayError GetDrmIGC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
   static DisplayError GetDrmPGC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
@@ -49,11 +49,13 @@
 #include <utils/debug.h>
 #include <utils/formats.h>
 #include <utils/sys.h>
+#include <utils/thread_policy.h>
 #include <drm/sde_drm.h>
 #include <private/color_params.h>
 #include <utils/rect.h>
 #include <utils/utils.h>
 #include <utils/fence.h>
+#include <utils/frame_timing.h>
 
 #include <sstream>
 #include <ctime>
@@ -108,6 +110,7 @@ using sde_drm::DRMSecurityLevel;
 using sde_drm::DRMCscType;
 using sde_drm::DRMMultiRectMode;
 using sde_drm::DRMSSPPLayoutIndex;
+using sde_drm::DRMPlaneState;
 
 namespace sdm {
 
@@ -274,7 +277,7 @@ class FrameBufferObject : public LayerBufferObject {
   ~FrameBufferObject() {
     DRMMaster *master;
     DRMMaster::GetInstance(&master);
-    int ret = master->RemoveFbId(fb_id_);
+    int ret = master->RemoveFbIdDeferred(fb_id_);
     if (ret < 0) {
       DLOGE("Removing fb_id %d failed with error %d", fb_id_, errno);
     }
@@ -297,6 +300,143 @@ HWDeviceDRM::Registry::Registry(BufferAllocator *buffer_allocator) :
   if (Debug::GetProperty(DISABLE_FBID_CACHE, &value) == kErrorNone) {
     disable_fbid_cache_ = (value == 1);
   }
+
+  value = 0;
+  if (Debug::GetProperty(ENABLE_FBID_PREFETCH, &value) == kErrorNone) {
+    enable_fbid_prefetch_ = (value == 1) && !disable_fbid_cache_;
+  }
+
+  if (enable_fbid_prefetch_) {
+    prefetch_thread_ = std::thread(&HWDeviceDRM::Registry::PrefetchThread, this);
+  }
+}
+
+HWDeviceDRM::Registry::~Registry() {
+  if (!prefetch_thread_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(prefetch_lock_);
+    exit_prefetch_ = true;
+  }
+  prefetch_cv_.notify_one();
+  prefetch_thread_.join();
+
+  for (auto &request : prefetch_queue_) {
+    Sys::close_(request.fd);
+  }
+}
+
+void HWDeviceDRM::Registry::Prefetch(Layer *layer) {
+  if (!enable_fbid_prefetch_ || !layer->buffer_map) {
+    return;
+  }
+
+  const LayerBuffer &buffer = layer->input_buffer;
+  if (buffer.planes[0].fd < 0 || !buffer.handle_id || buffer.flags.interlace) {
+    return;
+  }
+
+  auto it = layer->buffer_map->buffer_map.find(buffer.handle_id);
+  if (it != layer->buffer_map->buffer_map.end()) {
+    FrameBufferObject *fb_obj = static_cast<FrameBufferObject*>(it->second.get());
+    if (fb_obj->IsEqual(buffer.format, buffer.width, buffer.height)) {
+      return;
+    }
+  }
+
+  PrefetchRequest request;
+  request.handle_id = buffer.handle_id;
+  request.format = buffer.format;
+  request.width = buffer.width;
+  request.height = buffer.height;
+
+  {
+    std::lock_guard<std::mutex> lock(prefetch_lock_);
+    if (prefetched_map_.find(buffer.handle_id) != prefetched_map_.end() ||
+        (prefetched_map_.size() + prefetch_queue_.size()) >= kMaxPrefetchedFbIds) {
+      return;
+    }
+    for (auto &queued : prefetch_queue_) {
+      if (queued.handle_id == buffer.handle_id) {
+        return;
+      }
+    }
+
+    // Buffer fd of the layer may be closed before the request is serviced.
+    request.fd = Sys::dup_(buffer.planes[0].fd);
+    if (request.fd < 0) {
+      return;
+    }
+    prefetch_queue_.push_back(request);
+  }
+  prefetch_cv_.notify_one();
+}
+
+void HWDeviceDRM::Registry::PrefetchThread() {
+  ThreadPolicy::Apply(kThreadClassBackground, "SDM_FbPrefetch");
+
+  std::unique_lock<std::mutex> lock(prefetch_lock_);
+  while (true) {
+    prefetch_cv_.wait(lock, [this] { return exit_prefetch_ || !prefetch_queue_.empty(); });
+    if (exit_prefetch_) {
+      break;
+    }
+
+    PrefetchRequest request = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+
+    // Drop the lock across the ioctl so that commit path never waits on fb_id creation.
+    lock.unlock();
+    LayerBuffer buffer = {};
+    buffer.planes[0].fd = request.fd;
+    buffer.format = request.format;
+    buffer.width = request.width;
+    buffer.height = request.height;
+    buffer.handle_id = request.handle_id;
+    uint32_t fb_id = 0;
+    int ret = CreateFbId(buffer, &fb_id);
+    Sys::close_(request.fd);
+    lock.lock();
+
+    if (ret >= 0) {
+      prefetched_map_[request.handle_id] = std::make_shared<FrameBufferObject>(fb_id,
+          request.format, request.width, request.height);
+    }
+  }
+}
+
+bool HWDeviceDRM::Registry::ConsumePrefetched(LayerBufferMap *layer_buffer_map,
+                                              const LayerBuffer &buffer) {
+  if (!enable_fbid_prefetch_) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(prefetch_lock_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return false;
+  }
+
+  auto it = prefetched_map_.find(buffer.handle_id);
+  if (it == prefetched_map_.end()) {
+    return false;
+  }
+
+  std::shared_ptr<LayerBufferObject> fb_obj = it->second;
+  prefetched_map_.erase(it);
+  lock.unlock();
+
+  if (!static_cast<FrameBufferObject*>(fb_obj.get())->IsEqual(buffer.format, buffer.width,
+                                                              buffer.height)) {
+    // Buffer got reinterpreted (rotator output, interlace), fb_id gets removed on release.
+    return false;
+  }
+
+  layer_buffer_map->buffer_map[buffer.handle_id] = fb_obj;
+  TouchLru(layer_buffer_map, buffer.handle_id);
+
+  return true;
 }
 
 void HWDeviceDRM::Registry::Register(HWLayers *hw_layers) {
@@ -305,21 +445,25 @@ void HWDeviceDRM::Registry::Register(HWLayers *hw_layers) {
 
   for (uint32_t i = 0; i < hw_layer_count; i++) {
     Layer &layer = hw_layer_info.hw_layers.at(i);
-    LayerBuffer input_buffer = layer.input_buffer;
+    const LayerBuffer *input_buffer = &layer.input_buffer;
     HWRotatorSession *hw_rotator_session = &hw_layers->config[i].hw_rotator_session;
     HWRotateInfo *hw_rotate_info = &hw_rotator_session->hw_rotate_info[0];
-    fbid_cache_limit_ = input_buffer.flags.video ? VIDEO_FBID_LIMIT : UI_FBID_LIMIT;
+    fbid_cache_limit_ = input_buffer->flags.video ? VIDEO_FBID_LIMIT : UI_FBID_LIMIT;
 
     if (hw_rotator_session->mode == kRotatorOffline && hw_rotate_info->valid) {
-      input_buffer = hw_rotator_session->output_buffer;
+      input_buffer = &hw_rotator_session->output_buffer;
       fbid_cache_limit_ = OFFLINE_ROTATOR_FBID_LIMIT;
     }
 
-    if (input_buffer.flags.interlace) {
-      input_buffer.width *= 2;
-      input_buffer.height /= 2;
+    // Only interlaced buffers need an adjusted copy, the rest are mapped in place.
+    if (input_buffer->flags.interlace) {
+      LayerBuffer interlaced_buffer = *input_buffer;
+      interlaced_buffer.width *= 2;
+      interlaced_buffer.height /= 2;
+      MapBufferToFbId(&layer, interlaced_buffer);
+    } else {
+      MapBufferToFbId(&layer, *input_buffer);
     }
-    MapBufferToFbId(&layer, input_buffer);
   }
 }
 
@@ -350,39 +494,75 @@ int HWDeviceDRM::Registry::CreateFbId(const LayerBuffer &buffer, uint32_t *fb_id
   return ret;
 }
 
+void HWDeviceDRM::Registry::TouchLru(LayerBufferMap *layer_buffer_map, uint64_t handle_id) {
+  std::list<uint64_t> &lru_list = layer_buffer_map->lru_list;
+  auto it = std::find(lru_list.begin(), lru_list.end(), handle_id);
+  if (it != lru_list.end()) {
+    lru_list.splice(lru_list.begin(), lru_list, it);
+  } else {
+    lru_list.push_front(handle_id);
+  }
+}
+
+void HWDeviceDRM::Registry::EvictLru(LayerBufferMap *layer_buffer_map) {
+  std::list<uint64_t> &lru_list = layer_buffer_map->lru_list;
+  while (!lru_list.empty() && layer_buffer_map->buffer_map.size() >= fbid_cache_limit_) {
+    // Drop only the least recently used fb_id, buffers still in rotation keep theirs.
+    layer_buffer_map->buffer_map.erase(lru_list.back());
+    lru_list.pop_back();
+    stats_.evictions++;
+  }
+
+  if (layer_buffer_map->buffer_map.size() >= fbid_cache_limit_) {
+    // Map was populated without lru tracking, fall back to clearing it.
+    layer_buffer_map->buffer_map.clear();
+  }
+}
+
 void HWDeviceDRM::Registry::MapBufferToFbId(Layer* layer, const LayerBuffer &buffer) {
   if (buffer.planes[0].fd < 0) {
     return;
   }
 
+  LayerBufferMap *layer_buffer_map = layer->buffer_map.get();
   uint64_t handle_id = buffer.handle_id;
   if (!handle_id || disable_fbid_cache_) {
     // In legacy path, clear fb_id map in each frame.
-    layer->buffer_map->buffer_map.clear();
+    layer_buffer_map->buffer_map.clear();
+    layer_buffer_map->lru_list.clear();
   } else {
-    auto it = layer->buffer_map->buffer_map.find(handle_id);
-    if (it != layer->buffer_map->buffer_map.end()) {
+    auto it = layer_buffer_map->buffer_map.find(handle_id);
+    if (it != layer_buffer_map->buffer_map.end()) {
       FrameBufferObject *fb_obj = static_cast<FrameBufferObject*>(it->second.get());
       if (fb_obj->IsEqual(buffer.format, buffer.width, buffer.height)) {
         // Found fb_id for given handle_id key
+        TouchLru(layer_buffer_map, handle_id);
+        stats_.hits++;
         return;
       } else {
         // Erase from fb_id map if format or size have been modified
-        layer->buffer_map->buffer_map.erase(it);
+        layer_buffer_map->buffer_map.erase(it);
+        layer_buffer_map->lru_list.remove(handle_id);
       }
     }
 
-    if (layer->buffer_map->buffer_map.size() >= fbid_cache_limit_) {
-      // Clear fb_id map, if the size reaches cache limit.
-      layer->buffer_map->buffer_map.clear();
+    EvictLru(layer_buffer_map);
+
+    if (ConsumePrefetched(layer_buffer_map, buffer)) {
+      stats_.prefetched++;
+      return;
     }
   }
 
+  stats_.misses++;
   uint32_t fb_id = 0;
   if (CreateFbId(buffer, &fb_id) >= 0) {
     // Create and cache the fb_id in map
-    layer->buffer_map->buffer_map[handle_id] = std::make_shared<FrameBufferObject>(fb_id,
+    layer_buffer_map->buffer_map[handle_id] = std::make_shared<FrameBufferObject>(fb_id,
         buffer.format, buffer.width, buffer.height);
+    if (handle_id && !disable_fbid_cache_) {
+      TouchLru(layer_buffer_map, handle_id);
+    }
   }
 }
 
@@ -421,6 +601,9 @@ void HWDeviceDRM::Registry::MapOutputBufferToFbId(LayerBuffer *output_buffer) {
 
 void HWDeviceDRM::Registry::Clear() {
   output_buffer_map_.clear();
+
+  std::lock_guard<std::mutex> lock(prefetch_lock_);
+  prefetched_map_.clear();
 }
 
 uint32_t HWDeviceDRM::Registry::GetFbId(Layer *layer, uint64_t handle_id) {
@@ -513,6 +696,21 @@ DisplayError HWDeviceDRM::Init() {
   std::unique_ptr<HWColorManagerDrm> hw_color_mgr(new HWColorManagerDrm());
   hw_color_mgr_ = std::move(hw_color_mgr);
 
+  int value = 0;
+  if (Debug::GetProperty(DISABLE_PIPE_CONFIG_CACHE, &value) == kErrorNone) {
+    disable_pipe_config_cache_ = (value == 1);
+  }
+
+  value = 0;
+  if (Debug::GetProperty(QOS_VOTE_HOLD_MS, &value) == kErrorNone && value > 0) {
+    qos_governor_ = HWQosGovernor(UINT32(value));
+  }
+
+  value = 0;
+  if (Debug::GetProperty(QOS_UBWC_MIN_PCT, &value) == kErrorNone && value > 0) {
+    qos_governor_.SetCompressionMinPct(UINT32(value));
+  }
+
   return kErrorNone;
 }
 
@@ -1157,7 +1355,16 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
   bool resource_update = hw_layers->updates_mask.test(kUpdateResources);
   bool buffer_update = hw_layers->updates_mask.test(kSwapBuffers);
   bool update_config = resource_update || buffer_update ||
-                       hw_layer_info.stack->flags.geometry_changed;
+                       hw_layer_info.stack->flags.geometry_changed ||
+                       IsColorTransformUpdated(hw_layer_info);
+
+  pending_ctm_updates_.clear();
+  // Without a config update the pipes stay as committed, otherwise their configs are rebuilt.
+  if (update_config) {
+    pending_pipe_configs_.clear();
+  } else {
+    pending_pipe_configs_ = committed_pipe_configs_;
+  }
 
   if (hw_panel_info_.partial_update && update_config) {
     if (IsFullFrameUpdate(hw_layer_info)) {
@@ -1168,8 +1375,12 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
       DRMRect conn_rects[kNumMaxROIs] = {{0, 0, display_attributes_[index].x_pixels,
                                           display_attributes_[index].y_pixels}};
 
-      for (uint32_t i = 0; i < hw_layer_info.left_frame_roi.size(); i++) {
-        auto &roi = hw_layer_info.left_frame_roi.at(i);
+      // Fit the ROIs to what the panel takes, merging the cheapest pixel wise pairs.
+      std::vector<LayerRect> frame_roi = hw_layer_info.left_frame_roi;
+      MergeRects(std::min(UINT32(kNumMaxROIs), hw_panel_info_.left_roi_count), &frame_roi);
+
+      for (uint32_t i = 0; i < frame_roi.size(); i++) {
+        auto &roi = frame_roi.at(i);
         // TODO(user): In multi PU, stitch ROIs vertically adjacent and upate plane destination
         crtc_rects[i].left = UINT32(roi.left);
         crtc_rects[i].right = UINT32(roi.right);
@@ -1181,7 +1392,7 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
         conn_rects[i].bottom = UINT32(roi.bottom);
       }
 
-      uint32_t num_rects = std::max(1u, static_cast<uint32_t>(hw_layer_info.left_frame_roi.size()));
+      uint32_t num_rects = std::max(1u, static_cast<uint32_t>(frame_roi.size()));
       drm_atomic_intf_->Perform(DRMOps::CRTC_SET_ROI, token_.crtc_id, num_rects, crtc_rects);
       drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_ROI, token_.conn_id, num_rects, conn_rects);
     }
@@ -1215,30 +1426,25 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
         uint32_t pipe_id = pipe_info->pipe_id;
 
         if (update_config) {
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ALPHA, pipe_id, layer.plane_alpha);
+          // Value initialized, which clears the padding the bytewise compare looks at as well.
+          PipeConfig &config = pending_pipe_configs_[pipe_id];
+          config = PipeConfig();
+          config.alpha = layer.plane_alpha;
 
 #ifdef FOD_ZPOS
-          uint32_t z_order = pipe_info->z_order;
+          config.z_order = pipe_info->z_order;
           if (layer.flags.fod_pressed
               || (hw_layer_info.stack->flags.fod_pressed_present
                 && i == hw_layer_count - 1)) {
-            z_order |= FOD_PRESSED_LAYER_ZORDER;
+            config.z_order |= FOD_PRESSED_LAYER_ZORDER;
           }
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ZORDER, pipe_id, z_order);
 #else
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ZORDER, pipe_id, pipe_info->z_order);
+          config.z_order = pipe_info->z_order;
 #endif
 
-          DRMBlendType blending = {};
-          SetBlending(layer.blending, &blending);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_BLEND_TYPE, pipe_id, blending);
-
-          DRMRect src = {};
-          SetRect(pipe_info->src_roi, &src);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_RECT, pipe_id, src);
+          SetBlending(layer.blending, &config.blending);
+          SetRect(pipe_info->src_roi, &config.src);
 
-          DRMRect dst = {};
-          SetRect(pipe_info->dst_roi, &dst);
           LayerRect right_mixer = {FLOAT(mixer_attributes_.split_left), 0,
                                    FLOAT(mixer_attributes_.width), FLOAT(mixer_attributes_.height)};
           LayerRect dst_roi = pipe_info->dst_roi;
@@ -1246,12 +1452,12 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
           // For larget displays ie; 2 * 2k * 2k * 90 fps 4 LM's get programmed.
           // Each pair of LM's drive independent displays.
           // Layout Index indicates the panel onto which pipe gets staged.
-          DRMSSPPLayoutIndex layout_index = DRMSSPPLayoutIndex::NONE;
+          config.layout_index = DRMSSPPLayoutIndex::NONE;
           if (mixer_attributes_.split_type == kQuadSplit) {
-            layout_index = DRMSSPPLayoutIndex::LEFT;
+            config.layout_index = DRMSSPPLayoutIndex::LEFT;
             if (IsValid(Intersection(dst_roi, right_mixer))) {
               dst_roi = Reposition(dst_roi, -INT(mixer_attributes_.split_left), 0);
-              layout_index = DRMSSPPLayoutIndex::RIGHT;
+              config.layout_index = DRMSSPPLayoutIndex::RIGHT;
               DLOGV_IF(kTagDriverConfig, "Layer index = %d sspp layout = RIGHT", i);
               DLOGV_IF(kTagDriverConfig, "Right dst_roi l = %f t = %f r = %f b = %f",
                        dst_roi.left, dst_roi.top, dst_roi.right, dst_roi.bottom);
@@ -1261,56 +1467,32 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
                        dst_roi.left, dst_roi.top, dst_roi.right, dst_roi.bottom);
             }
           }
-          SetRect(dst_roi, &dst);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DST_RECT, pipe_id, dst);
-
-          // Update Layout index.
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SSPP_LAYOUT, pipe_id, layout_index);
-
-          DRMRect excl = {};
-          SetRect(pipe_info->excl_rect, &excl);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_EXCL_RECT, pipe_id, excl);
-
-          uint32_t rot_bit_mask = 0;
-          SetRotation(layer.transform, layer_config, &rot_bit_mask);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ROTATION, pipe_id, rot_bit_mask);
+          SetRect(dst_roi, &config.dst);
+          SetRect(pipe_info->excl_rect, &config.excl);
+          SetRotation(layer.transform, layer_config, &config.rotation);
+          config.h_decimation = pipe_info->horizontal_decimation;
+          config.v_decimation = pipe_info->vertical_decimation;
 
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_H_DECIMATION, pipe_id,
-                                    pipe_info->horizontal_decimation);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_V_DECIMATION, pipe_id,
-                                    pipe_info->vertical_decimation);
-
-          DRMSecureMode fb_secure_mode;
           DRMSecurityLevel security_level;
-          SetSecureConfig(layer.input_buffer, &fb_secure_mode, &security_level);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_SECURE_MODE, pipe_id, fb_secure_mode);
+          SetSecureConfig(layer.input_buffer, &config.fb_secure_mode, &security_level);
           if (security_level > crtc_security_level) {
             crtc_security_level = security_level;
           }
 
-          uint32_t config = 0;
-          SetSrcConfig(layer.input_buffer, hw_rotator_session->mode, &config);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_CONFIG, pipe_id, config);;
-
+          SetSrcConfig(layer.input_buffer, hw_rotator_session->mode, &config.src_config);
           if (hw_scale_) {
-            SDEScaler scaler_output = {};
-            hw_scale_->SetScaler(pipe_info->scale_data, &scaler_output);
-            // TODO(user): Remove qseed3 and add version check, then send appropriate scaler object
-            if (hw_resource_.has_qseed3) {
-              drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SCALER_CONFIG, pipe_id,
-                                        reinterpret_cast<uint64_t>(&scaler_output.scaler_v2));
-            }
+            hw_scale_->SetPipeScaler(pipe_id, pipe_info->scale_data, &config.scaler);
           }
+          SelectCscType(layer.input_buffer, &config.csc_type);
+          SetMultiRectMode(pipe_info->flags, &config.multirect_mode);
 
-          DRMCscType csc_type = DRMCscType::kCscTypeMax;
-          SelectCscType(layer.input_buffer, &csc_type);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CSC_CONFIG, pipe_id, &csc_type);
-
-          DRMMultiRectMode multirect_mode;
-          SetMultiRectMode(pipe_info->flags, &multirect_mode);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_MULTIRECT_MODE, pipe_id, multirect_mode);
+          // A pipe the last commit left programmed the same way only needs its new buffer.
+          if (!IsPipeConfigCommitted(pipe_id, config)) {
+            SetPipeConfig(pipe_id, &config);
+          }
 
           SetSsppTonemapFeatures(pipe_info);
+          SetLayerColorTransform(layer, *pipe_info);
         }
 
         drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, fb_id);
@@ -1326,7 +1508,14 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
 
   if (update_config) {
     SetSolidfillStages();
-    SetQOSData(qos_data);
+    HWQosData qos_request = qos_data;
+    HWQosData qos_vote = {};
+    qos_governor_.ScaleForCompression(hw_layer_info, !validate, &qos_request);
+    DLOGI_IF(kTagDriverConfig, "%s::%s UBWC scaled DRAM AB=%f KBps, IB=%f KBps",
+             validate ? "Validate" : "Commit", device_name_, qos_request.dram_ab_bps / 1000.f,
+             qos_request.dram_ib_bps / 1000.f);
+    qos_governor_.Vote(qos_request, !validate, &qos_vote);
+    SetQOSData(qos_vote);
     drm_atomic_intf_->Perform(DRMOps::CRTC_SET_SECURITY_LEVEL, token_.crtc_id, crtc_security_level);
   }
 
@@ -1468,6 +1657,7 @@ void HWDeviceDRM::ClearSolidfillStages() {
 
 DisplayError HWDeviceDRM::Validate(HWLayers *hw_layers) {
   DTRACE_SCOPED();
+  FrameTiming::ScopedStage stage_timing(display_id_, kFrameStageHWValidate);
 
   DisplayError err = kErrorNone;
   registry_.Register(hw_layers);
@@ -1553,6 +1743,19 @@ DisplayError HWDeviceDRM::DefaultCommit(HWLayers *hw_layers) {
 DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
   DTRACE_SCOPED();
 
+  // Nonblocking commits are pipelined, but only one frame may be queued behind the one on its
+  // way to the panel. A commit that never retires is reported instead of stalling in the driver.
+  if (!synchronous_commit_ && prev_retire_fence_) {
+    DisplayError error = Fence::Wait(prev_retire_fence_, kTimeoutMsPendingCommit);
+    prev_retire_fence_ = nullptr;
+    if (error != kErrorNone) {
+      DLOGE("Previous commit did not retire in %d ms on crtc %d", kTimeoutMsPendingCommit,
+            token_.crtc_id);
+      pending_retire_fence_ = nullptr;
+      return kErrorTimeOut;
+    }
+  }
+
   int64_t release_fence_fd = -1;
   int64_t retire_fence_fd = -1;
 
@@ -1570,7 +1773,9 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
     }
   }
 
+  uint64_t commit_start = FrameTiming::Now();
   int ret = drm_atomic_intf_->Commit(synchronous_commit_, false /* retain_planes*/);
+  FrameTiming::Record(display_id_, kFrameStageDRMCommit, FrameTiming::Now() - commit_start);
   shared_ptr<Fence> release_fence = Fence::Create(INT(release_fence_fd), "release");
   shared_ptr<Fence> retire_fence = Fence::Create(INT(retire_fence_fd), "retire");
   if (ret) {
@@ -1578,9 +1783,38 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
     DumpHWLayers(hw_layers);
     vrefresh_ = 0;
     panel_mode_changed_ = 0;
+    committed_pipe_configs_.clear();
+    if (hw_color_mgr_) {
+      hw_color_mgr_->CommitStagedFeatures(false);
+    }
     return kErrorHardware;
   }
 
+  if (hw_color_mgr_) {
+    hw_color_mgr_->CommitStagedFeatures(true);
+  }
+
+  // Pipes left out of this commit got unstaged by it, only the ones programmed now remain.
+  committed_pipe_configs_.swap(pending_pipe_configs_);
+
+  // The DGM CSC of a plane sticks to it when unstaged, so these are tracked across commits.
+  for (auto &update : pending_ctm_updates_) {
+    if (update.second.first) {
+      committed_ctm_pipes_[update.first] = update.second.second;
+    } else {
+      committed_ctm_pipes_.erase(update.first);
+    }
+  }
+  pending_ctm_updates_.clear();
+
+  if (synchronous_commit_) {
+    prev_retire_fence_ = nullptr;
+    pending_retire_fence_ = nullptr;
+  } else {
+    prev_retire_fence_ = pending_retire_fence_;
+    pending_retire_fence_ = retire_fence;
+  }
+
   DLOGD_IF(kTagDriverConfig, "RELEASE fence: fd: %s", Fence::GetStr(release_fence).c_str());
   DLOGD_IF(kTagDriverConfig, "RETIRE fence: fd: %s", Fence::GetStr(retire_fence).c_str());
 
@@ -1758,8 +1992,73 @@ bool HWDeviceDRM::EnableHotPlugDetection(int enable) {
   return true;
 }
 
+// Moves the cursor with a commit of its pipe rects alone, the other planes stay as the last
+// frame left them. The resource manager has already placed the cursor pipes in hw_layers. Moves
+// that would need the pipe to be reprogrammed otherwise, like a new crop size at a screen edge,
+// are left to the next frame.
 DisplayError HWDeviceDRM::SetCursorPosition(HWLayers *hw_layers, int x, int y) {
   DTRACE_SCOPED();
+  HWLayersInfo &hw_layer_info = hw_layers->info;
+  uint32_t hw_layer_count = UINT32(hw_layer_info.hw_layers.size());
+  uint32_t cursor_index = hw_layer_count;
+  for (uint32_t i = 0; i < hw_layer_count; i++) {
+    if (hw_layer_info.hw_layers.at(i).composition == kCompositionCursor) {
+      cursor_index = i;
+    }
+  }
+
+  if ((cursor_index == hw_layer_count) || (mixer_attributes_.split_type == kQuadSplit) ||
+      null_display_commit_ || disable_pipe_config_cache_) {
+    return kErrorNotSupported;
+  }
+
+  HWLayerConfig &layer_config = hw_layers->config[cursor_index];
+  std::pair<uint32_t, PipeConfig> moves[2];
+  uint32_t num_moves = 0;
+  for (HWPipeInfo *pipe_info : {&layer_config.left_pipe, &layer_config.right_pipe}) {
+    if (!pipe_info->valid) {
+      continue;
+    }
+    auto it = committed_pipe_configs_.find(pipe_info->pipe_id);
+    if (it == committed_pipe_configs_.end()) {
+      return kErrorNotSupported;
+    }
+
+    PipeConfig config = it->second;
+    SetRect(pipe_info->src_roi, &config.src);
+    SetRect(pipe_info->dst_roi, &config.dst);
+    const DRMRect &src = it->second.src, &dst = it->second.dst;
+    if (((config.src.right - config.src.left) != (src.right - src.left)) ||
+        ((config.src.bottom - config.src.top) != (src.bottom - src.top)) ||
+        ((config.dst.right - config.dst.left) != (dst.right - dst.left)) ||
+        ((config.dst.bottom - config.dst.top) != (dst.bottom - dst.top))) {
+      return kErrorNotSupported;
+    }
+    moves[num_moves++] = std::make_pair(pipe_info->pipe_id, config);
+  }
+
+  if (!num_moves) {
+    return kErrorNotSupported;
+  }
+
+  for (uint32_t i = 0; i < num_moves; i++) {
+    drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_RECT, moves[i].first, moves[i].second.src);
+    drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DST_RECT, moves[i].first, moves[i].second.dst);
+  }
+
+  int ret = drm_atomic_intf_->Commit(false /* synchronous */, true /* retain_planes */);
+  if (ret) {
+    // Most likely a frame is still being committed, the next one brings the cursor along.
+    DLOGV_IF(kTagDriverConfig, "Cursor commit failed with error %d crtc %d", ret, token_.crtc_id);
+    committed_pipe_configs_.clear();
+    return kErrorNotSupported;
+  }
+
+  for (uint32_t i = 0; i < num_moves; i++) {
+    committed_pipe_configs_[moves[i].first] = moves[i].second;
+  }
+  DLOGV_IF(kTagDriverConfig, "Cursor moved to %d %d", x, y);
+
   return kErrorNone;
 }
 
@@ -1817,12 +2116,18 @@ DisplayError HWDeviceDRM::SetPPFeatures(PPFeaturesConfig *feature_list) {
       }
       kernel_params.id = id;
       ret = hw_color_mgr_->GetDrmFeature(feature, &kernel_params);
-      if (!ret && crtc_feature)
+      // Features set again with an unchanged payload are left as programmed, so that one
+      // changed feature does not upload every other feature blob again.
+      uint32_t obj_id = crtc_feature ? token_.crtc_id : token_.conn_id;
+      if (!ret && !hw_color_mgr_->StageFeature(obj_id, kernel_params)) {
+        DLOGV_IF(kTagDriverConfig, "feature id %d unchanged", id);
+      } else if (!ret && crtc_feature) {
         drm_atomic_intf_->Perform(DRMOps::CRTC_SET_POST_PROC,
                                   token_.crtc_id, &kernel_params);
-      else if (!ret && !crtc_feature)
+      } else if (!ret && !crtc_feature) {
         drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_POST_PROC,
                                   token_.conn_id, &kernel_params);
+      }
 
       hw_color_mgr_->FreeDrmFeatureData(&kernel_params);
     }
@@ -2167,6 +2472,40 @@ void HWDeviceDRM::SetMultiRectMode(const uint32_t flags, DRMMultiRectMode *targe
   }
 }
 
+bool HWDeviceDRM::IsPipeConfigCommitted(uint32_t pipe_id, const PipeConfig &config) {
+  if (disable_pipe_config_cache_) {
+    return false;
+  }
+
+  auto it = committed_pipe_configs_.find(pipe_id);
+  return (it != committed_pipe_configs_.end()) &&
+         (memcmp(&it->second, &config, sizeof(config)) == 0);
+}
+
+void HWDeviceDRM::SetPipeConfig(uint32_t pipe_id, PipeConfig *config) {
+  DRMPlaneState state;
+  state.alpha = config->alpha;
+  state.z_order = config->z_order;
+  state.blending = config->blending;
+  state.src = config->src;
+  state.dst = config->dst;
+  state.layout_index = config->layout_index;
+  state.excl = config->excl;
+  state.rotation = config->rotation;
+  state.h_decimation = config->h_decimation;
+  state.v_decimation = config->v_decimation;
+  state.fb_secure_mode = config->fb_secure_mode;
+  state.src_config = config->src_config;
+  // TODO(user): Remove qseed3 and add version check, then send appropriate scaler object
+  if (hw_scale_ && hw_resource_.has_qseed3) {
+    state.scaler = reinterpret_cast<uint64_t>(&config->scaler.scaler_v2);
+  }
+  state.csc_type = config->csc_type;
+  state.multirect_mode = config->multirect_mode;
+
+  drm_atomic_intf_->SetPlaneState(pipe_id, state);
+}
+
 void HWDeviceDRM::SetSsppTonemapFeatures(HWPipeInfo *pipe_info) {
   if (pipe_info->dgm_csc_info.op != kNoOp) {
     SDECsc csc = {};
@@ -2185,6 +2524,86 @@ void HWDeviceDRM::SetSsppTonemapFeatures(HWPipeInfo *pipe_info) {
   SetSsppLutFeatures(pipe_info);
 }
 
+bool HWDeviceDRM::IsColorTransformUpdated(const HWLayersInfo &hw_layer_info) {
+  for (auto &layer : hw_layer_info.hw_layers) {
+    if (layer.update_mask.test(kColorTransformUpdate) ||
+        layer.update_mask.test(kLuminanceScaleUpdate)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool HWDeviceDRM::GetColorTransformCsc(const Layer &layer, HWCsc *csc) {
+  // The layer matrix is 4x4 column-major and applied as [R G B 1] * matrix. The DGM CSC takes the
+  // 3x3 part row by row in S31.32, it has no linear space bias for the translation.
+  static const float kIdentity[kColorTransformMatrixSize] = { 1.0, 0.0, 0.0, 0.0,
+                                                               0.0, 1.0, 0.0, 0.0,
+                                                               0.0, 0.0, 1.0, 0.0,
+                                                               0.0, 0.0, 0.0, 1.0 };
+  const float *matrix = layer.flags.color_transform ? layer.color_transform_matrix : kIdentity;
+  if (matrix[12] != 0.0f || matrix[13] != 0.0f || matrix[14] != 0.0f) {
+    return false;
+  }
+
+  // Without a degamma ahead of it the CSC works on gamma encoded values, the luminance scale is
+  // brought to that domain with a 2.2 power approximation of the transfer.
+  double gain = (layer.luminance_scale == 1.0f) ? 1.0 : pow(DOUBLE(layer.luminance_scale),
+                                                            1.0 / 2.2);
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t col = 0; col < 3; col++) {
+      csc->ctm_coeff[row * 3 + col] = llround(DOUBLE(matrix[col * 4 + row]) * gain *
+                                              (1LL << 32));
+    }
+  }
+  for (uint32_t i = 0; i < MAX_CSC_CLAMP_SIZE; i += 2) {
+    csc->pre_clamp[i + 1] = csc->post_clamp[i + 1] = 0x3FF;
+  }
+
+  return true;
+}
+
+void HWDeviceDRM::SetLayerColorTransform(const Layer &layer, const HWPipeInfo &pipe_info) {
+  uint32_t pipe_id = pipe_info.pipe_id;
+  auto committed = committed_ctm_pipes_.find(pipe_id);
+  bool programmed = (committed != committed_ctm_pipes_.end());
+
+  // Tone mapping owns the DGM CSC of the pipes it sets up.
+  if (pipe_info.dgm_csc_info.op != kNoOp) {
+    if (programmed) {
+      pending_ctm_updates_[pipe_id] = std::make_pair(false, HWCsc());
+    }
+    return;
+  }
+
+  auto caps = std::find_if(hw_resource_.hw_pipes.begin(), hw_resource_.hw_pipes.end(),
+                           [pipe_id](const HWPipeCaps &pipe_caps) {
+                             return pipe_caps.id == pipe_id;
+                           });
+  bool supported = (caps != hw_resource_.hw_pipes.end()) && caps->dgm_csc_version;
+
+  HWCsc csc = {};
+  bool needs_csc = layer.flags.color_transform || (layer.luminance_scale != 1.0f);
+  if (needs_csc && supported && GetColorTransformCsc(layer, &csc)) {
+    if (!programmed || memcmp(&committed->second, &csc, sizeof(csc))) {
+      SDECsc sde_csc = {};
+      SetDGMCscV1(csc, &sde_csc.csc_v1);
+      DLOGV_IF(kTagDriverConfig, "Layer color transform on pipe %d", pipe_id);
+      drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DGM_CSC_CONFIG, pipe_id,
+                                reinterpret_cast<uint64_t>(&sde_csc.csc_v1));
+    }
+    pending_ctm_updates_[pipe_id] = std::make_pair(true, csc);
+  } else if (programmed) {
+    // An all zero config detaches the CSC from the plane.
+    SDECsc sde_csc = {};
+    DLOGV_IF(kTagDriverConfig, "Reset layer color transform on pipe %d", pipe_id);
+    drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DGM_CSC_CONFIG, pipe_id,
+                              reinterpret_cast<uint64_t>(&sde_csc.csc_v1));
+    pending_ctm_updates_[pipe_id] = std::make_pair(false, HWCsc());
+  }
+}
+
 void HWDeviceDRM::SetDGMCsc(const HWPipeCscInfo &dgm_csc_info, SDECsc *csc) {
   SetDGMCscV1(dgm_csc_info.csc, &csc->csc_v1);
 }
@@ -2260,6 +2679,13 @@ void HWDeviceDRM::AddDimLayerIfNeeded() {
 DisplayError HWDeviceDRM::NullCommit(bool synchronous, bool retain_planes) {
   DTRACE_SCOPED();
   AddDimLayerIfNeeded();
+  // Planes may be unset or reset by this commit, next frame programs its pipes in full. Votes of
+  // power state changes bypass the governor.
+  committed_pipe_configs_.clear();
+  if (hw_color_mgr_) {
+    hw_color_mgr_->CommitStagedFeatures(false);
+  }
+  qos_governor_.Reset();
   int ret = drm_atomic_intf_->Commit(synchronous , retain_planes);
   if (ret) {
     DLOGE("failed with error %d", ret);
@@ -2413,6 +2839,36 @@ void HWDeviceDRM::DumpHWLayers(HWLayers *hw_layers) {
   }
 }
 
+DisplayError HWDeviceDRM::GetQosVoteStats(HWQosVoteStats *stats) {
+  if (!stats) {
+    return kErrorParameters;
+  }
+
+  *stats = qos_governor_.GetStats();
+
+  return kErrorNone;
+}
+
+DisplayError HWDeviceDRM::GetFbIdCacheStats(HWFbIdCacheStats *stats) {
+  if (!stats) {
+    return kErrorParameters;
+  }
+
+  *stats = registry_.GetStats();
+
+  return kErrorNone;
+}
+
+DisplayError HWDeviceDRM::PrefetchFbId(Layer *layer) {
+  if (!layer) {
+    return kErrorParameters;
+  }
+
+  registry_.Prefetch(layer);
+
+  return kErrorNone;
+}
+
 DisplayError HWDeviceDRM::SetBlendSpace(const PrimariesTransfer &blend_space) {
   blend_space_ = blend_space;
   return kErrorNone;
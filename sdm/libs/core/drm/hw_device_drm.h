@@ -35,12 +35,17 @@
 #include <pthread.h>
 #include <xf86drmMode.h>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <memory>
 
 #include "hw_interface.h"
+#include "hw_qos_governor.h"
 #include "hw_scale_drm.h"
 #include "hw_color_manager_drm.h"
 
@@ -110,6 +115,7 @@ class HWDeviceDRM : public HWInterface {
   virtual DisplayError SetMixerAttributes(const HWMixerAttributes &mixer_attributes);
   virtual DisplayError GetMixerAttributes(HWMixerAttributes *mixer_attributes);
   virtual void InitializeConfigs();
+  void SetDisplaySwitchMode(uint32_t index);
   virtual DisplayError DumpDebugData();
   virtual void PopulateHWPanelInfo();
   virtual DisplayError SetDppsFeature(void *payload, size_t size) { return kErrorNotSupported; }
@@ -132,6 +138,9 @@ class HWDeviceDRM : public HWInterface {
     return kErrorNotSupported;
   }
   virtual DisplayError SetBlendSpace(const PrimariesTransfer &blend_space);
+  virtual DisplayError GetFbIdCacheStats(HWFbIdCacheStats *stats);
+  virtual DisplayError PrefetchFbId(Layer *layer);
+  virtual DisplayError GetQosVoteStats(HWQosVoteStats *stats);
 
   enum {
     kHWEventVSync,
@@ -147,6 +156,8 @@ class HWDeviceDRM : public HWInterface {
   static const int kTimeoutMsPowerOff = 3000;
   static const int kTimeoutMsDoze = kTimeoutMsPowerOff;
   static const int kTimeoutMsDozeSuspend = kTimeoutMsPowerOff;
+  // Max wait for an older nonblocking commit to retire before another one is queued.
+  static const int kTimeoutMsPendingCommit = 1000;
 
   DisplayError SetFormat(const LayerBufferFormat &source, uint32_t *target);
   DisplayError SetStride(HWDeviceType device_type, LayerBufferFormat format, uint32_t width,
@@ -176,6 +187,9 @@ class HWDeviceDRM : public HWInterface {
   void SetSsppTonemapFeatures(HWPipeInfo *pipe_info);
   void SetDGMCsc(const HWPipeCscInfo &dgm_csc_info, SDECsc *csc);
   void SetDGMCscV1(const HWCsc &dgm_csc, sde_drm_csc_v1 *csc_v1);
+  bool IsColorTransformUpdated(const HWLayersInfo &hw_layer_info);
+  bool GetColorTransformCsc(const Layer &layer, HWCsc *csc);
+  void SetLayerColorTransform(const Layer &layer, const HWPipeInfo &pipe_info);
   void SetSsppLutFeatures(HWPipeInfo *pipe_info);
   void AddDimLayerIfNeeded();
   DisplayError NullCommit(bool synchronous, bool retain_planes);
@@ -188,6 +202,7 @@ class HWDeviceDRM : public HWInterface {
   class Registry {
    public:
     explicit Registry(BufferAllocator *buffer_allocator);
+    ~Registry();
     // Called on each Validate and Commit to map the handle_id to fb_id of each layer buffer.
     void Register(HWLayers *hw_layers);
     // Called on display disconnect to clear output buffer map and remove fb_ids.
@@ -202,9 +217,41 @@ class HWDeviceDRM : public HWInterface {
     uint32_t GetFbId(Layer *layer, uint64_t handle_id);
     // Find fb_id for given handle_id in output buffer map.
     uint32_t GetOutputFbId(uint64_t handle_id);
+    // Hit/miss/eviction counters of the layer fb_id caches of this display.
+    const HWFbIdCacheStats &GetStats() const { return stats_; }
+    // Queue creation of the fb_id for the current layer buffer on the prefetch thread, if the
+    // layer map does not have it yet.
+    void Prefetch(Layer *layer);
 
    private:
+    struct PrefetchRequest {
+      uint64_t handle_id = 0;
+      int fd = -1;  // Duplicated buffer fd, owned by the request.
+      LayerBufferFormat format = kFormatInvalid;
+      uint32_t width = 0;
+      uint32_t height = 0;
+    };
+
+    static const uint32_t kMaxPrefetchedFbIds = VIDEO_FBID_LIMIT;
+
+    void PrefetchThread();
+    // Move a prefetched fb_id matching the buffer into the layer map. Never blocks on the
+    // prefetch thread, returns false if no fb_id is (yet) available.
+    bool ConsumePrefetched(LayerBufferMap *layer_buffer_map, const LayerBuffer &buffer);
+    // Move handle_id to the most recently used position, adding it if not present.
+    void TouchLru(LayerBufferMap *layer_buffer_map, uint64_t handle_id);
+    // Drop least recently used entries until the map has room for one more fb_id.
+    void EvictLru(LayerBufferMap *layer_buffer_map);
+
     bool disable_fbid_cache_ = false;
+    HWFbIdCacheStats stats_ = {};
+    bool enable_fbid_prefetch_ = false;
+    bool exit_prefetch_ = false;
+    std::thread prefetch_thread_;
+    std::mutex prefetch_lock_;
+    std::condition_variable prefetch_cv_;
+    std::deque<PrefetchRequest> prefetch_queue_ {};
+    std::unordered_map<uint64_t, std::shared_ptr<LayerBufferObject>> prefetched_map_ {};
     std::unordered_map<uint64_t, std::shared_ptr<LayerBufferObject>> output_buffer_map_ {};
     BufferAllocator *buffer_allocator_ = {};
     uint8_t fbid_cache_limit_ = UI_FBID_LIMIT;
@@ -233,6 +280,9 @@ class HWDeviceDRM : public HWInterface {
   bool secure_display_active_ = false;
   uint64_t debug_dump_count_ = 0;
   bool synchronous_commit_ = false;
+  // Retire fences of the last two nonblocking commits, newest in pending_retire_fence_.
+  shared_ptr<Fence> prev_retire_fence_ = nullptr;
+  shared_ptr<Fence> pending_retire_fence_ = nullptr;
   uint32_t topology_control_ = 0;
   uint32_t vrefresh_ = 0;
   uint32_t panel_mode_changed_ = 0;
@@ -252,14 +302,43 @@ class HWDeviceDRM : public HWInterface {
   // Destination scaler blocks in use by all HWDeviceDRM instances.
   static std::atomic<uint32_t> hw_dest_scaler_blocks_used_;
   bool null_display_commit_ = false;
+  bool resolution_switch_enabled_ = false;
 
  private:
-  void SetDisplaySwitchMode(uint32_t index);
+  // Per pipe properties SetupAtomic programs besides FB_ID, CRTC and INPUT_FENCE. Compared
+  // bytewise against the last committed copy, so it must stay trivially copyable.
+  struct PipeConfig {
+    uint32_t alpha;
+    uint32_t z_order;
+    sde_drm::DRMBlendType blending;
+    sde_drm::DRMRect src;
+    sde_drm::DRMRect dst;
+    sde_drm::DRMSSPPLayoutIndex layout_index;
+    sde_drm::DRMRect excl;
+    uint32_t rotation;
+    uint32_t h_decimation;
+    uint32_t v_decimation;
+    sde_drm::DRMSecureMode fb_secure_mode;
+    uint32_t src_config;
+    SDEScaler scaler;
+    sde_drm::DRMCscType csc_type;
+    sde_drm::DRMMultiRectMode multirect_mode;
+  };
+
+  bool IsPipeConfigCommitted(uint32_t pipe_id, const PipeConfig &config);
+  void SetPipeConfig(uint32_t pipe_id, PipeConfig *config);
 
   std::string interface_str_ = "DSI";
-  bool resolution_switch_enabled_ = false;
   bool autorefresh_ = false;
   std::unique_ptr<HWColorManagerDrm> hw_color_mgr_ = {};
+  bool disable_pipe_config_cache_ = false;
+  HWQosGovernor qos_governor_ = HWQosGovernor(0);
+  // Pipe configs of the frame being set up, and of the last successful commit.
+  std::unordered_map<uint32_t, PipeConfig> pending_pipe_configs_ = {};
+  std::unordered_map<uint32_t, PipeConfig> committed_pipe_configs_ = {};
+  // Layer color transforms on pipe DGM CSCs, set up by this frame and held by the hardware.
+  std::unordered_map<uint32_t, std::pair<bool, HWCsc>> pending_ctm_updates_ = {};
+  std::unordered_map<uint32_t, HWCsc> committed_ctm_pipes_ = {};
 };
 
 }  // namespace sdm
@@ -34,12 +34,13 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/prctl.h>
-#include <sys/resource.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_timing.h>
 #include <utils/sys.h>
+#include <utils/thread_policy.h>
 #include <xf86drm.h>
 #include <drm/msm_drm.h>
 
@@ -70,9 +71,191 @@ namespace sdm {
 
 using drm_utils::DRMMaster;
 
+std::mutex HWEventLoopDRM::s_lock_;
+HWEventLoopDRM *HWEventLoopDRM::s_instance_ = nullptr;
+uint32_t HWEventLoopDRM::s_ref_count_ = 0;
+
+HWEventLoopDRM *HWEventLoopDRM::Acquire() {
+  std::lock_guard<std::mutex> lock(s_lock_);
+  if (!s_instance_) {
+    s_instance_ = new HWEventLoopDRM();
+    if (s_instance_->Init() != kErrorNone) {
+      delete s_instance_;
+      s_instance_ = nullptr;
+      return nullptr;
+    }
+  }
+
+  s_ref_count_++;
+  return s_instance_;
+}
+
+void HWEventLoopDRM::Release() {
+  std::lock_guard<std::mutex> lock(s_lock_);
+  if (!s_instance_ || --s_ref_count_) {
+    return;
+  }
+
+  s_instance_->Deinit();
+  delete s_instance_;
+  s_instance_ = nullptr;
+}
+
+DisplayError HWEventLoopDRM::Init() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    DLOGE("epoll_create1 failed, error = %s", strerror(errno));
+    return kErrorResources;
+  }
+
+  // The eventfd only unblocks epoll_wait when the thread is exiting.
+  wake_fd_ = Sys::eventfd_(0, 0);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeSourceId;
+  if (wake_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+    DLOGE("Failed to set up the wake up fd, error = %s", strerror(errno));
+    Deinit();
+    return kErrorResources;
+  }
+
+  if (pthread_create(&event_thread_, NULL, &EventThread, this) < 0) {
+    DLOGE("Failed to start the event thread, error = %s", strerror(errno));
+    Deinit();
+    return kErrorResources;
+  }
+  thread_started_ = true;
+
+  return kErrorNone;
+}
+
+void HWEventLoopDRM::Deinit() {
+  if (thread_started_) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      exit_thread_ = true;
+    }
+    uint64_t exit_value = 1;
+    ssize_t write_size = Sys::write_(wake_fd_, &exit_value, sizeof(uint64_t));
+    if (write_size != sizeof(uint64_t)) {
+      DLOGW("Error triggering exit fd (%d). write size = %zu, error = %s", wake_fd_,
+            static_cast<size_t>(write_size), strerror(errno));
+    }
+    pthread_join(event_thread_, NULL);
+    thread_started_ = false;
+  }
+
+  if (wake_fd_ >= 0) {
+    Sys::close_(wake_fd_);
+    wake_fd_ = -1;
+  }
+  if (epoll_fd_ >= 0) {
+    Sys::close_(epoll_fd_);
+    epoll_fd_ = -1;
+  }
+}
+
+DisplayError HWEventLoopDRM::AddSource(int fd, uint32_t events, HWEventsDRM *owner,
+                                       uint32_t index) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // Ids are never reused, so a stale epoll entry of a removed source cannot reach a new one that
+  // got the same fd number.
+  uint64_t id = next_source_id_++;
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    DLOGE("epoll_ctl failed to add fd %d, error = %s", fd, strerror(errno));
+    return kErrorResources;
+  }
+
+  EventSource &source = sources_[id];
+  source.fd = fd;
+  source.owner = owner;
+  source.index = index;
+
+  return kErrorNone;
+}
+
+void HWEventLoopDRM::RemoveSources(HWEventsDRM *owner) {
+  std::unique_lock<std::mutex> lock(lock_);
+  for (auto it = sources_.begin(); it != sources_.end();) {
+    if (it->second.owner == owner) {
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+      it = sources_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  if (!thread_started_ || !pthread_equal(pthread_self(), event_thread_)) {
+    dispatch_done_.wait(lock, [this, owner] { return dispatching_owner_ != owner; });
+  }
+}
+
+void *HWEventLoopDRM::EventThread(void *context) {
+  if (context) {
+    return reinterpret_cast<HWEventLoopDRM *>(context)->EventHandler();
+  }
+
+  return NULL;
+}
+
+void *HWEventLoopDRM::EventHandler() {
+  ThreadPolicy::Apply(kThreadClassEvent, "SDM_EventThread");
+
+  struct epoll_event events[kMaxEvents];
+  while (true) {
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (count <= 0) {
+      if (errno != EINTR) {
+        DLOGW("epoll_wait failed. error = %s", strerror(errno));
+      }
+      continue;
+    }
+
+    uint64_t wake_ns = FrameTiming::Now();
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.u64 == kWakeSourceId) {
+        uint64_t exit_value = 0;
+        Sys::read_(wake_fd_, &exit_value, sizeof(uint64_t));
+        continue;
+      }
+
+      HWEventsDRM *owner = nullptr;
+      uint32_t index = 0;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = sources_.find(events[i].data.u64);
+        if (it == sources_.end()) {
+          // Removed after epoll_wait returned.
+          continue;
+        }
+        owner = it->second.owner;
+        index = it->second.index;
+        dispatching_owner_ = owner;
+      }
+
+      owner->DispatchEvent(index, events[i].events, wake_ns);
+
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        dispatching_owner_ = nullptr;
+      }
+      dispatch_done_.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (exit_thread_) {
+      break;
+    }
+  }
+
+  return nullptr;
+}
+
 DisplayError HWEventsDRM::InitializePollFd() {
   for (uint32_t i = 0; i < event_data_list_.size(); i++) {
-    char data[kMaxStringLength]{};
     HWEventData &event_data = event_data_list_[i];
     poll_fds_[i] = {};
     poll_fds_[i].fd = -1;
@@ -93,14 +276,9 @@ DisplayError HWEventsDRM::InitializePollFd() {
         }
         vsync_index_ = i;
       } break;
-      case HWEvent::EXIT: {
-        // Create an eventfd to be used to unblock the poll system call when
-        // a thread is exiting.
-        poll_fds_[i].fd = Sys::eventfd_(0, 0);
-        poll_fds_[i].events |= POLLIN;
-        // Clear any existing data
-        Sys::pread_(poll_fds_[i].fd, data, kMaxStringLength, 0);
-      } break;
+      case HWEvent::EXIT:
+        // The shared event loop owns the eventfd that unblocks it on exit.
+        break;
       case HWEvent::IDLE_NOTIFY: {
         poll_fds_[i].fd = drmOpen("msm_drm", nullptr);
         if (poll_fds_[i].fd < 0) {
@@ -225,16 +403,32 @@ DisplayError HWEventsDRM::Init(int display_id, DisplayType display_type,
         token_.crtc_id, token_.conn_id);
 
   event_handler_ = event_handler;
+  display_id_ = display_id;
   poll_fds_.resize(event_list.size());
-  event_thread_name_ += " - " + std::to_string(display_id) + "-" + std::to_string(display_type);
 
   PopulateHWEventData(event_list);
 
-  if (pthread_create(&event_thread_, NULL, &DisplayEventThread, this) < 0) {
-    DLOGE("Failed to start %s, error = %s", event_thread_name_.c_str(), strerror(errno));
+  event_loop_ = HWEventLoopDRM::Acquire();
+  if (!event_loop_) {
+    CloseFds();
     return kErrorResources;
   }
 
+  for (uint32_t i = 0; i < event_data_list_.size(); i++) {
+    if (poll_fds_[i].fd < 0 || !poll_fds_[i].events) {
+      continue;
+    }
+    // poll and epoll share the values of POLLIN, POLLPRI and POLLERR.
+    if (event_loop_->AddSource(poll_fds_[i].fd, UINT32(poll_fds_[i].events), this, i) !=
+        kErrorNone) {
+      event_loop_->RemoveSources(this);
+      HWEventLoopDRM::Release();
+      event_loop_ = nullptr;
+      CloseFds();
+      return kErrorResources;
+    }
+  }
+
   RegisterPanelDead(true);
   RegisterIdleNotify(true);
   RegisterIdlePowerCollapse(true);
@@ -260,7 +454,12 @@ DisplayError HWEventsDRM::Init(int display_id, DisplayType display_type,
 }
 
 DisplayError HWEventsDRM::Deinit() {
-  exit_threads_ = true;
+  if (event_loop_) {
+    event_loop_->RemoveSources(this);
+    HWEventLoopDRM::Release();
+    event_loop_ = nullptr;
+  }
+
   RegisterPanelDead(false);
   RegisterIdleNotify(false);
   RegisterIdlePowerCollapse(false);
@@ -270,9 +469,6 @@ DisplayError HWEventsDRM::Deinit() {
   if (enable_hist_interrupt_) {
     RegisterHistogram(false);
   }
-  Sys::pthread_cancel_(event_thread_);
-  WakeUpEventThread();
-  pthread_join(event_thread_, NULL);
   CloseFds();
 
   return kErrorNone;
@@ -302,20 +498,6 @@ DisplayError HWEventsDRM::SetEventState(HWEvent event, bool enable, void *arg) {
   return kErrorNone;
 }
 
-void HWEventsDRM::WakeUpEventThread() {
-  for (uint32_t i = 0; i < event_data_list_.size(); i++) {
-    if (event_data_list_[i].event_type == HWEvent::EXIT && poll_fds_[i].fd >= 0) {
-      uint64_t exit_value = 1;
-      ssize_t write_size = Sys::write_(poll_fds_[i].fd, &exit_value, sizeof(uint64_t));
-      if (write_size != sizeof(uint64_t)) {
-        DLOGW("Error triggering exit fd (%d). write size = %zu, error = %s", poll_fds_[i].fd,
-              static_cast<size_t>(write_size), strerror(errno));
-      }
-      break;
-    }
-  }
-}
-
 DisplayError HWEventsDRM::CloseFds() {
   for (uint32_t i = 0; i < event_data_list_.size(); i++) {
     switch (event_data_list_[i].event_type) {
@@ -326,8 +508,6 @@ DisplayError HWEventsDRM::CloseFds() {
         poll_fds_[i].fd = -1;
         break;
       case HWEvent::EXIT:
-        Sys::close_(poll_fds_[i].fd);
-        poll_fds_[i].fd = -1;
         break;
       case HWEvent::IDLE_NOTIFY:
       case HWEvent::IDLE_POWER_COLLAPSE:
@@ -348,71 +528,36 @@ DisplayError HWEventsDRM::CloseFds() {
   return kErrorNone;
 }
 
-void *HWEventsDRM::DisplayEventThread(void *context) {
-  if (context) {
-    return reinterpret_cast<HWEventsDRM *>(context)->DisplayEventHandler();
-  }
-
-  return NULL;
-}
-
-void *HWEventsDRM::DisplayEventHandler() {
+void HWEventsDRM::DispatchEvent(uint32_t index, uint32_t revents, uint64_t wake_ns) {
   char data[kMaxStringLength]{};
 
-  prctl(PR_SET_NAME, event_thread_name_.c_str(), 0, 0, 0);
-  setpriority(PRIO_PROCESS, 0, kThreadPriorityUrgent);
-
-  // Real Time task with lowest priority.
-  struct sched_param param = {0};
-  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
-  sched_setscheduler(0, SCHED_FIFO, &param);
-
-  while (!exit_threads_) {
-    int error = Sys::poll_(poll_fds_.data(), UINT32(poll_fds_.size()), -1);
-    if (error <= 0) {
-      DLOGW("poll failed. error = %s", strerror(errno));
-      continue;
-    }
-
-    for (uint32_t i = 0; i < event_data_list_.size(); i++) {
-      pollfd &poll_fd = poll_fds_[i];
-      if (poll_fd.fd < 0) {
-        continue;
+  switch (event_data_list_[index].event_type) {
+    case HWEvent::VSYNC:
+    case HWEvent::PANEL_DEAD:
+    case HWEvent::IDLE_NOTIFY:
+    case HWEvent::IDLE_POWER_COLLAPSE:
+    case HWEvent::HW_RECOVERY:
+    case HWEvent::HISTOGRAM:
+      if (revents & (EPOLLIN | EPOLLPRI | EPOLLERR)) {
+        (this->*(event_data_list_[index]).event_parser)(nullptr);
       }
-
-      switch (event_data_list_[i].event_type) {
-        case HWEvent::VSYNC:
-        case HWEvent::PANEL_DEAD:
-        case HWEvent::IDLE_NOTIFY:
-        case HWEvent::IDLE_POWER_COLLAPSE:
-        case HWEvent::HW_RECOVERY:
-        case HWEvent::HISTOGRAM:
-          if (poll_fd.revents & (POLLIN | POLLPRI | POLLERR)) {
-            (this->*(event_data_list_[i]).event_parser)(nullptr);
-          }
-          break;
-        case HWEvent::EXIT:
-          if ((poll_fd.revents & POLLIN) &&
-              (Sys::read_(poll_fd.fd, data, kMaxStringLength) > 0)) {
-            (this->*(event_data_list_[i]).event_parser)(data);
-          }
-          break;
-        case HWEvent::CEC_READ_MESSAGE:
-        case HWEvent::SHOW_BLANK_EVENT:
-        case HWEvent::THERMAL_LEVEL:
-        case HWEvent::PINGPONG_TIMEOUT:
-          if ((poll_fd.revents & POLLPRI) &&
-              (Sys::pread_(poll_fd.fd, data, kMaxStringLength, 0) > 0)) {
-            (this->*(event_data_list_[i]).event_parser)(data);
-          }
-          break;
+      break;
+    case HWEvent::CEC_READ_MESSAGE:
+    case HWEvent::SHOW_BLANK_EVENT:
+    case HWEvent::THERMAL_LEVEL:
+    case HWEvent::PINGPONG_TIMEOUT:
+      if ((revents & EPOLLPRI) &&
+          (Sys::pread_(poll_fds_[index].fd, data, kMaxStringLength, 0) > 0)) {
+        (this->*(event_data_list_[index]).event_parser)(data);
       }
-    }
+      break;
+    case HWEvent::EXIT:
+      break;
   }
 
-  pthread_exit(0);
-
-  return nullptr;
+  // Time from the loop waking up to this handler returning, including the handlers of other
+  // displays that were ready first.
+  FrameTiming::Record(display_id_, kFrameStageHWEvent, FrameTiming::Now() - wake_ns);
 }
 
 DisplayError HWEventsDRM::RegisterVSync() {
@@ -32,6 +32,7 @@
 
 #include <drm_interface.h>
 #include <sys/poll.h>
+#include <condition_variable>
 #include <map>
 #include <mutex>
 #include <string>
@@ -47,6 +48,49 @@ namespace sdm {
 
 using std::vector;
 
+class HWEventsDRM;
+
+// A single epoll thread that waits on the event fds of all displays and dispatches each ready fd
+// to the HWEventsDRM instance that registered it.
+class HWEventLoopDRM {
+ public:
+  static HWEventLoopDRM *Acquire();
+  static void Release();
+  DisplayError AddSource(int fd, uint32_t events, HWEventsDRM *owner, uint32_t index);
+  // Returns once no event of the owner is being dispatched, and none will be anymore.
+  void RemoveSources(HWEventsDRM *owner);
+
+ private:
+  struct EventSource {
+    int fd = -1;
+    HWEventsDRM *owner = nullptr;
+    uint32_t index = 0;
+  };
+
+  static const uint64_t kWakeSourceId = 0;
+  static const int kMaxEvents = 16;
+
+  DisplayError Init();
+  void Deinit();
+  static void *EventThread(void *context);
+  void *EventHandler();
+
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  pthread_t event_thread_{};
+  bool thread_started_ = false;
+  bool exit_thread_ = false;
+  std::mutex lock_;
+  std::condition_variable dispatch_done_;
+  std::map<uint64_t, EventSource> sources_;  // Keyed by the id stored in the epoll data
+  uint64_t next_source_id_ = kWakeSourceId + 1;
+  HWEventsDRM *dispatching_owner_ = nullptr;
+
+  static std::mutex s_lock_;
+  static HWEventLoopDRM *s_instance_;
+  static uint32_t s_ref_count_;
+};
+
 class HWEventsDRM : public HWEventsInterface {
  public:
   virtual DisplayError Init(int display_id, DisplayType display_type, HWEventHandler *event_handler,
@@ -64,11 +108,12 @@ class HWEventsDRM : public HWEventsInterface {
     EventParser event_parser {};
   };
 
-  static void *DisplayEventThread(void *context);
+  friend class HWEventLoopDRM;
+
   static void VSyncHandlerCallback(int fd, unsigned int sequence, unsigned int tv_sec,
                                    unsigned int tv_usec, void *data);
 
-  void *DisplayEventHandler();
+  void DispatchEvent(uint32_t index, uint32_t revents, uint64_t wake_ns);
   void HandleVSync(char *data);
   void HandleIdleTimeout(char *data);
   void HandleCECMessage(char *data);
@@ -81,7 +126,6 @@ class HWEventsDRM : public HWEventsInterface {
   void HandleHistogram(char *data);
   int SetHwRecoveryEvent(const uint32_t hw_event_code, HWRecoveryEvent *sdm_event_code);
   void PopulateHWEventData(const vector<HWEvent> &event_list);
-  void WakeUpEventThread();
   DisplayError SetEventParser();
   DisplayError InitializePollFd();
   DisplayError CloseFds();
@@ -93,11 +137,10 @@ class HWEventsDRM : public HWEventsInterface {
   DisplayError RegisterHistogram(bool enable);
 
   HWEventHandler *event_handler_{};
+  HWEventLoopDRM *event_loop_ = nullptr;
+  int display_id_ = -1;
   vector<HWEventData> event_data_list_{};
   vector<pollfd> poll_fds_{};
-  pthread_t event_thread_{};
-  std::string event_thread_name_ = "SDM_EventThread";
-  bool exit_threads_ = false;
   uint32_t vsync_index_ = UINT32_MAX;
   uint32_t histogram_index_ = UINT32_MAX;
   bool vsync_enabled_ = false;
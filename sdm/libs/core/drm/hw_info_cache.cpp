@@ -0,0 +1,397 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <utils/debug.h>
+#include <xf86drm.h>
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hw_info_cache.h"
+
+#define __CLASS__ "HWInfoCache"
+
+namespace sdm {
+
+// Writes fields to a byte buffer, or reads them back in the same order. Both directions go
+// through the same Serialize() overloads, so the stored layout cannot drift from the parsed one.
+class HWInfoArchive {
+ public:
+  explicit HWInfoArchive(std::vector<uint8_t> *buffer) : buffer_(buffer) {}
+  HWInfoArchive(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+  bool IsReading() const { return !buffer_; }
+  bool IsValid() const { return valid_; }
+  bool IsComplete() const { return valid_ && (offset_ == size_); }
+  size_t Remaining() const { return size_ - offset_; }
+
+  void Bytes(void *value, size_t size) {
+    if (buffer_) {
+      const uint8_t *bytes = reinterpret_cast<const uint8_t *>(value);
+      buffer_->insert(buffer_->end(), bytes, bytes + size);
+      return;
+    }
+
+    if (!valid_ || size > Remaining()) {
+      valid_ = false;
+      return;
+    }
+    memcpy(value, data_ + offset_, size);
+    offset_ += size;
+  }
+
+  // Reads or writes a container size, rejecting sizes the remaining data cannot hold.
+  bool Count(size_t *count) {
+    uint32_t value = static_cast<uint32_t>(*count);
+    Bytes(&value, sizeof(value));
+    if (IsReading() && (!valid_ || value > Remaining())) {
+      valid_ = false;
+      return false;
+    }
+    *count = value;
+    return true;
+  }
+
+ private:
+  std::vector<uint8_t> *buffer_ = nullptr;
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+  bool valid_ = true;
+};
+
+template <class T>
+static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+Serialize(HWInfoArchive *ar, T *value) {
+  ar->Bytes(value, sizeof(T));
+}
+
+static void Serialize(HWInfoArchive *ar, bool *value) {
+  uint8_t byte = *value;
+  ar->Bytes(&byte, sizeof(byte));
+  *value = (byte != 0);
+}
+
+static void Serialize(HWInfoArchive *ar, std::string *value) {
+  size_t length = value->size();
+  if (!ar->Count(&length)) {
+    return;
+  }
+  value->resize(length);
+  ar->Bytes(&(*value)[0], length);
+}
+
+static void Serialize(HWInfoArchive *ar, std::bitset<32> *value) {
+  uint32_t bits = static_cast<uint32_t>(value->to_ulong());
+  ar->Bytes(&bits, sizeof(bits));
+  *value = bits;
+}
+
+template <class A, class B>
+static void Serialize(HWInfoArchive *ar, std::pair<A, B> *value) {
+  Serialize(ar, &value->first);
+  Serialize(ar, &value->second);
+}
+
+template <class T>
+static void Serialize(HWInfoArchive *ar, std::vector<T> *value) {
+  size_t count = value->size();
+  if (!ar->Count(&count)) {
+    return;
+  }
+  value->resize(count);
+  for (size_t i = 0; i < count && ar->IsValid(); i++) {
+    Serialize(ar, &(*value)[i]);
+  }
+}
+
+template <class K, class V>
+static void Serialize(HWInfoArchive *ar, std::map<K, V> *value) {
+  size_t count = value->size();
+  if (!ar->Count(&count)) {
+    return;
+  }
+
+  if (!ar->IsReading()) {
+    for (auto &entry : *value) {
+      K key = entry.first;
+      Serialize(ar, &key);
+      Serialize(ar, &entry.second);
+    }
+    return;
+  }
+
+  value->clear();
+  for (size_t i = 0; i < count && ar->IsValid(); i++) {
+    K key = {};
+    V entry = {};
+    Serialize(ar, &key);
+    Serialize(ar, &entry);
+    (*value)[key] = std::move(entry);
+  }
+}
+
+static void Serialize(HWInfoArchive *ar, HWDynBwLimitInfo *value) {
+  Serialize(ar, &value->cur_mode);
+  for (int i = 0; i < kBwModeMax; i++) {
+    Serialize(ar, &value->total_bw_limit[i]);
+    Serialize(ar, &value->pipe_bw_limit[i]);
+  }
+}
+
+static void Serialize(HWInfoArchive *ar, HWPipeCaps *value) {
+  Serialize(ar, &value->type);
+  Serialize(ar, &value->id);
+  Serialize(ar, &value->master_pipe_id);
+  Serialize(ar, &value->max_rects);
+  Serialize(ar, &value->inverse_pma);
+  Serialize(ar, &value->dgm_csc_version);
+  Serialize(ar, &value->tm_lut_version_map);
+  Serialize(ar, &value->block_sec_ui);
+}
+
+static void Serialize(HWInfoArchive *ar, HWRotatorInfo *value) {
+  Serialize(ar, &value->num_rotator);
+  Serialize(ar, &value->has_downscale);
+  Serialize(ar, &value->device_path);
+  Serialize(ar, &value->min_downscale);
+  Serialize(ar, &value->downscale_compression);
+  Serialize(ar, &value->max_line_width);
+}
+
+static void Serialize(HWInfoArchive *ar, HWDestScalarInfo *value) {
+  Serialize(ar, &value->count);
+  Serialize(ar, &value->max_input_width);
+  Serialize(ar, &value->max_output_width);
+  Serialize(ar, &value->max_scale_up);
+  Serialize(ar, &value->prefill_lines);
+}
+
+static void Serialize(HWInfoArchive *ar, InlineRotationInfo *value) {
+  Serialize(ar, &value->inrot_version);
+  Serialize(ar, &value->inrot_fmts_supported);
+  Serialize(ar, &value->max_downscale_rt);
+  Serialize(ar, &value->max_ds_without_pre_downscaler);
+}
+
+static void Serialize(HWInfoArchive *ar, HWResourceInfo *value) {
+  Serialize(ar, &value->hw_version);
+  Serialize(ar, &value->num_dma_pipe);
+  Serialize(ar, &value->num_vig_pipe);
+  Serialize(ar, &value->num_rgb_pipe);
+  Serialize(ar, &value->num_cursor_pipe);
+  Serialize(ar, &value->num_blending_stages);
+  Serialize(ar, &value->num_solidfill_stages);
+  Serialize(ar, &value->max_scale_up);
+  Serialize(ar, &value->max_scale_down);
+  Serialize(ar, &value->max_bandwidth_low);
+  Serialize(ar, &value->max_bandwidth_high);
+  Serialize(ar, &value->max_mixer_width);
+  Serialize(ar, &value->max_pipe_width);
+  Serialize(ar, &value->max_scaler_pipe_width);
+  Serialize(ar, &value->max_rotation_pipe_width);
+  Serialize(ar, &value->max_cursor_size);
+  Serialize(ar, &value->max_pipe_bw);
+  Serialize(ar, &value->max_pipe_bw_high);
+  Serialize(ar, &value->max_sde_clk);
+  Serialize(ar, &value->clk_fudge_factor);
+  Serialize(ar, &value->macrotile_nv12_factor);
+  Serialize(ar, &value->macrotile_factor);
+  Serialize(ar, &value->linear_factor);
+  Serialize(ar, &value->scale_factor);
+  Serialize(ar, &value->extra_fudge_factor);
+  Serialize(ar, &value->amortizable_threshold);
+  Serialize(ar, &value->system_overhead_lines);
+  Serialize(ar, &value->has_ubwc);
+  Serialize(ar, &value->has_decimation);
+  Serialize(ar, &value->has_non_scalar_rgb);
+  Serialize(ar, &value->is_src_split);
+  Serialize(ar, &value->separate_rotator);
+  Serialize(ar, &value->has_qseed3);
+  Serialize(ar, &value->has_concurrent_writeback);
+  Serialize(ar, &value->has_ppp);
+  Serialize(ar, &value->has_excl_rect);
+  Serialize(ar, &value->writeback_index);
+  Serialize(ar, &value->dyn_bw_info);
+  Serialize(ar, &value->hw_pipes);
+  Serialize(ar, &value->supported_formats_map);
+  Serialize(ar, &value->hw_rot_info);
+  Serialize(ar, &value->hw_dest_scalar_info);
+  Serialize(ar, &value->has_hdr);
+  Serialize(ar, &value->smart_dma_rev);
+  Serialize(ar, &value->ib_fudge_factor);
+  Serialize(ar, &value->undersized_prefill_lines);
+  Serialize(ar, &value->comp_ratio_rt_map);
+  Serialize(ar, &value->comp_ratio_nrt_map);
+  Serialize(ar, &value->cache_size);
+  Serialize(ar, &value->pipe_qseed3_version);
+  Serialize(ar, &value->min_prefill_lines);
+  Serialize(ar, &value->inline_rot_info);
+  Serialize(ar, &value->src_tone_map);
+  Serialize(ar, &value->secure_disp_blend_stage);
+  Serialize(ar, &value->line_width_constraints_count);
+  Serialize(ar, &value->line_width_limits);
+  Serialize(ar, &value->line_width_constraints);
+  Serialize(ar, &value->num_mnocports);
+  Serialize(ar, &value->mnoc_bus_width);
+  Serialize(ar, &value->use_baselayer_for_stage);
+  Serialize(ar, &value->has_micro_idle);
+  Serialize(ar, &value->ubwc_version);
+}
+
+static uint32_t Checksum(const uint8_t *data, size_t size) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+std::string HWInfoCache::GetKey(int drm_fd) {
+  struct utsname kernel = {};
+  if (uname(&kernel)) {
+    return "";
+  }
+
+  drmVersionPtr version = drmGetVersion(drm_fd);
+  if (!version) {
+    return "";
+  }
+
+  char driver[256] = {};
+  snprintf(driver, sizeof(driver), "%s %d.%d.%d %s", version->name ? version->name : "",
+           version->version_major, version->version_minor, version->version_patchlevel,
+           version->date ? version->date : "");
+  drmFreeVersion(version);
+
+  return std::string(kernel.release) + " " + kernel.version + " " + driver;
+}
+
+void HWInfoCache::Serialize(const HWResourceInfo &hw_resource, std::vector<uint8_t> *payload) {
+  HWResourceInfo copy = hw_resource;
+  HWInfoArchive ar(payload);
+  payload->clear();
+  sdm::Serialize(&ar, &copy);
+}
+
+bool HWInfoCache::Load(const char *path, const std::string &key, HWResourceInfo *hw_resource,
+                       std::vector<uint8_t> *payload) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st = {};
+  void *map = MAP_FAILED;
+  if (!fstat(fd, &st) && st.st_size > 0) {
+    map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  HWInfoArchive header(reinterpret_cast<const uint8_t *>(map), size_t(st.st_size));
+  uint32_t magic = 0, version = 0, payload_checksum = 0;
+  std::string stored_key;
+  size_t payload_size = 0;
+  sdm::Serialize(&header, &magic);
+  sdm::Serialize(&header, &version);
+  sdm::Serialize(&header, &stored_key);
+  header.Count(&payload_size);
+  sdm::Serialize(&header, &payload_checksum);
+
+  bool loaded = false;
+  if (!header.IsValid() || magic != kMagic || version != kVersion) {
+    DLOGI("Ignoring %s, unsupported format", path);
+  } else if (stored_key != key) {
+    DLOGI("Ignoring %s, recorded for \"%s\"", path, stored_key.c_str());
+  } else if (payload_size != header.Remaining()) {
+    DLOGW("Ignoring %s, truncated", path);
+  } else {
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(map) + (st.st_size - payload_size);
+    HWResourceInfo cached;
+    HWInfoArchive ar(data, payload_size);
+    sdm::Serialize(&ar, &cached);
+    if (Checksum(data, payload_size) != payload_checksum || !ar.IsComplete()) {
+      DLOGW("Ignoring %s, corrupted", path);
+    } else {
+      *hw_resource = cached;
+      payload->assign(data, data + payload_size);
+      loaded = true;
+    }
+  }
+  munmap(map, size_t(st.st_size));
+
+  return loaded;
+}
+
+bool HWInfoCache::Store(const char *path, const std::string &key,
+                        const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> buffer;
+  HWInfoArchive ar(&buffer);
+  uint32_t magic = kMagic, version = kVersion, payload_checksum = 0;
+  std::string stored_key = key;
+  size_t payload_size = payload.size();
+  payload_checksum = Checksum(payload.data(), payload.size());
+  sdm::Serialize(&ar, &magic);
+  sdm::Serialize(&ar, &version);
+  sdm::Serialize(&ar, &stored_key);
+  ar.Count(&payload_size);
+  sdm::Serialize(&ar, &payload_checksum);
+  buffer.insert(buffer.end(), payload.begin(), payload.end());
+
+  // Write a temporary file and rename it, so that a restart never observes a partial cache.
+  std::string tmp_path = std::string(path) + ".tmp";
+  FILE *file = fopen(tmp_path.c_str(), "wb");
+  if (!file) {
+    DLOGW("Unable to create %s: %s", tmp_path.c_str(), strerror(errno));
+    return false;
+  }
+  bool written = (fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size());
+  written = (fclose(file) == 0) && written;
+  if (!written || rename(tmp_path.c_str(), path)) {
+    DLOGW("Unable to write %s: %s", path, strerror(errno));
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  DLOGI("Stored hardware resource info in %s", path);
+  return true;
+}
+
+}  // namespace sdm
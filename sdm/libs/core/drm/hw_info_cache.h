@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_INFO_CACHE_H__
+#define __HW_INFO_CACHE_H__
+
+#include <private/hw_info_types.h>
+
+#include <string>
+#include <vector>
+
+namespace sdm {
+
+// Persists the HWResourceInfo parsed by HWInfoDRM, so that a restarted composer does not need to
+// query the driver again before it can bring up displays. The cache is keyed by the kernel build
+// and the DRM driver version, and is discarded when either of them changes.
+class HWInfoCache {
+ public:
+  static std::string GetKey(int drm_fd);
+  static bool Load(const char *path, const std::string &key, HWResourceInfo *hw_resource,
+                   std::vector<uint8_t> *payload);
+  static bool Store(const char *path, const std::string &key, const std::vector<uint8_t> &payload);
+  static void Serialize(const HWResourceInfo &hw_resource, std::vector<uint8_t> *payload);
+
+ private:
+  // Bump whenever the fields of HWResourceInfo or the order they are stored in change.
+  static const uint32_t kVersion = 1;
+  static const uint32_t kMagic = 0x48574943;  // "HWIC"
+};
+
+}  // namespace sdm
+
+#endif  // __HW_INFO_CACHE_H__
@@ -42,6 +42,7 @@
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/sys.h>
+#include <utils/thread_policy.h>
 
 #include <algorithm>
 #include <fstream>
@@ -53,6 +54,7 @@
 #include <vector>
 
 #include "hw_info_drm.h"
+#include "hw_info_cache.h"
 
 #ifndef DRM_FORMAT_MOD_QCOM_COMPRESSED
 #define DRM_FORMAT_MOD_QCOM_COMPRESSED fourcc_mod_code(QCOM, 1)
@@ -137,12 +139,22 @@ DisplayError HWInfoDRM::Init() {
       DLOGE("Failed to get DRMManagerInterface");
       return kErrorCriticalResource;
     }
+
+    int value = 0;
+    Debug::GetProperty(DISABLE_HW_INFO_CACHE_PROP, &value);
+    if (value != 1) {
+      cache_key_ = HWInfoCache::GetKey(dev_fd);
+    }
   }
 
   return kErrorNone;
 }
 
 void HWInfoDRM::Deinit() {
+  if (verify_thread_.joinable()) {
+    verify_thread_.join();
+  }
+
   delete hw_resource_;
   hw_resource_ = nullptr;
 
@@ -180,6 +192,49 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
     return kErrorNone;
   }
 
+  // Use the info stored by a previous instance on the same kernel and driver, and check it against
+  // the driver in the background instead of holding up display bring up.
+  if (!cache_key_.empty() &&
+      HWInfoCache::Load(kCachePath, cache_key_, hw_resource, &cached_payload_)) {
+    DLOGI("Loaded hardware resource info from %s", kCachePath);
+    hw_resource_ = new HWResourceInfo(*hw_resource);
+    verify_thread_ = std::thread(&HWInfoDRM::VerifyCache, this);
+    return kErrorNone;
+  }
+
+  QueryHWResourceInfo(hw_resource, true /* query_wb */);
+  hw_resource_ = new HWResourceInfo(*hw_resource);
+
+  if (!cache_key_.empty()) {
+    std::vector<uint8_t> payload;
+    HWInfoCache::Serialize(*hw_resource, &payload);
+    HWInfoCache::Store(kCachePath, cache_key_, payload);
+  }
+
+  return kErrorNone;
+}
+
+void HWInfoDRM::VerifyCache() {
+  ThreadPolicy::Apply(kThreadClassBackground, "SDM_HWInfoVerify");
+
+  HWResourceInfo hw_resource;
+  // Writeback caps need a connector reservation, which could race with virtual display creation.
+  // They are reported by the same driver the key identifies, so the cached ones are kept.
+  QueryHWResourceInfo(&hw_resource, false /* query_wb */);
+  auto it = hw_resource_->supported_formats_map.find(kHWWBIntfOutput);
+  if (it != hw_resource_->supported_formats_map.end()) {
+    hw_resource.supported_formats_map[kHWWBIntfOutput] = it->second;
+  }
+
+  std::vector<uint8_t> payload;
+  HWInfoCache::Serialize(hw_resource, &payload);
+  if (payload != cached_payload_) {
+    DLOGW("Cached hardware resource info is stale, it is refreshed for the next start");
+    HWInfoCache::Store(kCachePath, cache_key_, payload);
+  }
+}
+
+void HWInfoDRM::QueryHWResourceInfo(HWResourceInfo *hw_resource, bool query_wb) {
   hw_resource->num_blending_stages = 1;
   hw_resource->max_pipe_width = 2560;
   hw_resource->max_cursor_size = 128;
@@ -217,7 +272,9 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
 
   GetSystemInfo(hw_resource);
   GetHWPlanesInfo(hw_resource);
-  GetWBInfo(hw_resource);
+  if (query_wb) {
+    GetWBInfo(hw_resource);
+  }
 
   // Disable destination scalar count to 0 if extension library is not present or disabled
   // through property
@@ -269,13 +326,6 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
           hw_resource->dyn_bw_info.total_bw_limit[index],
           hw_resource->dyn_bw_info.pipe_bw_limit[index]);
   }
-
-  if (!hw_resource_) {
-    hw_resource_ = new HWResourceInfo();
-    *hw_resource_ = *hw_resource;
-  }
-
-  return kErrorNone;
 }
 
 void HWInfoDRM::GetSystemInfo(HWResourceInfo *hw_resource) {
@@ -35,6 +35,8 @@
 #include <drm_interface.h>
 #include <private/hw_info_types.h>
 #include <bitset>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "hw_info_interface.h"
@@ -52,6 +54,8 @@ class HWInfoDRM: public HWInfoInterface {
 
  private:
   void Deinit();
+  void QueryHWResourceInfo(HWResourceInfo *hw_resource, bool query_wb);
+  void VerifyCache();
   DisplayError GetHWRotatorInfo(HWResourceInfo *hw_resource);
   void GetSystemInfo(HWResourceInfo *hw_resource);
   void GetHWPlanesInfo(HWResourceInfo *hw_resource);
@@ -72,9 +76,13 @@ class HWInfoDRM: public HWInfoInterface {
 
   sde_drm::DRMManagerInterface *drm_mgr_intf_ = {};
   bool default_mode_ = false;
+  std::string cache_key_;  // empty when the resource info is not cached across restarts
+  std::vector<uint8_t> cached_payload_;
+  std::thread verify_thread_;
 
   static const int kMaxStringLength = 1024;
   static const int kKiloUnit = 1000;
+  static constexpr const char *kCachePath = "/data/vendor/display/hw_resource_info.bin";
 
   static HWResourceInfo *hw_resource_;
 };
@@ -28,8 +28,10 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <utils/debug.h>
 #include <utils/sys.h>
+#include <utils/thread_policy.h>
 #include <vector>
 #include <string>
 #include <cstring>
@@ -68,9 +70,37 @@ DisplayError HWPeripheralDRM::Init() {
 
   PopulateBitClkRates();
 
+  int value = 0;
+  Debug::GetProperty(ENABLE_ASYNC_BRIGHTNESS_PROP, &value);
+  async_brightness_ = (value == 1);
+  if (async_brightness_) {
+    exit_brightness_ = false;
+    brightness_thread_ = std::thread(&HWPeripheralDRM::BrightnessThread, this);
+  }
+
   return kErrorNone;
 }
 
+DisplayError HWPeripheralDRM::Deinit() {
+  if (brightness_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(brightness_lock_);
+      exit_brightness_ = true;
+    }
+    brightness_cv_.notify_one();
+    brightness_thread_.join();
+    DLOGI("%s: %" PRIu64 " brightness writes, %" PRIu64 " levels superseded", device_name_,
+          brightness_writes_, brightness_coalesced_);
+  }
+
+  if (brightness_fd_ >= 0) {
+    Sys::close_(brightness_fd_);
+    brightness_fd_ = -1;
+  }
+
+  return HWDeviceDRM::Deinit();
+}
+
 void HWPeripheralDRM::InitDestScaler() {
   if (hw_resource_.hw_dest_scalar_info.count) {
     // Do all destination scaler block resource allocations here.
@@ -689,34 +719,80 @@ DisplayError HWPeripheralDRM::SetPanelBrightness(int level) {
     return kErrorDeferred;
   }
 
-  char buffer[kMaxSysfsCommandLength] = {0};
-
   if (brightness_base_path_.empty()) {
     return kErrorHardware;
   }
 
-  std::string brightness_node(brightness_base_path_ + "brightness");
-  int fd = Sys::open_(brightness_node.c_str(), O_RDWR);
+  if (!async_brightness_) {
+    return WriteBrightness(level);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(brightness_lock_);
+    if (brightness_pending_) {
+      brightness_coalesced_++;
+    }
+    pending_brightness_level_ = level;
+    brightness_pending_ = true;
+  }
+  brightness_cv_.notify_one();
+
+  return kErrorNone;
+}
+
+int HWPeripheralDRM::GetBrightnessFd() {
+  if (brightness_fd_ < 0) {
+    std::string brightness_node(brightness_base_path_ + "brightness");
+    brightness_fd_ = Sys::open_(brightness_node.c_str(), O_RDWR);
+    if (brightness_fd_ < 0) {
+      DLOGE("Failed to open node = %s, error = %s ", brightness_node.c_str(),
+            strerror(errno));
+    }
+  }
+
+  return brightness_fd_;
+}
+
+DisplayError HWPeripheralDRM::WriteBrightness(int level) {
+  char buffer[kMaxSysfsCommandLength] = {0};
+
+  int fd = GetBrightnessFd();
   if (fd < 0) {
-    DLOGE("Failed to open node = %s, error = %s ", brightness_node.c_str(),
-          strerror(errno));
     return kErrorFileDescriptor;
   }
 
   int32_t bytes = snprintf(buffer, kMaxSysfsCommandLength, "%d\n", level);
   ssize_t ret = Sys::pwrite_(fd, buffer, static_cast<size_t>(bytes), 0);
   if (ret <= 0) {
-    DLOGE("Failed to write to node = %s, error = %s ", brightness_node.c_str(),
+    DLOGE("Failed to write to node = %sbrightness, error = %s ", brightness_base_path_.c_str(),
           strerror(errno));
-    Sys::close_(fd);
     return kErrorHardware;
   }
 
-  Sys::close_(fd);
-
   return kErrorNone;
 }
 
+void HWPeripheralDRM::BrightnessThread() {
+  ThreadPolicy::Apply(kThreadClassBackground, "SDM_Brightness");
+
+  std::unique_lock<std::mutex> lock(brightness_lock_);
+  while (true) {
+    brightness_cv_.wait(lock, [this] { return exit_brightness_ || brightness_pending_; });
+    if (exit_brightness_) {
+      break;
+    }
+
+    int level = pending_brightness_level_;
+    brightness_pending_ = false;
+
+    // Levels set while the node is being written are folded into the next write.
+    lock.unlock();
+    WriteBrightness(level);
+    lock.lock();
+    brightness_writes_++;
+  }
+}
+
 DisplayError HWPeripheralDRM::GetPanelBrightness(int *level) {
   char value[kMaxStringLength] = {0};
 
@@ -729,11 +805,17 @@ DisplayError HWPeripheralDRM::GetPanelBrightness(int *level) {
     return kErrorHardware;
   }
 
-  std::string brightness_node(brightness_base_path_ + "brightness");
-  int fd = Sys::open_(brightness_node.c_str(), O_RDWR);
+  if (async_brightness_) {
+    // A level not yet written is what the panel is about to show.
+    std::lock_guard<std::mutex> lock(brightness_lock_);
+    if (brightness_pending_) {
+      *level = pending_brightness_level_;
+      return kErrorNone;
+    }
+  }
+
+  int fd = GetBrightnessFd();
   if (fd < 0) {
-    DLOGE("Failed to open brightness node = %s, error = %s", brightness_node.c_str(),
-           strerror(errno));
     return kErrorFileDescriptor;
   }
 
@@ -741,12 +823,9 @@ DisplayError HWPeripheralDRM::GetPanelBrightness(int *level) {
     *level = atoi(value);
   } else {
     DLOGE("Failed to read panel brightness");
-    Sys::close_(fd);
     return kErrorHardware;
   }
 
-  Sys::close_(fd);
-
   return kErrorNone;
 }
 
@@ -31,7 +31,10 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __HW_PERIPHERAL_DRM_H__
 
 #include <vector>
+#include <condition_variable>  // NOLINT
+#include <mutex>
 #include <string>
+#include <thread>
 #include "hw_device_drm.h"
 
 namespace sdm {
@@ -49,6 +52,7 @@ class HWPeripheralDRM : public HWDeviceDRM {
 
  protected:
   virtual DisplayError Init();
+  virtual DisplayError Deinit();
   virtual DisplayError Validate(HWLayers *hw_layers);
   virtual DisplayError Commit(HWLayers *hw_layers);
   virtual DisplayError Flush(HWLayers *hw_layers);
@@ -88,6 +92,9 @@ class HWPeripheralDRM : public HWDeviceDRM {
                               idle_pc_state_);
   }
   void CacheDestScalarData();
+  DisplayError WriteBrightness(int level);
+  int GetBrightnessFd();
+  void BrightnessThread();
 
   struct DestScalarCache {
     SDEScaler scalar_data = {};
@@ -105,6 +112,18 @@ class HWPeripheralDRM : public HWDeviceDRM {
   void PopulateBitClkRates();
   std::vector<uint64_t> bitclk_rates_;
   std::string brightness_base_path_ = "";
+  // Brightness node, kept open. With async brightness, a writer thread writes the latest level
+  // set and levels superseded before it got to them are dropped.
+  int brightness_fd_ = -1;
+  bool async_brightness_ = false;
+  bool exit_brightness_ = false;
+  bool brightness_pending_ = false;
+  int pending_brightness_level_ = 0;
+  uint64_t brightness_writes_ = 0;
+  uint64_t brightness_coalesced_ = 0;
+  std::thread brightness_thread_;
+  std::mutex brightness_lock_;
+  std::condition_variable brightness_cv_;
 };
 
 }  // namespace sdm
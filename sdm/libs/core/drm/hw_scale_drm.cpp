@@ -28,6 +28,7 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <utils/debug.h>
 
 #include "hw_scale_drm.h"
@@ -72,6 +73,23 @@ void HWScaleDRM::SetScaler(const HWScaleData &scale_data, SDEScaler *scaler) {
   }
 }
 
+void HWScaleDRM::SetPipeScaler(uint32_t pipe_id, const HWScaleData &scale_data,
+                               SDEScaler *scaler) {
+  // The config is a function of the scale data alone, so a byte equal copy of it is enough to
+  // reuse the previous result.
+  auto it = pipe_scalers_.find(pipe_id);
+  if (it != pipe_scalers_.end() &&
+      !memcmp(&it->second.scale_data, &scale_data, sizeof(scale_data))) {
+    *scaler = it->second.scaler;
+    return;
+  }
+
+  SetScaler(scale_data, scaler);
+  CachedScaler &cached = pipe_scalers_[pipe_id];
+  cached.scale_data = scale_data;
+  cached.scaler = *scaler;
+}
+
 void HWScaleDRM::SetScalerV2(const HWScaleData &scale_data, sde_drm_scaler_v2 *scaler) {
   if (!scale_data.enable.scale && !scale_data.enable.direction_detection &&
       !scale_data.enable.detail_enhance) {
@@ -39,6 +39,8 @@
 #include <drm/sde_drm.h>
 #include <private/hw_info_types.h>
 
+#include <unordered_map>
+
 namespace sdm {
 
 struct SDEScaler {
@@ -51,10 +53,19 @@ class HWScaleDRM {
   enum class Version { V2 };
   explicit HWScaleDRM(Version v) : version_(v) {}
   void SetScaler(const HWScaleData &scale, SDEScaler *scaler);
+  // Same as SetScaler, but reuses the config of the previous call for the pipe when its scale
+  // data is unchanged, as is the case for every frame of steady video playback.
+  void SetPipeScaler(uint32_t pipe_id, const HWScaleData &scale, SDEScaler *scaler);
 
  private:
+  struct CachedScaler {
+    HWScaleData scale_data = {};
+    SDEScaler scaler = {};
+  };
+
   void SetScalerV2(const HWScaleData &scale, sde_drm_scaler_v2 *scaler_v2);
   Version version_ = Version::V2;
+  std::unordered_map<uint32_t, CachedScaler> pipe_scalers_ = {};
 };
 
 }  // namespace sdm
@@ -39,6 +39,9 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
@@ -91,6 +94,27 @@ static int32_t GetEOTF(const GammaTransfer &transfer) {
   return hdr_transfer;
 }
 
+std::mutex HWTVDRM::sink_cache_lock_;
+std::map<size_t, HWTVDRM::SinkConfigs> HWTVDRM::sink_cache_;
+
+static size_t GetEDIDHash(const std::vector<uint8_t> &edid) {
+  return std::hash<std::string>()(std::string(edid.begin(), edid.end()));
+}
+
+static bool IsSameModeList(const std::vector<drmModeModeInfo> &modes,
+                           const std::vector<sde_drm::DRMModeInfo> &connector_modes) {
+  if (modes.size() != connector_modes.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < modes.size(); i++) {
+    if (memcmp(&modes[i], &connector_modes[i].mode, sizeof(drmModeModeInfo))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 static float GetMaxOrAverageLuminance(float luminance) {
   return (50.0f * powf(2.0f, (luminance / 32.0f)));
 }
@@ -107,6 +131,53 @@ HWTVDRM::HWTVDRM(int32_t display_id, BufferAllocator *buffer_allocator,
   display_id_ = display_id;
 }
 
+void HWTVDRM::InitializeConfigs() {
+  std::lock_guard<std::mutex> lock(sink_cache_lock_);
+  default_config_ = -1;
+  if (connector_info_.edid.empty()) {
+    HWDeviceDRM::InitializeConfigs();
+    return;
+  }
+
+  // The driver may filter modes by link bandwidth, so a cached list is only reused when the
+  // modes reported for the sink are unchanged.
+  size_t edid_hash = GetEDIDHash(connector_info_.edid);
+  auto it = sink_cache_.find(edid_hash);
+  if (it != sink_cache_.end() && IsSameModeList(it->second.modes, connector_info_.modes)) {
+    SinkConfigs &configs = it->second;
+    display_attributes_ = configs.display_attributes;
+    current_mode_index_ = configs.preferred_mode_index;
+    resolution_switch_enabled_ = configs.resolution_switch_enabled;
+    default_config_ = configs.default_config;
+    SetDisplaySwitchMode(current_mode_index_);
+    DLOGI("Reusing %zu modes of known sink, preferred mode %d", display_attributes_.size(),
+          current_mode_index_);
+    return;
+  }
+
+  HWDeviceDRM::InitializeConfigs();
+  for (uint32_t i = 0; i < connector_info_.modes.size(); i++) {
+    auto &mode = connector_info_.modes[i].mode;
+    if (mode.hdisplay == 640 && mode.vdisplay == 480) {
+      default_config_ = INT32(i);
+      break;
+    }
+  }
+
+  if (it == sink_cache_.end() && sink_cache_.size() >= kMaxCachedSinks) {
+    sink_cache_.erase(sink_cache_.begin());
+  }
+  SinkConfigs &configs = sink_cache_[edid_hash];
+  configs.modes.clear();
+  for (auto &mode_info : connector_info_.modes) {
+    configs.modes.push_back(mode_info.mode);
+  }
+  configs.display_attributes = display_attributes_;
+  configs.preferred_mode_index = current_mode_index_;
+  configs.resolution_switch_enabled = resolution_switch_enabled_;
+  configs.default_config = default_config_;
+}
+
 DisplayError HWTVDRM::SetDisplayAttributes(uint32_t index) {
   if (index >= connector_info_.modes.size()) {
     DLOGE("Invalid mode index %d mode size %d", index, UINT32(connector_info_.modes.size()));
@@ -116,6 +187,7 @@ DisplayError HWTVDRM::SetDisplayAttributes(uint32_t index) {
   current_mode_index_ = index;
   PopulateHWPanelInfo();
   UpdateMixerAttributes();
+  ResetCommittedHDRMetaData();
 
   DLOGI("Display attributes[%d]: WxH: %dx%d, DPI: %fx%f, FPS: %d, LM_SPLIT: %d, V_BACK_PORCH: %d," \
         " V_FRONT_PORCH: %d, V_PULSE_WIDTH: %d, V_TOTAL: %d, H_TOTAL: %d, CLK: %dKHZ, TOPOLOGY: %d",
@@ -172,24 +244,20 @@ DisplayError HWTVDRM::Deinit() {
     drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id,
                               &hdr_metadata_);
   }
+  ResetCommittedHDRMetaData();
 
   return HWDeviceDRM::Deinit();
 }
 
 DisplayError HWTVDRM::GetDefaultConfig(uint32_t *default_config) {
-  bool found = false;
-
-  for (uint32_t i = 0; i < connector_info_.modes.size(); i++) {
-    auto &mode = connector_info_.modes[i].mode;
-    if (mode.hdisplay == 640 && mode.vdisplay == 480) {
-      *default_config = i;
-      found = true;
-      DLOGI("Found 640x480 default mode, using as failure fallback");
-      break;
-    }
+  if (default_config_ < 0) {
+    return kErrorNotSupported;
   }
 
-  return found ? kErrorNone : kErrorNotSupported;
+  *default_config = UINT32(default_config_);
+  DLOGI("Found 640x480 default mode, using as failure fallback");
+
+  return kErrorNone;
 }
 
 DisplayError HWTVDRM::PowerOff(bool teardown) {
@@ -212,6 +280,8 @@ DisplayError HWTVDRM::PowerOff(bool teardown) {
     DLOGE("%s failed with error %d", __FUNCTION__, ret);
     return kErrorHardware;
   }
+  // The sink may drop its InfoFrame state while the link is down.
+  ResetCommittedHDRMetaData();
 
   return kErrorNone;
 }
@@ -272,7 +342,16 @@ DisplayError HWTVDRM::Commit(HWLayers *hw_layers) {
   if (error != kErrorNone) {
     return error;
   }
-  return HWDeviceDRM::Commit(hw_layers);
+
+  error = HWDeviceDRM::Commit(hw_layers);
+  if (hdr_metadata_pending_ && error == kErrorNone) {
+    committed_hdr_metadata_ = pending_hdr_metadata_;
+    committed_hdr_plus_payload_.swap(pending_hdr_plus_payload_);
+    hdr_metadata_committed_ = true;
+  }
+  hdr_metadata_pending_ = false;
+
+  return error;
 }
 
 DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
@@ -344,8 +423,7 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
       hdr_metadata_.hdr_plus_payload_size = 0;
     }
 
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
+    SetHDRMetaData(hdr_op);
   } else if (hdr_op == HWHDRLayerInfo::kSet && !in_multiset_) {
     // Special case to handle multiple HDR layers.
     // If there are multiple HDR layers, then simply drop all metadata (which is optional) since
@@ -354,8 +432,7 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
     InitMaxHDRMetaData();
     in_multiset_ = true;
     reset_hdr_flag_ = false;
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
+    SetHDRMetaData(hdr_op);
   } else if (hdr_op == HWHDRLayerInfo::kReset) {
     memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
     hdr_metadata_.hdr_supported = 1;
@@ -364,8 +441,7 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
     in_multiset_ = false;
     gettimeofday(&hdr_reset_start_, NULL);
 
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
+    SetHDRMetaData(hdr_op);
   } else if (hdr_op == HWHDRLayerInfo::kNoOp) {
     // TODO(user): This case handles the state transition from HDR_ENABLED to HDR_DISABLED.
     // As per HDMI spec requirement, we need to send zero metadata for atleast 2 sec after end of
@@ -383,8 +459,7 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
         hdr_metadata_.hdr_state = HDR_DISABLE;
         reset_hdr_flag_ = false;
 
-        drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id,
-                                  &hdr_metadata_);
+        SetHDRMetaData(hdr_op);
       }
     }
   }
@@ -392,6 +467,33 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
   return error;
 }
 
+void HWTVDRM::SetHDRMetaData(HWHDRLayerInfo::HDROperation operation) {
+  // The connector keeps the metadata of the last commit, and some sinks renegotiate on every
+  // InfoFrame, so only send metadata that differs from it. HDR10+ payloads change per frame and
+  // are compared by content. The driver copies them in the commit ioctl, so the payload can
+  // stay in the layer stack instead of being copied into a blob.
+  const uint8_t *payload = reinterpret_cast<const uint8_t *>(hdr_metadata_.hdr_plus_payload);
+  const uint32_t payload_size = payload ? hdr_metadata_.hdr_plus_payload_size : 0;
+  pending_hdr_metadata_ = hdr_metadata_;
+  pending_hdr_metadata_.hdr_plus_payload = 0;
+  if (hdr_metadata_committed_ &&
+      !memcmp(&pending_hdr_metadata_, &committed_hdr_metadata_, sizeof(pending_hdr_metadata_)) &&
+      payload_size == committed_hdr_plus_payload_.size() &&
+      std::equal(payload, payload + payload_size, committed_hdr_plus_payload_.begin())) {
+    return;
+  }
+
+  pending_hdr_plus_payload_.assign(payload, payload + payload_size);
+  hdr_metadata_pending_ = true;
+  drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
+  DumpHDRMetaData(operation);
+}
+
+void HWTVDRM::ResetCommittedHDRMetaData() {
+  hdr_metadata_committed_ = false;
+  committed_hdr_plus_payload_.clear();
+}
+
 void HWTVDRM::DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation) {
   DLOGI("Operation = %d, HDR Metadata: MaxDisplayLuminance = %d MinDisplayLuminance = %d\n"
         "MaxContentLightLevel = %d MaxAverageLightLevel = %d Red_x = %d Red_y = %d Green_x = %d\n"
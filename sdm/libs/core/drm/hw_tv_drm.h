@@ -26,6 +26,7 @@
 #define __HW_TV_DRM_H__
 
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "hw_device_drm.h"
@@ -51,9 +52,21 @@ class HWTVDRM : public HWDeviceDRM {
   virtual DisplayError GetDefaultConfig(uint32_t *default_config);
   virtual DisplayError PowerOn(const HWQosData &qos_data, shared_ptr<Fence> *release_fence);
   virtual DisplayError Deinit();
+  virtual void InitializeConfigs();
 
  private:
+  // Mode list derived from a sink's EDID, reused when the same sink reconnects.
+  struct SinkConfigs {
+    std::vector<drmModeModeInfo> modes = {};
+    std::vector<HWDisplayAttributes> display_attributes = {};
+    uint32_t preferred_mode_index = 0;
+    bool resolution_switch_enabled = false;
+    int32_t default_config = -1;
+  };
+
   DisplayError UpdateHDRMetaData(HWLayers *hw_layers);
+  void SetHDRMetaData(HWHDRLayerInfo::HDROperation operation);
+  void ResetCommittedHDRMetaData();
   void DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation);
   void InitMaxHDRMetaData();
 
@@ -68,6 +81,19 @@ class HWTVDRM : public HWDeviceDRM {
   struct timeval hdr_reset_end_ = {};
   bool reset_hdr_flag_ = false;
   bool in_multiset_ = false;
+  // Metadata sent in the current commit and in the last successful one, the HDR10+ payloads kept
+  // apart since hdr_plus_payload only points at the layer stack of its frame.
+  bool hdr_metadata_pending_ = false;
+  bool hdr_metadata_committed_ = false;
+  drm_msm_ext_hdr_metadata pending_hdr_metadata_ = {};
+  drm_msm_ext_hdr_metadata committed_hdr_metadata_ = {};
+  std::vector<uint8_t> pending_hdr_plus_payload_ = {};
+  std::vector<uint8_t> committed_hdr_plus_payload_ = {};
+  int32_t default_config_ = -1;
+
+  static const size_t kMaxCachedSinks = 8;
+  static std::mutex sink_cache_lock_;
+  static std::map<size_t, SinkConfigs> sink_cache_;  // Keyed by EDID hash
 };
 
 }  // namespace sdm
@@ -190,6 +190,7 @@ DisplayError HWVirtualDRM::SetDisplayAttributes(const HWDisplayAttributes &displ
     if (error != kErrorNone) {
       return error;
     }
+    drm_mgr_intf_->InvalidateConnectorInfo(token_.conn_id);
   }
 
   // Reload connector info for updated info
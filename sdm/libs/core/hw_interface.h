@@ -130,6 +130,9 @@ class HWInterface {
   virtual DisplayError SetBLScale(uint32_t level) = 0;
   virtual DisplayError GetPanelBrightnessBasePath(std::string *base_path) = 0;
   virtual DisplayError SetBlendSpace(const PrimariesTransfer &blend_space) = 0;
+  virtual DisplayError GetFbIdCacheStats(HWFbIdCacheStats *stats) = 0;
+  virtual DisplayError PrefetchFbId(Layer *layer) = 0;
+  virtual DisplayError GetQosVoteStats(HWQosVoteStats *stats) = 0;
 
  protected:
   virtual ~HWInterface() { }
@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include <utils/constants.h>
+#include <utils/formats.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "hw_qos_governor.h"
+
+namespace sdm {
+
+template <class T>
+T HWQosGovernor::Apply(T request, T held, T period_max, bool period_end) {
+  // Fast up, slow down.
+  if (request >= held || period_end) {
+    return std::max(request, period_max);
+  }
+
+  return held;
+}
+
+void HWQosGovernor::Max(const HWQosData &a, const HWQosData &b, HWQosData *max) {
+  max->core_ab_bps = std::max(a.core_ab_bps, b.core_ab_bps);
+  max->core_ib_bps = std::max(a.core_ib_bps, b.core_ib_bps);
+  max->llcc_ab_bps = std::max(a.llcc_ab_bps, b.llcc_ab_bps);
+  max->llcc_ib_bps = std::max(a.llcc_ib_bps, b.llcc_ib_bps);
+  max->dram_ab_bps = std::max(a.dram_ab_bps, b.dram_ab_bps);
+  max->dram_ib_bps = std::max(a.dram_ib_bps, b.dram_ib_bps);
+  max->rot_prefill_bw_bps = std::max(a.rot_prefill_bw_bps, b.rot_prefill_bw_bps);
+  max->clock_hz = std::max(a.clock_hz, b.clock_hz);
+  max->rot_clock_hz = std::max(a.rot_clock_hz, b.rot_clock_hz);
+}
+
+void HWQosGovernor::Vote(const HWQosData &request, bool commit, HWQosData *vote) {
+  uint64_t period = 0;
+  if (hold_ms_) {
+    period = UINT64(std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count()) / hold_ms_;
+  }
+  bool period_end = !valid_ || (period != period_);
+
+  if (!hold_ms_ || !valid_) {
+    *vote = request;
+  } else {
+    // A request landing in a new period closes the last one. Its highest request is the lowest
+    // vote that still covers the frames of that period.
+    const HWQosData &max = period_max_;
+    vote->core_ab_bps = Apply(request.core_ab_bps, held_.core_ab_bps, max.core_ab_bps,
+                              period_end);
+    vote->core_ib_bps = Apply(request.core_ib_bps, held_.core_ib_bps, max.core_ib_bps,
+                              period_end);
+    vote->llcc_ab_bps = Apply(request.llcc_ab_bps, held_.llcc_ab_bps, max.llcc_ab_bps,
+                              period_end);
+    vote->llcc_ib_bps = Apply(request.llcc_ib_bps, held_.llcc_ib_bps, max.llcc_ib_bps,
+                              period_end);
+    vote->dram_ab_bps = Apply(request.dram_ab_bps, held_.dram_ab_bps, max.dram_ab_bps,
+                              period_end);
+    vote->dram_ib_bps = Apply(request.dram_ib_bps, held_.dram_ib_bps, max.dram_ib_bps,
+                              period_end);
+    vote->rot_prefill_bw_bps = Apply(request.rot_prefill_bw_bps, held_.rot_prefill_bw_bps,
+                                     max.rot_prefill_bw_bps, period_end);
+    vote->clock_hz = Apply(request.clock_hz, held_.clock_hz, max.clock_hz, period_end);
+    vote->rot_clock_hz = Apply(request.rot_clock_hz, held_.rot_clock_hz, max.rot_clock_hz,
+                               period_end);
+  }
+
+  if (!commit) {
+    return;
+  }
+
+  stats_.frames++;
+  if (!valid_ || memcmp(&request, &last_request_, sizeof(request))) {
+    stats_.request_changes++;
+  }
+  if (!valid_ || memcmp(vote, &held_, sizeof(*vote))) {
+    stats_.vote_changes++;
+  }
+
+  if (period_end) {
+    period_max_ = request;
+  } else {
+    Max(period_max_, request, &period_max_);
+  }
+  period_ = period;
+  last_request_ = request;
+  held_ = *vote;
+  valid_ = true;
+}
+
+void HWQosGovernor::Reset() {
+  valid_ = false;
+}
+
+void HWQosGovernor::GetCompressionRatio(const UbwcCrStatsVector &cr_stats, float *mean,
+                                        float *peak) {
+  // Buckets count the tiles compressed to each size, in ascending order of size.
+  const float kTileBytes = 256.0f;
+  uint64_t tiles = 0;
+  uint64_t bytes = 0;
+  for (auto &bucket : cr_stats) {
+    if (bucket.first > 0 && bucket.second > 0) {
+      tiles += UINT64(bucket.second);
+      bytes += UINT64(bucket.first) * UINT64(bucket.second);
+    }
+  }
+  if (!tiles) {
+    return;
+  }
+
+  // Lines fetched at the peak rate may all come from the worse compressed parts of the buffer,
+  // so the instantaneous vote goes by the size that 90% of the tiles fit in.
+  *mean = std::min(1.0f, FLOAT(bytes) / (kTileBytes * FLOAT(tiles)));
+  uint64_t covered = 0;
+  for (auto &bucket : cr_stats) {
+    if (bucket.first > 0 && bucket.second > 0) {
+      covered += UINT64(bucket.second);
+      if (covered * 10 >= tiles * 9) {
+        *peak = std::min(1.0f, FLOAT(bucket.first) / kTileBytes);
+        break;
+      }
+    }
+  }
+}
+
+void HWQosGovernor::ScaleForCompression(const HWLayersInfo &info, bool commit,
+                                        HWQosData *request) {
+  if (compression_min_pct_ >= 100) {
+    return;
+  }
+
+  // Each layer weighs in by the bytes it fetches uncompressed.
+  float total_bytes = 0.0f;
+  float average_bytes = 0.0f;
+  float peak_bytes = 0.0f;
+  for (auto &layer : info.hw_layers) {
+    const LayerBuffer &buffer = layer.input_buffer;
+    float bytes = (layer.src_rect.right - layer.src_rect.left) *
+                  (layer.src_rect.bottom - layer.src_rect.top) * GetBufferFormatBpp(buffer.format);
+    if (bytes <= 0.0f) {
+      continue;
+    }
+
+    float mean = 1.0f;
+    float peak = 1.0f;
+    if (IsUBWCFormat(buffer.format)) {
+      GetCompressionRatio(buffer.ubwc_crstats[0], &mean, &peak);
+    }
+    total_bytes += bytes;
+    average_bytes += bytes * mean;
+    peak_bytes += bytes * peak;
+  }
+
+  if (total_bytes <= 0.0f || average_bytes >= total_bytes) {
+    if (commit) {
+      stats_.ubwc_last_pct = 0;
+    }
+    return;
+  }
+
+  float min_scale = FLOAT(compression_min_pct_) / 100.0f;
+  float ab_scale = std::max(min_scale, average_bytes / total_bytes);
+  float ib_scale = std::max(min_scale, peak_bytes / total_bytes);
+  uint64_t requested_dram_ab = request->dram_ab_bps;
+  request->core_ab_bps = UINT64(FLOAT(request->core_ab_bps) * ab_scale);
+  request->llcc_ab_bps = UINT64(FLOAT(request->llcc_ab_bps) * ab_scale);
+  request->dram_ab_bps = UINT64(FLOAT(request->dram_ab_bps) * ab_scale);
+  request->core_ib_bps = UINT64(FLOAT(request->core_ib_bps) * ib_scale);
+  request->llcc_ib_bps = UINT64(FLOAT(request->llcc_ib_bps) * ib_scale);
+  request->dram_ib_bps = UINT64(FLOAT(request->dram_ib_bps) * ib_scale);
+
+  if (commit) {
+    stats_.ubwc_frames++;
+    stats_.ubwc_in_kbps += requested_dram_ab / 1000;
+    stats_.ubwc_out_kbps += request->dram_ab_bps / 1000;
+    stats_.ubwc_last_pct = UINT32((1.0f - ab_scale) * 100.0f);
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_QOS_GOVERNOR_H__
+#define __HW_QOS_GOVERNOR_H__
+
+#include <private/hw_info_types.h>
+
+namespace sdm {
+
+// Filters the clock and bandwidth votes the strategy requests for a display. Increases are voted
+// right away. Decreases are held back and applied only when a hold period ends, lowering the vote
+// to the highest request seen over the last period. Periods are aligned to the monotonic clock,
+// not to the display's own frames, so all displays lower their votes on the same boundaries.
+class HWQosGovernor {
+ public:
+  // A hold period of 0 passes every request through unchanged.
+  explicit HWQosGovernor(uint32_t hold_ms) : hold_ms_(hold_ms) { }
+  // Fills vote for the request. Only commits update the held votes and the stats, validates get
+  // the vote a commit would make at this point.
+  void Vote(const HWQosData &request, bool commit, HWQosData *vote);
+  // Drops held votes, the next request is voted as is.
+  void Reset();
+  // Scales the bandwidth of request by how well the UBWC layers of the frame compress, going by
+  // the CR stats of their buffers. Layers without stats count as uncompressed, and no bandwidth
+  // drops below min_pct of the request.
+  void ScaleForCompression(const HWLayersInfo &info, bool commit, HWQosData *request);
+  void SetCompressionMinPct(uint32_t min_pct) { compression_min_pct_ = min_pct; }
+  const HWQosVoteStats &GetStats() const { return stats_; }
+
+ private:
+  template <class T>
+  static T Apply(T request, T held, T period_max, bool period_end);
+  static void Max(const HWQosData &a, const HWQosData &b, HWQosData *max);
+  static void GetCompressionRatio(const UbwcCrStatsVector &cr_stats, float *mean, float *peak);
+
+  uint32_t hold_ms_ = 0;
+  uint32_t compression_min_pct_ = 50;
+  bool valid_ = false;
+  uint64_t period_ = 0;
+  HWQosData held_ = {};
+  HWQosData period_max_ = {};  // Highest requests in the current period.
+  HWQosData last_request_ = {};
+  HWQosVoteStats stats_ = {};
+};
+
+}  // namespace sdm
+
+#endif  // __HW_QOS_GOVERNOR_H__
@@ -0,0 +1,188 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/formats.h>
+#include <utils/rect.h>
+
+#include <algorithm>
+
+#include "multirect_packer.h"
+
+#define __CLASS__ "MultiRectPacker"
+
+namespace sdm {
+
+void MultiRectPacker::Init(const HWResourceInfo &hw_res_info) {
+  // The second rect of a source pipe shows up as a plane of its own, naming the first as master.
+  stats_ = {};
+  for (auto &pipe_caps : hw_res_info.hw_pipes) {
+    if (pipe_caps.master_pipe_id) {
+      stats_.max_pairs++;
+    }
+  }
+  half_pipe_width_ = FLOAT(hw_res_info.max_pipe_width) / 2.0f;
+}
+
+bool MultiRectPacker::IsCandidate(const Layer &layer) {
+  const LayerRect &src = layer.src_rect;
+  const LayerRect &dst = layer.dst_rect;
+  if (layer.flags.skip || layer.flags.cursor || layer.flags.solid_fill ||
+      !IS_RGB_FORMAT(layer.input_buffer.format) || layer.transform.rotation != 0.0f ||
+      !IsValid(src) || !IsValid(dst)) {
+    return false;
+  }
+
+  return ((src.right - src.left) == (dst.right - dst.left)) &&
+         ((src.bottom - src.top) == (dst.bottom - dst.top));
+}
+
+bool MultiRectPacker::CanPair(const Layer &layer1, const Layer &layer2, bool *parallel) {
+  LayerBufferFormat format1 = layer1.input_buffer.format;
+  LayerBufferFormat format2 = layer2.input_buffer.format;
+  if ((IsUBWCFormat(format1) || IsUBWCFormat(format2)) && (format1 != format2)) {
+    return false;
+  }
+
+  const LayerRect &src1 = layer1.src_rect;
+  const LayerRect &src2 = layer2.src_rect;
+  if (((src1.right - src1.left) <= half_pipe_width_) &&
+      ((src2.right - src2.left) <= half_pipe_width_)) {
+    *parallel = true;
+    return true;
+  }
+
+  const LayerRect &dst1 = layer1.dst_rect;
+  const LayerRect &dst2 = layer2.dst_rect;
+  *parallel = false;
+  return ((dst1.bottom + kSerialGapLines) <= dst2.top) ||
+         ((dst2.bottom + kSerialGapLines) <= dst1.top);
+}
+
+void MultiRectPacker::Pack(HWLayersInfo *hw_layers_info) {
+  std::vector<HWMultiRectPair> &pairs = hw_layers_info->multirect_pairs;
+  const std::vector<uint32_t> &occluded_index = hw_layers_info->occluded_index;
+  pairs.clear();
+  stats_.pairs_planned = 0;
+  if (!stats_.max_pairs) {
+    return;
+  }
+
+  std::vector<Layer *> &layers = hw_layers_info->stack->layers;
+  uint32_t candidates[kMaxCandidates];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < hw_layers_info->app_layer_count && count < kMaxCandidates; i++) {
+    if (IsCandidate(*layers.at(i)) &&
+        (std::find(occluded_index.begin(), occluded_index.end(), i) == occluded_index.end())) {
+      candidates[count++] = i;
+    }
+  }
+  if (count < 2) {
+    return;
+  }
+
+  // Compatibility of each candidate with every other one, as a bit mask per candidate.
+  uint32_t compatible[kMaxCandidates] = {};
+  uint32_t parallel[kMaxCandidates] = {};
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t j = i + 1; j < count; j++) {
+      bool is_parallel = false;
+      if (CanPair(*layers.at(candidates[i]), *layers.at(candidates[j]), &is_parallel)) {
+        compatible[i] |= (1u << j);
+        compatible[j] |= (1u << i);
+        parallel[i] |= (is_parallel ? (1u << j) : 0);
+        parallel[j] |= (is_parallel ? (1u << i) : 0);
+      }
+    }
+  }
+
+  // Greedy matching that always pairs off the most constrained candidate with its most
+  // constrained partner, so that the flexible ones remain for those with fewer options.
+  uint32_t unpaired = (count == kMaxCandidates) ? ~0u : ((1u << count) - 1);
+  while (pairs.size() < stats_.max_pairs) {
+    uint32_t best = count;
+    uint32_t best_options = UINT32_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t options = UINT32(__builtin_popcount(compatible[i] & unpaired));
+      if ((unpaired & (1u << i)) && options && options < best_options) {
+        best = i;
+        best_options = options;
+      }
+    }
+    if (best == count) {
+      break;
+    }
+
+    uint32_t partner = count;
+    uint32_t partner_options = UINT32_MAX;
+    for (uint32_t j = 0; j < count; j++) {
+      uint32_t options = UINT32(__builtin_popcount(compatible[j] & unpaired));
+      if ((compatible[best] & unpaired & (1u << j)) && options < partner_options) {
+        partner = j;
+        partner_options = options;
+      }
+    }
+
+    HWMultiRectPair pair;
+    pair.layer_index[0] = std::min(candidates[best], candidates[partner]);
+    pair.layer_index[1] = std::max(candidates[best], candidates[partner]);
+    pair.parallel = (parallel[best] & (1u << partner)) != 0;
+    pairs.push_back(pair);
+    unpaired &= ~((1u << best) | (1u << partner));
+  }
+
+  stats_.pairs_planned = UINT32(pairs.size());
+  DLOGV_IF(kTagResources, "%d of %d candidate layers paired", 2 * stats_.pairs_planned, count);
+}
+
+void MultiRectPacker::UpdateStats(const HWLayers &hw_layers) {
+  const HWLayersInfo &hw_layers_info = hw_layers.info;
+  uint32_t rects = 0;
+  stats_.sde_layers = 0;
+  for (uint32_t i = 0; i < UINT32(hw_layers_info.hw_layers.size()); i++) {
+    LayerComposition composition = hw_layers_info.hw_layers.at(i).composition;
+    if (composition == kCompositionSDE || composition == kCompositionCursor) {
+      stats_.sde_layers++;
+    }
+    const HWLayerConfig &layer_config = hw_layers.config[i];
+    for (const HWPipeInfo *pipe_info : {&layer_config.left_pipe, &layer_config.right_pipe}) {
+      if (pipe_info->valid && (pipe_info->flags & kMultiRect)) {
+        rects++;
+      }
+    }
+  }
+
+  stats_.pairs_in_use = rects / 2;
+  stats_.frames++;
+  stats_.total_pairs_in_use += stats_.pairs_in_use;
+  stats_.total_pairs_planned += stats_.pairs_planned;
+}
+
+}  // namespace sdm
@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __MULTIRECT_PACKER_H__
+#define __MULTIRECT_PACKER_H__
+
+#include <core/layer_stack.h>
+#include <private/hw_info_types.h>
+
+#include <vector>
+
+namespace sdm {
+
+struct MultiRectStats {
+  uint32_t sde_layers = 0;     // Layers of the last frame on source pipes.
+  uint32_t pairs_in_use = 0;   // Source pipes of the last frame fetching two layers.
+  uint32_t pairs_planned = 0;  // Pairs the packer found for the last frame.
+  uint32_t max_pairs = 0;      // Source pipes with a second rect.
+  uint64_t frames = 0;
+  uint64_t total_pairs_in_use = 0;
+  uint64_t total_pairs_planned = 0;
+};
+
+// Plans which app layers of a frame can share a source pipe through its two rects, and hands the
+// plan to the strategy in HWLayersInfo::multirect_pairs. The rects fetch in parallel when each is
+// at most half the pipe width, or one after the other when one ends a few lines above the other.
+// Neither rect can scale or rotate, and compressed rects must share a format.
+class MultiRectPacker {
+ public:
+  void Init(const HWResourceInfo &hw_res_info);
+  void Pack(HWLayersInfo *hw_layers_info);
+  void UpdateStats(const HWLayers &hw_layers);
+  const MultiRectStats &GetStats() const { return stats_; }
+
+ private:
+  static const uint32_t kMaxCandidates = 32;
+  static constexpr float kSerialGapLines = 2.0f;  // Line buffer turnaround between serial rects.
+
+  bool IsCandidate(const Layer &layer);
+  bool CanPair(const Layer &layer1, const Layer &layer2, bool *parallel);
+
+  float half_pipe_width_ = 0.0f;
+  MultiRectStats stats_ = {};
+};
+
+}  // namespace sdm
+
+#endif  // __MULTIRECT_PACKER_H__
@@ -0,0 +1,430 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <private/qdcm_calib_blob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdm {
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> XmlAttrs;
+
+// Section offsets of attributes and data are relative to their section until the blob is laid out.
+struct CalibBuilder {
+  QdcmCalibHeader header;
+  std::vector<QdcmCalibMode> modes;
+  std::vector<QdcmCalibFeature> features;
+  std::vector<QdcmCalibLut> luts;
+  std::string attrs;
+  std::vector<uint8_t> data;
+};
+
+uint32_t Align8(size_t value) {
+  return static_cast<uint32_t>((value + 7) & ~static_cast<size_t>(7));
+}
+
+const char *FindAttr(const XmlAttrs &attrs, const char *name) {
+  for (auto &attr : attrs) {
+    if (attr.first == name) {
+      return attr.second.c_str();
+    }
+  }
+
+  return nullptr;
+}
+
+uint32_t GetAttrUint(const XmlAttrs &attrs, const char *name) {
+  const char *value = FindAttr(attrs, name);
+  return value ? static_cast<uint32_t>(strtoul(value, nullptr, 0)) : 0;
+}
+
+// Parses the attributes of the element whose name ends at *pos, up to and including its '>'.
+bool ParseAttrs(const std::string &xml, size_t *pos, XmlAttrs *attrs, bool *empty) {
+  size_t i = *pos;
+  while (i < xml.size()) {
+    while (i < xml.size() && isspace(static_cast<unsigned char>(xml[i]))) {
+      i++;
+    }
+    if (xml.compare(i, 2, "/>") == 0) {
+      *empty = true;
+      *pos = i + 2;
+      return true;
+    }
+    if (i < xml.size() && xml[i] == '>') {
+      *empty = false;
+      *pos = i + 1;
+      return true;
+    }
+
+    size_t eq = xml.find('=', i);
+    if (eq == std::string::npos || eq + 1 >= xml.size() || xml[eq + 1] != '"') {
+      return false;
+    }
+    size_t end = xml.find('"', eq + 2);
+    if (end == std::string::npos) {
+      return false;
+    }
+    size_t name_end = eq;
+    while (name_end > i && isspace(static_cast<unsigned char>(xml[name_end - 1]))) {
+      name_end--;
+    }
+    attrs->emplace_back(xml.substr(i, name_end - i), xml.substr(eq + 2, end - eq - 2));
+    i = end + 1;
+  }
+
+  return false;
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Decodes the hex text content at *pos into the data section and returns its offset there.
+bool DecodeHex(const std::string &xml, size_t *pos, CalibBuilder *builder, uint32_t *offset,
+               uint32_t *size) {
+  size_t end = xml.find('<', *pos);
+  if (end == std::string::npos) {
+    return false;
+  }
+
+  std::vector<uint8_t> &data = builder->data;
+  data.resize(Align8(data.size()));
+  *offset = static_cast<uint32_t>(data.size());
+  int high = -1;
+  for (size_t i = *pos; i < end; i++) {
+    if (isspace(static_cast<unsigned char>(xml[i]))) {
+      continue;
+    }
+    int value = HexValue(xml[i]);
+    if (value < 0) {
+      return false;
+    }
+    if (high < 0) {
+      high = value;
+    } else {
+      data.push_back(static_cast<uint8_t>((high << 4) | value));
+      high = -1;
+    }
+  }
+  *size = static_cast<uint32_t>(data.size() - *offset);
+  *pos = end;
+
+  return (high < 0);
+}
+
+QdcmCalibAttrs AppendAttrs(const XmlAttrs &attrs, CalibBuilder *builder) {
+  QdcmCalibAttrs calib_attrs;
+  calib_attrs.offset = static_cast<uint32_t>(builder->attrs.size());
+  for (auto &attr : attrs) {
+    builder->attrs.append(attr.first).push_back('\0');
+    builder->attrs.append(attr.second).push_back('\0');
+  }
+  calib_attrs.size = static_cast<uint32_t>(builder->attrs.size() - calib_attrs.offset);
+
+  return calib_attrs;
+}
+
+int Parse(const std::string &xml, CalibBuilder *builder) {
+  size_t pos = 0;
+  while ((pos = xml.find('<', pos)) != std::string::npos) {
+    if (xml.compare(pos, 4, "<!--") == 0 || xml.compare(pos, 2, "<?") == 0 ||
+        xml.compare(pos, 2, "</") == 0) {
+      const char *close = (xml[pos + 1] == '!') ? "-->" : ((xml[pos + 1] == '?') ? "?>" : ">");
+      pos = xml.find(close, pos);
+      if (pos == std::string::npos) {
+        return -EINVAL;
+      }
+      continue;
+    }
+
+    size_t name_start = pos + 1;
+    size_t name_end = name_start;
+    while (name_end < xml.size() && (isalnum(static_cast<unsigned char>(xml[name_end])) ||
+                                     xml[name_end] == '_')) {
+      name_end++;
+    }
+    std::string name = xml.substr(name_start, name_end - name_start);
+    XmlAttrs attrs;
+    bool empty = false;
+    pos = name_end;
+    if (!ParseAttrs(xml, &pos, &attrs, &empty)) {
+      return -EINVAL;
+    }
+
+    if (name == "Disp_Modes") {
+      builder->header.modes_attrs = AppendAttrs(attrs, builder);
+    } else if (name == "Mode") {
+      QdcmCalibMode mode;
+      const char *mode_id = FindAttr(attrs, "ModeID");
+      mode.mode_id = mode_id ? atoi(mode_id) : -1;
+      mode.first_feature = static_cast<uint32_t>(builder->features.size());
+      mode.attrs = AppendAttrs(attrs, builder);
+      builder->modes.push_back(mode);
+    } else if (name == "Feature") {
+      if (builder->modes.empty()) {
+        return -EINVAL;
+      }
+      QdcmCalibFeature feature;
+      feature.type = GetAttrUint(attrs, "FeatureType");
+      const char *disable = FindAttr(attrs, "Disable");
+      feature.disabled = (disable && !strcmp(disable, "true"));
+      if (!empty && !DecodeHex(xml, &pos, builder, &feature.data_offset, &feature.data_size)) {
+        return -EINVAL;
+      }
+      if (feature.data_size != GetAttrUint(attrs, "DataSize")) {
+        return -EINVAL;
+      }
+      builder->features.push_back(feature);
+      builder->modes.back().num_features++;
+    } else if (name == "Lut") {
+      QdcmCalibLut lut;
+      lut.type = GetAttrUint(attrs, "Type");
+      lut.num_packets = GetAttrUint(attrs, "NumPackets");
+      if (!empty && !DecodeHex(xml, &pos, builder, &lut.data_offset, &lut.data_size)) {
+        return -EINVAL;
+      }
+      builder->luts.push_back(lut);
+    }
+  }
+
+  return builder->modes.empty() ? -EINVAL : 0;
+}
+
+int ReadFile(const char *path, std::string *contents, struct stat *st) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  int ret = 0;
+  if (fstat(fd, st)) {
+    ret = -errno;
+  } else {
+    contents->resize(static_cast<size_t>(st->st_size));
+    size_t done = 0;
+    while (done < contents->size()) {
+      ssize_t count = read(fd, &(*contents)[done], contents->size() - done);
+      if (count <= 0) {
+        ret = count ? -errno : -EIO;
+        break;
+      }
+      done += static_cast<size_t>(count);
+    }
+  }
+  close(fd);
+
+  return ret;
+}
+
+bool InBounds(size_t size, uint32_t offset, uint64_t length) {
+  return (offset <= size) && (length <= size - offset);
+}
+
+}  // namespace
+
+int QdcmCalibBlob::Compile(const char *xml_path, const char *blob_path) {
+  std::string xml;
+  struct stat st = {};
+  int ret = ReadFile(xml_path, &xml, &st);
+  if (ret) {
+    return ret;
+  }
+
+  CalibBuilder builder;
+  ret = Parse(xml, &builder);
+  if (ret) {
+    return ret;
+  }
+
+  QdcmCalibHeader &header = builder.header;
+  header.source_size = static_cast<uint64_t>(st.st_size);
+  header.source_mtime = static_cast<int64_t>(st.st_mtime);
+  header.num_modes = static_cast<uint32_t>(builder.modes.size());
+  header.num_features = static_cast<uint32_t>(builder.features.size());
+  header.num_luts = static_cast<uint32_t>(builder.luts.size());
+  header.modes_offset = Align8(sizeof(header));
+  header.features_offset = Align8(header.modes_offset + header.num_modes * sizeof(QdcmCalibMode));
+  header.luts_offset =
+      Align8(header.features_offset + header.num_features * sizeof(QdcmCalibFeature));
+  uint32_t attrs_offset = Align8(header.luts_offset + header.num_luts * sizeof(QdcmCalibLut));
+  uint32_t data_offset = Align8(attrs_offset + builder.attrs.size());
+  header.size = Align8(data_offset + builder.data.size());
+
+  header.modes_attrs.offset += attrs_offset;
+  for (auto &mode : builder.modes) {
+    mode.attrs.offset += attrs_offset;
+  }
+  for (auto &feature : builder.features) {
+    feature.data_offset += data_offset;
+  }
+  for (auto &lut : builder.luts) {
+    lut.data_offset += data_offset;
+  }
+
+  std::vector<uint8_t> blob(header.size, 0);
+  memcpy(&blob[0], &header, sizeof(header));
+  if (header.num_modes) {
+    memcpy(&blob[header.modes_offset], builder.modes.data(),
+           header.num_modes * sizeof(QdcmCalibMode));
+  }
+  if (header.num_features) {
+    memcpy(&blob[header.features_offset], builder.features.data(),
+           header.num_features * sizeof(QdcmCalibFeature));
+  }
+  if (header.num_luts) {
+    memcpy(&blob[header.luts_offset], builder.luts.data(),
+           header.num_luts * sizeof(QdcmCalibLut));
+  }
+  if (!builder.attrs.empty()) {
+    memcpy(&blob[attrs_offset], builder.attrs.data(), builder.attrs.size());
+  }
+  if (!builder.data.empty()) {
+    memcpy(&blob[data_offset], builder.data.data(), builder.data.size());
+  }
+
+  // Written aside and renamed into place, so a reader only ever maps a complete blob.
+  std::string tmp_path = std::string(blob_path) + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return -errno;
+  }
+  size_t done = 0;
+  while (done < blob.size()) {
+    ssize_t count = write(fd, &blob[done], blob.size() - done);
+    if (count <= 0) {
+      ret = count ? -errno : -EIO;
+      break;
+    }
+    done += static_cast<size_t>(count);
+  }
+  if (!ret && fsync(fd)) {
+    ret = -errno;
+  }
+  close(fd);
+  if (!ret && rename(tmp_path.c_str(), blob_path)) {
+    ret = -errno;
+  }
+  if (ret) {
+    unlink(tmp_path.c_str());
+  }
+
+  return ret;
+}
+
+int QdcmCalibBlob::Map(const char *blob_path, const char *xml_path) {
+  Unmap();
+
+  int fd = open(blob_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st)) {
+    int ret = -errno;
+    close(fd);
+    return ret;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  if (size < sizeof(QdcmCalibHeader)) {
+    close(fd);
+    return -EINVAL;
+  }
+
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return -errno;
+  }
+
+  const QdcmCalibHeader *header = reinterpret_cast<const QdcmCalibHeader *>(addr);
+  bool valid = (header->magic == kQdcmCalibMagic) && (header->version == kQdcmCalibVersion) &&
+               (header->size == size) &&
+               InBounds(size, header->modes_offset,
+                        uint64_t(header->num_modes) * sizeof(QdcmCalibMode)) &&
+               InBounds(size, header->features_offset,
+                        uint64_t(header->num_features) * sizeof(QdcmCalibFeature)) &&
+               InBounds(size, header->luts_offset,
+                        uint64_t(header->num_luts) * sizeof(QdcmCalibLut));
+
+  // A blob shipped without its XML is taken as is, otherwise it has to match the XML.
+  struct stat xml_st = {};
+  if (valid && xml_path && !stat(xml_path, &xml_st)) {
+    valid = (header->source_size == static_cast<uint64_t>(xml_st.st_size)) &&
+            (header->source_mtime == static_cast<int64_t>(xml_st.st_mtime));
+  }
+
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(addr);
+  const QdcmCalibFeature *features =
+      reinterpret_cast<const QdcmCalibFeature *>(base + header->features_offset);
+  for (uint32_t i = 0; valid && i < header->num_features; i++) {
+    valid = InBounds(size, features[i].data_offset, features[i].data_size);
+  }
+  const QdcmCalibLut *luts = reinterpret_cast<const QdcmCalibLut *>(base + header->luts_offset);
+  for (uint32_t i = 0; valid && i < header->num_luts; i++) {
+    valid = InBounds(size, luts[i].data_offset, luts[i].data_size);
+  }
+
+  if (!valid) {
+    munmap(addr, size);
+    return -EINVAL;
+  }
+
+  addr_ = addr;
+  size_ = size;
+
+  return 0;
+}
+
+void QdcmCalibBlob::Unmap() {
+  if (addr_) {
+    munmap(addr_, size_);
+    addr_ = nullptr;
+    size_ = 0;
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,58 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Compiles a QDCM calibration XML into the blob the color manager maps, for products that ship
+// the blob instead of having it compiled on the first boot.
+//
+// Usage: qdcm_calib_compiler <qdcm_calib_data xml> <blob>
+
+#include <private/qdcm_calib_blob.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <qdcm_calib_data xml> <blob>\n", argv[0]);
+    return 1;
+  }
+
+  int ret = sdm::QdcmCalibBlob::Compile(argv[1], argv[2]);
+  if (ret) {
+    fprintf(stderr, "Unable to compile %s: %s\n", argv[1], strerror(-ret));
+    return 1;
+  }
+
+  sdm::QdcmCalibBlob blob;
+  ret = blob.Map(argv[2], argv[1]);
+  if (ret) {
+    fprintf(stderr, "Unable to map %s: %s\n", argv[2], strerror(-ret));
+    return 1;
+  }
+
+  const sdm::QdcmCalibHeader *header = blob.GetHeader();
+  printf("%s: %u modes, %u features, %u luts, %u bytes\n", argv[2], header->num_modes,
+         header->num_features, header->num_luts, header->size);
+
+  return 0;
+}
@@ -258,7 +258,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
   // left pipe is needed
   if (left_pipe->valid) {
     need_scale = IsScalingNeeded(left_pipe);
-    left_index = GetPipe(hw_block_type, need_scale);
+    left_index = GetPipe(hw_block_type, need_scale, display_resource_ctx->last_left_index);
     if (left_index >= num_pipe_) {
       DLOGV_IF(kTagResources, "Get left pipe failed: hw_block_type = %d, need_scale = %d",
                hw_block_type, need_scale);
@@ -277,13 +277,15 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
     if (left_index < num_pipe_) {
       left_pipe->pipe_id = src_pipes_[left_index].mdss_pipe_id;
     }
+    display_resource_ctx->last_left_index = left_index;
+    display_resource_ctx->last_right_index = UINT32_MAX;
     DLOGV_IF(kTagResources, "1 pipe acquired for FB layer, left_pipe = %x", left_pipe->pipe_id);
     return kErrorNone;
   }
 
   need_scale = IsScalingNeeded(right_pipe);
 
-  right_index = GetPipe(hw_block_type, need_scale);
+  right_index = GetPipe(hw_block_type, need_scale, display_resource_ctx->last_right_index);
   if (right_index >= num_pipe_) {
     DLOGV_IF(kTagResources, "Get right pipe failed: hw_block_type = %d, need_scale = %d",
              hw_block_type, need_scale);
@@ -305,6 +307,8 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
     goto CleanupOnError;
   }
 
+  display_resource_ctx->last_left_index = left_index;
+  display_resource_ctx->last_right_index = right_index;
   DLOGV_IF(kTagResources, "2 pipes acquired for FB layer, left_pipe = %x, right_pipe = %x",
            left_pipe->pipe_id,  right_pipe->pipe_id);
 
@@ -425,6 +429,24 @@ uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_type, bool need_scale) {
   return index;
 }
 
+uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_type, bool need_scale,
+                                  uint32_t preferred_index) {
+  // Keep the FB layer on the pipe it had in the last frame, so that the driver does not have to
+  // move the plane and reprogram its scaler and color state when pipes are otherwise free.
+  if (preferred_index < num_pipe_) {
+    SourcePipe *src_pipe = &src_pipes_[preferred_index];
+    bool can_scale = (src_pipe->type == kPipeTypeVIG) ||
+                     ((src_pipe->type == kPipeTypeRGB) && !hw_res_info_.has_non_scalar_rgb);
+    if (src_pipe->owner == kPipeOwnerUserMode && src_pipe->hw_block_type == kHWBlockMax &&
+        (!need_scale || can_scale)) {
+      src_pipe->hw_block_type = hw_block_type;
+      return preferred_index;
+    }
+  }
+
+  return GetPipe(hw_block_type, need_scale);
+}
+
 bool ResourceDefault::IsScalingNeeded(const HWPipeInfo *pipe_info) {
   const LayerRect &src_roi = pipe_info->src_roi;
   const LayerRect &dst_roi = pipe_info->dst_roi;
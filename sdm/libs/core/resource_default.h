@@ -106,8 +106,13 @@ class ResourceDefault : public ResourceInterface {
     HWBlockType hw_block_type;
     uint64_t frame_count;
     HWMixerAttributes mixer_attributes;
+    // Pipes that held the left and right half of the FB layer in the last frame
+    uint32_t last_left_index;
+    uint32_t last_right_index;
 
-    DisplayResourceContext() : hw_block_type(kHWBlockMax), frame_count(0) {}
+    DisplayResourceContext()
+      : hw_block_type(kHWBlockMax), frame_count(0), last_left_index(UINT32_MAX),
+        last_right_index(UINT32_MAX) {}
   };
 
   struct HWBlockContext {
@@ -121,6 +126,7 @@ class ResourceDefault : public ResourceInterface {
   uint32_t NextPipe(PipeType pipe_type, HWBlockType hw_block_type);
   uint32_t SearchPipe(HWBlockType hw_block_type, SourcePipe *src_pipes, uint32_t num_pipe);
   uint32_t GetPipe(HWBlockType hw_block_type, bool need_scale);
+  uint32_t GetPipe(HWBlockType hw_block_type, bool need_scale, uint32_t preferred_index);
   bool IsScalingNeeded(const HWPipeInfo *pipe_info);
   DisplayError Config(DisplayResourceContext *display_resource_ctx, HWLayers *hw_layers);
   DisplayError DisplaySplitConfig(DisplayResourceContext *display_resource_ctx,
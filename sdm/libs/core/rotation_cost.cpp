@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/formats.h>
+
+#include <algorithm>
+
+#include "rotation_cost.h"
+
+namespace sdm {
+
+bool RotationCostModel::IsInlineSupported(const Layer &layer, float downscale) {
+  const InlineRotationInfo &info = hw_res_info_.inline_rot_info;
+  if (info.inrot_version == kInlineRotationNone || downscale > info.max_downscale_rt) {
+    return false;
+  }
+
+  // The rotated pipe fetches source columns as lines, a split layer uses two pipes.
+  uint32_t src_height = UINT32(layer.src_rect.bottom - layer.src_rect.top);
+  if (src_height > 2 * hw_res_info_.max_rotation_pipe_width) {
+    return false;
+  }
+
+  const std::vector<LayerBufferFormat> &formats = info.inrot_fmts_supported;
+  return std::find(formats.begin(), formats.end(), layer.input_buffer.format) != formats.end();
+}
+
+float RotationCostModel::GetScore(const RotationCost &cost) {
+  // max_bandwidth_high is in KBps and max_sde_clk in Hz.
+  float max_bandwidth_mbps = FLOAT(hw_res_info_.max_bandwidth_high) / 1000.0f;
+  float max_clock_mhz = FLOAT(hw_res_info_.max_sde_clk) / 1000000.0f;
+
+  float score = FLOAT(cost.passes) * kPassWeight;
+  if (max_bandwidth_mbps > 0.0f) {
+    score += cost.bandwidth_mbps / max_bandwidth_mbps;
+  }
+  if (max_clock_mhz > 0.0f) {
+    score += cost.clock_mhz / max_clock_mhz;
+  }
+
+  return score;
+}
+
+void RotationCostModel::Evaluate(const Layer &layer, uint32_t fps,
+                                 RotationCost cost[kRotationPathMax]) {
+  const LayerBuffer &buffer = layer.input_buffer;
+  float src_pixels = (layer.src_rect.right - layer.src_rect.left) *
+                     (layer.src_rect.bottom - layer.src_rect.top);
+  float dst_pixels = (layer.dst_rect.right - layer.dst_rect.left) *
+                     (layer.dst_rect.bottom - layer.dst_rect.top);
+  float frame_rate = FLOAT(std::max(fps, UINT32(1)));
+  float content_rate = layer.frame_rate ? std::min(FLOAT(layer.frame_rate), frame_rate) :
+                                          frame_rate;
+  float ratio = IsUBWCFormat(buffer.format) ? kUbwcRatio : 1.0f;
+  float target_ratio = hw_res_info_.has_ubwc ? kUbwcRatio : 1.0f;
+  float downscale = (dst_pixels > 0.0f) ? (src_pixels / dst_pixels) : 1.0f;
+
+  // Traffic of one read of the source, and of a write or read of a 32bpp client target area.
+  float src_mbps = src_pixels * GetBufferFormatBpp(buffer.format) * ratio * frame_rate / 1e6f;
+  float target_mbps = dst_pixels * 4.0f * target_ratio * frame_rate / 1e6f;
+  float content_share = content_rate / frame_rate;
+  // SDE clock follows the larger of the fetched and the blended pixels.
+  float clock_mhz = std::max(src_pixels, dst_pixels) * frame_rate *
+                    hw_res_info_.clk_fudge_factor / 1e6f;
+
+  RotationCost &inline_cost = cost[kRotationPathInline];
+  inline_cost = RotationCost();
+  inline_cost.feasible = IsInlineSupported(layer, downscale);
+  inline_cost.bandwidth_mbps = src_mbps;
+  inline_cost.clock_mhz = clock_mhz;
+
+  // The rotator reads the source and writes it out rotated, then the pipe fetches that copy.
+  RotationCost &offline_cost = cost[kRotationPathOffline];
+  offline_cost = RotationCost();
+  uint32_t src_width = UINT32(layer.src_rect.right - layer.src_rect.left);
+  const HWRotatorInfo &rot_info = hw_res_info_.hw_rot_info;
+  offline_cost.feasible = rot_info.num_rotator &&
+                          (!rot_info.max_line_width || src_width <= rot_info.max_line_width);
+  offline_cost.bandwidth_mbps = (1.0f + 2.0f * content_share) * src_mbps;
+  offline_cost.clock_mhz = clock_mhz;
+  offline_cost.passes = 1;
+
+  // GPU reads the source and writes the target, which the pipe of the client target fetches.
+  RotationCost &gpu_cost = cost[kRotationPathGPU];
+  gpu_cost = RotationCost();
+  gpu_cost.feasible = true;
+  gpu_cost.bandwidth_mbps = content_share * (src_mbps + target_mbps) + target_mbps;
+  gpu_cost.clock_mhz = dst_pixels * frame_rate * hw_res_info_.clk_fudge_factor / 1e6f;
+  gpu_cost.passes = 1;
+
+  for (uint32_t i = 0; i < kRotationPathMax; i++) {
+    cost[i].score = GetScore(cost[i]);
+  }
+}
+
+RotationPath RotationCostModel::GetBestPath(const RotationCost cost[kRotationPathMax]) {
+  RotationPath best = kRotationPathGPU;
+  for (uint32_t i = 0; i < kRotationPathMax; i++) {
+    if (cost[i].feasible && cost[i].score < cost[best].score) {
+      best = RotationPath(i);
+    }
+  }
+
+  return best;
+}
+
+const char *RotationCostModel::GetPathName(RotationPath path) {
+  switch (path) {
+  case kRotationPathInline:   return "inline";
+  case kRotationPathOffline:  return "offline";
+  case kRotationPathGPU:      return "gpu";
+  default:                    return "unknown";
+  }
+}
+
+}  // namespace sdm
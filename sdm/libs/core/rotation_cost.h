@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ROTATION_COST_H__
+#define __ROTATION_COST_H__
+
+#include <core/layer_stack.h>
+#include <private/hw_info_types.h>
+
+namespace sdm {
+
+enum RotationPath {
+  kRotationPathInline,   // Rotated by the SSPP while fetching.
+  kRotationPathOffline,  // Rotated by the rotator into an intermediate buffer.
+  kRotationPathGPU,      // Rotated while composing the client target.
+  kRotationPathMax,
+};
+
+struct RotationCost {
+  bool feasible = false;
+  float bandwidth_mbps = 0.0f;  // Memory traffic the path adds per second.
+  float clock_mhz = 0.0f;       // SDE clock the layer needs on that path.
+  uint32_t passes = 0;          // Extra passes over the layer before it reaches the mixer.
+  float score = 0.0f;           // Weighted sum of the above, lower is better.
+};
+
+// Estimates the cost of the ways a 90 degree rotated layer can be shown, from its source and
+// destination sizes, format, frame rate and the display refresh rate. Pipes fetch at the display
+// rate, while the rotator and GPU only work on new frames of the layer. Bandwidth and clock are
+// normalized to the limits of the target, and each extra pass counts as a quarter of either.
+class RotationCostModel {
+ public:
+  void Init(const HWResourceInfo &hw_res_info) { hw_res_info_ = hw_res_info; }
+  void Evaluate(const Layer &layer, uint32_t fps, RotationCost cost[kRotationPathMax]);
+  static RotationPath GetBestPath(const RotationCost cost[kRotationPathMax]);
+  static const char *GetPathName(RotationPath path);
+
+ private:
+  static constexpr float kUbwcRatio = 0.5f;    // Assumed compression of UBWC buffers.
+  static constexpr float kPassWeight = 0.25f;
+
+  bool IsInlineSupported(const Layer &layer, float downscale);
+  float GetScore(const RotationCost &cost);
+
+  HWResourceInfo hw_res_info_ = {};
+};
+
+}  // namespace sdm
+
+#endif  // __ROTATION_COST_H__
@@ -24,6 +24,8 @@
 
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "strategy.h"
@@ -52,6 +54,11 @@ Strategy::Strategy(ExtensionInterface *extension_intf,
 DisplayError Strategy::Init() {
   DisplayError error = kErrorNone;
 
+  int value = 0;
+  if (Debug::GetProperty(ENABLE_GPU_TARGET_CROP_PROP, &value) == kErrorNone) {
+    enable_gpu_target_crop_ = (value == 1);
+  }
+
   if (extension_intf_) {
     error = extension_intf_->CreateStrategyExtn(display_id_, display_type_, buffer_allocator_,
                                                 hw_resource_info_, hw_panel_info_,
@@ -61,9 +68,8 @@ DisplayError Strategy::Init() {
       return error;
     }
 
-    error = extension_intf_->CreatePartialUpdate(
-        display_id_, display_type_, hw_resource_info_, hw_panel_info_, mixer_attributes_,
-        display_attributes_, fb_config_, &partial_update_intf_);
+    partial_update_intf_ = GetPartialUpdate(hw_panel_info_, display_attributes_,
+                                            mixer_attributes_, fb_config_);
   }
 
   return kErrorNone;
@@ -71,9 +77,13 @@ DisplayError Strategy::Init() {
 
 DisplayError Strategy::Deinit() {
   if (strategy_intf_) {
-    if (partial_update_intf_) {
-      extension_intf_->DestroyPartialUpdate(partial_update_intf_);
+    for (auto &context : config_contexts_) {
+      if (context.partial_update_intf) {
+        extension_intf_->DestroyPartialUpdate(context.partial_update_intf);
+      }
     }
+    config_contexts_.clear();
+    partial_update_intf_ = NULL;
 
     extension_intf_->DestroyStrategyExtn(strategy_intf_);
   }
@@ -124,7 +134,12 @@ DisplayError Strategy::Stop() {
 
 DisplayError Strategy::GetNextStrategy(StrategyConstraints *constraints) {
   if (extn_start_success_) {
-    return strategy_intf_->GetNextStrategy(constraints);
+    DisplayError error = strategy_intf_->GetNextStrategy(constraints);
+    if (error == kErrorNone) {
+      DropOccludedLayers();
+      CropGPUTarget();
+    }
+    return error;
   }
 
   // Do not fallback to GPU if GPU comp is disabled.
@@ -139,6 +154,7 @@ DisplayError Strategy::GetNextStrategy(StrategyConstraints *constraints) {
     layer_stack->layers.at(i)->composition = kCompositionGPU;
     layer_stack->layers.at(i)->request.flags.request_flags = 0;  // Reset layer request
   }
+  DropOccludedLayers();
 
   // When mixer resolution and panel resolutions are same (1600x2560) and FB resolution is
   // 1080x1920 FB_Target destination coordinates(mapped to FB resolution 1080x1920) need to
@@ -161,10 +177,98 @@ DisplayError Strategy::GetNextStrategy(StrategyConstraints *constraints) {
   // Scale to mixer resolution.
   MapRect(src_domain, dst_domain, layer.dst_rect, &layer.dst_rect);
   hw_layers_info_->hw_layers.push_back(layer);
+  CropGPUTarget();
 
   return kErrorNone;
 }
 
+// Layers hidden behind opaque layers need not be rendered by the GPU either. Those the strategy
+// placed on pipes are left as they are, and so is a GPU target that would be left empty.
+void Strategy::DropOccludedLayers() {
+  const std::vector<uint32_t> &occluded_index = hw_layers_info_->occluded_index;
+  if (occluded_index.empty()) {
+    return;
+  }
+
+  LayerStack *layer_stack = hw_layers_info_->stack;
+  bool gpu_layer_visible = false;
+  for (uint32_t i = 0; i < hw_layers_info_->app_layer_count && !gpu_layer_visible; i++) {
+    gpu_layer_visible = (layer_stack->layers.at(i)->composition == kCompositionGPU) &&
+        (std::find(occluded_index.begin(), occluded_index.end(), i) == occluded_index.end());
+  }
+  if (!gpu_layer_visible) {
+    return;
+  }
+
+  for (uint32_t index : occluded_index) {
+    Layer *layer = layer_stack->layers.at(index);
+    if (layer->composition == kCompositionGPU) {
+      layer->composition = kCompositionNone;
+    }
+  }
+}
+
+// SurfaceFlinger renders a full size client target even when only a few layers, such as a
+// notification, go to GPU. Fetch and blend only the part of it those layers cover, so that
+// bandwidth scales with the GPU composed area. The rest of the target holds nothing to blend.
+void Strategy::CropGPUTarget() {
+  if (!enable_gpu_target_crop_) {
+    return;
+  }
+
+  LayerStack *layer_stack = hw_layers_info_->stack;
+  uint32_t gpu_target_index = hw_layers_info_->gpu_target_index;
+  LayerRect gpu_rect;
+  for (uint32_t i = 0; i < hw_layers_info_->app_layer_count; i++) {
+    Layer *layer = layer_stack->layers.at(i);
+    if (layer->composition == kCompositionGPU) {
+      gpu_rect = Union(gpu_rect, layer->dst_rect);
+    }
+  }
+  if (!IsValid(gpu_rect)) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < hw_layers_info_->index.size(); i++) {
+    if (hw_layers_info_->index.at(i) != gpu_target_index) {
+      continue;
+    }
+
+    Layer &hw_layer = hw_layers_info_->hw_layers.at(i);
+    Layer *gpu_target = layer_stack->layers.at(gpu_target_index);
+    // Keep to the plain case: client target buffer and frame in the same space, no flips.
+    if (hw_layer.transform.flip_horizontal || hw_layer.transform.flip_vertical ||
+        hw_layer.transform.rotation != 0.0f || hw_layer.blending == kBlendingOpaque ||
+        !IsCongruent(gpu_target->src_rect, gpu_target->dst_rect) ||
+        !IsCongruent(hw_layer.src_rect, gpu_target->src_rect)) {
+      return;
+    }
+
+    // Grow to even pixels for chroma and UBWC friendly fetches.
+    LayerRect crop = gpu_rect;
+    crop.left = FLOAT(INT(std::floor(crop.left)) & ~1);
+    crop.top = FLOAT(INT(std::floor(crop.top)) & ~1);
+    crop.right = FLOAT((INT(std::ceil(crop.right)) + 1) & ~1);
+    crop.bottom = FLOAT((INT(std::ceil(crop.bottom)) + 1) & ~1);
+    crop = Intersection(crop, hw_layer.src_rect);
+
+    const LayerRect &src = hw_layer.src_rect;
+    float full_area = (src.right - src.left) * (src.bottom - src.top);
+    float crop_area = (crop.right - crop.left) * (crop.bottom - crop.top);
+    if (!IsValid(crop) || (crop_area * 4.0f > full_area * 3.0f)) {
+      return;
+    }
+
+    LayerRect dst;
+    MapRect(hw_layer.src_rect, hw_layer.dst_rect, crop, &dst);
+    DLOGV_IF(kTagCompManager, "GPU target cropped to %.0f %.0f %.0f %.0f", crop.left, crop.top,
+             crop.right, crop.bottom);
+    hw_layer.src_rect = crop;
+    hw_layer.dst_rect = dst;
+    return;
+  }
+}
+
 void Strategy::GenerateROI() {
   bool split_display = false;
 
@@ -207,19 +311,18 @@ DisplayError Strategy::Reconfigure(const HWPanelInfo &hw_panel_info,
 
   // TODO(user): PU Intf will not be created for video mode panels, hence re-evaluate if
   // reconfigure is needed.
-  if (partial_update_intf_) {
-    extension_intf_->DestroyPartialUpdate(partial_update_intf_);
-    partial_update_intf_ = NULL;
-  }
-
-  extension_intf_->CreatePartialUpdate(display_id_, display_type_, hw_resource_info_, hw_panel_info,
-                                       mixer_attributes, display_attributes, fb_config,
-                                       &partial_update_intf_);
-
-  error = strategy_intf_->Reconfigure(hw_panel_info, hw_resource_info_, mixer_attributes,
-                                      fb_config);
-  if (error != kErrorNone) {
-    return error;
+  partial_update_intf_ = GetPartialUpdate(hw_panel_info, display_attributes, mixer_attributes,
+                                          fb_config);
+
+  // The strategy does not depend on the display attributes, so a switch that only changes those,
+  // such as a refresh rate change at the same resolution, leaves it as it is.
+  if (hw_panel_info_ != hw_panel_info || mixer_attributes_ != mixer_attributes ||
+      !(fb_config_ == fb_config)) {
+    error = strategy_intf_->Reconfigure(hw_panel_info, hw_resource_info_, mixer_attributes,
+                                        fb_config);
+    if (error != kErrorNone) {
+      return error;
+    }
   }
 
   hw_panel_info_ = hw_panel_info;
@@ -230,6 +333,43 @@ DisplayError Strategy::Reconfigure(const HWPanelInfo &hw_panel_info,
   return kErrorNone;
 }
 
+PartialUpdateInterface *Strategy::GetPartialUpdate(const HWPanelInfo &hw_panel_info,
+                                                   const HWDisplayAttributes &display_attributes,
+                                                   const HWMixerAttributes &mixer_attributes,
+                                                   const DisplayConfigVariableInfo &fb_config) {
+  for (auto it = config_contexts_.begin(); it != config_contexts_.end(); it++) {
+    if (it->hw_panel_info == hw_panel_info && it->display_attributes == display_attributes &&
+        it->mixer_attributes == mixer_attributes && it->fb_config == fb_config) {
+      ConfigContext context = *it;
+      config_contexts_.erase(it);
+      config_contexts_.push_back(context);
+      DLOGI("Reusing partial update context of %dx%d@%d for display %d", fb_config.x_pixels,
+            fb_config.y_pixels, display_attributes.fps, display_id_);
+      return context.partial_update_intf;
+    }
+  }
+
+  ConfigContext context;
+  context.hw_panel_info = hw_panel_info;
+  context.display_attributes = display_attributes;
+  context.mixer_attributes = mixer_attributes;
+  context.fb_config = fb_config;
+  extension_intf_->CreatePartialUpdate(display_id_, display_type_, hw_resource_info_,
+                                       hw_panel_info, mixer_attributes, display_attributes,
+                                       fb_config, &context.partial_update_intf);
+
+  // The least recently used context is never the active one once there is more than one.
+  if (config_contexts_.size() == kMaxConfigContexts) {
+    if (config_contexts_.front().partial_update_intf) {
+      extension_intf_->DestroyPartialUpdate(config_contexts_.front().partial_update_intf);
+    }
+    config_contexts_.erase(config_contexts_.begin());
+  }
+  config_contexts_.push_back(context);
+
+  return context.partial_update_intf;
+}
+
 DisplayError Strategy::SetCompositionState(LayerComposition composition_type, bool enable) {
   DLOGI("composition type = %d, enable = %d", composition_type, enable);
 
@@ -60,11 +60,29 @@ class Strategy {
   DisplayError SwapBuffers();
 
  private:
+  // Partial update state built for one display config. Kept so that switching back to a config,
+  // e.g. between the refresh rates of a panel, is a lookup instead of a rebuild.
+  struct ConfigContext {
+    HWPanelInfo hw_panel_info;
+    HWDisplayAttributes display_attributes;
+    HWMixerAttributes mixer_attributes;
+    DisplayConfigVariableInfo fb_config;
+    PartialUpdateInterface *partial_update_intf = NULL;
+  };
+  static const uint32_t kMaxConfigContexts = 8;
+
+  PartialUpdateInterface *GetPartialUpdate(const HWPanelInfo &hw_panel_info,
+                                           const HWDisplayAttributes &display_attributes,
+                                           const HWMixerAttributes &mixer_attributes,
+                                           const DisplayConfigVariableInfo &fb_config);
   void GenerateROI();
+  void DropOccludedLayers();
+  void CropGPUTarget();
 
   ExtensionInterface *extension_intf_ = NULL;
   StrategyInterface *strategy_intf_ = NULL;
   PartialUpdateInterface *partial_update_intf_ = NULL;
+  std::vector<ConfigContext> config_contexts_;  // Least recently used first.
   int32_t display_id_;
   DisplayType display_type_;
   HWResourceInfo hw_resource_info_;
@@ -75,6 +93,7 @@ class Strategy {
   DisplayConfigVariableInfo fb_config_ = {};
   bool extn_start_success_ = false;
   bool disable_gpu_comp_ = false;
+  bool enable_gpu_target_crop_ = false;
   BufferAllocator *buffer_allocator_ = NULL;
 };
 
@@ -14,6 +14,10 @@ LOCAL_SRC_FILES               := debug.cpp \
                                  sys.cpp \
                                  fence.cpp \
                                  formats.cpp \
+                                 frame_timing.cpp \
+                                 vsync_model.cpp \
+                                 thread_policy.cpp \
+                                 layer_stack_recorder.cpp \
                                  utils.cpp
 
 LOCAL_SHARED_LIBRARIES        := libdisplaydebug
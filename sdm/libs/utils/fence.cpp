@@ -27,9 +27,14 @@
 * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <utils/constants.h>
 #include <utils/fence.h>
 #include <debug_handler.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -42,6 +47,116 @@ namespace sdm {
 
 BufferSyncHandler* Fence::g_buffer_sync_handler_ = nullptr;
 std::vector<std::weak_ptr<Fence>> Fence::wps_;
+Locker Fence::wait_stats_locker_;
+std::map<string, Fence::WaitStats> Fence::wait_stats_;
+constexpr uint32_t Fence::kWaitBucketBoundsMs[];
+
+// Allocated through allocate_shared, which needs a public constructor.
+struct Fence::PooledFence : public Fence {
+  PooledFence(int fd, const string &name) : Fence(fd, name) { }
+};
+
+namespace {
+
+// Free list of the blocks allocate_shared places a fence and its shared_ptr control block in.
+// Fences are created and dropped every frame, so after warm up they no longer reach the heap.
+class FenceBlockPool {
+ public:
+  static FenceBlockPool *Get() {
+    // Never destroyed, fences may still be released during exit.
+    static FenceBlockPool *pool = new FenceBlockPool();
+    return pool;
+  }
+
+  void *Allocate(size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!block_size_) {
+        block_size_ = size;
+      }
+      if (size == block_size_) {
+        live_++;
+        peak_live_ = std::max(peak_live_, live_);
+        if (free_list_) {
+          FreeBlock *block = free_list_;
+          free_list_ = block->next;
+          num_free_--;
+          reused_++;
+          return block;
+        }
+        allocated_++;
+      }
+    }
+
+    return malloc(std::max(size, sizeof(FreeBlock)));
+  }
+
+  void Free(void *ptr, size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (size == block_size_) {
+        live_--;
+        if (num_free_ < kMaxFreeBlocks) {
+          FreeBlock *block = static_cast<FreeBlock *>(ptr);
+          block->next = free_list_;
+          free_list_ = block;
+          num_free_++;
+          return;
+        }
+      }
+    }
+
+    free(ptr);
+  }
+
+  void Dump(std::ostringstream *os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    *os << "\nFence pool: live: " << live_ << ", peak: " << peak_live_ << ", free: " << num_free_;
+    *os << ", block size: " << block_size_ << ", heap allocations: " << allocated_;
+    *os << ", reused: " << reused_;
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  static const uint32_t kMaxFreeBlocks = 256;
+
+  std::mutex mutex_;
+  FreeBlock *free_list_ = nullptr;
+  size_t block_size_ = 0;
+  uint32_t num_free_ = 0;
+  uint64_t live_ = 0;
+  uint64_t peak_live_ = 0;
+  uint64_t allocated_ = 0;
+  uint64_t reused_ = 0;
+};
+
+template <class T>
+struct FencePoolAllocator {
+  typedef T value_type;
+
+  FencePoolAllocator() = default;
+  template <class U>
+  FencePoolAllocator(const FencePoolAllocator<U> &) { }  // NOLINT
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(FenceBlockPool::Get()->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *ptr, size_t n) {
+    FenceBlockPool::Get()->Free(ptr, n * sizeof(T));
+  }
+};
+
+template <class T, class U>
+bool operator==(const FencePoolAllocator<T> &, const FencePoolAllocator<U> &) { return true; }
+
+template <class T, class U>
+bool operator!=(const FencePoolAllocator<T> &, const FencePoolAllocator<U> &) { return false; }
+
+}  // namespace
 
 Fence::Fence(int fd, const string &name) : fd_(fd), name_(name) {
 }
@@ -67,7 +182,8 @@ shared_ptr<Fence> Fence::Create(int fd, const string &name) {
     return nullptr;
   }
 
-  shared_ptr<Fence> fence(new Fence(fd, name));
+  shared_ptr<Fence> fence = std::allocate_shared<PooledFence>(FencePoolAllocator<PooledFence>(),
+                                                             fd, name);
   if (!fence) {
     close(fd);
   }
@@ -88,9 +204,17 @@ int Fence::Get(const shared_ptr<Fence> &fence) {
 shared_ptr<Fence> Fence::Merge(const shared_ptr<Fence> &fence1, const shared_ptr<Fence> &fence2) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
+  // Fence objects are immutable, so a merge with nothing new to wait on can share the source.
+  if (!fence1 || fence1 == fence2) {
+    return fence2;
+  }
+  if (!fence2) {
+    return fence1;
+  }
+
   // Sync merge will return a new unique fd if source fds are same.
-  int fd1 = fence1 ? fence1->fd_ : -1;
-  int fd2 = fence2 ? fence2->fd_ : -1;
+  int fd1 = fence1->fd_;
+  int fd2 = fence2->fd_;
   int merged = -1;
   std::string name = "merged[" + to_string(fd1) + ", " + to_string(fd2) + "]";
 
@@ -102,8 +226,19 @@ shared_ptr<Fence> Fence::Merge(const shared_ptr<Fence> &fence1, const shared_ptr
 shared_ptr<Fence> Fence::Merge(const std::vector<shared_ptr<Fence>> &fences, bool ignore_signaled) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
+  // Layers composed in one commit share the same release fence object. Collapse duplicates
+  // before touching the driver so that each distinct fence costs at most one status check and
+  // one sync merge.
+  std::vector<Fence *> unique_fences;
+  unique_fences.reserve(fences.size());
   shared_ptr<Fence> merged_fence = nullptr;
   for (auto &fence : fences) {
+    if (!fence || std::find(unique_fences.begin(), unique_fences.end(), fence.get()) !=
+                  unique_fences.end()) {
+      continue;
+    }
+    unique_fences.push_back(fence.get());
+
     if (ignore_signaled && (Fence::Wait(fence, 0) == kErrorNone)) {
       continue;
     }
@@ -115,27 +250,61 @@ shared_ptr<Fence> Fence::Merge(const std::vector<shared_ptr<Fence>> &fences, boo
 }
 
 DisplayError Fence::Wait(const shared_ptr<Fence> &fence) {
-  ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
-
-  return g_buffer_sync_handler_->SyncWait(Fence::Get(fence), 1000);
+  return Fence::Wait(fence, 1000);
 }
 
 DisplayError Fence::Wait(const shared_ptr<Fence> &fence, int timeout) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
-  return g_buffer_sync_handler_->SyncWait(Fence::Get(fence), timeout);
+  if (!fence || fence->signaled_) {
+    return kErrorNone;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  DisplayError error = g_buffer_sync_handler_->SyncWait(fence->fd_, timeout);
+  if (error == kErrorNone) {
+    fence->signaled_ = true;
+  }
+
+  // Only blocking waits are of interest, status polls would flood the histograms with zeros.
+  if (timeout != 0) {
+    auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start).count();
+    RecordWait(fence->name_, UINT64(wait_us));
+  }
+
+  return error;
 }
 
 Fence::Status Fence::GetStatus(const shared_ptr<Fence> &fence) {
+  // Treat only timeout error as pending, assume other errors as signaled.
+  return (Fence::Wait(fence, 0) == kErrorTimeOut ? Fence::Status::kPending :
+                                                   Fence::Status::kSignaled);
+}
+
+void Fence::SetDeadline(const shared_ptr<Fence> &fence, uint64_t deadline_ns) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
-  if (!fence) {
-    return Fence::Status::kSignaled;
+  if (!fence || fence->signaled_) {
+    return;
   }
 
-  // Treat only timeout error as pending, assume other errors as signaled.
-  return (g_buffer_sync_handler_->SyncWait(Fence::Get(fence), 0) == kErrorTimeOut ?
-                                    Fence::Status::kPending : Fence::Status::kSignaled);
+  g_buffer_sync_handler_->SyncSetDeadline(fence->fd_, deadline_ns);
+}
+
+void Fence::RecordWait(const string &name, uint64_t wait_us) {
+  uint32_t bucket = 0;
+  while (bucket < kNumWaitBuckets - 1 && wait_us >= kWaitBucketBoundsMs[bucket] * 1000ULL) {
+    bucket++;
+  }
+
+  SCOPE_LOCK(wait_stats_locker_);
+  // Merged fences carry source fds in their names, drop them to keep one entry per kind.
+  WaitStats &stats = wait_stats_[name.substr(0, name.find('['))];
+  stats.count++;
+  stats.total_us += wait_us;
+  stats.max_us = std::max(stats.max_us, wait_us);
+  stats.buckets[bucket]++;
 }
 
 string Fence::GetStr(const shared_ptr<Fence> &fence) {
@@ -160,22 +329,39 @@ void Fence::Dump(std::ostringstream *os) {
     g_buffer_sync_handler_->GetSyncInfo(fence->fd_, os);
   }
   */
+  FenceBlockPool::Get()->Dump(os);
   *os << "\n---------------------------------------\n";
-}
 
-Fence::ScopedRef::~ScopedRef() {
-  for (int dup_fd : dup_fds_) {
-    close(dup_fd);
+  *os << "\n------------Fence Wait Histograms------";
+  SCOPE_LOCK(wait_stats_locker_);
+  for (auto &it : wait_stats_) {
+    const WaitStats &stats = it.second;
+    *os << "\n" << it.first << ": waits: " << stats.count;
+    *os << ", avg: " << (stats.total_us / stats.count) << " us, max: " << stats.max_us << " us";
+    for (uint32_t i = 0; i < kNumWaitBuckets; i++) {
+      if (i < kNumWaitBuckets - 1) {
+        *os << ", <" << kWaitBucketBoundsMs[i] << "ms: ";
+      } else {
+        *os << ", >=" << kWaitBucketBoundsMs[i - 1] << "ms: ";
+      }
+      *os << stats.buckets[i];
+    }
   }
+  *os << "\n---------------------------------------\n";
 }
 
 int Fence::ScopedRef::Get(const shared_ptr<Fence> &fence) {
-  int dup_fd = Fence::Dup(fence);
-  if (dup_fd >= 0) {
-    dup_fds_.push_back(dup_fd);
+  if (!fence) {
+    return -1;
+  }
+
+  if (num_refs_ < kInlineRefs) {
+    refs_[num_refs_++] = fence;
+  } else {
+    overflow_refs_.push_back(fence);
   }
 
-  return dup_fd;
+  return fence->fd_;
 }
 
 }  // namespace sdm
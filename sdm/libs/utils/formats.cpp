@@ -33,167 +33,130 @@
 
 namespace sdm {
 
-bool IsUBWCFormat(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatRGBA8888Ubwc:
-  case kFormatRGBX8888Ubwc:
-  case kFormatBGR565Ubwc:
-  case kFormatYCbCr420SPVenusUbwc:
-  case kFormatRGBA1010102Ubwc:
-  case kFormatRGBX1010102Ubwc:
-  case kFormatYCbCr420TP10Ubwc:
-  case kFormatYCbCr420P010Ubwc:
-    return true;
-  default:
-    return false;
+namespace {
+
+enum FormatFlags : uint8_t {
+  kFlagUbwc = 1 << 0,
+  kFlag10Bit = 1 << 1,
+  kFlagAlpha = 1 << 2,
+};
+
+struct FormatInfo {
+  const char *name = "UNKNOWN";
+  float bpp = 0.0f;
+  uint8_t flags = 0;
+  BufferLayout layout = kLinear;
+};
+
+struct FormatEntry {
+  LayerBufferFormat format;
+  FormatInfo info;
+};
+
+constexpr FormatEntry kFormats[] = {
+  {kFormatARGB8888, {"ARGB_8888", 4.0f, kFlagAlpha, kLinear}},
+  {kFormatRGBA8888, {"RGBA_8888", 4.0f, kFlagAlpha, kLinear}},
+  {kFormatBGRA8888, {"BGRA_8888", 4.0f, kFlagAlpha, kLinear}},
+  {kFormatXRGB8888, {"XRGB_8888", 4.0f, 0, kLinear}},
+  {kFormatRGBX8888, {"RGBX_8888", 4.0f, 0, kLinear}},
+  {kFormatBGRX8888, {"BGRX_8888", 4.0f, 0, kLinear}},
+  {kFormatRGBA5551, {"RGBA_5551", 2.0f, kFlagAlpha, kLinear}},
+  {kFormatRGBA4444, {"RGBA_4444", 2.0f, kFlagAlpha, kLinear}},
+  {kFormatRGB888, {"RGB_888", 3.0f, 0, kLinear}},
+  {kFormatBGR888, {"BGR_888", 3.0f, 0, kLinear}},
+  {kFormatRGB565, {"RGB_565", 2.0f, 0, kLinear}},
+  {kFormatBGR565, {"BGR_565", 2.0f, 0, kLinear}},
+  {kFormatRGBA8888Ubwc, {"RGBA_8888_UBWC", 4.0f, kFlagUbwc | kFlagAlpha, kUBWC}},
+  {kFormatRGBX8888Ubwc, {"RGBX_8888_UBWC", 4.0f, kFlagUbwc, kUBWC}},
+  {kFormatBGR565Ubwc, {"BGR_565_UBWC", 2.0f, kFlagUbwc, kUBWC}},
+  {kFormatRGBA1010102, {"RGBA_1010102", 4.0f, kFlag10Bit | kFlagAlpha, kLinear}},
+  {kFormatARGB2101010, {"ARGB_2101010", 4.0f, kFlag10Bit | kFlagAlpha, kLinear}},
+  {kFormatRGBX1010102, {"RGBX_1010102", 4.0f, kFlag10Bit, kLinear}},
+  {kFormatXRGB2101010, {"XRGB_2101010", 4.0f, kFlag10Bit, kLinear}},
+  {kFormatBGRA1010102, {"BGRA_1010102", 4.0f, kFlag10Bit | kFlagAlpha, kLinear}},
+  {kFormatABGR2101010, {"ABGR_2101010", 4.0f, kFlag10Bit | kFlagAlpha, kLinear}},
+  {kFormatBGRX1010102, {"BGRX_1010102", 4.0f, kFlag10Bit, kLinear}},
+  {kFormatXBGR2101010, {"XBGR_2101010", 4.0f, kFlag10Bit, kLinear}},
+  {kFormatRGBA1010102Ubwc, {"RGBA_1010102_UBWC", 4.0f, kFlagUbwc | kFlag10Bit | kFlagAlpha, kUBWC}},
+  {kFormatRGBX1010102Ubwc, {"RGBX_1010102_UBWC", 4.0f, kFlagUbwc | kFlag10Bit, kUBWC}},
+  {kFormatYCbCr420Planar, {"Y_CB_CR_420", 1.5f, 0, kLinear}},
+  {kFormatYCrCb420Planar, {"Y_CR_CB_420", 1.5f, 0, kLinear}},
+  {kFormatYCrCb420PlanarStride16, {"Y_CR_CB_420_STRIDE16", 1.5f, 0, kLinear}},
+  {kFormatYCbCr420SemiPlanar, {"Y_CBCR_420", 1.5f, 0, kLinear}},
+  {kFormatYCrCb420SemiPlanar, {"Y_CRCB_420", 1.5f, 0, kLinear}},
+  {kFormatYCbCr420SemiPlanarVenus, {"Y_CBCR_420_VENUS", 1.5f, 0, kLinear}},
+  {kFormatYCbCr422H1V2SemiPlanar, {"Y_CBCR_422_H1V2", 2.0f, 0, kLinear}},
+  {kFormatYCrCb422H1V2SemiPlanar, {"Y_CRCB_422_H1V2", 2.0f, 0, kLinear}},
+  {kFormatYCbCr422H2V1SemiPlanar, {"Y_CBCR_422_H2V1", 2.0f, 0, kLinear}},
+  {kFormatYCrCb422H2V1SemiPlanar, {"Y_CRCB_422_H2V2", 2.0f, 0, kLinear}},
+  {kFormatYCbCr420SPVenusUbwc, {"Y_CBCR_420_VENUS_UBWC", 1.5f, kFlagUbwc, kUBWC}},
+  {kFormatYCrCb420SemiPlanarVenus, {"Y_CRCB_420_VENUS", 1.5f, 0, kLinear}},
+  {kFormatYCbCr420P010, {"Y_CBCR_420_P010", 3.0f, kFlag10Bit, kLinear}},
+  {kFormatYCbCr420TP10Ubwc, {"Y_CBCR_420_TP10_UBWC", 2.0f, kFlagUbwc | kFlag10Bit, kTPTiled}},
+  {kFormatYCbCr420P010Ubwc, {"Y_CBCR_420_P010_UBWC", 3.0f, kFlagUbwc | kFlag10Bit, kUBWC}},
+  {kFormatYCbCr420P010Venus, {"Y_CBCR_420_P010_VENUS", 3.0f, kFlag10Bit, kLinear}},
+  {kFormatYCbCr420SPVenusTile, {"Y_CBCR_420_VENUS_TILED", 1.5f, 0, kUBWC}},
+  {kFormatYCbCr420TP10Tile, {"Y_CBCR_420_TP10_TILED", 2.0f, 0, kTPTiled}},
+  {kFormatYCbCr420P010Tile, {"Y_CBCR_420_P010_TILED", 3.0f, 0, kUBWC}},
+  {kFormatYCbCr422H2V1Packed, {"YCBYCR_422_H2V1", 2.0f, 0, kLinear}},
+  {kFormatCbYCrY422H2V1Packed, {"CBYCRY_422_H2V1", 2.0f, 0, kLinear}},
+};
+
+// Formats are enumerated in groups starting at multiples of 0x100, each well below 32 entries.
+// Anything outside maps to the trailing unknown entry.
+constexpr uint32_t kFormatGroupSize = 32;
+constexpr uint32_t kNumFormatGroups = 4;
+constexpr uint32_t kUnknownFormatIndex = kNumFormatGroups * kFormatGroupSize;
+
+constexpr uint32_t GetFormatIndex(uint32_t format) {
+  return ((format >> 8) < kNumFormatGroups && (format & 0xFF) < kFormatGroupSize) ?
+         (format >> 8) * kFormatGroupSize + (format & 0xFF) : kUnknownFormatIndex;
+}
+
+struct FormatTable {
+  FormatInfo info[kUnknownFormatIndex + 1];
+};
+
+constexpr FormatTable BuildFormatTable() {
+  FormatTable table = {};
+  for (const FormatEntry &entry : kFormats) {
+    table.info[GetFormatIndex(entry.format)] = entry.info;
   }
+  return table;
+}
+
+// Properties of each format, looked up per layer per frame by strategy and resource checks.
+constexpr FormatTable kFormatTable = BuildFormatTable();
+
+static_assert(GetFormatIndex(kFormatRGBX1010102Ubwc) < kFormatGroupSize &&
+              GetFormatIndex(kFormatYCbCr420P010Tile) < 3 * kFormatGroupSize &&
+              GetFormatIndex(kFormatCbYCrY422H2V1Packed) < kUnknownFormatIndex,
+              "LayerBufferFormat groups no longer fit the format table");
+
+inline const FormatInfo &GetFormatInfo(LayerBufferFormat format) {
+  return kFormatTable.info[GetFormatIndex(format)];
+}
+
+}  // namespace
+
+bool IsUBWCFormat(LayerBufferFormat format) {
+  return GetFormatInfo(format).flags & kFlagUbwc;
 }
 
 bool Is10BitFormat(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatRGBA1010102:
-  case kFormatARGB2101010:
-  case kFormatRGBX1010102:
-  case kFormatXRGB2101010:
-  case kFormatBGRA1010102:
-  case kFormatABGR2101010:
-  case kFormatBGRX1010102:
-  case kFormatXBGR2101010:
-  case kFormatRGBA1010102Ubwc:
-  case kFormatRGBX1010102Ubwc:
-  case kFormatYCbCr420P010:
-  case kFormatYCbCr420TP10Ubwc:
-  case kFormatYCbCr420P010Ubwc:
-  case kFormatYCbCr420P010Venus:
-    return true;
-  default:
-    return false;
-  }
+  return GetFormatInfo(format).flags & kFlag10Bit;
 }
 
 const char *GetFormatString(const LayerBufferFormat &format) {
-  switch (format) {
-  case kFormatARGB8888:                 return "ARGB_8888";
-  case kFormatRGBA8888:                 return "RGBA_8888";
-  case kFormatBGRA8888:                 return "BGRA_8888";
-  case kFormatXRGB8888:                 return "XRGB_8888";
-  case kFormatRGBX8888:                 return "RGBX_8888";
-  case kFormatBGRX8888:                 return "BGRX_8888";
-  case kFormatRGBA5551:                 return "RGBA_5551";
-  case kFormatRGBA4444:                 return "RGBA_4444";
-  case kFormatRGB888:                   return "RGB_888";
-  case kFormatBGR888:                   return "BGR_888";
-  case kFormatRGB565:                   return "RGB_565";
-  case kFormatBGR565:                   return "BGR_565";
-  case kFormatRGBA8888Ubwc:             return "RGBA_8888_UBWC";
-  case kFormatRGBX8888Ubwc:             return "RGBX_8888_UBWC";
-  case kFormatBGR565Ubwc:               return "BGR_565_UBWC";
-  case kFormatYCbCr420Planar:           return "Y_CB_CR_420";
-  case kFormatYCrCb420Planar:           return "Y_CR_CB_420";
-  case kFormatYCrCb420PlanarStride16:   return "Y_CR_CB_420_STRIDE16";
-  case kFormatYCbCr420SemiPlanar:       return "Y_CBCR_420";
-  case kFormatYCrCb420SemiPlanar:       return "Y_CRCB_420";
-  case kFormatYCbCr420SemiPlanarVenus:  return "Y_CBCR_420_VENUS";
-  case kFormatYCrCb420SemiPlanarVenus:  return "Y_CRCB_420_VENUS";
-  case kFormatYCbCr422H1V2SemiPlanar:   return "Y_CBCR_422_H1V2";
-  case kFormatYCrCb422H1V2SemiPlanar:   return "Y_CRCB_422_H1V2";
-  case kFormatYCbCr422H2V1SemiPlanar:   return "Y_CBCR_422_H2V1";
-  case kFormatYCrCb422H2V1SemiPlanar:   return "Y_CRCB_422_H2V2";
-  case kFormatYCbCr420SPVenusUbwc:      return "Y_CBCR_420_VENUS_UBWC";
-  case kFormatYCbCr420SPVenusTile:      return "Y_CBCR_420_VENUS_TILED";
-  case kFormatYCbCr422H2V1Packed:       return "YCBYCR_422_H2V1";
-  case kFormatCbYCrY422H2V1Packed:      return "CBYCRY_422_H2V1";
-  case kFormatRGBA1010102:              return "RGBA_1010102";
-  case kFormatARGB2101010:              return "ARGB_2101010";
-  case kFormatRGBX1010102:              return "RGBX_1010102";
-  case kFormatXRGB2101010:              return "XRGB_2101010";
-  case kFormatBGRA1010102:              return "BGRA_1010102";
-  case kFormatABGR2101010:              return "ABGR_2101010";
-  case kFormatBGRX1010102:              return "BGRX_1010102";
-  case kFormatXBGR2101010:              return "XBGR_2101010";
-  case kFormatRGBA1010102Ubwc:          return "RGBA_1010102_UBWC";
-  case kFormatRGBX1010102Ubwc:          return "RGBX_1010102_UBWC";
-  case kFormatYCbCr420P010:             return "Y_CBCR_420_P010";
-  case kFormatYCbCr420TP10Ubwc:         return "Y_CBCR_420_TP10_UBWC";
-  case kFormatYCbCr420P010Ubwc:         return "Y_CBCR_420_P010_UBWC";
-  case kFormatYCbCr420P010Venus:        return "Y_CBCR_420_P010_VENUS";
-  case kFormatYCbCr420TP10Tile:         return "Y_CBCR_420_TP10_TILED";
-  case kFormatYCbCr420P010Tile:         return "Y_CBCR_420_P010_TILED";
-  default:                              return "UNKNOWN";
-  }
+  return GetFormatInfo(format).name;
 }
 
 BufferLayout GetBufferLayout(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatYCbCr420TP10Ubwc:
-  case kFormatYCbCr420TP10Tile:
-    return kTPTiled;
-  case kFormatYCbCr420SPVenusTile:
-  case kFormatYCbCr420P010Tile:
-    return kUBWC;
-  default:
-    return (IsUBWCFormat(format) ? kUBWC : kLinear);
-  }
+  return GetFormatInfo(format).layout;
 }
 
 float GetBufferFormatBpp(LayerBufferFormat format) {
-  float bpp = 0.0f;
-  switch (format) {
-    case kFormatARGB8888:
-    case kFormatRGBA8888:
-    case kFormatBGRA8888:
-    case kFormatXRGB8888:
-    case kFormatRGBX8888:
-    case kFormatBGRX8888:
-    case kFormatRGBA8888Ubwc:
-    case kFormatRGBX8888Ubwc:
-    case kFormatRGBA1010102:
-    case kFormatARGB2101010:
-    case kFormatRGBX1010102:
-    case kFormatXRGB2101010:
-    case kFormatBGRA1010102:
-    case kFormatABGR2101010:
-    case kFormatBGRX1010102:
-    case kFormatXBGR2101010:
-    case kFormatRGBA1010102Ubwc:
-    case kFormatRGBX1010102Ubwc:
-      return 4.0f;
-    case kFormatRGB888:
-    case kFormatBGR888:
-    case kFormatYCbCr420P010:
-    case kFormatYCbCr420P010Ubwc:
-    case kFormatYCbCr420P010Venus:
-    case kFormatYCbCr420P010Tile:
-      return 3.0f;
-    case kFormatRGB565:
-    case kFormatBGR565:
-    case kFormatRGBA5551:
-    case kFormatRGBA4444:
-    case kFormatBGR565Ubwc:
-    case kFormatYCbCr422H2V1Packed:
-    case kFormatCbYCrY422H2V1Packed:
-    case kFormatYCrCb422H2V1SemiPlanar:
-    case kFormatYCbCr422H2V1SemiPlanar:
-    case kFormatYCbCr420TP10Ubwc:
-    case kFormatYCbCr420TP10Tile:
-    case kFormatYCbCr422H1V2SemiPlanar:
-    case kFormatYCrCb422H1V2SemiPlanar:
-      return 2.0f;
-    case kFormatYCbCr420Planar:
-    case kFormatYCrCb420Planar:
-    case kFormatYCrCb420PlanarStride16:
-    case kFormatYCbCr420SemiPlanar:
-    case kFormatYCrCb420SemiPlanar:
-    case kFormatYCbCr420SemiPlanarVenus:
-    case kFormatYCrCb420SemiPlanarVenus:
-    case kFormatYCbCr420SPVenusUbwc:
-    case kFormatYCbCr420SPVenusTile:
-      return 1.5f;
-    default:
-      return 0.0f;
-  }
-
-  return bpp;
+  return GetFormatInfo(format).bpp;
 }
 
 DisplayError GetBufferFormatTileSize(LayerBufferFormat format, FormatTileSize *tile_size) {
@@ -226,22 +189,7 @@ DisplayError GetBufferFormatTileSize(LayerBufferFormat format, FormatTileSize *t
 }
 
 bool HasAlphaChannel(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatARGB8888:
-  case kFormatRGBA8888:
-  case kFormatBGRA8888:
-  case kFormatRGBA5551:
-  case kFormatRGBA4444:
-  case kFormatRGBA8888Ubwc:
-  case kFormatRGBA1010102:
-  case kFormatARGB2101010:
-  case kFormatBGRA1010102:
-  case kFormatABGR2101010:
-  case kFormatRGBA1010102Ubwc:
-    return true;
-  default:
-    return false;
-  }
+  return GetFormatInfo(format).flags & kFlagAlpha;
 }
 
 bool IsWideColor(const ColorPrimaries &primary) {
@@ -0,0 +1,154 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <time.h>
+#include <utils/frame_timing.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+#define __CLASS__ "FrameTiming"
+
+namespace sdm {
+
+// Zero initialized; slots store display_id + 1 so that zero marks a free slot.
+FrameTiming::DisplayTiming FrameTiming::display_timing_[kMaxDisplays];
+
+FrameTiming::ScopedStage::ScopedStage(int32_t display_id, FrameStage stage)
+  : display_id_(display_id), stage_(stage), start_ns_(Now()) {
+}
+
+FrameTiming::ScopedStage::~ScopedStage() {
+  Record(display_id_, stage_, Now() - start_ns_);
+}
+
+uint64_t FrameTiming::Now() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL) + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+FrameTiming::DisplayTiming *FrameTiming::GetDisplayTiming(int32_t display_id, bool create) {
+  int32_t key = display_id + 1;
+  for (auto &timing : display_timing_) {
+    int32_t slot = timing.display_id.load(std::memory_order_acquire);
+    if (slot == key) {
+      return &timing;
+    }
+    if (!slot && create) {
+      if (timing.display_id.compare_exchange_strong(slot, key, std::memory_order_acq_rel) ||
+          slot == key) {
+        return &timing;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void FrameTiming::Record(int32_t display_id, FrameStage stage, uint64_t duration_ns) {
+  if (stage >= kFrameStageMax) {
+    return;
+  }
+
+  DisplayTiming *timing = GetDisplayTiming(display_id, true /* create */);
+  if (!timing) {
+    return;
+  }
+
+  StageRing &ring = timing->stages[stage];
+  uint32_t count = ring.count.load(std::memory_order_relaxed);
+  ring.samples[count % kMaxSamples].store(duration_ns, std::memory_order_relaxed);
+  ring.count.store(count + 1, std::memory_order_release);
+}
+
+uint64_t FrameTiming::GetLatest(int32_t display_id, FrameStage stage) {
+  DisplayTiming *timing = GetDisplayTiming(display_id, false /* create */);
+  if (!timing || stage >= kFrameStageMax) {
+    return 0;
+  }
+
+  StageRing &ring = timing->stages[stage];
+  uint32_t count = ring.count.load(std::memory_order_acquire);
+  if (!count) {
+    return 0;
+  }
+
+  return ring.samples[(count - 1) % kMaxSamples].load(std::memory_order_relaxed);
+}
+
+const char *FrameTiming::GetStageName(FrameStage stage) {
+  switch (stage) {
+    case kFrameStageValidate:   return "Validate";
+    case kFrameStagePrepare:    return "Prepare";
+    case kFrameStageStrategy:   return "Strategy";
+    case kFrameStageResources:  return "Resources";
+    case kFrameStageHWValidate: return "HWValidate";
+    case kFrameStagePresent:    return "Present";
+    case kFrameStageCommit:     return "Commit";
+    case kFrameStageDRMCommit:  return "DRMCommit";
+    case kFrameStageHWEvent:    return "HWEvent";
+    default:                    return "Unknown";
+  }
+}
+
+void FrameTiming::Dump(int32_t display_id, std::ostringstream *os) {
+  DisplayTiming *timing = GetDisplayTiming(display_id, false /* create */);
+  if (!timing) {
+    return;
+  }
+
+  *os << "\n------------Frame Timing (us)-----------\n";
+  std::vector<uint64_t> samples;
+  samples.reserve(kMaxSamples);
+  for (uint32_t i = 0; i < kFrameStageMax; i++) {
+    StageRing &ring = timing->stages[i];
+    uint32_t count = std::min(ring.count.load(std::memory_order_acquire), kMaxSamples);
+    if (!count) {
+      continue;
+    }
+
+    samples.clear();
+    for (uint32_t j = 0; j < count; j++) {
+      samples.push_back(ring.samples[j].load(std::memory_order_relaxed));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    uint64_t p50 = samples[(count - 1) / 2];
+    uint64_t p99 = samples[((count - 1) * 99) / 100];
+    *os << std::setw(12) << GetStageName(static_cast<FrameStage>(i));
+    *os << " p50: " << std::setw(7) << (p50 / 1000);
+    *os << " p99: " << std::setw(7) << (p99 / 1000);
+    *os << " max: " << std::setw(7) << (samples.back() / 1000);
+    *os << " frames: " << count << std::endl;
+  }
+}
+
+}  // namespace sdm
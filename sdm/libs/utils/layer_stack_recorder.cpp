@@ -0,0 +1,154 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <inttypes.h>
+#include <utils/layer_stack_recorder.h>
+
+#define __CLASS__ "LayerStackRecorder"
+
+namespace sdm {
+
+// Record layout, one line each:
+//   stack <layer count> <stack flags>
+//   layer <composition> <format> <w> <h> <unaligned w> <unaligned h> <buffer flags> <primaries>
+//         <transfer> <buffer id> <src l t r b> <dst l t r b> <rotation> <flip h> <flip v>
+//         <blending> <plane alpha> <frame rate> <solid fill> <layer flags> <update mask>
+//         <visible count> <visible l t r b>... <dirty count> <dirty l t r b>...
+
+static void WriteRects(FILE *file, const std::vector<LayerRect> &rects) {
+  fprintf(file, " %zu", rects.size());
+  for (auto &rect : rects) {
+    fprintf(file, " %f %f %f %f", rect.left, rect.top, rect.right, rect.bottom);
+  }
+}
+
+static bool ReadRect(FILE *file, LayerRect *rect) {
+  return fscanf(file, "%f %f %f %f", &rect->left, &rect->top, &rect->right, &rect->bottom) == 4;
+}
+
+static bool ReadRects(FILE *file, std::vector<LayerRect> *rects) {
+  size_t count = 0;
+  if (fscanf(file, "%zu", &count) != 1) {
+    return false;
+  }
+
+  rects->resize(count);
+  for (auto &rect : *rects) {
+    if (!ReadRect(file, &rect)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LayerStackRecorder::Write(FILE *file, const LayerStack &stack) {
+  if (!file) {
+    return false;
+  }
+
+  fprintf(file, "stack %zu %u\n", stack.layers.size(), stack.flags.flags);
+  for (auto layer : stack.layers) {
+    const LayerBuffer &buffer = layer->input_buffer;
+    fprintf(file, "layer %d %d %u %u %u %u %u %d %d %" PRIu64, layer->composition, buffer.format,
+            buffer.width, buffer.height, buffer.unaligned_width, buffer.unaligned_height,
+            buffer.flags.flags, buffer.color_metadata.colorPrimaries,
+            buffer.color_metadata.transfer, buffer.buffer_id);
+    fprintf(file, " %f %f %f %f %f %f %f %f", layer->src_rect.left, layer->src_rect.top,
+            layer->src_rect.right, layer->src_rect.bottom, layer->dst_rect.left,
+            layer->dst_rect.top, layer->dst_rect.right, layer->dst_rect.bottom);
+    fprintf(file, " %f %d %d %d %u %u %u %u %lu", layer->transform.rotation,
+            layer->transform.flip_horizontal, layer->transform.flip_vertical, layer->blending,
+            layer->plane_alpha, layer->frame_rate, layer->solid_fill_color, layer->flags.flags,
+            layer->update_mask.to_ulong());
+    WriteRects(file, layer->visible_regions);
+    WriteRects(file, layer->dirty_regions);
+    fprintf(file, "\n");
+  }
+
+  return !ferror(file);
+}
+
+bool LayerStackRecorder::Read(FILE *file, RecordedLayerStack *recorded) {
+  if (!file || !recorded) {
+    return false;
+  }
+
+  size_t count = 0;
+  uint32_t stack_flags = 0;
+  if (fscanf(file, " stack %zu %u", &count, &stack_flags) != 2) {
+    return false;
+  }
+
+  recorded->layers.assign(count, Layer());
+  recorded->stack = LayerStack();
+  recorded->stack.flags.flags = stack_flags;
+  for (auto &layer : recorded->layers) {
+    LayerBuffer &buffer = layer.input_buffer;
+    int composition = 0, format = 0, primaries = 0, transfer = 0;
+    if (fscanf(file, " layer %d %d %u %u %u %u %u %d %d %" SCNu64, &composition, &format,
+               &buffer.width, &buffer.height, &buffer.unaligned_width, &buffer.unaligned_height,
+               &buffer.flags.flags, &primaries, &transfer, &buffer.buffer_id) != 10) {
+      return false;
+    }
+
+    if (!ReadRect(file, &layer.src_rect) || !ReadRect(file, &layer.dst_rect)) {
+      return false;
+    }
+
+    int flip_horizontal = 0, flip_vertical = 0, blending = 0;
+    uint32_t plane_alpha = 0;
+    unsigned long update_mask = 0;
+    if (fscanf(file, "%f %d %d %d %u %u %u %u %lu", &layer.transform.rotation, &flip_horizontal,
+               &flip_vertical, &blending, &plane_alpha, &layer.frame_rate,
+               &layer.solid_fill_color, &layer.flags.flags, &update_mask) != 9) {
+      return false;
+    }
+
+    if (!ReadRects(file, &layer.visible_regions) || !ReadRects(file, &layer.dirty_regions)) {
+      return false;
+    }
+
+    layer.composition = static_cast<LayerComposition>(composition);
+    buffer.format = static_cast<LayerBufferFormat>(format);
+    buffer.color_metadata.colorPrimaries = static_cast<ColorPrimaries>(primaries);
+    buffer.color_metadata.transfer = static_cast<GammaTransfer>(transfer);
+    layer.transform.flip_horizontal = flip_horizontal;
+    layer.transform.flip_vertical = flip_vertical;
+    layer.blending = static_cast<LayerBlending>(blending);
+    layer.plane_alpha = static_cast<uint8_t>(plane_alpha);
+    layer.update_mask = std::bitset<kLayerUpdateMax>(update_mask);
+    recorded->stack.layers.push_back(&layer);
+  }
+
+  return true;
+}
+
+}  // namespace sdm
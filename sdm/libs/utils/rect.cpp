@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2015-2019, The Linux Foundation. All rights reserved.
+* Copyright (c) 2015-2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without
 * modification, are permitted provided that the following conditions are
@@ -32,6 +32,10 @@
 #include <utils/constants.h>
 #include <algorithm>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #define __CLASS__ "RectUtils"
 
 namespace sdm {
@@ -350,5 +354,117 @@ DisplayError GetScaleFactor(const LayerRect &crop, const LayerRect &dst,
   return kErrorNone;
 }
 
+static float Area(const LayerRect &rect) {
+  return IsValid(rect) ? (rect.right - rect.left) * (rect.bottom - rect.top) : 0.0f;
+}
+
+void MergeRects(uint32_t max_count, std::vector<LayerRect> *rects) {
+  rects->erase(std::remove_if(rects->begin(), rects->end(),
+                              [](const LayerRect &rect) { return !IsValid(rect); }),
+               rects->end());
+  max_count = std::max(max_count, 1U);
+
+  bool merged = true;
+  while (merged && rects->size() > 1) {
+    merged = false;
+    size_t merge_i = 0, merge_j = 0;
+    float min_cost = 0.0f;
+
+    for (size_t i = 0; i < rects->size() && !merged; i++) {
+      for (size_t j = i + 1; j < rects->size(); j++) {
+        const LayerRect &rect_i = rects->at(i);
+        const LayerRect &rect_j = rects->at(j);
+        if (IsValid(Intersection(rect_i, rect_j))) {
+          // Overlapping rects are always merged, regions sent to the panel have to be disjoint.
+          merge_i = i;
+          merge_j = j;
+          merged = true;
+          break;
+        }
+
+        float cost = Area(Union(rect_i, rect_j)) - Area(rect_i) - Area(rect_j);
+        if ((rects->size() > max_count) && (!merge_j || cost < min_cost)) {
+          merge_i = i;
+          merge_j = j;
+          min_cost = cost;
+        }
+      }
+    }
+
+    if (merged || merge_j) {
+      rects->at(merge_i) = Union(rects->at(merge_i), rects->at(merge_j));
+      rects->erase(rects->begin() + static_cast<std::ptrdiff_t>(merge_j));
+      merged = true;
+    }
+  }
+}
+
+#if defined(__ARM_NEON)
+static_assert(sizeof(LayerRect) == 4 * sizeof(float), "a LayerRect is loaded as one vector");
+
+// Lanes are {left, top, right, bottom}, the first two take the min for a union.
+static const uint32_t kLeftTopLanes[4] = { UINT32_MAX, UINT32_MAX, 0, 0 };
+
+static inline bool IsValid(float32x4_t rect) {
+  // {right > left, bottom > top, ...}
+  uint32x4_t gt = vcgtq_f32(vextq_f32(rect, rect, 2), rect);
+  return vgetq_lane_u32(gt, 0) && vgetq_lane_u32(gt, 1);
+}
+#endif
+
+LayerRect UnionAll(const LayerRect *rects, size_t count) {
+  LayerRect res;
+  size_t i = 0;
+
+  // Seed with the first valid rect, as Union() ignores invalid ones.
+  while (i < count && !IsValid(rects[i])) {
+    i++;
+  }
+  if (i == count) {
+    return res;
+  }
+
+#if defined(__ARM_NEON)
+  const uint32x4_t left_top = vld1q_u32(kLeftTopLanes);
+  float32x4_t acc = vld1q_f32(&rects[i].left);
+  for (i++; i < count; i++) {
+    float32x4_t rect = vld1q_f32(&rects[i].left);
+    if (IsValid(rect)) {
+      acc = vbslq_f32(left_top, vminq_f32(acc, rect), vmaxq_f32(acc, rect));
+    }
+  }
+  vst1q_f32(&res.left, acc);
+#else
+  res = rects[i];
+  for (i++; i < count; i++) {
+    res = Union(res, rects[i]);
+  }
+#endif
+
+  return res;
+}
+
+void IntersectAll(const LayerRect &clip, LayerRect *rects, size_t count) {
+  if (!IsValid(clip)) {
+    std::fill(rects, rects + count, LayerRect());
+    return;
+  }
+
+#if defined(__ARM_NEON)
+  const uint32x4_t left_top = vld1q_u32(kLeftTopLanes);
+  const float32x4_t clip_rect = vld1q_f32(&clip.left);
+  const float32x4_t empty = vdupq_n_f32(0.0f);
+  for (size_t i = 0; i < count; i++) {
+    float32x4_t rect = vld1q_f32(&rects[i].left);
+    float32x4_t res = vbslq_f32(left_top, vmaxq_f32(rect, clip_rect), vminq_f32(rect, clip_rect));
+    vst1q_f32(&rects[i].left, (IsValid(rect) && IsValid(res)) ? res : empty);
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    rects[i] = Intersection(rects[i], clip);
+  }
+#endif
+}
+
 }  // namespace sdm
 
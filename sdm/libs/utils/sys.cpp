@@ -27,11 +27,17 @@
 * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <utils/constants.h>
 #include <utils/sys.h>
+#include <utils/thread_policy.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <chrono>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define __CLASS__ "Sys"
 
@@ -91,5 +97,73 @@ void DynLib::Close() {
   }
 }
 
+struct PreloadedLib {
+  std::string name;
+  void *handle = NULL;
+  bool done = false;
+  uint64_t load_us = 0;
+};
+
+static std::mutex g_preload_mutex;
+static std::vector<PreloadedLib> g_preloaded_libs;
+
+// The dynamic linker serializes dlopen on its own lock, so one thread loads the list in order.
+static void PreloadLibs() {
+  ThreadPolicy::Apply(kThreadClassBackground, "sdm_lib_preload");
+
+  std::unique_lock<std::mutex> lock(g_preload_mutex);
+  for (size_t i = 0; i < g_preloaded_libs.size(); i++) {
+    std::string name = g_preloaded_libs[i].name;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    void *handle = ::dlopen(name.c_str(), RTLD_NOW);
+    auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    PreloadedLib &lib = g_preloaded_libs[i];
+    lib.handle = handle;
+    lib.done = true;
+    lib.load_us = UINT64(load_us);
+  }
+}
+
+void DynLibPreloader::Start(const std::vector<std::string> &lib_names) {
+  std::lock_guard<std::mutex> lock(g_preload_mutex);
+  if (!g_preloaded_libs.empty()) {
+    return;
+  }
+
+  for (auto &name : lib_names) {
+    PreloadedLib lib;
+    lib.name = name;
+    g_preloaded_libs.push_back(lib);
+  }
+
+  if (!g_preloaded_libs.empty()) {
+    std::thread(PreloadLibs).detach();
+  }
+}
+
+void DynLibPreloader::Dump(std::ostringstream *os) {
+  std::lock_guard<std::mutex> lock(g_preload_mutex);
+  if (g_preloaded_libs.empty()) {
+    return;
+  }
+
+  *os << "\nPreloaded libraries:\n";
+  for (auto &lib : g_preloaded_libs) {
+    *os << "  " << lib.name << ": ";
+    if (!lib.done) {
+      *os << "pending\n";
+    } else if (!lib.handle) {
+      *os << "not found\n";
+    } else {
+      *os << lib.load_us << " us\n";
+    }
+  }
+}
+
 }  // namespace sdm
 
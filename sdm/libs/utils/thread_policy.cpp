@@ -0,0 +1,222 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/thread_policy.h>
+
+#include <string>
+
+#define __CLASS__ "ThreadPolicy"
+
+namespace sdm {
+
+static const char *kThreadClassNames[kThreadClassMax] = {
+  "event", "present", "uevent", "gpu", "background",
+};
+
+static const int kNiceUrgentDisplay = -8;  // HAL_PRIORITY_URGENT_DISPLAY
+
+std::once_flag ThreadPolicy::load_once_;
+std::mutex ThreadPolicy::lock_;
+ThreadPolicy::Policy ThreadPolicy::policies_[kThreadClassMax];
+
+void ThreadPolicy::Load() {
+  // Vsync timestamps and the presents they pace run as lowest priority real time tasks, so that
+  // they are not queued behind busy normal tasks. Other classes keep the policy they inherit.
+  Policy &event = policies_[kThreadClassEvent];
+  event.set = true;
+  event.fifo_priority = sched_get_priority_min(SCHED_FIFO);
+
+  Policy &present = policies_[kThreadClassPresent];
+  present.set = true;
+  present.fifo_priority = sched_get_priority_min(SCHED_FIFO);
+
+  Policy &uevent = policies_[kThreadClassUEvent];
+  uevent.set = true;
+  uevent.nice = kNiceUrgentDisplay;
+
+  for (uint32_t i = 0; i < kThreadClassMax; i++) {
+    char value[64] = {};
+    std::string name = std::string(THREAD_POLICY_PROP) + kThreadClassNames[i];
+    if (Debug::GetProperty(name.c_str(), value) == kErrorNone && value[0]) {
+      if (!ParsePolicy(value, &policies_[i])) {
+        DLOGW("Ignoring %s = %s", name.c_str(), value);
+      }
+    }
+
+    value[0] = '\0';
+    name = std::string(THREAD_CPUS_PROP) + kThreadClassNames[i];
+    if (Debug::GetProperty(name.c_str(), value) == kErrorNone && value[0]) {
+      policies_[i].cpu_mask = ParseCpus(value);
+      if (!policies_[i].cpu_mask) {
+        DLOGW("Ignoring %s = %s", name.c_str(), value);
+      }
+    }
+  }
+}
+
+bool ThreadPolicy::ParsePolicy(const char *value, Policy *policy) {
+  if (!strcmp(value, "default")) {
+    policy->set = false;
+    return true;
+  }
+
+  const char *separator = strchr(value, ':');
+  if (!separator || !separator[1]) {
+    return false;
+  }
+
+  char *end = nullptr;
+  long priority = strtol(separator + 1, &end, 10);  // NOLINT
+  if (*end) {
+    return false;
+  }
+
+  std::string type(value, size_t(separator - value));
+  if (type == "fifo") {
+    if (priority < sched_get_priority_min(SCHED_FIFO) ||
+        priority > sched_get_priority_max(SCHED_FIFO)) {
+      return false;
+    }
+    policy->fifo_priority = INT(priority);
+    policy->nice = 0;
+  } else if (type == "nice") {
+    if (priority < -20 || priority > 19) {
+      return false;
+    }
+    policy->fifo_priority = 0;
+    policy->nice = INT(priority);
+  } else {
+    return false;
+  }
+
+  policy->set = true;
+  return true;
+}
+
+uint64_t ThreadPolicy::ParseCpus(const char *value) {
+  // Comma separated CPUs and CPU ranges, as in the cpuset files.
+  uint64_t mask = 0;
+  const char *cursor = value;
+  while (*cursor) {
+    char *end = nullptr;
+    long first = strtol(cursor, &end, 10);  // NOLINT
+    long last = first;  // NOLINT
+    if (end == cursor) {
+      return 0;
+    }
+    if (*end == '-') {
+      cursor = end + 1;
+      last = strtol(cursor, &end, 10);
+      if (end == cursor) {
+        return 0;
+      }
+    }
+    if (first < 0 || last < first || last >= 64) {
+      return 0;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {  // NOLINT
+      mask |= (1ULL << cpu);
+    }
+    if (*end == ',') {
+      end++;
+    } else if (*end) {
+      return 0;
+    }
+    cursor = end;
+  }
+
+  return mask;
+}
+
+void ThreadPolicy::Apply(ThreadClass thread_class, const char *name) {
+  std::call_once(load_once_, Load);
+
+  prctl(PR_SET_NAME, name, 0, 0, 0);
+
+  const Policy &policy = policies_[thread_class];
+  if (policy.set) {
+    // Threads inherit the policy of the thread that created them, which may be real time.
+    struct sched_param param = {0};
+    param.sched_priority = policy.fifo_priority;
+    if (sched_setscheduler(0, policy.fifo_priority ? SCHED_FIFO : SCHED_OTHER, &param)) {
+      DLOGW("%s: failed to set scheduler, error = %s", name, strerror(errno));
+    }
+    if (!policy.fifo_priority && setpriority(PRIO_PROCESS, 0, policy.nice)) {
+      DLOGW("%s: failed to set nice %d, error = %s", name, policy.nice, strerror(errno));
+    }
+  }
+
+  if (policy.cpu_mask) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < 64; cpu++) {
+      if (policy.cpu_mask & (1ULL << cpu)) {
+        CPU_SET(cpu, &cpus);
+      }
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+      DLOGW("%s: failed to set affinity, error = %s", name, strerror(errno));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  policies_[thread_class].applied++;
+}
+
+void ThreadPolicy::Dump(std::ostringstream *os) {
+  std::call_once(load_once_, Load);
+
+  std::lock_guard<std::mutex> lock(lock_);
+  *os << "\nThread policies:\n";
+  for (uint32_t i = 0; i < kThreadClassMax; i++) {
+    const Policy &policy = policies_[i];
+    *os << "  " << kThreadClassNames[i] << ": ";
+    if (!policy.set) {
+      *os << "default";
+    } else if (policy.fifo_priority) {
+      *os << "fifo " << policy.fifo_priority;
+    } else {
+      *os << "nice " << policy.nice;
+    }
+    if (policy.cpu_mask) {
+      *os << " cpus 0x" << std::hex << policy.cpu_mask << std::dec;
+    }
+    *os << " threads " << policy.applied << "\n";
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,155 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/vsync_model.h>
+#include <stdlib.h>
+
+#include <cmath>
+
+#define __CLASS__ "VSyncModel"
+
+namespace sdm {
+
+void VSyncModel::Reset(int64_t nominal_period_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  nominal_period_ns_ = nominal_period_ns;
+  ResetLocked();
+}
+
+void VSyncModel::ResetLocked() {
+  num_samples_ = 0;
+  next_sample_ = 0;
+  outliers_ = 0;
+  period_ns_ = 0;
+  reference_ns_ = 0;
+}
+
+void VSyncModel::AddSample(int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!num_samples_) {
+    AddSampleLocked(timestamp_ns, 0);
+    return;
+  }
+
+  const Sample &last = samples_[(next_sample_ + kMaxSamples - 1) % kMaxSamples];
+  int64_t period_ns = period_ns_ ? period_ns_ : nominal_period_ns_;
+  int64_t interval_ns = timestamp_ns - last.timestamp_ns;
+  if (period_ns <= 0) {
+    // No nominal period to start from, take the first interval as the initial guess.
+    if (interval_ns <= 0) {
+      return;
+    }
+    period_ns = interval_ns;
+  }
+
+  // Vsyncs may have been missed while hardware vsync was off, so compare against the nearest
+  // multiple of the period.
+  int64_t periods = (interval_ns + period_ns / 2) / period_ns;
+  int64_t error_ns = interval_ns - (periods * period_ns);
+  if (periods < 1 || llabs(error_ns) > (period_ns / 4)) {
+    if (++outliers_ >= kMaxOutliers) {
+      // The period changed without a Reset(), relearn it from the incoming intervals.
+      nominal_period_ns_ = 0;
+      ResetLocked();
+      AddSampleLocked(timestamp_ns, 0);
+    }
+    return;
+  }
+
+  // Decay instead of clearing, a new rate can still line up with every few vsyncs of the old one.
+  if (outliers_) {
+    outliers_--;
+  }
+  AddSampleLocked(timestamp_ns, last.index + periods);
+  UpdateModelLocked();
+}
+
+void VSyncModel::AddSampleLocked(int64_t timestamp_ns, int64_t index) {
+  samples_[next_sample_].timestamp_ns = timestamp_ns;
+  samples_[next_sample_].index = index;
+  next_sample_ = (next_sample_ + 1) % kMaxSamples;
+  if (num_samples_ < kMaxSamples) {
+    num_samples_++;
+  }
+}
+
+void VSyncModel::UpdateModelLocked() {
+  if (num_samples_ < kMinSamples) {
+    return;
+  }
+
+  // Least squares fit of timestamp against vsync index, relative to the oldest sample so that
+  // the sums stay well within double precision.
+  const Sample &oldest = samples_[(next_sample_ + kMaxSamples - num_samples_) % kMaxSamples];
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (uint32_t i = 0; i < num_samples_; i++) {
+    const Sample &sample = samples_[i];
+    double x = static_cast<double>(sample.index - oldest.index);
+    double y = static_cast<double>(sample.timestamp_ns - oldest.timestamp_ns);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+
+  double n = static_cast<double>(num_samples_);
+  double denominator = (n * sum_xx) - (sum_x * sum_x);
+  if (denominator <= 0) {
+    return;
+  }
+
+  double slope = ((n * sum_xy) - (sum_x * sum_y)) / denominator;
+  double intercept = (sum_y - (slope * sum_x)) / n;
+  period_ns_ = static_cast<int64_t>(std::llround(slope));
+  reference_ns_ = oldest.timestamp_ns + static_cast<int64_t>(std::llround(intercept));
+}
+
+bool VSyncModel::Predict(int64_t now_ns, int64_t *next_vsync_ns, int64_t *period_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (period_ns_ <= 0 || !num_samples_) {
+    return false;
+  }
+
+  const Sample &last = samples_[(next_sample_ + kMaxSamples - 1) % kMaxSamples];
+  if ((now_ns - last.timestamp_ns) > kMaxExtrapolationNs) {
+    return false;
+  }
+
+  int64_t elapsed_ns = now_ns - reference_ns_;
+  int64_t periods = elapsed_ns / period_ns_;
+  if ((elapsed_ns < 0) && (elapsed_ns % period_ns_)) {
+    periods--;
+  }
+  *next_vsync_ns = reference_ns_ + ((periods + 1) * period_ns_);
+  *period_ns = period_ns_;
+
+  return true;
+}
+
+}  // namespace sdm